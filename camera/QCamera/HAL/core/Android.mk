@@ -81,7 +81,8 @@ LOCAL_HAL_FILES := \
         src/QCameraStream.cpp\
         ../usbcamcore/src/QualcommUsbCamera.cpp\
         ../usbcamcore/src/QCameraMjpegDecode.cpp\
-        ../usbcamcore/src/QCameraUsbParm.cpp
+        ../usbcamcore/src/QCameraUsbParm.cpp\
+        ../../../QCamera2/util/QCameraPlaneOps.cpp
 
 LOCAL_HAL_WRAPPER_FILES := ../wrapper/QualcommCamera.cpp
 
@@ -89,6 +90,7 @@ LOCAL_C_INCLUDES := \
         $(LOCAL_PATH)/../wrapper \
         $(LOCAL_PATH)/inc \
         $(LOCAL_PATH)/../usbcamcore/inc\
+        $(LOCAL_PATH)/../../../QCamera2/util\
         $(LOCAL_PATH)/../../stack/mm-camera-interface/inc \
         $(LOCAL_PATH)/../../stack/mm-jpeg-interface/inc \
         $(LOCAL_PATH)/../../../ \
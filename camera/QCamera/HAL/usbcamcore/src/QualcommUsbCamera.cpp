@@ -46,6 +46,7 @@
 #include "QCameraUsbPriv.h"
 #include "QCameraMjpegDecode.h"
 #include "QCameraUsbParm.h"
+#include "QCameraPlaneOps.h"
 #include <gralloc_priv.h>
 #include <genlock.h>
 
@@ -718,23 +719,14 @@ int usbcam_dump(struct camera_device * device, int fd)
 static int convert_YUYV_to_420_NV12(char *in_buf, char *out_buf, int wd, int ht)
 {
     int rc =0;
-    int row, col, uv_row;
 
     ALOGD("%s: E", __func__);
-    /* Arrange Y */
-    for(row = 0; row < ht; row++)
-        for(col = 0; col < wd * 2; col += 2)
-        {
-            out_buf[row * wd + col / 2] = in_buf[row * wd * 2 + col];
-        }
-
-    /* Arrange UV */
-    for(row = 0, uv_row = ht; row < ht; row += 2, uv_row++)
-        for(col = 1; col < wd * 2; col += 4)
-        {
-            out_buf[uv_row * wd + col / 2]= in_buf[row * wd * 2 + col + 2];
-            out_buf[uv_row * wd + col / 2 + 1]  = in_buf[row * wd * 2 + col];
-        }
+    /* Chroma is written V first, i.e. the output is really NV21 */
+    qcamera::QCameraPlaneOps::yuyvToSemiPlanar(
+        (uint8_t *)out_buf, wd,
+        (uint8_t *)out_buf + wd * ht, wd,
+        (const uint8_t *)in_buf, wd * 2,
+        wd, ht, true);
 
     ALOGD("%s: X", __func__);
     return rc;
@@ -6,6 +6,13 @@ LOCAL_SRC_FILES := \
         QCamera2HWI.cpp \
         QCameraMem.cpp \
         ../util/QCameraQueue.cpp \
+        ../util/QCameraBoundedQueue.cpp \
+        ../util/QCameraPlaneOps.cpp \
+        ../util/QCameraDumpWriter.cpp \
+        ../util/QCameraBurstScheduler.cpp \
+        ../util/QCameraLoadGovernor.cpp \
+        ../util/QCameraBufIndexMap.cpp \
+        ../util/QCameraRecordingMonitor.cpp \
         ../util/QCameraCmdThread.cpp \
         QCameraStateMachine.cpp \
         QCameraChannel.cpp \
@@ -14,6 +21,7 @@ LOCAL_SRC_FILES := \
         QCamera2HWICallbacks.cpp \
         QCameraParameters.cpp \
         QCameraThermalAdapter.cpp \
+        QCameraCapabilityCache.cpp \
         wrapper/QualcommCamera.cpp
 
 LOCAL_CFLAGS = -Wall -Wextra -Werror
@@ -56,6 +64,7 @@ LOCAL_C_INCLUDES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/media
 ifeq ($(TARGET_TS_MAKEUP),true)
 LOCAL_CFLAGS += -DTARGET_TS_MAKEUP
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/tsMakeuplib/include
+LOCAL_SRC_FILES += QCameraMakeup.cpp
 endif
 LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
 
@@ -69,6 +78,27 @@ LOCAL_MODULE := camera.$(TARGET_BOARD_PLATFORM)
 LOCAL_32_BIT_ONLY := true
 LOCAL_MODULE_TAGS := optional
 
+QCAMERA_HAL_SRC_FILES := $(LOCAL_SRC_FILES)
+QCAMERA_HAL_CFLAGS := $(LOCAL_CFLAGS)
+QCAMERA_HAL_C_INCLUDES := $(LOCAL_C_INCLUDES)
+QCAMERA_HAL_SHARED_LIBRARIES := $(filter-out libmmcamera_interface,$(LOCAL_SHARED_LIBRARIES))
+
+include $(BUILD_SHARED_LIBRARY)
+
+# camera.synth: the same HAL on libmmcamera_interface_synth, for running and
+# profiling the pipeline without sensor, kernel driver or daemon. Loaded with
+# hw_get_module_by_class("camera", "synth"), see test/qcamera_synth_test.cpp
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(QCAMERA_HAL_SRC_FILES)
+LOCAL_CFLAGS := $(QCAMERA_HAL_CFLAGS) -DQCAMERA_SYNTH_ION
+LOCAL_C_INCLUDES := $(QCAMERA_HAL_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SHARED_LIBRARIES := $(QCAMERA_HAL_SHARED_LIBRARIES) libmmcamera_interface_synth
+LOCAL_MODULE_RELATIVE_PATH    := hw
+LOCAL_MODULE := camera.synth.default
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS := optional
+
 include $(BUILD_SHARED_LIBRARY)
 
 include $(LOCAL_PATH)/test/Android.mk
@@ -34,6 +34,7 @@
 #include <cutils/properties.h>
 #include <hardware/camera.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <utils/Errors.h>
 #include <utils/Trace.h>
 #include <gralloc_priv.h>
@@ -41,6 +42,7 @@
 
 #include "QCamera2HWI.h"
 #include "QCameraMem.h"
+#include "QCameraCapabilityCache.h"
 
 #define MAP_TO_DRIVER_COORDINATE(val, base, scale, offset) \
   ((int32_t)val * (int32_t)scale / (int32_t)base + (int32_t)offset)
@@ -255,6 +257,11 @@ int QCamera2HardwareInterface::msg_type_enabled(struct camera_device *device, in
         ALOGE("NULL camera device");
         return BAD_VALUE;
     }
+    // read only, answered without the cmd thread when the state allows it
+    if (hw->m_stateMachine.canAnswerQueries()) {
+        return hw->msgTypeEnabled(msg_type);
+    }
+
     hw->lockAPI();
     qcamera_api_result_t apiResult;
     ret = hw->processAPI(QCAMERA_SM_EVT_MSG_TYPE_ENABLED, (void *)&msg_type);
@@ -290,6 +297,7 @@ int QCamera2HardwareInterface::start_preview(struct camera_device *device)
         return BAD_VALUE;
     }
     CDBG_HIGH("[KPI Perf] %s: E PROFILE_START_PREVIEW", __func__);
+    cam_trace_refresh();
     hw->lockAPI();
     qcamera_api_result_t apiResult;
     qcamera_sm_evt_enum_t evt = QCAMERA_SM_EVT_START_PREVIEW;
@@ -358,6 +366,10 @@ int QCamera2HardwareInterface::preview_enabled(struct camera_device *device)
         ALOGE("NULL camera device");
         return BAD_VALUE;
     }
+    // read only, answered from the state snapshot when the state allows it
+    if (hw->m_stateMachine.getPreviewEnabled(ret)) {
+        return ret;
+    }
 
     hw->lockAPI();
     qcamera_api_result_t apiResult;
@@ -494,6 +506,11 @@ int QCamera2HardwareInterface::recording_enabled(struct camera_device *device)
         ALOGE("NULL camera device");
         return BAD_VALUE;
     }
+    // read only, answered from the state snapshot when the state allows it
+    if (hw->m_stateMachine.getRecordingEnabled(ret)) {
+        return ret;
+    }
+
     hw->lockAPI();
     qcamera_api_result_t apiResult;
     ret = hw->processAPI(QCAMERA_SM_EVT_RECORDING_ENABLED, NULL);
@@ -885,10 +902,15 @@ void QCamera2HardwareInterface::release(struct camera_device *device)
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int QCamera2HardwareInterface::dump(struct camera_device * /*device*/, int /*fd*/)
+int QCamera2HardwareInterface::dump(struct camera_device *device, int fd)
 {
-    //This is not implemented, so just return here.
-    return NO_ERROR;
+    QCamera2HardwareInterface *hw =
+        reinterpret_cast<QCamera2HardwareInterface *>(device->priv);
+    if (!hw) {
+        ALOGE("NULL camera device");
+        return BAD_VALUE;
+    }
+    return hw->dump(fd);
 }
 
 /*===========================================================================
@@ -991,6 +1013,7 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(uint32_t cameraId)
       mDumpFrmCnt(0U),
       mDumpSkipCnt(0U),
       mThermalLevel(QCAMERA_THERMAL_NO_ADJUSTMENT),
+      mThermalRequest(QCAMERA_THERMAL_NO_ADJUSTMENT),
       mCancelAutoFocus(false),
       mActiveAF(false),
       m_HDRSceneEnabled(false),
@@ -1012,15 +1035,15 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(uint32_t cameraId)
       mMetadataJob(-1),
       mReprocJob(-1),
       mRawdataJob(-1),
+      mParamInitJob(-1),
+      mThermalJob(-1),
+      mPoolWarmUpJob(-1),
+      mPoolWarmUpCancel(false),
       mPreviewFrameSkipValid(0),
       mNumPreviewFaces(-1),
       mAdvancedCaptureConfigured(false),
       mFPSReconfigure(false)
 {
-#ifdef TARGET_TS_MAKEUP
-    mMakeUpBuf = NULL;
-    memset(&mFaceRect, -1, sizeof(mFaceRect));
-#endif
     getLogLevel();
     ATRACE_CALL();
     mCameraDevice.common.tag = HARDWARE_DEVICE_TAG;
@@ -1122,7 +1145,11 @@ int QCamera2HardwareInterface::openCamera(struct hw_device_t **hw_device)
     rc = openCamera();
     if (rc == NO_ERROR){
         *hw_device = &mCameraDevice.common;
-        if (m_thermalAdapter.init(this) != 0) {
+        // thermal client registration does not gate the first frame
+        DefferWorkArgs args;
+        memset(&args, 0, sizeof(DefferWorkArgs));
+        mThermalJob = queueDefferedWork(CMD_DEFF_THERMAL_INIT, args);
+        if (mThermalJob < 0 && m_thermalAdapter.init(this) != 0) {
           ALOGE("Init thermal adapter failed");
         }
     }
@@ -1239,9 +1266,21 @@ int QCamera2HardwareInterface::openCamera()
        }
     }
 
+    // the parameter table only needs the capabilities, build it on the
+    // deferred thread while the jpeg client comes up here
+    DefferWorkArgs args;
+    memset(&args, 0, sizeof(DefferWorkArgs));
+    mParamInitJob = queueDefferedWork(CMD_DEFF_PARAM_INIT, args);
+    if (mParamInitJob < 0) {
+        mParameters.init(gCamCapability[mCameraId], mCameraHandle, this, this);
+    }
+
     int32_t rc = m_postprocessor.init(jpegEvtHandle, this);
+    waitDefferedWork(mParamInitJob);
+    mParamInitJob = -1;
     if (rc != 0) {
         ALOGE("Init Postprocessor failed");
+        mParameters.deinit();
         mCameraHandle->ops->close_camera(mCameraHandle->camera_handle);
         mCameraHandle = NULL;
         return UNKNOWN_ERROR;
@@ -1260,9 +1299,8 @@ int QCamera2HardwareInterface::openCamera()
         gCamCapability[mCameraId]->padding_info.plane_padding = padding_info.plane_padding;
     }
 
-    mParameters.init(gCamCapability[mCameraId], mCameraHandle, this, this);
-
     mCameraOpened = true;
+    warmUpMetadataPool();
 
     return NO_ERROR;
 }
@@ -1297,13 +1335,22 @@ int QCamera2HardwareInterface::closeCamera()
 
     pthread_mutex_unlock(&m_parm_lock);
 
+    // no metadata pool warm up may run past close
+    cancelMemoryPoolWarmUp();
+
     // exit notifier
     m_cbNotifier.exit();
+    m_cbMemPool.clear();
 
     // stop and deinit postprocessor
     m_postprocessor.stop();
+#ifdef TARGET_TS_MAKEUP
+    m_makeup.release();
+#endif
     m_postprocessor.deinit();
 
+    waitDefferedWork(mThermalJob);
+    mThermalJob = -1;
     m_thermalAdapter.deinit();
 
     // delete all channels if not already deleted
@@ -1315,6 +1362,9 @@ int QCamera2HardwareInterface::closeCamera()
         }
     }
 
+    // no stream is left to dump from, flush and index the dump container
+    m_dumpWriter.stop();
+
     //free all pending api results here
     if(m_apiResultList != NULL) {
         api_result_list *apiResultList = m_apiResultList;
@@ -1355,6 +1405,21 @@ int QCamera2HardwareInterface::initCapabilities(uint32_t cameraId,
     ATRACE_CALL();
     int rc = NO_ERROR;
     QCameraHeapMemory *capabilityHeap = NULL;
+    bool useCache = QCameraCapabilityCache::isEnabled();
+    nsecs_t startTime = systemTime();
+
+    gCamCapability[cameraId] = (cam_capability_t *)malloc(sizeof(cam_capability_t));
+    if (!gCamCapability[cameraId]) {
+        ALOGE("%s: out of memory", __func__);
+        return NO_MEMORY;
+    }
+
+    if (useCache &&
+            QCameraCapabilityCache::load(cameraId, gCamCapability[cameraId]) == NO_ERROR) {
+        CDBG_HIGH("[KPI Perf] %s: capabilities from cache in %lld us", __func__,
+                (long long)ns2us(systemTime() - startTime));
+        goto save_sizes;
+    }
 
     /* Allocate memory for capability buffer */
     capabilityHeap = new QCameraHeapMemory(QCAMERA_ION_USE_CACHE);
@@ -1381,14 +1446,29 @@ int QCamera2HardwareInterface::initCapabilities(uint32_t cameraId,
         ALOGE("%s: failed to query capability",__func__);
         goto query_failed;
     }
-    gCamCapability[cameraId] = (cam_capability_t *)malloc(sizeof(cam_capability_t));
-    if (!gCamCapability[cameraId]) {
-        ALOGE("%s: out of memory", __func__);
-        goto query_failed;
-    }
     memcpy(gCamCapability[cameraId], DATA_PTR(capabilityHeap,0),
                                         sizeof(cam_capability_t));
+    CDBG_HIGH("[KPI Perf] %s: capabilities queried in %lld us", __func__,
+            (long long)ns2us(systemTime() - startTime));
+    if (useCache) {
+        QCameraCapabilityCache::store(cameraId, gCamCapability[cameraId]);
+    }
+    rc = NO_ERROR;
+
+query_failed:
+    cameraHandle->ops->unmap_buf(cameraHandle->camera_handle,
+                            CAM_MAPPING_BUF_TYPE_CAPABILITY);
+map_failed:
+    capabilityHeap->deallocate();
+allocate_failed:
+    delete capabilityHeap;
+    if (rc != NO_ERROR) {
+        free(gCamCapability[cameraId]);
+        gCamCapability[cameraId] = NULL;
+        return rc;
+    }
 
+save_sizes:
     //copy the preview sizes and video sizes lists because they
     //might be changed later
     copyList(gCamCapability[cameraId]->preview_sizes_tbl, savedSizes[cameraId].all_preview_sizes,
@@ -1398,16 +1478,7 @@ int QCamera2HardwareInterface::initCapabilities(uint32_t cameraId,
              gCamCapability[cameraId]->video_sizes_tbl_cnt);
     savedSizes[cameraId].all_video_sizes_cnt = gCamCapability[cameraId]->video_sizes_tbl_cnt;
 
-    rc = NO_ERROR;
-
-query_failed:
-    cameraHandle->ops->unmap_buf(cameraHandle->camera_handle,
-                            CAM_MAPPING_BUF_TYPE_CAPABILITY);
-map_failed:
-    capabilityHeap->deallocate();
-    delete capabilityHeap;
-allocate_failed:
-    return rc;
+    return NO_ERROR;
 }
 
 /*===========================================================================
@@ -1619,8 +1690,10 @@ uint8_t QCamera2HardwareInterface::getBufNumRequired(cam_stream_type_t stream_ty
         break;
     case CAM_STREAM_TYPE_VIDEO:
         {
+            // includes the slots held back for growth, see startRecordingMonitor
             bufferCnt = CAMERA_MIN_VIDEO_BUFFERS +
-                    mParameters.getNumOfExtraBuffersForVideo();
+                    mParameters.getNumOfExtraBuffersForVideo() +
+                    getVideoReservedBufs();
         }
         break;
     case CAM_STREAM_TYPE_METADATA:
@@ -1668,6 +1741,135 @@ uint8_t QCamera2HardwareInterface::getBufNumRequired(cam_stream_type_t stream_ty
     return (uint8_t)bufferCnt;
 }
 
+/*===========================================================================
+ * FUNCTION   : warmUpMemoryPool
+ *
+ * DESCRIPTION: queues allocation of the snapshot buffers of a regular non
+ *              ZSL capture into the memory pool while preview runs, so
+ *              takePicture does not wait on ION. Enabled by setting
+ *              persist.camera.mem.pool.warmup to 1. takePicture waits for
+ *              the job and stopPreview cancels it.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::warmUpMemoryPool()
+{
+    char value[PROPERTY_VALUE_MAX];
+    cam_stream_info_t streamInfo;
+    DefferWorkArgs args;
+
+    property_get("persist.camera.mem.usepool", value, "1");
+    if (atoi(value) != 1) {
+        return;
+    }
+    property_get("persist.camera.mem.pool.warmup", value, "0");
+    if ((atoi(value) != 1) || isZSLMode() || isLongshotEnabled() ||
+            mParameters.getRecordingHintValue()) {
+        return;
+    }
+
+    memset(&streamInfo, 0, sizeof(cam_stream_info_t));
+    streamInfo.stream_type = CAM_STREAM_TYPE_SNAPSHOT;
+    mParameters.getStreamFormat(CAM_STREAM_TYPE_SNAPSHOT, streamInfo.fmt);
+    mParameters.getStreamDimension(CAM_STREAM_TYPE_SNAPSHOT, streamInfo.dim);
+    if (mm_stream_calc_offset_snapshot(&streamInfo, &streamInfo.dim,
+            &gCamCapability[mCameraId]->padding_info,
+            &streamInfo.buf_planes) != 0) {
+        return;
+    }
+
+    memset(&args, 0, sizeof(DefferWorkArgs));
+    args.poolArgs.heap_id = 0x1 << ION_IOMMU_HEAP_ID;
+    args.poolArgs.size = streamInfo.buf_planes.plane_info.frame_len;
+    args.poolArgs.cached = QCAMERA_ION_USE_CACHE;
+    args.poolArgs.count = getBufNumRequired(CAM_STREAM_TYPE_SNAPSHOT);
+    waitDefferedWork(mPoolWarmUpJob);
+    {
+        Mutex::Autolock l(mDeffLock);
+        mPoolWarmUpCancel = false;
+    }
+    mPoolWarmUpJob = queueDefferedWork(CMD_DEFF_POOL_WARMUP, args);
+    if (mPoolWarmUpJob < 0) {
+        CDBG_HIGH("%s: no slot for pool warm up", __func__);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : cancelMemoryPoolWarmUp
+ *
+ * DESCRIPTION: drops the snapshot pool warm up if it did not start yet and
+ *              waits for it otherwise, so no preload runs past stopPreview
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::cancelMemoryPoolWarmUp()
+{
+    {
+        Mutex::Autolock l(mDeffLock);
+        mPoolWarmUpCancel = true;
+    }
+    waitDefferedWork(mPoolWarmUpJob);
+    mPoolWarmUpJob = -1;
+}
+
+/*===========================================================================
+ * FUNCTION   : warmUpMetadataPool
+ *
+ * DESCRIPTION: queue preloading of the metadata stream buffers at open.
+ *              Their size and count only depend on the capabilities and the
+ *              default parameters, so the first startPreview takes them
+ *              from the memory pool instead of ION. Shares the warm up job
+ *              of warmUpMemoryPool: preparePreview waits for it and
+ *              closeCamera cancels it. Off unless
+ *              persist.camera.mem.pool.warmup is 1.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::warmUpMetadataPool()
+{
+    char value[PROPERTY_VALUE_MAX];
+    cam_dimension_t dim;
+    cam_stream_buf_plane_info_t bufPlanes;
+    DefferWorkArgs args;
+
+    property_get("persist.camera.mem.usepool", value, "1");
+    if (atoi(value) != 1) {
+        return;
+    }
+    property_get("persist.camera.mem.pool.warmup", value, "0");
+    if (atoi(value) != 1) {
+        return;
+    }
+
+    mParameters.getStreamDimension(CAM_STREAM_TYPE_METADATA, dim);
+    memset(&bufPlanes, 0, sizeof(cam_stream_buf_plane_info_t));
+    if (mm_stream_calc_offset_metadata(&dim,
+            &gCamCapability[mCameraId]->padding_info, &bufPlanes) != 0) {
+        return;
+    }
+
+    memset(&args, 0, sizeof(DefferWorkArgs));
+    args.poolArgs.heap_id = 0x1 << ION_IOMMU_HEAP_ID;
+    args.poolArgs.size = bufPlanes.plane_info.frame_len;
+    args.poolArgs.cached = QCAMERA_ION_USE_CACHE;
+    args.poolArgs.count = getBufNumRequired(CAM_STREAM_TYPE_METADATA);
+    waitDefferedWork(mPoolWarmUpJob);
+    {
+        Mutex::Autolock l(mDeffLock);
+        mPoolWarmUpCancel = false;
+    }
+    mPoolWarmUpJob = queueDefferedWork(CMD_DEFF_POOL_WARMUP, args);
+    if (mPoolWarmUpJob < 0) {
+        CDBG_HIGH("%s: no slot for pool warm up", __func__);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : allocateStreamBuf
  *
@@ -1964,6 +2166,8 @@ int QCamera2HardwareInterface::setCallBacks(camera_notify_callback notify_cb,
     mDataCbTimestamp = data_cb_timestamp;
     mGetMemory       = get_memory;
     mCallbackCookie  = user;
+    // pooled preview buffers belong to the previous client
+    m_cbMemPool.clear();
     m_cbNotifier.setCallbacks(notify_cb, data_cb, data_cb_timestamp, user);
     return NO_ERROR;
 }
@@ -1982,7 +2186,8 @@ int QCamera2HardwareInterface::setCallBacks(camera_notify_callback notify_cb,
  *==========================================================================*/
 int QCamera2HardwareInterface::enableMsgType(int32_t msg_type)
 {
-    mMsgEnabled |= msg_type;
+    // msg_type_enabled reads the mask without the API lock
+    __atomic_fetch_or(&mMsgEnabled, msg_type, __ATOMIC_RELEASE);
     CDBG_HIGH("%s (0x%x) : mMsgEnabled = 0x%x", __func__, msg_type , mMsgEnabled );
     return NO_ERROR;
 }
@@ -2001,7 +2206,7 @@ int QCamera2HardwareInterface::enableMsgType(int32_t msg_type)
  *==========================================================================*/
 int QCamera2HardwareInterface::disableMsgType(int32_t msg_type)
 {
-    mMsgEnabled &= ~msg_type;
+    __atomic_fetch_and(&mMsgEnabled, ~msg_type, __ATOMIC_RELEASE);
     CDBG_HIGH("%s (0x%x) : mMsgEnabled = 0x%x", __func__, msg_type , mMsgEnabled );
     return NO_ERROR;
 }
@@ -2019,7 +2224,7 @@ int QCamera2HardwareInterface::disableMsgType(int32_t msg_type)
  *==========================================================================*/
 int QCamera2HardwareInterface::msgTypeEnabled(int32_t msg_type)
 {
-    return (mMsgEnabled & msg_type);
+    return (__atomic_load_n(&mMsgEnabled, __ATOMIC_ACQUIRE) & msg_type);
 }
 
 /*===========================================================================
@@ -2058,7 +2263,11 @@ int QCamera2HardwareInterface::startPreview()
     ATRACE_CALL();
     int32_t rc = NO_ERROR;
     CDBG_HIGH("%s: E", __func__);
-    updateThermalLevel(mThermalLevel);
+    startLoadGovernor();
+    updateThermalLevel(mThermalRequest);
+#ifdef TARGET_TS_MAKEUP
+    startMakeup();
+#endif
     // start preview stream
     if (mParameters.isZSLMode() && mParameters.getRecordingHintValue() !=true) {
         rc = startChannel(QCAMERA_CH_TYPE_ZSL);
@@ -2073,15 +2282,10 @@ int QCamera2HardwareInterface::startPreview()
         cam_focus_mode_type focusMode = mParameters.getFocusMode();
         if (focusMode == CAM_FOCUS_MODE_CONTINOUS_PICTURE)
             mCameraHandle->ops->cancel_auto_focus(mCameraHandle->camera_handle);
+        if (rc == NO_ERROR) {
+            warmUpMemoryPool();
+        }
     }
-#ifdef TARGET_TS_MAKEUP
-    if (mMakeUpBuf == NULL) {
-        int pre_width, pre_height;
-        mParameters.getPreviewSize(&pre_width, &pre_height);
-        mMakeUpBuf = new unsigned char[pre_width*pre_height*3/2];
-        CDBG_HIGH("prewidht=%d,preheight=%d",pre_width, pre_height);
-    }
-#endif
     CDBG_HIGH("%s: X", __func__);
     return rc;
 }
@@ -2103,20 +2307,26 @@ int QCamera2HardwareInterface::stopPreview()
     CDBG_HIGH("%s: E", __func__);
     mNumPreviewFaces = -1;
     mActiveAF = false;
+#ifdef TARGET_TS_MAKEUP
+    // queued frames go back to the stream before it stops
+    m_makeup.stopWorker();
+#endif
     // stop preview stream
     stopChannel(QCAMERA_CH_TYPE_ZSL);
     stopChannel(QCAMERA_CH_TYPE_PREVIEW);
+    m_loadGovernor.stop();
+    cancelMemoryPoolWarmUp();
+
+    // drop pending preview callbacks and the buffers mapped for them
+    m_cbNotifier.flushPreviewCallbacks();
+    m_cbMemPool.clear();
 
     //reset preview frame skip
     mPreviewFrameSkipValid = 0;
     memset(&mPreviewFrameSkipIdxRange, 0, sizeof(cam_frame_idx_range_t));
     //add for ts makeup
 #ifdef TARGET_TS_MAKEUP
-    if (mMakeUpBuf) {
-        delete []mMakeUpBuf;
-        mMakeUpBuf=NULL;
-    }
-    ts_makeup_finish();
+    m_makeup.releasePreview();
 #endif
     // delete all channels from preparePreview
     unpreparePreview();
@@ -2199,7 +2409,12 @@ int QCamera2HardwareInterface::startRecording()
     }
 
     if (rc == NO_ERROR) {
+        // before the channel starts, so the first frames are accounted
+        startRecordingMonitor();
         rc = startChannel(QCAMERA_CH_TYPE_VIDEO);
+        if (rc != NO_ERROR) {
+            m_recMonitor.stop();
+        }
     }
 
 #ifdef HAS_MULTIMEDIA_HINTS
@@ -2229,6 +2444,8 @@ int QCamera2HardwareInterface::startRecording()
 int QCamera2HardwareInterface::stopRecording()
 {
     CDBG_HIGH("%s: E", __func__);
+    // waits for a buffer growth in progress and blocks new ones
+    m_recMonitor.stop();
     int rc = stopChannel(QCAMERA_CH_TYPE_VIDEO);
 
 #ifdef HAS_MULTIMEDIA_HINTS
@@ -2261,6 +2478,15 @@ int QCamera2HardwareInterface::releaseRecordingFrame(const void * opaque)
         (QCameraVideoChannel *)m_channels[QCAMERA_CH_TYPE_VIDEO];
     CDBG("%s: opaque data = %p", __func__,opaque);
     if(pChannel != NULL) {
+        // account the return before the buffer can come back as a new frame
+        QCameraStream *pStream = pChannel->getVideoStream();
+        if ((pStream != NULL) && (pStream->getStreamBufs() != NULL)) {
+            int index = pStream->getStreamBufs()->getMatchBufIndex(opaque,
+                    mStoreMetaDataInFrame > 0);
+            // out of range for a buffer that was not found
+            m_recMonitor.returned((index < 0) ?
+                    QCAMERA_REC_MAX_BUFS : (uint32_t)index);
+        }
         rc = pChannel->releaseFrame(opaque, mStoreMetaDataInFrame > 0);
     }
     return rc;
@@ -2862,6 +3088,10 @@ int QCamera2HardwareInterface::takePicture()
 
     getOrientation();
     CDBG_HIGH("%s: E", __func__);
+    // the snapshot buffers are allocated below, let the warm up fill the
+    // pool first instead of racing it for the same ION memory
+    waitDefferedWork(mPoolWarmUpJob);
+    mPoolWarmUpJob = -1;
     if (mParameters.isZSLMode()) {
 
         //Reduce fps range to half of the current value during zsl snapshot.
@@ -2907,9 +3137,15 @@ int QCamera2HardwareInterface::takePicture()
                         mCameraHandle->camera_handle,
                         pZSLChannel->getMyHandle());
             }
-            rc = pZSLChannel->takePicture(numSnapshots);
+            if (mLongshotEnabled) {
+                startBurst(pZSLChannel);
+                rc = longShot();
+            } else {
+                rc = pZSLChannel->takePicture(numSnapshots);
+            }
             if (rc != NO_ERROR) {
                 ALOGE("%s: cannot take ZSL picture", __func__);
+                stopBurst();
                 m_postprocessor.stop();
                 return rc;
             }
@@ -3007,8 +3243,10 @@ int QCamera2HardwareInterface::takePicture()
                     }
                 }
                 if ( mLongshotEnabled ) {
+                    startBurst(m_channels[QCAMERA_CH_TYPE_CAPTURE]);
                     rc = longShot();
                     if (NO_ERROR != rc) {
+                        stopBurst();
                         waitDefferedWork(mReprocJob);
                         delChannel(QCAMERA_CH_TYPE_CAPTURE);
                         return rc;
@@ -3054,7 +3292,8 @@ int QCamera2HardwareInterface::takePicture()
  * FUNCTION   : longShot
  *
  * DESCRIPTION: Queue one more ZSL frame
- *              in the longshot pipe.
+ *              in the longshot pipe. While the burst scheduler runs the
+ *              request may be held back until the pipeline has room.
  *
  * PARAMETERS : none
  *
@@ -3064,8 +3303,29 @@ int QCamera2HardwareInterface::takePicture()
  *==========================================================================*/
 int32_t QCamera2HardwareInterface::longShot()
 {
-    int32_t rc = NO_ERROR;
     uint8_t numSnapshots = mParameters.getNumOfSnapshots();
+
+    if (m_burstScheduler.isActive()) {
+        return m_burstScheduler.requestShot(numSnapshots);
+    }
+    return queueLongShot(numSnapshots);
+}
+
+/*===========================================================================
+ * FUNCTION   : queueLongShot
+ *
+ * DESCRIPTION: request frames for the longshot pipe from the backend
+ *
+ * PARAMETERS :
+ *   @numSnapshots : number of frames
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::queueLongShot(uint8_t numSnapshots)
+{
+    int32_t rc = NO_ERROR;
     QCameraPicChannel *pChannel = NULL;
 
     if (mParameters.isZSLMode()) {
@@ -3086,6 +3346,342 @@ end:
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : burstRequest
+ *
+ * DESCRIPTION: request callback of the burst scheduler
+ *
+ * PARAMETERS :
+ *   @count     : number of frames
+ *   @user_data : ptr to QCamera2HardwareInterface
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::burstRequest(uint8_t count, void *user_data)
+{
+    QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)user_data;
+    return pme->queueLongShot(count);
+}
+
+/*===========================================================================
+ * FUNCTION   : startBurst
+ *
+ * DESCRIPTION: start flow control for a longshot. Shots in flight are
+ *              limited by persist.camera.longshot.mem (MB of snapshot and
+ *              reprocess buffers, default 192) and, if set, by
+ *              persist.camera.longshot.window. persist.camera.longshot.sched=0
+ *              passes every request straight to the backend.
+ *
+ * PARAMETERS :
+ *   @pChannel : channel the longshot frames come from
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::startBurst(QCameraChannel *pChannel)
+{
+    char prop[PROPERTY_VALUE_MAX];
+    qcamera_burst_config_t config;
+
+    property_get("persist.camera.longshot.sched", prop, "1");
+    if ((atoi(prop) == 0) || (NULL == pChannel) ||
+            !mParameters.isJpegPictureFormat()) {
+        return;
+    }
+
+    memset(&config, 0, sizeof(config));
+    for (uint32_t i = 0; i < pChannel->getNumOfStreams(); i++) {
+        QCameraStream *pStream = pChannel->getStreamByIndex(i);
+        if ((NULL != pStream) && pStream->isTypeOf(CAM_STREAM_TYPE_SNAPSHOT)) {
+            cam_frame_len_offset_t offset;
+            memset(&offset, 0, sizeof(offset));
+            pStream->getFrameOffset(offset);
+            config.shot_bytes = offset.frame_len;
+            break;
+        }
+    }
+    if (needReprocess()) {
+        // the reprocess output is held until encoding is done as well
+        config.shot_bytes *= 2;
+    }
+
+    property_get("persist.camera.longshot.mem", prop, "192");
+    config.mem_limit = (size_t)atoi(prop) * 1024 * 1024;
+    property_get("persist.camera.longshot.window", prop, "0");
+    config.max_window = (uint32_t)atoi(prop);
+    // a shot lost without a jpeg event gives its slot back after this
+    property_get("persist.camera.longshot.timeout", prop, "3000");
+    config.shot_timeout_ns = (int64_t)atoi(prop) * 1000000LL;
+
+    m_burstScheduler.start(config, burstRequest, this);
+    CDBG_HIGH("%s: shot %zu bytes, limit %zu bytes, window %u", __func__,
+            config.shot_bytes, config.mem_limit, m_burstScheduler.window());
+}
+
+/*===========================================================================
+ * FUNCTION   : stopBurst
+ *
+ * DESCRIPTION: stop longshot flow control, drop shots that are still
+ *              deferred and log the burst statistics
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::stopBurst()
+{
+    static const char *stageNames[QCAMERA_BURST_STAGE_MAX] = {
+        "pp input", "reprocess", "jpeg input", "encode", "save"
+    };
+    qcamera_burst_stats_t stats;
+
+    if (!m_burstScheduler.isActive()) {
+        return;
+    }
+    m_burstScheduler.stop();
+    m_burstScheduler.getStats(stats);
+
+    CDBG_HIGH("%s: %u shots, %.2f shots/s, shot to shot %lld ms avg %lld ms max, "
+            "latency %lld/%lld/%lld ms min/avg/max", __func__,
+            stats.completed, stats.shots_per_sec,
+            (long long)(stats.avg_interval_ns / 1000000),
+            (long long)(stats.max_interval_ns / 1000000),
+            (long long)(stats.min_shot_ns / 1000000),
+            (long long)(stats.avg_shot_ns / 1000000),
+            (long long)(stats.max_shot_ns / 1000000));
+    CDBG_HIGH("%s: requested %u issued %u deferred %u failed %u, "
+            "in flight peak %u window %u", __func__,
+            stats.requested, stats.issued, stats.deferred, stats.failed,
+            stats.peak_in_flight, stats.window);
+    for (int i = 0; i < QCAMERA_BURST_STAGE_MAX; i++) {
+        qcamera_burst_stage_stats_t &st = stats.stage[i];
+        if (st.count > 0) {
+            CDBG_HIGH("%s: %-10s %u frames, depth peak %u, "
+                    "latency avg %lld ms max %lld ms", __func__,
+                    stageNames[i], st.count, st.peak_depth,
+                    (long long)(st.avg_latency_ns / 1000000),
+                    (long long)(st.max_latency_ns / 1000000));
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : startLoadGovernor
+ *
+ * DESCRIPTION: start governing the optional preview work for a new preview
+ *              session. Optional stages may use persist.camera.load.budget
+ *              percent of the frame period (default 40), evaluated every
+ *              persist.camera.load.window ms (default 500).
+ *              persist.camera.load.gov=0 runs every stage on every frame
+ *              and leaves the frame rate to the thermal engine alone.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::startLoadGovernor()
+{
+    char prop[PROPERTY_VALUE_MAX];
+    qcamera_load_config_t config;
+    int minFPS, maxFPS;
+
+    property_get("persist.camera.load.gov", prop, "1");
+    mParameters.getPreviewFpsRange(&minFPS, &maxFPS);
+    if ((atoi(prop) == 0) || (maxFPS <= 0)) {
+        m_loadGovernor.stop();
+        return;
+    }
+
+    memset(&config, 0, sizeof(config));
+    // the range is in fps * 1000
+    config.frame_ns = 1000000000000LL / maxFPS;
+    property_get("persist.camera.load.budget", prop, "40");
+    config.budget_pct = (uint32_t)atoi(prop);
+    property_get("persist.camera.load.window", prop, "500");
+    config.window_ms = (uint32_t)atoi(prop);
+    // calcThermalLevel does no fps mitigation in camcorder mode
+    config.max_fps_step = mParameters.getRecordingHintValue() ?
+            0 : QCAMERA_LOAD_MAX_FPS_STEP;
+    property_get("persist.camera.load.thermal.shed", prop, "0");
+    config.thermal_shed = (atoi(prop) == 1);
+
+    m_loadGovernor.start(config, loadFpsRequest, this);
+    CDBG_HIGH("%s: frame %lld us, budget %u%%, window %u ms", __func__,
+            (long long)(config.frame_ns / 1000), config.budget_pct,
+            config.window_ms);
+}
+
+/*===========================================================================
+ * FUNCTION   : getVideoReservedBufs
+ *
+ * DESCRIPTION: number of video slots registered on top of the regular
+ *              video buffers and only allocated when the encoder holds so
+ *              many buffers that the driver starves. Set with
+ *              persist.camera.video.growbufs, 0 turns growth off.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : number of reserved video slots
+ *==========================================================================*/
+uint8_t QCamera2HardwareInterface::getVideoReservedBufs()
+{
+    char prop[PROPERTY_VALUE_MAX];
+    int base = CAMERA_MIN_VIDEO_BUFFERS +
+            mParameters.getNumOfExtraBuffersForVideo();
+
+    property_get("persist.camera.video.growbufs", prop, "4");
+    int reserved = atoi(prop);
+    if (reserved > MM_CAMERA_MAX_NUM_FRAMES - base) {
+        reserved = MM_CAMERA_MAX_NUM_FRAMES - base;
+    }
+    if (reserved > QCAMERA_REC_MAX_BUFS - base) {
+        reserved = QCAMERA_REC_MAX_BUFS - base;
+    }
+    return (uint8_t)((reserved > 0) ? reserved : 0);
+}
+
+/*===========================================================================
+ * FUNCTION   : startRecordingMonitor
+ *
+ * DESCRIPTION: start watching the video buffers of a new recording. The
+ *              driver is starving once the encoder leaves it no more than
+ *              the ISP ping-pong buffers; persist.camera.video.starve
+ *              frames in a row of that add buffers to the video stream
+ *              out of its reserved slots.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::startRecordingMonitor()
+{
+    char prop[PROPERTY_VALUE_MAX];
+    qcamera_rec_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.active_bufs = (uint32_t)(CAMERA_MIN_VIDEO_BUFFERS +
+            mParameters.getNumOfExtraBuffersForVideo());
+    config.max_bufs = config.active_bufs;
+    QCameraVideoChannel *pChannel =
+            (QCameraVideoChannel *)m_channels[QCAMERA_CH_TYPE_VIDEO];
+    QCameraStream *pStream = (pChannel != NULL) ? pChannel->getVideoStream() : NULL;
+    if (pStream != NULL) {
+        // the reserved slots are registered on top of the regular ones
+        config.max_bufs = pStream->getBufferCount();
+        config.active_bufs = config.max_bufs - getVideoReservedBufs();
+    }
+    config.low_water = CAMERA_ISP_PING_PONG_BUFFERS;
+    property_get("persist.camera.video.starve", prop, "2");
+    config.starve_frames = (uint32_t)atoi(prop);
+    config.grow_step = 2;
+
+    m_recMonitor.start(config);
+    CDBG_HIGH("%s: %u video buffers, up to %u", __func__,
+            config.active_bufs, config.max_bufs);
+}
+
+/*===========================================================================
+ * FUNCTION   : requestVideoGrow
+ *
+ * DESCRIPTION: queue the growth the recording monitor asked for to the
+ *              deferred work thread, allocating on the video stream
+ *              thread would hold up the frames behind it
+ *
+ * PARAMETERS :
+ *   @count   : number of buffers to add
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::requestVideoGrow(uint32_t count)
+{
+    DefferWorkArgs args;
+
+    memset(&args, 0, sizeof(args));
+    args.growArgs = (uint8_t)count;
+    if (queueDefferedWork(CMD_DEFF_GROW_VIDEO_BUFF, args) < 0) {
+        ALOGE("%s: cannot queue video buffer growth", __func__);
+        // the monitor waits for an answer before it asks again
+        if (m_recMonitor.beginGrow()) {
+            m_recMonitor.endGrow(0);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : growVideoBufs
+ *
+ * DESCRIPTION: add buffers to the running video stream out of its
+ *              reserved slots. Runs on the deferred work thread.
+ *
+ * PARAMETERS :
+ *   @count   : number of buffers to add
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::growVideoBufs(uint8_t count)
+{
+    // refused once stopRecording began, which in turn waits for us
+    if (!m_recMonitor.beginGrow()) {
+        return;
+    }
+
+    QCameraVideoChannel *pChannel =
+            (QCameraVideoChannel *)m_channels[QCAMERA_CH_TYPE_VIDEO];
+    QCameraStream *pStream = (pChannel != NULL) ? pChannel->getVideoStream() : NULL;
+    if (pStream == NULL || pStream->growBufs(count) != NO_ERROR) {
+        count = 0;
+    }
+    CDBG_HIGH("%s: added %d video buffers", __func__, count);
+    m_recMonitor.endGrow(count);
+}
+
+#ifdef TARGET_TS_MAKEUP
+/*===========================================================================
+ * FUNCTION   : startMakeup
+ *
+ * DESCRIPTION: set up the makeup stage for a new preview session. With
+ *              persist.camera.makeup.async=1 preview frames are beautified
+ *              and displayed on a worker thread, pipelined with the
+ *              preview stream thread.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::startMakeup()
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    property_get("persist.camera.makeup.async", prop, "0");
+    if (atoi(prop) == 1) {
+        if (m_makeup.startWorker(makeup_preview_routine, this) != NO_ERROR) {
+            ALOGE("%s: makeup worker failed, running inline", __func__);
+        }
+    }
+}
+#endif
+
+/*===========================================================================
+ * FUNCTION   : loadFpsRequest
+ *
+ * DESCRIPTION: rate callback of the load governor. The new step is applied
+ *              from the state machine thread like a thermal level.
+ *
+ * PARAMETERS :
+ *   @step      : fps step, unused, read back in updateLoadLevel
+ *   @user_data : ptr to QCamera2HardwareInterface
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::loadFpsRequest(uint32_t /*step*/, void *user_data)
+{
+    QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)user_data;
+    if (pme->processEvt(QCAMERA_SM_EVT_LOAD_NOTIFY, NULL) != NO_ERROR) {
+        ALOGE("%s: cannot post fps step change", __func__);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : stopCaptureChannel
  *
@@ -3130,8 +3726,14 @@ int QCamera2HardwareInterface::cancelPicture()
     CDBG_HIGH("%s:%d] ",__func__, __LINE__);
     waitDefferedWork(mReprocJob);
 
+    // no more longshot requests once the postprocessor goes down
+    stopBurst();
+
     //stop post processor
     m_postprocessor.stop();
+#ifdef TARGET_TS_MAKEUP
+    m_makeup.releaseSnapshot();
+#endif
 
     unconfigureAdvancedCapture();
 
@@ -3456,6 +4058,9 @@ int QCamera2HardwareInterface::cancelLiveSnapshot()
     }
     //stop post processor
     m_postprocessor.stop();
+#ifdef TARGET_TS_MAKEUP
+    m_makeup.releaseSnapshot();
+#endif
 
     // stop snapshot channel
     rc = stopChannel(QCAMERA_CH_TYPE_SNAPSHOT);
@@ -3758,11 +4363,222 @@ int QCamera2HardwareInterface::release()
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int QCamera2HardwareInterface::dump(int /*fd*/)
+int QCamera2HardwareInterface::dump(int fd)
+{
+    char path[QCAMERA_MAX_FILEPATH_LENGTH];
+    char buf[320];
+    uint32_t hits = 0, misses = 0, mapped = 0;
+    QCameraMemoryPool::QCameraPoolStats poolStats;
+
+    m_memoryPool.getStats(poolStats);
+    m_cbMemPool.getStats(hits, misses, mapped);
+    int len = snprintf(buf, sizeof(buf),
+            "Camera %u\n"
+            "  memory pool: hits %u misses %u evictions %u, "
+            "held %u bufs %zu/%zu bytes, peak %zu\n"
+            "  preview callback buffers: pooled %u new %u mapped %u\n",
+            mCameraId, poolStats.hits, poolStats.misses, poolStats.evictions,
+            poolStats.buffers, poolStats.bytesHeld, poolStats.budget,
+            poolStats.peakBytesHeld, hits, misses, mapped);
+    if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+        ALOGE("%s: write failed", __func__);
+    }
+    m_cbNotifier.dumpPreviewStats(fd);
+    m_stateMachine.dumpEvtStats(fd);
+
+    qcamera_dump_stats_t dumpStats;
+    m_dumpWriter.getStats(dumpStats);
+    if (dumpStats.queued > 0 || m_dumpWriter.isRunning()) {
+        len = snprintf(buf, sizeof(buf),
+                "  frame dumps: queued %u written %u (%llu bytes, %u writes), "
+                "dropped ring %u rate %u interval %u size %u, peak ring %zu\n",
+                dumpStats.queued, dumpStats.written,
+                (unsigned long long)dumpStats.bytes_written, dumpStats.write_calls,
+                dumpStats.dropped_full, dumpStats.dropped_rate,
+                dumpStats.dropped_sample, dumpStats.dropped_limit,
+                dumpStats.peak_ring_used);
+        if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+            ALOGE("%s: write failed", __func__);
+        }
+    }
+
+    dumpLoadStats(fd);
+    dumpRecordingStats(fd);
+#ifdef TARGET_TS_MAKEUP
+    dumpMakeupStats(fd);
+#endif
+
+    if (!g_cam_trace_enabled) {
+        return NO_ERROR;
+    }
+
+    // Frame trace, see persist.camera.trace
+    snprintf(path, sizeof(path), "/data/misc/camera/camera_trace_%u.json",
+            mCameraId);
+    if (cam_trace_dump(fd, path) < 0) {
+        ALOGE("%s: failed to dump frame trace", __func__);
+        return UNKNOWN_ERROR;
+    }
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : dumpLoadStats
+ *
+ * DESCRIPTION: write the load governor state, stage timings and recent
+ *              decisions to a file descriptor
+ *
+ * PARAMETERS :
+ *   @fd      : file descriptor to write to
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::dumpLoadStats(int fd)
+{
+    static const char *stageNames[QCAMERA_LOAD_STAGE_MAX] = {
+        "dump", "fd cb", "preview cb", "makeup", "reprocess"
+    };
+    static const char *reasonNames[] = { "load", "relax", "thermal" };
+    char buf[256];
+    qcamera_load_stats_t stats;
+
+    m_loadGovernor.getStats(stats);
+    if (stats.frames == 0) {
+        return;
+    }
+
+    int len = snprintf(buf, sizeof(buf),
+            "  load governor: %s, level %u/%u, fps step %u (load %u thermal %u), "
+            "load %u%% peak %u%%, %u frames %u windows, "
+            "escalations %u relaxations %u\n",
+            m_loadGovernor.isActive() ? "active" : "stopped",
+            stats.level, stats.max_level, stats.fps_step, stats.load_step,
+            stats.thermal_step, stats.load_pct, stats.peak_load_pct,
+            stats.frames, stats.windows, stats.escalations, stats.relaxations);
+    if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+        ALOGE("%s: write failed", __func__);
+        return;
+    }
+    for (int i = 0; i < QCAMERA_LOAD_STAGE_MAX; i++) {
+        qcamera_load_stage_stats_t &st = stats.stage[i];
+        if (st.runs + st.shed == 0) {
+            continue;
+        }
+        len = snprintf(buf, sizeof(buf),
+                "    %-10s runs %u shed %u every %u, avg %lld us max %lld us, "
+                "%lld us/frame\n",
+                stageNames[i], st.runs, st.shed, st.divisor,
+                (long long)(st.avg_ns / 1000), (long long)(st.max_ns / 1000),
+                (long long)(st.frame_cost_ns / 1000));
+        if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+            ALOGE("%s: write failed", __func__);
+            return;
+        }
+    }
+    uint32_t first = (stats.decisions > QCAMERA_LOAD_LOG_SIZE) ?
+            stats.decisions - QCAMERA_LOAD_LOG_SIZE : 0;
+    for (uint32_t i = first; i < stats.decisions; i++) {
+        qcamera_load_decision_t &d = stats.log[i % QCAMERA_LOAD_LOG_SIZE];
+        len = snprintf(buf, sizeof(buf),
+                "    #%u at %lld ms: %s, level %u fps step %u, load %u%%\n",
+                i, (long long)(d.ts_ns / 1000000), reasonNames[d.reason],
+                d.level, d.fps_step, d.load_pct);
+        if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+            ALOGE("%s: write failed", __func__);
+            return;
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : dumpRecordingStats
+ *
+ * DESCRIPTION: write encoder hold times, starvation and video buffer
+ *              growth of the current or last recording to a file
+ *              descriptor
+ *
+ * PARAMETERS :
+ *   @fd      : file descriptor to write to
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::dumpRecordingStats(int fd)
 {
-    ALOGE("%s: not supported yet", __func__);
-    return INVALID_OPERATION;
+    char buf[320];
+    qcamera_rec_stats_t stats;
+
+    m_recMonitor.getStats(stats);
+    if (stats.sent == 0) {
+        return;
+    }
+
+    uint32_t n = (stats.returned > 0) ? stats.returned : 1;
+    int len = snprintf(buf, sizeof(buf),
+            "  recording: %s, sent %u returned %u cancelled %u unknown %u, "
+            "in flight %u peak %u, hold avg %lld us max %lld us\n"
+            "  recording starvation: %u times, %u frames, %lld ms; "
+            "video bufs %u/%u, grown %u in %u requests, %u failed\n",
+            m_recMonitor.isActive() ? "active" : "stopped",
+            stats.sent, stats.returned, stats.cancelled, stats.unknown,
+            stats.in_flight, stats.peak_in_flight,
+            (long long)(stats.hold_total_ns / n / 1000),
+            (long long)(stats.hold_max_ns / 1000),
+            stats.starvations, stats.starved_frames,
+            (long long)(stats.starved_ns / 1000000),
+            stats.active_bufs, stats.max_bufs, stats.grown,
+            stats.grow_requests, stats.grow_failures);
+    if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+        ALOGE("%s: write failed", __func__);
+    }
+}
+
+#ifdef TARGET_TS_MAKEUP
+/*===========================================================================
+ * FUNCTION   : dumpMakeupStats
+ *
+ * DESCRIPTION: write the makeup stage costs of the current preview session
+ *              to a file descriptor
+ *
+ * PARAMETERS :
+ *   @fd      : file descriptor to write to
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::dumpMakeupStats(int fd)
+{
+    char buf[512];
+    qcamera_makeup_stats_t stats;
+
+    m_makeup.getStats(stats);
+    uint32_t n = (stats.preview_frames > 0) ? stats.preview_frames : 1;
+    uint32_t s = (stats.snapshot_frames > 0) ? stats.snapshot_frames : 1;
+    uint32_t d = (stats.detected > 0) ? stats.detected : 1;
+    uint32_t q = (stats.queued > 0) ? stats.queued : 1;
+    int len = snprintf(buf, sizeof(buf),
+            "  makeup preview: %u frames skipped %u failed %u, "
+            "avg %lld us max %lld us, copy avg %lld us\n"
+            "  makeup snapshot: %u frames failed %u, avg %lld us max %lld us, "
+            "face seeded %u detected %u (avg %lld us)\n"
+            "  makeup worker: queued %u dropped %u, wait avg %lld max %lld us, "
+            "buffers %zu bytes\n",
+            stats.preview_frames, stats.preview_skipped, stats.preview_failed,
+            (long long)(stats.preview_total_ns / n / 1000),
+            (long long)(stats.preview_max_ns / 1000),
+            (long long)(stats.preview_copy_ns / n / 1000),
+            stats.snapshot_frames, stats.snapshot_failed,
+            (long long)(stats.snapshot_total_ns / s / 1000),
+            (long long)(stats.snapshot_max_ns / 1000),
+            stats.seeded, stats.detected,
+            (long long)(stats.detect_total_ns / d / 1000),
+            stats.queued, stats.dropped,
+            (long long)(stats.queue_wait_total_ns / q / 1000),
+            (long long)(stats.queue_wait_max_ns / 1000),
+            stats.buffer_bytes);
+    if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+        ALOGE("%s: write failed", __func__);
+    }
 }
+#endif
 
 /*===========================================================================
  * FUNCTION   : processAPI
@@ -4761,6 +5577,13 @@ int32_t QCamera2HardwareInterface::addVideoChannel()
         return rc;
     }
 
+    uint8_t reserved = getVideoReservedBufs();
+    QCameraStream *pStream = pChannel->getVideoStream();
+    if ((reserved > 0) && (pStream != NULL) &&
+            (pStream->setReservedBufs(reserved) != NO_ERROR)) {
+        ALOGE("%s: cannot reserve %d video buffers", __func__, reserved);
+    }
+
     m_channels[QCAMERA_CH_TYPE_VIDEO] = pChannel;
     return rc;
 }
@@ -5518,6 +6341,10 @@ int32_t QCamera2HardwareInterface::preparePreview()
     ATRACE_CALL();
     int32_t rc = NO_ERROR;
 
+    // let the metadata buffers preloaded at open land in the pool first
+    waitDefferedWork(mPoolWarmUpJob);
+    mPoolWarmUpJob = -1;
+
     if (mParameters.isZSLMode() && mParameters.getRecordingHintValue() !=true) {
         rc = addChannel(QCAMERA_CH_TYPE_ZSL);
         if (rc != NO_ERROR) {
@@ -5683,6 +6510,14 @@ int32_t QCamera2HardwareInterface::processFaceDetectionResult(cam_face_detection
         return NO_ERROR;
     }
 
+    int64_t fdStart = 0;
+    if (fd_type == QCAMERA_FD_PREVIEW) {
+        if (!m_loadGovernor.admit(QCAMERA_LOAD_STAGE_FD_CB)) {
+            return NO_ERROR;
+        }
+        fdStart = m_loadGovernor.begin();
+    }
+
     cam_dimension_t display_dim;
     mParameters.getStreamDimension(CAM_STREAM_TYPE_PREVIEW, display_dim);
     if (display_dim.width <= 0 || display_dim.height <= 0) {
@@ -5804,10 +6639,9 @@ int32_t QCamera2HardwareInterface::processFaceDetectionResult(cam_face_detection
             faces[i].mouth[1] =
                 MAP_TO_DRIVER_COORDINATE(fd_data->faces[i].mouth_center.y, display_dim.height, 2000, -1000);
 #ifdef TARGET_TS_MAKEUP
-            mFaceRect.left = fd_data->faces[i].face_boundary.left;
-            mFaceRect.top = fd_data->faces[i].face_boundary.top;
-            mFaceRect.right = fd_data->faces[i].face_boundary.width+mFaceRect.left;
-            mFaceRect.bottom = fd_data->faces[i].face_boundary.height+mFaceRect.top;
+            if (fd_type == QCAMERA_FD_PREVIEW) {
+                m_makeup.setFaceTrack(fd_data->faces[i].face_boundary, display_dim);
+            }
 #endif
             faces[i].smile_degree = fd_data->faces[i].smile_degree;
             faces[i].smile_score = fd_data->faces[i].smile_confidence;
@@ -5829,7 +6663,9 @@ int32_t QCamera2HardwareInterface::processFaceDetectionResult(cam_face_detection
     }
     else{
 #ifdef TARGET_TS_MAKEUP
-        memset(&mFaceRect,-1,sizeof(mFaceRect));
+        if (fd_type == QCAMERA_FD_PREVIEW) {
+            m_makeup.clearFaceTrack();
+        }
 #endif
     }
     qcamera_callback_argm_t cbArg;
@@ -5850,6 +6686,9 @@ int32_t QCamera2HardwareInterface::processFaceDetectionResult(cam_face_detection
         ALOGE("%s: fail sending notification", __func__);
         faceResultBuffer->release(faceResultBuffer);
     }
+    if (fd_type == QCAMERA_FD_PREVIEW) {
+        m_loadGovernor.end(QCAMERA_LOAD_STAGE_FD_CB, fdStart);
+    }
 
     return rc;
 }
@@ -6132,7 +6971,8 @@ int QCamera2HardwareInterface::recalcFPSRange(int &minFPS, int &maxFPS,
 /*===========================================================================
  * FUNCTION   : updateThermalLevel
  *
- * DESCRIPTION: update thermal level depending on thermal events
+ * DESCRIPTION: update thermal level depending on thermal events. The
+ *              level applied is combined with the load governor's step.
  *
  * PARAMETERS :
  *   @level   : thermal level
@@ -6159,6 +6999,10 @@ int QCamera2HardwareInterface::updateThermalLevel(
 
     mParameters.getPreviewFpsRange(&minFPS, &maxFPS);
     qcamera_thermal_mode thermalMode = mParameters.getThermalMode();
+    // the thermal level always applies, the load governor may only ask
+    // for a lower rate of its own on top
+    mThermalRequest = level;
+    level = (qcamera_thermal_level_enum_t)m_loadGovernor.setThermalStep(level);
     calcThermalLevel(level, minFPS, maxFPS, adjustedRange, skipPattern);
     mThermalLevel = level;
 
@@ -6175,6 +7019,23 @@ int QCamera2HardwareInterface::updateThermalLevel(
 
 }
 
+/*===========================================================================
+ * FUNCTION   : updateLoadLevel
+ *
+ * DESCRIPTION: apply the fps step the load governor asked for, together
+ *              with the last thermal level
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int QCamera2HardwareInterface::updateLoadLevel()
+{
+    return updateThermalLevel(mThermalRequest);
+}
+
 /*===========================================================================
  * FUNCTION   : updateParameters
  *
@@ -6195,6 +7056,12 @@ int QCamera2HardwareInterface::updateParameters(const char *parms, bool &needRes
     String8 str = String8(parms);
     QCameraParameters param(str);
     rc =  mParameters.updateParameters(param, needRestart);
+#ifdef TARGET_TS_MAKEUP
+    // frames use these cached levels instead of taking m_parm_lock
+    m_makeup.setParams(mParameters.get(QCameraParameters::KEY_TS_MAKEUP),
+            mParameters.getInt(QCameraParameters::KEY_TS_MAKEUP_WHITEN),
+            mParameters.getInt(QCameraParameters::KEY_TS_MAKEUP_CLEAN));
+#endif
 
     // update stream based parameter settings
     for (int i = 0; i < QCAMERA_CH_TYPE_MAX; i++) {
@@ -6627,6 +7494,24 @@ uint32_t QCamera2HardwareInterface::getJpegQuality()
     return quality;
 }
 
+/*===========================================================================
+ * FUNCTION   : getJpegThumbnailQuality
+ *
+ * DESCRIPTION: get user set jpeg thumbnail quality
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : jpeg thumbnail quality setting
+ *==========================================================================*/
+uint32_t QCamera2HardwareInterface::getJpegThumbnailQuality()
+{
+    uint32_t quality = 0;
+    pthread_mutex_lock(&m_parm_lock);
+    quality =  mParameters.getJpegThumbnailQuality();
+    pthread_mutex_unlock(&m_parm_lock);
+    return quality;
+}
+
 /*===========================================================================
  * FUNCTION   : getJpegRotation
  *
@@ -7068,6 +7953,65 @@ void *QCamera2HardwareInterface::defferedWorkRoutine(void *obj)
 
                     }
                     break;
+                case CMD_DEFF_POOL_WARMUP:
+                    {
+                        bool cancelled;
+                        {
+                            Mutex::Autolock l(pme->mDeffLock);
+                            cancelled = pme->mPoolWarmUpCancel;
+                        }
+                        if (!cancelled) {
+                            pme->m_memoryPool.preload(dw->args.poolArgs.heap_id,
+                                    dw->args.poolArgs.size,
+                                    dw->args.poolArgs.cached,
+                                    dw->args.poolArgs.count);
+                        }
+                        {
+                            Mutex::Autolock l(pme->mDeffLock);
+                            pme->mDeffOngoingJobs[dw->id] = false;
+                            delete dw;
+                            pme->mDeffCond.signal();
+                        }
+                    }
+                    break;
+                case CMD_DEFF_PARAM_INIT:
+                    {
+                        if (pme->mParameters.init(gCamCapability[pme->mCameraId],
+                                pme->mCameraHandle, pme, pme) != NO_ERROR) {
+                            ALOGE("%s: parameter init failed", __func__);
+                        }
+                        {
+                            Mutex::Autolock l(pme->mDeffLock);
+                            pme->mDeffOngoingJobs[dw->id] = false;
+                            delete dw;
+                            pme->mDeffCond.broadcast();
+                        }
+                    }
+                    break;
+                case CMD_DEFF_THERMAL_INIT:
+                    {
+                        if (pme->m_thermalAdapter.init(pme) != 0) {
+                            ALOGE("%s: Init thermal adapter failed", __func__);
+                        }
+                        {
+                            Mutex::Autolock l(pme->mDeffLock);
+                            pme->mDeffOngoingJobs[dw->id] = false;
+                            delete dw;
+                            pme->mDeffCond.broadcast();
+                        }
+                    }
+                    break;
+                case CMD_DEFF_GROW_VIDEO_BUFF:
+                    {
+                        pme->growVideoBufs(dw->args.growArgs);
+                        {
+                            Mutex::Autolock l(pme->mDeffLock);
+                            pme->mDeffOngoingJobs[dw->id] = false;
+                            delete dw;
+                            pme->mDeffCond.broadcast();
+                        }
+                    }
+                    break;
                 case CMD_DEFF_PPROC_START:
                     {
                         QCameraChannel * pChannel = dw->args.pprocArgs;
@@ -35,9 +35,11 @@
 #include <utils/Log.h>
 #include <utils/Mutex.h>
 #include <utils/Condition.h>
+#include <utils/Timers.h>
 #include <QCameraParameters.h>
 
 #include "QCameraQueue.h"
+#include "QCameraBoundedQueue.h"
 #include "QCameraCmdThread.h"
 #include "QCameraChannel.h"
 #include "QCameraStream.h"
@@ -46,10 +48,13 @@
 #include "QCameraPostProc.h"
 #include "QCameraThermalAdapter.h"
 #include "QCameraMem.h"
+#include "QCameraDumpWriter.h"
+#include "QCameraBurstScheduler.h"
+#include "QCameraLoadGovernor.h"
+#include "QCameraRecordingMonitor.h"
 #include "cam_intf.h"
 #ifdef TARGET_TS_MAKEUP
-#include "ts_makeup_engine.h"
-#include "ts_detectface_engine.h"
+#include "QCameraMakeup.h"
 #endif
 extern "C" {
 #include <mm_camera_interface.h>
@@ -122,6 +127,7 @@ typedef struct {
 #define QCAMERA_DUMP_FRM_THUMBNAIL  (1<<3)
 #define QCAMERA_DUMP_FRM_RAW        (1<<4)
 #define QCAMERA_DUMP_FRM_JPEG       (1<<5)
+#define QCAMERA_DUMP_FRM_METADATA   (1<<6) // dump container record type only
 
 #define QCAMERA_DUMP_FRM_MASK_ALL    0x000000ff
 
@@ -181,7 +187,13 @@ public:
                           mCallbackCookie (NULL),
                           mParent (parent),
                           mDataQ(releaseNotifications, this),
-                          mActive(false){}
+                          mActive(false),
+                          mPreviewQ(MAX_PREVIEW_CB_BACKLOG, false,
+                                  releasePreviewNotifications, this)
+    {
+        pthread_mutex_init(&mPreviewStatsLock, NULL);
+        resetPreviewStats();
+    }
 
     virtual ~QCameraCbNotifier();
 
@@ -193,10 +205,24 @@ public:
     virtual int32_t startSnapshots();
     virtual void stopSnapshots();
     virtual void exit();
+    virtual int32_t notifyPreviewCallback(qcamera_callback_argm_t &cbArgs);
+    virtual void flushPreviewCallbacks();
+    void dumpPreviewStats(int fd);
     static void * cbNotifyRoutine(void * data);
+    static void * previewNotifyRoutine(void * data);
     static void releaseNotifications(void *data, void *user_data);
+    static void releasePreviewNotifications(void *data, void *user_data);
     static bool matchSnapshotNotifications(void *data, void *user_data);
 private:
+    // preview frames waiting for the app, oldest is dropped when full
+    static const uint32_t MAX_PREVIEW_CB_BACKLOG = 2;
+
+    typedef struct {
+        qcamera_callback_argm_t cb;
+        nsecs_t queued;         // time the frame entered the backlog
+    } qcamera_preview_cb_node_t;
+
+    void resetPreviewStats();
 
     camera_notify_callback         mNotifyCb;
     camera_data_callback           mDataCb;
@@ -207,6 +233,16 @@ private:
     QCameraQueue     mDataQ;
     QCameraCmdThread mProcTh;
     bool             mActive;
+
+    QCameraBoundedQueue mPreviewQ;
+    QCameraCmdThread    mPreviewTh;
+    pthread_mutex_t     mPreviewStatsLock;
+    uint32_t            mPreviewDelivered;
+    uint32_t            mPreviewDropped;
+    nsecs_t             mPreviewWaitTotal;  // backlog wait, queued to dispatch
+    nsecs_t             mPreviewWaitMax;
+    nsecs_t             mPreviewCbTotal;    // time spent in the app callback
+    nsecs_t             mPreviewCbMax;
 };
 
 class QCamera2HardwareInterface : public QCameraAllocator,
@@ -318,16 +354,32 @@ private:
     int sendCommand(int32_t cmd, int32_t &arg1, int32_t &arg2);
     int release();
     int dump(int fd);
+    void dumpLoadStats(int fd);
+    void dumpRecordingStats(int fd);
     int registerFaceImage(void *img_ptr,
                           cam_pp_offline_src_config_t *config,
                           int32_t &faceID);
     int32_t longShot();
+    int32_t queueLongShot(uint8_t numSnapshots);
+    void startBurst(QCameraChannel *pChannel);
+    void stopBurst();
+    void startLoadGovernor();
+    void startRecordingMonitor();
+    uint8_t getVideoReservedBufs();
+    void requestVideoGrow(uint32_t count);
+    void growVideoBufs(uint8_t count);
+#ifdef TARGET_TS_MAKEUP
+    void startMakeup();
+    void dumpMakeupStats(int fd);
+#endif
 
     int openCamera();
     int closeCamera();
 
     int processAPI(qcamera_sm_evt_enum_t api, void *api_payload);
     int processEvt(qcamera_sm_evt_enum_t evt, void *evt_payload);
+    int32_t postMetadataEvt(qcamera_sm_metadata_evt_payload_t *meta,
+            qcamera_internal_evt_type_t type, const void *data, size_t size);
     int processSyncEvt(qcamera_sm_evt_enum_t evt, void *evt_payload);
     void lockAPI();
     void waitAPIResult(qcamera_sm_evt_enum_t api_evt, qcamera_api_result_t *apiResult);
@@ -339,6 +391,7 @@ private:
             const int minFPSi, const int maxFPSi, cam_fps_range_t &adjustedRange,
             enum msm_vfe_frame_skip_pattern &skipPattern);
     int updateThermalLevel(qcamera_thermal_level_enum_t level);
+    int updateLoadLevel();
 
     // update entris to set parameters and check if restart is needed
     int updateParameters(const char *parms, bool &needRestart);
@@ -365,10 +418,13 @@ private:
             mm_camera_buf_def_t *frame, uint32_t dump_type);
     void dumpMetadataToFile(QCameraStream *stream,
                             mm_camera_buf_def_t *frame,char *type);
+    bool dumpToWriter(uint32_t type, uint32_t frameIdx, const char *name,
+            const qcamera_dump_seg_t *segs, uint32_t count);
     void releaseSuperBuf(mm_camera_super_buf_t *super_buf);
     void playShutter();
     void getThumbnailSize(cam_dimension_t &dim);
     uint32_t getJpegQuality();
+    uint32_t getJpegThumbnailQuality();
     uint32_t getJpegRotation();
     void getOrientation();
     inline int getFlash(){ return mFlash; }
@@ -442,6 +498,9 @@ private:
     };
     bool isLongshotEnabled() { return mLongshotEnabled; };
     uint8_t getBufNumRequired(cam_stream_type_t stream_type);
+    void warmUpMemoryPool();
+    void cancelMemoryPoolWarmUp();
+    void warmUpMetadataPool();
     bool needFDMetadata(qcamera_ch_type_enum_t channel_type);
     bool removeSizeFromList(cam_dimension_t* size_list, size_t length,
             cam_dimension_t size);
@@ -462,6 +521,8 @@ private:
     inline void setInputImageCount(uint32_t aCount) {mInputCount = aCount;}
     bool processMTFDumps(qcamera_jpeg_evt_payload_t *evt);
     void captureDone();
+    static int32_t burstRequest(uint8_t count, void *user_data);
+    static void loadFpsRequest(uint32_t step, void *user_data);
     static void copyList(cam_dimension_t* src_list, cam_dimension_t* dst_list,
             size_t len);
     static void camEvtHandle(uint32_t camera_handle,
@@ -489,6 +550,14 @@ private:
     static void preview_stream_cb_routine(mm_camera_super_buf_t *frame,
                                           QCameraStream *stream,
                                           void *userdata);
+    void displayPreviewFrame(mm_camera_super_buf_t *super_frame,
+                             QCameraStream *stream);
+#ifdef TARGET_TS_MAKEUP
+    static void makeup_preview_routine(mm_camera_super_buf_t *super_frame,
+                                       QCameraStream *stream,
+                                       void *userdata);
+    void makeupPreviewFrame(mm_camera_buf_def_t *frame, QCameraStream *stream);
+#endif
     static void postview_stream_cb_routine(mm_camera_super_buf_t *frame,
                                            QCameraStream *stream,
                                            void *userdata);
@@ -546,6 +615,7 @@ private:
     pthread_cond_t m_cond;
     api_result_list *m_apiResultList;
     QCameraMemoryPool m_memoryPool;
+    QCameraCallbackMemPool m_cbMemPool; // preview callback buffers
 
     pthread_mutex_t m_evtLock;
     pthread_cond_t m_evtCond;
@@ -570,8 +640,13 @@ private:
 
     uint32_t mDumpFrmCnt;  // frame dump count
     uint32_t mDumpSkipCnt; // frame skip count
+    QCameraDumpWriter m_dumpWriter; // async frame dumps, persist.camera.dump.*
+    QCameraBurstScheduler m_burstScheduler; // longshot flow control
+    QCameraLoadGovernor m_loadGovernor; // sheds optional preview work under load
+    QCameraRecordingMonitor m_recMonitor; // encoder hold times, video buffer growth
     mm_jpeg_exif_params_t mExifParams;
-    qcamera_thermal_level_enum_t mThermalLevel;
+    qcamera_thermal_level_enum_t mThermalLevel;   // level applied to the fps range
+    qcamera_thermal_level_enum_t mThermalRequest; // level from the thermal engine
     bool mCancelAutoFocus;
     bool mActiveAF;
     bool m_HDRSceneEnabled;
@@ -601,6 +676,10 @@ private:
     enum DefferedWorkCmd {
         CMD_DEFF_ALLOCATE_BUFF,
         CMD_DEFF_PPROC_START,
+        CMD_DEFF_POOL_WARMUP,
+        CMD_DEFF_PARAM_INIT,
+        CMD_DEFF_THERMAL_INIT,
+        CMD_DEFF_GROW_VIDEO_BUFF,
         CMD_DEFF_MAX
     };
 
@@ -609,9 +688,18 @@ private:
         cam_stream_type_t type;
     } DefferAllocBuffArgs;
 
+    typedef struct {
+        unsigned int heap_id;
+        size_t size;
+        bool cached;
+        int count;
+    } DefferPoolWarmupArgs;
+
     typedef union {
         DefferAllocBuffArgs allocArgs;
         QCameraChannel *pprocArgs;
+        DefferPoolWarmupArgs poolArgs;
+        uint8_t growArgs;
     } DefferWorkArgs;
 
     bool mDeffOngoingJobs[MAX_ONGOING_JOBS];
@@ -646,6 +734,10 @@ private:
     int32_t mMetadataJob;
     int32_t mReprocJob;
     int32_t mRawdataJob;
+    int32_t mParamInitJob;
+    int32_t mThermalJob;
+    int32_t mPoolWarmUpJob;
+    bool mPoolWarmUpCancel;
     uint32_t mOutputCount;
     uint32_t mInputCount;
     bool mPreviewFrameSkipValid;
@@ -655,13 +747,7 @@ private:
     bool mFPSReconfigure;
    //ts add for makeup
 #ifdef TARGET_TS_MAKEUP
-    TSRect mFaceRect;
-    unsigned char *mMakeUpBuf;
-    int yuvDataRelocate(uint8_t* pSrcBuffer,uint8_t* pDstBuffer,cam_frame_len_offset_t offset);
-    int yuvDataRecover(uint8_t* pSrcBuffer,uint8_t* pDstBuffer,cam_frame_len_offset_t offset);
-    bool TsMakeupProcess_Preview(mm_camera_buf_def_t *pFrame,QCameraStream * pStream);
-    bool TsMakeupProcess_Snapshot(mm_camera_buf_def_t *pFrame,QCameraStream * pStream);
-    bool TsMakeupProcess(mm_camera_buf_def_t *frame,QCameraStream * stream,unsigned char *makeupOutBuf,TSRect& faceRect);
+    QCameraMakeup m_makeup; // skin beauty on preview and snapshot frames
 #endif
 };
 
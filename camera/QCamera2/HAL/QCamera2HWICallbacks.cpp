@@ -37,6 +37,7 @@
 #include <utils/Trace.h>
 #include <utils/Timers.h>
 #include "QCamera2HWI.h"
+#include "QCameraPlaneOps.h"
 
 namespace qcamera {
 
@@ -77,6 +78,8 @@ void QCamera2HardwareInterface::zsl_channel_cb(mm_camera_super_buf_t *recvd_fram
     if (pChannel == NULL ||
         pChannel->getMyHandle() != recvd_frame->ch_id) {
         ALOGE("%s: ZSL channel doesn't exist, return here", __func__);
+        // the longshot frame is lost, free its slot
+        pme->m_burstScheduler.shotDone(false);
         return;
     }
 
@@ -89,6 +92,7 @@ void QCamera2HardwareInterface::zsl_channel_cb(mm_camera_super_buf_t *recvd_fram
     if (frame == NULL) {
         ALOGE("%s: Error allocating memory to save received_frame structure.", __func__);
         pChannel->bufDone(recvd_frame);
+        pme->m_burstScheduler.shotDone(false);
         return;
     }
     *frame = *recvd_frame;
@@ -156,21 +160,8 @@ void QCamera2HardwareInterface::zsl_channel_cb(mm_camera_super_buf_t *recvd_fram
                     __func__, pMetaData->faces_data.num_faces_detected);
             }
 
-            qcamera_sm_internal_evt_payload_t *payload =
-                (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-            if (NULL != payload) {
-                memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-                payload->evt_type = QCAMERA_INTERNAL_EVT_FACE_DETECT_RESULT;
-                payload->faces_data = pMetaData->faces_data;
-                int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-                if (rc != NO_ERROR) {
-                    ALOGE("%s: processEvt prep_snapshot failed", __func__);
-                    free(payload);
-                    payload = NULL;
-                }
-            } else {
-                ALOGE("%s: No memory for prep_snapshot qcamera_sm_internal_evt_payload_t", __func__);
-            }
+            pme->postMetadataEvt(NULL, QCAMERA_INTERNAL_EVT_FACE_DETECT_RESULT,
+                    &pMetaData->faces_data, sizeof(pMetaData->faces_data));
         }
     }
 
@@ -348,210 +339,7 @@ void QCamera2HardwareInterface::capture_channel_cb_routine(mm_camera_super_buf_t
 
     CDBG_HIGH("[KPI Perf] %s: X", __func__);
 }
-#ifdef TARGET_TS_MAKEUP
-int QCamera2HardwareInterface::yuvDataRelocate(uint8_t* pSrcBuffer,uint8_t* pDstBuffer,
-        cam_frame_len_offset_t offset) {
-    if (pSrcBuffer == NULL || pDstBuffer == NULL) {
-        CDBG_HIGH(" buf is null so return\n");
-        return -1;
-    }
-
-    void *data = NULL;
-    uint32_t offset_w = 0;
-    int32_t buf_h =0;
-
-    for (uint i = 0; i < (uint)offset.num_planes; i++) {
-        uint32_t index = offset.mp[i].offset;
-        buf_h = offset.mp[i].height;
-        if (i > 0) {
-            index += offset.mp[i-1].len;
-            buf_h = offset.mp[i-1].height / 2;//sometimes uv'h equal to y'h
-        }
-        for (int j = 0; j < buf_h; j++) {
-            data = (void *)((uint8_t *)pSrcBuffer + index);
-            memcpy(pDstBuffer + offset_w, data, offset.mp[i].width);
-            offset_w += offset.mp[i].width;
-            index += offset.mp[i].stride;
-        }
-    }
-    return 0;
-}
-
-int QCamera2HardwareInterface::yuvDataRecover(uint8_t* pSrcBuffer,uint8_t* pDstBuffer,
-        cam_frame_len_offset_t offset) {
-    if (pSrcBuffer == NULL || pDstBuffer == NULL) {
-        CDBG_HIGH(" buf is null so return\n");
-        return -1;
-    }
-
-    void *data = NULL;
-    uint32_t offset_w = 0;
-    int32_t buf_h =0;
-
-    for (uint i = 0; i < (uint)offset.num_planes; i++) {
-        uint32_t index = offset.mp[i].offset;
-        buf_h = offset.mp[i].height;
-        if (i > 0) {
-            index += offset.mp[i-1].len;
-            buf_h = offset.mp[i-1].height / 2;//sometimes uv'h equal to y'h
-        }
-
-        for (int j = 0; j < buf_h; j++) {
-            data = (void *)((uint8_t *)pSrcBuffer + offset_w);
-            memcpy((uint8_t *)pDstBuffer + index, data, offset.mp[i].width);
-            offset_w += offset.mp[i].width;
-            index += offset.mp[i].stride;
-        }
-    }
-    return 0;
-}
-
-bool isNeedDelPadding(cam_frame_len_offset_t offset, int32_t width) {
-    int32_t nLen = offset.mp[0].len;
-    return (offset.mp[0].stride != width || offset.mp[0].stride*offset.mp[0].height != nLen);
-}
-
-bool QCamera2HardwareInterface::TsMakeupProcess_Preview(mm_camera_buf_def_t *pFrame,
-        QCameraStream * pStream) {
-    CDBG("%s begin",__func__);
-    bool bRet = false;
-    if (pStream == NULL || pFrame == NULL) {
-        bRet = false;
-        CDBG_HIGH("%s pStream == NULL || pFrame == NULL",__func__);
-    } else {
-        bRet = TsMakeupProcess(pFrame,pStream,mMakeUpBuf,mFaceRect);
-    }
-    CDBG("%s end bRet = %d ",__func__,bRet);
-    return bRet;
-}
 
-bool QCamera2HardwareInterface::TsMakeupProcess_Snapshot(mm_camera_buf_def_t *pFrame,
-        QCameraStream * pStream) {
-    CDBG("%s begin",__func__);
-    bool bRet = false;
-    if (pStream == NULL || pFrame == NULL) {
-        bRet = false;
-        CDBG_HIGH("%s pStream == NULL || pFrame == NULL",__func__);
-    } else {
-        cam_frame_len_offset_t offset;
-        memset(&offset, 0, sizeof(cam_frame_len_offset_t));
-        pStream->getFrameOffset(offset);
-
-        cam_dimension_t dim;
-        pStream->getFrameDimension(dim);
-        int tempBufLen = offset.mp[0].width * offset.mp[0].height * 3 /2;
-        unsigned char* tempBuf = new unsigned char[tempBufLen];
-        memset(tempBuf,0,tempBufLen);
-        yuvDataRelocate((unsigned char*)(pFrame->buffer),tempBuf,offset);
-
-        unsigned char *yBuf  = tempBuf;
-        unsigned char *uvBuf = tempBuf + dim.width*dim.height;
-        TSMakeupData inMakeupData;
-        inMakeupData.frameWidth  = dim.width;
-        inMakeupData.frameHeight = dim.height;
-        inMakeupData.yBuf  = yBuf;
-        inMakeupData.uvBuf = uvBuf;
-        CDBG("%s detect begin",__func__);
-        TSHandle fd_handle = ts_detectface_create_context();
-        if (fd_handle != NULL) {
-            cam_format_t fmt;
-            pStream->getFormat(fmt);
-            int iret = ts_detectface_detect(fd_handle, &inMakeupData);
-            CDBG("%s ts_detectface_detect iret = %d",__func__,iret);
-            if (iret <= 0) {
-                bRet = false;
-            } else {
-                TSRect faceRect;
-                memset(&faceRect,-1,sizeof(TSRect));
-                iret = ts_detectface_get_face_info(fd_handle, 0, &faceRect, NULL,NULL,NULL);
-                CDBG("%s ts_detectface_get_face_info iret=%d,faceRect.left=%ld,"
-                        "faceRect.top=%ld,faceRect.right=%ld,faceRect.bottom=%ld"
-                        ,__func__,iret,faceRect.left,faceRect.top,faceRect.right,faceRect.bottom);
-                bRet = TsMakeupProcess(pFrame,pStream,tempBuf,faceRect);
-            }
-            ts_detectface_destroy_context(&fd_handle);
-            fd_handle = NULL;
-        } else {
-            CDBG_HIGH("%s fd_handle == NULL",__func__);
-        }
-        if(tempBuf != NULL){
-            delete[] tempBuf;
-            tempBuf = NULL;
-        }
-        CDBG("%s detect end",__func__);
-    }
-    CDBG("%s end bRet = %d ",__func__,bRet);
-    return bRet;
-}
-
-bool QCamera2HardwareInterface::TsMakeupProcess(mm_camera_buf_def_t *pFrame,
-        QCameraStream * pStream,unsigned char *pMakeupOutBuf,TSRect& faceRect) {
-    bool bRet = false;
-    CDBG("%s begin",__func__);
-    if (pStream == NULL || pFrame == NULL || pMakeupOutBuf == NULL) {
-        bRet = false;
-        CDBG_HIGH("%s pStream == NULL || pFrame == NULL || pMakeupOutBuf == NULL",__func__);
-    }
-    pthread_mutex_lock(&m_parm_lock);
-    const char* pch_makeup_enable = mParameters.get(QCameraParameters::KEY_TS_MAKEUP);
-    pthread_mutex_unlock(&m_parm_lock);
-    if (pch_makeup_enable == NULL) {
-        CDBG_HIGH("%s pch_makeup_enable = null",__func__);
-        return bRet = false;
-    }
-    bool enableMakeUp = (strcmp(pch_makeup_enable,"On") == 0)&& faceRect.left > -1 ;
-    CDBG("%s pch_makeup_enable = %s ",__func__,pch_makeup_enable);
-    if (enableMakeUp) {
-        cam_dimension_t dim;
-        cam_frame_len_offset_t offset;
-        pStream->getFrameDimension(dim);
-        pStream->getFrameOffset(offset);
-        pthread_mutex_lock(&m_parm_lock);
-        int whiteLevel = mParameters.getInt(QCameraParameters::KEY_TS_MAKEUP_WHITEN),
-                cleanLevel = mParameters.getInt(QCameraParameters::KEY_TS_MAKEUP_CLEAN);
-        pthread_mutex_unlock(&(m_parm_lock));
-        unsigned char *tempOriBuf = NULL;
-
-        if (isNeedDelPadding(offset, dim.width)) {
-            tempOriBuf = new unsigned char[dim.width*dim.height * 3 /2];
-            yuvDataRelocate((unsigned char*)(pFrame->buffer),tempOriBuf,offset);
-        } else {
-            tempOriBuf = (unsigned char*)pFrame->buffer;
-        }
-        unsigned char *yBuf = tempOriBuf;
-        unsigned char *uvBuf = tempOriBuf + dim.width*dim.height;
-        unsigned char *tmpBuf = pMakeupOutBuf;
-        TSMakeupData inMakeupData, outMakeupData;
-        whiteLevel =  whiteLevel <= 0 ? 0 : (whiteLevel >= 100 ? 100 : whiteLevel);
-        cleanLevel =  cleanLevel <= 0 ? 0 : (cleanLevel >= 100 ? 100 : cleanLevel);
-        inMakeupData.frameWidth = dim.width;  // NV21 Frame width  > 0
-        inMakeupData.frameHeight = dim.height; // NV21 Frame height > 0
-        inMakeupData.yBuf =  yBuf; //  Y buffer pointer
-        inMakeupData.uvBuf = uvBuf; // VU buffer pointer
-
-        outMakeupData.frameWidth = dim.width; // NV21 Frame width  > 0
-        outMakeupData.frameHeight = dim.height; // NV21 Frame height > 0
-        outMakeupData.yBuf =  tmpBuf; //  Y buffer pointer
-        outMakeupData.uvBuf = tmpBuf+(dim.width*dim.height); // VU buffer pointer
-
-        CDBG("%s: faceRect:left 2:%ld,,right:%ld,,top:%ld,,bottom:%ld,,Level:%dx%d",
-            __func__,
-            faceRect.left,faceRect.right,faceRect.top,faceRect.bottom,cleanLevel,whiteLevel);
-        ts_makeup_skin_beauty(&inMakeupData, &outMakeupData, &(faceRect),cleanLevel,whiteLevel);
-        if (isNeedDelPadding(offset, dim.width)) {
-            yuvDataRecover(tmpBuf,(unsigned char*)pFrame->buffer,offset);
-            delete tempOriBuf;
-            tempOriBuf = NULL;
-        } else {
-            memcpy((unsigned char*)pFrame->buffer, tmpBuf, dim.width * dim.height * 3 / 2);
-        }
-        QCameraMemory *memory = (QCameraMemory *)pFrame->mem_info;
-        memory->cleanCache(pFrame->buf_idx);
-    }
-    CDBG("%s end bRet = %d ",__func__,bRet);
-    return bRet;
-}
-#endif
 /*===========================================================================
  * FUNCTION   : postproc_channel_cb_routine
  *
@@ -668,8 +456,10 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
                                                           void *userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG("[KPI Perf] %s : BEGIN", __func__);
-    int err = NO_ERROR;
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     QCameraGrallocMemory *memory = (QCameraGrallocMemory *)super_frame->bufs[0]->mem_info;
 
@@ -691,31 +481,107 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
         return;
     }
 #ifdef TARGET_TS_MAKEUP
-    pme->TsMakeupProcess_Preview(frame,stream);
+    // the makeup worker beautifies and displays the frame when running
+    if (pme->m_makeup.queuePreview(super_frame, stream)) {
+        return;
+    }
+    pme->makeupPreviewFrame(frame, stream);
 #endif
-    if (!pme->needProcessPreviewFrame()) {
+    pme->displayPreviewFrame(super_frame, stream);
+    CDBG("[KPI Perf] %s : END", __func__);
+}
+
+#ifdef TARGET_TS_MAKEUP
+/*===========================================================================
+ * FUNCTION   : makeup_preview_routine
+ *
+ * DESCRIPTION: makeup worker stage of the preview pipeline, beautifies and
+ *              displays a frame queued by preview_stream_cb_routine
+ *
+ * PARAMETERS :
+ *   @super_frame : received super buffer
+ *   @stream      : stream object
+ *   @userdata    : user data ptr
+ *
+ * RETURN    : None
+ *
+ * NOTE      : ownership of super_frame is passed on to displayPreviewFrame
+ *==========================================================================*/
+void QCamera2HardwareInterface::makeup_preview_routine(
+        mm_camera_super_buf_t *super_frame, QCameraStream *stream, void *userdata)
+{
+    QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
+
+    pme->makeupPreviewFrame(super_frame->bufs[0], stream);
+    pme->displayPreviewFrame(super_frame, stream);
+}
+
+/*===========================================================================
+ * FUNCTION   : makeupPreviewFrame
+ *
+ * DESCRIPTION: beautify a preview frame unless the load governor sheds it
+ *
+ * PARAMETERS :
+ *   @frame   : preview frame
+ *   @stream  : stream object
+ *
+ * RETURN    : None
+ *==========================================================================*/
+void QCamera2HardwareInterface::makeupPreviewFrame(mm_camera_buf_def_t *frame,
+        QCameraStream *stream)
+{
+    if (m_loadGovernor.admit(QCAMERA_LOAD_STAGE_MAKEUP)) {
+        int64_t start = m_loadGovernor.begin();
+        m_makeup.processPreview(frame, stream);
+        m_loadGovernor.end(QCAMERA_LOAD_STAGE_MAKEUP, start);
+    }
+}
+#endif
+
+/*===========================================================================
+ * FUNCTION   : displayPreviewFrame
+ *
+ * DESCRIPTION: display a preview frame, return the frame dequeued from
+ *              display to the stream and send the preview data callback
+ *
+ * PARAMETERS :
+ *   @super_frame : received super buffer
+ *   @stream      : stream object
+ *
+ * RETURN    : None
+ *
+ * NOTE      : takes ownership of super_frame and frees it
+ *==========================================================================*/
+void QCamera2HardwareInterface::displayPreviewFrame(mm_camera_super_buf_t *super_frame,
+                                                    QCameraStream *stream)
+{
+    int err = NO_ERROR;
+    mm_camera_buf_def_t *frame = super_frame->bufs[0];
+    QCameraGrallocMemory *memory = (QCameraGrallocMemory *)frame->mem_info;
+
+    if (!needProcessPreviewFrame()) {
         ALOGE("%s: preview is not running, no need to process", __func__);
         stream->bufDone(frame->buf_idx);
         free(super_frame);
         return;
     }
 
-    if (pme->needDebugFps()) {
-        pme->debugShowPreviewFPS();
+    if (needDebugFps()) {
+        debugShowPreviewFPS();
     }
 
     uint32_t idx = frame->buf_idx;
-    pme->dumpFrameToFile(stream, frame, QCAMERA_DUMP_FRM_PREVIEW);
+    dumpFrameToFile(stream, frame, QCAMERA_DUMP_FRM_PREVIEW);
 
-    if (pme->mPreviewFrameSkipValid) {
-        uint32_t min_frame_idx = pme->mPreviewFrameSkipIdxRange.min_frame_idx;
-        uint32_t max_frame_idx = pme->mPreviewFrameSkipIdxRange.max_frame_idx;
+    if (mPreviewFrameSkipValid) {
+        uint32_t min_frame_idx = mPreviewFrameSkipIdxRange.min_frame_idx;
+        uint32_t max_frame_idx = mPreviewFrameSkipIdxRange.max_frame_idx;
         uint32_t current_frame_idx = frame->frame_idx;
         if (current_frame_idx >= max_frame_idx) {
             // Reset the flags when current frame ID >= max frame ID
-            pme->mPreviewFrameSkipValid = 0;
-            pme->mPreviewFrameSkipIdxRange.min_frame_idx = 0;
-            pme->mPreviewFrameSkipIdxRange.max_frame_idx = 0;
+            mPreviewFrameSkipValid = 0;
+            mPreviewFrameSkipIdxRange.min_frame_idx = 0;
+            mPreviewFrameSkipIdxRange.max_frame_idx = 0;
         }
         if (current_frame_idx >= min_frame_idx && current_frame_idx <= max_frame_idx) {
             CDBG_HIGH("%s: Skip Preview frame ID %d during flash", __func__, current_frame_idx);
@@ -725,13 +591,14 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
         }
     }
 
-    if(pme->m_bPreviewStarted) {
+    if(m_bPreviewStarted) {
        CDBG_HIGH("[KPI Perf] %s : PROFILE_FIRST_PREVIEW_FRAME", __func__);
-       pme->m_bPreviewStarted = false ;
+       m_bPreviewStarted = false ;
     }
 
     // Display the buffer.
-    CDBG("%p displayBuffer %d E", pme, idx);
+    CDBG("%p displayBuffer %d E", this, idx);
+    CAM_TRACE_BUF(CAM_TRACE_DELIVER, frame);
     int dequeuedIdx = memory->displayBuffer(idx);
     if (dequeuedIdx < 0 || dequeuedIdx >= memory->getCnt()) {
         CDBG_HIGH("%s: Invalid dequeued buffer index %d from display",
@@ -745,18 +612,19 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
     }
 
     // Handle preview data callback
-    if (pme->mDataCb != NULL &&
-            (pme->msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0)) {
-        int32_t rc = pme->sendPreviewCallback(stream, memory, idx);
+    if (mDataCb != NULL &&
+            (msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0) &&
+            m_loadGovernor.admit(QCAMERA_LOAD_STAGE_PREVIEW_CB)) {
+        int64_t start = m_loadGovernor.begin();
+        int32_t rc = sendPreviewCallback(stream, memory, idx);
         if (NO_ERROR != rc) {
             ALOGE("%s: Preview callback was not sent succesfully", __func__);
         }
-
+        m_loadGovernor.end(QCAMERA_LOAD_STAGE_PREVIEW_CB, start);
     }
 
+    m_loadGovernor.frameDone();
     free(super_frame);
-    CDBG("[KPI Perf] %s : END", __func__);
-    return;
 }
 
 /*===========================================================================
@@ -796,11 +664,8 @@ int32_t QCamera2HardwareInterface::sendPreviewCallback(QCameraStream *stream,
     int32_t uvStrideToApp = 0;
     int32_t yScanlineToApp = 0;
     int32_t uvScanlineToApp = 0;
-    int32_t srcOffset = 0;
-    int32_t dstOffset = 0;
     int32_t srcBaseOffset = 0;
     int32_t dstBaseOffset = 0;
-    int i;
 
     if ((NULL == stream) || (NULL == memory)) {
         ALOGE("%s: Invalid preview callback input", __func__);
@@ -852,10 +717,12 @@ int32_t QCamera2HardwareInterface::sendPreviewCallback(QCameraStream *stream,
             previewBufSizeFromCallback = (size_t)
                     ((yStride * yScanline) + (uvStride * uvScanline));
         }
+        // callback buffers come from m_cbMemPool, so mappings of the
+        // stream buffers and the copy buffers are set up once per session
         if(previewBufSize == previewBufSizeFromCallback) {
-            previewMem = mGetMemory(memory->getFd(idx),
-                       previewBufSize, 1, mCallbackCookie);
-            if (!previewMem || !previewMem->data) {
+            previewMem = m_cbMemPool.get(mGetMemory, mCallbackCookie,
+                    memory->getFd(idx), previewBufSize, previewFmt);
+            if (!previewMem) {
                 ALOGE("%s: mGetMemory failed.\n", __func__);
                 return NO_MEMORY;
             } else {
@@ -863,31 +730,23 @@ int32_t QCamera2HardwareInterface::sendPreviewCallback(QCameraStream *stream,
             }
         } else {
             data = memory->getMemory(idx, false);
-            dataToApp = mGetMemory(-1, previewBufSize, 1, mCallbackCookie);
-            if (!dataToApp || !dataToApp->data) {
+            dataToApp = m_cbMemPool.get(mGetMemory, mCallbackCookie,
+                    -1, previewBufSize, previewFmt);
+            if (!dataToApp) {
                 ALOGE("%s: mGetMemory failed.\n", __func__);
                 return NO_MEMORY;
             }
 
-            for (i = 0; i < preview_dim.height; i++) {
-                srcOffset = i * yStride;
-                dstOffset = i * yStrideToApp;
-
-                memcpy((unsigned char *) dataToApp->data + dstOffset,
-                        (unsigned char *) data->data + srcOffset, (size_t) yStrideToApp);
-            }
+            QCameraPlaneOps::copyPlane((uint8_t *)dataToApp->data, yStrideToApp,
+                    (const uint8_t *)data->data, yStride,
+                    yStrideToApp, preview_dim.height);
 
             srcBaseOffset = yStride * yScanline;
             dstBaseOffset = yStrideToApp * yScanlineToApp;
 
-            for (i = 0; i < preview_dim.height/2; i++) {
-                srcOffset = i * uvStride + srcBaseOffset;
-                dstOffset = i * uvStrideToApp + dstBaseOffset;
-
-                memcpy((unsigned char *) dataToApp->data + dstOffset,
-                        (unsigned char *) data->data + srcOffset,
-                        (size_t) yStrideToApp);
-            }
+            QCameraPlaneOps::copyPlane((uint8_t *)dataToApp->data + dstBaseOffset,
+                    uvStrideToApp, (const uint8_t *)data->data + srcBaseOffset,
+                    uvStride, yStrideToApp, preview_dim.height / 2);
         }
     } else {
         data = memory->getMemory(idx, false);
@@ -906,19 +765,19 @@ int32_t QCamera2HardwareInterface::sendPreviewCallback(QCameraStream *stream,
     }
     if ( previewMem ) {
         cbArg.user_data = previewMem;
-        cbArg.release_cb = releaseCameraMemory;
+        cbArg.release_cb = QCameraCallbackMemPool::releaseCallbackMem;
     } else if (dataToApp) {
         cbArg.user_data = dataToApp;
-        cbArg.release_cb = releaseCameraMemory;
+        cbArg.release_cb = QCameraCallbackMemPool::releaseCallbackMem;
     }
-    cbArg.cookie = this;
-    rc = m_cbNotifier.notifyCallback(cbArg);
+    cbArg.cookie = &m_cbMemPool;
+    rc = m_cbNotifier.notifyPreviewCallback(cbArg);
     if (rc != NO_ERROR) {
         ALOGE("%s: fail sending notification", __func__);
         if (previewMem) {
-            previewMem->release(previewMem);
+            m_cbMemPool.put(previewMem);
         } else if (dataToApp) {
-            dataToApp->release(dataToApp);
+            m_cbMemPool.put(dataToApp);
         }
     }
 
@@ -947,6 +806,9 @@ void QCamera2HardwareInterface::nodisplay_preview_stream_cb_routine(
                                                           void * userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG_HIGH("[KPI Perf] %s E",__func__);
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     if (pme == NULL ||
@@ -1003,7 +865,9 @@ void QCamera2HardwareInterface::nodisplay_preview_stream_cb_routine(
 
         if (pme->needProcessPreviewFrame() &&
             pme->mDataCb != NULL &&
-            pme->msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0 ) {
+            pme->msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0 &&
+            pme->m_loadGovernor.admit(QCAMERA_LOAD_STAGE_PREVIEW_CB)) {
+            int64_t start = pme->m_loadGovernor.begin();
             qcamera_callback_argm_t cbArg;
             memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
             cbArg.cb_type = QCAMERA_DATA_CALLBACK;
@@ -1012,15 +876,18 @@ void QCamera2HardwareInterface::nodisplay_preview_stream_cb_routine(
             cbArg.user_data = (void *) &frame->buf_idx;
             cbArg.cookie = stream;
             cbArg.release_cb = returnStreamBuffer;
-            int32_t rc = pme->m_cbNotifier.notifyCallback(cbArg);
+            CAM_TRACE_BUF(CAM_TRACE_DELIVER, frame);
+            int32_t rc = pme->m_cbNotifier.notifyPreviewCallback(cbArg);
             if (rc != NO_ERROR) {
                 ALOGE("%s: fail sending data notify", __func__);
                 stream->bufDone(frame->buf_idx);
             }
+            pme->m_loadGovernor.end(QCAMERA_LOAD_STAGE_PREVIEW_CB, start);
         } else {
             stream->bufDone(frame->buf_idx);
         }
     }
+    pme->m_loadGovernor.frameDone();
     free(super_frame);
     CDBG_HIGH("[KPI Perf] %s X",__func__);
 }
@@ -1045,6 +912,9 @@ void QCamera2HardwareInterface::postview_stream_cb_routine(mm_camera_super_buf_t
                                                            void *userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     int err = NO_ERROR;
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     QCameraGrallocMemory *memory = (QCameraGrallocMemory *)super_frame->bufs[0]->mem_info;
@@ -1108,6 +978,9 @@ void QCamera2HardwareInterface::video_stream_cb_routine(mm_camera_super_buf_t *s
                                                         void *userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG("[KPI Perf] %s : BEGIN", __func__);
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     if (pme == NULL ||
@@ -1150,11 +1023,18 @@ void QCamera2HardwareInterface::video_stream_cb_routine(mm_camera_super_buf_t *s
             cbArg.msg_type = CAMERA_MSG_VIDEO_FRAME;
             cbArg.data = video_mem;
             cbArg.timestamp = timeStamp;
+            CAM_TRACE_BUF(CAM_TRACE_DELIVER, frame);
+            // accounted first, the encoder may return it right away
+            uint32_t grow = pme->m_recMonitor.sent(frame->buf_idx);
             int32_t rc = pme->m_cbNotifier.notifyCallback(cbArg);
             if (rc != NO_ERROR) {
                 ALOGE("%s: fail sending data notify", __func__);
+                pme->m_recMonitor.cancel(frame->buf_idx);
                 stream->bufDone(frame->buf_idx);
             }
+            if (grow > 0) {
+                pme->requestVideoGrow(grow);
+            }
         }
     }
     free(super_frame);
@@ -1272,6 +1152,9 @@ void QCamera2HardwareInterface::raw_stream_cb_routine(mm_camera_super_buf_t * su
                                                       void * userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG_HIGH("[KPI Perf] %s : BEGIN", __func__);
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     if (pme == NULL ||
@@ -1307,6 +1190,9 @@ void QCamera2HardwareInterface::preview_raw_stream_cb_routine(mm_camera_super_bu
                                                               void * userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG_HIGH("[KPI Perf] %s : BEGIN", __func__);
     char value[PROPERTY_VALUE_MAX];
     bool dump_raw = false;
@@ -1362,6 +1248,9 @@ void QCamera2HardwareInterface::snapshot_raw_stream_cb_routine(mm_camera_super_b
                                                                void * userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG_HIGH("[KPI Perf] %s : BEGIN", __func__);
     char value[PROPERTY_VALUE_MAX];
     bool dump_raw = false;
@@ -1397,6 +1286,83 @@ void QCamera2HardwareInterface::snapshot_raw_stream_cb_routine(mm_camera_super_b
     CDBG_HIGH("[KPI Perf] %s : END", __func__);
 }
 
+/*===========================================================================
+ * FUNCTION   : postMetadataEvt
+ *
+ * DESCRIPTION: hand one internal evt of a metadata frame to the state
+ *              machine, either as a section of the coalesced frame payload
+ *              or as its own QCAMERA_SM_EVT_EVT_INTERNAL.
+ *
+ * PARAMETERS :
+ *   @meta    : coalesced payload of the frame, NULL to post right away
+ *   @type    : internal evt type
+ *   @data    : evt data, of the type the evt carries
+ *   @size    : size of evt data
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::postMetadataEvt(
+        qcamera_sm_metadata_evt_payload_t *meta,
+        qcamera_internal_evt_type_t type, const void *data, size_t size)
+{
+    if (meta != NULL) {
+        void *section = NULL;
+        switch (type) {
+        case QCAMERA_INTERNAL_EVT_FOCUS_UPDATE:
+            section = &meta->focus_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_PREP_SNAPSHOT_DONE:
+            section = &meta->prep_snapshot_state;
+            break;
+        case QCAMERA_INTERNAL_EVT_FACE_DETECT_RESULT:
+            section = &meta->faces_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_HISTOGRAM_STATS:
+            section = &meta->stats_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_CROP_INFO:
+            section = &meta->crop_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_ASD_UPDATE:
+            section = &meta->asd_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_AWB_UPDATE:
+            section = &meta->awb_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_AE_UPDATE:
+            section = &meta->ae_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_FOCUS_POS_UPDATE:
+            section = &meta->focus_pos;
+            break;
+        default:
+            ALOGE("%s: Invalid internal event %d", __func__, type);
+            return BAD_VALUE;
+        }
+        memcpy(section, data, size);
+        meta->valid_mask |= QCAMERA_INTERNAL_EVT_BIT(type);
+        return NO_ERROR;
+    }
+
+    qcamera_sm_internal_evt_payload_t *payload =
+        m_stateMachine.getInternalEvtPayload();
+    if (NULL == payload) {
+        ALOGE("%s: No memory for internal event %d", __func__, type);
+        return NO_MEMORY;
+    }
+    payload->evt_type = type;
+    // all members of the payload union start at the same address
+    memcpy(&payload->focus_data, data, size);
+    int32_t rc = processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
+    if (rc != NO_ERROR) {
+        ALOGE("%s: processEvt internal event %d failed", __func__, type);
+        m_stateMachine.releaseEvtPayload(payload);
+    }
+    return rc;
+}
+
 /*===========================================================================
  * FUNCTION   : metadata_stream_cb_routine
  *
@@ -1419,6 +1385,9 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
                                                            void * userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG("[KPI Perf] %s : BEGIN", __func__);
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     if (pme == NULL ||
@@ -1430,8 +1399,20 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
         return;
     }
 
+    // retire longshot shots lost without a completion
+    pme->m_burstScheduler.checkTimeouts();
+
     mm_camera_buf_def_t *frame = super_frame->bufs[0];
     cam_metadata_info_t *pMetaData = (cam_metadata_info_t *)frame->buffer;
+    qcamera_sm_metadata_evt_payload_t *meta = NULL;
+    uint32_t num_evts = 0;
+    uint32_t num_posts = 0;
+
+    // one state machine evt for all sections of this frame, see
+    // persist.camera.meta.coalesce
+    if (pme->m_stateMachine.isMetadataCoalesced()) {
+        meta = pme->m_stateMachine.getMetadataEvtPayload();
+    }
 
     if (pMetaData->is_preview_frame_skip_valid) {
         pme->mPreviewFrameSkipValid = 1;
@@ -1456,63 +1437,28 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
                 CDBG_HIGH("[KPI Perf] %s: PROFILE_NUMBER_OF_FACES_DETECTED %d",__func__,
                            pMetaData->faces_data.num_faces_detected);
             pMetaData->faces_data.fd_type = QCAMERA_FD_PREVIEW; //HARD CODE here before MCT can support
-            qcamera_sm_internal_evt_payload_t *payload =
-                (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-            if (NULL != payload) {
-                memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-                payload->evt_type = QCAMERA_INTERNAL_EVT_FACE_DETECT_RESULT;
-                payload->faces_data = pMetaData->faces_data;
-                int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-                if (rc != NO_ERROR) {
-                    ALOGE("%s: processEvt face detection failed", __func__);
-                    free(payload);
-                    payload = NULL;
-
-                }
-            } else {
-                ALOGE("%s: No memory for face detect qcamera_sm_internal_evt_payload_t", __func__);
+            if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_FACE_DETECT_RESULT,
+                    &pMetaData->faces_data, sizeof(pMetaData->faces_data)) == NO_ERROR) {
+                num_evts++;
             }
         }
     }
 
     if (pMetaData->is_stats_valid) {
         // process histogram statistics info
-        qcamera_sm_internal_evt_payload_t *payload =
-            (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-        if (NULL != payload) {
-            memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-            payload->evt_type = QCAMERA_INTERNAL_EVT_HISTOGRAM_STATS;
-            payload->stats_data = pMetaData->stats_data;
-            int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-            if (rc != NO_ERROR) {
-                ALOGE("%s: processEvt histogram failed", __func__);
-                free(payload);
-                payload = NULL;
-
-            }
-        } else {
-            ALOGE("%s: No memory for histogram qcamera_sm_internal_evt_payload_t", __func__);
+        if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_HISTOGRAM_STATS,
+                &pMetaData->stats_data, sizeof(pMetaData->stats_data)) == NO_ERROR) {
+            num_evts++;
         }
     }
 
     if (pMetaData->is_focus_valid) {
         // process focus info
-        qcamera_sm_internal_evt_payload_t *payload =
-            (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-        if (NULL != payload) {
-            memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-            payload->evt_type = QCAMERA_INTERNAL_EVT_FOCUS_UPDATE;
-            payload->focus_data = pMetaData->focus_data;
-            payload->focus_data.focused_frame_idx = frame->frame_idx;
-            int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-            if (rc != NO_ERROR) {
-                ALOGE("%s: processEvt focus failed", __func__);
-                free(payload);
-                payload = NULL;
-
-            }
-        } else {
-            ALOGE("%s: No memory for focus qcamera_sm_internal_evt_payload_t", __func__);
+        cam_auto_focus_data_t focus_data = pMetaData->focus_data;
+        focus_data.focused_frame_idx = frame->frame_idx;
+        if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_FOCUS_UPDATE,
+                &focus_data, sizeof(focus_data)) == NO_ERROR) {
+            num_evts++;
         }
     }
 
@@ -1521,41 +1467,18 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
             ALOGE("%s: Invalid num_of_streams %d in crop_data", __func__,
                 pMetaData->crop_data.num_of_streams);
         } else {
-            qcamera_sm_internal_evt_payload_t *payload =
-                (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-            if (NULL != payload) {
-                memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-                payload->evt_type = QCAMERA_INTERNAL_EVT_CROP_INFO;
-                payload->crop_data = pMetaData->crop_data;
-                int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-                if (rc != NO_ERROR) {
-                    ALOGE("%s: processEvt crop info failed", __func__);
-                    free(payload);
-                    payload = NULL;
-
-                }
-            } else {
-                ALOGE("%s: No memory for crop info qcamera_sm_internal_evt_payload_t", __func__);
+            if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_CROP_INFO,
+                    &pMetaData->crop_data, sizeof(pMetaData->crop_data)) == NO_ERROR) {
+                num_evts++;
             }
         }
     }
 
     if (pMetaData->is_prep_snapshot_done_valid) {
-        qcamera_sm_internal_evt_payload_t *payload =
-            (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-        if (NULL != payload) {
-            memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-            payload->evt_type = QCAMERA_INTERNAL_EVT_PREP_SNAPSHOT_DONE;
-            payload->prep_snapshot_state = pMetaData->prep_snapshot_done_state;
-            int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-            if (rc != NO_ERROR) {
-                ALOGE("%s: processEvt prep_snapshot failed", __func__);
-                free(payload);
-                payload = NULL;
-
-            }
-        } else {
-            ALOGE("%s: No memory for prep_snapshot qcamera_sm_internal_evt_payload_t", __func__);
+        if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_PREP_SNAPSHOT_DONE,
+                &pMetaData->prep_snapshot_done_state,
+                sizeof(pMetaData->prep_snapshot_done_state)) == NO_ERROR) {
+            num_evts++;
         }
     }
     if (pMetaData->is_hdr_scene_data_valid) {
@@ -1577,39 +1500,17 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
     if(pMetaData->is_ae_params_valid) {
         pme->mExifParams.ae_params = pMetaData->ae_params;
         pme->mFlashNeeded = pMetaData->ae_params.flash_needed ? true : false;
-        qcamera_sm_internal_evt_payload_t *payload =
-            (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-        if (NULL != payload) {
-            memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-            payload->evt_type = QCAMERA_INTERNAL_EVT_AE_UPDATE;
-            payload->ae_data = pMetaData->ae_params;
-            int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-            if (rc != NO_ERROR) {
-                ALOGE("%s: processEvt ae_update failed", __func__);
-                free(payload);
-                payload = NULL;
-            }
-        } else {
-            ALOGE("%s: No memory for ae_update qcamera_sm_internal_evt_payload_t", __func__);
+        if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_AE_UPDATE,
+                &pMetaData->ae_params, sizeof(pMetaData->ae_params)) == NO_ERROR) {
+            num_evts++;
         }
     }
 
     if(pMetaData->is_awb_params_valid) {
         pme->mExifParams.awb_params = pMetaData->awb_params;
-        qcamera_sm_internal_evt_payload_t *payload =
-            (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-        if (NULL != payload) {
-            memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-            payload->evt_type = QCAMERA_INTERNAL_EVT_AWB_UPDATE;
-            payload->awb_data = pMetaData->awb_params;
-            int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-            if (rc != NO_ERROR) {
-                ALOGE("%s: processEvt awb_update failed", __func__);
-                free(payload);
-                payload = NULL;
-            }
-        } else {
-            ALOGE("%s: No memory for awb_update qcamera_sm_internal_evt_payload_t", __func__);
+        if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_AWB_UPDATE,
+                &pMetaData->awb_params, sizeof(pMetaData->awb_params)) == NO_ERROR) {
+            num_evts++;
         }
     }
     if(pMetaData->is_focus_valid) {
@@ -1645,21 +1546,9 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
     }
 
     if (pMetaData->is_asd_decision_valid) {
-        qcamera_sm_internal_evt_payload_t *payload =
-            (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-        if (NULL != payload) {
-            memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-            payload->evt_type = QCAMERA_INTERNAL_EVT_ASD_UPDATE;
-            payload->asd_data = pMetaData->scene;
-            int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-            if (rc != NO_ERROR) {
-                ALOGE("%s: processEvt prep_snapshot failed", __func__);
-                free(payload);
-                payload = NULL;
-
-            }
-        } else {
-            ALOGE("%s: No memory for prep_snapshot qcamera_sm_internal_evt_payload_t", __func__);
+        if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_ASD_UPDATE,
+                &pMetaData->scene, sizeof(pMetaData->scene)) == NO_ERROR) {
+            num_evts++;
         }
         /*Update scene capture type info*/
         if (pme->mExifParams.debug_params) {
@@ -1675,22 +1564,27 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
     }
 
     if (pMetaData->is_focus_pos_info_valid) {
-        qcamera_sm_internal_evt_payload_t *payload =
-            (qcamera_sm_internal_evt_payload_t *)malloc(sizeof(qcamera_sm_internal_evt_payload_t));
-        if (NULL != payload) {
-            memset(payload, 0, sizeof(qcamera_sm_internal_evt_payload_t));
-            payload->evt_type = QCAMERA_INTERNAL_EVT_FOCUS_POS_UPDATE;
-            payload->focus_pos = pMetaData->cur_pos_info;
-            int32_t rc = pme->processEvt(QCAMERA_SM_EVT_EVT_INTERNAL, payload);
-            if (rc != NO_ERROR) {
-                ALOGE("%s: processEvt focus_pos_update failed", __func__);
-                free(payload);
-                payload = NULL;
-            }
+        if (pme->postMetadataEvt(meta, QCAMERA_INTERNAL_EVT_FOCUS_POS_UPDATE,
+                &pMetaData->cur_pos_info, sizeof(pMetaData->cur_pos_info)) == NO_ERROR) {
+            num_evts++;
+        }
+    }
+
+    if (meta != NULL) {
+        if (meta->valid_mask != 0 &&
+                pme->processEvt(QCAMERA_SM_EVT_METADATA_FRAME, meta) == NO_ERROR) {
+            num_posts = 1;
         } else {
-            ALOGE("%s: No memory for focus_pos_update qcamera_sm_internal_evt_payload_t", __func__);
+            if (meta->valid_mask != 0) {
+                ALOGE("%s: processEvt metadata frame failed", __func__);
+                num_evts = 0;
+            }
+            pme->m_stateMachine.releaseEvtPayload(meta);
         }
+    } else {
+        num_posts = num_evts;
     }
+    pme->m_stateMachine.addMetadataFrameStats(num_evts, num_posts);
 
     stream->bufDone(frame->buf_idx);
     free(super_frame);
@@ -1722,6 +1616,9 @@ void QCamera2HardwareInterface::reprocess_stream_cb_routine(mm_camera_super_buf_
                                                             void * userdata)
 {
     ATRACE_CALL();
+    if (NULL != super_frame->bufs[0]) {
+        CAM_TRACE_BUF(CAM_TRACE_STREAM_CB, super_frame->bufs[0]);
+    }
     CDBG_HIGH("[KPI Perf] %s: E", __func__);
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     if (pme == NULL ||
@@ -1738,6 +1635,75 @@ void QCamera2HardwareInterface::reprocess_stream_cb_routine(mm_camera_super_buf_
     CDBG_HIGH("[KPI Perf] %s: X", __func__);
 }
 
+/*===========================================================================
+ * FUNCTION   : dumpToWriter
+ *
+ * DESCRIPTION: hand a debug dump to the asynchronous dump writer, starting
+ *              it on first use. Records go to one container file per
+ *              session, /data/misc/camera/<time>_cam<id>.qcd, which
+ *              qcamera_dump_extract splits back into the usual files.
+ *
+ * PARAMETERS :
+ *    @type     : QCAMERA_DUMP_FRM_* type of the record
+ *    @frameIdx : frame index
+ *    @name     : file name of the record
+ *    @segs     : pieces of the record
+ *    @count    : number of pieces
+ *
+ * RETURN     : true if the writer took care of the record, whether queued
+ *              or dropped by its limits. false if disabled with
+ *              persist.camera.dump.async or not running, the caller then
+ *              writes the file itself.
+ *==========================================================================*/
+bool QCamera2HardwareInterface::dumpToWriter(uint32_t type, uint32_t frameIdx,
+        const char *name, const qcamera_dump_seg_t *segs, uint32_t count)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    if (!m_dumpWriter.isRunning()) {
+        property_get("persist.camera.dump.async", value, "1");
+        if (atoi(value) <= 0) {
+            return false;
+        }
+
+        qcamera_dump_config_t config;
+        memset(&config, 0, sizeof(config));
+        property_get("persist.camera.dump.ring_mb", value, "32");
+        config.ring_size = (size_t)atoi(value) << 20;
+        property_get("persist.camera.dump.rate_kbps", value, "0");
+        config.rate_kbps = (uint32_t)atoi(value);
+        property_get("persist.camera.dump.interval_ms", value, "0");
+        config.min_interval_ms = (uint32_t)atoi(value);
+        property_get("persist.camera.dump.max_mb", value, "0");
+        config.max_file_size = (uint64_t)atoi(value) << 20;
+
+        char timeBuf[32];
+        char path[64];
+        time_t current_time;
+        struct tm * timeinfo;
+        memset(timeBuf, 0, sizeof(timeBuf));
+        time (&current_time);
+        timeinfo = localtime (&current_time);
+        if (timeinfo != NULL)
+            strftime (timeBuf, sizeof(timeBuf), "%Y%m%d%H%M%S", timeinfo);
+        snprintf(path, sizeof(path), "/data/misc/camera/%s_cam%u.qcd",
+                timeBuf, mCameraId);
+        if (m_dumpWriter.start(path, mCameraId, config) != NO_ERROR) {
+            ALOGE("%s: dump writer not started, dumping synchronously", __func__);
+            return false;
+        }
+        CDBG_HIGH("%s: dumping to %s, ring %zu bytes, %u KB/s, %u ms, max %llu bytes",
+                __func__, path, config.ring_size, config.rate_kbps,
+                config.min_interval_ms, (unsigned long long)config.max_file_size);
+    }
+
+    int32_t rc = m_dumpWriter.dump(type, frameIdx, name, segs, count);
+    if (rc == WOULD_BLOCK) {
+        CDBG("%s: dump of %s dropped", __func__, name);
+    }
+    return rc != NO_INIT;
+}
+
 /*===========================================================================
  * FUNCTION   : dumpFrameToFile
  *
@@ -1791,14 +1757,19 @@ void QCamera2HardwareInterface::dumpJpegToFile(const void *data,
                     mBackendFileSize = size;
                 }
 
-                int file_fd = open(buf, O_RDWR | O_CREAT, 0777);
-                if (file_fd >= 0) {
-                    ssize_t written_len = write(file_fd, data, size);
-                    fchmod(file_fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-                    CDBG_HIGH("%s: written number of bytes %d\n", __func__, written_len);
-                    close(file_fd);
-                } else {
-                    ALOGE("%s: fail t open file for image dumping", __func__);
+                // the backend reads the file by name, keep it a real file
+                qcamera_dump_seg_t seg = { data, size, 1, size };
+                if ((true == m_bIntEvtPending) || !dumpToWriter(QCAMERA_DUMP_FRM_JPEG,
+                        index, strrchr(buf, '/') + 1, &seg, 1)) {
+                    int file_fd = open(buf, O_RDWR | O_CREAT, 0777);
+                    if (file_fd >= 0) {
+                        ssize_t written_len = write(file_fd, data, size);
+                        fchmod(file_fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+                        CDBG_HIGH("%s: written number of bytes %d\n", __func__, written_len);
+                        close(file_fd);
+                    } else {
+                        ALOGE("%s: fail t open file for image dumping", __func__);
+                    }
                 }
                 if (false == m_bIntEvtPending) {
                     mDumpFrmCnt++;
@@ -1851,39 +1822,44 @@ void QCamera2HardwareInterface::dumpMetadataToFile(QCameraStream *stream,
             String8 filePath(timeBuf);
             snprintf(buf, sizeof(buf), "%um_%s_%d.bin", dumpFrmCnt, type, frame->frame_idx);
             filePath.append(buf);
-            int file_fd = open(filePath.string(), O_RDWR | O_CREAT, 0777);
-            if (file_fd > 0) {
-                ssize_t written_len = 0;
-                metadata->tuning_params.tuning_data_version = TUNING_DATA_VERSION;
-                void *data = (void *)((uint8_t *)&metadata->tuning_params.tuning_data_version);
-                written_len += write(file_fd, data, sizeof(uint32_t));
-                data = (void *)((uint8_t *)&metadata->tuning_params.tuning_sensor_data_size);
-                CDBG_HIGH("tuning_sensor_data_size %d",(int)(*(int *)data));
-                written_len += write(file_fd, data, sizeof(uint32_t));
-                data = (void *)((uint8_t *)&metadata->tuning_params.tuning_vfe_data_size);
-                CDBG_HIGH("tuning_vfe_data_size %d",(int)(*(int *)data));
-                written_len += write(file_fd, data, sizeof(uint32_t));
-                data = (void *)((uint8_t *)&metadata->tuning_params.tuning_cpp_data_size);
-                CDBG_HIGH("tuning_cpp_data_size %d",(int)(*(int *)data));
-                written_len += write(file_fd, data, sizeof(uint32_t));
-                data = (void *)((uint8_t *)&metadata->tuning_params.tuning_cac_data_size);
-                CDBG_HIGH("tuning_cac_data_size %d",(int)(*(int *)data));
-                written_len += write(file_fd, data, sizeof(uint32_t));
-                size_t total_size = metadata->tuning_params.tuning_sensor_data_size;
-                data = (void *)((uint8_t *)&metadata->tuning_params.data);
-                written_len += write(file_fd, data, total_size);
-                total_size = metadata->tuning_params.tuning_vfe_data_size;
-                data = (void *)((uint8_t *)&metadata->tuning_params.data[TUNING_VFE_DATA_OFFSET]);
-                written_len += write(file_fd, data, total_size);
-                total_size = metadata->tuning_params.tuning_cpp_data_size;
-                data = (void *)((uint8_t *)&metadata->tuning_params.data[TUNING_CPP_DATA_OFFSET]);
-                written_len += write(file_fd, data, total_size);
-                total_size = metadata->tuning_params.tuning_cac_data_size;
-                data = (void *)((uint8_t *)&metadata->tuning_params.data[TUNING_CAC_DATA_OFFSET]);
-                written_len += write(file_fd, data, total_size);
-                close(file_fd);
-            }else {
-                ALOGE("%s: fail t open file for image dumping", __func__);
+
+            // version and the four sizes (32 bit each), then the four blocks
+            tuning_params_t *tuning = &metadata->tuning_params;
+            tuning->tuning_data_version = TUNING_DATA_VERSION;
+            CDBG_HIGH("tuning sizes sensor %d vfe %d cpp %d cac %d",
+                    (int)tuning->tuning_sensor_data_size,
+                    (int)tuning->tuning_vfe_data_size,
+                    (int)tuning->tuning_cpp_data_size,
+                    (int)tuning->tuning_cac_data_size);
+            qcamera_dump_seg_t segs[] = {
+                { &tuning->tuning_data_version, sizeof(uint32_t), 1, 0 },
+                { &tuning->tuning_sensor_data_size, sizeof(uint32_t), 1, 0 },
+                { &tuning->tuning_vfe_data_size, sizeof(uint32_t), 1, 0 },
+                { &tuning->tuning_cpp_data_size, sizeof(uint32_t), 1, 0 },
+                { &tuning->tuning_cac_data_size, sizeof(uint32_t), 1, 0 },
+                { &tuning->data[0], tuning->tuning_sensor_data_size, 1, 0 },
+                { &tuning->data[TUNING_VFE_DATA_OFFSET],
+                        tuning->tuning_vfe_data_size, 1, 0 },
+                { &tuning->data[TUNING_CPP_DATA_OFFSET],
+                        tuning->tuning_cpp_data_size, 1, 0 },
+                { &tuning->data[TUNING_CAC_DATA_OFFSET],
+                        tuning->tuning_cac_data_size, 1, 0 },
+            };
+            uint32_t num_segs = sizeof(segs) / sizeof(segs[0]);
+
+            if (!dumpToWriter(QCAMERA_DUMP_FRM_METADATA, frame->frame_idx, buf,
+                    segs, num_segs)) {
+                int file_fd = open(filePath.string(), O_RDWR | O_CREAT, 0777);
+                if (file_fd > 0) {
+                    ssize_t written_len = 0;
+                    for (uint32_t i = 0; i < num_segs; i++) {
+                        written_len += write(file_fd, segs[i].data, segs[i].width);
+                    }
+                    CDBG_HIGH("%s: written number of bytes %d\n", __func__, written_len);
+                    close(file_fd);
+                }else {
+                    ALOGE("%s: fail t open file for image dumping", __func__);
+                }
             }
             dumpFrmCnt++;
         }
@@ -1918,7 +1894,11 @@ void QCamera2HardwareInterface::dumpFrameToFile(QCameraStream *stream,
         mDumpFrmCnt = stream->mDumpFrame;
 
     if(enabled & QCAMERA_DUMP_FRM_MASK_ALL) {
-        if((enabled & dump_type) && stream && frame) {
+        // preview dumps run at frame rate and are the first to go under load
+        bool governed = (dump_type == QCAMERA_DUMP_FRM_PREVIEW);
+        if((enabled & dump_type) && stream && frame &&
+                (!governed || m_loadGovernor.admit(QCAMERA_LOAD_STAGE_DUMP))) {
+            int64_t start = m_loadGovernor.begin();
             frm_num = ((enabled & 0xffff0000) >> 16);
             if(frm_num == 0) {
                 frm_num = 10; //default 10 frames
@@ -2000,33 +1980,59 @@ void QCamera2HardwareInterface::dumpFrameToFile(QCameraStream *stream,
                     }
 
                     filePath.append(buf);
-                    int file_fd = open(filePath.string(), O_RDWR | O_CREAT, 0777);
-                    if (file_fd > 0) {
-                        void *data = NULL;
-                        ssize_t written_len = 0;
-
-                        for (uint32_t i = 0; i < offset.num_planes; i++) {
-                            uint32_t index = offset.mp[i].offset;
-                            if (i > 0) {
-                                index += offset.mp[i-1].len;
-                            }
-                            for (int j = 0; j < offset.mp[i].height; j++) {
-                                data = (void *)((uint8_t *)frame->buffer + index);
-                                written_len += write(file_fd, data,
-                                        (size_t)offset.mp[i].width);
-                                index += (uint32_t)offset.mp[i].stride;
-                            }
+
+                    qcamera_dump_seg_t segs[VIDEO_MAX_PLANES];
+                    uint32_t num_segs = 0;
+                    size_t packed_len = 0;
+                    for (uint32_t i = 0; i < offset.num_planes &&
+                            i < VIDEO_MAX_PLANES; i++) {
+                        uint32_t index = offset.mp[i].offset;
+                        if (i > 0) {
+                            index += offset.mp[i-1].len;
                         }
+                        segs[num_segs].data = (uint8_t *)frame->buffer + index;
+                        segs[num_segs].width = (size_t)offset.mp[i].width;
+                        segs[num_segs].height = (size_t)offset.mp[i].height;
+                        segs[num_segs].stride = (size_t)offset.mp[i].stride;
+                        packed_len += segs[num_segs].width * segs[num_segs].height;
+                        num_segs++;
+                    }
 
-                        CDBG_HIGH("%s: written number of bytes %d\n", __func__, written_len);
-                        close(file_fd);
-                    } else {
-                        ALOGE("%s: fail t open file for image dumping", __func__);
+                    if (!dumpToWriter(dump_type, frame->frame_idx, buf, segs, num_segs)) {
+                        int file_fd = open(filePath.string(), O_RDWR | O_CREAT, 0777);
+                        if (file_fd > 0) {
+                            ssize_t written_len = 0;
+
+                            // strip the padding first, one write instead of one per row
+                            uint8_t *packed = (uint8_t *)malloc(packed_len);
+                            if (packed != NULL) {
+                                uint8_t *dst = packed;
+                                for (uint32_t i = 0; i < num_segs; i++) {
+                                    QCameraPlaneOps::copyPlane(dst, (int32_t)segs[i].width,
+                                            (const uint8_t *)segs[i].data,
+                                            (int32_t)segs[i].stride,
+                                            (int32_t)segs[i].width, (int32_t)segs[i].height);
+                                    dst += segs[i].width * segs[i].height;
+                                }
+                                written_len = write(file_fd, packed, packed_len);
+                                free(packed);
+                            } else {
+                                ALOGE("%s: no memory to pack frame for dumping", __func__);
+                            }
+
+                            CDBG_HIGH("%s: written number of bytes %d\n", __func__, written_len);
+                            close(file_fd);
+                        } else {
+                            ALOGE("%s: fail t open file for image dumping", __func__);
+                        }
                     }
                     mDumpFrmCnt++;
                 }
             }
             stream->mDumpSkipCnt++;
+            if (governed) {
+                m_loadGovernor.end(QCAMERA_LOAD_STAGE_DUMP, start);
+            }
         }
     } else {
         mDumpFrmCnt = 0;
@@ -2100,6 +2106,7 @@ void QCamera2HardwareInterface::debugShowPreviewFPS()
  *==========================================================================*/
 QCameraCbNotifier::~QCameraCbNotifier()
 {
+    pthread_mutex_destroy(&mPreviewStatsLock);
 }
 
 /*===========================================================================
@@ -2115,6 +2122,7 @@ void QCameraCbNotifier::exit()
 {
     mActive = false;
     mProcTh.exit();
+    mPreviewTh.exit();
 }
 
 /*===========================================================================
@@ -2139,6 +2147,32 @@ void QCameraCbNotifier::releaseNotifications(void *data, void *user_data)
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : releasePreviewNotifications
+ *
+ * DESCRIPTION: callback for releasing preview frames dropped from or left
+ *              in the preview backlog. The node itself is freed by the
+ *              queue.
+ *
+ * PARAMETERS :
+ *   @data      : data to be released
+ *   @user_data : context data
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::releasePreviewNotifications(void *data,
+                                                    void */*user_data*/)
+{
+    qcamera_preview_cb_node_t *node = (qcamera_preview_cb_node_t *) data;
+
+    if (NULL != node) {
+        if (node->cb.release_cb) {
+            node->cb.release_cb(node->cb.user_data, node->cb.cookie,
+                    FAILED_TRANSACTION);
+        }
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : matchSnapshotNotifications
  *
@@ -2337,6 +2371,99 @@ void * QCameraCbNotifier::cbNotifyRoutine(void * data)
     return NULL;
 }
 
+/*===========================================================================
+ * FUNCTION   : previewNotifyRoutine
+ *
+ * DESCRIPTION: delivers preview frame callbacks to the app, so a slow
+ *              callback stalls neither the preview stream nor the other
+ *              notifications.
+ *
+ * PARAMETERS :
+ *   @data    : context data
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void * QCameraCbNotifier::previewNotifyRoutine(void * data)
+{
+    int running = 1;
+    int ret;
+    QCameraCbNotifier *pme = (QCameraCbNotifier *)data;
+    QCameraCmdThread *cmdThread = &pme->mPreviewTh;
+    cmdThread->setName("CAM_cbPreview");
+    int32_t cbStatus = NO_ERROR;
+
+    CDBG("%s: E", __func__);
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                CDBG("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            {
+                // frames dropped by the producer leave extra wakeups
+                qcamera_preview_cb_node_t *node =
+                    (qcamera_preview_cb_node_t *)pme->mPreviewQ.dequeue();
+                if (NULL == node) {
+                    break;
+                }
+                qcamera_callback_argm_t *cb = &node->cb;
+                nsecs_t start = systemTime();
+                cbStatus = NO_ERROR;
+                if (pme->mParent->msgTypeEnabledWithLock(cb->msg_type) &&
+                        (NULL != pme->mDataCb)) {
+                    pme->mDataCb(cb->msg_type,
+                                 cb->data,
+                                 cb->index,
+                                 cb->metadata,
+                                 pme->mCallbackCookie);
+                } else {
+                    cbStatus = INVALID_OPERATION;
+                }
+                nsecs_t end = systemTime();
+                if ( cb->release_cb ) {
+                    cb->release_cb(cb->user_data, cb->cookie, cbStatus);
+                }
+
+                if (NO_ERROR == cbStatus) {
+                    nsecs_t wait = start - node->queued;
+                    nsecs_t spent = end - start;
+                    pthread_mutex_lock(&pme->mPreviewStatsLock);
+                    pme->mPreviewDelivered++;
+                    pme->mPreviewWaitTotal += wait;
+                    pme->mPreviewCbTotal += spent;
+                    if (wait > pme->mPreviewWaitMax) {
+                        pme->mPreviewWaitMax = wait;
+                    }
+                    if (spent > pme->mPreviewCbMax) {
+                        pme->mPreviewCbMax = spent;
+                    }
+                    pthread_mutex_unlock(&pme->mPreviewStatsLock);
+                }
+                free(node);
+            }
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            {
+                running = 0;
+                pme->mPreviewQ.flush();
+            }
+            break;
+        default:
+            break;
+        }
+    } while (running);
+    CDBG("%s: X", __func__);
+
+    return NULL;
+}
+
 /*===========================================================================
  * FUNCTION   : notifyCallback
  *
@@ -2373,6 +2500,141 @@ int32_t QCameraCbNotifier::notifyCallback(qcamera_callback_argm_t &cbArgs)
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : notifyPreviewCallback
+ *
+ * DESCRIPTION: Enqueues a preview frame callback on the preview delivery
+ *              thread. When the app falls behind, the oldest pending frame
+ *              is released unsent to make room, so the backlog never holds
+ *              more than MAX_PREVIEW_CB_BACKLOG frames.
+ *
+ * PARAMETERS :
+ *   @cbArgs  : callback arguments
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraCbNotifier::notifyPreviewCallback(qcamera_callback_argm_t &cbArgs)
+{
+    if (!mActive) {
+        ALOGE("%s: notify thread is not active", __func__);
+        return UNKNOWN_ERROR;
+    }
+
+    qcamera_preview_cb_node_t *node =
+        (qcamera_preview_cb_node_t *)malloc(sizeof(qcamera_preview_cb_node_t));
+    if (NULL == node) {
+        ALOGE("%s: no mem for qcamera_preview_cb_node_t", __func__);
+        return NO_MEMORY;
+    }
+    node->cb = cbArgs;
+    node->queued = systemTime();
+
+    // only the preview stream thread enqueues, so the size check holds
+    if (mPreviewQ.getCurrentSize() >= (int)MAX_PREVIEW_CB_BACKLOG) {
+        void *oldest = mPreviewQ.dequeue();
+        if (NULL != oldest) {
+            releasePreviewNotifications(oldest, this);
+            free(oldest);
+            pthread_mutex_lock(&mPreviewStatsLock);
+            mPreviewDropped++;
+            pthread_mutex_unlock(&mPreviewStatsLock);
+        }
+    }
+
+    if (mPreviewQ.enqueue((void *)node)) {
+        return mPreviewTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    } else {
+        ALOGE("%s: Error adding preview cb into queue", __func__);
+        free(node);
+        return UNKNOWN_ERROR;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : flushPreviewCallbacks
+ *
+ * DESCRIPTION: Releases pending preview frames and logs the delivery
+ *              statistics of the preview session that ended.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::flushPreviewCallbacks()
+{
+    mPreviewQ.flush();
+
+    pthread_mutex_lock(&mPreviewStatsLock);
+    if ((mPreviewDelivered > 0) || (mPreviewDropped > 0)) {
+        uint32_t n = (mPreviewDelivered > 0) ? mPreviewDelivered : 1;
+        CDBG_HIGH("%s: preview cb delivered %u dropped %u, "
+                "wait avg %lld max %lld us, cb avg %lld max %lld us",
+                __func__, mPreviewDelivered, mPreviewDropped,
+                (long long)(mPreviewWaitTotal / n / 1000),
+                (long long)(mPreviewWaitMax / 1000),
+                (long long)(mPreviewCbTotal / n / 1000),
+                (long long)(mPreviewCbMax / 1000));
+    }
+    pthread_mutex_unlock(&mPreviewStatsLock);
+    resetPreviewStats();
+}
+
+/*===========================================================================
+ * FUNCTION   : resetPreviewStats
+ *
+ * DESCRIPTION: Clears the preview delivery statistics.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::resetPreviewStats()
+{
+    pthread_mutex_lock(&mPreviewStatsLock);
+    mPreviewDelivered = 0;
+    mPreviewDropped = 0;
+    mPreviewWaitTotal = 0;
+    mPreviewWaitMax = 0;
+    mPreviewCbTotal = 0;
+    mPreviewCbMax = 0;
+    pthread_mutex_unlock(&mPreviewStatsLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : dumpPreviewStats
+ *
+ * DESCRIPTION: Writes the preview delivery statistics of the current
+ *              preview session.
+ *
+ * PARAMETERS :
+ *   @fd      : fd to write to
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::dumpPreviewStats(int fd)
+{
+    char buf[256];
+
+    pthread_mutex_lock(&mPreviewStatsLock);
+    uint32_t n = (mPreviewDelivered > 0) ? mPreviewDelivered : 1;
+    int len = snprintf(buf, sizeof(buf),
+            "  preview callbacks: delivered %u dropped %u pending %d\n"
+            "  preview callback wait: avg %lld max %lld us\n"
+            "  preview callback time: avg %lld max %lld us\n",
+            mPreviewDelivered, mPreviewDropped, mPreviewQ.getCurrentSize(),
+            (long long)(mPreviewWaitTotal / n / 1000),
+            (long long)(mPreviewWaitMax / 1000),
+            (long long)(mPreviewCbTotal / n / 1000),
+            (long long)(mPreviewCbMax / 1000));
+    pthread_mutex_unlock(&mPreviewStatsLock);
+
+    if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+        ALOGE("%s: write failed", __func__);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : setCallbacks
  *
@@ -2403,6 +2665,7 @@ void QCameraCbNotifier::setCallbacks(camera_notify_callback notifyCb,
         mCallbackCookie = callbackCookie;
         mActive = true;
         mProcTh.launch(cbNotifyRoutine, this);
+        mPreviewTh.launch(previewNotifyRoutine, this);
     } else {
         ALOGE("%s : Camera callback notifier already initialized!",
               __func__);
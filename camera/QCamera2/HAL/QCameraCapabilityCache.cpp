@@ -0,0 +1,257 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_TAG "QCameraCapabilityCache"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <utils/Log.h>
+#include <utils/Errors.h>
+#include <cutils/properties.h>
+#include <hardware/camera.h>
+#include "QCameraCapabilityCache.h"
+
+extern "C" {
+#include <mm_camera_interface.h>
+}
+
+using namespace android;
+
+namespace qcamera {
+
+// backend the HAL is linked against, part of the cache key
+#ifdef QCAMERA_SYNTH_ION
+#define QCAMERA_CAP_CACHE_BACKEND   "synth"
+#else
+#define QCAMERA_CAP_CACHE_BACKEND   "mm-camera"
+#endif
+
+/*===========================================================================
+ * FUNCTION   : isEnabled
+ *
+ * DESCRIPTION: if the capability cache is in use
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : true -- enabled (default)
+ *              false -- disabled by persist.camera.cap.cache
+ *==========================================================================*/
+bool QCameraCapabilityCache::isEnabled()
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get("persist.camera.cap.cache", value, "1");
+    return atoi(value) == 1;
+}
+
+/*===========================================================================
+ * FUNCTION   : getPath
+ *
+ * DESCRIPTION: cache file of a camera. The backend is part of the name so
+ *              camera.synth and the real HAL do not evict each other.
+ *
+ * PARAMETERS :
+ *   @cameraId : camera Id
+ *   @suffix   : appended to the file name, "" for the cache file itself
+ *   @path     : [output] file path
+ *   @len      : size of path
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraCapabilityCache::getPath(uint32_t cameraId, const char *suffix,
+        char *path, size_t len)
+{
+    snprintf(path, len, "%s/qcamera_cap_%s_%u.bin%s", QCAMERA_CAP_CACHE_DIR,
+            QCAMERA_CAP_CACHE_BACKEND, cameraId, suffix);
+}
+
+/*===========================================================================
+ * FUNCTION   : initHeader
+ *
+ * DESCRIPTION: fill in the key fields a cache file must match for a camera.
+ *              The build fingerprint stands in for the backend version: the
+ *              daemon, sensor drivers and tuning only change with the build.
+ *              The sensor name catches a module swapped for another part
+ *              with the same facing and mount angle on the same build.
+ *
+ * PARAMETERS :
+ *   @cameraId : camera Id
+ *   @hdr      : [output] header with everything but the checksum set
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraCapabilityCache::initHeader(uint32_t cameraId,
+        qcamera_cap_cache_hdr_t &hdr)
+{
+    char fingerprint[PROPERTY_VALUE_MAX];
+    struct camera_info *info = get_cam_info(cameraId);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = QCAMERA_CAP_CACHE_MAGIC;
+    hdr.version = QCAMERA_CAP_CACHE_VERSION;
+    hdr.camera_id = cameraId;
+    hdr.cap_size = sizeof(cam_capability_t);
+    if (info != NULL) {
+        hdr.facing = info->facing;
+        hdr.orientation = info->orientation;
+    }
+    property_get("ro.build.fingerprint", fingerprint, "");
+    snprintf(hdr.backend, sizeof(hdr.backend), "%s:%s",
+            QCAMERA_CAP_CACHE_BACKEND, fingerprint);
+    snprintf(hdr.sensor, sizeof(hdr.sensor), "%s",
+            get_cam_sensor_name(cameraId));
+}
+
+/*===========================================================================
+ * FUNCTION   : checksum
+ *
+ * DESCRIPTION: 32 bit FNV-1a over a word at a time, catches files cut short
+ *              or written by a crashed process
+ *
+ * PARAMETERS :
+ *   @data    : payload
+ *   @len     : payload size in bytes
+ *
+ * RETURN     : checksum
+ *==========================================================================*/
+uint32_t QCameraCapabilityCache::checksum(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t hash = 2166136261U;
+    size_t i = 0;
+
+    for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, p + i, sizeof(word));
+        hash = (hash ^ word) * 16777619U;
+    }
+    for (; i < len; i++) {
+        hash = (hash ^ p[i]) * 16777619U;
+    }
+    return hash;
+}
+
+/*===========================================================================
+ * FUNCTION   : load
+ *
+ * DESCRIPTION: read the cached capabilities of a camera. Validation is one
+ *              fstat, a header compare and a checksum over the payload.
+ *
+ * PARAMETERS :
+ *   @cameraId : camera Id
+ *   @cap      : [output] capabilities, undefined unless NO_ERROR
+ *
+ * RETURN     : NO_ERROR on a valid entry
+ *              NAME_NOT_FOUND if there is none, BAD_VALUE if it is stale
+ *==========================================================================*/
+int32_t QCameraCapabilityCache::load(uint32_t cameraId, cam_capability_t *cap)
+{
+    char path[PATH_MAX];
+    qcamera_cap_cache_hdr_t expected, hdr;
+    struct stat st;
+    int32_t rc = BAD_VALUE;
+
+    getPath(cameraId, "", path, sizeof(path));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    initHeader(cameraId, expected);
+    if (fstat(fd, &st) == 0 &&
+            st.st_size == (off_t)(sizeof(hdr) + sizeof(cam_capability_t)) &&
+            read(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr)) {
+        expected.checksum = hdr.checksum;
+        if (memcmp(&hdr, &expected, sizeof(hdr)) == 0 &&
+                read(fd, cap, sizeof(cam_capability_t)) ==
+                (ssize_t)sizeof(cam_capability_t) &&
+                checksum(cap, sizeof(cam_capability_t)) == hdr.checksum) {
+            rc = NO_ERROR;
+        }
+    }
+    close(fd);
+
+    if (rc != NO_ERROR) {
+        ALOGI("%s: stale capability cache %s, querying the backend",
+                __func__, path);
+    }
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : store
+ *
+ * DESCRIPTION: write the capabilities of a camera to a temporary file and
+ *              rename it over the cache file. There is no fsync: a file torn
+ *              by a power cut fails the checksum and is simply rebuilt.
+ *
+ * PARAMETERS :
+ *   @cameraId : camera Id
+ *   @cap      : capabilities as returned by query_capability
+ *
+ * RETURN     : NO_ERROR on success, UNKNOWN_ERROR otherwise
+ *==========================================================================*/
+int32_t QCameraCapabilityCache::store(uint32_t cameraId,
+        const cam_capability_t *cap)
+{
+    char path[PATH_MAX];
+    char tmpPath[PATH_MAX];
+    qcamera_cap_cache_hdr_t hdr;
+    bool ok;
+
+    getPath(cameraId, "", path, sizeof(path));
+    getPath(cameraId, ".tmp", tmpPath, sizeof(tmpPath));
+    initHeader(cameraId, hdr);
+    hdr.checksum = checksum(cap, sizeof(cam_capability_t));
+
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    if (fd < 0) {
+        ALOGE("%s: cannot create %s: %s", __func__, tmpPath, strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    ok = (write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr)) &&
+            (write(fd, cap, sizeof(cam_capability_t)) ==
+            (ssize_t)sizeof(cam_capability_t));
+    close(fd);
+
+    if (!ok || rename(tmpPath, path) != 0) {
+        ALOGE("%s: cannot write %s: %s", __func__, path, strerror(errno));
+        unlink(tmpPath);
+        return UNKNOWN_ERROR;
+    }
+    return NO_ERROR;
+}
+
+}; // namespace qcamera
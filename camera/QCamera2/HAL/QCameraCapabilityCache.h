@@ -0,0 +1,81 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_CAPABILITY_CACHE_H__
+#define __QCAMERA_CAPABILITY_CACHE_H__
+
+#include <stdint.h>
+#include "cam_intf.h"
+
+namespace qcamera {
+
+#define QCAMERA_CAP_CACHE_DIR       "/data/misc/camera"
+#define QCAMERA_CAP_CACHE_MAGIC     0x50414351 /* "QCAP" */
+#define QCAMERA_CAP_CACHE_VERSION   2
+#define QCAMERA_CAP_CACHE_ID_LEN    128
+
+/*
+ * On disk layout of a capability cache file: this header followed by the
+ * cam_capability_t exactly as query_capability returned it, before the HAL
+ * trims size tables or raises padding. The file is only used when every
+ * key field matches the running sensor, backend and build.
+ */
+typedef struct {
+    uint32_t magic;                          // QCAMERA_CAP_CACHE_MAGIC
+    uint32_t version;                        // QCAMERA_CAP_CACHE_VERSION
+    uint32_t camera_id;
+    uint32_t cap_size;                       // sizeof(cam_capability_t) of the writer
+    int32_t facing;                          // camera_info of the sensor
+    int32_t orientation;
+    uint32_t checksum;                       // FNV-1a of the payload
+    uint32_t reserved;
+    char backend[QCAMERA_CAP_CACHE_ID_LEN];  // backend and build fingerprint
+    char sensor[QCAMERA_CAP_CACHE_ID_LEN];   // sensor name the backend reports
+} qcamera_cap_cache_hdr_t;
+
+// Persistent copy of the sensor capabilities, so a cold open can skip the
+// ION round trip of query_capability. Disabled by persist.camera.cap.cache=0.
+class QCameraCapabilityCache {
+public:
+    static bool isEnabled();
+    // NO_ERROR and cap filled in if a valid entry exists for the camera
+    static int32_t load(uint32_t cameraId, cam_capability_t *cap);
+    // replace the entry of the camera with a freshly queried cap
+    static int32_t store(uint32_t cameraId, const cam_capability_t *cap);
+
+private:
+    static void getPath(uint32_t cameraId, const char *suffix,
+            char *path, size_t len);
+    static void initHeader(uint32_t cameraId, qcamera_cap_cache_hdr_t &hdr);
+    static uint32_t checksum(const void *data, size_t len);
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_CAPABILITY_CACHE_H__ */
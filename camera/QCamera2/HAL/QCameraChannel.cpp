@@ -817,13 +817,7 @@ int32_t QCameraVideoChannel::cancelPicture()
  *==========================================================================*/
 int32_t QCameraVideoChannel::releaseFrame(const void * opaque, bool isMetaData)
 {
-    QCameraStream *pVideoStream = NULL;
-    for (size_t i = 0; i < mStreams.size(); i++) {
-        if (mStreams[i] != NULL && mStreams[i]->isTypeOf(CAM_STREAM_TYPE_VIDEO)) {
-            pVideoStream = mStreams[i];
-            break;
-        }
-    }
+    QCameraStream *pVideoStream = getVideoStream();
 
     if (NULL == pVideoStream) {
         ALOGE("%s: No video stream in the channel", __func__);
@@ -834,6 +828,25 @@ int32_t QCameraVideoChannel::releaseFrame(const void * opaque, bool isMetaData)
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : getVideoStream
+ *
+ * DESCRIPTION: find the video stream of the channel
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : ptr to the video stream, NULL if there is none
+ *==========================================================================*/
+QCameraStream *QCameraVideoChannel::getVideoStream()
+{
+    for (size_t i = 0; i < mStreams.size(); i++) {
+        if (mStreams[i] != NULL && mStreams[i]->isTypeOf(CAM_STREAM_TYPE_VIDEO)) {
+            return mStreams[i];
+        }
+    }
+    return NULL;
+}
+
 /*===========================================================================
  * FUNCTION   : QCameraReprocessChannel
  *
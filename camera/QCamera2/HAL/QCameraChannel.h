@@ -114,6 +114,7 @@ public:
     int32_t takePicture(uint8_t num_of_snapshot);
     int32_t cancelPicture();
     int32_t releaseFrame(const void *opaque, bool isMetaData);
+    QCameraStream *getVideoStream();
 };
 
 // reprocess channel class
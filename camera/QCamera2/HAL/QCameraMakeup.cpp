@@ -0,0 +1,892 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_TAG "QCameraMakeup"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <utils/Log.h>
+#include <utils/Errors.h>
+#include "QCamera2HWI.h"
+#include "QCameraMakeup.h"
+#include "QCameraMem.h"
+#include "QCameraPlaneOps.h"
+
+using namespace android;
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraMakeup
+ *
+ * DESCRIPTION: constructor of QCameraMakeup
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraMakeup::QCameraMakeup() :
+    m_enabled(false),
+    m_white(0),
+    m_clean(0),
+    m_trackTime(0),
+    m_detector(NULL),
+    m_workerActive(false),
+    m_frameFn(NULL),
+    m_userData(NULL),
+    m_frameQ(MAX_PENDING_FRAMES, false, releaseFrame, this)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_mutex_init(&m_snapshotLock, NULL);
+    pthread_mutex_init(&m_workerLock, NULL);
+    memset(&m_track, -1, sizeof(m_track));
+    memset(&m_trackDim, 0, sizeof(m_trackDim));
+    memset(&m_previewBufs, 0, sizeof(m_previewBufs));
+    memset(&m_snapshotBufs, 0, sizeof(m_snapshotBufs));
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraMakeup
+ *
+ * DESCRIPTION: destructor of QCameraMakeup
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraMakeup::~QCameraMakeup()
+{
+    release();
+    pthread_mutex_destroy(&m_workerLock);
+    pthread_mutex_destroy(&m_snapshotLock);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : setParams
+ *
+ * DESCRIPTION: cache the makeup parameters of the app. Called with the
+ *              parameter lock held whenever parameters are updated.
+ *
+ * PARAMETERS :
+ *   @enable  : value of KEY_TS_MAKEUP, NULL if not set
+ *   @whiten  : whiten level, clamped to [0, 100]
+ *   @clean   : clean level, clamped to [0, 100]
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::setParams(const char *enable, int whiten, int clean)
+{
+    pthread_mutex_lock(&m_lock);
+    m_enabled = (enable != NULL) && (strcmp(enable, "On") == 0);
+    m_white = whiten <= 0 ? 0 : (whiten >= 100 ? 100 : whiten);
+    m_clean = clean <= 0 ? 0 : (clean >= 100 ? 100 : clean);
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : setFaceTrack
+ *
+ * DESCRIPTION: store the face found in the latest preview frame
+ *
+ * PARAMETERS :
+ *   @face    : face boundary
+ *   @dim     : dimension of the frame the boundary refers to
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::setFaceTrack(const cam_rect_t &face, const cam_dimension_t &dim)
+{
+    pthread_mutex_lock(&m_lock);
+    m_track.left = face.left;
+    m_track.top = face.top;
+    m_track.right = face.left + face.width;
+    m_track.bottom = face.top + face.height;
+    m_trackDim = dim;
+    m_trackTime = systemTime();
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : clearFaceTrack
+ *
+ * DESCRIPTION: forget the preview face, no face is in view
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::clearFaceTrack()
+{
+    pthread_mutex_lock(&m_lock);
+    memset(&m_track, -1, sizeof(m_track));
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : getParams
+ *
+ * DESCRIPTION: read the cached makeup levels
+ *
+ * PARAMETERS :
+ *   @white   : whiten level
+ *   @clean   : clean level
+ *
+ * RETURN     : true -- makeup is on
+ *              false -- makeup is off
+ *==========================================================================*/
+bool QCameraMakeup::getParams(int &white, int &clean)
+{
+    pthread_mutex_lock(&m_lock);
+    bool enabled = m_enabled;
+    white = m_white;
+    clean = m_clean;
+    pthread_mutex_unlock(&m_lock);
+    return enabled;
+}
+
+/*===========================================================================
+ * FUNCTION   : getTrack
+ *
+ * DESCRIPTION: map the preview face to a frame of another size. For a
+ *              snapshot the track must be recent and the frame must have
+ *              the aspect ratio of preview, otherwise the preview field of
+ *              view does not line up with the picture.
+ *
+ * PARAMETERS :
+ *   @dim      : dimension of the frame to process
+ *   @rect     : face boundary in frame coordinates
+ *   @snapshot : apply the snapshot checks
+ *
+ * RETURN     : true -- rect is valid
+ *              false -- no usable track
+ *==========================================================================*/
+bool QCameraMakeup::getTrack(const cam_dimension_t &dim, TSRect &rect, bool snapshot)
+{
+    bool valid = false;
+
+    pthread_mutex_lock(&m_lock);
+    int64_t tw = m_trackDim.width;
+    int64_t th = m_trackDim.height;
+    if ((m_track.left > -1) && (tw > 0) && (th > 0) &&
+            (dim.width > 0) && (dim.height > 0)) {
+        valid = true;
+        if (snapshot) {
+            int64_t diff = tw * dim.height - th * dim.width;
+            if (diff < 0) {
+                diff = -diff;
+            }
+            // within 1% of the preview aspect ratio
+            if ((systemTime() - m_trackTime > MAX_TRACK_AGE_NS) ||
+                    (diff * 100 > tw * dim.height)) {
+                valid = false;
+            }
+        }
+        if (valid) {
+            rect.left = (long)(m_track.left * dim.width / tw);
+            rect.top = (long)(m_track.top * dim.height / th);
+            rect.right = (long)(m_track.right * dim.width / tw);
+            rect.bottom = (long)(m_track.bottom * dim.height / th);
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+    return valid;
+}
+
+/*===========================================================================
+ * FUNCTION   : ensure
+ *
+ * DESCRIPTION: grow a work buffer to hold at least needed bytes. Buffers
+ *              never shrink while in use, so steady state needs no
+ *              allocation.
+ *
+ * PARAMETERS :
+ *   @buf     : buffer, replaced if too small
+ *   @size    : current size of buf
+ *   @needed  : bytes required
+ *
+ * RETURN     : true -- buf holds needed bytes
+ *              false -- out of memory
+ *==========================================================================*/
+bool QCameraMakeup::ensure(uint8_t *&buf, size_t &size, size_t needed)
+{
+    if ((buf != NULL) && (size >= needed)) {
+        return true;
+    }
+
+    uint8_t *grown = (uint8_t *)malloc(needed);
+    if (grown == NULL) {
+        ALOGE("%s: no memory for %zu byte buffer", __func__, needed);
+        return false;
+    }
+    free(buf);
+    pthread_mutex_lock(&m_lock);
+    m_stats.buffer_bytes = m_stats.buffer_bytes - size + needed;
+    pthread_mutex_unlock(&m_lock);
+    buf = grown;
+    size = needed;
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : freeBufs
+ *
+ * DESCRIPTION: free a set of work buffers
+ *
+ * PARAMETERS :
+ *   @bufs    : buffers to free
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::freeBufs(qcamera_makeup_bufs_t &bufs)
+{
+    pthread_mutex_lock(&m_lock);
+    m_stats.buffer_bytes -= bufs.inSize + bufs.outSize;
+    pthread_mutex_unlock(&m_lock);
+    free(bufs.in);
+    free(bufs.out);
+    memset(&bufs, 0, sizeof(bufs));
+}
+
+/*===========================================================================
+ * FUNCTION   : getInput
+ *
+ * DESCRIPTION: describe the NV21 planes of a frame to the library. Planes
+ *              without row padding are used in place, padded ones are
+ *              copied to a packed work buffer first.
+ *
+ * PARAMETERS :
+ *   @frame   : frame to process
+ *   @stream  : stream the frame belongs to
+ *   @bufs    : work buffers of the path
+ *   @data    : filled with the plane pointers
+ *   @copyNs  : time spent copying is added here
+ *
+ * RETURN     : true -- success
+ *              false -- failure
+ *==========================================================================*/
+bool QCameraMakeup::getInput(mm_camera_buf_def_t *frame, QCameraStream *stream,
+        qcamera_makeup_bufs_t &bufs, TSMakeupData &data, nsecs_t &copyNs)
+{
+    cam_frame_len_offset_t offset;
+    cam_dimension_t dim;
+
+    memset(&offset, 0, sizeof(offset));
+    stream->getFrameOffset(offset);
+    stream->getFrameDimension(dim);
+    if ((offset.num_planes < 2) || (dim.width <= 0) || (dim.height <= 0)) {
+        ALOGE("%s: unsupported frame %dx%d, %u planes", __func__,
+                dim.width, dim.height, offset.num_planes);
+        return false;
+    }
+
+    uint8_t *base = (uint8_t *)frame->buffer;
+    uint8_t *y = base + offset.mp[0].offset;
+    uint8_t *uv = base + offset.mp[0].len + offset.mp[1].offset;
+    size_t ySize = (size_t)dim.width * (size_t)dim.height;
+
+    data.frameWidth = dim.width;
+    data.frameHeight = dim.height;
+    if ((offset.mp[0].stride == dim.width) && (offset.mp[1].stride == dim.width)) {
+        data.yBuf = y;
+        data.uvBuf = uv;
+        return true;
+    }
+
+    if (!ensure(bufs.in, bufs.inSize, ySize * 3 / 2)) {
+        return false;
+    }
+    nsecs_t start = systemTime();
+    QCameraPlaneOps::copyPlane(bufs.in, dim.width, y, offset.mp[0].stride,
+            dim.width, dim.height);
+    QCameraPlaneOps::copyPlane(bufs.in + ySize, dim.width, uv, offset.mp[1].stride,
+            dim.width, dim.height / 2);
+    copyNs += systemTime() - start;
+
+    data.yBuf = bufs.in;
+    data.uvBuf = bufs.in + ySize;
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : beautify
+ *
+ * DESCRIPTION: run skin beauty on a frame and write the result back into
+ *              the frame with its own strides
+ *
+ * PARAMETERS :
+ *   @frame   : frame to process
+ *   @stream  : stream the frame belongs to
+ *   @bufs    : work buffers of the path
+ *   @in      : input planes from getInput
+ *   @rect    : face boundary in frame coordinates
+ *   @white   : whiten level
+ *   @clean   : clean level
+ *   @copyNs  : time spent copying is added here
+ *
+ * RETURN     : true -- frame was beautified
+ *              false -- frame is untouched
+ *==========================================================================*/
+bool QCameraMakeup::beautify(mm_camera_buf_def_t *frame, QCameraStream *stream,
+        qcamera_makeup_bufs_t &bufs, TSMakeupData &in, const TSRect &rect,
+        int white, int clean, nsecs_t &copyNs)
+{
+    cam_frame_len_offset_t offset;
+    TSMakeupData out;
+
+    memset(&offset, 0, sizeof(offset));
+    stream->getFrameOffset(offset);
+    size_t ySize = (size_t)in.frameWidth * (size_t)in.frameHeight;
+    if (!ensure(bufs.out, bufs.outSize, ySize * 3 / 2)) {
+        return false;
+    }
+    out.frameWidth = in.frameWidth;
+    out.frameHeight = in.frameHeight;
+    out.yBuf = bufs.out;
+    out.uvBuf = bufs.out + ySize;
+
+    CDBG("%s: face %ld,%ld,%ld,%ld clean %d white %d", __func__,
+            rect.left, rect.top, rect.right, rect.bottom, clean, white);
+    int rc = ts_makeup_skin_beauty(&in, &out, &rect, clean, white);
+    if (rc != TS_OK) {
+        ALOGE("%s: ts_makeup_skin_beauty failed %d", __func__, rc);
+        return false;
+    }
+
+    uint8_t *base = (uint8_t *)frame->buffer;
+    nsecs_t start = systemTime();
+    QCameraPlaneOps::copyPlane(base + offset.mp[0].offset, offset.mp[0].stride,
+            out.yBuf, out.frameWidth, out.frameWidth, out.frameHeight);
+    QCameraPlaneOps::copyPlane(base + offset.mp[0].len + offset.mp[1].offset,
+            offset.mp[1].stride, out.uvBuf, out.frameWidth,
+            out.frameWidth, out.frameHeight / 2);
+    copyNs += systemTime() - start;
+
+    QCameraMemory *memory = (QCameraMemory *)frame->mem_info;
+    if (memory != NULL) {
+        memory->cleanCache(frame->buf_idx);
+    }
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : detectFace
+ *
+ * DESCRIPTION: find a face with the detector, creating its context on
+ *              first use. Called with m_snapshotLock held.
+ *
+ * PARAMETERS :
+ *   @data    : packed frame planes
+ *   @rect    : first face found
+ *
+ * RETURN     : true -- a face was found
+ *              false -- no face or detector failure
+ *==========================================================================*/
+bool QCameraMakeup::detectFace(TSMakeupData &data, TSRect &rect)
+{
+    bool found = false;
+    nsecs_t start = systemTime();
+
+    if (m_detector == NULL) {
+        m_detector = ts_detectface_create_context();
+        if (m_detector == NULL) {
+            ALOGE("%s: ts_detectface_create_context failed", __func__);
+            return false;
+        }
+    }
+
+    int faces = ts_detectface_detect(m_detector, &data);
+    if (faces > 0) {
+        memset(&rect, -1, sizeof(rect));
+        ts_detectface_get_face_info(m_detector, 0, &rect, NULL, NULL, NULL);
+        found = (rect.left > -1);
+    }
+    CDBG("%s: %d faces, face %ld,%ld,%ld,%ld", __func__, faces,
+            rect.left, rect.top, rect.right, rect.bottom);
+
+    pthread_mutex_lock(&m_lock);
+    m_stats.detect_total_ns += systemTime() - start;
+    pthread_mutex_unlock(&m_lock);
+    return found;
+}
+
+/*===========================================================================
+ * FUNCTION   : processPreview
+ *
+ * DESCRIPTION: beautify a preview frame around the tracked face
+ *
+ * PARAMETERS :
+ *   @frame   : preview frame
+ *   @stream  : preview stream
+ *
+ * RETURN     : true -- frame was beautified
+ *              false -- frame is untouched
+ *==========================================================================*/
+bool QCameraMakeup::processPreview(mm_camera_buf_def_t *frame, QCameraStream *stream)
+{
+    int white, clean;
+    cam_dimension_t dim;
+    TSRect rect;
+    TSMakeupData in;
+
+    if ((frame == NULL) || (stream == NULL)) {
+        ALOGE("%s: invalid frame or stream", __func__);
+        return false;
+    }
+    stream->getFrameDimension(dim);
+    if (!getParams(white, clean) || !getTrack(dim, rect, false)) {
+        pthread_mutex_lock(&m_lock);
+        m_stats.preview_skipped++;
+        pthread_mutex_unlock(&m_lock);
+        return false;
+    }
+
+    nsecs_t start = systemTime();
+    nsecs_t copyNs = 0;
+    bool done = getInput(frame, stream, m_previewBufs, in, copyNs) &&
+            beautify(frame, stream, m_previewBufs, in, rect, white, clean, copyNs);
+    nsecs_t spent = systemTime() - start;
+
+    pthread_mutex_lock(&m_lock);
+    if (done) {
+        m_stats.preview_frames++;
+        m_stats.preview_total_ns += spent;
+        m_stats.preview_copy_ns += copyNs;
+        if (spent > m_stats.preview_max_ns) {
+            m_stats.preview_max_ns = spent;
+        }
+    } else {
+        m_stats.preview_failed++;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return done;
+}
+
+/*===========================================================================
+ * FUNCTION   : processSnapshot
+ *
+ * DESCRIPTION: beautify a snapshot frame. The face comes from the preview
+ *              track when it still applies, otherwise from the detector.
+ *
+ * PARAMETERS :
+ *   @frame   : snapshot frame
+ *   @stream  : snapshot stream
+ *
+ * RETURN     : true -- frame was beautified
+ *              false -- frame is untouched
+ *==========================================================================*/
+bool QCameraMakeup::processSnapshot(mm_camera_buf_def_t *frame, QCameraStream *stream)
+{
+    int white, clean;
+    cam_dimension_t dim;
+    TSRect rect;
+    TSMakeupData in;
+    bool seeded = false;
+    bool detected = false;
+    bool done = false;
+
+    if ((frame == NULL) || (stream == NULL)) {
+        ALOGE("%s: invalid frame or stream", __func__);
+        return false;
+    }
+    if (!getParams(white, clean)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&m_snapshotLock);
+    nsecs_t start = systemTime();
+    nsecs_t copyNs = 0;
+    stream->getFrameDimension(dim);
+    if (getInput(frame, stream, m_snapshotBufs, in, copyNs)) {
+        seeded = getTrack(dim, rect, true);
+        detected = !seeded && detectFace(in, rect);
+        if (seeded || detected) {
+            done = beautify(frame, stream, m_snapshotBufs, in, rect,
+                    white, clean, copyNs);
+        }
+    }
+    nsecs_t spent = systemTime() - start;
+    pthread_mutex_unlock(&m_snapshotLock);
+
+    CDBG_HIGH("%s: %s, face from %s, %lld us", __func__,
+            done ? "done" : "skipped",
+            seeded ? "preview" : (detected ? "detector" : "none"),
+            (long long)(spent / 1000));
+    pthread_mutex_lock(&m_lock);
+    if (seeded) {
+        m_stats.seeded++;
+    } else if (detected) {
+        m_stats.detected++;
+    }
+    if (done) {
+        m_stats.snapshot_frames++;
+        m_stats.snapshot_total_ns += spent;
+        if (spent > m_stats.snapshot_max_ns) {
+            m_stats.snapshot_max_ns = spent;
+        }
+    } else {
+        m_stats.snapshot_failed++;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return done;
+}
+
+/*===========================================================================
+ * FUNCTION   : startWorker
+ *
+ * DESCRIPTION: start the worker thread that beautifies and displays
+ *              preview frames queued by queuePreview
+ *
+ * PARAMETERS :
+ *   @fn        : called on the worker for every queued frame
+ *   @user_data : passed to fn
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraMakeup::startWorker(makeup_frame_fn fn, void *user_data)
+{
+    int32_t rc = NO_ERROR;
+
+    pthread_mutex_lock(&m_workerLock);
+    if (!m_workerActive) {
+        m_frameFn = fn;
+        m_userData = user_data;
+        rc = m_workerTh.launch(workerRoutine, this);
+        m_workerActive = (rc == NO_ERROR);
+    }
+    pthread_mutex_unlock(&m_workerLock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : queuePreview
+ *
+ * DESCRIPTION: hand a preview frame to the worker. When MAX_PENDING_FRAMES
+ *              are already waiting the oldest is returned to its stream,
+ *              so display latency stays bounded. While the worker runs it
+ *              owns m_previewBufs and the display, so a frame it can not
+ *              queue is returned to its stream as well instead of being
+ *              left to the caller. Only the preview stream thread calls
+ *              this.
+ *
+ * PARAMETERS :
+ *   @super_frame : preview super buffer, owned by the worker on success
+ *   @stream      : preview stream
+ *
+ * RETURN     : true -- frame is queued or returned to its stream
+ *              false -- no worker, caller keeps the frame
+ *==========================================================================*/
+bool QCameraMakeup::queuePreview(mm_camera_super_buf_t *super_frame,
+        QCameraStream *stream)
+{
+    bool taken = false;
+    uint32_t dropped = 0;
+
+    pthread_mutex_lock(&m_workerLock);
+    if (m_workerActive) {
+        qcamera_makeup_node_t *node =
+                (qcamera_makeup_node_t *)malloc(sizeof(qcamera_makeup_node_t));
+        if (node != NULL) {
+            node->super_frame = super_frame;
+            node->stream = stream;
+            node->queued = systemTime();
+            if (m_frameQ.getCurrentSize() >= (int)MAX_PENDING_FRAMES) {
+                void *oldest = m_frameQ.dequeue();
+                if (oldest != NULL) {
+                    releaseFrame(oldest, this);
+                    free(oldest);
+                    dropped++;
+                }
+            }
+            if (m_frameQ.enqueue((void *)node)) {
+                m_workerTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+                pthread_mutex_lock(&m_lock);
+                m_stats.queued++;
+                pthread_mutex_unlock(&m_lock);
+            } else {
+                ALOGE("%s: Error adding frame into queue", __func__);
+                releaseFrame(node, this);
+                free(node);
+                dropped++;
+            }
+        } else {
+            ALOGE("%s: No memory for queue node", __func__);
+            if (super_frame->bufs[0] != NULL) {
+                stream->bufDone(super_frame->bufs[0]->buf_idx);
+            }
+            free(super_frame);
+            dropped++;
+        }
+        taken = true;
+    }
+    pthread_mutex_unlock(&m_workerLock);
+
+    if (dropped > 0) {
+        pthread_mutex_lock(&m_lock);
+        m_stats.dropped += dropped;
+        pthread_mutex_unlock(&m_lock);
+    }
+    return taken;
+}
+
+/*===========================================================================
+ * FUNCTION   : stopWorker
+ *
+ * DESCRIPTION: stop the worker and return queued frames to their streams.
+ *              Must be called before the preview stream stops; later
+ *              frames are processed by the caller of queuePreview.
+ *              The worker is joined before it is marked inactive, so a
+ *              frame arriving meanwhile waits on m_workerLock instead of
+ *              being processed inline while the worker still uses
+ *              m_previewBufs and the display.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::stopWorker()
+{
+    pthread_mutex_lock(&m_workerLock);
+    if (m_workerActive) {
+        m_workerTh.exit();
+        m_frameQ.flush();
+        m_workerActive = false;
+    }
+    pthread_mutex_unlock(&m_workerLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseFrame
+ *
+ * DESCRIPTION: return a queued preview frame to its stream undisplayed.
+ *              The node itself is freed by the queue.
+ *
+ * PARAMETERS :
+ *   @data      : queue node
+ *   @user_data : context data
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::releaseFrame(void *data, void */*user_data*/)
+{
+    qcamera_makeup_node_t *node = (qcamera_makeup_node_t *)data;
+
+    if (node != NULL) {
+        mm_camera_super_buf_t *super_frame = node->super_frame;
+        if ((super_frame != NULL) && (super_frame->bufs[0] != NULL)) {
+            node->stream->bufDone(super_frame->bufs[0]->buf_idx);
+        }
+        free(super_frame);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : workerRoutine
+ *
+ * DESCRIPTION: worker thread, passes queued preview frames to the frame
+ *              function in arrival order
+ *
+ * PARAMETERS :
+ *   @data    : context data
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraMakeup::workerRoutine(void *data)
+{
+    int running = 1;
+    int ret;
+    QCameraMakeup *pme = (QCameraMakeup *)data;
+    QCameraCmdThread *cmdThread = &pme->m_workerTh;
+    cmdThread->setName("CAM_makeup");
+
+    CDBG("%s: E", __func__);
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                CDBG("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            {
+                // frames dropped by the producer leave extra wakeups
+                qcamera_makeup_node_t *node =
+                    (qcamera_makeup_node_t *)pme->m_frameQ.dequeue();
+                if (node == NULL) {
+                    break;
+                }
+                nsecs_t wait = systemTime() - node->queued;
+                pthread_mutex_lock(&pme->m_lock);
+                pme->m_stats.queue_wait_total_ns += wait;
+                if (wait > pme->m_stats.queue_wait_max_ns) {
+                    pme->m_stats.queue_wait_max_ns = wait;
+                }
+                pthread_mutex_unlock(&pme->m_lock);
+                pme->m_frameFn(node->super_frame, node->stream, pme->m_userData);
+                free(node);
+            }
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            {
+                running = 0;
+                pme->m_frameQ.flush();
+            }
+            break;
+        default:
+            break;
+        }
+    } while (running);
+    CDBG("%s: X", __func__);
+
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : releasePreview
+ *
+ * DESCRIPTION: free the preview work buffers and finish the makeup library
+ *              once preview has stopped, and log the session statistics
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::releasePreview()
+{
+    qcamera_makeup_stats_t stats;
+
+    stopWorker();
+    freeBufs(m_previewBufs);
+    clearFaceTrack();
+    ts_makeup_finish();
+
+    getStats(stats);
+    if ((stats.preview_frames > 0) || (stats.snapshot_frames > 0)) {
+        uint32_t n = (stats.preview_frames > 0) ? stats.preview_frames : 1;
+        CDBG_HIGH("%s: preview %u frames avg %lld max %lld us (copy %lld us), "
+                "skipped %u failed %u, dropped %u; snapshot %u frames "
+                "avg %lld us, seeded %u detected %u",
+                __func__, stats.preview_frames,
+                (long long)(stats.preview_total_ns / n / 1000),
+                (long long)(stats.preview_max_ns / 1000),
+                (long long)(stats.preview_copy_ns / n / 1000),
+                stats.preview_skipped, stats.preview_failed, stats.dropped,
+                stats.snapshot_frames,
+                (long long)(stats.snapshot_total_ns /
+                        (stats.snapshot_frames > 0 ? stats.snapshot_frames : 1) / 1000),
+                stats.seeded, stats.detected);
+    }
+    resetStats();
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseSnapshot
+ *
+ * DESCRIPTION: free the snapshot work buffers once a capture is over
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::releaseSnapshot()
+{
+    pthread_mutex_lock(&m_snapshotLock);
+    freeBufs(m_snapshotBufs);
+    pthread_mutex_unlock(&m_snapshotLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : release
+ *
+ * DESCRIPTION: free everything including the detector context, when the
+ *              camera closes
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::release()
+{
+    stopWorker();
+    freeBufs(m_previewBufs);
+
+    pthread_mutex_lock(&m_snapshotLock);
+    freeBufs(m_snapshotBufs);
+    if (m_detector != NULL) {
+        ts_detectface_destroy_context(&m_detector);
+        m_detector = NULL;
+    }
+    pthread_mutex_unlock(&m_snapshotLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: copy the cost statistics
+ *
+ * PARAMETERS :
+ *   @stats   : filled with the statistics
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::getStats(qcamera_makeup_stats_t &stats)
+{
+    pthread_mutex_lock(&m_lock);
+    stats = m_stats;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : resetStats
+ *
+ * DESCRIPTION: clear the cost statistics, buffer accounting is kept
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMakeup::resetStats()
+{
+    pthread_mutex_lock(&m_lock);
+    size_t held = m_stats.buffer_bytes;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.buffer_bytes = held;
+    pthread_mutex_unlock(&m_lock);
+}
+
+}; // namespace qcamera
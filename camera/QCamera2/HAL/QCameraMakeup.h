@@ -0,0 +1,166 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_MAKEUP_H__
+#define __QCAMERA_MAKEUP_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <utils/Timers.h>
+#include "QCameraBoundedQueue.h"
+#include "QCameraCmdThread.h"
+#include "QCameraStream.h"
+#include "ts_makeup_engine.h"
+#include "ts_detectface_engine.h"
+
+extern "C" {
+#include <mm_camera_interface.h>
+}
+
+namespace qcamera {
+
+// runs the rest of the preview pipeline for a frame on the makeup worker
+typedef void (*makeup_frame_fn)(mm_camera_super_buf_t *super_frame,
+        QCameraStream *stream, void *user_data);
+
+typedef struct {
+    uint32_t preview_frames;        // preview frames beautified
+    uint32_t preview_skipped;       // makeup off or no face tracked
+    uint32_t preview_failed;
+    nsecs_t preview_total_ns;       // whole stage, copies included
+    nsecs_t preview_max_ns;
+    nsecs_t preview_copy_ns;        // de-padding and write back part
+    uint32_t snapshot_frames;
+    uint32_t snapshot_failed;       // includes snapshots without a face
+    nsecs_t snapshot_total_ns;
+    nsecs_t snapshot_max_ns;
+    uint32_t seeded;                // snapshot face taken from preview track
+    uint32_t detected;              // snapshot face found by the detector
+    nsecs_t detect_total_ns;
+    uint32_t queued;                // frames handed to the worker
+    uint32_t dropped;               // oldest frame released when it fell behind
+    nsecs_t queue_wait_total_ns;
+    nsecs_t queue_wait_max_ns;
+    size_t buffer_bytes;            // work buffers held
+} qcamera_makeup_stats_t;
+
+/*
+ * TS makeup (skin beauty) stage for preview and snapshot frames.
+ *
+ * Levels are cached when the app sets parameters, so frames never take
+ * the parameter lock. De-padding and output buffers are kept per path and
+ * only grow, and frames whose planes are already tightly packed are read
+ * in place. The face detector context lives as long as the camera and is
+ * only used for a snapshot when the preview face track is missing, too old
+ * or from a different aspect ratio.
+ *
+ * With persist.camera.makeup.async=1 preview frames are handed to a worker
+ * thread which beautifies and displays them, so the stream thread is free
+ * for the next frame. At most MAX_PENDING_FRAMES wait for the worker; the
+ * oldest is returned to the stream when it falls behind.
+ */
+class QCameraMakeup {
+public:
+    QCameraMakeup();
+    virtual ~QCameraMakeup();
+
+    void setParams(const char *enable, int whiten, int clean);
+    void setFaceTrack(const cam_rect_t &face, const cam_dimension_t &dim);
+    void clearFaceTrack();
+
+    bool processPreview(mm_camera_buf_def_t *frame, QCameraStream *stream);
+    bool processSnapshot(mm_camera_buf_def_t *frame, QCameraStream *stream);
+
+    int32_t startWorker(makeup_frame_fn fn, void *user_data);
+    bool queuePreview(mm_camera_super_buf_t *super_frame, QCameraStream *stream);
+    void stopWorker();
+
+    void releasePreview();
+    void releaseSnapshot();
+    void release();
+    void getStats(qcamera_makeup_stats_t &stats);
+    void resetStats();
+
+    static void *workerRoutine(void *data);
+    static void releaseFrame(void *data, void *user_data);
+
+private:
+    static const uint32_t MAX_PENDING_FRAMES = 2;
+    static const nsecs_t MAX_TRACK_AGE_NS = 500000000LL;
+
+    typedef struct {
+        uint8_t *in;            // tightly packed copy of a padded frame
+        size_t inSize;
+        uint8_t *out;           // library output, written back to the frame
+        size_t outSize;
+    } qcamera_makeup_bufs_t;
+
+    typedef struct {
+        mm_camera_super_buf_t *super_frame;
+        QCameraStream *stream;
+        nsecs_t queued;
+    } qcamera_makeup_node_t;
+
+    bool getParams(int &white, int &clean);
+    bool getTrack(const cam_dimension_t &dim, TSRect &rect, bool snapshot);
+    bool detectFace(TSMakeupData &data, TSRect &rect);
+    bool beautify(mm_camera_buf_def_t *frame, QCameraStream *stream,
+            qcamera_makeup_bufs_t &bufs, TSMakeupData &in, const TSRect &rect,
+            int white, int clean, nsecs_t &copyNs);
+    bool getInput(mm_camera_buf_def_t *frame, QCameraStream *stream,
+            qcamera_makeup_bufs_t &bufs, TSMakeupData &data, nsecs_t &copyNs);
+    bool ensure(uint8_t *&buf, size_t &size, size_t needed);
+    void freeBufs(qcamera_makeup_bufs_t &bufs);
+
+    pthread_mutex_t m_lock;         // params, face track, stats
+    bool m_enabled;
+    int m_white;
+    int m_clean;
+    TSRect m_track;                 // last preview face, -1 if none
+    cam_dimension_t m_trackDim;     // frame size the track refers to
+    nsecs_t m_trackTime;
+
+    pthread_mutex_t m_snapshotLock; // snapshot buffers and detector
+    qcamera_makeup_bufs_t m_previewBufs;
+    qcamera_makeup_bufs_t m_snapshotBufs;
+    TSHandle m_detector;
+
+    pthread_mutex_t m_workerLock;
+    bool m_workerActive;
+    makeup_frame_fn m_frameFn;
+    void *m_userData;
+    QCameraBoundedQueue m_frameQ;
+    QCameraCmdThread m_workerTh;
+
+    qcamera_makeup_stats_t m_stats;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_MAKEUP_H__ */
@@ -31,10 +31,12 @@
 #define LOG_TAG "QCameraHWI_Mem"
 
 #include <string.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <utils/Errors.h>
 #include <utils/Trace.h>
+#include <cutils/properties.h>
 #include <gralloc_priv.h>
 #include <QComOMXMetadata.h>
 #include <qdMetaData.h>
@@ -45,8 +47,19 @@
 
 extern "C" {
 #include <mm_camera_interface.h>
+#ifdef QCAMERA_SYNTH_ION
+#include <mm_camera_synth.h>
+#endif
 }
 
+#ifdef QCAMERA_SYNTH_ION
+#define ION_DEVICE_OPEN()          mm_camera_synth_ion_open()
+#define ION_IOCTL(fd, req, arg)    mm_camera_synth_ion_ioctl((fd), (req), (arg))
+#else
+#define ION_DEVICE_OPEN()          open("/dev/ion", O_RDONLY)
+#define ION_IOCTL(fd, req, arg)    ioctl((fd), (req), (arg))
+#endif
+
 using namespace android;
 
 namespace qcamera {
@@ -133,7 +146,7 @@ int QCameraMemory::cacheOpsInternal(uint32_t index, unsigned int cmd, void *vadd
          __func__, cache_inv_data.vaddr, cache_inv_data.fd,
          (unsigned long)cache_inv_data.handle, cache_inv_data.length,
          mMemInfo[index].main_ion_fd);
-    ret = ioctl(mMemInfo[index].main_ion_fd, ION_IOC_CUSTOM, &custom_data);
+    ret = ION_IOCTL(mMemInfo[index].main_ion_fd, ION_IOC_CUSTOM, &custom_data);
     if (ret < 0)
         ALOGE("%s: Cache Invalidate failed: %s\n", __func__, strerror(errno));
 
@@ -190,6 +203,25 @@ uint8_t QCameraMemory::getCnt() const
     return mBufferCount;
 }
 
+/*===========================================================================
+ * FUNCTION   : getMatchBufIndex
+ *
+ * DESCRIPTION: query buffer index by opaque ptr. Subclasses register the
+ *              pointers they hand out as buffers are allocated, so this is
+ *              a table lookup rather than a scan of every buffer.
+ *
+ * PARAMETERS :
+ *   @opaque  : opaque ptr
+ *   @metadata: flag if it's metadata
+ *
+ * RETURN     : buffer index if match found,
+ *              -1 if failed
+ *==========================================================================*/
+int QCameraMemory::getMatchBufIndex(const void *opaque, bool metadata) const
+{
+    return metadata ? mMetaMap.find(opaque) : mBufMap.find(opaque);
+}
+
 /*===========================================================================
  * FUNCTION   : getBufDef
  *
@@ -386,7 +418,7 @@ int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo,
     struct ion_fd_data ion_info_fd;
     int main_ion_fd = 0;
 
-    main_ion_fd = open("/dev/ion", O_RDONLY);
+    main_ion_fd = ION_DEVICE_OPEN();
     if (main_ion_fd < 0) {
         ALOGE("Ion dev open failed: %s\n", strerror(errno));
         goto ION_OPEN_FAILED;
@@ -401,7 +433,7 @@ int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo,
         alloc.flags = ION_FLAG_CACHED;
     }
     alloc.heap_id_mask = heap_id;
-    rc = ioctl(main_ion_fd, ION_IOC_ALLOC, &alloc);
+    rc = ION_IOCTL(main_ion_fd, ION_IOC_ALLOC, &alloc);
     if (rc < 0) {
         ALOGE("ION allocation failed: %s\n", strerror(errno));
         goto ION_ALLOC_FAILED;
@@ -409,7 +441,7 @@ int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo,
 
     memset(&ion_info_fd, 0, sizeof(ion_info_fd));
     ion_info_fd.handle = alloc.handle;
-    rc = ioctl(main_ion_fd, ION_IOC_SHARE, &ion_info_fd);
+    rc = ION_IOCTL(main_ion_fd, ION_IOC_SHARE, &ion_info_fd);
     if (rc < 0) {
         ALOGE("ION map failed %s\n", strerror(errno));
         goto ION_MAP_FAILED;
@@ -419,6 +451,7 @@ int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo,
     memInfo.fd = ion_info_fd.fd;
     memInfo.handle = ion_info_fd.handle;
     memInfo.size = alloc.len;
+    memInfo.alloc_size = alloc.len;
     memInfo.cached = cached;
     memInfo.heap_id = heap_id;
 
@@ -429,7 +462,7 @@ int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo,
 ION_MAP_FAILED:
     memset(&handle_data, 0, sizeof(handle_data));
     handle_data.handle = ion_info_fd.handle;
-    ioctl(main_ion_fd, ION_IOC_FREE, &handle_data);
+    ION_IOCTL(main_ion_fd, ION_IOC_FREE, &handle_data);
 ION_ALLOC_FAILED:
     close(main_ion_fd);
 ION_OPEN_FAILED:
@@ -458,12 +491,13 @@ void QCameraMemory::deallocOneBuffer(QCameraMemInfo &memInfo)
     if (memInfo.main_ion_fd > 0) {
         memset(&handle_data, 0, sizeof(handle_data));
         handle_data.handle = memInfo.handle;
-        ioctl(memInfo.main_ion_fd, ION_IOC_FREE, &handle_data);
+        ION_IOCTL(memInfo.main_ion_fd, ION_IOC_FREE, &handle_data);
         close(memInfo.main_ion_fd);
         memInfo.main_ion_fd = 0;
     }
     memInfo.handle = 0;
     memInfo.size = 0;
+    memInfo.alloc_size = 0;
 }
 
 /*===========================================================================
@@ -476,7 +510,13 @@ void QCameraMemory::deallocOneBuffer(QCameraMemInfo &memInfo)
  * RETURN     : None
  *==========================================================================*/
 QCameraMemoryPool::QCameraMemoryPool()
+    : mSeq(0)
 {
+    char value[PROPERTY_VALUE_MAX];
+
+    memset(&mStats, 0, sizeof(mStats));
+    property_get("persist.camera.mem.pool.budget", value, "64");
+    mStats.budget = (size_t)atoi(value) << 20;
     pthread_mutex_init(&mLock, NULL);
 }
 
@@ -496,6 +536,60 @@ QCameraMemoryPool::~QCameraMemoryPool()
     pthread_mutex_destroy(&mLock);
 }
 
+/*===========================================================================
+ * FUNCTION   : sizeClass
+ *
+ * DESCRIPTION: maps a buffer size to its bucket. Each power of two from 4KB
+ *              up is split in four classes; everything below 4KB shares
+ *              class 0 and everything beyond the table the last class.
+ *
+ * PARAMETERS :
+ *   @size    : size of the buffer
+ *
+ * RETURN     : size class index
+ *==========================================================================*/
+int QCameraMemoryPool::sizeClass(size_t size)
+{
+    if (size <= 4096) {
+        return 0;
+    }
+
+    int msb = 0;
+    while ((size >> msb) > 1) {
+        msb++;
+    }
+    int cls = (msb - 12) * 4 + (int)((size >> (msb - 2)) & 3);
+    return (cls < MAX_SIZE_CLASSES) ? cls : MAX_SIZE_CLASSES - 1;
+}
+
+/*===========================================================================
+ * FUNCTION   : isCompatible
+ *
+ * DESCRIPTION: checks whether a cached buffer can serve a request
+ *
+ * PARAMETERS :
+ *   @memInfo : cached buffer
+ *   @heap_id : requested heap mask
+ *   @size    : requested page aligned size
+ *   @cached  : whether the buffer should be cached
+ *   @exact   : size has to match exactly
+ *
+ * RETURN     : true if the buffer fits
+ *==========================================================================*/
+bool QCameraMemoryPool::isCompatible(
+        const struct QCameraMemory::QCameraMemInfo &memInfo,
+        unsigned int heap_id, size_t size, bool cached, bool exact)
+{
+    if ((memInfo.cached != cached) ||
+            ((memInfo.heap_id & ~heap_id) != 0)) {
+        return false;
+    }
+    if (exact) {
+        return memInfo.alloc_size == size;
+    }
+    return (memInfo.alloc_size >= size) && (memInfo.alloc_size <= 2 * size);
+}
+
 /*===========================================================================
  * FUNCTION   : releaseBuffer
  *
@@ -509,12 +603,96 @@ QCameraMemoryPool::~QCameraMemoryPool()
  *==========================================================================*/
 void QCameraMemoryPool::releaseBuffer(
         struct QCameraMemory::QCameraMemInfo &memInfo,
-        cam_stream_type_t streamType)
+        cam_stream_type_t /*streamType*/)
 {
     pthread_mutex_lock(&mLock);
 
-    mPools[streamType].push_back(memInfo);
+    addBufferLocked(memInfo);
+    trimLocked(mStats.budget);
+
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : addBufferLocked
+ *
+ * DESCRIPTION: files an idle buffer in its size class bucket
+ *
+ * PARAMETERS :
+ *   @memInfo : buffer to be cached
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::addBufferLocked(
+        struct QCameraMemory::QCameraMemInfo &memInfo)
+{
+    QCameraPoolEntry entry;
+
+    if (memInfo.alloc_size < memInfo.size) {
+        memInfo.alloc_size = memInfo.size;
+    }
+    entry.memInfo = memInfo;
+    entry.seq = ++mSeq;
+    mBuckets[sizeClass(memInfo.alloc_size)].push_back(entry);
+
+    mStats.buffers++;
+    mStats.bytesHeld += memInfo.alloc_size;
+    if (mStats.bytesHeld > mStats.peakBytesHeld) {
+        mStats.peakBytesHeld = mStats.bytesHeld;
+    }
+}
 
+/*===========================================================================
+ * FUNCTION   : trimLocked
+ *
+ * DESCRIPTION: frees the least recently released buffers until the idle
+ *              bytes held fit in the given limit. The front of every bucket
+ *              is its oldest entry, so only the fronts are compared.
+ *
+ * PARAMETERS :
+ *   @limit   : max idle bytes to keep
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::trimLocked(size_t limit)
+{
+    while (mStats.bytesHeld > limit) {
+        int oldest = -1;
+        for (int i = 0; i < MAX_SIZE_CLASSES; i++) {
+            if (!mBuckets[i].empty() && ((oldest < 0) ||
+                    ((*mBuckets[i].begin()).seq <
+                     (*mBuckets[oldest].begin()).seq))) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+
+        List<QCameraPoolEntry>::iterator it = mBuckets[oldest].begin();
+        size_t size = (*it).memInfo.alloc_size;
+        QCameraMemory::deallocOneBuffer((*it).memInfo);
+        mBuckets[oldest].erase(it);
+
+        mStats.buffers--;
+        mStats.bytesHeld -= size;
+        mStats.evictions++;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : trim
+ *
+ * DESCRIPTION: frees idle buffers beyond the budget
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::trim()
+{
+    pthread_mutex_lock(&mLock);
+    trimLocked(mStats.budget);
     pthread_mutex_unlock(&mLock);
 }
 
@@ -531,14 +709,21 @@ void QCameraMemoryPool::clear()
 {
     pthread_mutex_lock(&mLock);
 
-    for (int i = CAM_STREAM_TYPE_DEFAULT; i < CAM_STREAM_TYPE_MAX; i++ ) {
-        List<struct QCameraMemory::QCameraMemInfo>::iterator it = mPools[i].begin();
-        for( ; it != mPools[i].end() ; it++) {
-            QCameraMemory::deallocOneBuffer(*it);
+    CDBG_HIGH("%s: hits %u misses %u evictions %u, held %u bufs %zu bytes, "
+            "peak %zu bytes", __func__, mStats.hits, mStats.misses,
+            mStats.evictions, mStats.buffers, mStats.bytesHeld,
+            mStats.peakBytesHeld);
+
+    for (int i = 0; i < MAX_SIZE_CLASSES; i++ ) {
+        List<QCameraPoolEntry>::iterator it = mBuckets[i].begin();
+        for( ; it != mBuckets[i].end() ; it++) {
+            QCameraMemory::deallocOneBuffer((*it).memInfo);
         }
 
-        mPools[i].clear();
+        mBuckets[i].clear();
     }
+    mStats.buffers = 0;
+    mStats.bytesHeld = 0;
 
     pthread_mutex_unlock(&mLock);
 }
@@ -546,12 +731,14 @@ void QCameraMemoryPool::clear()
 /*===========================================================================
  * FUNCTION   : findBufferLocked
  *
- * DESCRIPTION: search for a appropriate cached buffer
+ * DESCRIPTION: search for the best fitting cached buffer, starting at the
+ *              size class of the request and stopping once buffers would be
+ *              more than twice as large
  *
  * PARAMETERS :
  *   @memInfo : reference to struct that stores additional memory allocation info
  *   @heap_id : type of heap
- *   @size    : size of the buffer
+ *   @size    : page aligned size of the buffer
  *   @cached  : whether the buffer should be cached
  *   @streaType: type of stream this buffer belongs to
  *
@@ -563,42 +750,71 @@ int QCameraMemoryPool::findBufferLocked(
         struct QCameraMemory::QCameraMemInfo &memInfo, unsigned int heap_id,
         size_t size, bool cached, cam_stream_type_t streamType)
 {
-    int rc = NAME_NOT_FOUND;
+    bool exact = (streamType == CAM_STREAM_TYPE_OFFLINE_PROC);
+    int first = sizeClass(size);
+    int last = exact ? first : sizeClass(2 * size);
+    List<QCameraPoolEntry>::iterator best;
+    int bestClass = -1;
+
+    for (int i = first; i <= last && bestClass < 0; i++) {
+        List<QCameraPoolEntry>::iterator it = mBuckets[i].begin();
+        for( ; it != mBuckets[i].end() ; it++) {
+            if (!isCompatible((*it).memInfo, heap_id, size, cached, exact)) {
+                continue;
+            }
+            // smallest fit, most recently released on a tie
+            if ((bestClass < 0) ||
+                    ((*it).memInfo.alloc_size <=
+                     (*best).memInfo.alloc_size)) {
+                best = it;
+                bestClass = i;
+            }
+        }
+    }
 
-    if (mPools[streamType].empty()) {
+    if (bestClass < 0) {
         return NAME_NOT_FOUND;
     }
 
-    List<struct QCameraMemory::QCameraMemInfo>::iterator it = mPools[streamType].begin();
-    if (streamType == CAM_STREAM_TYPE_OFFLINE_PROC) {
-        for( ; it != mPools[streamType].end() ; it++) {
-            if( ((*it).size == size) &&
-                    ((*it).heap_id == heap_id) &&
-                    ((*it).cached == cached) ) {
-                memInfo = *it;
-                ALOGE("%s : Found buffer %lx size %d",
-                        __func__, (unsigned long)memInfo.handle, memInfo.size);
-                mPools[streamType].erase(it);
-                rc = NO_ERROR;
-                break;
-            }
-        }
-    } else {
-        for( ; it != mPools[streamType].end() ; it++) {
-            if(((*it).size >= size) &&
-                    ((*it).heap_id == heap_id) &&
-                    ((*it).cached == cached) ) {
-                memInfo = *it;
-                ALOGE("%s : Found buffer %lx size %d",
-                        __func__, (unsigned long)memInfo.handle, memInfo.size);
-                mPools[streamType].erase(it);
-                rc = NO_ERROR;
-                break;
+    memInfo = (*best).memInfo;
+    memInfo.size = size;
+    mBuckets[bestClass].erase(best);
+    mStats.buffers--;
+    mStats.bytesHeld -= memInfo.alloc_size;
+    CDBG("%s : Found buffer %lx size %zu for %zu", __func__,
+            (unsigned long)memInfo.handle, memInfo.alloc_size, size);
+
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : countBuffersLocked
+ *
+ * DESCRIPTION: counts cached buffers which could serve a request
+ *
+ * PARAMETERS :
+ *   @heap_id : type of heap
+ *   @size    : page aligned size of the buffer
+ *   @cached  : whether the buffer should be cached
+ *
+ * RETURN     : number of matching buffers
+ *==========================================================================*/
+int QCameraMemoryPool::countBuffersLocked(unsigned int heap_id, size_t size,
+        bool cached)
+{
+    int count = 0;
+    int last = sizeClass(2 * size);
+
+    for (int i = sizeClass(size); i <= last; i++) {
+        List<QCameraPoolEntry>::iterator it = mBuckets[i].begin();
+        for( ; it != mBuckets[i].end() ; it++) {
+            if (isCompatible((*it).memInfo, heap_id, size, cached, false)) {
+                count++;
             }
         }
     }
 
-    return rc;
+    return count;
 }
 
 /*===========================================================================
@@ -623,13 +839,17 @@ int QCameraMemoryPool::allocateBuffer(
         size_t size, bool cached, cam_stream_type_t streamType)
 {
     int rc = NO_ERROR;
+    size_t len = (size + 4095U) & (~4095U);
 
     pthread_mutex_lock(&mLock);
 
-    rc = findBufferLocked(memInfo, heap_id, size, cached, streamType);
+    rc = findBufferLocked(memInfo, heap_id, len, cached, streamType);
     if (NAME_NOT_FOUND == rc ) {
-        ALOGE("%s : Buffer not found!", __func__);
+        CDBG_HIGH("%s : Buffer not found!", __func__);
+        mStats.misses++;
         rc = QCameraMemory::allocOneBuffer(memInfo, heap_id, size, cached);
+    } else {
+        mStats.hits++;
     }
 
     pthread_mutex_unlock(&mLock);
@@ -637,6 +857,337 @@ int QCameraMemoryPool::allocateBuffer(
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : preload
+ *
+ * DESCRIPTION: allocates buffers ahead of an upcoming configuration so
+ *              that the streams find them in the pool. Buffers already
+ *              cached which would fit count towards the total, and no
+ *              buffer is added once it would take the pool over budget.
+ *
+ * PARAMETERS :
+ *   @heap_id : type of heap
+ *   @size    : size of the buffers
+ *   @cached  : whether the buffers should be cached
+ *   @count   : number of buffers wanted
+ *
+ * RETURN     : number of matching buffers cached after the call
+ *==========================================================================*/
+int QCameraMemoryPool::preload(unsigned int heap_id, size_t size, bool cached,
+        int count)
+{
+    size_t len = (size + 4095U) & (~4095U);
+
+    int ready = 0;
+
+    pthread_mutex_lock(&mLock);
+    ready = countBuffersLocked(heap_id, len, cached);
+    bool room = (mStats.bytesHeld + len <= mStats.budget);
+    pthread_mutex_unlock(&mLock);
+
+    // allocate unlocked, streams may be allocating from the pool meanwhile
+    while ((ready < count) && room) {
+        struct QCameraMemory::QCameraMemInfo memInfo;
+        memset(&memInfo, 0, sizeof(memInfo));
+        if (QCameraMemory::allocOneBuffer(memInfo, heap_id, size, cached) < 0) {
+            ALOGE("%s: preload of %zu bytes failed", __func__, len);
+            break;
+        }
+
+        pthread_mutex_lock(&mLock);
+        room = (mStats.bytesHeld + len <= mStats.budget);
+        if (room) {
+            addBufferLocked(memInfo);
+            ready++;
+        }
+        pthread_mutex_unlock(&mLock);
+
+        if (!room) {
+            QCameraMemory::deallocOneBuffer(memInfo);
+        }
+    }
+
+    CDBG_HIGH("%s: %d/%d buffers of %zu bytes ready", __func__, ready, count,
+            len);
+    return ready;
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: reads the pool counters
+ *
+ * PARAMETERS :
+ *   @stats   : [output] pool statistics
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::getStats(QCameraPoolStats &stats)
+{
+    pthread_mutex_lock(&mLock);
+    stats = mStats;
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraCallbackMemPool
+ *
+ * DESCRIPTION: default constructor of QCameraCallbackMemPool
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraCallbackMemPool::QCameraCallbackMemPool()
+    : mUseCount(0),
+      mHits(0),
+      mMisses(0),
+      mMapped(0)
+{
+    memset(mEntries, 0, sizeof(mEntries));
+    pthread_mutex_init(&mLock, NULL);
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraCallbackMemPool
+ *
+ * DESCRIPTION: deconstructor of QCameraCallbackMemPool
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraCallbackMemPool::~QCameraCallbackMemPool()
+{
+    clear();
+    pthread_mutex_destroy(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : get
+ *
+ * DESCRIPTION: returns an idle callback buffer matching fd, size and format,
+ *              or requests a new one from the framework. When the pool is
+ *              full the least recently used idle entry is evicted.
+ *
+ * PARAMETERS :
+ *   @getMemory : framework memory request function
+ *   @cookie    : framework callback cookie
+ *   @fd        : fd to map, -1 for a buffer the HAL copies into
+ *   @size      : size of the buffer
+ *   @fmt       : format of the frame carried by the buffer
+ *
+ * RETURN     : camera memory ptr, NULL on failure
+ *==========================================================================*/
+camera_memory_t *QCameraCallbackMemPool::get(camera_request_memory getMemory,
+        void *cookie, int fd, size_t size, cam_format_t fmt)
+{
+    camera_memory_t *mem = NULL;
+    camera_memory_t *evicted = NULL;
+    int match = -1;
+    int victim = -1;
+    int slot = -1;
+
+    if (NULL == getMemory) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < MAX_CB_MEM_ENTRIES; i++) {
+        QCameraCbMemEntry &e = mEntries[i];
+        if (NULL == e.mem) {
+            if (slot < 0) {
+                slot = i;
+            }
+        } else if (!e.busy) {
+            if ((e.fd == fd) && (e.size == size) && (e.fmt == fmt)) {
+                if ((match < 0) || (e.lastUse < mEntries[match].lastUse)) {
+                    match = i;
+                }
+            } else if ((victim < 0) ||
+                    (e.lastUse < mEntries[victim].lastUse)) {
+                victim = i;
+            }
+        }
+    }
+
+    if (match >= 0) {
+        mEntries[match].busy = true;
+        mHits++;
+        if (fd >= 0) {
+            mMapped++;
+        }
+        mem = mEntries[match].mem;
+        pthread_mutex_unlock(&mLock);
+        return mem;
+    }
+
+    if ((slot < 0) && (victim >= 0)) {
+        evicted = mEntries[victim].mem;
+        memset(&mEntries[victim], 0, sizeof(QCameraCbMemEntry));
+        slot = victim;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    if (NULL != evicted) {
+        evicted->release(evicted);
+    }
+
+    mem = getMemory(fd, size, 1, cookie);
+    if ((NULL == mem) || (NULL == mem->data)) {
+        ALOGE("%s: getMemory failed for size %zu", __func__, size);
+        if (NULL != mem) {
+            mem->release(mem);
+        }
+        return NULL;
+    }
+
+    pthread_mutex_lock(&mLock);
+    mMisses++;
+    if (fd >= 0) {
+        mMapped++;
+    }
+    // with every slot busy the buffer is not pooled and put() releases it
+    if ((slot >= 0) && (NULL == mEntries[slot].mem)) {
+        QCameraCbMemEntry &e = mEntries[slot];
+        e.mem = mem;
+        e.fd = fd;
+        e.size = size;
+        e.fmt = fmt;
+        e.busy = true;
+        e.stale = false;
+        e.lastUse = mUseCount;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    return mem;
+}
+
+/*===========================================================================
+ * FUNCTION   : put
+ *
+ * DESCRIPTION: returns a buffer obtained by get() to the pool
+ *
+ * PARAMETERS :
+ *   @mem     : camera memory ptr
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraCallbackMemPool::put(camera_memory_t *mem)
+{
+    bool release = true;
+
+    if (NULL == mem) {
+        return;
+    }
+
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < MAX_CB_MEM_ENTRIES; i++) {
+        QCameraCbMemEntry &e = mEntries[i];
+        if (e.mem == mem) {
+            if (e.stale) {
+                memset(&e, 0, sizeof(QCameraCbMemEntry));
+            } else {
+                e.busy = false;
+                e.lastUse = ++mUseCount;
+                release = false;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+
+    if (release) {
+        mem->release(mem);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : clear
+ *
+ * DESCRIPTION: releases all idle buffers. Buffers still held by the app are
+ *              marked stale and released when they are returned.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraCallbackMemPool::clear()
+{
+    camera_memory_t *idle[MAX_CB_MEM_ENTRIES];
+    int count = 0;
+
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < MAX_CB_MEM_ENTRIES; i++) {
+        QCameraCbMemEntry &e = mEntries[i];
+        if (NULL == e.mem) {
+            continue;
+        }
+        if (e.busy) {
+            e.stale = true;
+        } else {
+            idle[count++] = e.mem;
+            memset(&e, 0, sizeof(QCameraCbMemEntry));
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+
+    for (int i = 0; i < count; i++) {
+        idle[i]->release(idle[i]);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: reads the pool counters
+ *
+ * PARAMETERS :
+ *   @hits    : buffers served from the pool
+ *   @misses  : buffers requested from the framework
+ *   @mapped  : buffers that map a stream buffer instead of carrying a copy
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraCallbackMemPool::getStats(uint32_t &hits, uint32_t &misses,
+        uint32_t &mapped)
+{
+    pthread_mutex_lock(&mLock);
+    hits = mHits;
+    misses = mMisses;
+    mapped = mMapped;
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseCallbackMem
+ *
+ * DESCRIPTION: release callback matching camera_release_callback, hands the
+ *              buffer back to the pool passed as cookie
+ *
+ * PARAMETERS :
+ *   @data    : buffer to be returned
+ *   @cookie  : QCameraCallbackMemPool ptr
+ *   @cbStatus: callback status
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCallbackMemPool::releaseCallbackMem(void *data, void *cookie,
+        int32_t /*cbStatus*/)
+{
+    QCameraCallbackMemPool *pool = (QCameraCallbackMemPool *)cookie;
+    camera_memory_t *mem = (camera_memory_t *)data;
+
+    if (NULL == mem) {
+        return;
+    }
+    if (NULL != pool) {
+        pool->put(mem);
+    } else {
+        mem->release(mem);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : QCameraHeapMemory
  *
@@ -723,6 +1274,9 @@ int QCameraHeapMemory::allocate(uint8_t count, size_t size)
         } else
             mPtr[i] = vaddr;
     }
+    for (int i = 0; i < count; i ++) {
+        mBufMap.add(mPtr[i], i);
+    }
     if (rc == 0)
         mBufferCount = count;
     traceLogAllocEnd((size * count));
@@ -767,6 +1321,9 @@ int QCameraHeapMemory::allocateMore(uint8_t count, size_t size)
             mPtr[i] = vaddr;
         }
     }
+    for (int i = mBufferCount; i < count + mBufferCount; i ++) {
+        mBufMap.add(mPtr[i], i);
+    }
     mBufferCount = (uint8_t)(mBufferCount + count);
     traceLogAllocEnd((size * count));
     return OK;
@@ -783,6 +1340,7 @@ int QCameraHeapMemory::allocateMore(uint8_t count, size_t size)
  *==========================================================================*/
 void QCameraHeapMemory::deallocate()
 {
+    mBufMap.clear();
     for (int i = 0; i < mBufferCount; i++) {
         munmap(mPtr[i], mMemInfo[i].size);
         mPtr[i] = NULL;
@@ -845,34 +1403,6 @@ camera_memory_t *QCameraHeapMemory::getMemory(uint32_t /*index*/, bool /*metadat
     return NULL;
 }
 
-/*===========================================================================
- * FUNCTION   : getMatchBufIndex
- *
- * DESCRIPTION: query buffer index by opaque ptr
- *
- * PARAMETERS :
- *   @opaque  : opaque ptr
- *   @metadata: flag if it's metadata
- *
- * RETURN     : buffer index if match found,
- *              -1 if failed
- *==========================================================================*/
-int QCameraHeapMemory::getMatchBufIndex(const void *opaque,
-                                        bool metadata) const
-{
-    int index = -1;
-    if (metadata) {
-        return -1;
-    }
-    for (int i = 0; i < mBufferCount; i++) {
-        if (mPtr[i] == opaque) {
-            index = i;
-            break;
-        }
-    }
-    return index;
-}
-
 /*===========================================================================
  * FUNCTION   : QCameraStreamMemory
  *
@@ -932,6 +1462,9 @@ int QCameraStreamMemory::allocate(uint8_t count, size_t size)
 
     for (int i = 0; i < count; i ++) {
         mCameraMemory[i] = mGetMemory(mMemInfo[i].fd, mMemInfo[i].size, 1, this);
+        if (mCameraMemory[i] != NULL) {
+            mBufMap.add(mCameraMemory[i]->data, i);
+        }
     }
     mBufferCount = count;
     traceLogAllocEnd((size * count));
@@ -961,6 +1494,9 @@ int QCameraStreamMemory::allocateMore(uint8_t count, size_t size)
 
     for (int i = mBufferCount; i < mBufferCount + count; i++) {
         mCameraMemory[i] = mGetMemory(mMemInfo[i].fd, mMemInfo[i].size, 1, this);
+        if (mCameraMemory[i] != NULL) {
+            mBufMap.add(mCameraMemory[i]->data, i);
+        }
     }
     mBufferCount = (uint8_t)(mBufferCount + count);
     traceLogAllocEnd((size * count));
@@ -978,6 +1514,7 @@ int QCameraStreamMemory::allocateMore(uint8_t count, size_t size)
  *==========================================================================*/
 void QCameraStreamMemory::deallocate()
 {
+    mBufMap.clear();
     for (int i = 0; i < mBufferCount; i ++) {
         mCameraMemory[i]->release(mCameraMemory[i]);
         mCameraMemory[i] = NULL;
@@ -1045,34 +1582,6 @@ camera_memory_t *QCameraStreamMemory::getMemory(uint32_t index,
     return mCameraMemory[index];
 }
 
-/*===========================================================================
- * FUNCTION   : getMatchBufIndex
- *
- * DESCRIPTION: query buffer index by opaque ptr
- *
- * PARAMETERS :
- *   @opaque  : opaque ptr
- *   @metadata: flag if it's metadata
- *
- * RETURN     : buffer index if match found,
- *              -1 if failed
- *==========================================================================*/
-int QCameraStreamMemory::getMatchBufIndex(const void *opaque,
-                                          bool metadata) const
-{
-    int index = -1;
-    if (metadata) {
-        return -1;
-    }
-    for (int i = 0; i < mBufferCount; i++) {
-        if (mCameraMemory[i]->data == opaque) {
-            index = i;
-            break;
-        }
-    }
-    return index;
-}
-
 /*===========================================================================
  * FUNCTION   : getPtr
  *
@@ -1164,6 +1673,9 @@ int QCameraVideoMemory::allocate(uint8_t count, size_t size)
         nh->data[1] = 0;
         nh->data[2] = (int)mMemInfo[i].size;
     }
+    for (int i = 0; i < count; i ++) {
+        mMetaMap.add(mMetadata[i]->data, i);
+    }
     mBufferCount = count;
     traceLogAllocEnd((size * count));
     return NO_ERROR;
@@ -1185,33 +1697,47 @@ int QCameraVideoMemory::allocate(uint8_t count, size_t size)
 int QCameraVideoMemory::allocateMore(uint8_t count, size_t size)
 {
     traceLogAllocStart(size, count, "VideoMemsize");
+    // the stream memory already counts the new buffers when it returns
+    uint8_t first = mBufferCount;
     int rc = QCameraStreamMemory::allocateMore(count, size);
     if (rc < 0)
         return rc;
 
-    for (int i = mBufferCount; i < count + mBufferCount; i ++) {
+    for (int i = first; i < first + count; i ++) {
         mMetadata[i] = mGetMemory(-1,
                 sizeof(struct encoder_media_buffer_type), 1, this);
         if (!mMetadata[i]) {
             ALOGE("allocation of video metadata failed.");
-            for (int j = mBufferCount; j <= i-1; j ++) {
+            for (int j = first; j <= i-1; j ++) {
+                struct encoder_media_buffer_type * packet =
+                    (struct encoder_media_buffer_type *)mMetadata[j]->data;
+                native_handle_delete(
+                        const_cast<native_handle_t *>(packet->meta_handle));
                 mMetadata[j]->release(mMetadata[j]);
+                mMetadata[j] = NULL;
+            }
+            for (int j = first; j < first + count; j ++) {
+                mBufMap.remove(mCameraMemory[j]->data);
                 mCameraMemory[j]->release(mCameraMemory[j]);
                 mCameraMemory[j] = NULL;
-                deallocOneBuffer(mMemInfo[j]);;
+                deallocOneBuffer(mMemInfo[j]);
             }
+            mBufferCount = first;
             return NO_MEMORY;
         }
         struct encoder_media_buffer_type * packet =
             (struct encoder_media_buffer_type *)mMetadata[i]->data;
-        packet->meta_handle = native_handle_create(1, 2); //1 fd, 1 offset and 1 size
+        //1 fd, 1 offset, 1 size, 1 color transform
+        packet->meta_handle = native_handle_create(1, 3);
         packet->buffer_type = kMetadataBufferTypeCameraSource;
         native_handle_t * nh = const_cast<native_handle_t *>(packet->meta_handle);
         nh->data[0] = mMemInfo[i].fd;
         nh->data[1] = 0;
         nh->data[2] = (int)mMemInfo[i].size;
     }
-    mBufferCount = (uint8_t)(mBufferCount + count);
+    for (int i = first; i < first + count; i ++) {
+        mMetaMap.add(mMetadata[i]->data, i);
+    }
     traceLogAllocEnd((size * count));
     return NO_ERROR;
 }
@@ -1227,6 +1753,7 @@ int QCameraVideoMemory::allocateMore(uint8_t count, size_t size)
  *==========================================================================*/
 void QCameraVideoMemory::deallocate()
 {
+    mMetaMap.clear();
     for (int i = 0; i < mBufferCount; i ++) {
         struct encoder_media_buffer_type * packet =
             (struct encoder_media_buffer_type *)mMetadata[i]->data;
@@ -1274,38 +1801,6 @@ camera_memory_t *QCameraVideoMemory::getMemory(uint32_t index,
         return mCameraMemory[index];
 }
 
-/*===========================================================================
- * FUNCTION   : getMatchBufIndex
- *
- * DESCRIPTION: query buffer index by opaque ptr
- *
- * PARAMETERS :
- *   @opaque  : opaque ptr
- *   @metadata: flag if it's metadata
- *
- * RETURN     : buffer index if match found,
- *              -1 if failed
- *==========================================================================*/
-int QCameraVideoMemory::getMatchBufIndex(const void *opaque,
-                                         bool metadata) const
-{
-    int index = -1;
-    for (int i = 0; i < mBufferCount; i++) {
-        if (metadata) {
-            if (mMetadata[i]->data == opaque) {
-                index = i;
-                break;
-            }
-        } else {
-            if (mCameraMemory[i]->data == opaque) {
-                index = i;
-                break;
-            }
-        }
-    }
-    return index;
-}
-
 /*===========================================================================
  * FUNCTION   : QCameraGrallocMemory
  *
@@ -1544,7 +2039,7 @@ int QCameraGrallocMemory::allocate(uint8_t count, size_t /*size*/)
                 struct ion_handle_data ion_handle;
                 memset(&ion_handle, 0, sizeof(ion_handle));
                 ion_handle.handle = mMemInfo[i].handle;
-                if (ioctl(mMemInfo[i].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
+                if (ION_IOCTL(mMemInfo[i].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
                     ALOGE("ion free failed");
                 }
                 if(mLocalFlag[i] != BUFFER_NOT_OWNED) {
@@ -1562,14 +2057,14 @@ int QCameraGrallocMemory::allocate(uint8_t count, size_t /*size*/)
             (struct private_handle_t *)(*mBufferHandle[cnt]);
         //update max fps info
         setMetaData(mPrivateHandle[cnt], UPDATE_REFRESH_RATE, (void*)&mMaxFPS);
-        mMemInfo[cnt].main_ion_fd = open("/dev/ion", O_RDONLY);
+        mMemInfo[cnt].main_ion_fd = ION_DEVICE_OPEN();
         if (mMemInfo[cnt].main_ion_fd < 0) {
             ALOGE("%s: failed: could not open ion device", __func__);
             for(int i = 0; i < cnt; i++) {
                 struct ion_handle_data ion_handle;
                 memset(&ion_handle, 0, sizeof(ion_handle));
                 ion_handle.handle = mMemInfo[i].handle;
-                if (ioctl(mMemInfo[i].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
+                if (ION_IOCTL(mMemInfo[i].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
                     ALOGE("%s: ion free failed", __func__);
                 }
                 close(mMemInfo[i].main_ion_fd);
@@ -1585,14 +2080,14 @@ int QCameraGrallocMemory::allocate(uint8_t count, size_t /*size*/)
             goto end;
         } else {
             ion_info_fd.fd = mPrivateHandle[cnt]->fd;
-            if (ioctl(mMemInfo[cnt].main_ion_fd,
+            if (ION_IOCTL(mMemInfo[cnt].main_ion_fd,
                       ION_IOC_IMPORT, &ion_info_fd) < 0) {
                 ALOGE("%s: ION import failed\n", __func__);
                 for(int i = 0; i < cnt; i++) {
                     struct ion_handle_data ion_handle;
                     memset(&ion_handle, 0, sizeof(ion_handle));
                     ion_handle.handle = mMemInfo[i].handle;
-                    if (ioctl(mMemInfo[i].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
+                    if (ION_IOCTL(mMemInfo[i].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
                         ALOGE("ion free failed");
                     }
                     close(mMemInfo[i].main_ion_fd);
@@ -1623,6 +2118,11 @@ int QCameraGrallocMemory::allocate(uint8_t count, size_t /*size*/)
         mMemInfo[cnt].size = (size_t)mPrivateHandle[cnt]->size;
         mMemInfo[cnt].handle = ion_info_fd.handle;
     }
+    for (int cnt = 0; cnt < count; cnt++) {
+        if (mCameraMemory[cnt] != NULL) {
+            mBufMap.add(mCameraMemory[cnt]->data, cnt);
+        }
+    }
     mBufferCount = count;
 
     //Cancel min_undequeued_buffer buffers back to the window
@@ -1669,12 +2169,13 @@ void QCameraGrallocMemory::deallocate()
 {
     CDBG("%s: E ", __FUNCTION__);
 
+    mBufMap.clear();
     for (int cnt = 0; cnt < mBufferCount; cnt++) {
         mCameraMemory[cnt]->release(mCameraMemory[cnt]);
         struct ion_handle_data ion_handle;
         memset(&ion_handle, 0, sizeof(ion_handle));
         ion_handle.handle = mMemInfo[cnt].handle;
-        if (ioctl(mMemInfo[cnt].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
+        if (ION_IOCTL(mMemInfo[cnt].main_ion_fd, ION_IOC_FREE, &ion_handle) < 0) {
             ALOGE("ion free failed");
         }
         close(mMemInfo[cnt].main_ion_fd);
@@ -1756,34 +2257,6 @@ camera_memory_t *QCameraGrallocMemory::getMemory(uint32_t index,
     return mCameraMemory[index];
 }
 
-/*===========================================================================
- * FUNCTION   : getMatchBufIndex
- *
- * DESCRIPTION: query buffer index by opaque ptr
- *
- * PARAMETERS :
- *   @opaque  : opaque ptr
- *   @metadata: flag if it's metadata
- *
- * RETURN     : buffer index if match found,
- *              -1 if failed
- *==========================================================================*/
-int QCameraGrallocMemory::getMatchBufIndex(const void *opaque,
-                                           bool metadata) const
-{
-    int index = -1;
-    if (metadata) {
-        return -1;
-    }
-    for (int i = 0; i < mBufferCount; i++) {
-        if (mCameraMemory[i]->data == opaque) {
-            index = i;
-            break;
-        }
-    }
-    return index;
-}
-
 /*===========================================================================
  * FUNCTION   : getPtr
  *
@@ -33,6 +33,7 @@
 #include <hardware/camera.h>
 #include <utils/Mutex.h>
 #include <utils/List.h>
+#include "QCameraBufIndexMap.h"
 
 extern "C" {
 #include <sys/types.h>
@@ -71,7 +72,7 @@ public:
     virtual int getRegFlags(uint8_t *regFlags) const = 0;
     virtual camera_memory_t *getMemory(uint32_t index,
             bool metadata) const = 0;
-    virtual int getMatchBufIndex(const void *opaque, bool metadata) const = 0;
+    virtual int getMatchBufIndex(const void *opaque, bool metadata) const;
     virtual void *getPtr(uint32_t index) const= 0;
 
     QCameraMemory(bool cached,
@@ -96,6 +97,7 @@ protected:
         size_t size;
         bool cached;
         unsigned int heap_id;
+        size_t alloc_size;   // bytes behind fd, >= size if reused from pool
     };
 
     int alloc(int count, size_t size, unsigned int heap_id);
@@ -110,12 +112,32 @@ protected:
     struct QCameraMemInfo mMemInfo[MM_CAMERA_MAX_NUM_FRAMES];
     QCameraMemoryPool *mMemoryPool;
     cam_stream_type_t mStreamType;
+    QCameraBufIndexMap mBufMap;   // data ptr -> index, filled by subclasses
+    QCameraBufIndexMap mMetaMap;  // metadata ptr -> index
 };
 
+// Cache of idle ION buffers shared by all pooled stream memories.
+// Buffers are bucketed by size class, four classes per power of two, and
+// handed out best fit: the smallest idle buffer of at least the requested
+// size and at most twice as large, allocated from a subset of the
+// requested heaps with the same cache flag. Offline reprocess buffers
+// still need an exact size. Idle bytes are capped by a budget
+// (persist.camera.mem.pool.budget, in MB); the least recently released
+// buffers are freed first when it is exceeded.
 class QCameraMemoryPool {
 
 public:
 
+    struct QCameraPoolStats {
+        uint32_t hits;          // requests served from the pool
+        uint32_t misses;        // requests that needed allocOneBuffer
+        uint32_t evictions;     // idle buffers freed to stay in budget
+        uint32_t buffers;       // idle buffers held
+        size_t bytesHeld;       // bytes of idle buffers held
+        size_t peakBytesHeld;
+        size_t budget;
+    };
+
     QCameraMemoryPool();
     virtual ~QCameraMemoryPool();
 
@@ -124,15 +146,75 @@ public:
             cam_stream_type_t streamType);
     void releaseBuffer(struct QCameraMemory::QCameraMemInfo &memInfo,
             cam_stream_type_t streamType);
+    int preload(unsigned int heap_id, size_t size, bool cached, int count);
+    void trim();
     void clear();
+    void getStats(QCameraPoolStats &stats);
 
 protected:
 
+    struct QCameraPoolEntry {
+        struct QCameraMemory::QCameraMemInfo memInfo;
+        uint32_t seq;           // release order, for LRU trimming
+    };
+
+    static const int MAX_SIZE_CLASSES = 80;  // 4KB up to 4GB
+
+    static int sizeClass(size_t size);
+    static bool isCompatible(const struct QCameraMemory::QCameraMemInfo &memInfo,
+            unsigned int heap_id, size_t size, bool cached, bool exact);
     int findBufferLocked(struct QCameraMemory::QCameraMemInfo &memInfo,
             unsigned int heap_id, size_t size, bool cached,
             cam_stream_type_t streamType);
+    int countBuffersLocked(unsigned int heap_id, size_t size, bool cached);
+    void addBufferLocked(struct QCameraMemory::QCameraMemInfo &memInfo);
+    void trimLocked(size_t limit);
+
+    android::List<QCameraPoolEntry> mBuckets[MAX_SIZE_CLASSES];
+    uint32_t mSeq;
+    QCameraPoolStats mStats;
+    pthread_mutex_t mLock;
+};
+
+// Recycles the camera_memory_t objects handed to the app with preview
+// callbacks. Entries are keyed by (fd, size, format), where fd is the
+// mapped stream buffer or -1 for a HAL owned copy, and idle entries are
+// reused least recently returned first. Entries still out with the app
+// during clear() are released once they come back through put().
+class QCameraCallbackMemPool {
+
+public:
 
-    android::List<QCameraMemory::QCameraMemInfo> mPools[CAM_STREAM_TYPE_MAX];
+    QCameraCallbackMemPool();
+    virtual ~QCameraCallbackMemPool();
+
+    camera_memory_t *get(camera_request_memory getMemory, void *cookie,
+            int fd, size_t size, cam_format_t fmt);
+    void put(camera_memory_t *mem);
+    void clear();
+    void getStats(uint32_t &hits, uint32_t &misses, uint32_t &mapped);
+
+    static void releaseCallbackMem(void *data, void *cookie, int32_t cbStatus);
+
+private:
+
+    typedef struct {
+        camera_memory_t *mem;
+        int fd;
+        size_t size;
+        cam_format_t fmt;
+        bool busy;
+        bool stale;        // dropped by clear() while busy
+        uint32_t lastUse;
+    } QCameraCbMemEntry;
+
+    static const int MAX_CB_MEM_ENTRIES = MM_CAMERA_MAX_NUM_FRAMES;
+
+    QCameraCbMemEntry mEntries[MAX_CB_MEM_ENTRIES];
+    uint32_t mUseCount;
+    uint32_t mHits;         // served without calling getMemory
+    uint32_t mMisses;       // new getMemory allocation or mapping
+    uint32_t mMapped;       // stream buffer mapped instead of copied
     pthread_mutex_t mLock;
 };
 
@@ -149,7 +231,6 @@ public:
     virtual int cacheOps(uint32_t index, unsigned int cmd);
     virtual int getRegFlags(uint8_t *regFlags) const;
     virtual camera_memory_t *getMemory(uint32_t index, bool metadata) const;
-    virtual int getMatchBufIndex(const void *opaque, bool metadata) const;
     virtual void *getPtr(uint32_t index) const;
 
 private:
@@ -172,7 +253,6 @@ public:
     virtual int cacheOps(uint32_t index, unsigned int cmd);
     virtual int getRegFlags(uint8_t *regFlags) const;
     virtual camera_memory_t *getMemory(uint32_t index, bool metadata) const;
-    virtual int getMatchBufIndex(const void *opaque, bool metadata) const;
     virtual void *getPtr(uint32_t index) const;
 
 protected:
@@ -191,7 +271,6 @@ public:
     virtual int allocateMore(uint8_t count, size_t size);
     virtual void deallocate();
     virtual camera_memory_t *getMemory(uint32_t index, bool metadata) const;
-    virtual int getMatchBufIndex(const void *opaque, bool metadata) const;
 
 private:
     camera_memory_t *mMetadata[MM_CAMERA_MAX_NUM_FRAMES];
@@ -215,7 +294,6 @@ public:
     virtual int cacheOps(uint32_t index, unsigned int cmd);
     virtual int getRegFlags(uint8_t *regFlags) const;
     virtual camera_memory_t *getMemory(uint32_t index, bool metadata) const;
-    virtual int getMatchBufIndex(const void *opaque, bool metadata) const;
     virtual void *getPtr(uint32_t index) const;
 
     void setWindowInfo(preview_stream_ops_t *window, int width, int height,
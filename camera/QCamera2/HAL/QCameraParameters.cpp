@@ -8709,6 +8709,24 @@ uint32_t QCameraParameters::getJpegQuality()
     return (uint32_t)quality;
 }
 
+/*===========================================================================
+ * FUNCTION   : getJpegThumbnailQuality
+ *
+ * DESCRIPTION: get jpeg encoding quality of the thumbnail
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : thumbnail encoding quality
+ *==========================================================================*/
+uint32_t QCameraParameters::getJpegThumbnailQuality()
+{
+    int quality = getInt(KEY_JPEG_THUMBNAIL_QUALITY);
+    if (quality < 0) {
+        quality = 85; // set to default quality value
+    }
+    return (uint32_t)quality;
+}
+
 
 /*===========================================================================
  * FUNCTION   : getJpegRotation
@@ -619,6 +619,7 @@ public:
     int setRecordingHintValue(int32_t value); // set local copy of video hint and send to server
                                               // no change in parameters value
     uint32_t getJpegQuality();
+    uint32_t getJpegThumbnailQuality();
     uint32_t getJpegRotation();
     uint32_t getJpegExifRotation();
     bool useJpegExifRotation();
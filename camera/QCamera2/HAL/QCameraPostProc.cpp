@@ -466,6 +466,7 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
         ALOGI("%s: Using default JPEG quality", __func__);
         encode_parm.quality = 85;
     }
+    encode_parm.thumb_quality = m_parent->getJpegThumbnailQuality();
     cam_frame_len_offset_t main_offset;
     memset(&main_offset, 0, sizeof(cam_frame_len_offset_t));
     main_stream->getFrameOffset(main_offset);
@@ -691,6 +692,7 @@ int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
 {
     if (m_bInited == FALSE) {
         ALOGE("%s: postproc not initialized yet", __func__);
+        m_parent->m_burstScheduler.shotDone(false);
         return UNKNOWN_ERROR;
     }
 
@@ -706,6 +708,7 @@ int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
         CDBG_HIGH("%s: need reprocess", __func__);
         // enqueu to post proc input queue
         m_inputPPQ.enqueue((void *)frame);
+        m_parent->m_burstScheduler.enter(QCAMERA_BURST_STAGE_PP_INPUT);
     } else if (m_parent->mParameters.isNV16PictureFormat() ||
         m_parent->mParameters.isNV21PictureFormat()) {
         //check if raw frame information is needed.
@@ -722,6 +725,7 @@ int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
             (qcamera_jpeg_data_t *)malloc(sizeof(qcamera_jpeg_data_t));
         if (jpeg_job == NULL) {
             ALOGE("%s: No memory for jpeg job", __func__);
+            m_parent->m_burstScheduler.shotDone(false);
             return NO_MEMORY;
         }
 
@@ -745,6 +749,7 @@ int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
 
         // enqueu to jpeg input queue
         m_inputJpegQ.enqueue((void *)jpeg_job);
+        m_parent->m_burstScheduler.enter(QCAMERA_BURST_STAGE_JPEG_INPUT);
     }
     m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
 
@@ -797,6 +802,7 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
 {
     if (m_bInited == FALSE) {
         ALOGE("%s: postproc not initialized yet", __func__);
+        m_parent->m_burstScheduler.shotDone(false);
         return UNKNOWN_ERROR;
     }
 
@@ -804,14 +810,20 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
     camera_memory_t *jpeg_mem = NULL;
     omx_jpeg_ouput_buf_t *jpeg_out = NULL;
 
+    CAM_TRACE(CAM_TRACE_JPEG_DONE, 0, CAM_STREAM_TYPE_SNAPSHOT, 0, evt->jobId);
+    m_parent->m_burstScheduler.leave(QCAMERA_BURST_STAGE_ENCODE);
     if (mUseSaveProc && m_parent->isLongshotEnabled()) {
         qcamera_jpeg_evt_payload_t *saveData = ( qcamera_jpeg_evt_payload_t * ) malloc(sizeof(qcamera_jpeg_evt_payload_t));
         if ( NULL == saveData ) {
             ALOGE("%s: Can not allocate save data message!", __func__);
+            m_ongoingJpegQ.flushNodes(matchJobId, (void*)&evt->jobId);
+            m_parent->m_burstScheduler.shotDone(false);
+            m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
             return NO_MEMORY;
         }
         *saveData = *evt;
         m_inputSaveQ.enqueue((void *) saveData);
+        m_parent->m_burstScheduler.enter(QCAMERA_BURST_STAGE_SAVE);
         m_saveProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     } else {
         // Release jpeg job data
@@ -860,6 +872,7 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
           pthread_mutex_lock(&m_parent->m_int_lock);
           pthread_cond_signal(&m_parent->m_int_cond);
           pthread_mutex_unlock(&m_parent->m_int_lock);
+          m_parent->m_burstScheduler.shotDone(true);
           m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
           return rc;
         }
@@ -901,6 +914,7 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
         memset(&release_data, 0, sizeof(qcamera_release_data_t));
         release_data.data = jpeg_mem;
         CDBG_HIGH("[KPI Perf] %s: PROFILE_JPEG_CB ",__func__);
+        CAM_TRACE(CAM_TRACE_SAVE, 0, CAM_STREAM_TYPE_SNAPSHOT, 0, evt->jobId);
         rc = sendDataNotify(CAMERA_MSG_COMPRESSED_IMAGE,
                             jpeg_mem,
                             0,
@@ -947,6 +961,9 @@ end:
         }
     }
 
+    // retire the shot, this may request the next longshot frame
+    m_parent->m_burstScheduler.shotDone(evt->status != JPEG_JOB_STATUS_ERROR);
+
     // wait up data proc thread to do next job,
     // if previous request is blocked due to ongoing jpeg job
     m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
@@ -978,6 +995,7 @@ int32_t QCameraPostProcessor::processPPData(mm_camera_super_buf_t *frame)
     }
 
     qcamera_pp_data_t *job = (qcamera_pp_data_t *)m_ongoingPPQ.dequeue();
+    m_parent->m_burstScheduler.leave(QCAMERA_BURST_STAGE_REPROCESS);
 
     if (!needSuperBufMatch && (job == NULL || job->src_frame == NULL) ) {
         ALOGE("%s: Cannot find reprocess job", __func__);
@@ -1008,7 +1026,7 @@ int32_t QCameraPostProcessor::processPPData(mm_camera_super_buf_t *frame)
         }
     }
     if(pReprocFrame != NULL && m_parent->mParameters.isFaceDetectionEnabled()){
-        m_parent->TsMakeupProcess_Snapshot(pReprocFrame,pSnapshotStream);
+        m_parent->m_makeup.processSnapshot(pReprocFrame,pSnapshotStream);
     } else {
         CDBG_HIGH("%s pReprocFrame == NULL || isFaceDetectionEnabled = %d",__func__,
                 m_parent->mParameters.isFaceDetectionEnabled());
@@ -1065,6 +1083,7 @@ int32_t QCameraPostProcessor::processPPData(mm_camera_super_buf_t *frame)
 
     // enqueu reprocessed frame to jpeg input queue
     m_inputJpegQ.enqueue((void *)jpeg_job);
+    m_parent->m_burstScheduler.enter(QCAMERA_BURST_STAGE_JPEG_INPUT);
 
     CDBG_HIGH("%s: %d] ", __func__, __LINE__);
     // wait up data proc thread
@@ -1999,6 +2018,7 @@ int32_t QCameraPostProcessor::encodeData(qcamera_jpeg_data_t *jpeg_job_data,
     if (ret == NO_ERROR) {
         // remember job info
         jpeg_job_data->jobId = jobId;
+        CAM_TRACE(CAM_TRACE_JPEG_START, 0, CAM_STREAM_TYPE_SNAPSHOT, 0, jobId);
     }
 
     return ret;
@@ -2195,6 +2215,7 @@ void *QCameraPostProcessor::dataSaveRoutine(void *data)
                 }
 
                 pme->m_ongoingJpegQ.flushNodes(matchJobId, (void*)&job_data->jobId);
+                pme->m_parent->m_burstScheduler.leave(QCAMERA_BURST_STAGE_SAVE);
 
                 CDBG_HIGH("[KPI Perf] %s : jpeg job %d", __func__, job_data->jobId);
 
@@ -2242,6 +2263,8 @@ void *QCameraPostProcessor::dataSaveRoutine(void *data)
                     release_data.data = jpeg_mem;
                     release_data.unlinkFile = true;
                     ALOGE("[KPI Perf] %s: PROFILE_JPEG_CB ",__func__);
+                    CAM_TRACE(CAM_TRACE_SAVE, 0, CAM_STREAM_TYPE_SNAPSHOT, 0,
+                            job_data->jobId);
                     ret = pme->sendDataNotify(CAMERA_MSG_COMPRESSED_IMAGE,
                                         jpeg_mem,
                                         0,
@@ -2284,6 +2307,7 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
     uint8_t is_active = FALSE;
     QCameraPostProcessor *pme = (QCameraPostProcessor *)data;
     QCameraCmdThread *cmdThread = &pme->m_dataProcTh;
+    QCameraBurstScheduler &burst = pme->m_parent->m_burstScheduler;
     cmdThread->setName("CAM_JpegProc");
 
     CDBG("%s: E", __func__);
@@ -2387,14 +2411,18 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
 
                     if (NULL != jpeg_job) {
                         pme->syncStreamParams(jpeg_job->src_frame);
+                        burst.leave(QCAMERA_BURST_STAGE_JPEG_INPUT);
 
                       // add into ongoing jpeg job Q
                       pme->m_ongoingJpegQ.enqueue((void *)jpeg_job);
+                      burst.enter(QCAMERA_BURST_STAGE_ENCODE);
                       ret = pme->encodeData(jpeg_job,
                               pme->mNewJpegSessionNeeded);
                       if (NO_ERROR != ret) {
                         // dequeue the last one
                         pme->m_ongoingJpegQ.dequeue(false);
+                        burst.leave(QCAMERA_BURST_STAGE_ENCODE);
+                        burst.shotDone(false);
                         pme->releaseJpegJobData(jpeg_job);
                         free(jpeg_job);
                         pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
@@ -2420,9 +2448,13 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
                     mm_camera_super_buf_t *pp_frame = NULL;
                     if (pme->m_inputPPQ.getCurrentSize() > 0) {
                         if (!pme->m_parent->isLongshotEnabled() ||
-                                (pme->m_ongoingPPQ.getCurrentSize() <
-                                pme->m_reprocStream->getNumQueuedBuf())) {
+                                ((pme->m_ongoingPPQ.getCurrentSize() <
+                                pme->m_reprocStream->getNumQueuedBuf()) &&
+                                burst.admitReprocess())) {
                             pp_frame = (mm_camera_super_buf_t *)pme->m_inputPPQ.dequeue();
+                            if (NULL != pp_frame) {
+                                burst.leave(QCAMERA_BURST_STAGE_PP_INPUT);
+                            }
                         }
                         else {
                             CDBG_HIGH("Postpone reprocess.On going reproc=%d,Queued reproc buf=%d",
@@ -2463,6 +2495,7 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
                                 pme->releaseSuperBuf(pp_frame);
                                 free(pp_frame);
                             }
+                            burst.shotDone(false);
                             // send error notify
                             pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
                         }
@@ -2535,6 +2568,15 @@ int32_t QCameraPostProcessor::reprocess(qcamera_pp_data_t *pp_job)
         return BAD_VALUE;
     }
 
+    if (NULL != pp_job->src_frame) {
+        for (uint32_t i = 0; i < pp_job->src_frame->num_bufs; i++) {
+            CAM_TRACE_BUF(CAM_TRACE_REPROCESS, pp_job->src_frame->bufs[i]);
+        }
+    }
+
+    // reprocess is never shed, it is only charged to the preview load
+    m_parent->m_loadGovernor.admit(QCAMERA_LOAD_STAGE_REPROCESS);
+    int64_t start = m_parent->m_loadGovernor.begin();
     if (m_parent->isRegularCapture()) {
         if ((NULL != pp_job->src_frame) &&
                 (0 < pp_job->src_frame->num_bufs)) {
@@ -2557,15 +2599,19 @@ int32_t QCameraPostProcessor::reprocess(qcamera_pp_data_t *pp_job)
         // at this point the source channel will not exist.
         pp_job->reproc_frame_release = true;
         m_ongoingPPQ.enqueue((void *)pp_job);
+        m_parent->m_burstScheduler.enter(QCAMERA_BURST_STAGE_REPROCESS);
         rc = pChannel->doReprocessOffline(pp_job->src_frame);
     } else {
         m_ongoingPPQ.enqueue((void *)pp_job);
+        m_parent->m_burstScheduler.enter(QCAMERA_BURST_STAGE_REPROCESS);
         rc = pChannel->doReprocess(pp_job->src_frame);
     }
+    m_parent->m_loadGovernor.end(QCAMERA_LOAD_STAGE_REPROCESS, start);
 
     if (NO_ERROR != rc) {
         // remove from ongoing PP job Q
         m_ongoingPPQ.dequeue(false);
+        m_parent->m_burstScheduler.leave(QCAMERA_BURST_STAGE_REPROCESS);
     }
 
     return rc;
@@ -2754,7 +2800,8 @@ int QCameraPostProcessor::releaseJpegMemory(omx_jpeg_ouput_buf_t *out_buf)
  * RETURN     : None
  *==========================================================================*/
 QCameraExif::QCameraExif()
-    : m_nNumEntries(0)
+    : m_nNumEntries(0),
+      m_nDataUsed(0)
 {
     memset(m_Entries, 0, sizeof(m_Entries));
 }
@@ -2762,7 +2809,8 @@ QCameraExif::QCameraExif()
 /*===========================================================================
  * FUNCTION   : ~QCameraExif
  *
- * DESCRIPTION: deconstructor of QCameraExif. Will release internal memory ptr.
+ * DESCRIPTION: deconstructor of QCameraExif. Entry values live in the
+ *              object itself, so there is nothing to release.
  *
  * PARAMETERS : None
  *
@@ -2770,86 +2818,14 @@ QCameraExif::QCameraExif()
  *==========================================================================*/
 QCameraExif::~QCameraExif()
 {
-    for (uint32_t i = 0; i < m_nNumEntries; i++) {
-        switch (m_Entries[i].tag_entry.type) {
-        case EXIF_BYTE:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._bytes != NULL) {
-                    free(m_Entries[i].tag_entry.data._bytes);
-                    m_Entries[i].tag_entry.data._bytes = NULL;
-                }
-            }
-            break;
-        case EXIF_ASCII:
-            {
-                if (m_Entries[i].tag_entry.data._ascii != NULL) {
-                    free(m_Entries[i].tag_entry.data._ascii);
-                    m_Entries[i].tag_entry.data._ascii = NULL;
-                }
-            }
-            break;
-        case EXIF_SHORT:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._shorts != NULL) {
-                    free(m_Entries[i].tag_entry.data._shorts);
-                    m_Entries[i].tag_entry.data._shorts = NULL;
-                }
-            }
-            break;
-        case EXIF_LONG:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._longs != NULL) {
-                    free(m_Entries[i].tag_entry.data._longs);
-                    m_Entries[i].tag_entry.data._longs = NULL;
-                }
-            }
-            break;
-        case EXIF_RATIONAL:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._rats != NULL) {
-                    free(m_Entries[i].tag_entry.data._rats);
-                    m_Entries[i].tag_entry.data._rats = NULL;
-                }
-            }
-            break;
-        case EXIF_UNDEFINED:
-            {
-                if (m_Entries[i].tag_entry.data._undefined != NULL) {
-                    free(m_Entries[i].tag_entry.data._undefined);
-                    m_Entries[i].tag_entry.data._undefined = NULL;
-                }
-            }
-            break;
-        case EXIF_SLONG:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._slongs != NULL) {
-                    free(m_Entries[i].tag_entry.data._slongs);
-                    m_Entries[i].tag_entry.data._slongs = NULL;
-                }
-            }
-            break;
-        case EXIF_SRATIONAL:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._srats != NULL) {
-                    free(m_Entries[i].tag_entry.data._srats);
-                    m_Entries[i].tag_entry.data._srats = NULL;
-                }
-            }
-            break;
-        }
-    }
 }
 
 /*===========================================================================
  * FUNCTION   : addEntry
  *
- * DESCRIPTION: function to add an entry to exif data
+ * DESCRIPTION: function to add an entry to exif data. Single numbers are
+ *              kept in the entry, strings and arrays are copied into the
+ *              data area of the object instead of a heap buffer per tag.
  *
  * PARAMETERS :
  *   @tagid   : exif tag ID
@@ -2866,144 +2842,64 @@ int32_t QCameraExif::addEntry(exif_tag_id_t tagid,
                               uint32_t count,
                               void *data)
 {
-    int32_t rc = NO_ERROR;
+    uint32_t size = 0;
     if(m_nNumEntries >= MAX_EXIF_TABLE_ENTRIES) {
         ALOGE("%s: Number of entries exceeded limit", __func__);
         return NO_MEMORY;
     }
 
-    m_Entries[m_nNumEntries].tag_id = tagid;
-    m_Entries[m_nNumEntries].tag_entry.type = type;
-    m_Entries[m_nNumEntries].tag_entry.count = count;
-    m_Entries[m_nNumEntries].tag_entry.copy = 1;
     switch (type) {
     case EXIF_BYTE:
-        {
-            if (count > 1) {
-                uint8_t *values = (uint8_t *)malloc(count);
-                if (values == NULL) {
-                    ALOGE("%s: No memory for byte array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count);
-                    m_Entries[m_nNumEntries].tag_entry.data._bytes = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._byte = *(uint8_t *)data;
-            }
-        }
+    case EXIF_UNDEFINED:
+        size = count;
         break;
     case EXIF_ASCII:
-        {
-            char *str = NULL;
-            str = (char *)malloc(count + 1);
-            if (str == NULL) {
-                ALOGE("%s: No memory for ascii string", __func__);
-                rc = NO_MEMORY;
-            } else {
-                memset(str, 0, count + 1);
-                memcpy(str, data, count);
-                m_Entries[m_nNumEntries].tag_entry.data._ascii = str;
-            }
-        }
+        size = count + 1;
         break;
     case EXIF_SHORT:
-        {
-            if (count > 1) {
-                uint16_t *values = (uint16_t *)malloc(count * sizeof(uint16_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for short array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(uint16_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._shorts = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._short = *(uint16_t *)data;
-            }
-        }
+        size = count * (uint32_t)sizeof(uint16_t);
         break;
     case EXIF_LONG:
-        {
-            if (count > 1) {
-                uint32_t *values = (uint32_t *)malloc(count * sizeof(uint32_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for long array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(uint32_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._longs = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._long = *(uint32_t *)data;
-            }
-        }
+    case EXIF_SLONG:
+        size = count * (uint32_t)sizeof(uint32_t);
         break;
     case EXIF_RATIONAL:
-        {
-            if (count > 1) {
-                rat_t *values = (rat_t *)malloc(count * sizeof(rat_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for rational array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(rat_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._rats = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._rat = *(rat_t *)data;
-            }
-        }
-        break;
-    case EXIF_UNDEFINED:
-        {
-            uint8_t *values = (uint8_t *)malloc(count);
-            if (values == NULL) {
-                ALOGE("%s: No memory for undefined array", __func__);
-                rc = NO_MEMORY;
-            } else {
-                memcpy(values, data, count);
-                m_Entries[m_nNumEntries].tag_entry.data._undefined = values;
-            }
-        }
+    case EXIF_SRATIONAL:
+        size = count * (uint32_t)sizeof(rat_t);
         break;
-    case EXIF_SLONG:
-        {
-            if (count > 1) {
-                int32_t *values = (int32_t *)malloc(count * sizeof(int32_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for signed long array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(int32_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._slongs = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._slong = *(int32_t *)data;
-            }
+    default:
+        ALOGE("%s: Unknown type %d", __func__, type);
+        return BAD_VALUE;
+    }
+
+    QEXIF_INFO_DATA *entry = &m_Entries[m_nNumEntries];
+    entry->tag_id = tagid;
+    entry->tag_entry.type = type;
+    entry->tag_entry.count = count;
+    entry->tag_entry.copy = 1;
+    if (count <= 1 && type != EXIF_ASCII && type != EXIF_UNDEFINED) {
+        memcpy(&entry->tag_entry.data, data, size);
+    } else {
+        uint32_t offset = (m_nDataUsed + 7) & ~7U;
+        if (offset + size > sizeof(m_Data)) {
+            ALOGE("%s: No memory for tag 0x%x", __func__, tagid);
+            return NO_MEMORY;
         }
-        break;
-    case EXIF_SRATIONAL:
-        {
-            if (count > 1) {
-                srat_t *values = (srat_t *)malloc(count * sizeof(srat_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for signed rational array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(srat_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._srats = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._srat = *(srat_t *)data;
-            }
+        uint8_t *values = (uint8_t *)m_Data + offset;
+        if (type == EXIF_ASCII) {
+            memcpy(values, data, count);
+            values[count] = '\0';
+        } else {
+            memcpy(values, data, size);
         }
-        break;
+        // all pointer members of the union share the same storage
+        entry->tag_entry.data._bytes = values;
+        m_nDataUsed = offset + size;
     }
 
     // Increase number of entries
     m_nNumEntries++;
-    return rc;
+    return NO_ERROR;
 }
 
 }; // namespace qcamera
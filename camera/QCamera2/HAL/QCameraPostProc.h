@@ -88,6 +88,7 @@ typedef struct {
 } qcamera_data_argm_t;
 
 #define MAX_EXIF_TABLE_ENTRIES 20
+#define MAX_EXIF_DATA_SIZE 1024
 class QCameraExif
 {
 public:
@@ -104,6 +105,8 @@ public:
 private:
     QEXIF_INFO_DATA m_Entries[MAX_EXIF_TABLE_ENTRIES];  // exif tags for JPEG encoder
     uint32_t  m_nNumEntries;                            // number of valid entries
+    uint64_t  m_Data[MAX_EXIF_DATA_SIZE / sizeof(uint64_t)]; // strings and arrays of the entries
+    uint32_t  m_nDataUsed;                              // bytes of m_Data in use
 };
 
 class QCameraPostProcessor
@@ -30,11 +30,25 @@
 #define LOG_TAG "QCameraStateMachine"
 
 #include <utils/Errors.h>
+#include <cutils/properties.h>
+#include <stdio.h>
+#include <unistd.h>
 #include "QCamera2HWI.h"
 #include "QCameraStateMachine.h"
 
 namespace qcamera {
 
+// payload slots kept by the state machine for the metadata path
+#define QCAMERA_SM_METADATA_EVT_SLOTS       8
+#define QCAMERA_SM_INTERNAL_EVT_SLOTS       32
+#define QCAMERA_SM_INTERNAL_EVT_SLOTS_MIN   4
+
+// bits of the read only API snapshot published with every state change
+#define QCAMERA_SM_SNAP_STATE_MASK          0xFFU
+#define QCAMERA_SM_SNAP_VALID               (1U << 8)
+#define QCAMERA_SM_SNAP_PREVIEW_ENABLED     (1U << 9)
+#define QCAMERA_SM_SNAP_RECORDING_ENABLED   (1U << 10)
+
 /*===========================================================================
  * FUNCTION   : smEvtProcRoutine
  *
@@ -77,10 +91,18 @@ void *QCameraStateMachine::smEvtProcRoutine(void *data)
                 // no need to free payload for API
                 break;
             case QCAMERA_SM_CMD_TYPE_EVT:
-                pme->stateMachine(node->evt, node->evt_payload);
+                if (node->evt == QCAMERA_SM_EVT_METADATA_FRAME) {
+                    pme->procMetadataFrame(
+                        (qcamera_sm_metadata_evt_payload_t *)node->evt_payload);
+                } else if (node->evt == QCAMERA_SM_EVT_LOAD_NOTIFY) {
+                    // same in every state, applied like a thermal level
+                    pme->m_parent->updateLoadLevel();
+                } else {
+                    pme->stateMachine(node->evt, node->evt_payload);
+                }
 
                 // EVT is async call, so payload need to be free after use
-                free(node->evt_payload);
+                pme->releaseEvtPayload(node->evt_payload);
                 node->evt_payload = NULL;
                 break;
             case QCAMERA_SM_CMD_TYPE_EXIT:
@@ -111,10 +133,23 @@ QCameraStateMachine::QCameraStateMachine(QCamera2HardwareInterface *ctrl) :
     api_queue(),
     evt_queue()
 {
+    char value[PROPERTY_VALUE_MAX];
+
     m_parent = ctrl;
-    m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+    setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
     cmd_pid = 0;
     cam_sem_init(&cmd_sem, 0);
+
+    property_get("persist.camera.meta.coalesce", value, "1");
+    m_bCoalesceMetadata = atoi(value) > 0;
+    pthread_mutex_init(&m_evtPoolLock, NULL);
+    memset(&m_evtStats, 0, sizeof(m_evtStats));
+    memset(&m_metaInternalEvt, 0, sizeof(m_metaInternalEvt));
+    initPayloadPool(m_metadataEvtPool, sizeof(qcamera_sm_metadata_evt_payload_t),
+            m_bCoalesceMetadata ? QCAMERA_SM_METADATA_EVT_SLOTS : 0);
+    initPayloadPool(m_internalEvtPool, sizeof(qcamera_sm_internal_evt_payload_t),
+            m_bCoalesceMetadata ?
+            QCAMERA_SM_INTERNAL_EVT_SLOTS_MIN : QCAMERA_SM_INTERNAL_EVT_SLOTS);
     pthread_create(&cmd_pid,
                    NULL,
                    smEvtProcRoutine,
@@ -134,6 +169,9 @@ QCameraStateMachine::QCameraStateMachine(QCamera2HardwareInterface *ctrl) :
 QCameraStateMachine::~QCameraStateMachine()
 {
     cam_sem_destroy(&cmd_sem);
+    deinitPayloadPool(m_metadataEvtPool);
+    deinitPayloadPool(m_internalEvtPool);
+    pthread_mutex_destroy(&m_evtPoolLock);
 }
 
 /*===========================================================================
@@ -239,6 +277,309 @@ int32_t QCameraStateMachine::procEvt(qcamera_sm_evt_enum_t evt,
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : initPayloadPool
+ *
+ * DESCRIPTION: allocate the slots of a payload pool
+ *
+ * PARAMETERS :
+ *   @pool      : pool to set up
+ *   @slot_size : bytes per payload
+ *   @num_slots : number of payloads, 0 leaves the pool empty
+ *
+ * RETURN     : none. On allocation failure the pool stays empty and every
+ *              request falls back to malloc.
+ *==========================================================================*/
+void QCameraStateMachine::initPayloadPool(qcamera_sm_payload_pool_t &pool,
+        size_t slot_size, uint32_t num_slots)
+{
+    memset(&pool, 0, sizeof(pool));
+    pool.slot_size = slot_size;
+    if (num_slots == 0) {
+        return;
+    }
+
+    pool.base = (uint8_t *)malloc(slot_size * num_slots);
+    pool.free_slots = (uint32_t *)malloc(sizeof(uint32_t) * num_slots);
+    if (pool.base == NULL || pool.free_slots == NULL) {
+        ALOGE("%s: No memory for %u payloads of %zu bytes",
+                __func__, num_slots, slot_size);
+        deinitPayloadPool(pool);
+        pool.slot_size = slot_size;
+        return;
+    }
+    pool.num_slots = num_slots;
+    for (uint32_t i = 0; i < num_slots; i++) {
+        pool.free_slots[i] = num_slots - 1 - i;
+    }
+    pool.num_free = num_slots;
+}
+
+/*===========================================================================
+ * FUNCTION   : deinitPayloadPool
+ *
+ * DESCRIPTION: free the slots of a payload pool
+ *
+ * PARAMETERS :
+ *   @pool    : pool to release
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStateMachine::deinitPayloadPool(qcamera_sm_payload_pool_t &pool)
+{
+    free(pool.base);
+    free(pool.free_slots);
+    memset(&pool, 0, sizeof(pool));
+}
+
+/*===========================================================================
+ * FUNCTION   : getPayload
+ *
+ * DESCRIPTION: take a zeroed payload from a pool, or from the heap when the
+ *              pool is exhausted. Caller holds m_evtPoolLock.
+ *
+ * PARAMETERS :
+ *   @pool    : pool to take from
+ *
+ * RETURN     : ptr to payload, NULL if out of memory
+ *==========================================================================*/
+void *QCameraStateMachine::getPayload(qcamera_sm_payload_pool_t &pool)
+{
+    void *payload = NULL;
+
+    if (pool.num_free > 0) {
+        payload = pool.base + pool.free_slots[--pool.num_free] * pool.slot_size;
+        m_evtStats.pooled++;
+    } else {
+        payload = malloc(pool.slot_size);
+        if (payload == NULL) {
+            return NULL;
+        }
+        m_evtStats.allocs++;
+    }
+    memset(payload, 0, pool.slot_size);
+    return payload;
+}
+
+/*===========================================================================
+ * FUNCTION   : putPayload
+ *
+ * DESCRIPTION: return a payload to the pool it came from. Caller holds
+ *              m_evtPoolLock.
+ *
+ * PARAMETERS :
+ *   @pool    : pool to return to
+ *   @payload : payload to return
+ *
+ * RETURN     : true if the payload belongs to the pool
+ *==========================================================================*/
+bool QCameraStateMachine::putPayload(qcamera_sm_payload_pool_t &pool,
+        void *payload)
+{
+    uint8_t *p = (uint8_t *)payload;
+
+    if (pool.base == NULL || p < pool.base ||
+            p >= pool.base + pool.slot_size * pool.num_slots) {
+        return false;
+    }
+    pool.free_slots[pool.num_free++] = (uint32_t)((size_t)(p - pool.base) / pool.slot_size);
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : getInternalEvtPayload
+ *
+ * DESCRIPTION: get a zeroed payload for QCAMERA_SM_EVT_EVT_INTERNAL
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : ptr to payload, NULL if out of memory
+ *==========================================================================*/
+qcamera_sm_internal_evt_payload_t *QCameraStateMachine::getInternalEvtPayload()
+{
+    pthread_mutex_lock(&m_evtPoolLock);
+    void *payload = getPayload(m_internalEvtPool);
+    pthread_mutex_unlock(&m_evtPoolLock);
+    return (qcamera_sm_internal_evt_payload_t *)payload;
+}
+
+/*===========================================================================
+ * FUNCTION   : getMetadataEvtPayload
+ *
+ * DESCRIPTION: get a zeroed payload for QCAMERA_SM_EVT_METADATA_FRAME
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : ptr to payload, NULL if out of memory
+ *==========================================================================*/
+qcamera_sm_metadata_evt_payload_t *QCameraStateMachine::getMetadataEvtPayload()
+{
+    pthread_mutex_lock(&m_evtPoolLock);
+    void *payload = getPayload(m_metadataEvtPool);
+    pthread_mutex_unlock(&m_evtPoolLock);
+    return (qcamera_sm_metadata_evt_payload_t *)payload;
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseEvtPayload
+ *
+ * DESCRIPTION: release an evt payload, pooled or malloc'ed
+ *
+ * PARAMETERS :
+ *   @payload : payload to release, may be NULL
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStateMachine::releaseEvtPayload(void *payload)
+{
+    bool pooled;
+
+    if (payload == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&m_evtPoolLock);
+    pooled = putPayload(m_internalEvtPool, payload) ||
+            putPayload(m_metadataEvtPool, payload);
+    pthread_mutex_unlock(&m_evtPoolLock);
+    if (!pooled) {
+        free(payload);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : addMetadataFrameStats
+ *
+ * DESCRIPTION: account the internal evts raised by one metadata frame
+ *
+ * PARAMETERS :
+ *   @evts    : number of internal evts in the frame
+ *   @posts   : number of evt_queue posts used for them
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStateMachine::addMetadataFrameStats(uint32_t evts, uint32_t posts)
+{
+    if (evts == 0) {
+        return;
+    }
+    pthread_mutex_lock(&m_evtPoolLock);
+    m_evtStats.frames++;
+    m_evtStats.evts += evts;
+    m_evtStats.posts += posts;
+    if (evts > m_evtStats.max_evts) {
+        m_evtStats.max_evts = evts;
+    }
+    pthread_mutex_unlock(&m_evtPoolLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : dumpEvtStats
+ *
+ * DESCRIPTION: write the metadata evt counters to a file descriptor
+ *
+ * PARAMETERS :
+ *   @fd      : file descriptor to write to
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStateMachine::dumpEvtStats(int fd)
+{
+    char buf[256];
+    qcamera_sm_evt_stats_t stats;
+
+    pthread_mutex_lock(&m_evtPoolLock);
+    stats = m_evtStats;
+    pthread_mutex_unlock(&m_evtPoolLock);
+
+    int len = snprintf(buf, sizeof(buf),
+            "  metadata evts: %s, frames %u evts %u (%.2f/frame, max %u) "
+            "posts %u, payloads pooled %u malloc %u\n",
+            m_bCoalesceMetadata ? "coalesced" : "per evt",
+            stats.frames, stats.evts,
+            stats.frames ? (double)stats.evts / stats.frames : 0.0,
+            stats.max_evts, stats.posts, stats.pooled, stats.allocs);
+    if ((len > 0) && (write(fd, buf, strnlen(buf, sizeof(buf))) < 0)) {
+        ALOGE("%s: write failed", __func__);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : procMetadataFrame
+ *
+ * DESCRIPTION: fan a coalesced metadata frame out into internal evts
+ *
+ * PARAMETERS :
+ *   @meta    : coalesced payload
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraStateMachine::procMetadataFrame(qcamera_sm_metadata_evt_payload_t *meta)
+{
+    static const qcamera_internal_evt_type_t order[] = {
+        QCAMERA_INTERNAL_EVT_FACE_DETECT_RESULT,
+        QCAMERA_INTERNAL_EVT_HISTOGRAM_STATS,
+        QCAMERA_INTERNAL_EVT_FOCUS_UPDATE,
+        QCAMERA_INTERNAL_EVT_CROP_INFO,
+        QCAMERA_INTERNAL_EVT_PREP_SNAPSHOT_DONE,
+        QCAMERA_INTERNAL_EVT_AE_UPDATE,
+        QCAMERA_INTERNAL_EVT_AWB_UPDATE,
+        QCAMERA_INTERNAL_EVT_ASD_UPDATE,
+        QCAMERA_INTERNAL_EVT_FOCUS_POS_UPDATE,
+    };
+    qcamera_sm_internal_evt_payload_t *evt = &m_metaInternalEvt;
+    int32_t rc = NO_ERROR;
+
+    if (meta == NULL) {
+        return BAD_VALUE;
+    }
+
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        if (!(meta->valid_mask & QCAMERA_INTERNAL_EVT_BIT(order[i]))) {
+            continue;
+        }
+        evt->evt_type = order[i];
+        switch (order[i]) {
+        case QCAMERA_INTERNAL_EVT_FOCUS_UPDATE:
+            evt->focus_data = meta->focus_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_PREP_SNAPSHOT_DONE:
+            evt->prep_snapshot_state = meta->prep_snapshot_state;
+            break;
+        case QCAMERA_INTERNAL_EVT_FACE_DETECT_RESULT:
+            evt->faces_data = meta->faces_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_HISTOGRAM_STATS:
+            evt->stats_data = meta->stats_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_CROP_INFO:
+            evt->crop_data = meta->crop_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_ASD_UPDATE:
+            evt->asd_data = meta->asd_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_AWB_UPDATE:
+            evt->awb_data = meta->awb_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_AE_UPDATE:
+            evt->ae_data = meta->ae_data;
+            break;
+        case QCAMERA_INTERNAL_EVT_FOCUS_POS_UPDATE:
+            evt->focus_pos = meta->focus_pos;
+            break;
+        default:
+            break;
+        }
+        // the state may change with any of them, dispatch each on its own
+        int32_t ret = stateMachine(QCAMERA_SM_EVT_EVT_INTERNAL, evt);
+        if (ret != NO_ERROR) {
+            rc = ret;
+        }
+    }
+    return rc;
+}
+
 /*===========================================================================
  * FUNCTION   : stateMachine
  *
@@ -367,8 +708,8 @@ int32_t QCameraStateMachine::procEvtPreviewStoppedState(qcamera_sm_evt_enum_t ev
             bool needRestart = false;
             rc = m_parent->updateParameters((char*)payload, needRestart);
             if (needRestart) {
-                // Clear memory pools
-                m_parent->m_memoryPool.clear();
+                // Keep pooled buffers for the new configuration, within budget
+                m_parent->m_memoryPool.trim();
             }
             if (rc == NO_ERROR) {
                 rc = m_parent->commitParameterChanges();
@@ -404,7 +745,7 @@ int32_t QCameraStateMachine::procEvtPreviewStoppedState(qcamera_sm_evt_enum_t ev
                 rc = m_parent->preparePreview();
                 if(rc == NO_ERROR) {
                     // preview window is not set yet, move to previewReady state
-                    m_state = QCAMERA_SM_STATE_PREVIEW_READY;
+                    setState(QCAMERA_SM_STATE_PREVIEW_READY);
                 } else {
                     ALOGE("%s: preparePreview failed",__func__);
                 }
@@ -416,7 +757,7 @@ int32_t QCameraStateMachine::procEvtPreviewStoppedState(qcamera_sm_evt_enum_t ev
                         m_parent->unpreparePreview();
                     } else {
                         // start preview success, move to previewing state
-                        m_state = QCAMERA_SM_STATE_PREVIEWING;
+                        setState(QCAMERA_SM_STATE_PREVIEWING);
                     }
                 }
             }
@@ -434,7 +775,7 @@ int32_t QCameraStateMachine::procEvtPreviewStoppedState(qcamera_sm_evt_enum_t ev
                 if (rc != NO_ERROR) {
                     m_parent->unpreparePreview();
                 } else {
-                    m_state = QCAMERA_SM_STATE_PREVIEWING;
+                    setState(QCAMERA_SM_STATE_PREVIEWING);
                 }
             }
             result.status = rc;
@@ -629,9 +970,9 @@ int32_t QCameraStateMachine::procEvtPreviewReadyState(qcamera_sm_evt_enum_t evt,
                 rc = m_parent->startPreview();
                 if (rc != NO_ERROR) {
                     m_parent->unpreparePreview();
-                    m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+                    setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
                 } else {
-                    m_state = QCAMERA_SM_STATE_PREVIEWING;
+                    setState(QCAMERA_SM_STATE_PREVIEWING);
                 }
             }
 
@@ -692,14 +1033,14 @@ int32_t QCameraStateMachine::procEvtPreviewReadyState(qcamera_sm_evt_enum_t evt,
                 if (needRestart) {
                     // need restart preview for parameters to take effect
                     m_parent->unpreparePreview();
-                    // Clear memory pools
-                    m_parent->m_memoryPool.clear();
+                    // Keep pooled buffers for the new configuration, within budget
+                    m_parent->m_memoryPool.trim();
                     // commit parameter changes to server
                     m_parent->commitParameterChanges();
                     // prepare preview again
                     rc = m_parent->preparePreview();
                     if (rc != NO_ERROR) {
-                        m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+                        setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
                     }
                 } else {
                     rc = m_parent->commitParameterChanges();
@@ -745,7 +1086,7 @@ int32_t QCameraStateMachine::procEvtPreviewReadyState(qcamera_sm_evt_enum_t evt,
         {
             m_parent->unpreparePreview();
             rc = 0;
-            m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+            setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -986,8 +1327,8 @@ int32_t QCameraStateMachine::procEvtPreviewingState(qcamera_sm_evt_enum_t evt,
                     // need restart preview for parameters to take effect
                     // stop preview
                     m_parent->stopPreview();
-                    // Clear memory pools
-                    m_parent->m_memoryPool.clear();
+                    // Keep pooled buffers for the new configuration, within budget
+                    m_parent->m_memoryPool.trim();
                     // commit parameter changes to server
                     m_parent->commitParameterChanges();
                     // start preview again
@@ -999,7 +1340,7 @@ int32_t QCameraStateMachine::procEvtPreviewingState(qcamera_sm_evt_enum_t evt,
                         }
                     }
                     if (rc != NO_ERROR) {
-                        m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+                        setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
                     }
                 } else {
                     rc = m_parent->commitParameterChanges();
@@ -1045,7 +1386,7 @@ int32_t QCameraStateMachine::procEvtPreviewingState(qcamera_sm_evt_enum_t evt,
     case QCAMERA_SM_EVT_STOP_PREVIEW:
         {
             rc = m_parent->stopPreview();
-            m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+            setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -1113,7 +1454,7 @@ int32_t QCameraStateMachine::procEvtPreviewingState(qcamera_sm_evt_enum_t evt,
             rc = m_parent->startRecording();
             if (rc == NO_ERROR) {
                 // move state to recording state
-                m_state = QCAMERA_SM_STATE_RECORDING;
+                setState(QCAMERA_SM_STATE_RECORDING);
             }
             result.status = rc;
             result.request_api = evt;
@@ -1127,7 +1468,7 @@ int32_t QCameraStateMachine::procEvtPreviewingState(qcamera_sm_evt_enum_t evt,
             if (rc == NO_ERROR) {
                 // Do not signal API result in this case.
                 // Need to wait for snapshot done in metadta.
-                m_state = QCAMERA_SM_STATE_PREPARE_SNAPSHOT;
+                setState(QCAMERA_SM_STATE_PREPARE_SNAPSHOT);
             } else {
                 // Do not change state in this case.
                 ALOGE("%s: prepareHardwareForSnapshot failed %d",
@@ -1155,18 +1496,18 @@ int32_t QCameraStateMachine::procEvtPreviewingState(qcamera_sm_evt_enum_t evt,
                 }
            }
            if (m_parent->isZSLMode() || m_parent->isLongshotEnabled()) {
-               m_state = QCAMERA_SM_STATE_PREVIEW_PIC_TAKING;
+               setState(QCAMERA_SM_STATE_PREVIEW_PIC_TAKING);
                rc = m_parent->takePicture();
                if (rc != NO_ERROR) {
                    // move state to previewing state
-                   m_state = QCAMERA_SM_STATE_PREVIEWING;
+                   setState(QCAMERA_SM_STATE_PREVIEWING);
                }
            } else {
-               m_state = QCAMERA_SM_STATE_PIC_TAKING;
+               setState(QCAMERA_SM_STATE_PIC_TAKING);
                rc = m_parent->takePicture();
                if (rc != NO_ERROR) {
                    // move state to preview stopped state
-                   m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+                   setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
                }
            }
 
@@ -1186,8 +1527,8 @@ int32_t QCameraStateMachine::procEvtPreviewingState(qcamera_sm_evt_enum_t evt,
             if (CAMERA_CMD_LONGSHOT_ON == cmd_payload->cmd) {
                 if (QCAMERA_SM_EVT_RESTART_PERVIEW == cmd_payload->arg1) {
                     m_parent->stopPreview();
-                    // Clear memory pools
-                    m_parent->m_memoryPool.clear();
+                    // Keep pooled buffers for the new configuration, within budget
+                    m_parent->m_memoryPool.trim();
                     // start preview again
                     rc = m_parent->preparePreview();
                     if (rc == NO_ERROR) {
@@ -1385,7 +1726,7 @@ int32_t QCameraStateMachine::procEvtPrepareSnapshotState(qcamera_sm_evt_enum_t e
                 CDBG("%s: Received QCAMERA_INTERNAL_EVT_PREP_SNAPSHOT_DONE event",
                     __func__);
                 m_parent->processPrepSnapshotDoneEvent(internal_evt->prep_snapshot_state);
-                m_state = QCAMERA_SM_STATE_PREVIEWING;
+                setState(QCAMERA_SM_STATE_PREVIEWING);
 
                 result.status = NO_ERROR;
                 result.request_api = QCAMERA_SM_EVT_PREPARE_SNAPSHOT;
@@ -1580,7 +1921,7 @@ int32_t QCameraStateMachine::procEvtPicTakingState(qcamera_sm_evt_enum_t evt,
         {
             // cancel picture first
             rc = m_parent->cancelPicture();
-            m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+            setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
 
             result.status = rc;
             result.request_api = evt;
@@ -1653,7 +1994,7 @@ int32_t QCameraStateMachine::procEvtPicTakingState(qcamera_sm_evt_enum_t evt,
                                        cmd_payload->arg2);
             if ( CAMERA_CMD_LONGSHOT_OFF == cmd_payload->cmd ) {
                 // move state to previewing state
-                m_state = QCAMERA_SM_STATE_PREVIEWING;
+                setState(QCAMERA_SM_STATE_PREVIEWING);
             }
             result.status = rc;
             result.request_api = evt;
@@ -1664,7 +2005,7 @@ int32_t QCameraStateMachine::procEvtPicTakingState(qcamera_sm_evt_enum_t evt,
     case QCAMERA_SM_EVT_CANCEL_PICTURE:
         {
             rc = m_parent->cancelPicture();
-            m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+            setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -1807,9 +2148,9 @@ int32_t QCameraStateMachine::procEvtPicTakingState(qcamera_sm_evt_enum_t evt,
 
             bool restartPreview = m_parent->isPreviewRestartEnabled();
             if (restartPreview) {
-                m_state = QCAMERA_SM_STATE_PREVIEWING;
+                setState(QCAMERA_SM_STATE_PREVIEWING);
             } else {
-                m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+                setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
             }
 
             result.status = rc;
@@ -2024,10 +2365,10 @@ int32_t QCameraStateMachine::procEvtRecordingState(qcamera_sm_evt_enum_t evt,
         break;
     case QCAMERA_SM_EVT_TAKE_PICTURE:
         {
-            m_state = QCAMERA_SM_STATE_VIDEO_PIC_TAKING;
+            setState(QCAMERA_SM_STATE_VIDEO_PIC_TAKING);
             rc = m_parent->takeLiveSnapshot();
             if (rc != NO_ERROR) {
-                m_state = QCAMERA_SM_STATE_RECORDING;
+                setState(QCAMERA_SM_STATE_RECORDING);
             }
             result.status = rc;
             result.request_api = evt;
@@ -2049,7 +2390,7 @@ int32_t QCameraStateMachine::procEvtRecordingState(qcamera_sm_evt_enum_t evt,
     case QCAMERA_SM_EVT_STOP_RECORDING:
         {
             rc = m_parent->stopRecording();
-            m_state = QCAMERA_SM_STATE_PREVIEWING;
+            setState(QCAMERA_SM_STATE_PREVIEWING);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -2059,10 +2400,10 @@ int32_t QCameraStateMachine::procEvtRecordingState(qcamera_sm_evt_enum_t evt,
     case QCAMERA_SM_EVT_STOP_PREVIEW:
         {
             rc = m_parent->stopRecording();
-            m_state = QCAMERA_SM_STATE_PREVIEWING;
+            setState(QCAMERA_SM_STATE_PREVIEWING);
 
             rc = m_parent->stopPreview();
-            m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+            setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
 
             result.status = rc;
             result.request_api = evt;
@@ -2385,10 +2726,10 @@ int32_t QCameraStateMachine::procEvtVideoPicTakingState(qcamera_sm_evt_enum_t ev
     case QCAMERA_SM_EVT_STOP_RECORDING:
         {
             rc = m_parent->cancelLiveSnapshot();
-            m_state = QCAMERA_SM_STATE_RECORDING;
+            setState(QCAMERA_SM_STATE_RECORDING);
 
             rc = m_parent->stopRecording();
-            m_state = QCAMERA_SM_STATE_PREVIEWING;
+            setState(QCAMERA_SM_STATE_PREVIEWING);
 
             result.status = rc;
             result.request_api = evt;
@@ -2408,7 +2749,7 @@ int32_t QCameraStateMachine::procEvtVideoPicTakingState(qcamera_sm_evt_enum_t ev
     case QCAMERA_SM_EVT_CANCEL_PICTURE:
         {
             rc = m_parent->cancelLiveSnapshot();
-            m_state = QCAMERA_SM_STATE_RECORDING;
+            setState(QCAMERA_SM_STATE_RECORDING);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -2433,13 +2774,13 @@ int32_t QCameraStateMachine::procEvtVideoPicTakingState(qcamera_sm_evt_enum_t ev
     case QCAMERA_SM_EVT_STOP_PREVIEW:
         {
             rc = m_parent->cancelLiveSnapshot();
-            m_state = QCAMERA_SM_STATE_RECORDING;
+            setState(QCAMERA_SM_STATE_RECORDING);
 
             rc = m_parent->stopRecording();
-            m_state = QCAMERA_SM_STATE_PREVIEWING;
+            setState(QCAMERA_SM_STATE_PREVIEWING);
 
             rc = m_parent->stopPreview();
-            m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+            setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
 
             result.status = rc;
             result.request_api = evt;
@@ -2526,7 +2867,7 @@ int32_t QCameraStateMachine::procEvtVideoPicTakingState(qcamera_sm_evt_enum_t ev
     case QCAMERA_SM_EVT_SNAPSHOT_DONE:
         {
             rc = m_parent->cancelLiveSnapshot();
-            m_state = QCAMERA_SM_STATE_RECORDING;
+            setState(QCAMERA_SM_STATE_RECORDING);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -2625,8 +2966,8 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
                     // need restart preview for parameters to take effect
                     // stop preview
                     m_parent->stopPreview();
-                    // Clear memory pools
-                    m_parent->m_memoryPool.clear();
+                    // Keep pooled buffers for the new configuration, within budget
+                    m_parent->m_memoryPool.trim();
                     // commit parameter changes to server
                     m_parent->commitParameterChanges();
                     // start preview again
@@ -2638,7 +2979,7 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
                         }
                     }
                     if (rc != NO_ERROR) {
-                        m_state = QCAMERA_SM_STATE_PIC_TAKING;
+                        setState(QCAMERA_SM_STATE_PIC_TAKING);
                     }
                 } else {
                     rc = m_parent->commitParameterChanges();
@@ -2734,7 +3075,7 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
                                        cmd_payload->arg2);
             if ( CAMERA_CMD_LONGSHOT_OFF == cmd_payload->cmd ) {
                 // move state to previewing state
-                m_state = QCAMERA_SM_STATE_PREVIEWING;
+                setState(QCAMERA_SM_STATE_PREVIEWING);
             }
             result.status = rc;
             result.request_api = evt;
@@ -2758,7 +3099,7 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
             } else {
                 rc = m_parent->cancelLiveSnapshot();
             }
-            m_state = QCAMERA_SM_STATE_PREVIEWING;
+            setState(QCAMERA_SM_STATE_PREVIEWING);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -2780,7 +3121,7 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
             }
             // unprepare preview
             m_parent->unpreparePreview();
-            m_state = QCAMERA_SM_STATE_PREVIEW_STOPPED;
+            setState(QCAMERA_SM_STATE_PREVIEW_STOPPED);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -2800,7 +3141,7 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
             } else {
                 rc = m_parent->startRecording();
                 if (rc == NO_ERROR) {
-                    m_state = QCAMERA_SM_STATE_VIDEO_PIC_TAKING;
+                    setState(QCAMERA_SM_STATE_VIDEO_PIC_TAKING);
                 }
             }
             result.status = rc;
@@ -2932,7 +3273,7 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
             } else {
                 rc = m_parent->cancelLiveSnapshot();
             }
-            m_state = QCAMERA_SM_STATE_PREVIEWING;
+            setState(QCAMERA_SM_STATE_PREVIEWING);
             result.status = rc;
             result.request_api = evt;
             result.result_type = QCAMERA_API_RESULT_TYPE_DEF;
@@ -2957,6 +3298,116 @@ int32_t QCameraStateMachine::procEvtPreviewPicTakingState(qcamera_sm_evt_enum_t
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : setState
+ *
+ * DESCRIPTION: switch to a new state and publish the answers of the read
+ *              only APIs for it. Only called from the cmd thread, before the
+ *              API result of the transition is signaled, so a caller that
+ *              returns from an API sees the snapshot of the state it left
+ *              the statemachine in.
+ *
+ * PARAMETERS :
+ *   @state   : new state
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraStateMachine::setState(qcamera_state_enum_t state)
+{
+    uint32_t snap = (uint32_t)state & QCAMERA_SM_SNAP_STATE_MASK;
+
+    // same answers as the PREVIEW_ENABLED/RECORDING_ENABLED handlers of
+    // each state. PREPARE_SNAPSHOT rejects them, leave it to its handler.
+    switch (state) {
+    case QCAMERA_SM_STATE_PREVIEW_STOPPED:
+    case QCAMERA_SM_STATE_PIC_TAKING:
+        snap |= QCAMERA_SM_SNAP_VALID;
+        break;
+    case QCAMERA_SM_STATE_PREVIEW_READY:
+    case QCAMERA_SM_STATE_PREVIEWING:
+    case QCAMERA_SM_STATE_PREVIEW_PIC_TAKING:
+        snap |= QCAMERA_SM_SNAP_VALID | QCAMERA_SM_SNAP_PREVIEW_ENABLED;
+        break;
+    case QCAMERA_SM_STATE_RECORDING:
+        snap |= QCAMERA_SM_SNAP_VALID | QCAMERA_SM_SNAP_RECORDING_ENABLED;
+        break;
+    case QCAMERA_SM_STATE_VIDEO_PIC_TAKING:
+        snap |= QCAMERA_SM_SNAP_VALID | QCAMERA_SM_SNAP_PREVIEW_ENABLED |
+                QCAMERA_SM_SNAP_RECORDING_ENABLED;
+        break;
+    case QCAMERA_SM_STATE_PREPARE_SNAPSHOT:
+    default:
+        break;
+    }
+
+    m_state = state;
+    __atomic_store_n(&m_snapshot, snap, __ATOMIC_RELEASE);
+}
+
+/*===========================================================================
+ * FUNCTION   : canAnswerQueries
+ *
+ * DESCRIPTION: if the current state answers the read only APIs (preview,
+ *              recording and msg type enabled) without side effects, so the
+ *              caller may answer them itself. Safe from any thread.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true  -- answer without procAPI
+ *              false -- current state has to answer through procAPI
+ *==========================================================================*/
+bool QCameraStateMachine::canAnswerQueries()
+{
+    return (__atomic_load_n(&m_snapshot, __ATOMIC_ACQUIRE) &
+            QCAMERA_SM_SNAP_VALID) != 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : getPreviewEnabled
+ *
+ * DESCRIPTION: answer preview_enabled from the published snapshot without
+ *              going through the cmd thread. Safe from any thread.
+ *
+ * PARAMETERS :
+ *   @enabled : [output] 1 if preview is enabled, 0 otherwise
+ *
+ * RETURN     : true  -- enabled is valid
+ *              false -- current state has to answer through procAPI
+ *==========================================================================*/
+bool QCameraStateMachine::getPreviewEnabled(int &enabled)
+{
+    uint32_t snap = __atomic_load_n(&m_snapshot, __ATOMIC_ACQUIRE);
+
+    if (!(snap & QCAMERA_SM_SNAP_VALID)) {
+        return false;
+    }
+    enabled = (snap & QCAMERA_SM_SNAP_PREVIEW_ENABLED) ? 1 : 0;
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : getRecordingEnabled
+ *
+ * DESCRIPTION: answer recording_enabled from the published snapshot without
+ *              going through the cmd thread. Safe from any thread.
+ *
+ * PARAMETERS :
+ *   @enabled : [output] 1 if recording is enabled, 0 otherwise
+ *
+ * RETURN     : true  -- enabled is valid
+ *              false -- current state has to answer through procAPI
+ *==========================================================================*/
+bool QCameraStateMachine::getRecordingEnabled(int &enabled)
+{
+    uint32_t snap = __atomic_load_n(&m_snapshot, __ATOMIC_ACQUIRE);
+
+    if (!(snap & QCAMERA_SM_SNAP_VALID)) {
+        return false;
+    }
+    enabled = (snap & QCAMERA_SM_SNAP_RECORDING_ENABLED) ? 1 : 0;
+    return true;
+}
+
 /*===========================================================================
  * FUNCTION   : isPreviewRunning
  *
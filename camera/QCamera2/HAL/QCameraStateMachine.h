@@ -87,6 +87,8 @@ typedef enum {
     QCAMERA_SM_EVT_THERMAL_NOTIFY,           // evt notify from thermal daemon
     QCAMERA_SM_EVT_STOP_CAPTURE_CHANNEL,     // stop capture channel
     QCAMERA_SM_EVT_RESTART_PERVIEW,          // internal preview restart
+    QCAMERA_SM_EVT_METADATA_FRAME,           // internal evts of one metadata frame
+    QCAMERA_SM_EVT_LOAD_NOTIFY,              // fps step change from load governor
     QCAMERA_SM_EVT_MAX
 } qcamera_sm_evt_enum_t;
 
@@ -164,6 +166,34 @@ typedef struct {
     };
 } qcamera_sm_internal_evt_payload_t;
 
+#define QCAMERA_INTERNAL_EVT_BIT(type) (1U << (type))
+
+// payload of QCAMERA_SM_EVT_METADATA_FRAME: the internal evts found in one
+// metadata buffer, dispatched one by one in the order the metadata callback
+// used to post them. Only sections flagged in valid_mask are filled in.
+typedef struct {
+    uint32_t valid_mask;                     // QCAMERA_INTERNAL_EVT_BIT of each section
+    cam_auto_focus_data_t focus_data;
+    cam_prep_snapshot_state_t prep_snapshot_state;
+    cam_face_detection_data_t faces_data;
+    cam_hist_stats_t stats_data;
+    cam_crop_data_t crop_data;
+    cam_auto_scene_t asd_data;
+    cam_awb_params_t awb_data;
+    cam_ae_params_t ae_data;
+    cam_focus_pos_info_t focus_pos;
+} qcamera_sm_metadata_evt_payload_t;
+
+// counters of the metadata evt path
+typedef struct {
+    uint32_t frames;                         // metadata frames with any evt
+    uint32_t evts;                           // internal evts carried
+    uint32_t max_evts;                       // most evts in one frame
+    uint32_t posts;                          // evt_queue posts for them
+    uint32_t pooled;                         // payloads served from the pools
+    uint32_t allocs;                         // payloads malloc'ed, pools empty
+} qcamera_sm_evt_stats_t;
+
 class QCameraStateMachine
 {
 public:
@@ -175,8 +205,21 @@ public:
     bool isPreviewRunning(); // check if preview is running
     bool isCaptureRunning(); // check if image capture is running
     bool isNonZSLCaptureRunning(); // check if image capture is running in non ZSL mode
+    // lock free answers of the read only APIs, false when the current
+    // state has to be asked through procAPI
+    bool canAnswerQueries();
+    bool getPreviewEnabled(int &enabled);
+    bool getRecordingEnabled(int &enabled);
     void releaseThread();
 
+    // evt payloads for the metadata path, release with releaseEvtPayload
+    qcamera_sm_internal_evt_payload_t *getInternalEvtPayload();
+    qcamera_sm_metadata_evt_payload_t *getMetadataEvtPayload();
+    void releaseEvtPayload(void *payload);
+    bool isMetadataCoalesced() { return m_bCoalesceMetadata; };
+    void addMetadataFrameStats(uint32_t evts, uint32_t posts);
+    void dumpEvtStats(int fd);
+
 private:
     typedef enum {
         QCAMERA_SM_STATE_PREVIEW_STOPPED,          // preview is stopped
@@ -204,6 +247,23 @@ private:
         void *evt_payload;                          // ptr to payload
     } qcamera_sm_cmd_t;
 
+    // fixed set of equally sized payload slots
+    typedef struct {
+        uint8_t *base;                              // slot storage
+        size_t slot_size;                           // bytes per slot
+        uint32_t num_slots;                         // slots in base
+        uint32_t num_free;                          // entries in free_slots
+        uint32_t *free_slots;                       // stack of free slot indices
+    } qcamera_sm_payload_pool_t;
+
+    static void initPayloadPool(qcamera_sm_payload_pool_t &pool,
+            size_t slot_size, uint32_t num_slots);
+    static void deinitPayloadPool(qcamera_sm_payload_pool_t &pool);
+    void *getPayload(qcamera_sm_payload_pool_t &pool);
+    static bool putPayload(qcamera_sm_payload_pool_t &pool, void *payload);
+    int32_t procMetadataFrame(qcamera_sm_metadata_evt_payload_t *meta);
+
+    void setState(qcamera_state_enum_t state);
     int32_t stateMachine(qcamera_sm_evt_enum_t evt, void *payload);
     int32_t procEvtPreviewStoppedState(qcamera_sm_evt_enum_t evt, void *payload);
     int32_t procEvtPreviewReadyState(qcamera_sm_evt_enum_t evt, void *payload);
@@ -219,11 +279,19 @@ private:
 
     QCamera2HardwareInterface *m_parent;  // ptr to HWI
     qcamera_state_enum_t m_state;         // statemachine state
+    uint32_t m_snapshot;                  // read only API answers of m_state, atomic
     QCameraQueue api_queue;               // cmd queue for APIs
     QCameraQueue evt_queue;               // cmd queue for evt from mm-camera-intf/mm-jpeg-intf
     pthread_t cmd_pid;                    // cmd thread ID
     cam_semaphore_t cmd_sem;              // semaphore for cmd thread
 
+    bool m_bCoalesceMetadata;             // post one evt per metadata frame
+    pthread_mutex_t m_evtPoolLock;        // protects pools and stats below
+    qcamera_sm_payload_pool_t m_internalEvtPool;
+    qcamera_sm_payload_pool_t m_metadataEvtPool;
+    qcamera_sm_evt_stats_t m_evtStats;
+    qcamera_sm_internal_evt_payload_t m_metaInternalEvt; // fan out scratch
+
 };
 
 }; // namespace qcamera
@@ -232,10 +232,12 @@ QCameraStream::QCameraStream(QCameraAllocator &allocator,
         mStreamInfo(NULL),
         mNumBufs(0),
         mNumBufsNeedAlloc(0),
+        mNumBufsReserved(0),
+        mNumBufsIdle(0),
         mRegFlags(NULL),
         mDataCB(NULL),
         mUserData(NULL),
-        mDataQ(releaseFrameData, this),
+        mDataQ(CAM_MAX_NUM_BUFS_PER_STREAM, true, releaseFrameData, this),
         mStreamInfoBuf(NULL),
         mStreamBufs(NULL),
         mAllocator(allocator),
@@ -666,7 +668,11 @@ int32_t QCameraStream::processDataNotify(mm_camera_super_buf_t *frame)
 {
     CDBG("%s:\n", __func__);
     if (m_bActive) {
-        mDataQ.enqueue((void *)frame);
+        if (!mDataQ.enqueue((void *)frame)) {
+            bufDone(frame->bufs[0]->buf_idx);
+            free(frame);
+            return NO_MEMORY;
+        }
         return mProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     } else {
         CDBG("%s: Stream thread is not active, no ops here", __func__);
@@ -700,6 +706,7 @@ void QCameraStream::dataNotifyCB(mm_camera_super_buf_t *recvd_frame,
         ALOGE("%s: Not a valid stream to handle buf", __func__);
         return;
     }
+    CAM_TRACE_BUF(CAM_TRACE_DATA_NOTIFY, recvd_frame->bufs[0]);
 
     mm_camera_super_buf_t *frame =
         (mm_camera_super_buf_t *)malloc(sizeof(mm_camera_super_buf_t));
@@ -751,6 +758,7 @@ void *QCameraStream::dataProcRoutine(void *data)
                 mm_camera_super_buf_t *frame =
                     (mm_camera_super_buf_t *)pme->mDataQ.dequeue();
                 if (NULL != frame) {
+                    CAM_TRACE_BUF(CAM_TRACE_DATA_PROC, frame->bufs[0]);
                     if (pme->mDataCB != NULL) {
                         pme->mDataCB(frame, pme, pme->mUserData);
                     } else {
@@ -794,6 +802,7 @@ int32_t QCameraStream::bufDone(uint32_t index)
     if (index >= mNumBufs || mBufDefs == NULL)
         return BAD_INDEX;
 
+    CAM_TRACE_BUF(CAM_TRACE_BUF_DONE, &mBufDefs[index]);
     rc = mCamOps->qbuf(mCamHandle, mChannelHandle, &mBufDefs[index]);
     if (rc < 0)
         return rc;
@@ -883,15 +892,17 @@ int32_t QCameraStream::getBufs(cam_frame_len_offset_t *offset,
 
     mFrameLenOffset = *offset;
 
-    uint8_t numBufAlloc = mNumBufs;
+    // reserved slots are registered below but only allocated by growBufs
+    uint8_t numBufUsed = (uint8_t)(mNumBufs - mNumBufsReserved);
+    uint8_t numBufAlloc = numBufUsed;
     mNumBufsNeedAlloc = 0;
     if (mDynBufAlloc) {
         numBufAlloc = CAMERA_MIN_ALLOCATED_BUFFERS;
-        if (numBufAlloc > mNumBufs) {
+        if (numBufAlloc > numBufUsed) {
             mDynBufAlloc = false;
-            numBufAlloc = mNumBufs;
+            numBufAlloc = numBufUsed;
         } else {
-            mNumBufsNeedAlloc = (uint8_t)(mNumBufs - numBufAlloc);
+            mNumBufsNeedAlloc = (uint8_t)(numBufUsed - numBufAlloc);
         }
     }
 
@@ -901,7 +912,8 @@ int32_t QCameraStream::getBufs(cam_frame_len_offset_t *offset,
                                                mFrameLenOffset.mp[0].stride,
                                                mFrameLenOffset.mp[0].scanline,
                                                numBufAlloc);
-    mNumBufs = (uint8_t)(numBufAlloc + mNumBufsNeedAlloc);
+    mNumBufs = (uint8_t)(numBufAlloc + mNumBufsNeedAlloc + mNumBufsReserved);
+    mNumBufsIdle = mNumBufsReserved;
 
     if (!mStreamBufs) {
         ALOGE("%s: Failed to allocate stream buffers", __func__);
@@ -981,14 +993,14 @@ int32_t QCameraStream::getBufs(cam_frame_len_offset_t *offset,
     *initial_reg_flag = regFlags;
     *bufs = mBufDefs;
 
+    // remember memops table for buffers mapped later
+    m_MemOpsTbl = *ops_tbl;
     if (mNumBufsNeedAlloc > 0) {
         pthread_mutex_lock(&m_lock);
         wait_for_cond = TRUE;
         pthread_mutex_unlock(&m_lock);
         CDBG_HIGH("%s: Still need to allocate %d buffers",
               __func__, mNumBufsNeedAlloc);
-        // remember memops table
-        m_MemOpsTbl = *ops_tbl;
         // start another thread to allocate the rest of buffers
         pthread_create(&mBufAllocPid,
                        NULL,
@@ -1161,12 +1173,13 @@ void *QCameraStream::BufAllocRoutine(void *data)
     CDBG_HIGH("%s: E", __func__);
     pme->cond_wait();
     if (pme->mNumBufsNeedAlloc > 0) {
-        uint8_t numBufAlloc = (uint8_t)(pme->mNumBufs - pme->mNumBufsNeedAlloc);
+        uint8_t numBufUsed = (uint8_t)(pme->mNumBufs - pme->mNumBufsReserved);
+        uint8_t numBufAlloc = (uint8_t)(numBufUsed - pme->mNumBufsNeedAlloc);
         rc = pme->mAllocator.allocateMoreStreamBuf(pme->mStreamBufs,
                                                    pme->mFrameLenOffset.frame_len,
                                                    pme->mNumBufsNeedAlloc);
         if (rc == NO_ERROR){
-            for (uint32_t i = numBufAlloc; i < pme->mNumBufs; i++) {
+            for (uint32_t i = numBufAlloc; i < numBufUsed; i++) {
                 ssize_t bufSize = pme->mStreamBufs->getSize(i);
                 if (BAD_INDEX != bufSize) {
                     rc = pme->m_MemOpsTbl.map_ops(i, -1, pme->mStreamBufs->getFd(i),
@@ -1190,6 +1203,112 @@ void *QCameraStream::BufAllocRoutine(void *data)
     return NULL;
 }
 
+/*===========================================================================
+ * FUNCTION   : setReservedBufs
+ *
+ * DESCRIPTION: keep the last slots of the stream registered with the
+ *              kernel but unallocated until growBufs asks for them
+ *
+ * PARAMETERS :
+ *   @count   : number of slots to hold back
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *
+ * NOTE       : only before the stream buffers are registered
+ *==========================================================================*/
+int32_t QCameraStream::setReservedBufs(uint8_t count)
+{
+    if (mBufDefs != NULL) {
+        ALOGE("%s: stream buffers already registered", __func__);
+        return INVALID_OPERATION;
+    }
+    if (count >= mNumBufs) {
+        ALOGE("%s: %d reserved of %d buffers", __func__, count, mNumBufs);
+        return BAD_VALUE;
+    }
+    mNumBufsReserved = count;
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : growBufs
+ *
+ * DESCRIPTION: allocate buffers for reserved slots, map them and queue
+ *              them to the kernel while the stream is running
+ *
+ * PARAMETERS :
+ *   @count   : [IN/OUT] number of buffers to add. Output is the number
+ *              actually added.
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *
+ * NOTE       : the caller keeps this from overlapping with stream stop
+ *==========================================================================*/
+int32_t QCameraStream::growBufs(uint8_t &count)
+{
+    int32_t rc = NO_ERROR;
+    uint8_t first = (uint8_t)(mNumBufs - mNumBufsIdle);
+
+    if (mStreamBufs == NULL || mBufDefs == NULL) {
+        count = 0;
+        return INVALID_OPERATION;
+    }
+    // buffer indexes have to line up with the slots
+    if (mNumBufsNeedAlloc > 0 || mStreamBufs->getCnt() != first) {
+        ALOGE("%s: stream buffers still being allocated", __func__);
+        count = 0;
+        return INVALID_OPERATION;
+    }
+    if (count > mNumBufsIdle) {
+        count = mNumBufsIdle;
+    }
+    if (count == 0) {
+        return NO_MEMORY;
+    }
+
+    uint8_t numBufs = count;
+    rc = mAllocator.allocateMoreStreamBuf(mStreamBufs,
+            mFrameLenOffset.frame_len, numBufs);
+    if (rc != NO_ERROR) {
+        ALOGE("%s: allocating %d buffers failed: %d", __func__, count, rc);
+        count = 0;
+        return rc;
+    }
+
+    // the memory object can not give single buffers back, so the slots
+    // are used up even if one of them fails below
+    mNumBufsIdle = (uint8_t)(mNumBufsIdle - count);
+    uint8_t added = 0;
+    for (uint32_t i = first; i < (uint32_t)(first + count); i++) {
+        ssize_t bufSize = mStreamBufs->getSize(i);
+        if (BAD_INDEX == bufSize) {
+            ALOGE("Failed to retrieve buffer size (bad index)");
+            continue;
+        }
+        rc = m_MemOpsTbl.map_ops(i, -1, mStreamBufs->getFd(i),
+                (uint32_t)bufSize, m_MemOpsTbl.userdata);
+        if (rc < 0) {
+            ALOGE("%s: map_stream_buf %d failed: %d", __func__, i, rc);
+            continue;
+        }
+        mStreamBufs->getBufDef(mFrameLenOffset, mBufDefs[i], i);
+        rc = mCamOps->qbuf(mCamHandle, mChannelHandle, &mBufDefs[i]);
+        if (rc < 0) {
+            ALOGE("%s: qbuf %d failed: %d", __func__, i, rc);
+            continue;
+        }
+        added++;
+    }
+    CDBG_HIGH("%s: added %d of %d buffers, %d reserved left", __func__,
+            added, count, mNumBufsIdle);
+    count = added;
+    return (added > 0) ? NO_ERROR : UNKNOWN_ERROR;
+}
+
 /*===========================================================================
  * FUNCTION   : cond_signal
  *
@@ -1245,12 +1364,14 @@ int32_t QCameraStream::putBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl)
         CDBG_HIGH("%s: return from buf allocation thread", __func__);
     }
 
-    for (uint32_t i = 0; i < mNumBufs; i++) {
+    // reserved slots that were never grown into were never mapped
+    for (uint32_t i = 0; i < (uint32_t)(mNumBufs - mNumBufsIdle); i++) {
         rc = ops_tbl->unmap_ops(i, -1, ops_tbl->userdata);
         if (rc < 0) {
             ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
         }
     }
+    mNumBufsIdle = 0;
     mBufDefs = NULL; // mBufDefs just keep a ptr to the buffer
                      // mm-camera-interface own the buffer, so no need to free
     memset(&mFrameLenOffset, 0, sizeof(mFrameLenOffset));
@@ -32,11 +32,13 @@
 
 #include <hardware/camera.h>
 #include "QCameraCmdThread.h"
+#include "QCameraBoundedQueue.h"
 #include "QCameraMem.h"
 #include "QCameraAllocator.h"
 
 extern "C" {
 #include <mm_camera_interface.h>
+#include <cam_trace.h>
 }
 
 namespace qcamera {
@@ -73,6 +75,10 @@ public:
     virtual int32_t allocateBuffers();
     virtual int32_t releaseBuffs();
 
+    /* Registered slots that are only allocated on demand */
+    int32_t setReservedBufs(uint8_t count);
+    int32_t growBufs(uint8_t &count);
+
     static void dataNotifyCB(mm_camera_super_buf_t *recvd_frame, void *userdata);
     static void *dataProcRoutine(void *data);
     static void *BufAllocRoutine(void *data);
@@ -125,11 +131,13 @@ private:
     mm_camera_stream_mem_vtbl_t mMemVtbl;
     uint8_t mNumBufs;
     uint8_t mNumBufsNeedAlloc;
+    uint8_t mNumBufsReserved; // slots registered but left for growBufs
+    uint8_t mNumBufsIdle;     // reserved slots not grown into yet
     uint8_t *mRegFlags;
     stream_cb_routine mDataCB;
     void *mUserData;
 
-    QCameraQueue     mDataQ;
+    QCameraBoundedQueue mDataQ; // one producer (dataNotifyCB), one consumer
     QCameraCmdThread mProcTh; // thread for dataCB
 
     QCameraHeapMemory *mStreamInfoBuf;
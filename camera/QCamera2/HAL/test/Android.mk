@@ -52,3 +52,200 @@ LOCAL_CFLAGS += -O0
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_queue_test.cpp \
+    ../../util/QCameraQueue.cpp \
+    ../../util/QCameraBoundedQueue.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libutils \
+    libcutils \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../util \
+    $(LOCAL_PATH)/../../stack/common \
+
+LOCAL_MODULE:= qcamera_queue_test
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_burst_test.cpp \
+    ../../util/QCameraBurstScheduler.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../util \
+
+LOCAL_MODULE:= qcamera_burst_test
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_load_test.cpp \
+    ../../util/QCameraLoadGovernor.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../util \
+
+LOCAL_MODULE:= qcamera_load_test
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_recording_test.cpp \
+    ../../util/QCameraBufIndexMap.cpp \
+    ../../util/QCameraRecordingMonitor.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../util \
+
+LOCAL_MODULE:= qcamera_recording_test
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_synth_test.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libutils \
+    libcutils \
+    libhardware \
+    libcamera_client \
+
+LOCAL_C_INCLUDES += \
+    $(call project-path-for,qcom-display)/libgralloc \
+
+ifeq ($(call is-platform-sdk-version-at-least,20),true)
+LOCAL_C_INCLUDES += system/media/camera/include
+endif
+
+LOCAL_MODULE:= qcamera_synth_test
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_plane_ops_test.cpp \
+    ../../util/QCameraPlaneOps.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../util \
+
+LOCAL_MODULE:= qcamera_plane_ops_test
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_dump_extract.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../util \
+
+LOCAL_MODULE:= qcamera_dump_extract
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_api_bench.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libutils \
+    libcutils \
+    libhardware \
+    libcamera_client \
+
+LOCAL_C_INCLUDES += \
+    $(call project-path-for,qcom-display)/libgralloc \
+
+ifeq ($(call is-platform-sdk-version-at-least,20),true)
+LOCAL_C_INCLUDES += system/media/camera/include
+endif
+
+LOCAL_MODULE:= qcamera_api_bench
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_open_bench.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    liblog \
+    libutils \
+    libcutils \
+    libhardware \
+    libcamera_client \
+
+ifeq ($(call is-platform-sdk-version-at-least,20),true)
+LOCAL_C_INCLUDES += system/media/camera/include
+endif
+
+LOCAL_MODULE:= qcamera_open_bench
+LOCAL_32_BIT_ONLY := true
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,75 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __HOST_QCAMERA_STREAM_H__
+#define __HOST_QCAMERA_STREAM_H__
+
+/* Host stand-in for the stream object: the frame geometry QCameraMakeup
+ * asks for and a count of the buffers handed back per index.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+#include <mm_camera_interface.h>
+}
+
+namespace qcamera {
+
+class QCameraStream {
+public:
+    static const uint32_t MAX_BUFS = 64;
+
+    QCameraStream() : done(0)
+    {
+        memset(&offset, 0, sizeof(offset));
+        memset(&dim, 0, sizeof(dim));
+        memset(returned, 0, sizeof(returned));
+    }
+    int32_t getFrameOffset(cam_frame_len_offset_t &o) { o = offset; return 0; }
+    int32_t getFrameDimension(cam_dimension_t &d) { d = dim; return 0; }
+    int32_t bufDone(uint32_t index)
+    {
+        __sync_fetch_and_add(&done, 1);
+        if (index < MAX_BUFS) {
+            __sync_fetch_and_add(&returned[index], 1);
+        }
+        return 0;
+    }
+
+    cam_frame_len_offset_t offset;
+    cam_dimension_t dim;
+    int done;
+    int returned[MAX_BUFS];
+};
+
+}; // namespace qcamera
+
+#endif /* __HOST_QCAMERA_STREAM_H__ */
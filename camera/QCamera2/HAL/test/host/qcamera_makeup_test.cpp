@@ -0,0 +1,517 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Host check of QCameraMakeup with the TS makeup library faked:
+ *   - preview: skipped when off or without a face, packed and padded
+ *     frames are beautified and written back with their strides
+ *   - snapshot: seeded from a fresh preview track of the same aspect
+ *     ratio, otherwise from the detector, whose context is created once
+ *   - worker: frames queued faster than they are processed are dropped
+ *     back to the stream, at most MAX_PENDING_FRAMES wait
+ *   - stop during load: stopWorker while the stream thread keeps
+ *     delivering never lets the worker and the inline path use the
+ *     preview buffers or the display at the same time, and every frame
+ *     is either displayed or returned to the stream exactly once
+ *
+ *   make -C camera/QCamera2/HAL/test/host check
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Errors.h>
+
+#include "QCameraMakeup.h"
+#include "QCameraMem.h"
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define TEST_Y          10
+#define TEST_UV         20
+#define TEST_NUM_BUFS   8
+#define LOAD_FRAMES     300
+#define LOAD_CYCLES     10
+
+using namespace android;
+using namespace qcamera;
+
+/* fake TS makeup library: +1 on luma, +2 on chroma, detects a face unless
+ * the first luma byte is TEST_NO_FACE */
+#define TEST_NO_FACE    7
+
+static int g_create, g_destroy, g_detect, g_beauty;
+static int g_busy;                      // threads inside beauty or display
+static int g_overlaps;
+static TSRect g_lastRect;
+static useconds_t g_beautyUs;
+
+static void enter()
+{
+    if (__sync_add_and_fetch(&g_busy, 1) > 1) {
+        __sync_fetch_and_add(&g_overlaps, 1);
+    }
+}
+
+static void leave()
+{
+    __sync_fetch_and_sub(&g_busy, 1);
+}
+
+TSHandle ts_detectface_create_context()
+{
+    g_create++;
+    return (TSHandle)&g_create;
+}
+
+void ts_detectface_destroy_context(TSHandle *handle)
+{
+    g_destroy++;
+    *handle = NULL;
+}
+
+int ts_detectface_detect(TSHandle handle, TSMakeupData *data)
+{
+    g_detect++;
+    return (data->yBuf[0] == TEST_NO_FACE) ? 0 : 1;
+}
+
+int ts_detectface_get_face_info(TSHandle handle, int index, TSRect *face,
+        TSRect *leftEye, TSRect *rightEye, TSRect *mouth)
+{
+    face->left = 1;
+    face->top = 2;
+    face->right = 3;
+    face->bottom = 4;
+    return TS_OK;
+}
+
+int ts_makeup_skin_beauty(TSMakeupData *in, TSMakeupData *out,
+        const TSRect *face, int clean, int white)
+{
+    size_t ySize = (size_t)in->frameWidth * in->frameHeight;
+
+    enter();
+    __sync_fetch_and_add(&g_beauty, 1);
+    g_lastRect = *face;
+    for (size_t i = 0; i < ySize; i++) {
+        out->yBuf[i] = (uint8_t)(in->yBuf[i] + 1);
+    }
+    for (size_t i = 0; i < ySize / 2; i++) {
+        out->uvBuf[i] = (uint8_t)(in->uvBuf[i] + 2);
+    }
+    if (g_beautyUs) {
+        usleep(g_beautyUs);
+    }
+    leave();
+    return TS_OK;
+}
+
+void ts_makeup_finish()
+{
+}
+
+static void setup(QCameraStream &stream, int w, int h, int stride, int scanline)
+{
+    cam_frame_len_offset_t &off = stream.offset;
+
+    memset(&off, 0, sizeof(off));
+    stream.dim.width = w;
+    stream.dim.height = h;
+    off.num_planes = 2;
+    off.mp[0].width = w;
+    off.mp[0].height = h;
+    off.mp[0].stride = stride;
+    off.mp[0].scanline = scanline;
+    off.mp[0].len = (uint32_t)(stride * scanline);
+    off.mp[1].width = w;
+    off.mp[1].height = h / 2;
+    off.mp[1].stride = stride;
+    off.mp[1].scanline = scanline / 2;
+    off.mp[1].len = (uint32_t)(stride * scanline / 2);
+    off.frame_len = off.mp[0].len + off.mp[1].len;
+}
+
+static void fill(const QCameraStream &stream, uint8_t *buf, uint8_t y)
+{
+    memset(buf, y, stream.offset.mp[0].len);
+    memset(buf + stream.offset.mp[0].len, TEST_UV, stream.offset.mp[1].len);
+}
+
+/* beautified inside the picture, padding left alone */
+static int verify(const QCameraStream &stream, const uint8_t *buf)
+{
+    const cam_frame_len_offset_t &off = stream.offset;
+    const uint8_t *uv = buf + off.mp[0].len;
+
+    for (int y = 0; y < stream.dim.height; y++) {
+        for (int x = 0; x < off.mp[0].stride; x++) {
+            uint8_t want = (x < stream.dim.width) ? TEST_Y + 1 : TEST_Y;
+            if (buf[y * off.mp[0].stride + x] != want) {
+                ERROR("luma %d,%d is %u, want %u", x, y,
+                        buf[y * off.mp[0].stride + x], want);
+                return -1;
+            }
+        }
+    }
+    for (int y = 0; y < stream.dim.height / 2; y++) {
+        for (int x = 0; x < off.mp[1].stride; x++) {
+            uint8_t want = (x < stream.dim.width) ? TEST_UV + 2 : TEST_UV;
+            if (uv[y * off.mp[1].stride + x] != want) {
+                ERROR("chroma %d,%d is %u, want %u", x, y,
+                        uv[y * off.mp[1].stride + x], want);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int test_preview(QCameraMakeup &makeup)
+{
+    QCameraStream stream;
+    QCameraMemory mem;
+    mm_camera_buf_def_t frame;
+    cam_rect_t face = { 10, 10, 20, 20 };
+    cam_dimension_t dim = { 64, 48 };
+    int rc = 0;
+
+    for (int padded = 0; (padded < 2) && (rc == 0); padded++) {
+        setup(stream, 64, 48, padded ? 96 : 64, padded ? 64 : 48);
+        uint8_t *buf = (uint8_t *)malloc(stream.offset.frame_len);
+        memset(&frame, 0, sizeof(frame));
+        frame.buffer = buf;
+        frame.mem_info = &mem;
+        fill(stream, buf, TEST_Y);
+
+        makeup.setParams(NULL, 0, 0);
+        makeup.clearFaceTrack();
+        if (makeup.processPreview(&frame, &stream)) {
+            ERROR("beautified while off");
+            rc = -1;
+        }
+        makeup.setParams("On", 150, -3);
+        if ((rc == 0) && makeup.processPreview(&frame, &stream)) {
+            ERROR("beautified without a face");
+            rc = -1;
+        }
+        makeup.setFaceTrack(face, dim);
+        if ((rc == 0) && (!makeup.processPreview(&frame, &stream) ||
+                verify(stream, buf) || (g_lastRect.left != 10) ||
+                (g_lastRect.right != 30))) {
+            ERROR("%s frame not beautified", padded ? "padded" : "packed");
+            rc = -1;
+        }
+        free(buf);
+    }
+    if ((rc == 0) && (mem.cleaned != 2)) {
+        ERROR("cache cleaned %d times, want 2", mem.cleaned);
+        rc = -1;
+    }
+    return rc;
+}
+
+static int test_snapshot(QCameraMakeup &makeup)
+{
+    QCameraStream stream;
+    QCameraMemory mem;
+    mm_camera_buf_def_t frame;
+    cam_rect_t face = { 10, 10, 20, 20 };
+    cam_dimension_t dim = { 64, 48 };
+    int rc = -1;
+
+    setup(stream, 128, 96, 128, 96);
+    uint8_t *buf = (uint8_t *)malloc(stream.offset.frame_len);
+    memset(&frame, 0, sizeof(frame));
+    frame.buffer = buf;
+    frame.mem_info = &mem;
+
+    // 4:3 like the preview track: seeded and scaled, no detection
+    makeup.setParams("On", 50, 50);
+    makeup.setFaceTrack(face, dim);
+    fill(stream, buf, TEST_Y);
+    if (!makeup.processSnapshot(&frame, &stream) || (g_detect != 0) ||
+            (g_lastRect.left != 20) || (g_lastRect.bottom != 60) ||
+            verify(stream, buf)) {
+        ERROR("seeded snapshot failed, detect %d", g_detect);
+        goto end;
+    }
+
+    // 16:9: detector, its context is created once and kept
+    setup(stream, 128, 72, 128, 72);
+    for (int i = 0; i < 2; i++) {
+        fill(stream, buf, TEST_Y);
+        if (!makeup.processSnapshot(&frame, &stream) || verify(stream, buf)) {
+            ERROR("detected snapshot %d failed", i);
+            goto end;
+        }
+    }
+    fill(stream, buf, TEST_NO_FACE);
+    if (makeup.processSnapshot(&frame, &stream) || (g_detect != 3) ||
+            (g_create != 1)) {
+        ERROR("detect %d create %d", g_detect, g_create);
+        goto end;
+    }
+    rc = 0;
+
+end:
+    makeup.releaseSnapshot();
+    free(buf);
+    return rc;
+}
+
+/* preview pipeline, as preview_stream_cb_routine runs it */
+typedef struct {
+    QCameraMakeup *makeup;
+    QCameraStream stream;
+    QCameraMemory mem;
+    mm_camera_buf_def_t bufs[TEST_NUM_BUFS];
+    uint8_t *mem_bufs[TEST_NUM_BUFS];
+    int displayed;
+    int inline_frames;
+    useconds_t display_us;
+    useconds_t frame_us;
+    int frames;
+    volatile int delivered;
+} test_pipeline_t;
+
+static void display(mm_camera_super_buf_t *super_frame, test_pipeline_t *p)
+{
+    enter();
+    __sync_fetch_and_add(&p->displayed, 1);
+    if (p->display_us) {
+        usleep(p->display_us);
+    }
+    leave();
+    free(super_frame);
+}
+
+static void worker_frame(mm_camera_super_buf_t *super_frame,
+        QCameraStream *stream, void *user_data)
+{
+    test_pipeline_t *p = (test_pipeline_t *)user_data;
+
+    p->makeup->processPreview(super_frame->bufs[0], stream);
+    display(super_frame, p);
+}
+
+static void *stream_thread(void *data)
+{
+    test_pipeline_t *p = (test_pipeline_t *)data;
+
+    for (int i = 0; i < p->frames; i++) {
+        mm_camera_super_buf_t *super_frame =
+                (mm_camera_super_buf_t *)calloc(1, sizeof(*super_frame));
+        super_frame->num_bufs = 1;
+        super_frame->bufs[0] = &p->bufs[i % TEST_NUM_BUFS];
+        if (!p->makeup->queuePreview(super_frame, &p->stream)) {
+            p->inline_frames++;
+            worker_frame(super_frame, &p->stream, p);
+        }
+        __sync_fetch_and_add(&p->delivered, 1);
+        if (p->frame_us) {
+            usleep(p->frame_us);
+        }
+    }
+    return NULL;
+}
+
+static void pipeline_init(test_pipeline_t *p, QCameraMakeup &makeup)
+{
+    cam_rect_t face = { 10, 10, 20, 20 };
+    cam_dimension_t dim = { 64, 48 };
+
+    p->makeup = &makeup;
+    memset(p->bufs, 0, sizeof(p->bufs));
+    p->displayed = 0;
+    p->inline_frames = 0;
+    p->display_us = 0;
+    p->frame_us = 0;
+    p->frames = 0;
+    p->delivered = 0;
+    // padded, so every frame goes through the preview work buffers
+    setup(p->stream, 64, 48, 96, 64);
+    for (int i = 0; i < TEST_NUM_BUFS; i++) {
+        p->mem_bufs[i] = (uint8_t *)malloc(p->stream.offset.frame_len);
+        fill(p->stream, p->mem_bufs[i], TEST_Y);
+        p->bufs[i].buf_idx = (uint32_t)i;
+        p->bufs[i].buffer = p->mem_bufs[i];
+        p->bufs[i].mem_info = &p->mem;
+    }
+    makeup.setParams("On", 50, 50);
+    makeup.setFaceTrack(face, dim);
+}
+
+static void pipeline_deinit(test_pipeline_t *p)
+{
+    for (int i = 0; i < TEST_NUM_BUFS; i++) {
+        free(p->mem_bufs[i]);
+    }
+}
+
+/* every frame displayed or returned to the stream, never both */
+static int pipeline_check(test_pipeline_t *p, const char *name)
+{
+    if (p->displayed + p->stream.done != p->frames) {
+        ERROR("%s: displayed %d + returned %d != %d frames", name,
+                p->displayed, p->stream.done, p->frames);
+        return -1;
+    }
+    return 0;
+}
+
+static int test_worker(QCameraMakeup &makeup)
+{
+    test_pipeline_t p;
+    qcamera_makeup_stats_t stats;
+    pthread_t tid;
+    int rc = -1;
+
+    makeup.resetStats();
+    pipeline_init(&p, makeup);
+    p.frames = 20;
+    p.frame_us = 2000;
+    g_beautyUs = 10000;
+    if (makeup.startWorker(worker_frame, &p) != NO_ERROR) {
+        ERROR("startWorker failed");
+        goto end;
+    }
+    pthread_create(&tid, NULL, stream_thread, &p);
+    pthread_join(tid, NULL);
+    makeup.stopWorker();
+
+    makeup.getStats(stats);
+    printf("worker: queued %u dropped %u displayed %d returned %d\n",
+            stats.queued, stats.dropped, p.displayed, p.stream.done);
+    if (pipeline_check(&p, "worker") || (stats.queued != 20) ||
+            (stats.dropped == 0) || (p.inline_frames != 0)) {
+        ERROR("queued %u dropped %u inline %d", stats.queued, stats.dropped,
+                p.inline_frames);
+        goto end;
+    }
+    rc = 0;
+
+end:
+    g_beautyUs = 0;
+    pipeline_deinit(&p);
+    return rc;
+}
+
+static int test_stop_during_load(QCameraMakeup &makeup)
+{
+    int inline_frames = 0;
+    int rc = 0;
+
+    g_beautyUs = 500;
+    for (int cycle = 0; (cycle < LOAD_CYCLES) && (rc == 0); cycle++) {
+        test_pipeline_t p;
+        qcamera_makeup_stats_t stats;
+        pthread_t tid;
+
+        makeup.resetStats();
+        pipeline_init(&p, makeup);
+        p.frames = LOAD_FRAMES;
+        p.frame_us = 200;
+        p.display_us = 300;
+        g_overlaps = 0;
+        if (makeup.startWorker(worker_frame, &p) != NO_ERROR) {
+            ERROR("startWorker failed");
+            rc = -1;
+            break;
+        }
+        pthread_create(&tid, NULL, stream_thread, &p);
+        // stop part way while frames keep coming, as stopPreview does
+        while (__sync_fetch_and_add(&p.delivered, 0) < LOAD_FRAMES / 3) {
+            usleep(1000);
+        }
+        makeup.stopWorker();
+        pthread_join(tid, NULL);
+
+        inline_frames += p.inline_frames;
+        makeup.getStats(stats);
+        if (stats.queued == 0) {
+            // a restarted worker has to take frames again
+            ERROR("cycle %d: nothing queued to the worker", cycle);
+            rc = -1;
+        } else if (g_overlaps != 0) {
+            ERROR("cycle %d: worker and inline path overlapped %d times",
+                    cycle, g_overlaps);
+            rc = -1;
+        } else if (pipeline_check(&p, "stop during load")) {
+            rc = -1;
+        } else if (p.inline_frames == 0) {
+            ERROR("cycle %d: nothing ran inline after stop", cycle);
+            rc = -1;
+        }
+        pipeline_deinit(&p);
+    }
+    g_beautyUs = 0;
+    if (rc == 0) {
+        printf("stop during load: %d cycles, %d frames inline after stop\n",
+                LOAD_CYCLES, inline_frames);
+    }
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    QCameraMakeup makeup;
+    qcamera_makeup_stats_t stats;
+    int rc = 0;
+
+    rc |= test_preview(makeup);
+    rc |= test_snapshot(makeup);
+    makeup.getStats(stats);
+    printf("preview %u skipped %u, snapshot %u failed %u, seeded %u "
+            "detected %u\n", stats.preview_frames, stats.preview_skipped,
+            stats.snapshot_frames, stats.snapshot_failed, stats.seeded,
+            stats.detected);
+    if ((stats.preview_frames != 2) || (stats.seeded != 1) ||
+            (stats.detected != 2) || (stats.snapshot_failed != 1)) {
+        ERROR("unexpected stats");
+        rc = 1;
+    }
+    rc |= test_worker(makeup);
+    rc |= test_stop_during_load(makeup);
+
+    makeup.releasePreview();
+    makeup.release();
+    makeup.getStats(stats);
+    if ((stats.buffer_bytes != 0) || (g_destroy != 1)) {
+        ERROR("buffer bytes %zu destroyed %d", (size_t)stats.buffer_bytes,
+                g_destroy);
+        rc = 1;
+    }
+
+    printf("%s\n", rc ? "FAIL" : "PASS");
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,537 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Measures the latency of the read only camera APIs (preview_enabled,
+ * msg_type_enabled, recording_enabled and get_parameters) of the camera.synth
+ * HAL while the pipeline is busy: with preview streaming, while recording,
+ * and while a second thread keeps taking pictures. The preview window is a
+ * stub that displays instantly.
+ *
+ *   qcamera_api_bench [iterations per case] [WxH preview]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <cutils/ashmem.h>
+#include <hardware/hardware.h>
+#include <hardware/camera.h>
+#include <camera/CameraParameters.h>
+#include <gralloc_priv.h>
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define WINDOW_MAX_BUFS     16
+#define WINDOW_MIN_UNDEQ    2
+#define WINDOW_META_SIZE    4096
+#define PICTURE_TIMEOUT_S   10
+
+using namespace android;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ns(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Preview window stub. Buffers are ashmem backed gralloc handles; an
+ * enqueued buffer is "displayed" immediately and becomes dequeueable again.
+ */
+typedef struct {
+    preview_stream_ops_t ops;           /* must stay first */
+    pthread_mutex_t lock;
+    int width;
+    int height;
+    int format;
+    int count;
+    private_handle_t *handles[WINDOW_MAX_BUFS];
+    buffer_handle_t bufs[WINDOW_MAX_BUFS];
+    bool queued[WINDOW_MAX_BUFS];       /* owned by the window */
+} test_window_t;
+
+static test_window_t *to_window(preview_stream_ops_t *w)
+{
+    return (test_window_t *)w;
+}
+
+static void window_free_bufs(test_window_t *win)
+{
+    for (int i = 0; i < WINDOW_MAX_BUFS; i++) {
+        if (win->handles[i] != NULL) {
+            close(win->handles[i]->fd);
+            close(win->handles[i]->fd_metadata);
+            delete win->handles[i];
+            win->handles[i] = NULL;
+            win->bufs[i] = NULL;
+        }
+    }
+}
+
+static int window_alloc_bufs(test_window_t *win)
+{
+    /* worst case of the formats the HAL asks for, NV21 padded to 32 */
+    int stride = (win->width + 31) & ~31;
+    int scanline = (win->height + 31) & ~31;
+    int size = (stride * scanline * 3 / 2 + 4095) & ~4095;
+
+    window_free_bufs(win);
+    for (int i = 0; i < win->count; i++) {
+        int fd = ashmem_create_region("api_bench_preview", (size_t)size);
+        int meta_fd = ashmem_create_region("api_bench_meta", WINDOW_META_SIZE);
+        if (fd < 0 || meta_fd < 0) {
+            ERROR("ashmem allocation failed");
+            if (fd >= 0) {
+                close(fd);
+            }
+            if (meta_fd >= 0) {
+                close(meta_fd);
+            }
+            return -1;
+        }
+        win->handles[i] = new private_handle_t(fd, size, 0, 0, win->format,
+                stride, scanline, meta_fd, 0, 0);
+        win->bufs[i] = win->handles[i];
+        win->queued[i] = true;
+    }
+    return 0;
+}
+
+static int window_dequeue(preview_stream_ops_t *w, buffer_handle_t **buffer,
+        int *stride)
+{
+    test_window_t *win = to_window(w);
+    int rc = -1;
+
+    pthread_mutex_lock(&win->lock);
+    if (win->handles[0] == NULL && window_alloc_bufs(win) != 0) {
+        pthread_mutex_unlock(&win->lock);
+        return -1;
+    }
+    for (int i = 0; i < win->count; i++) {
+        if (win->queued[i]) {
+            win->queued[i] = false;
+            *buffer = &win->bufs[i];
+            *stride = (win->width + 31) & ~31;
+            rc = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&win->lock);
+    return rc;
+}
+
+static int window_return(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    test_window_t *win = to_window(w);
+    int rc = -1;
+
+    pthread_mutex_lock(&win->lock);
+    for (int i = 0; i < win->count; i++) {
+        if (buffer == &win->bufs[i]) {
+            win->queued[i] = true;
+            rc = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&win->lock);
+    return rc;
+}
+
+static int window_set_buffer_count(preview_stream_ops_t *w, int count)
+{
+    test_window_t *win = to_window(w);
+
+    if (count <= 0 || count > WINDOW_MAX_BUFS) {
+        return -1;
+    }
+    pthread_mutex_lock(&win->lock);
+    window_free_bufs(win);
+    win->count = count;
+    pthread_mutex_unlock(&win->lock);
+    return 0;
+}
+
+static int window_set_geometry(preview_stream_ops_t *w, int width, int height,
+        int format)
+{
+    test_window_t *win = to_window(w);
+
+    pthread_mutex_lock(&win->lock);
+    window_free_bufs(win);
+    win->width = width;
+    win->height = height;
+    win->format = format;
+    pthread_mutex_unlock(&win->lock);
+    return 0;
+}
+
+static int window_set_crop(preview_stream_ops_t *w, int left, int top,
+        int right, int bottom)
+{
+    return 0;
+}
+
+static int window_set_int(preview_stream_ops_t *w, int value)
+{
+    return 0;
+}
+
+static int window_get_min_undequeued(preview_stream_ops_t *w, int *count)
+{
+    *count = WINDOW_MIN_UNDEQ;
+    return 0;
+}
+
+static int window_lock_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    return 0;
+}
+
+static int window_set_timestamp(preview_stream_ops_t *w, int64_t timestamp)
+{
+    return 0;
+}
+
+static void window_init(test_window_t *win)
+{
+    memset(win, 0, sizeof(*win));
+    pthread_mutex_init(&win->lock, NULL);
+    win->ops.dequeue_buffer = window_dequeue;
+    win->ops.enqueue_buffer = window_return;
+    win->ops.cancel_buffer = window_return;
+    win->ops.set_buffer_count = window_set_buffer_count;
+    win->ops.set_buffers_geometry = window_set_geometry;
+    win->ops.set_crop = window_set_crop;
+    win->ops.set_usage = window_set_int;
+    win->ops.set_swap_interval = window_set_int;
+    win->ops.get_min_undequeued_buffer_count = window_get_min_undequeued;
+    win->ops.lock_buffer = window_lock_buffer;
+    win->ops.set_timestamp = window_set_timestamp;
+}
+
+/* camera_request_memory: mmap the fd the HAL hands over, or heap memory */
+typedef struct {
+    camera_memory_t mem;
+    bool mapped;
+} test_memory_t;
+
+static void memory_release(camera_memory_t *mem)
+{
+    test_memory_t *m = (test_memory_t *)mem->handle;
+
+    if (m->mapped) {
+        munmap(mem->data, mem->size);
+    } else {
+        free(mem->data);
+    }
+    delete m;
+}
+
+static camera_memory_t *request_memory(int fd, size_t buf_size,
+        unsigned int num_bufs, void *user)
+{
+    test_memory_t *m = new test_memory_t;
+    size_t size = buf_size * num_bufs;
+
+    m->mapped = (fd >= 0);
+    if (m->mapped) {
+        m->mem.data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m->mem.data == MAP_FAILED) {
+            ERROR("mmap of fd %d failed", fd);
+            delete m;
+            return NULL;
+        }
+    } else {
+        m->mem.data = calloc(1, size);
+    }
+    m->mem.size = size;
+    m->mem.handle = m;
+    m->mem.release = memory_release;
+    return &m->mem;
+}
+
+typedef struct {
+    camera_device_t *dev;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool picture_done;
+    bool stop;                          /* ends the capture thread */
+    uint32_t pictures;
+} test_ctx_t;
+
+static void notify_cb(int32_t msg_type, int32_t ext1, int32_t ext2, void *user)
+{
+    if (msg_type == CAMERA_MSG_ERROR) {
+        ERROR("camera error %d", ext1);
+    }
+}
+
+static void data_cb(int32_t msg_type, const camera_memory_t *data,
+        unsigned int index, camera_frame_metadata_t *metadata, void *user)
+{
+    test_ctx_t *ctx = (test_ctx_t *)user;
+
+    if (msg_type == CAMERA_MSG_COMPRESSED_IMAGE) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->picture_done = true;
+        ctx->pictures++;
+        pthread_cond_broadcast(&ctx->cond);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+static void data_cb_timestamp(nsecs_t timestamp, int32_t msg_type,
+        const camera_memory_t *data, unsigned index, void *user)
+{
+    test_ctx_t *ctx = (test_ctx_t *)user;
+
+    if (msg_type == CAMERA_MSG_VIDEO_FRAME && data != NULL) {
+        ctx->dev->ops->release_recording_frame(ctx->dev, data->data);
+    }
+}
+
+/* take pictures back to back until stopped, restarting preview if needed */
+static void *capture_thread(void *data)
+{
+    test_ctx_t *ctx = (test_ctx_t *)data;
+    camera_device_t *dev = ctx->dev;
+    bool stop = false;
+
+    while (!stop) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->picture_done = false;
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (dev->ops->take_picture(dev) != 0) {
+            ERROR("take_picture failed");
+            break;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += PICTURE_TIMEOUT_S;
+        pthread_mutex_lock(&ctx->lock);
+        while (!ctx->picture_done && !ctx->stop) {
+            if (pthread_cond_timedwait(&ctx->cond, &ctx->lock, &deadline) != 0) {
+                break;
+            }
+        }
+        bool done = ctx->picture_done;
+        stop = ctx->stop;
+        pthread_mutex_unlock(&ctx->lock);
+        if (!done) {
+            if (!stop) {
+                ERROR("no picture after %d s", PICTURE_TIMEOUT_S);
+            }
+            break;
+        }
+
+        /* non ZSL capture leaves preview stopped */
+        if (!dev->ops->preview_enabled(dev) && dev->ops->start_preview(dev) != 0) {
+            ERROR("start_preview failed");
+            break;
+        }
+    }
+    return NULL;
+}
+
+typedef enum {
+    API_PREVIEW_ENABLED,
+    API_MSG_TYPE_ENABLED,
+    API_RECORDING_ENABLED,
+    API_GET_PARAMETERS,
+    API_MAX
+} api_case_t;
+
+static const char *api_names[API_MAX] = {
+    "preview_enabled",
+    "msg_type_enabled",
+    "recording_enabled",
+    "get_parameters",
+};
+
+/* time one read only API and print mean, median, p95 and max */
+static void run_case(camera_device_t *dev, const char *phase, api_case_t api,
+        int iterations)
+{
+    int64_t *lat = new int64_t[iterations];
+    int64_t sum = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        int64_t start = now_ns();
+        switch (api) {
+        case API_PREVIEW_ENABLED:
+            dev->ops->preview_enabled(dev);
+            break;
+        case API_MSG_TYPE_ENABLED:
+            dev->ops->msg_type_enabled(dev, CAMERA_MSG_COMPRESSED_IMAGE);
+            break;
+        case API_RECORDING_ENABLED:
+            dev->ops->recording_enabled(dev);
+            break;
+        default:
+            {
+                char *str = dev->ops->get_parameters(dev);
+                if (str != NULL) {
+                    dev->ops->put_parameters(dev, str);
+                }
+            }
+            break;
+        }
+        lat[i] = now_ns() - start;
+        sum += lat[i];
+    }
+    qsort(lat, (size_t)iterations, sizeof(lat[0]), cmp_ns);
+    printf("%-9s %-18s mean %7.1f us  p50 %7.1f us  p95 %7.1f us  max %7.1f us\n",
+            phase, api_names[api], (double)sum / iterations / 1e3,
+            (double)lat[iterations / 2] / 1e3,
+            (double)lat[iterations * 95 / 100] / 1e3,
+            (double)lat[iterations - 1] / 1e3);
+    delete [] lat;
+}
+
+static void run_phase(camera_device_t *dev, const char *phase, int iterations)
+{
+    for (int api = 0; api < API_MAX; api++) {
+        run_case(dev, phase, (api_case_t)api, iterations);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+    const char *preview = (argc > 2) ? argv[2] : "1280x720";
+    const hw_module_t *hw_module = NULL;
+    hw_device_t *hw_dev = NULL;
+    test_window_t window;
+    test_ctx_t ctx;
+    pthread_t capture_tid;
+    int w, h;
+    int rc;
+
+    if (iterations < 2) {
+        iterations = 2000;
+    }
+
+    rc = hw_get_module_by_class(CAMERA_HARDWARE_MODULE_ID, "synth", &hw_module);
+    if (rc != 0 || hw_module == NULL) {
+        ERROR("camera.synth HAL not found: %d", rc);
+        return 1;
+    }
+    rc = hw_module->methods->open(hw_module, "0", &hw_dev);
+    if (rc != 0 || hw_dev == NULL) {
+        ERROR("open failed: %d", rc);
+        return 1;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.dev = (camera_device_t *)hw_dev;
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.cond, NULL);
+    window_init(&window);
+
+    camera_device_t *dev = ctx.dev;
+    dev->ops->set_callbacks(dev, notify_cb, data_cb, data_cb_timestamp,
+            request_memory, &ctx);
+    dev->ops->enable_msg_type(dev, CAMERA_MSG_ERROR |
+            CAMERA_MSG_COMPRESSED_IMAGE | CAMERA_MSG_VIDEO_FRAME);
+
+    char *str = dev->ops->get_parameters(dev);
+    if (str == NULL) {
+        ERROR("get_parameters failed");
+        dev->common.close(hw_dev);
+        return 1;
+    }
+    CameraParameters params;
+    params.unflatten(String8(str));
+    dev->ops->put_parameters(dev, str);
+    if (sscanf(preview, "%dx%d", &w, &h) == 2) {
+        params.setPreviewSize(w, h);
+        params.setVideoSize(w, h);
+    }
+    dev->ops->set_parameters(dev, params.flatten().string());
+    dev->ops->set_preview_window(dev, &window.ops);
+
+    printf("%d calls per case, preview %s\n", iterations, preview);
+    run_phase(dev, "stopped", iterations);
+
+    rc = dev->ops->start_preview(dev);
+    if (rc != 0) {
+        ERROR("start_preview failed %d", rc);
+        dev->common.close(hw_dev);
+        return 1;
+    }
+    run_phase(dev, "preview", iterations);
+
+    dev->ops->store_meta_data_in_buffers(dev, 1);
+    if (dev->ops->start_recording(dev) != 0) {
+        ERROR("start_recording failed");
+    } else {
+        run_phase(dev, "recording", iterations);
+        dev->ops->stop_recording(dev);
+    }
+
+    if (pthread_create(&capture_tid, NULL, capture_thread, &ctx) != 0) {
+        ERROR("capture thread not started");
+    } else {
+        run_phase(dev, "capture", iterations);
+        pthread_mutex_lock(&ctx.lock);
+        ctx.stop = true;
+        pthread_cond_broadcast(&ctx.cond);
+        pthread_mutex_unlock(&ctx.lock);
+        pthread_join(capture_tid, NULL);
+        printf("%u pictures taken during the capture phase\n", ctx.pictures);
+    }
+
+    dev->ops->stop_preview(dev);
+    dev->ops->release(dev);
+    dev->common.close(hw_dev);
+
+    pthread_mutex_lock(&window.lock);
+    window_free_bufs(&window);
+    pthread_mutex_unlock(&window.lock);
+    return 0;
+}
@@ -0,0 +1,419 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * Runs QCameraBurstScheduler against a simulated longshot pipeline: frames
+ * arrive a fixed time after they are requested, then go through a serial
+ * reprocess stage and a serial encode stage, each with its own service
+ * time. An app thread asks for shots faster than the pipeline can take
+ * them. Checks that every shot asked for is delivered, that the memory
+ * limit is never exceeded, that the sustained rate reaches the slowest
+ * stage and that the encoder backlog stays bounded. The loss cases drop
+ * frames without a shotDone() or have the backend refuse shots issued
+ * from shotDone(), and check that the timeout retires the dropped shots
+ * and that refused ones are issued again.
+ *
+ *   qcamera_burst_test [shots per case]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "QCameraBurstScheduler.h"
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define SIM_QUEUE_SIZE 256
+#define SIM_SHOT_BYTES (16 * 1024 * 1024)
+#define SIM_SHOT_TIMEOUT_MS 300
+#define SIM_MAX_REFUSED 3
+
+using namespace qcamera;
+
+typedef struct {
+    const char *name;
+    int capture_ms;       // request to frame available
+    int reproc_ms;
+    int encode_ms;
+    uint32_t mem_shots;   // memory limit in shots, 0 for none
+    int drop_every;       // every nth encoded frame is lost, 0 for none
+    int refuse_every;     // every nth request from shotDone() fails, 0 for none
+} sim_case_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int64_t due[SIM_QUEUE_SIZE];  // capture: when each frame is available
+    uint32_t head;
+    uint32_t count;
+} sim_queue_t;
+
+typedef struct {
+    QCameraBurstScheduler *sched;
+    const sim_case_t *tc;
+    sim_queue_t capture;
+    sim_queue_t reproc;
+    sim_queue_t encode;
+    volatile int exit;
+    volatile int stopped;
+    int late_requests;    // callbacks after stop
+    int errors;
+    int encoded;
+    int dropped;
+    int done_requests;    // requests made from shotDone()
+    int refused;
+} sim_ctx_t;
+
+/* set by the encode thread while it is in shotDone() */
+static __thread int in_shot_done;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t t)
+{
+    int64_t d = t - now_ns();
+    if (d > 0) {
+        usleep((useconds_t)(d / 1000));
+    }
+}
+
+static void q_init(sim_queue_t *q)
+{
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    q->head = 0;
+    q->count = 0;
+}
+
+static void q_deinit(sim_queue_t *q)
+{
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+}
+
+static int q_push(sim_queue_t *q, int64_t due)
+{
+    int rc = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->count < SIM_QUEUE_SIZE) {
+        q->due[(q->head + q->count) % SIM_QUEUE_SIZE] = due;
+        q->count++;
+        pthread_cond_signal(&q->cond);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return rc;
+}
+
+/* waits up to 1 ms for an entry, returns 0 and its due time if there is one */
+static int q_pop(sim_queue_t *q, int64_t *due)
+{
+    int rc = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->count == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&q->cond, &q->lock, &ts);
+    }
+    if (q->count > 0) {
+        *due = q->due[q->head];
+        q->head = (q->head + 1) % SIM_QUEUE_SIZE;
+        q->count--;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return rc;
+}
+
+static uint32_t q_size(sim_queue_t *q)
+{
+    pthread_mutex_lock(&q->lock);
+    uint32_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+/* backend: frames become available capture_ms after the request */
+static int32_t sim_request(uint8_t count, void *user_data)
+{
+    sim_ctx_t *ctx = (sim_ctx_t *)user_data;
+    int64_t due = now_ns() + (int64_t)ctx->tc->capture_ms * 1000000;
+
+    if (ctx->stopped) {
+        ctx->late_requests++;
+    }
+    if (in_shot_done && ctx->tc->refuse_every > 0 &&
+            ctx->refused < SIM_MAX_REFUSED &&
+            (++ctx->done_requests % ctx->tc->refuse_every) == 0) {
+        ctx->refused++;
+        return -1;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (q_push(&ctx->capture, due) != 0) {
+            ERROR("capture queue full");
+            ctx->errors++;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void *capture_thread(void *arg)
+{
+    sim_ctx_t *ctx = (sim_ctx_t *)arg;
+    int64_t due;
+
+    while (!ctx->exit) {
+        if (q_pop(&ctx->capture, &due) == 0) {
+            sleep_until(due);
+            ctx->sched->enter(QCAMERA_BURST_STAGE_PP_INPUT);
+            q_push(&ctx->reproc, 0);
+        }
+    }
+    return NULL;
+}
+
+/* like dataProcessRoutine: only start a reprocess when the scheduler agrees */
+static void *reproc_thread(void *arg)
+{
+    sim_ctx_t *ctx = (sim_ctx_t *)arg;
+    int64_t due;
+
+    while (!ctx->exit) {
+        if (q_size(&ctx->reproc) == 0 || !ctx->sched->admitReprocess()) {
+            usleep(200);
+            continue;
+        }
+        if (q_pop(&ctx->reproc, &due) != 0) {
+            continue;
+        }
+        ctx->sched->leave(QCAMERA_BURST_STAGE_PP_INPUT);
+        ctx->sched->enter(QCAMERA_BURST_STAGE_REPROCESS);
+        usleep((useconds_t)ctx->tc->reproc_ms * 1000);
+        ctx->sched->leave(QCAMERA_BURST_STAGE_REPROCESS);
+        ctx->sched->enter(QCAMERA_BURST_STAGE_JPEG_INPUT);
+        q_push(&ctx->encode, 0);
+    }
+    return NULL;
+}
+
+static void *encode_thread(void *arg)
+{
+    sim_ctx_t *ctx = (sim_ctx_t *)arg;
+    int64_t due;
+
+    while (!ctx->exit) {
+        if (q_pop(&ctx->encode, &due) != 0) {
+            continue;
+        }
+        ctx->sched->leave(QCAMERA_BURST_STAGE_JPEG_INPUT);
+        ctx->sched->enter(QCAMERA_BURST_STAGE_ENCODE);
+        usleep((useconds_t)ctx->tc->encode_ms * 1000);
+        ctx->sched->leave(QCAMERA_BURST_STAGE_ENCODE);
+        ctx->encoded++;
+        if (ctx->tc->drop_every > 0 &&
+                (ctx->encoded % ctx->tc->drop_every) == 0) {
+            /* lost on the way, nobody calls shotDone() for it */
+            ctx->dropped++;
+            continue;
+        }
+        in_shot_done = 1;
+        ctx->sched->shotDone(true);
+        in_shot_done = 0;
+    }
+    return NULL;
+}
+
+static int run_case(const sim_case_t *tc, uint32_t shots)
+{
+    QCameraBurstScheduler sched;
+    sim_ctx_t *ctx = (sim_ctx_t *)calloc(1, sizeof(sim_ctx_t));
+    pthread_t cap, rep, enc;
+    qcamera_burst_config_t config;
+    qcamera_burst_stats_t stats;
+    int rc = 0;
+
+    if (NULL == ctx) {
+        ERROR("No memory");
+        return -1;
+    }
+    ctx->sched = &sched;
+    ctx->tc = tc;
+    q_init(&ctx->capture);
+    q_init(&ctx->reproc);
+    q_init(&ctx->encode);
+
+    memset(&config, 0, sizeof(config));
+    config.shot_bytes = SIM_SHOT_BYTES;
+    config.mem_limit = (size_t)tc->mem_shots * SIM_SHOT_BYTES;
+    config.shot_timeout_ns = SIM_SHOT_TIMEOUT_MS * 1000000LL;
+    sched.start(config, sim_request, ctx);
+
+    pthread_create(&cap, NULL, capture_thread, ctx);
+    pthread_create(&rep, NULL, reproc_thread, ctx);
+    pthread_create(&enc, NULL, encode_thread, ctx);
+
+    /* the app asks again every 2 ms, far faster than any stage */
+    for (uint32_t i = 0; i < shots; i++) {
+        if (sched.requestShot(1) != 0) {
+            ERROR("%s: requestShot failed at %u", tc->name, i);
+            rc = -1;
+            break;
+        }
+        usleep(2000);
+    }
+
+    int64_t slowest = (tc->reproc_ms > tc->encode_ms) ? tc->reproc_ms : tc->encode_ms;
+    int64_t deadline = now_ns() + (int64_t)shots * slowest * 4000000LL + 1000000000LL;
+    if (tc->drop_every > 0) {
+        deadline += (int64_t)(shots / tc->drop_every + 1) *
+                SIM_SHOT_TIMEOUT_MS * 1000000LL;
+    }
+    do {
+        /* stands in for the metadata callback */
+        sched.checkTimeouts();
+        sched.getStats(stats);
+        usleep(1000);
+    } while (stats.completed + stats.failed < shots && now_ns() < deadline);
+
+    sched.stop();
+    ctx->stopped = 1;
+    /* nothing may be requested once stop() returned */
+    sched.requestShot(1);
+    sched.shotDone(true);
+
+    ctx->exit = 1;
+    pthread_join(cap, NULL);
+    pthread_join(rep, NULL);
+    pthread_join(enc, NULL);
+
+    double expect = 1000.0 / slowest;
+    if (tc->mem_shots > 0) {
+        double limited = tc->mem_shots * 1000.0 /
+                (tc->capture_ms + tc->reproc_ms + tc->encode_ms);
+        if (limited < expect) {
+            expect = limited;
+        }
+    }
+
+    printf("%-10s %3u/%u shots  %5.1f/s (expect %5.1f)  shot %5.1f ms (min %5.1f)  "
+            "interval %5.1f ms (max %5.1f)  window %u  peak in flight %u  "
+            "deferred %u  peak jpeg backlog %u  expired %u  refused %d\n",
+            tc->name, stats.completed, shots, stats.shots_per_sec, expect,
+            stats.avg_shot_ns / 1e6, stats.min_shot_ns / 1e6,
+            stats.avg_interval_ns / 1e6, stats.max_interval_ns / 1e6,
+            stats.window, stats.peak_in_flight, stats.deferred,
+            stats.stage[QCAMERA_BURST_STAGE_JPEG_INPUT].peak_depth,
+            stats.expired, ctx->refused);
+
+    if (stats.completed + stats.failed != shots || stats.issued != shots) {
+        ERROR("%s: %u of %u shots completed, %u failed, %u issued", tc->name,
+                stats.completed, shots, stats.failed, stats.issued);
+        rc = -1;
+    }
+    if (stats.expired != (uint32_t)ctx->dropped ||
+            stats.failed != stats.expired) {
+        ERROR("%s: %d shots dropped, %u expired, %u failed", tc->name,
+                ctx->dropped, stats.expired, stats.failed);
+        rc = -1;
+    }
+    if (tc->refuse_every > 0 && ctx->refused == 0) {
+        ERROR("%s: no request from shotDone() was refused", tc->name);
+        rc = -1;
+    }
+    if (tc->mem_shots > 0 && stats.peak_in_flight > tc->mem_shots) {
+        ERROR("%s: %u shots in flight, limit %u", tc->name,
+                stats.peak_in_flight, tc->mem_shots);
+        rc = -1;
+    }
+    /* every dropped shot stalls its slot for the timeout */
+    if (tc->drop_every == 0 && stats.shots_per_sec < expect * 0.8) {
+        ERROR("%s: %.1f shots/s, expected %.1f", tc->name,
+                stats.shots_per_sec, expect);
+        rc = -1;
+    }
+    if (tc->encode_ms > tc->reproc_ms &&
+            stats.stage[QCAMERA_BURST_STAGE_JPEG_INPUT].peak_depth > 2) {
+        ERROR("%s: %u frames waited for the encoder", tc->name,
+                stats.stage[QCAMERA_BURST_STAGE_JPEG_INPUT].peak_depth);
+        rc = -1;
+    }
+    if (ctx->late_requests || ctx->errors) {
+        ERROR("%s: %d requests after stop, %d errors", tc->name,
+                ctx->late_requests, ctx->errors);
+        rc = -1;
+    }
+
+    q_deinit(&ctx->capture);
+    q_deinit(&ctx->reproc);
+    q_deinit(&ctx->encode);
+    free(ctx);
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    static const sim_case_t cases[] = {
+        { "encode",  40, 10, 25, 0, 0, 0 },
+        { "reproc",  40, 25, 10, 0, 0, 0 },
+        { "balanced", 40, 20, 20, 0, 0, 0 },
+        { "memory",  40, 10, 25, 2, 0, 0 },
+        { "dropped", 40, 10, 25, 2, 10, 0 },
+        { "refused", 40, 10, 25, 0, 0, 3 },
+    };
+    uint32_t shots = (argc > 1) ? (uint32_t)atoi(argv[1]) : 60;
+    int rc = 0;
+
+    if (shots < 2) {
+        shots = 60;
+    }
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (run_case(&cases[i], shots) != 0) {
+            rc = 1;
+        }
+    }
+    return rc;
+}
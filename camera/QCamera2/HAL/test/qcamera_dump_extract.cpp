@@ -0,0 +1,214 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * Host tool splitting a frame dump container written by QCameraDumpWriter
+ * (persist.camera.dump.async) back into one file per record, named as the
+ * synchronous dump would have named them.
+ *
+ *   qcamera_dump_extract <container.qcd> [output dir]
+ *   qcamera_dump_extract -l <container.qcd>
+ *
+ * Uses the index at the end of the file when present, otherwise walks the
+ * records from the start, e.g. for a file left behind by a crash.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "QCameraDumpFormat.h"
+
+#define ERROR(format, ...) fprintf(stderr, \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+/* file offsets of the record headers, from the index or by walking */
+static uint64_t *load_offsets(FILE *fp, uint64_t file_size, uint32_t *count)
+{
+    qcamera_dump_trailer_t trailer;
+    uint64_t *offsets = NULL;
+    uint32_t n = 0;
+
+    if (file_size >= sizeof(qcamera_dump_file_hdr_t) + sizeof(trailer) &&
+            fseeko(fp, (off_t)(file_size - sizeof(trailer)), SEEK_SET) == 0 &&
+            fread(&trailer, sizeof(trailer), 1, fp) == 1 &&
+            trailer.magic == QCAMERA_DUMP_INDEX_MAGIC &&
+            trailer.index_offset + (uint64_t)trailer.count *
+            sizeof(qcamera_dump_index_entry_t) + sizeof(trailer) == file_size) {
+        offsets = (uint64_t *)malloc(sizeof(uint64_t) * (trailer.count + 1));
+        if (offsets == NULL ||
+                fseeko(fp, (off_t)trailer.index_offset, SEEK_SET) != 0) {
+            free(offsets);
+            return NULL;
+        }
+        for (n = 0; n < trailer.count; n++) {
+            qcamera_dump_index_entry_t entry;
+            if (fread(&entry, sizeof(entry), 1, fp) != 1) {
+                break;
+            }
+            offsets[n] = entry.offset;
+        }
+        *count = n;
+        return offsets;
+    }
+
+    printf("no index, walking records\n");
+    uint32_t max = 256;
+    uint64_t pos = sizeof(qcamera_dump_file_hdr_t);
+    offsets = (uint64_t *)malloc(sizeof(uint64_t) * max);
+    while (offsets != NULL && pos + sizeof(qcamera_dump_rec_hdr_t) <= file_size) {
+        qcamera_dump_rec_hdr_t hdr;
+        if (fseeko(fp, (off_t)pos, SEEK_SET) != 0 ||
+                fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+                hdr.magic != QCAMERA_DUMP_REC_MAGIC ||
+                pos + sizeof(hdr) + hdr.size > file_size) {
+            break;
+        }
+        if (n == max) {
+            max *= 2;
+            uint64_t *grown = (uint64_t *)realloc(offsets, sizeof(uint64_t) * max);
+            if (grown == NULL) {
+                break;
+            }
+            offsets = grown;
+        }
+        offsets[n++] = pos;
+        pos += sizeof(hdr) + QCAMERA_DUMP_ALIGN_SIZE(hdr.size);
+    }
+    *count = n;
+    return offsets;
+}
+
+static int extract(FILE *fp, const qcamera_dump_rec_hdr_t *hdr,
+        const char *dir, uint8_t *buf, size_t buf_size)
+{
+    char name[QCAMERA_DUMP_NAME_MAX + 1];
+    char path[PATH_MAX];
+
+    memcpy(name, hdr->name, QCAMERA_DUMP_NAME_MAX);
+    name[QCAMERA_DUMP_NAME_MAX] = '\0';
+    if (name[0] == '\0' || strchr(name, '/') != NULL || strcmp(name, "..") == 0) {
+        snprintf(name, sizeof(name), "%u_%u.bin", hdr->seq, hdr->frame_idx);
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        ERROR("cannot create %s: %s", path, strerror(errno));
+        return -1;
+    }
+    uint64_t left = hdr->size;
+    while (left > 0) {
+        size_t len = (left < buf_size) ? (size_t)left : buf_size;
+        if (fread(buf, 1, len, fp) != len || fwrite(buf, 1, len, out) != len) {
+            ERROR("short copy for %s", path);
+            fclose(out);
+            return -1;
+        }
+        left -= len;
+    }
+    fclose(out);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    bool list = (argc > 1 && strcmp(argv[1], "-l") == 0);
+    const char *file = list ? ((argc > 2) ? argv[2] : NULL) : ((argc > 1) ? argv[1] : NULL);
+    const char *dir = (!list && argc > 2) ? argv[2] : ".";
+    qcamera_dump_file_hdr_t file_hdr;
+    struct stat st;
+    uint32_t count = 0;
+    int failed = 0;
+
+    if (file == NULL) {
+        printf("usage: %s <container> [output dir]\n"
+               "       %s -l <container>\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    FILE *fp = fopen(file, "rb");
+    if (fp == NULL || fstat(fileno(fp), &st) != 0) {
+        ERROR("cannot open %s: %s", file, strerror(errno));
+        return 1;
+    }
+    if (fread(&file_hdr, sizeof(file_hdr), 1, fp) != 1 ||
+            file_hdr.magic != QCAMERA_DUMP_FILE_MAGIC ||
+            file_hdr.version != QCAMERA_DUMP_VERSION) {
+        ERROR("%s is not a version %d dump container", file, QCAMERA_DUMP_VERSION);
+        fclose(fp);
+        return 1;
+    }
+    if (!list && mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        ERROR("cannot create %s: %s", dir, strerror(errno));
+        fclose(fp);
+        return 1;
+    }
+
+    uint64_t *offsets = load_offsets(fp, (uint64_t)st.st_size, &count);
+    size_t buf_size = 1 << 20;
+    uint8_t *buf = (uint8_t *)malloc(buf_size);
+    if (offsets == NULL || buf == NULL) {
+        ERROR("out of memory");
+        free(offsets);
+        free(buf);
+        fclose(fp);
+        return 1;
+    }
+
+    printf("camera %u, %u records\n", file_hdr.camera_id, count);
+    for (uint32_t i = 0; i < count; i++) {
+        qcamera_dump_rec_hdr_t hdr;
+        if (fseeko(fp, (off_t)offsets[i], SEEK_SET) != 0 ||
+                fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+                hdr.magic != QCAMERA_DUMP_REC_MAGIC) {
+            ERROR("bad record at offset %llu", (unsigned long long)offsets[i]);
+            failed++;
+            continue;
+        }
+        if (list) {
+            printf("%6u  type 0x%02x  frame %6u  %10llu bytes  %lld.%06lld  %.*s\n",
+                    hdr.seq, hdr.type, hdr.frame_idx, (unsigned long long)hdr.size,
+                    (long long)(hdr.timestamp / 1000000000LL),
+                    (long long)(hdr.timestamp % 1000000000LL / 1000),
+                    QCAMERA_DUMP_NAME_MAX, hdr.name);
+        } else if (extract(fp, &hdr, dir, buf, buf_size) != 0) {
+            failed++;
+        }
+    }
+
+    free(offsets);
+    free(buf);
+    fclose(fp);
+    return failed ? 1 : 0;
+}
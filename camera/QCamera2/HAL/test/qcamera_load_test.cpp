@@ -0,0 +1,257 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Runs QCameraLoadGovernor against a simulated preview thread: each frame
+ * the optional stages ask to be admitted and take a fixed time when they
+ * run, then the thread waits for the next frame at the rate the governor
+ * last asked for. Checks that light load is left alone, that heavy load
+ * is shed in ladder order before the frame rate is touched, that load
+ * nothing can be shed from lowers the rate, that thermal steps always
+ * apply in full, with the ladder shed on top only when asked to, and that
+ * everything comes back once the load goes away.
+ *
+ *   qcamera_load_test [seconds per phase]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "QCameraLoadGovernor.h"
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define SIM_FRAME_NS 33333333LL
+#define SIM_WINDOW_MS 100
+
+using namespace qcamera;
+
+typedef struct {
+    int cost_us[QCAMERA_LOAD_STAGE_MAX];  // per run, 0 when the stage is idle
+    uint32_t thermal;                     // thermal step during the phase
+} sim_phase_t;
+
+typedef struct {
+    const char *name;
+    sim_phase_t load;
+    sim_phase_t after;                    // second phase, load gone
+    uint32_t min_level;                   // at the end of the first phase
+    uint32_t fps_step;                    // at the end of the first phase
+    bool thermal_shed;
+} sim_case_t;
+
+typedef struct {
+    volatile uint32_t step;               // rate step from the callback
+    int calls;
+    int late_calls;                       // callbacks after stop
+    volatile int stopped;
+} sim_ctx_t;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t t)
+{
+    int64_t d = t - now_ns();
+    if (d > 0) {
+        usleep((useconds_t)(d / 1000));
+    }
+}
+
+static void sim_fps(uint32_t step, void *user_data)
+{
+    sim_ctx_t *ctx = (sim_ctx_t *)user_data;
+    if (ctx->stopped) {
+        ctx->late_calls++;
+    }
+    ctx->step = step;
+    ctx->calls++;
+}
+
+/* one phase of preview frames, paced at the rate step in effect */
+static void run_phase(QCameraLoadGovernor &gov, sim_ctx_t *ctx,
+        const sim_phase_t *phase, int seconds)
+{
+    ctx->step = gov.setThermalStep(phase->thermal);
+
+    int64_t end = now_ns() + seconds * 1000000000LL;
+    int64_t next = now_ns();
+    while (now_ns() < end) {
+        for (int i = 0; i < QCAMERA_LOAD_STAGE_MAX; i++) {
+            qcamera_load_stage_t stage = (qcamera_load_stage_t)i;
+            if (phase->cost_us[i] > 0 && gov.admit(stage)) {
+                int64_t start = gov.begin();
+                usleep((useconds_t)phase->cost_us[i]);
+                gov.end(stage, start);
+            }
+        }
+        gov.frameDone();
+        uint32_t step = (ctx->step < QCAMERA_LOAD_MAX_FPS_STEP) ?
+                ctx->step : QCAMERA_LOAD_MAX_FPS_STEP;
+        next += SIM_FRAME_NS << step;
+        sleep_until(next);
+    }
+}
+
+static void print_stats(const char *name, const char *phase,
+        const qcamera_load_stats_t &stats)
+{
+    printf("%-9s %-6s level %u/%u  fps step %u (load %u thermal %u)  "
+            "load %3u%% peak %3u%%  escalations %u relaxations %u\n",
+            name, phase, stats.level, stats.max_level, stats.fps_step,
+            stats.load_step, stats.thermal_step, stats.load_pct,
+            stats.peak_load_pct, stats.escalations, stats.relaxations);
+}
+
+static int run_case(const sim_case_t *tc, int seconds)
+{
+    QCameraLoadGovernor gov;
+    sim_ctx_t ctx;
+    qcamera_load_config_t config;
+    qcamera_load_stats_t stats;
+    int rc = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&config, 0, sizeof(config));
+    config.frame_ns = SIM_FRAME_NS;
+    config.budget_pct = 40;
+    config.window_ms = SIM_WINDOW_MS;
+    config.max_fps_step = QCAMERA_LOAD_MAX_FPS_STEP;
+    config.thermal_shed = tc->thermal_shed;
+    gov.start(config, sim_fps, &ctx);
+
+    run_phase(gov, &ctx, &tc->load, seconds);
+    gov.getStats(stats);
+    print_stats(tc->name, "load", stats);
+
+    if (stats.level < tc->min_level) {
+        ERROR("%s: level %u, expected at least %u", tc->name,
+                stats.level, tc->min_level);
+        rc = -1;
+    }
+    if (stats.fps_step != tc->fps_step || ctx.step != tc->fps_step) {
+        ERROR("%s: fps step %u (applied %u), expected %u", tc->name,
+                stats.fps_step, ctx.step, tc->fps_step);
+        rc = -1;
+    }
+    if (stats.fps_step < tc->load.thermal) {
+        ERROR("%s: fps step %u below thermal step %u", tc->name,
+                stats.fps_step, tc->load.thermal);
+        rc = -1;
+    }
+    if (!tc->thermal_shed && stats.thermal_step > 0 &&
+            stats.level > tc->min_level) {
+        ERROR("%s: level %u, thermal step alone should not shed", tc->name,
+                stats.level);
+        rc = -1;
+    }
+    if (stats.thermal_step == 0 && stats.load_step == 0 &&
+            stats.load_pct > config.budget_pct) {
+        ERROR("%s: load %u%% over budget with nothing left to do",
+                tc->name, stats.load_pct);
+        rc = -1;
+    }
+    /* the ladder drops everything sheddable before the rate moves */
+    if (stats.load_step > 0 && stats.level != stats.max_level) {
+        ERROR("%s: rate lowered at level %u", tc->name, stats.level);
+        rc = -1;
+    }
+    if (tc->min_level > 0 &&
+            stats.stage[QCAMERA_LOAD_STAGE_REPROCESS].shed != 0) {
+        ERROR("%s: reprocess was shed", tc->name);
+        rc = -1;
+    }
+
+    /* long enough for the estimates of shed stages to fade */
+    run_phase(gov, &ctx, &tc->after, seconds * 2);
+    gov.getStats(stats);
+    print_stats(tc->name, "after", stats);
+    if (stats.level != 0 || stats.fps_step != 0 || ctx.step != 0) {
+        ERROR("%s: level %u fps step %u after the load went away",
+                tc->name, stats.level, stats.fps_step);
+        rc = -1;
+    }
+
+    gov.stop();
+    ctx.stopped = 1;
+    /* nothing may be shed or requested once stop() returned */
+    for (int i = 0; i < 64; i++) {
+        if (!gov.admit(QCAMERA_LOAD_STAGE_MAKEUP)) {
+            ERROR("%s: stage shed after stop", tc->name);
+            rc = -1;
+            break;
+        }
+        gov.frameDone();
+    }
+    if (ctx.late_calls) {
+        ERROR("%s: %d rate requests after stop", tc->name, ctx.late_calls);
+        rc = -1;
+    }
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    // costs in us: dump, fd cb, preview cb, makeup, reprocess
+    static const sim_case_t cases[] = {
+        { "light",    { { 0, 500, 1000, 1000, 0 }, 0 },
+                      { { 0, 500, 1000, 1000, 0 }, 0 }, 0, 0, false },
+        { "makeup",   { { 2000, 1000, 3000, 12000, 0 }, 0 },
+                      { { 2000, 1000, 3000, 1000, 0 }, 0 }, 4, 0, false },
+        { "reproc",   { { 0, 1000, 2000, 0, 20000 }, 0 },
+                      { { 0, 1000, 2000, 0, 0 }, 0 }, 5, 1, false },
+        { "thermal",  { { 0, 500, 1000, 5000, 0 }, 1 },
+                      { { 0, 500, 1000, 5000, 0 }, 0 }, 0, 1, false },
+        { "hot",      { { 0, 500, 1000, 5000, 0 }, 2 },
+                      { { 0, 500, 1000, 5000, 0 }, 0 }, 0, 2, false },
+        { "shed",     { { 0, 500, 1000, 5000, 0 }, 1 },
+                      { { 0, 500, 1000, 5000, 0 }, 0 }, 5, 1, true },
+    };
+    int seconds = (argc > 1) ? atoi(argv[1]) : 3;
+    int rc = 0;
+
+    if (seconds < 1) {
+        seconds = 3;
+    }
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (run_case(&cases[i], seconds) != 0) {
+            rc = 1;
+        }
+    }
+    return rc;
+}
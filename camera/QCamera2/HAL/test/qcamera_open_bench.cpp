@@ -0,0 +1,318 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Measures camera launch latency of the camera.synth HAL: module load and
+ * open, then start of a no-display preview until the first preview frame
+ * reaches the app. Every launch runs in a fresh child process, as after a
+ * media server restart, so the capabilities are never in memory yet and
+ * come from the on disk cache or from query_capability. The first launch
+ * with the cache enabled fills it in when it is missing or stale.
+ *
+ *   qcamera_open_bench [launches] [cache 0|1] [WxH preview]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <cutils/properties.h>
+#include <hardware/hardware.h>
+#include <hardware/camera.h>
+#include <camera/CameraParameters.h>
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define FIRST_FRAME_TIMEOUT_S   5
+
+using namespace android;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ns(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* timings of one launch, passed from the child to the parent */
+typedef struct {
+    int64_t open_ns;            /* module load and open */
+    int64_t first_frame_ns;     /* open until the first preview frame */
+    int rc;
+} launch_result_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int64_t first_frame;
+} test_ctx_t;
+
+/* camera_request_memory: mmap the fd the HAL hands over, or heap memory */
+typedef struct {
+    camera_memory_t mem;
+    bool mapped;
+} test_memory_t;
+
+static void memory_release(camera_memory_t *mem)
+{
+    test_memory_t *m = (test_memory_t *)mem->handle;
+
+    if (m->mapped) {
+        munmap(mem->data, mem->size);
+    } else {
+        free(mem->data);
+    }
+    delete m;
+}
+
+static camera_memory_t *request_memory(int fd, size_t buf_size,
+        unsigned int num_bufs, void *user)
+{
+    test_memory_t *m = new test_memory_t;
+    size_t size = buf_size * num_bufs;
+
+    m->mapped = (fd >= 0);
+    if (m->mapped) {
+        m->mem.data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m->mem.data == MAP_FAILED) {
+            ERROR("mmap of fd %d failed", fd);
+            delete m;
+            return NULL;
+        }
+    } else {
+        m->mem.data = calloc(1, size);
+    }
+    m->mem.size = size;
+    m->mem.handle = m;
+    m->mem.release = memory_release;
+    return &m->mem;
+}
+
+static void notify_cb(int32_t msg_type, int32_t ext1, int32_t ext2, void *user)
+{
+    if (msg_type == CAMERA_MSG_ERROR) {
+        ERROR("camera error %d", ext1);
+    }
+}
+
+static void data_cb(int32_t msg_type, const camera_memory_t *data,
+        unsigned int index, camera_frame_metadata_t *metadata, void *user)
+{
+    test_ctx_t *ctx = (test_ctx_t *)user;
+
+    if (msg_type == CAMERA_MSG_PREVIEW_FRAME) {
+        pthread_mutex_lock(&ctx->lock);
+        if (ctx->first_frame == 0) {
+            ctx->first_frame = now_ns();
+            pthread_cond_broadcast(&ctx->cond);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+static void data_cb_timestamp(nsecs_t timestamp, int32_t msg_type,
+        const camera_memory_t *data, unsigned index, void *user)
+{
+}
+
+static void launch(const char *preview, launch_result_t *res)
+{
+    const hw_module_t *hw_module = NULL;
+    hw_device_t *hw_dev = NULL;
+    test_ctx_t ctx;
+    int w, h;
+
+    memset(res, 0, sizeof(*res));
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.cond, NULL);
+
+    int64_t start = now_ns();
+    res->rc = hw_get_module_by_class(CAMERA_HARDWARE_MODULE_ID, "synth",
+            &hw_module);
+    if (res->rc != 0 || hw_module == NULL) {
+        ERROR("camera.synth HAL not found: %d", res->rc);
+        res->rc = -1;
+        return;
+    }
+    res->rc = hw_module->methods->open(hw_module, "0", &hw_dev);
+    if (res->rc != 0 || hw_dev == NULL) {
+        ERROR("open failed: %d", res->rc);
+        res->rc = -1;
+        return;
+    }
+    int64_t opened = now_ns();
+    res->open_ns = opened - start;
+
+    camera_device_t *dev = (camera_device_t *)hw_dev;
+    dev->ops->set_callbacks(dev, notify_cb, data_cb, data_cb_timestamp,
+            request_memory, &ctx);
+    dev->ops->enable_msg_type(dev, CAMERA_MSG_ERROR | CAMERA_MSG_PREVIEW_FRAME);
+
+    char *str = dev->ops->get_parameters(dev);
+    if (str == NULL) {
+        ERROR("get_parameters failed");
+        res->rc = -1;
+    } else {
+        CameraParameters params;
+        params.unflatten(String8(str));
+        dev->ops->put_parameters(dev, str);
+        if (sscanf(preview, "%dx%d", &w, &h) == 2) {
+            params.setPreviewSize(w, h);
+        }
+        /* preview without a window, frames only go to the data callback */
+        params.set("no-display-mode", 1);
+        res->rc = dev->ops->set_parameters(dev, params.flatten().string());
+        if (res->rc == 0) {
+            res->rc = dev->ops->start_preview(dev);
+        }
+    }
+
+    if (res->rc == 0) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += FIRST_FRAME_TIMEOUT_S;
+        pthread_mutex_lock(&ctx.lock);
+        while (ctx.first_frame == 0) {
+            if (pthread_cond_timedwait(&ctx.cond, &ctx.lock, &deadline) != 0) {
+                break;
+            }
+        }
+        if (ctx.first_frame != 0) {
+            res->first_frame_ns = ctx.first_frame - opened;
+        } else {
+            ERROR("no preview frame after %d s", FIRST_FRAME_TIMEOUT_S);
+            res->rc = -1;
+        }
+        pthread_mutex_unlock(&ctx.lock);
+        dev->ops->stop_preview(dev);
+    }
+
+    dev->ops->release(dev);
+    dev->common.close(hw_dev);
+}
+
+static void print_stats(const char *name, int64_t *v, int n)
+{
+    int64_t sum = 0;
+
+    for (int i = 0; i < n; i++) {
+        sum += v[i];
+    }
+    qsort(v, (size_t)n, sizeof(v[0]), cmp_ns);
+    printf("%-12s mean %7.2f ms  p50 %7.2f ms  max %7.2f ms\n", name,
+            (double)sum / n / 1e6, (double)v[n / 2] / 1e6,
+            (double)v[n - 1] / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    int launches = (argc > 1) ? atoi(argv[1]) : 10;
+    bool cache = (argc > 2) ? (atoi(argv[2]) != 0) : true;
+    const char *preview = (argc > 3) ? argv[3] : "1280x720";
+    int rc = 0;
+    int n = 0;
+
+    if (launches < 2) {
+        launches = 10;
+    }
+    if (property_set("persist.camera.cap.cache", cache ? "1" : "0") != 0) {
+        ERROR("cannot set persist.camera.cap.cache, run as root");
+        return 1;
+    }
+
+    int64_t *open_ns = new int64_t[launches];
+    int64_t *frame_ns = new int64_t[launches];
+    printf("%d launches, capability cache %s, preview %s\n", launches,
+            cache ? "on" : "off", preview);
+
+    for (int i = 0; i < launches; i++) {
+        launch_result_t res;
+        int fds[2];
+
+        if (pipe(fds) != 0) {
+            ERROR("pipe failed");
+            rc = -1;
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            launch(preview, &res);
+            if (write(fds[1], &res, sizeof(res)) != (ssize_t)sizeof(res)) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        close(fds[1]);
+        if (pid < 0 || read(fds[0], &res, sizeof(res)) != (ssize_t)sizeof(res)) {
+            ERROR("launch %d did not report", i);
+            res.rc = -1;
+        }
+        close(fds[0]);
+        if (pid > 0) {
+            waitpid(pid, NULL, 0);
+        }
+        if (res.rc != 0) {
+            rc = -1;
+            break;
+        }
+
+        if (i == 0) {
+            printf("first launch open %.2f ms  first frame %.2f ms\n",
+                    (double)res.open_ns / 1e6, (double)res.first_frame_ns / 1e6);
+            continue;
+        }
+        open_ns[n] = res.open_ns;
+        frame_ns[n] = res.first_frame_ns;
+        n++;
+    }
+
+    if (n > 0) {
+        print_stats("open", open_ns, n);
+        print_stats("first frame", frame_ns, n);
+    }
+    delete [] open_ns;
+    delete [] frame_ns;
+    return (rc == 0) ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "QCameraPlaneOps.h"
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define CHECK_ROUNDS     200
+#define CHECK_MAX_DIM    160
+#define BENCH_BYTES      (256 * 1024 * 1024)
+
+using namespace qcamera;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void fill_random(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)rand();
+    }
+}
+
+/*
+ * Correctness: every kernel against an obvious per byte reference, on
+ * random sizes, strides and misaligned base pointers. Bytes outside the
+ * written rectangle must stay untouched.
+ */
+typedef struct {
+    int32_t w;          // pairs or pixels, per kernel
+    int32_t h;
+    int32_t srcStride;
+    int32_t dstStride;
+    int32_t misalign;
+} check_geom_t;
+
+static check_geom_t random_geom(int32_t bytesPerUnit)
+{
+    check_geom_t g;
+
+    g.w = 1 + rand() % CHECK_MAX_DIM;
+    g.h = 1 + rand() % 9;
+    g.srcStride = g.w * bytesPerUnit + rand() % 40;
+    g.dstStride = g.w * bytesPerUnit + ((rand() & 1) ? 0 : rand() % 40);
+    g.misalign = rand() % 16;
+    return g;
+}
+
+static int check_copy(const check_geom_t &g)
+{
+    size_t sLen = (size_t)g.srcStride * g.h + 32;
+    size_t dLen = (size_t)g.dstStride * g.h + 32;
+    uint8_t *src = (uint8_t *)malloc(sLen);
+    uint8_t *dst = (uint8_t *)malloc(dLen);
+    uint8_t *ref = (uint8_t *)malloc(dLen);
+    int rc = 0;
+
+    fill_random(src, sLen);
+    fill_random(dst, dLen);
+    memcpy(ref, dst, dLen);
+    for (int32_t j = 0; j < g.h; j++) {
+        for (int32_t i = 0; i < g.w; i++) {
+            ref[g.misalign + j * g.dstStride + i] = src[g.misalign + j * g.srcStride + i];
+        }
+    }
+    QCameraPlaneOps::copyPlane(dst + g.misalign, g.dstStride,
+            src + g.misalign, g.srcStride, g.w, g.h);
+    if (memcmp(dst, ref, dLen)) {
+        ERROR("copyPlane w %d h %d", g.w, g.h);
+        rc = -1;
+    }
+    free(src);
+    free(dst);
+    free(ref);
+    return rc;
+}
+
+static int check_swap(const check_geom_t &g, bool inPlace)
+{
+    int32_t stride = inPlace ? g.srcStride : g.dstStride;
+    size_t sLen = (size_t)g.srcStride * g.h + 32;
+    size_t dLen = (size_t)stride * g.h + 32;
+    uint8_t *src = (uint8_t *)malloc(sLen);
+    uint8_t *dst = inPlace ? src : (uint8_t *)malloc(dLen);
+    uint8_t *ref = (uint8_t *)malloc(dLen);
+    int rc = 0;
+
+    fill_random(src, sLen);
+    if (!inPlace) {
+        fill_random(dst, dLen);
+    }
+    memcpy(ref, dst, dLen);
+    for (int32_t j = 0; j < g.h; j++) {
+        for (int32_t i = 0; i < g.w; i++) {
+            const uint8_t *s = src + g.misalign + j * g.srcStride + 2 * i;
+            uint8_t *r = ref + g.misalign + j * stride + 2 * i;
+            uint8_t c0 = s[0];
+            uint8_t c1 = s[1];
+            r[0] = c1;
+            r[1] = c0;
+        }
+    }
+    QCameraPlaneOps::swapUV(dst + g.misalign, stride,
+            src + g.misalign, g.srcStride, g.w, g.h);
+    if (memcmp(dst, ref, dLen)) {
+        ERROR("swapUV%s pairs %d h %d", inPlace ? " in place" : "", g.w, g.h);
+        rc = -1;
+    }
+    if (!inPlace) {
+        free(dst);
+    }
+    free(src);
+    free(ref);
+    return rc;
+}
+
+static int check_split_merge(const check_geom_t &g)
+{
+    size_t sLen = (size_t)g.srcStride * g.h + 32;
+    size_t pLen = (size_t)g.dstStride * g.h + 32;
+    uint8_t *src = (uint8_t *)malloc(sLen);
+    uint8_t *p0 = (uint8_t *)malloc(pLen);
+    uint8_t *p1 = (uint8_t *)malloc(pLen);
+    uint8_t *back = (uint8_t *)malloc(sLen);
+    int rc = 0;
+
+    fill_random(src, sLen);
+    memset(p0, 0, pLen);
+    memset(p1, 0, pLen);
+    memcpy(back, src, sLen);
+    for (int32_t j = 0; j < g.h; j++) {
+        memset(back + g.misalign + j * g.srcStride, 0, (size_t)g.w * 2);
+    }
+
+    QCameraPlaneOps::splitUV(p0 + g.misalign, g.dstStride, p1 + g.misalign,
+            g.dstStride, src + g.misalign, g.srcStride, g.w, g.h);
+    for (int32_t j = 0; j < g.h && rc == 0; j++) {
+        for (int32_t i = 0; i < g.w; i++) {
+            const uint8_t *s = src + g.misalign + j * g.srcStride + 2 * i;
+            if (p0[g.misalign + j * g.dstStride + i] != s[0] ||
+                    p1[g.misalign + j * g.dstStride + i] != s[1]) {
+                ERROR("splitUV pairs %d h %d at %d,%d", g.w, g.h, i, j);
+                rc = -1;
+                break;
+            }
+        }
+    }
+
+    QCameraPlaneOps::mergeUV(back + g.misalign, g.srcStride, p0 + g.misalign,
+            g.dstStride, p1 + g.misalign, g.dstStride, g.w, g.h);
+    if (rc == 0 && memcmp(back, src, sLen)) {
+        ERROR("mergeUV pairs %d h %d", g.w, g.h);
+        rc = -1;
+    }
+    free(src);
+    free(p0);
+    free(p1);
+    free(back);
+    return rc;
+}
+
+static int check_yuyv(const check_geom_t &g0, bool vuOrder)
+{
+    check_geom_t g = g0;
+    g.w = (g.w + 1) & ~1;
+    g.srcStride = g.w * 2 + (g0.srcStride - g0.w * 2);
+    g.dstStride = g.w + (g0.dstStride - g0.w * 2);
+    if (g.dstStride < g.w) {
+        g.dstStride = g.w;
+    }
+
+    size_t sLen = (size_t)g.srcStride * g.h + 32;
+    size_t yLen = (size_t)g.dstStride * g.h + 32;
+    size_t cLen = (size_t)g.dstStride * ((g.h + 1) / 2) + 32;
+    uint8_t *src = (uint8_t *)malloc(sLen);
+    uint8_t *y = (uint8_t *)calloc(1, yLen);
+    uint8_t *c = (uint8_t *)calloc(1, cLen);
+    uint8_t *yRef = (uint8_t *)calloc(1, yLen);
+    uint8_t *cRef = (uint8_t *)calloc(1, cLen);
+    int rc = 0;
+
+    fill_random(src, sLen);
+    for (int32_t j = 0; j < g.h; j++) {
+        const uint8_t *s = src + g.misalign + j * g.srcStride;
+        for (int32_t i = 0; i < g.w; i += 2) {
+            yRef[g.misalign + j * g.dstStride + i] = s[2 * i];
+            yRef[g.misalign + j * g.dstStride + i + 1] = s[2 * i + 2];
+            if ((j & 1) == 0) {
+                uint8_t *r = cRef + g.misalign + (j / 2) * g.dstStride + i;
+                r[0] = vuOrder ? s[2 * i + 3] : s[2 * i + 1];
+                r[1] = vuOrder ? s[2 * i + 1] : s[2 * i + 3];
+            }
+        }
+    }
+    QCameraPlaneOps::yuyvToSemiPlanar(y + g.misalign, g.dstStride,
+            c + g.misalign, g.dstStride, src + g.misalign, g.srcStride,
+            g.w, g.h, vuOrder);
+    if (memcmp(y, yRef, yLen) || memcmp(c, cRef, cLen)) {
+        ERROR("yuyvToSemiPlanar %s w %d h %d", vuOrder ? "nv21" : "nv12", g.w, g.h);
+        rc = -1;
+    }
+    free(src);
+    free(y);
+    free(c);
+    free(yRef);
+    free(cRef);
+    return rc;
+}
+
+static int run_check()
+{
+    int errors = 0;
+
+    srand(1);
+    for (int r = 0; r < CHECK_ROUNDS; r++) {
+        errors += check_copy(random_geom(1)) ? 1 : 0;
+        errors += check_swap(random_geom(2), false) ? 1 : 0;
+        errors += check_swap(random_geom(2), true) ? 1 : 0;
+        errors += check_split_merge(random_geom(2)) ? 1 : 0;
+        errors += check_yuyv(random_geom(2), false) ? 1 : 0;
+        errors += check_yuyv(random_geom(2), true) ? 1 : 0;
+    }
+    printf("check (%s): %d rounds, %d errors\n",
+            QCameraPlaneOps::impl(), CHECK_ROUNDS, errors);
+    return errors ? -1 : 0;
+}
+
+/*
+ * Throughput per resolution, in megapixels per second. Sources carry the
+ * 32 pixel stride padding of the camera buffers, destinations are packed,
+ * as on the preview callback path.
+ */
+static const struct {
+    const char *name;
+    int32_t w;
+    int32_t h;
+} bench_res[] = {
+    { "VGA",   640,  480 },
+    { "720p",  1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "8MP",   3264, 2448 },
+    { "13MP",  4160, 3120 },
+};
+
+static int bench_iters(int32_t w, int32_t h)
+{
+    int iters = BENCH_BYTES / (w * h * 3 / 2);
+    return iters < 4 ? 4 : iters;
+}
+
+static void run_bench()
+{
+    printf("bench (%s), Mpix/s\n", QCameraPlaneOps::impl());
+    printf("  %-6s %10s %10s %10s %10s %10s\n",
+            "", "compact", "nv21>nv12", "nv21>yv12", "yv12>nv21", "yuyv>nv21");
+
+    for (size_t r = 0; r < sizeof(bench_res) / sizeof(bench_res[0]); r++) {
+        int32_t w = bench_res[r].w;
+        int32_t h = bench_res[r].h;
+        int32_t stride = (w + 31) & ~31;
+        size_t frame = (size_t)stride * h * 2;
+        uint8_t *src = (uint8_t *)malloc(frame);
+        uint8_t *dst = (uint8_t *)malloc(frame);
+        uint8_t *dst2 = (uint8_t *)malloc(frame);
+        uint8_t *srcUV = src + (size_t)stride * h;
+        uint8_t *dstUV = dst + (size_t)w * h;
+        int iters = bench_iters(w, h);
+        double mpix = (double)w * h * iters / 1e6;
+        double res[5];
+        int64_t t;
+
+        fill_random(src, frame);
+
+        t = now_ns();
+        for (int i = 0; i < iters; i++) {
+            QCameraPlaneOps::copyPlane(dst, w, src, stride, w, h);
+            QCameraPlaneOps::copyPlane(dstUV, w, srcUV, stride, w, h / 2);
+        }
+        res[0] = mpix * 1e9 / (double)(now_ns() - t);
+
+        t = now_ns();
+        for (int i = 0; i < iters; i++) {
+            QCameraPlaneOps::copyPlane(dst, w, src, stride, w, h);
+            QCameraPlaneOps::swapUV(dstUV, w, srcUV, stride, w / 2, h / 2);
+        }
+        res[1] = mpix * 1e9 / (double)(now_ns() - t);
+
+        t = now_ns();
+        for (int i = 0; i < iters; i++) {
+            QCameraPlaneOps::copyPlane(dst, w, src, stride, w, h);
+            QCameraPlaneOps::splitUV(dstUV, w / 2, dstUV + (size_t)w * h / 4, w / 2,
+                    srcUV, stride, w / 2, h / 2);
+        }
+        res[2] = mpix * 1e9 / (double)(now_ns() - t);
+
+        t = now_ns();
+        for (int i = 0; i < iters; i++) {
+            QCameraPlaneOps::copyPlane(dst2, w, dst, w, w, h);
+            QCameraPlaneOps::mergeUV(dst2 + (size_t)w * h, w, dstUV, w / 2,
+                    dstUV + (size_t)w * h / 4, w / 2, w / 2, h / 2);
+        }
+        res[3] = mpix * 1e9 / (double)(now_ns() - t);
+
+        t = now_ns();
+        for (int i = 0; i < iters; i++) {
+            QCameraPlaneOps::yuyvToSemiPlanar(dst, w, dstUV, w, src, w * 2,
+                    w, h, true);
+        }
+        res[4] = mpix * 1e9 / (double)(now_ns() - t);
+
+        printf("  %-6s %10.0f %10.0f %10.0f %10.0f %10.0f\n", bench_res[r].name,
+                res[0], res[1], res[2], res[3], res[4]);
+        free(src);
+        free(dst);
+        free(dst2);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && !strcmp(argv[1], "-c")) {
+        return run_check() ? 1 : 0;
+    }
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        run_bench();
+        return 0;
+    }
+
+    if (run_check() != 0) {
+        return 1;
+    }
+    run_bench();
+    return 0;
+}
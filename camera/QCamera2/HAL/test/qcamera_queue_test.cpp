@@ -0,0 +1,353 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "QCameraQueue.h"
+#include "QCameraBoundedQueue.h"
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define BENCH_ITEMS      1000000
+#define STRESS_ITEMS     200000
+#define STRESS_PRIO      20000
+#define STRESS_CAPACITY  64
+
+using namespace qcamera;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t prio;
+} test_item_t;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Microbenchmark: one producer and one consumer thread pass BENCH_ITEMS
+ * pointers through the queue.
+ */
+template <class Q> struct bench_ctx_t {
+    Q *q;
+    test_item_t *items;
+};
+
+template <class Q> static void *bench_producer(void *arg)
+{
+    bench_ctx_t<Q> *ctx = (bench_ctx_t<Q> *)arg;
+
+    for (int i = 0; i < BENCH_ITEMS; i++) {
+        while (!ctx->q->enqueue(&ctx->items[i % 1024])) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+template <class Q> static double bench(Q &q, test_item_t *items)
+{
+    bench_ctx_t<Q> ctx = { &q, items };
+    pthread_t producer;
+    int received = 0;
+    int64_t start = now_ns();
+
+    pthread_create(&producer, NULL, bench_producer<Q>, &ctx);
+    while (received < BENCH_ITEMS) {
+        if (NULL != q.dequeue()) {
+            received++;
+        } else {
+            sched_yield();
+        }
+    }
+    pthread_join(producer, NULL);
+
+    return (double)(now_ns() - start) / BENCH_ITEMS;
+}
+
+template <class Q> static double bench_single(Q &q, test_item_t *items)
+{
+    int64_t start = now_ns();
+
+    for (int i = 0; i < BENCH_ITEMS; i++) {
+        q.enqueue(&items[i % 1024]);
+        q.dequeue();
+    }
+
+    return (double)(now_ns() - start) / BENCH_ITEMS;
+}
+
+static void run_bench()
+{
+    static test_item_t items[1024];
+    QCameraQueue list;
+    QCameraBoundedQueue locked(256, false);
+    QCameraBoundedQueue spsc(256, true);
+
+    printf("enqueue + dequeue, one thread (ns/item)\n");
+    printf("  QCameraQueue              : %.1f\n", bench_single(list, items));
+    printf("  QCameraBoundedQueue       : %.1f\n", bench_single(locked, items));
+    printf("  QCameraBoundedQueue spsc  : %.1f\n", bench_single(spsc, items));
+    printf("producer -> consumer threads (ns/item)\n");
+    printf("  QCameraQueue              : %.1f\n", bench(list, items));
+    printf("  QCameraBoundedQueue       : %.1f\n", bench(locked, items));
+    printf("  QCameraBoundedQueue spsc  : %.1f\n", bench(spsc, items));
+}
+
+/*
+ * Stress test: a producer and a consumer use the lock free path while a
+ * third thread adds priority items, flushes matching or all items and
+ * dequeues from the tail. Every item has to come out exactly once.
+ */
+typedef struct {
+    QCameraBoundedQueue *q;
+    int producer_done;
+    int stop;
+    int seen[STRESS_ITEMS + STRESS_PRIO];
+    int flushed;
+    int tail_taken;
+    int errors;
+} stress_ctx_t;
+
+static void stress_release(void *data, void *user_data)
+{
+    stress_ctx_t *ctx = (stress_ctx_t *)user_data;
+    test_item_t *item = (test_item_t *)data;
+
+    __atomic_add_fetch(&ctx->seen[item->seq], 1, __ATOMIC_RELAXED);
+    ctx->flushed++;
+}
+
+static bool stress_match(void *data, void *, void *match_data)
+{
+    test_item_t *item = (test_item_t *)data;
+
+    return (item->seq % *(uint32_t *)match_data) == 0;
+}
+
+static void *stress_producer(void *arg)
+{
+    stress_ctx_t *ctx = (stress_ctx_t *)arg;
+
+    for (uint32_t i = 0; i < STRESS_ITEMS; i++) {
+        test_item_t *item = (test_item_t *)malloc(sizeof(test_item_t));
+        item->seq = i;
+        item->prio = 0;
+        while (!ctx->q->enqueue(item)) {
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&ctx->producer_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *stress_consumer(void *arg)
+{
+    stress_ctx_t *ctx = (stress_ctx_t *)arg;
+    int64_t last = -1;
+
+    while (!__atomic_load_n(&ctx->stop, __ATOMIC_ACQUIRE)) {
+        test_item_t *item = (test_item_t *)ctx->q->dequeue();
+        if (NULL == item) {
+            sched_yield();
+            continue;
+        }
+        if (!item->prio) {
+            if ((int64_t)item->seq <= last) {
+                ERROR("out of order %u after %lld", item->seq, (long long)last);
+                ctx->errors++;
+            }
+            last = item->seq;
+        }
+        __atomic_add_fetch(&ctx->seen[item->seq], 1, __ATOMIC_RELAXED);
+        free(item);
+    }
+    return NULL;
+}
+
+static void *stress_meddler(void *arg)
+{
+    stress_ctx_t *ctx = (stress_ctx_t *)arg;
+    uint32_t prio = 0;
+    uint32_t round = 0;
+
+    while (!__atomic_load_n(&ctx->producer_done, __ATOMIC_ACQUIRE) ||
+            prio < STRESS_PRIO) {
+        round++;
+        if (prio < STRESS_PRIO) {
+            test_item_t *item = (test_item_t *)malloc(sizeof(test_item_t));
+            item->seq = STRESS_ITEMS + prio;
+            item->prio = 1;
+            if (ctx->q->enqueueWithPriority(item)) {
+                prio++;
+            } else {
+                free(item);
+            }
+        }
+        if ((round % 16) == 0) {
+            uint32_t div = 7 + (round % 5);
+            ctx->q->flushNodes(stress_match, &div);
+        }
+        if ((round % 1024) == 0) {
+            ctx->q->flush();
+        }
+        if ((round % 64) == 0) {
+            test_item_t *item = (test_item_t *)ctx->q->dequeue(false);
+            if (NULL != item) {
+                __atomic_add_fetch(&ctx->seen[item->seq], 1, __ATOMIC_RELAXED);
+                ctx->tail_taken++;
+                free(item);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int run_stress()
+{
+    stress_ctx_t *ctx = (stress_ctx_t *)calloc(1, sizeof(stress_ctx_t));
+    pthread_t producer, consumer, meddler;
+    int missing = 0;
+
+    if (NULL == ctx) {
+        ERROR("No memory");
+        return -1;
+    }
+
+    QCameraBoundedQueue q(STRESS_CAPACITY, true, stress_release, ctx);
+    ctx->q = &q;
+
+    pthread_create(&consumer, NULL, stress_consumer, ctx);
+    pthread_create(&meddler, NULL, stress_meddler, ctx);
+    pthread_create(&producer, NULL, stress_producer, ctx);
+    pthread_join(producer, NULL);
+    pthread_join(meddler, NULL);
+    while (!q.isEmpty()) {
+        sched_yield();
+    }
+    __atomic_store_n(&ctx->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(consumer, NULL);
+    q.flush();
+
+    for (int i = 0; i < STRESS_ITEMS + STRESS_PRIO; i++) {
+        if (ctx->seen[i] != 1) {
+            if (missing++ < 10) {
+                ERROR("item %d seen %d times", i, ctx->seen[i]);
+            }
+        }
+    }
+
+    printf("stress: %d items, %d flushed, %d taken from tail, %d errors\n",
+            STRESS_ITEMS + STRESS_PRIO, ctx->flushed, ctx->tail_taken,
+            missing + ctx->errors);
+    int rc = (missing || ctx->errors) ? -1 : 0;
+    free(ctx);
+    return rc;
+}
+
+/*
+ * Refill test: a flushed queue has to take capacity items again, in both
+ * modes. Flushed slots used to keep counting against the capacity.
+ */
+static void refill_release(void *, void *user_data)
+{
+    (*(int *)user_data)++;
+}
+
+static int run_refill(bool spsc)
+{
+    int flushed = 0;
+    QCameraBoundedQueue q(4, spsc, refill_release, &flushed);
+    int errors = 0;
+
+    for (int round = 0; round < 3; round++) {
+        for (uint32_t i = 0; i < 5; i++) {
+            test_item_t *item = (test_item_t *)malloc(sizeof(test_item_t));
+            item->seq = i;
+            item->prio = 0;
+            if (q.enqueue(item) != (i < 4)) {
+                ERROR("round %d: enqueue %u %s", round, i,
+                        (i < 4) ? "failed" : "past capacity");
+                errors++;
+            }
+            if (i == 4) {
+                free(item);
+            }
+        }
+        if (round == 2) {
+            // the consumer moves the head on as well
+            for (uint32_t i = 0; i < 2; i++) {
+                test_item_t *item = (test_item_t *)q.dequeue();
+                if (NULL == item || item->seq != i) {
+                    ERROR("dequeue %u returned %p", i, item);
+                    errors++;
+                }
+                free(item);
+            }
+        }
+        q.flush();
+        if (!q.isEmpty()) {
+            ERROR("round %d: not empty after flush", round);
+            errors++;
+        }
+    }
+    if (flushed != 10) {
+        ERROR("flushed %d items, expected 10", flushed);
+        errors++;
+    }
+
+    printf("refill%s: %d errors\n", spsc ? " spsc" : "", errors);
+    return errors ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && !strcmp(argv[1], "-s")) {
+        return run_stress() ? 1 : 0;
+    }
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        run_bench();
+        return 0;
+    }
+
+    run_bench();
+    if (run_refill(false) || run_refill(true)) {
+        return 1;
+    }
+    return run_stress() ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Checks the pieces behind recording buffer returns. QCameraBufIndexMap
+ * is run through random adds and removes of page aligned pointers and
+ * compared against a plain array. QCameraRecordingMonitor is run against
+ * a simulated recording: the driver fills a free buffer every frame, the
+ * encoder gives each one back a fixed number of frames later and a
+ * separate thread adds buffers when the monitor asks for them, taking a
+ * few frames to allocate. Checks hold times, that a light encoder never
+ * starves the driver, that a slow one gets just enough extra buffers, that
+ * growth stops at the limit and that stop() waits for a growth in
+ * progress.
+ *
+ *   qcamera_recording_test [frames per case]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "QCameraBufIndexMap.h"
+#include "QCameraRecordingMonitor.h"
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define SIM_FRAME_NS 4000000LL
+#define SIM_ALLOC_US 10000
+#define SIM_MAP_BUFS 48
+
+using namespace qcamera;
+
+typedef struct {
+    const char *name;
+    uint32_t hold_frames;     // encoder keeps each frame this long
+    uint32_t grown;           // buffers the monitor should add
+    bool drops;               // whether the driver runs dry
+} sim_case_t;
+
+typedef struct {
+    QCameraRecordingMonitor *mon;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t active;          // buffers the driver may use
+    uint32_t request;         // growth asked for, 0 for none
+    bool exit;
+} sim_ctx_t;
+
+static const sim_case_t gCases[] = {
+    { "light",   3, 0, false },
+    { "heavy",   8, 2, false },
+    { "capped", 14, 4, true  },
+};
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t t)
+{
+    int64_t d = t - now_ns();
+    if (d > 0) {
+        usleep((useconds_t)(d / 1000));
+    }
+}
+
+/* stands in for the deferred work thread that allocates more buffers */
+static void *grow_routine(void *data)
+{
+    sim_ctx_t *ctx = (sim_ctx_t *)data;
+
+    pthread_mutex_lock(&ctx->lock);
+    while (!ctx->exit) {
+        if (ctx->request == 0) {
+            pthread_cond_wait(&ctx->cond, &ctx->lock);
+            continue;
+        }
+        uint32_t count = ctx->request;
+        ctx->request = 0;
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (ctx->mon->beginGrow()) {
+            usleep(SIM_ALLOC_US);
+            pthread_mutex_lock(&ctx->lock);
+            ctx->active += count;
+            pthread_mutex_unlock(&ctx->lock);
+            ctx->mon->endGrow(count);
+        }
+        pthread_mutex_lock(&ctx->lock);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return NULL;
+}
+
+static int test_map()
+{
+    QCameraBufIndexMap map;
+    const uint8_t *base = (const uint8_t *)0x40000000;
+    int ref[SIM_MAP_BUFS];
+    int rc = 0;
+
+    for (int i = 0; i < SIM_MAP_BUFS; i++) {
+        ref[i] = -1;
+    }
+    srand(1);
+    for (int n = 0; n < 100000 && rc == 0; n++) {
+        int i = rand() % SIM_MAP_BUFS;
+        const void *ptr = base + (size_t)i * 4096 * 300;
+        if (ref[i] < 0) {
+            if (map.add(ptr, i) != 0) {
+                ERROR("add %d failed", i);
+                rc = -1;
+            }
+            ref[i] = i;
+        } else {
+            map.remove(ptr);
+            ref[i] = -1;
+        }
+        int count = 0;
+        for (int j = 0; j < SIM_MAP_BUFS; j++) {
+            int found = map.find(base + (size_t)j * 4096 * 300);
+            if (found != ref[j]) {
+                ERROR("step %d: buffer %d found %d, expected %d",
+                        n, j, found, ref[j]);
+                rc = -1;
+                break;
+            }
+            count += (ref[j] >= 0) ? 1 : 0;
+        }
+        if (rc == 0 && count != map.count()) {
+            ERROR("step %d: %d mapped, expected %d", n, map.count(), count);
+            rc = -1;
+        }
+    }
+
+    map.clear();
+    int added = 0;
+    while (map.add(base + (size_t)added * 64, added) == 0) {
+        added++;
+    }
+    if (added != QCAMERA_BUF_MAP_SIZE - 1 || map.find(base) != 0 ||
+            map.find(NULL) != -1 || map.add(NULL, 0) != -1) {
+        ERROR("full table: %d added", added);
+        rc = -1;
+    }
+    printf("map       ok %s\n", (rc == 0) ? "yes" : "no");
+    return rc;
+}
+
+static void print_stats(const char *name, const qcamera_rec_stats_t &s,
+        uint32_t drops)
+{
+    uint32_t n = (s.returned > 0) ? s.returned : 1;
+    printf("%-9s sent %u returned %u in flight %u peak %u, hold avg %lld "
+            "max %lld us, starvations %u (%u frames), bufs %u/%u grown %u "
+            "requests %u, drops %u\n",
+            name, s.sent, s.returned, s.in_flight, s.peak_in_flight,
+            (long long)(s.hold_total_ns / n / 1000),
+            (long long)(s.hold_max_ns / 1000), s.starvations,
+            s.starved_frames, s.active_bufs, s.max_bufs, s.grown,
+            s.grow_requests, drops);
+}
+
+static int run_case(const sim_case_t *tc, uint32_t frames)
+{
+    QCameraRecordingMonitor mon;
+    qcamera_rec_config_t config;
+    qcamera_rec_stats_t stats;
+    sim_ctx_t ctx;
+    pthread_t grower;
+    uint32_t due[QCAMERA_REC_MAX_BUFS];   // frame each held buffer returns at
+    bool held[QCAMERA_REC_MAX_BUFS];
+    uint32_t drops = 0;
+    int rc = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(held, 0, sizeof(held));
+    memset(due, 0, sizeof(due));
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.cond, NULL);
+    ctx.mon = &mon;
+    ctx.active = 9;
+
+    memset(&config, 0, sizeof(config));
+    config.active_bufs = 9;
+    config.max_bufs = 13;
+    config.low_water = 2;
+    config.starve_frames = 2;
+    config.grow_step = 2;
+    mon.start(config);
+    pthread_create(&grower, NULL, grow_routine, &ctx);
+
+    int64_t next = now_ns();
+    for (uint32_t f = 0; f < frames; f++) {
+        for (uint32_t i = 0; i < QCAMERA_REC_MAX_BUFS; i++) {
+            if (held[i] && due[i] <= f) {
+                mon.returned(i);
+                held[i] = false;
+            }
+        }
+
+        pthread_mutex_lock(&ctx.lock);
+        uint32_t active = ctx.active;
+        pthread_mutex_unlock(&ctx.lock);
+        uint32_t idx = 0;
+        while (idx < active && held[idx]) {
+            idx++;
+        }
+        if (idx == active) {
+            drops++;
+        } else {
+            uint32_t grow = mon.sent(idx);
+            held[idx] = true;
+            due[idx] = f + tc->hold_frames;
+            if (grow > 0) {
+                pthread_mutex_lock(&ctx.lock);
+                ctx.request = grow;
+                pthread_cond_signal(&ctx.cond);
+                pthread_mutex_unlock(&ctx.lock);
+            }
+        }
+        next += SIM_FRAME_NS;
+        sleep_until(next);
+    }
+
+    mon.returned(QCAMERA_REC_MAX_BUFS);
+    mon.getStats(stats);
+    print_stats(tc->name, stats, drops);
+
+    int64_t hold = stats.hold_total_ns / ((stats.returned > 0) ? stats.returned : 1);
+    int64_t expect = (int64_t)tc->hold_frames * SIM_FRAME_NS;
+    if (hold < expect - SIM_FRAME_NS / 2 || hold > expect + 2 * SIM_FRAME_NS) {
+        ERROR("%s: hold %lld us, expected about %lld us", tc->name,
+                (long long)(hold / 1000), (long long)(expect / 1000));
+        rc = -1;
+    }
+    if (stats.grown != tc->grown || stats.active_bufs != 9 + tc->grown ||
+            stats.active_bufs != ctx.active) {
+        ERROR("%s: grown %u to %u bufs (driver %u), expected %u",
+                tc->name, stats.grown, stats.active_bufs, ctx.active,
+                tc->grown);
+        rc = -1;
+    }
+    if ((drops > 0) != tc->drops) {
+        ERROR("%s: %u frames dropped", tc->name, drops);
+        rc = -1;
+    }
+    if ((tc->hold_frames + config.low_water < config.active_bufs) !=
+            (stats.starvations == 0)) {
+        ERROR("%s: %u starvations", tc->name, stats.starvations);
+        rc = -1;
+    }
+    if (stats.unknown != 1 || stats.grow_failures != 0 ||
+            stats.sent != stats.returned + stats.in_flight) {
+        ERROR("%s: sent %u returned %u in flight %u unknown %u",
+                tc->name, stats.sent, stats.returned, stats.in_flight,
+                stats.unknown);
+        rc = -1;
+    }
+
+    mon.stop();
+    pthread_mutex_lock(&ctx.lock);
+    ctx.exit = true;
+    pthread_cond_signal(&ctx.cond);
+    pthread_mutex_unlock(&ctx.lock);
+    pthread_join(grower, NULL);
+    pthread_cond_destroy(&ctx.cond);
+    pthread_mutex_destroy(&ctx.lock);
+    return rc;
+}
+
+static void *slow_grow_routine(void *data)
+{
+    QCameraRecordingMonitor *mon = (QCameraRecordingMonitor *)data;
+
+    if (mon->beginGrow()) {
+        usleep(5 * SIM_ALLOC_US);
+        mon->endGrow(1);
+    }
+    return NULL;
+}
+
+/* stop() has to wait for a growth in progress and refuse new ones */
+static int test_stop()
+{
+    QCameraRecordingMonitor mon;
+    qcamera_rec_config_t config;
+    qcamera_rec_stats_t stats;
+    pthread_t grower;
+    int rc = 0;
+
+    memset(&config, 0, sizeof(config));
+    config.active_bufs = 4;
+    config.max_bufs = 8;
+    mon.start(config);
+    pthread_create(&grower, NULL, slow_grow_routine, &mon);
+    usleep(SIM_ALLOC_US);
+    int64_t start = now_ns();
+    mon.stop();
+    int64_t waited = now_ns() - start;
+    pthread_join(grower, NULL);
+
+    mon.getStats(stats);
+    if (waited < 3 * SIM_ALLOC_US * 1000LL || stats.grown != 1) {
+        ERROR("stop waited %lld us, grown %u", (long long)(waited / 1000),
+                stats.grown);
+        rc = -1;
+    }
+    if (mon.beginGrow() || mon.isActive() || mon.sent(0) != 0) {
+        ERROR("monitor still active after stop");
+        rc = -1;
+    }
+    printf("stop      waited %lld us\n", (long long)(waited / 1000));
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t frames = (argc > 1) ? (uint32_t)atoi(argv[1]) : 250;
+    int rc = 0;
+
+    if (frames < 50) {
+        frames = 250;
+    }
+
+    rc |= test_map();
+    for (size_t i = 0; i < sizeof(gCases) / sizeof(gCases[0]); i++) {
+        rc |= run_case(&gCases[i], frames);
+    }
+    rc |= test_stop();
+
+    printf("%s\n", (rc == 0) ? "PASS" : "FAIL");
+    return (rc == 0) ? 0 : 1;
+}
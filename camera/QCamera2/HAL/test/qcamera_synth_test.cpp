@@ -0,0 +1,586 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Drives the camera.synth HAL (QCamera2 on libmmcamera_interface_synth)
+ * through preview, recording and still capture without a sensor, the
+ * kernel driver or the daemon, and reports frame rate and latency of each
+ * path. The preview window is a stub that displays instantly, so the
+ * numbers cover the HAL and the backend only.
+ *
+ *   qcamera_synth_test [seconds per phase] [WxH preview] [WxH picture]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <cutils/ashmem.h>
+#include <hardware/hardware.h>
+#include <hardware/camera.h>
+#include <camera/CameraParameters.h>
+#include <gralloc_priv.h>
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define WINDOW_MAX_BUFS     16
+#define WINDOW_MIN_UNDEQ    2
+#define WINDOW_META_SIZE    4096
+#define PICTURE_TIMEOUT_S   10
+
+using namespace android;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* frame interval and latency accumulator for one path */
+typedef struct {
+    const char *name;
+    uint32_t frames;
+    int64_t first_ns;
+    int64_t last_ns;
+    int64_t lat_sum_ns;
+    int64_t lat_max_ns;
+} path_stats_t;
+
+static void stats_reset(path_stats_t *s, const char *name)
+{
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+}
+
+static void stats_add(path_stats_t *s, int64_t frame_ts_ns)
+{
+    int64_t now = now_ns();
+    int64_t lat = (frame_ts_ns > 0 && now > frame_ts_ns) ? now - frame_ts_ns : 0;
+
+    if (s->frames == 0) {
+        s->first_ns = now;
+    }
+    s->last_ns = now;
+    s->frames++;
+    s->lat_sum_ns += lat;
+    if (lat > s->lat_max_ns) {
+        s->lat_max_ns = lat;
+    }
+}
+
+static void stats_print(const path_stats_t *s)
+{
+    double fps = 0.0;
+
+    if (s->frames > 1 && s->last_ns > s->first_ns) {
+        fps = (double)(s->frames - 1) * 1e9 / (double)(s->last_ns - s->first_ns);
+    }
+    printf("%-10s %6u frames %7.2f fps  latency avg %6.2f ms max %6.2f ms\n",
+            s->name, s->frames, fps,
+            s->frames ? (double)s->lat_sum_ns / s->frames / 1e6 : 0.0,
+            (double)s->lat_max_ns / 1e6);
+}
+
+/*
+ * Preview window stub. Buffers are ashmem backed gralloc handles; an
+ * enqueued buffer is "displayed" immediately and becomes dequeueable again.
+ */
+typedef struct {
+    preview_stream_ops_t ops;           /* must stay first */
+    pthread_mutex_t lock;
+    int width;
+    int height;
+    int format;
+    int count;
+    private_handle_t *handles[WINDOW_MAX_BUFS];
+    buffer_handle_t bufs[WINDOW_MAX_BUFS];
+    bool queued[WINDOW_MAX_BUFS];       /* owned by the window */
+    int64_t timestamp;
+    path_stats_t stats;
+} test_window_t;
+
+static test_window_t *to_window(preview_stream_ops_t *w)
+{
+    return (test_window_t *)w;
+}
+
+static void window_free_bufs(test_window_t *win)
+{
+    for (int i = 0; i < WINDOW_MAX_BUFS; i++) {
+        if (win->handles[i] != NULL) {
+            close(win->handles[i]->fd);
+            close(win->handles[i]->fd_metadata);
+            delete win->handles[i];
+            win->handles[i] = NULL;
+            win->bufs[i] = NULL;
+        }
+    }
+}
+
+static int window_alloc_bufs(test_window_t *win)
+{
+    /* worst case of the formats the HAL asks for, NV21 padded to 32 */
+    int stride = (win->width + 31) & ~31;
+    int scanline = (win->height + 31) & ~31;
+    int size = (stride * scanline * 3 / 2 + 4095) & ~4095;
+
+    window_free_bufs(win);
+    for (int i = 0; i < win->count; i++) {
+        int fd = ashmem_create_region("synth_preview", (size_t)size);
+        int meta_fd = ashmem_create_region("synth_preview_meta", WINDOW_META_SIZE);
+        if (fd < 0 || meta_fd < 0) {
+            ERROR("ashmem allocation failed");
+            if (fd >= 0) {
+                close(fd);
+            }
+            if (meta_fd >= 0) {
+                close(meta_fd);
+            }
+            return -1;
+        }
+        win->handles[i] = new private_handle_t(fd, size, 0, 0, win->format,
+                stride, scanline, meta_fd, 0, 0);
+        win->bufs[i] = win->handles[i];
+        win->queued[i] = true;
+    }
+    return 0;
+}
+
+static int window_dequeue(preview_stream_ops_t *w, buffer_handle_t **buffer,
+        int *stride)
+{
+    test_window_t *win = to_window(w);
+    int rc = -1;
+
+    pthread_mutex_lock(&win->lock);
+    if (win->handles[0] == NULL && window_alloc_bufs(win) != 0) {
+        pthread_mutex_unlock(&win->lock);
+        return -1;
+    }
+    for (int i = 0; i < win->count; i++) {
+        if (win->queued[i]) {
+            win->queued[i] = false;
+            *buffer = &win->bufs[i];
+            *stride = (win->width + 31) & ~31;
+            rc = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&win->lock);
+    return rc;
+}
+
+static int window_return(test_window_t *win, buffer_handle_t *buffer)
+{
+    for (int i = 0; i < win->count; i++) {
+        if (buffer == &win->bufs[i]) {
+            win->queued[i] = true;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int window_enqueue(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    test_window_t *win = to_window(w);
+    int rc;
+
+    pthread_mutex_lock(&win->lock);
+    rc = window_return(win, buffer);
+    if (rc == 0) {
+        stats_add(&win->stats, win->timestamp);
+    }
+    pthread_mutex_unlock(&win->lock);
+    return rc;
+}
+
+static int window_cancel(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    test_window_t *win = to_window(w);
+    int rc;
+
+    pthread_mutex_lock(&win->lock);
+    rc = window_return(win, buffer);
+    pthread_mutex_unlock(&win->lock);
+    return rc;
+}
+
+static int window_set_buffer_count(preview_stream_ops_t *w, int count)
+{
+    test_window_t *win = to_window(w);
+
+    if (count <= 0 || count > WINDOW_MAX_BUFS) {
+        return -1;
+    }
+    pthread_mutex_lock(&win->lock);
+    window_free_bufs(win);
+    win->count = count;
+    pthread_mutex_unlock(&win->lock);
+    return 0;
+}
+
+static int window_set_geometry(preview_stream_ops_t *w, int width, int height,
+        int format)
+{
+    test_window_t *win = to_window(w);
+
+    pthread_mutex_lock(&win->lock);
+    window_free_bufs(win);
+    win->width = width;
+    win->height = height;
+    win->format = format;
+    pthread_mutex_unlock(&win->lock);
+    return 0;
+}
+
+static int window_set_crop(preview_stream_ops_t *w, int left, int top,
+        int right, int bottom)
+{
+    return 0;
+}
+
+static int window_set_usage(preview_stream_ops_t *w, int usage)
+{
+    return 0;
+}
+
+static int window_set_swap_interval(preview_stream_ops_t *w, int interval)
+{
+    return 0;
+}
+
+static int window_get_min_undequeued(preview_stream_ops_t *w, int *count)
+{
+    *count = WINDOW_MIN_UNDEQ;
+    return 0;
+}
+
+static int window_lock_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    return 0;
+}
+
+static int window_set_timestamp(preview_stream_ops_t *w, int64_t timestamp)
+{
+    test_window_t *win = to_window(w);
+
+    pthread_mutex_lock(&win->lock);
+    win->timestamp = timestamp;
+    pthread_mutex_unlock(&win->lock);
+    return 0;
+}
+
+static void window_init(test_window_t *win)
+{
+    memset(win, 0, sizeof(*win));
+    pthread_mutex_init(&win->lock, NULL);
+    win->ops.dequeue_buffer = window_dequeue;
+    win->ops.enqueue_buffer = window_enqueue;
+    win->ops.cancel_buffer = window_cancel;
+    win->ops.set_buffer_count = window_set_buffer_count;
+    win->ops.set_buffers_geometry = window_set_geometry;
+    win->ops.set_crop = window_set_crop;
+    win->ops.set_usage = window_set_usage;
+    win->ops.set_swap_interval = window_set_swap_interval;
+    win->ops.get_min_undequeued_buffer_count = window_get_min_undequeued;
+    win->ops.lock_buffer = window_lock_buffer;
+    win->ops.set_timestamp = window_set_timestamp;
+    stats_reset(&win->stats, "preview");
+}
+
+/* camera_request_memory: mmap the fd the HAL hands over, or heap memory */
+typedef struct {
+    camera_memory_t mem;
+    bool mapped;
+} test_memory_t;
+
+static void memory_release(camera_memory_t *mem)
+{
+    test_memory_t *m = (test_memory_t *)mem->handle;
+
+    if (m->mapped) {
+        munmap(mem->data, mem->size);
+    } else {
+        free(mem->data);
+    }
+    delete m;
+}
+
+static camera_memory_t *request_memory(int fd, size_t buf_size,
+        unsigned int num_bufs, void *user)
+{
+    test_memory_t *m = new test_memory_t;
+    size_t size = buf_size * num_bufs;
+
+    m->mapped = (fd >= 0);
+    if (m->mapped) {
+        m->mem.data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m->mem.data == MAP_FAILED) {
+            ERROR("mmap of fd %d failed", fd);
+            delete m;
+            return NULL;
+        }
+    } else {
+        m->mem.data = calloc(1, size);
+    }
+    m->mem.size = size;
+    m->mem.handle = m;
+    m->mem.release = memory_release;
+    return &m->mem;
+}
+
+typedef struct {
+    camera_device_t *dev;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    path_stats_t video;
+    int64_t picture_req_ns;
+    int64_t shutter_ns;
+    int64_t picture_ns;
+    size_t picture_size;
+    bool focused;
+} test_ctx_t;
+
+static void notify_cb(int32_t msg_type, int32_t ext1, int32_t ext2, void *user)
+{
+    test_ctx_t *ctx = (test_ctx_t *)user;
+
+    pthread_mutex_lock(&ctx->lock);
+    if (msg_type == CAMERA_MSG_SHUTTER) {
+        ctx->shutter_ns = now_ns();
+    } else if (msg_type == CAMERA_MSG_FOCUS) {
+        ctx->focused = (ext1 != 0);
+        pthread_cond_broadcast(&ctx->cond);
+    } else if (msg_type == CAMERA_MSG_ERROR) {
+        ERROR("camera error %d", ext1);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void data_cb(int32_t msg_type, const camera_memory_t *data,
+        unsigned int index, camera_frame_metadata_t *metadata, void *user)
+{
+    test_ctx_t *ctx = (test_ctx_t *)user;
+
+    if (msg_type == CAMERA_MSG_COMPRESSED_IMAGE) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->picture_ns = now_ns();
+        ctx->picture_size = (data != NULL) ? data->size : 0;
+        pthread_cond_broadcast(&ctx->cond);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+static void data_cb_timestamp(nsecs_t timestamp, int32_t msg_type,
+        const camera_memory_t *data, unsigned index, void *user)
+{
+    test_ctx_t *ctx = (test_ctx_t *)user;
+
+    if (msg_type == CAMERA_MSG_VIDEO_FRAME && data != NULL) {
+        pthread_mutex_lock(&ctx->lock);
+        stats_add(&ctx->video, timestamp);
+        pthread_mutex_unlock(&ctx->lock);
+        /* the HAL hands out one camera_memory_t per video buffer */
+        ctx->dev->ops->release_recording_frame(ctx->dev, data->data);
+    }
+}
+
+static int set_params(camera_device_t *dev, const char *preview,
+        const char *picture)
+{
+    char *str = dev->ops->get_parameters(dev);
+    CameraParameters params;
+    int w, h;
+    int rc;
+
+    if (str == NULL) {
+        ERROR("get_parameters failed");
+        return -1;
+    }
+    params.unflatten(String8(str));
+    dev->ops->put_parameters(dev, str);
+
+    if (sscanf(preview, "%dx%d", &w, &h) == 2) {
+        params.setPreviewSize(w, h);
+        params.setVideoSize(w, h);
+    }
+    if (sscanf(picture, "%dx%d", &w, &h) == 2) {
+        params.setPictureSize(w, h);
+    }
+    params.set(CameraParameters::KEY_FOCUS_MODE,
+            CameraParameters::FOCUS_MODE_AUTO);
+
+    rc = dev->ops->set_parameters(dev, params.flatten().string());
+    if (rc != 0) {
+        ERROR("set_parameters failed %d", rc);
+    }
+    return rc;
+}
+
+static int wait_picture(test_ctx_t *ctx)
+{
+    struct timespec deadline;
+    int rc = 0;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += PICTURE_TIMEOUT_S;
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->picture_ns == 0 && rc == 0) {
+        rc = pthread_cond_timedwait(&ctx->cond, &ctx->lock, &deadline);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return (ctx->picture_ns != 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = (argc > 1) ? atoi(argv[1]) : 5;
+    const char *preview = (argc > 2) ? argv[2] : "1280x720";
+    const char *picture = (argc > 3) ? argv[3] : "";
+    const hw_module_t *hw_module = NULL;
+    camera_module_t *module;
+    hw_device_t *hw_dev = NULL;
+    struct camera_info info;
+    test_window_t window;
+    test_ctx_t ctx;
+    int rc;
+
+    if (seconds <= 0) {
+        seconds = 5;
+    }
+
+    rc = hw_get_module_by_class(CAMERA_HARDWARE_MODULE_ID, "synth", &hw_module);
+    if (rc != 0 || hw_module == NULL) {
+        ERROR("camera.synth HAL not found: %d", rc);
+        return 1;
+    }
+    module = (camera_module_t *)hw_module;
+    printf("%s: %d camera(s)\n", hw_module->name, module->get_number_of_cameras());
+    module->get_camera_info(0, &info);
+    printf("camera 0: facing %d orientation %d\n", info.facing, info.orientation);
+
+    int64_t open_ns = now_ns();
+    rc = hw_module->methods->open(hw_module, "0", &hw_dev);
+    if (rc != 0 || hw_dev == NULL) {
+        ERROR("open failed: %d", rc);
+        return 1;
+    }
+    printf("open       %.2f ms\n", (double)(now_ns() - open_ns) / 1e6);
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.dev = (camera_device_t *)hw_dev;
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.cond, NULL);
+    stats_reset(&ctx.video, "recording");
+    window_init(&window);
+
+    camera_device_t *dev = ctx.dev;
+    dev->ops->set_callbacks(dev, notify_cb, data_cb, data_cb_timestamp,
+            request_memory, &ctx);
+    dev->ops->enable_msg_type(dev, CAMERA_MSG_SHUTTER | CAMERA_MSG_FOCUS |
+            CAMERA_MSG_ERROR | CAMERA_MSG_COMPRESSED_IMAGE |
+            CAMERA_MSG_VIDEO_FRAME);
+    if (set_params(dev, preview, picture) != 0) {
+        dev->common.close(hw_dev);
+        return 1;
+    }
+    dev->ops->set_preview_window(dev, &window.ops);
+
+    /* preview */
+    int64_t start_ns = now_ns();
+    rc = dev->ops->start_preview(dev);
+    if (rc != 0) {
+        ERROR("start_preview failed %d", rc);
+        dev->common.close(hw_dev);
+        return 1;
+    }
+    printf("start      %.2f ms\n", (double)(now_ns() - start_ns) / 1e6);
+    sleep((unsigned int)seconds);
+
+    /* auto focus, completes through metadata */
+    start_ns = now_ns();
+    dev->ops->auto_focus(dev);
+    pthread_mutex_lock(&ctx.lock);
+    while (!ctx.focused && now_ns() - start_ns < 2000000000LL) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&ctx.cond, &ctx.lock, &deadline);
+    }
+    pthread_mutex_unlock(&ctx.lock);
+    printf("focus      %s in %.2f ms\n", ctx.focused ? "done" : "TIMEOUT",
+            (double)(now_ns() - start_ns) / 1e6);
+
+    /* recording */
+    dev->ops->store_meta_data_in_buffers(dev, 1);
+    rc = dev->ops->start_recording(dev);
+    if (rc != 0) {
+        ERROR("start_recording failed %d", rc);
+    } else {
+        sleep((unsigned int)seconds);
+        dev->ops->stop_recording(dev);
+    }
+
+    /* still capture, preview keeps running for ZSL, restarts otherwise */
+    pthread_mutex_lock(&window.lock);
+    stats_print(&window.stats);
+    pthread_mutex_unlock(&window.lock);
+    pthread_mutex_lock(&ctx.lock);
+    stats_print(&ctx.video);
+    ctx.picture_req_ns = now_ns();
+    pthread_mutex_unlock(&ctx.lock);
+    rc = dev->ops->take_picture(dev);
+    if (rc != 0) {
+        ERROR("take_picture failed %d", rc);
+    } else if (wait_picture(&ctx) != 0) {
+        ERROR("no picture after %d s", PICTURE_TIMEOUT_S);
+    } else {
+        printf("picture    %zu bytes  shutter %.2f ms  jpeg %.2f ms\n",
+                ctx.picture_size,
+                ctx.shutter_ns ? (double)(ctx.shutter_ns - ctx.picture_req_ns) / 1e6 : 0.0,
+                (double)(ctx.picture_ns - ctx.picture_req_ns) / 1e6);
+    }
+
+    dev->ops->stop_preview(dev);
+    dev->ops->release(dev);
+    dev->common.close(hw_dev);
+
+    pthread_mutex_lock(&window.lock);
+    window_free_bufs(&window);
+    pthread_mutex_unlock(&window.lock);
+    return (rc == 0) ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __CAM_TRACE_H__
+#define __CAM_TRACE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per frame pipeline tracing.
+ *
+ * Enabled with persist.camera.trace=1, the property is read again on every
+ * camera open and preview start. Each thread records into its own ring so
+ * recording takes no lock. cam_trace_dump() merges the rings, writes them
+ * as Chrome trace JSON (load in chrome://tracing) and prints latency
+ * histograms per stream type.
+ */
+
+typedef enum {
+    CAM_TRACE_RCVD_BUF,     /* mm_stream_handle_rcvd_buf */
+    CAM_TRACE_DATA_NOTIFY,  /* QCameraStream::dataNotifyCB */
+    CAM_TRACE_DATA_PROC,    /* QCameraStream::dataProcRoutine */
+    CAM_TRACE_STREAM_CB,    /* *_stream_cb_routine */
+    CAM_TRACE_DELIVER,      /* enqueue to display or callback to app */
+    CAM_TRACE_BUF_DONE,     /* QCameraStream::bufDone */
+    CAM_TRACE_REPROCESS,    /* frame sent to reprocess */
+    CAM_TRACE_JPEG_START,   /* jpeg job started, id is the job id */
+    CAM_TRACE_JPEG_DONE,    /* jpeg job finished, id is the job id */
+    CAM_TRACE_SAVE,         /* jpeg saved or sent to app, id is the job id */
+    CAM_TRACE_POINT_MAX
+} cam_trace_point_t;
+
+extern volatile int g_cam_trace_enabled;
+
+/* Record a trace point. id is the buffer index for buffer stages */
+#define CAM_TRACE(point, stream_id, stream_type, frame_idx, id) \
+    do { \
+        if (g_cam_trace_enabled) { \
+            cam_trace_record((point), (uint32_t)(stream_id), \
+                    (uint32_t)(stream_type), (uint32_t)(frame_idx), \
+                    (uint32_t)(id)); \
+        } \
+    } while (0)
+
+/* Record a trace point for a mm_camera_buf_def_t */
+#define CAM_TRACE_BUF(point, buf) \
+    CAM_TRACE((point), (buf)->stream_id, (buf)->stream_type, \
+            (buf)->frame_idx, (buf)->buf_idx)
+
+void cam_trace_refresh(void);
+void cam_trace_record(cam_trace_point_t point, uint32_t stream_id,
+        uint32_t stream_type, uint32_t frame_idx, uint32_t id);
+int cam_trace_dump(int fd, const char *json_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CAM_TRACE_H__ */
@@ -728,6 +728,8 @@ uint8_t get_num_of_cameras();
 /* return reference pointer of camera vtbl */
 mm_camera_vtbl_t * camera_open(uint8_t camera_idx);
 struct camera_info *get_cam_info(uint32_t camera_id);
+/* return the name the sensor driver registered, "" if unknown */
+const char *get_cam_sensor_name(uint32_t camera_id);
 
 /* helper functions */
 int32_t mm_stream_calc_offset_preview(cam_stream_info_t *stream_info,
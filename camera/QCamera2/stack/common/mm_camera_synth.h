@@ -0,0 +1,66 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __MM_CAMERA_SYNTH_H__
+#define __MM_CAMERA_SYNTH_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Synthetic camera backend.
+ *
+ * libmmcamera_interface_synth exports the same entry points as
+ * libmmcamera_interface (get_num_of_cameras, get_cam_info,
+ * get_cam_sensor_name, camera_open, check_cam_access) but serves them
+ * without the kernel driver or the daemon: frames and metadata are
+ * generated in process by one thread per camera. Tunables, read at
+ * camera open from the property or, when the property is unset, from
+ * the environment variable in brackets:
+ *
+ *   persist.camera.synth.num      (CAMERA_SYNTH_NUM)       cameras, 1 or 2
+ *   persist.camera.synth.sensor   (CAMERA_SYNTH_SENSOR)    sensor size, WxH
+ *   persist.camera.synth.fps      (CAMERA_SYNTH_FPS)       max frame rate
+ *   persist.camera.synth.fill     (CAMERA_SYNTH_FILL)      0 leaves pixels alone
+ *   persist.camera.synth.features (CAMERA_SYNTH_FEATURES)  qcom feature mask
+ *
+ * The HAL built with QCAMERA_SYNTH_ION routes its /dev/ion traffic through
+ * the calls below, which back every allocation with an ashmem region.
+ */
+
+int mm_camera_synth_ion_open(void);
+int mm_camera_synth_ion_ioctl(int fd, unsigned long req, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MM_CAMERA_SYNTH_H__ */
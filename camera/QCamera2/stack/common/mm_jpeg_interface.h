@@ -182,6 +182,9 @@ typedef struct {
   /* jpeg quality: range 0~100 */
   uint32_t quality;
 
+  /* thumbnail jpeg quality: range 0~100, 0 to use quality */
+  uint32_t thumb_quality;
+
   jpeg_encode_callback_t jpeg_cb;
   void* userdata;
 
@@ -11,6 +11,7 @@ MM_CAM_FILES := \
         src/mm_camera_stream.c \
         src/mm_camera_thread.c \
         src/mm_camera_sock.c \
+        src/mm_camera_trace.c \
         src/cam_intf.c
 
 ifeq ($(strip $(TARGET_USES_ION)),true)
@@ -56,5 +57,41 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
 
+# Same interface backed by generated frames instead of the kernel driver
+# and the daemon, see mm_camera_synth.h. test/Makefile builds it and its
+# check on a Linux host.
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -D_ANDROID_ -DMM_CAMERA_SYNTH
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/inc \
+    $(LOCAL_PATH)/../common
+
+LOCAL_C_INCLUDES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include
+LOCAL_C_INCLUDES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/media
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+LOCAL_C_INCLUDES += $(call project-path-for,qcom-media)/mm-core/inc
+ifeq ($(call is-platform-sdk-version-at-least,20),true)
+LOCAL_C_INCLUDES += system/media/camera/include
+endif
+
+ifneq ($(call is-platform-sdk-version-at-least,17),true)
+  LOCAL_CFLAGS += -include bionic/libc/kernel/common/linux/socket.h
+  LOCAL_CFLAGS += -include bionic/libc/kernel/common/linux/un.h
+endif
+
+LOCAL_CFLAGS += -Wall -Wextra -Werror -Wno-unused-parameter
+
+LOCAL_SRC_FILES := $(MM_CAM_FILES) src/mm_camera_synth.c
+
+LOCAL_MODULE           := libmmcamera_interface_synth
+LOCAL_32_BIT_ONLY := true
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libdl libcutils liblog
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_SHARED_LIBRARY)
+
 LOCAL_PATH := $(OLD_LOCAL_PATH)
 endif
@@ -151,19 +151,35 @@ typedef struct {
     void* user_data;
 } mm_camera_poll_entry_t;
 
+/* default max buffers a data poll thread dequeues per stream and wakeup */
+#define MM_CAMERA_POLL_DRAIN_BUDGET 4
+
+typedef struct {
+    uint32_t wakeups;     /* epoll_wait returns with events */
+    uint32_t cmd_wakeups; /* of which carried a control command */
+    uint32_t frames;      /* buffers dequeued */
+    uint32_t dq_calls;    /* VIDIOC_DQBUF calls, incl. empty ones */
+    uint32_t dq_empty;    /* drain attempts that found the queue empty */
+    uint32_t budget_hits; /* drains stopped by the budget */
+    uint32_t syscalls;    /* epoll, eventfd and DQBUF calls of the thread */
+} mm_camera_poll_stats_t;
+
 typedef struct {
     mm_camera_poll_thread_type_t poll_type;
     /* array to store poll fd and cb info
      * for MM_CAMERA_POLL_TYPE_EVT, only index 0 is valid;
      * for MM_CAMERA_POLL_TYPE_DATA, depends on valid stream fd */
     mm_camera_poll_entry_t poll_entries[MAX_STREAM_NUM_IN_BUNDLE];
-    int32_t pfds[2];
+    int32_t epoll_fd;
+    int32_t evt_fd;       /* eventfd kicking the thread for pending cmds */
+    uint32_t pending_cmds; /* bitmask of mm_camera_pipe_cmd_type_t, mutex */
+    /* fd registered in epoll_fd for each poll entry, -1 if none */
+    int32_t epoll_reg_fds[MAX_STREAM_NUM_IN_BUNDLE];
     pthread_t pid;
     int32_t state;
     int timeoutms;
-    uint32_t cmd;
-    struct pollfd poll_fds[MAX_STREAM_NUM_IN_BUNDLE + 1];
-    uint8_t num_fds;
+    uint32_t drain_budget;
+    mm_camera_poll_stats_t stats; /* only touched by the poll thread */
     pthread_mutex_t mutex;
     pthread_cond_t cond_v;
     int32_t status;
@@ -341,8 +357,21 @@ typedef struct {
     mm_camera_buf_info_t super_buf[MAX_STREAM_NUM_IN_BUNDLE];
     uint8_t matched;
     uint32_t frame_idx;
+    /* queue node holding this superbuf */
+    cam_node_t *node;
+    /* link in the unmatched list of the queue while not matched */
+    struct cam_list unmatched;
 } mm_channel_queue_node_t;
 
+/* frame_idx window of the superbuf matcher, must be a power of 2 */
+#define MM_CHANNEL_MATCH_WINDOW 64
+
+typedef struct {
+    uint32_t matched;    /* superbufs completed */
+    uint32_t dropped;    /* bufs and unmatched superbufs released as too old */
+    uint32_t overflowed; /* unmatched superbufs released to make room */
+} mm_channel_match_stats_t;
+
 typedef struct {
     cam_queue_t que;
     uint8_t num_streams;
@@ -352,6 +381,13 @@ typedef struct {
     uint32_t expected_frame_id;
     uint32_t match_cnt;
     uint32_t expected_frame_id_without_led;
+    /* unmatched superbufs by frame_idx & (MM_CHANNEL_MATCH_WINDOW - 1),
+     * at most one per slot */
+    mm_channel_queue_node_t *match_slots[MM_CHANNEL_MATCH_WINDOW];
+    /* unmatched superbufs in queue order, oldest frame_idx first */
+    struct cam_list unmatched;
+    uint32_t unmatched_cnt;
+    mm_channel_match_stats_t match_stats;
 } mm_channel_queue_t;
 
 typedef struct {
@@ -459,6 +495,7 @@ typedef struct mm_camera_obj {
 typedef struct {
     int8_t num_cam;
     char video_dev_name[MM_CAMERA_MAX_NUM_SENSORS][MM_CAMERA_DEV_NAME_LEN];
+    char sensor_name[MM_CAMERA_MAX_NUM_SENSORS][MM_CAMERA_DEV_NAME_LEN];
     mm_camera_obj_t *cam_obj[MM_CAMERA_MAX_NUM_SENSORS];
     struct camera_info info[MM_CAMERA_MAX_NUM_SENSORS];
     uint8_t is_yuv[MM_CAMERA_MAX_NUM_SENSORS]; // 1=CAM_SENSOR_YUV, 0=CAM_SENSOR_RAW
@@ -616,6 +653,7 @@ extern int32_t mm_stream_fsm_fn(mm_stream_t *my_obj,
  * to be register with dataCB. */
 extern int32_t mm_stream_reg_buf_cb(mm_stream_t *my_obj,
                                     mm_stream_data_cb_t *val);
+extern int32_t mm_stream_calc_offset(mm_stream_t *my_obj);
 extern int32_t mm_stream_map_buf(mm_stream_t *my_obj,
                                  uint8_t buf_type,
                                  uint32_t frame_idx,
@@ -124,6 +124,14 @@ static int32_t mm_channel_proc_general_cmd(mm_channel_t *my_obj,
                                            mm_camera_generic_cmd_t *p_gen_cmd);
 int32_t mm_channel_superbuf_flush_matched(mm_channel_t* my_obj,
                                           mm_channel_queue_t * queue);
+static void mm_channel_superbuf_track(mm_channel_queue_t *queue,
+                                      mm_channel_queue_node_t *super_buf,
+                                      mm_channel_queue_node_t *before);
+static void mm_channel_superbuf_untrack(mm_channel_queue_t *queue,
+                                        mm_channel_queue_node_t *super_buf);
+static void mm_channel_superbuf_release(mm_channel_t *ch_obj,
+                                        mm_channel_queue_t *queue,
+                                        mm_channel_queue_node_t *super_buf);
 /*===========================================================================
  * FUNCTION   : mm_channel_util_get_stream_by_handler
  *
@@ -1874,6 +1882,10 @@ int32_t mm_channel_unmap_stream_buf(mm_channel_t *my_obj,
  *==========================================================================*/
 int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue)
 {
+    memset(queue->match_slots, 0, sizeof(queue->match_slots));
+    cam_list_init(&queue->unmatched);
+    queue->unmatched_cnt = 0;
+    memset(&queue->match_stats, 0, sizeof(queue->match_stats));
     return cam_queue_init(&queue->que);
 }
 
@@ -1891,7 +1903,16 @@ int32_t mm_channel_superbuf_queue_init(mm_channel_queue_t * queue)
  *==========================================================================*/
 int32_t mm_channel_superbuf_queue_deinit(mm_channel_queue_t * queue)
 {
-    return cam_queue_deinit(&queue->que);
+    int32_t rc;
+
+    CDBG_HIGH("%s: superbufs matched %u, dropped %u, overflowed %u", __func__,
+            queue->match_stats.matched, queue->match_stats.dropped,
+            queue->match_stats.overflowed);
+    rc = cam_queue_deinit(&queue->que);
+    memset(queue->match_slots, 0, sizeof(queue->match_slots));
+    cam_list_init(&queue->unmatched);
+    queue->unmatched_cnt = 0;
+    return rc;
 }
 
 /*===========================================================================
@@ -1912,11 +1933,12 @@ int8_t mm_channel_util_seq_comp_w_rollover(uint32_t v1,
                                            uint32_t v2)
 {
     int8_t ret = 0;
+    /* signed distance, so a v1 that rolled over to 0 still compares larger */
+    int32_t diff = (int32_t)(v1 - v2);
 
-    /* TODO: need to handle the case if v2 roll over to 0 */
-    if (v1 > v2) {
+    if (diff > 0) {
         ret = 1;
-    } else if (v1 < v2) {
+    } else if (diff < 0) {
         ret = -1;
     }
 
@@ -2108,12 +2130,11 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                         mm_channel_queue_t *queue,
                         mm_camera_buf_info_t *buf_info)
 {
-    cam_node_t* node = NULL;
-    struct cam_list *head = NULL;
     struct cam_list *pos = NULL;
     mm_channel_queue_node_t* super_buf = NULL;
-    uint8_t buf_s_idx, i, found_super_buf, unmatched_bundles;
-    struct cam_list *last_buf, *insert_before_buf;
+    mm_channel_queue_node_t *last_buf = NULL, *insert_before_buf = NULL;
+    uint8_t buf_s_idx, i;
+    uint32_t unmatched_bundles;
 
     CDBG("%s: E", __func__);
     for (buf_s_idx = 0; buf_s_idx < queue->num_streams; buf_s_idx++) {
@@ -2138,6 +2159,7 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                                             queue->expected_frame_id) < 0) {
         CDBG_HIGH("%s: incoming buf is older than expected buf id, will discard it", __func__);
         mm_channel_qbuf(ch_obj, buf_info->buf);
+        queue->match_stats.dropped++;
         return 0;
     }
 
@@ -2147,47 +2169,29 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
          * if frame not to be queued, we need to qbuf it back */
     }
 
-    /* comp */
+    /* comp: the only unmatched superbuf that can have this frame_idx
+     * sits in its slot of the match window */
     pthread_mutex_lock(&queue->que.lock);
-    head = &queue->que.head.list;
-    /* get the last one in the queue which is possibly having no matching */
-    pos = head->next;
-
-    found_super_buf = 0;
-    unmatched_bundles = 0;
-    last_buf = NULL;
-    insert_before_buf = NULL;
-    while (pos != head) {
-        node = member_of(pos, cam_node_t, list);
-        super_buf = (mm_channel_queue_node_t*)node->data;
-        if (NULL != super_buf) {
-            if (super_buf->matched) {
-                /* find a matched super buf, move to next one */
-                pos = pos->next;
-                continue;
-            } else if ( buf_info->frame_idx == super_buf->frame_idx ) {
-                /* have an unmatched super buf that matches our frame idx,
-                 *  break the loop */
-                found_super_buf = 1;
-                break;
-            } else {
-                unmatched_bundles++;
-                if ( NULL == last_buf ) {
-                    if ( super_buf->frame_idx < buf_info->frame_idx ) {
-                        last_buf = pos;
-                    }
-                }
-                if ( NULL == insert_before_buf ) {
-                    if ( super_buf->frame_idx > buf_info->frame_idx ) {
-                        insert_before_buf = pos;
-                    }
-                }
-                pos = pos->next;
-            }
+    super_buf = queue->match_slots[buf_info->frame_idx & (MM_CHANNEL_MATCH_WINDOW - 1)];
+    if ((NULL != super_buf) && (super_buf->frame_idx != buf_info->frame_idx)) {
+        /* slot still taken by a superbuf a whole window away */
+        if (mm_channel_util_seq_comp_w_rollover(super_buf->frame_idx,
+                                                buf_info->frame_idx) > 0) {
+            CDBG_HIGH("%s: frame_idx %d is a window behind pending %d, discard",
+                    __func__, buf_info->frame_idx, super_buf->frame_idx);
+            mm_channel_qbuf(ch_obj, buf_info->buf);
+            queue->match_stats.dropped++;
+            pthread_mutex_unlock(&queue->que.lock);
+            return 0;
         }
+        CDBG_HIGH("%s: release unmatched frame_idx %d, window full",
+                __func__, super_buf->frame_idx);
+        mm_channel_superbuf_release(ch_obj, queue, super_buf);
+        queue->match_stats.overflowed++;
+        super_buf = NULL;
     }
 
-    if ( found_super_buf ) {
+    if ( NULL != super_buf ) {
             if(super_buf->super_buf[buf_s_idx].frame_idx != 0) {
                CDBG_ERROR(" %s : **** ERROR CASE Same stream is already in queue! **** ", __func__);
             }
@@ -2202,6 +2206,7 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
             }
 
             if (super_buf->matched) {
+                mm_channel_superbuf_untrack(queue, super_buf);
                 if(ch_obj->isFlashBracketingEnabled) {
                     queue->expected_frame_id =
                         queue->expected_frame_id_without_led;
@@ -2211,53 +2216,57 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                                               + queue->attr.post_frame_skip;
                 }
                 queue->match_cnt++;
+                queue->match_stats.matched++;
                 /* Any older unmatched buffer need to be released */
-                if ( last_buf ) {
-                    while ( last_buf != pos ) {
-                        node = member_of(last_buf, cam_node_t, list);
-                        super_buf = (mm_channel_queue_node_t*)node->data;
-                        if (NULL != super_buf) {
-                            for (i=0; i<super_buf->num_of_bufs; i++) {
-                                if (super_buf->super_buf[i].frame_idx != 0) {
-                                        mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
-                                }
-                            }
-                            queue->que.size--;
-                            last_buf = last_buf->next;
-                            cam_list_del_node(&node->list);
-                            free(node);
-                            free(super_buf);
-                        } else {
-                            CDBG_ERROR(" %s : Invalid superbuf in queue!", __func__);
-                            break;
-                        }
+                while (queue->unmatched.next != &queue->unmatched) {
+                    last_buf = member_of(queue->unmatched.next,
+                            mm_channel_queue_node_t, unmatched);
+                    if (mm_channel_util_seq_comp_w_rollover(last_buf->frame_idx,
+                                                            buf_info->frame_idx) >= 0) {
+                        break;
                     }
+                    mm_channel_superbuf_release(ch_obj, queue, last_buf);
+                    queue->match_stats.dropped++;
                 }
             }
     } else {
+        /* the oldest unmatched superbuf, if older than the incoming buf */
+        if (queue->unmatched.next != &queue->unmatched) {
+            last_buf = member_of(queue->unmatched.next,
+                    mm_channel_queue_node_t, unmatched);
+            if (mm_channel_util_seq_comp_w_rollover(last_buf->frame_idx,
+                                                    buf_info->frame_idx) >= 0) {
+                last_buf = NULL;
+            }
+        }
+        unmatched_bundles = queue->unmatched_cnt;
+
         if (  ( queue->attr.max_unmatched_frames < unmatched_bundles ) &&
               ( NULL == last_buf ) ) {
             CDBG("%s, incoming frame is older than the last bundled one", __func__);
             mm_channel_qbuf(ch_obj, buf_info->buf);
+            queue->match_stats.dropped++;
         } else {
             if ( queue->attr.max_unmatched_frames < unmatched_bundles ) {
                 /* release the oldest bundled superbuf */
-                node = member_of(last_buf, cam_node_t, list);
-                super_buf = (mm_channel_queue_node_t*)node->data;
-                for (i=0; i<super_buf->num_of_bufs; i++) {
-                    if (super_buf->super_buf[i].frame_idx != 0) {
-                            mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
-                    }
-                }
-                queue->que.size--;
-                node = member_of(last_buf, cam_node_t, list);
-                cam_list_del_node(&node->list);
-                free(node);
-                free(super_buf);
+                mm_channel_superbuf_release(ch_obj, queue, last_buf);
+                queue->match_stats.overflowed++;
             }
             CDBG("%s, unmatched_bundles=%d insert the new frame at the appropriate position",
                     __func__, unmatched_bundles);
 
+            /* keep unmatched superbufs ordered by frame_idx. New frames are
+             * normally the newest, so walk back from the tail */
+            for (pos = queue->unmatched.prev; pos != &queue->unmatched; pos = pos->prev) {
+                mm_channel_queue_node_t *prev_buf =
+                    member_of(pos, mm_channel_queue_node_t, unmatched);
+                if (mm_channel_util_seq_comp_w_rollover(prev_buf->frame_idx,
+                                                        buf_info->frame_idx) < 0) {
+                    break;
+                }
+                insert_before_buf = prev_buf;
+            }
+
             mm_channel_queue_node_t *new_buf = NULL;
             cam_node_t* new_node = NULL;
 
@@ -2267,13 +2276,16 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
                 memset(new_buf, 0, sizeof(mm_channel_queue_node_t));
                 memset(new_node, 0, sizeof(cam_node_t));
                 new_node->data = (void *)new_buf;
+                new_buf->node = new_node;
+                cam_list_init(&new_buf->unmatched);
                 new_buf->num_of_bufs = queue->num_streams;
                 new_buf->super_buf[buf_s_idx] = *buf_info;
                 new_buf->frame_idx = buf_info->frame_idx;
 
                 /* enqueue */
                 if ( insert_before_buf ) {
-                    cam_list_insert_before_node(&new_node->list, insert_before_buf);
+                    cam_list_insert_before_node(&new_node->list,
+                            &insert_before_buf->node->list);
                 } else {
                     cam_list_add_tail_node(&new_node->list, &queue->que.head.list);
                 }
@@ -2284,6 +2296,9 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
 
                     queue->expected_frame_id = buf_info->frame_idx + queue->attr.post_frame_skip;
                     queue->match_cnt++;
+                    queue->match_stats.matched++;
+                } else {
+                    mm_channel_superbuf_track(queue, new_buf, insert_before_buf);
                 }
             } else {
                 /* No memory */
@@ -2305,6 +2320,88 @@ int32_t mm_channel_superbuf_comp_and_enqueue(
     return 0;
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_track
+ *
+ * DESCRIPTION: add an unmatched superbuf to the matcher. Caller holds the
+ *              queue lock and has made sure its slot is free.
+ *
+ * PARAMETERS :
+ *   @queue     : superbuf queue
+ *   @super_buf : unmatched superbuf already in the queue
+ *   @before    : unmatched superbuf it precedes, NULL if the newest
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_track(mm_channel_queue_t *queue,
+                                      mm_channel_queue_node_t *super_buf,
+                                      mm_channel_queue_node_t *before)
+{
+    queue->match_slots[super_buf->frame_idx & (MM_CHANNEL_MATCH_WINDOW - 1)] = super_buf;
+    if (NULL != before) {
+        cam_list_insert_before_node(&super_buf->unmatched, &before->unmatched);
+    } else {
+        cam_list_add_tail_node(&super_buf->unmatched, &queue->unmatched);
+    }
+    queue->unmatched_cnt++;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_untrack
+ *
+ * DESCRIPTION: remove a superbuf from the matcher once it is matched or
+ *              leaves the queue unmatched. Caller holds the queue lock.
+ *
+ * PARAMETERS :
+ *   @queue     : superbuf queue
+ *   @super_buf : tracked superbuf
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_untrack(mm_channel_queue_t *queue,
+                                        mm_channel_queue_node_t *super_buf)
+{
+    uint32_t slot = super_buf->frame_idx & (MM_CHANNEL_MATCH_WINDOW - 1);
+
+    if (queue->match_slots[slot] == super_buf) {
+        queue->match_slots[slot] = NULL;
+    }
+    cam_list_del_node(&super_buf->unmatched);
+    queue->unmatched_cnt--;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_release
+ *
+ * DESCRIPTION: return the bufs of an unmatched superbuf to their streams
+ *              and remove it from the queue. Caller holds the queue lock.
+ *
+ * PARAMETERS :
+ *   @ch_obj    : channel object
+ *   @queue     : superbuf queue
+ *   @super_buf : unmatched superbuf to release
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_channel_superbuf_release(mm_channel_t *ch_obj,
+                                        mm_channel_queue_t *queue,
+                                        mm_channel_queue_node_t *super_buf)
+{
+    uint8_t i;
+    cam_node_t *node = super_buf->node;
+
+    for (i=0; i<super_buf->num_of_bufs; i++) {
+        if (super_buf->super_buf[i].frame_idx != 0) {
+            mm_channel_qbuf(ch_obj, super_buf->super_buf[i].buf);
+        }
+    }
+    mm_channel_superbuf_untrack(queue, super_buf);
+    cam_list_del_node(&node->list);
+    queue->que.size--;
+    free(node);
+    free(super_buf);
+}
+
 /*===========================================================================
  * FUNCTION   : mm_channel_superbuf_dequeue_internal
  *
@@ -2343,6 +2440,8 @@ mm_channel_queue_node_t* mm_channel_superbuf_dequeue_internal(mm_channel_queue_t
             queue->que.size--;
             if (super_buf->matched == TRUE) {
                 queue->match_cnt--;
+            } else {
+                mm_channel_superbuf_untrack(queue, super_buf);
             }
             free(node);
         }
@@ -27,6 +27,16 @@
  *
  */
 
+#ifdef MM_CAMERA_SYNTH
+/* mm_camera_synth.c owns the public entry points in the synthetic
+ * backend; keep the hardware ones around under other names */
+#define get_num_of_cameras mm_camera_hw_get_num_of_cameras
+#define get_cam_info mm_camera_hw_get_cam_info
+#define get_cam_sensor_name mm_camera_hw_get_cam_sensor_name
+#define check_cam_access mm_camera_hw_check_cam_access
+#define camera_open mm_camera_hw_camera_open
+#endif
+
 #include <pthread.h>
 #include <errno.h>
 #include <sys/ioctl.h>
@@ -46,6 +56,7 @@
 #include "mm_camera_interface.h"
 #include "mm_camera_sock.h"
 #include "mm_camera.h"
+#include "cam_trace.h"
 
 static pthread_mutex_t g_intf_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -1399,6 +1410,8 @@ void get_sensor_info()
                 g_cam_ctrl.info[num_cameras].facing = (int)facing;
                 g_cam_ctrl.info[num_cameras].orientation = (int)mount_angle;
                 g_cam_ctrl.is_yuv[num_cameras] = is_yuv;
+                strncpy(g_cam_ctrl.sensor_name[num_cameras], entity.name,
+                        MM_CAMERA_DEV_NAME_LEN - 1);
                 num_cameras++;
                 continue;
             }
@@ -1431,8 +1444,10 @@ void sort_camera_info(int num_cam)
     struct camera_info temp_info[MM_CAMERA_MAX_NUM_SENSORS];
     uint8_t temp_is_yuv[MM_CAMERA_MAX_NUM_SENSORS];
     char temp_dev_name[MM_CAMERA_MAX_NUM_SENSORS][MM_CAMERA_DEV_NAME_LEN];
+    char temp_sensor_name[MM_CAMERA_MAX_NUM_SENSORS][MM_CAMERA_DEV_NAME_LEN];
     memset(temp_info, 0, sizeof(temp_info));
     memset(temp_dev_name, 0, sizeof(temp_dev_name));
+    memset(temp_sensor_name, 0, sizeof(temp_sensor_name));
     memset(temp_is_yuv, 0, sizeof(temp_is_yuv));
 
     /* firstly save the back cameras info*/
@@ -1441,6 +1456,8 @@ void sort_camera_info(int num_cam)
             temp_info[idx] = g_cam_ctrl.info[i];
             temp_is_yuv[idx] = g_cam_ctrl.is_yuv[i];
             CDBG("%s: Found Back Camera: i: %d idx: %d", __func__, i, idx);
+            memcpy(temp_sensor_name[idx], g_cam_ctrl.sensor_name[i],
+                    MM_CAMERA_DEV_NAME_LEN);
             memcpy(temp_dev_name[idx++],g_cam_ctrl.video_dev_name[i],
                     MM_CAMERA_DEV_NAME_LEN);
         }
@@ -1452,6 +1469,8 @@ void sort_camera_info(int num_cam)
             temp_info[idx] = g_cam_ctrl.info[i];
             temp_is_yuv[idx] = g_cam_ctrl.is_yuv[i];
             CDBG("%s: Found Front Camera: i: %d idx: %d", __func__, i, idx);
+            memcpy(temp_sensor_name[idx], g_cam_ctrl.sensor_name[i],
+                    MM_CAMERA_DEV_NAME_LEN);
             memcpy(temp_dev_name[idx++],g_cam_ctrl.video_dev_name[i],
                 MM_CAMERA_DEV_NAME_LEN);
         }
@@ -1461,6 +1480,7 @@ void sort_camera_info(int num_cam)
         memcpy(g_cam_ctrl.info, temp_info, sizeof(temp_info));
         memcpy(g_cam_ctrl.is_yuv, temp_is_yuv, sizeof(temp_is_yuv));
         memcpy(g_cam_ctrl.video_dev_name, temp_dev_name, sizeof(temp_dev_name));
+        memcpy(g_cam_ctrl.sensor_name, temp_sensor_name, sizeof(temp_sensor_name));
         for (i = 0; i < num_cam; i++) {
             CDBG_HIGH("%s: Camera id: %d facing: %d, is_yuv: %d", __func__,
                 i, g_cam_ctrl.info[i].facing, g_cam_ctrl.is_yuv[i]);
@@ -1652,6 +1672,25 @@ struct camera_info *get_cam_info(uint32_t camera_id)
     return &g_cam_ctrl.info[camera_id];
 }
 
+/*===========================================================================
+ * FUNCTION   : get_cam_sensor_name
+ *
+ * DESCRIPTION: name of the sensor subdev found by get_sensor_info
+ *
+ * PARAMETERS :
+ *   @camera_id : camera Id
+ *
+ * RETURN     : sensor name, "" if the camera id is out of range
+ * NOTE       : caller should not free the char ptr
+ *==========================================================================*/
+const char *get_cam_sensor_name(uint32_t camera_id)
+{
+    if (camera_id >= MM_CAMERA_MAX_NUM_SENSORS) {
+        return "";
+    }
+    return g_cam_ctrl.sensor_name[camera_id];
+}
+
 /*===========================================================================
  * FUNCTION   : mm_camera_intf_process_advanced_capture
  *
@@ -1782,6 +1821,7 @@ mm_camera_vtbl_t * camera_open(uint8_t camera_idx)
     mm_camera_obj_t* cam_obj = NULL;
 
     CDBG("%s: E camera_idx = %d\n", __func__, camera_idx);
+    cam_trace_refresh();
     if (camera_idx >= g_cam_ctrl.num_cam) {
         CDBG_ERROR("%s: Invalid camera_idx (%d)", __func__, camera_idx);
         return NULL;
@@ -43,6 +43,7 @@
 #include "mm_camera_dbg.h"
 #include "mm_camera_interface.h"
 #include "mm_camera.h"
+#include "cam_trace.h"
 
 /* internal function decalre */
 int32_t mm_stream_qbuf(mm_stream_t *my_obj,
@@ -192,6 +193,10 @@ void mm_stream_handle_rcvd_buf(mm_stream_t *my_obj,
     CDBG("%s: E, my_handle = 0x%x, fd = %d, state = %d",
          __func__, my_obj->my_hdl, my_obj->fd, my_obj->state);
 
+    CAM_TRACE(CAM_TRACE_RCVD_BUF, my_obj->my_hdl,
+            my_obj->stream_info->stream_type, buf_info->frame_idx,
+            buf_info->buf->buf_idx);
+
     /* enqueue to super buf thread */
     if (my_obj->is_bundled) {
         rc = mm_stream_notify_channel(my_obj->ch_obj, buf_info);
@@ -245,41 +250,29 @@ void mm_stream_handle_rcvd_buf(mm_stream_t *my_obj,
 }
 
 /*===========================================================================
- * FUNCTION   : mm_stream_data_notify
+ * FUNCTION   : mm_stream_dequeue_buf
  *
- * DESCRIPTION: callback to handle data notify from kernel
+ * DESCRIPTION: dequeue one buffer from kernel and hand it to the stream's
+ *              buffer handling
  *
  * PARAMETERS :
- *   @user_data : user data ptr (stream object)
+ *   @my_obj   : stream object
  *
- * RETURN     : none
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure, nothing dequeued
  *==========================================================================*/
-static void mm_stream_data_notify(void* user_data)
+static int32_t mm_stream_dequeue_buf(mm_stream_t *my_obj)
 {
-    mm_stream_t *my_obj = (mm_stream_t*)user_data;
     int32_t i, rc;
     uint8_t has_cb = 0;
     mm_camera_buf_info_t buf_info;
 
-    if (NULL == my_obj) {
-        return;
-    }
-
-    CDBG("%s: E, my_handle = 0x%x, fd = %d, state = %d",
-         __func__, my_obj->my_hdl, my_obj->fd, my_obj->state);
-    if (MM_STREAM_STATE_ACTIVE != my_obj->state) {
-        /* this Cb will only received in active_stream_on state
-         * if not so, return here */
-        CDBG_ERROR("%s: ERROR!! Wrong state (%d) to receive data notify!",
-                   __func__, my_obj->state);
-        return;
-    }
-
     memset(&buf_info, 0, sizeof(mm_camera_buf_info_t));
     rc = mm_stream_read_msm_frame(my_obj, &buf_info,
         (uint8_t)my_obj->frame_offset.num_planes);
     if (rc != 0) {
-        return;
+        return rc;
     }
     uint32_t idx = buf_info.buf->buf_idx;
 
@@ -307,6 +300,67 @@ static void mm_stream_data_notify(void* user_data)
     pthread_mutex_unlock(&my_obj->buf_lock);
 
     mm_stream_handle_rcvd_buf(my_obj, &buf_info, has_cb);
+    return 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_stream_data_notify
+ *
+ * DESCRIPTION: callback to handle data notify from kernel. Dequeues every
+ *              ready buffer up to the poll thread's drain budget, so a
+ *              burst is handled in one wakeup. The fd is polled level
+ *              triggered, anything left past the budget wakes us again.
+ *
+ * PARAMETERS :
+ *   @user_data : user data ptr (stream object)
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_stream_data_notify(void* user_data)
+{
+    mm_stream_t *my_obj = (mm_stream_t*)user_data;
+    mm_camera_poll_thread_t *poll_cb;
+    uint32_t n, queued;
+
+    if (NULL == my_obj) {
+        return;
+    }
+
+    CDBG("%s: E, my_handle = 0x%x, fd = %d, state = %d",
+         __func__, my_obj->my_hdl, my_obj->fd, my_obj->state);
+    if (MM_STREAM_STATE_ACTIVE != my_obj->state) {
+        /* this Cb will only received in active_stream_on state
+         * if not so, return here */
+        CDBG_ERROR("%s: ERROR!! Wrong state (%d) to receive data notify!",
+                   __func__, my_obj->state);
+        return;
+    }
+
+    /* called on the data poll thread, which owns the stats */
+    poll_cb = &my_obj->ch_obj->poll_thread[0];
+    for (n = 0; n < poll_cb->drain_budget; n++) {
+        if (n > 0) {
+            /* skip the DQBUF when nothing is left in kernel */
+            pthread_mutex_lock(&my_obj->buf_lock);
+            queued = my_obj->queued_buffer_count;
+            pthread_mutex_unlock(&my_obj->buf_lock);
+            if ((0 == queued) || (MM_STREAM_STATE_ACTIVE != my_obj->state)) {
+                break;
+            }
+        }
+        poll_cb->stats.dq_calls++;
+        poll_cb->stats.syscalls++;
+        if (0 != mm_stream_dequeue_buf(my_obj)) {
+            if (n > 0) {
+                poll_cb->stats.dq_empty++;
+            }
+            break;
+        }
+        poll_cb->stats.frames++;
+    }
+    if (n == poll_cb->drain_budget) {
+        poll_cb->stats.budget_hits++;
+    }
 }
 
 /*===========================================================================
@@ -1047,7 +1101,11 @@ int32_t mm_stream_read_msm_frame(mm_stream_t * my_obj,
     vb.length = num_planes;
 
     rc = ioctl(my_obj->fd, VIDIOC_DQBUF, &vb);
-    if (0 > rc) {
+    if ((0 > rc) && (EAGAIN == errno)) {
+        /* expected once a drain has emptied the queue */
+        CDBG("%s: VIDIOC_DQBUF no buffer ready on stream type %d",
+            __func__, my_obj->stream_info->stream_type);
+    } else if (0 > rc) {
         CDBG_ERROR("%s: VIDIOC_DQBUF ioctl call failed on stream type %d (rc=%d): %s",
             __func__, my_obj->stream_info->stream_type, rc, strerror(errno));
     } else {
@@ -0,0 +1,2226 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <cutils/ashmem.h>
+#include <cutils/properties.h>
+
+#include "cam_types.h"
+#include "cam_trace.h"
+#include "mm_camera_dbg.h"
+#include "mm_camera_interface.h"
+#include "mm_camera.h"
+#include "mm_camera_synth.h"
+
+#define MM_SYNTH_MAX_STREAMS    16      /* streams per camera, all channels */
+#define MM_SYNTH_QUEUE_MAX      8       /* superbufs held per burst channel */
+#define MM_SYNTH_JOB_MAX        8       /* pending reprocess requests */
+#define MM_SYNTH_ION_MAX        256     /* live ion handles */
+#define MM_SYNTH_AF_FRAMES      3       /* frames from do_auto_focus to done */
+#define MM_SYNTH_MAX_DELIVERY \
+    (MM_SYNTH_MAX_STREAMS + MM_CAMERA_CHANNEL_MAX * MM_SYNTH_QUEUE_MAX)
+
+typedef struct {
+    uint32_t my_hdl;
+    uint32_t ch_hdl;                  /* owning channel */
+    uint32_t server_id;
+    cam_stream_info_t *stream_info;
+    cam_padding_info_t padding_info;
+    cam_frame_len_offset_t frame_offset;
+    mm_camera_stream_mem_vtbl_t mem_vtbl;
+    mm_camera_buf_notify_t stream_cb;
+    void *user_data;
+
+    uint8_t active;
+    uint8_t buf_num;
+    mm_camera_buf_def_t *buf;
+    uint8_t buf_refcnt[CAM_MAX_NUM_BUFS_PER_STREAM];
+
+    /* buffers owned by the "driver", FIFO like the kernel queue */
+    uint8_t free_q[CAM_MAX_NUM_BUFS_PER_STREAM];
+    uint8_t free_head;
+    uint8_t free_cnt;
+
+    int32_t cur;                      /* buf filled this tick, -1 if none */
+    uint32_t burst_left;              /* frames left in burst streaming */
+
+    /* offline reprocess input, mapped by map_stream_buf */
+    void *input_map[CAM_MAX_NUM_BUFS_PER_STREAM];
+    size_t input_len[CAM_MAX_NUM_BUFS_PER_STREAM];
+
+    uint32_t frames;
+    uint32_t drops;
+} mm_synth_stream_t;
+
+typedef struct {
+    uint32_t my_hdl;
+    mm_camera_channel_attr_t attr;
+    mm_camera_buf_notify_t super_cb;
+    void *user_data;
+    uint8_t active;
+
+    uint8_t num_streams;              /* own and linked */
+    uint32_t streams[MAX_STREAM_NUM_IN_BUNDLE];
+
+    uint32_t pending_req;             /* outstanding request_super_buf */
+    uint8_t req_started;
+    uint32_t skip_left;               /* post_frame_skip countdown */
+
+    mm_camera_super_buf_t queue[MM_SYNTH_QUEUE_MAX];
+    uint8_t q_head;
+    uint8_t q_cnt;
+
+    uint32_t delivered;
+    uint32_t unmatched;
+    uint32_t overflow;
+} mm_synth_channel_t;
+
+typedef struct {
+    uint32_t stream_hdl;
+    cam_reprocess_param param;
+} mm_synth_job_t;
+
+typedef struct {
+    mm_camera_buf_notify_t cb;
+    void *user_data;
+    mm_camera_super_buf_t super_buf;
+} mm_synth_delivery_t;
+
+typedef struct {
+    uint8_t cam_idx;
+    uint32_t my_hdl;
+    int32_t ref_count;
+    mm_camera_vtbl_t vtbl;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;              /* wakes the frame thread */
+    pthread_cond_t idle_cond;         /* dispatch finished */
+    pthread_t frame_tid;
+    uint8_t thread_exit;
+    uint8_t dispatching;
+
+    mm_camera_event_notify_t evt_cb;
+    void *evt_data;
+
+    cam_capability_t *cap_buf;
+    size_t cap_len;
+
+    mm_synth_channel_t ch[MM_CAMERA_CHANNEL_MAX];
+    mm_synth_stream_t streams[MM_SYNTH_MAX_STREAMS];
+    uint32_t next_server_id;
+
+    mm_synth_job_t jobs[MM_SYNTH_JOB_MAX];
+    uint8_t job_head;
+    uint8_t job_cnt;
+
+    cam_dimension_t sensor_dim;
+    uint32_t max_fps;
+    uint32_t fps;
+    uint8_t fill;
+
+    uint32_t frame_idx;
+    uint8_t af_countdown;
+    uint8_t prep_snapshot_pending;
+
+    uint32_t late_ticks;
+
+    mm_synth_delivery_t dl[MM_SYNTH_MAX_DELIVERY];
+    uint32_t dl_cnt;
+} mm_synth_obj_t;
+
+typedef struct {
+    uint8_t used;
+    int fd;                           /* ashmem region, -1 until shared */
+    size_t len;
+} mm_synth_ion_buf_t;
+
+static pthread_mutex_t g_synth_lock = PTHREAD_MUTEX_INITIALIZER;
+static mm_synth_obj_t *g_synth_obj[MM_CAMERA_MAX_NUM_SENSORS];
+static struct camera_info g_synth_info[MM_CAMERA_MAX_NUM_SENSORS];
+static char g_synth_sensor_name[MM_CAMERA_MAX_NUM_SENSORS][PROPERTY_VALUE_MAX];
+static uint8_t g_synth_num_cam;
+
+static pthread_mutex_t g_synth_ion_lock = PTHREAD_MUTEX_INITIALIZER;
+static mm_synth_ion_buf_t g_synth_ion[MM_SYNTH_ION_MAX];
+
+static const cam_dimension_t g_synth_picture_sizes[] = {
+    {4160, 3120}, {4000, 3000}, {3264, 2448}, {2592, 1944}, {2048, 1536},
+    {1920, 1080}, {1600, 1200}, {1280, 960}, {1280, 720}, {640, 480},
+    {320, 240}
+};
+
+static const cam_dimension_t g_synth_preview_sizes[] = {
+    {1920, 1080}, {1440, 1080}, {1280, 720}, {960, 720}, {800, 480},
+    {720, 480}, {640, 480}, {352, 288}, {320, 240}, {176, 144}
+};
+
+#define SYNTH_ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_get_config
+ *
+ * DESCRIPTION: read a tunable from its property, falling back to the
+ *              environment (persist.camera.synth.fps -> CAMERA_SYNTH_FPS)
+ *              so the backend can be configured where there is no
+ *              property service
+ *
+ * PARAMETERS :
+ *   @key     : property name
+ *   @value   : output buffer of PROPERTY_VALUE_MAX bytes
+ *   @def     : default value
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_get_config(const char *key, char *value, const char *def)
+{
+    char env[PROPERTY_KEY_MAX];
+    const char *p = key;
+    const char *env_val;
+    size_t i = 0;
+
+    property_get(key, value, "");
+    if (value[0] != '\0') {
+        return;
+    }
+
+    if (strncmp(p, "persist.", 8) == 0) {
+        p += 8;
+    }
+    for (; *p != '\0' && i < sizeof(env) - 1; p++, i++) {
+        env[i] = (*p == '.') ? '_' :
+                (char)((*p >= 'a' && *p <= 'z') ? *p - 'a' + 'A' : *p);
+    }
+    env[i] = '\0';
+
+    env_val = getenv(env);
+    strlcpy(value, (env_val != NULL) ? env_val : def, PROPERTY_VALUE_MAX);
+}
+
+static int mm_synth_get_config_int(const char *key, int def)
+{
+    char value[PROPERTY_VALUE_MAX];
+    char def_str[16];
+
+    snprintf(def_str, sizeof(def_str), "%d", def);
+    mm_synth_get_config(key, value, def_str);
+    return (int)strtol(value, NULL, 0);
+}
+
+static int64_t mm_synth_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_camera_synth_ion_open
+ *
+ * DESCRIPTION: stand-in for open("/dev/ion"). Returns a descriptor the
+ *              caller can close as usual.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : file descriptor, -1 on failure
+ *==========================================================================*/
+int mm_camera_synth_ion_open(void)
+{
+    return open("/dev/null", O_RDONLY);
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_camera_synth_ion_ioctl
+ *
+ * DESCRIPTION: emulate the ion ioctls the HAL issues. ALLOC reserves a
+ *              handle, SHARE backs it with an ashmem region and returns a
+ *              dup of it, IMPORT wraps an existing fd, FREE drops the
+ *              handle. Cache maintenance is a no-op.
+ *
+ * PARAMETERS :
+ *   @fd      : descriptor from mm_camera_synth_ion_open
+ *   @req     : ION_IOC_* request
+ *   @arg     : request argument
+ *
+ * RETURN     : 0 on success, -1 with errno set on failure
+ *==========================================================================*/
+int mm_camera_synth_ion_ioctl(int fd, unsigned long req, void *arg)
+{
+    int rc = 0;
+    uint32_t i;
+
+    if (fd < 0 || arg == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_synth_ion_lock);
+    if (req == ION_IOC_ALLOC) {
+        struct ion_allocation_data *alloc = (struct ion_allocation_data *)arg;
+        for (i = 1; i < MM_SYNTH_ION_MAX; i++) {
+            if (!g_synth_ion[i].used) {
+                break;
+            }
+        }
+        if (i == MM_SYNTH_ION_MAX) {
+            errno = ENOMEM;
+            rc = -1;
+        } else {
+            g_synth_ion[i].used = 1;
+            g_synth_ion[i].fd = -1;
+            g_synth_ion[i].len = alloc->len;
+            alloc->handle = (__typeof__(alloc->handle))(uintptr_t)i;
+        }
+    } else if (req == ION_IOC_SHARE || req == ION_IOC_MAP) {
+        struct ion_fd_data *data = (struct ion_fd_data *)arg;
+        i = (uint32_t)(uintptr_t)data->handle;
+        if (i == 0 || i >= MM_SYNTH_ION_MAX || !g_synth_ion[i].used) {
+            errno = EINVAL;
+            rc = -1;
+        } else {
+            if (g_synth_ion[i].fd < 0) {
+                g_synth_ion[i].fd = ashmem_create_region("camera_synth",
+                        g_synth_ion[i].len);
+            }
+            data->fd = (g_synth_ion[i].fd < 0) ? -1 : dup(g_synth_ion[i].fd);
+            rc = (data->fd < 0) ? -1 : 0;
+        }
+    } else if (req == ION_IOC_IMPORT) {
+        struct ion_fd_data *data = (struct ion_fd_data *)arg;
+        for (i = 1; i < MM_SYNTH_ION_MAX; i++) {
+            if (!g_synth_ion[i].used) {
+                break;
+            }
+        }
+        if (i == MM_SYNTH_ION_MAX) {
+            errno = ENOMEM;
+            rc = -1;
+        } else {
+            g_synth_ion[i].used = 1;
+            g_synth_ion[i].fd = dup(data->fd);
+            g_synth_ion[i].len = 0;
+            data->handle = (__typeof__(data->handle))(uintptr_t)i;
+        }
+    } else if (req == ION_IOC_FREE) {
+        struct ion_handle_data *data = (struct ion_handle_data *)arg;
+        i = (uint32_t)(uintptr_t)data->handle;
+        if (i == 0 || i >= MM_SYNTH_ION_MAX || !g_synth_ion[i].used) {
+            errno = EINVAL;
+            rc = -1;
+        } else {
+            if (g_synth_ion[i].fd >= 0) {
+                close(g_synth_ion[i].fd);
+            }
+            memset(&g_synth_ion[i], 0, sizeof(g_synth_ion[i]));
+        }
+    } else if (req != ION_IOC_CUSTOM) {
+        errno = ENOTTY;
+        rc = -1;
+    }
+    pthread_mutex_unlock(&g_synth_ion_lock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_get_obj
+ *
+ * DESCRIPTION: look up an opened camera by handle, taking its lock
+ *
+ * PARAMETERS :
+ *   @camera_handle : camera handle
+ *
+ * RETURN     : locked camera object, NULL if the handle is stale
+ *==========================================================================*/
+static mm_synth_obj_t *mm_synth_get_obj(uint32_t camera_handle)
+{
+    mm_synth_obj_t *obj = NULL;
+    uint8_t idx = mm_camera_util_get_index_by_handler(camera_handle);
+
+    pthread_mutex_lock(&g_synth_lock);
+    if (idx < MM_CAMERA_MAX_NUM_SENSORS && g_synth_obj[idx] != NULL &&
+            g_synth_obj[idx]->my_hdl == camera_handle) {
+        obj = g_synth_obj[idx];
+        pthread_mutex_lock(&obj->lock);
+    }
+    pthread_mutex_unlock(&g_synth_lock);
+    return obj;
+}
+
+static mm_synth_channel_t *mm_synth_get_channel(mm_synth_obj_t *obj,
+        uint32_t ch_id)
+{
+    uint8_t idx = mm_camera_util_get_index_by_handler(ch_id);
+    if (idx < MM_CAMERA_CHANNEL_MAX && obj->ch[idx].my_hdl != 0 &&
+            obj->ch[idx].my_hdl == ch_id) {
+        return &obj->ch[idx];
+    }
+    return NULL;
+}
+
+static mm_synth_stream_t *mm_synth_get_stream(mm_synth_obj_t *obj,
+        uint32_t stream_id)
+{
+    uint8_t idx = mm_camera_util_get_index_by_handler(stream_id);
+    if (idx < MM_SYNTH_MAX_STREAMS && obj->streams[idx].my_hdl != 0 &&
+            obj->streams[idx].my_hdl == stream_id) {
+        return &obj->streams[idx];
+    }
+    return NULL;
+}
+
+static mm_synth_stream_t *mm_synth_get_stream_by_server_id(
+        mm_synth_obj_t *obj, uint32_t server_id)
+{
+    int i;
+    for (i = 0; i < MM_SYNTH_MAX_STREAMS; i++) {
+        if (obj->streams[i].my_hdl != 0 &&
+                obj->streams[i].server_id == server_id) {
+            return &obj->streams[i];
+        }
+    }
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_buf_done
+ *
+ * DESCRIPTION: drop one reference on a stream buffer, returning it to the
+ *              driver queue when the last consumer is done. Caller holds
+ *              the camera lock.
+ *
+ * PARAMETERS :
+ *   @s       : stream object
+ *   @idx     : buffer index
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_synth_buf_done(mm_synth_stream_t *s, uint32_t idx)
+{
+    if (!s->active || idx >= s->buf_num) {
+        /* buffers returned after stop are simply forgotten */
+        return 0;
+    }
+    if (s->buf_refcnt[idx] == 0) {
+        CDBG_ERROR("%s: buf %u of stream 0x%x freed twice",
+                __func__, idx, s->my_hdl);
+        return -1;
+    }
+    if (--s->buf_refcnt[idx] == 0) {
+        s->free_q[(s->free_head + s->free_cnt) % CAM_MAX_NUM_BUFS_PER_STREAM] =
+                (uint8_t)idx;
+        s->free_cnt++;
+    }
+    return 0;
+}
+
+static void mm_synth_release_super_buf(mm_synth_obj_t *obj,
+        mm_camera_super_buf_t *super_buf)
+{
+    uint32_t i;
+    for (i = 0; i < super_buf->num_bufs; i++) {
+        mm_synth_stream_t *s =
+                mm_synth_get_stream(obj, super_buf->bufs[i]->stream_id);
+        if (s != NULL) {
+            mm_synth_buf_done(s, super_buf->bufs[i]->buf_idx);
+        }
+    }
+    super_buf->num_bufs = 0;
+}
+
+static void mm_synth_add_delivery(mm_synth_obj_t *obj,
+        mm_camera_buf_notify_t cb, void *user_data,
+        mm_camera_super_buf_t *super_buf)
+{
+    if (obj->dl_cnt >= MM_SYNTH_MAX_DELIVERY) {
+        /* sized for the worst case, cannot happen */
+        mm_synth_release_super_buf(obj, super_buf);
+        return;
+    }
+    obj->dl[obj->dl_cnt].cb = cb;
+    obj->dl[obj->dl_cnt].user_data = user_data;
+    obj->dl[obj->dl_cnt].super_buf = *super_buf;
+    obj->dl_cnt++;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_fill_frame
+ *
+ * DESCRIPTION: paint a synthetic image into a stream buffer: a luma ramp
+ *              that scrolls with the frame index and a moving bar, flat
+ *              chroma. Bayer and YUV streams get the same treatment.
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *   @s       : stream object
+ *   @buf     : buffer to fill
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_fill_frame(mm_synth_obj_t *obj, mm_synth_stream_t *s,
+        mm_camera_buf_def_t *buf)
+{
+    int8_t p;
+
+    if (!obj->fill || buf->buffer == NULL) {
+        return;
+    }
+
+    for (p = 0; p < buf->num_planes && p < VIDEO_MAX_PLANES; p++) {
+        const cam_mp_len_offset_t *mp = &s->frame_offset.mp[p];
+        uint8_t *base = (uint8_t *)buf->buffer +
+                buf->planes[p].reserved[0] + buf->planes[p].data_offset;
+        uint32_t len = buf->planes[p].length;
+        uint32_t stride = (mp->stride > 0) ? (uint32_t)mp->stride : 0;
+        uint32_t width = (mp->width > 0) ? (uint32_t)mp->width : stride;
+        uint32_t height = (mp->height > 0) ? (uint32_t)mp->height :
+                (uint32_t)mp->scanline;
+        uint32_t bar = (buf->frame_idx * 8) % (width ? width : 1);
+        uint32_t y;
+
+        if (stride == 0 || width > stride) {
+            continue;
+        }
+        for (y = 0; y < height && (y + 1) * stride <= len; y++) {
+            uint8_t *row = base + y * stride;
+            if (p == 0) {
+                memset(row, (uint8_t)(y + buf->frame_idx * 2), width);
+                memset(row + bar, 235,
+                        (bar + 16 <= width) ? 16 : width - bar);
+            } else {
+                memset(row, 128, width);
+            }
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_fill_meta
+ *
+ * DESCRIPTION: fill the HAL1 metadata for the current frame: crop of every
+ *              running stream plus any pending auto focus or prepare
+ *              snapshot completion
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *   @buf     : metadata buffer
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_fill_meta(mm_synth_obj_t *obj, mm_camera_buf_def_t *buf)
+{
+    cam_metadata_info_t *meta = (cam_metadata_info_t *)buf->buffer;
+    uint8_t n = 0;
+    int i;
+
+    if (meta == NULL || buf->frame_len < sizeof(cam_metadata_info_t)) {
+        return;
+    }
+
+    meta->is_crop_valid = 1;
+    for (i = 0; i < MM_SYNTH_MAX_STREAMS && n < MAX_NUM_STREAMS; i++) {
+        mm_synth_stream_t *s = &obj->streams[i];
+        if (s->active && s->stream_info != NULL) {
+            meta->crop_data.crop_info[n].stream_id = s->server_id;
+            meta->crop_data.crop_info[n].crop.left = 0;
+            meta->crop_data.crop_info[n].crop.top = 0;
+            meta->crop_data.crop_info[n].crop.width = s->stream_info->dim.width;
+            meta->crop_data.crop_info[n].crop.height = s->stream_info->dim.height;
+            n++;
+        }
+    }
+    meta->crop_data.num_of_streams = n;
+
+    meta->is_focus_valid = 0;
+    if (obj->af_countdown > 0 && --obj->af_countdown == 0) {
+        meta->is_focus_valid = 1;
+        memset(&meta->focus_data, 0, sizeof(meta->focus_data));
+        meta->focus_data.focus_state = CAM_AF_FOCUSED;
+    }
+
+    meta->is_prep_snapshot_done_valid = 0;
+    if (obj->prep_snapshot_pending) {
+        obj->prep_snapshot_pending = 0;
+        meta->is_prep_snapshot_done_valid = 1;
+        meta->prep_snapshot_done_state = DO_NOT_NEED_FUTURE_FRAME;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_produce
+ *
+ * DESCRIPTION: take the oldest driver owned buffer of a stream and fill it
+ *              for the current frame
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *   @s       : stream object
+ *   @ts      : frame timestamp
+ *
+ * RETURN     : buffer index, -1 if the HAL holds every buffer
+ *==========================================================================*/
+static int32_t mm_synth_produce(mm_synth_obj_t *obj, mm_synth_stream_t *s,
+        const struct timespec *ts)
+{
+    mm_camera_buf_def_t *buf;
+    uint8_t idx;
+
+    if (s->free_cnt == 0) {
+        s->drops++;
+        return -1;
+    }
+    idx = s->free_q[s->free_head];
+    s->free_head = (uint8_t)((s->free_head + 1) % CAM_MAX_NUM_BUFS_PER_STREAM);
+    s->free_cnt--;
+
+    buf = &s->buf[idx];
+    buf->frame_idx = obj->frame_idx;
+    buf->ts = *ts;
+    if (s->stream_info->stream_type == CAM_STREAM_TYPE_METADATA) {
+        mm_synth_fill_meta(obj, buf);
+    } else {
+        mm_synth_fill_frame(obj, s, buf);
+    }
+    s->frames++;
+    CAM_TRACE_BUF(CAM_TRACE_RCVD_BUF, buf);
+    return idx;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_service_channel
+ *
+ * DESCRIPTION: hand queued superbufs of a burst channel to the HAL while
+ *              it has outstanding requests. On the first delivery of a
+ *              request only the last look_back frames are considered.
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *   @ch      : channel object
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_service_channel(mm_synth_obj_t *obj,
+        mm_synth_channel_t *ch)
+{
+    if (ch->pending_req == 0 || ch->q_cnt == 0) {
+        return;
+    }
+    if (!ch->req_started) {
+        ch->req_started = 1;
+        while (ch->attr.look_back > 0 && ch->q_cnt > ch->attr.look_back) {
+            mm_synth_release_super_buf(obj, &ch->queue[ch->q_head]);
+            ch->q_head = (uint8_t)((ch->q_head + 1) % MM_SYNTH_QUEUE_MAX);
+            ch->q_cnt--;
+        }
+    }
+    while (ch->pending_req > 0 && ch->q_cnt > 0) {
+        mm_synth_add_delivery(obj, ch->super_cb, ch->user_data,
+                &ch->queue[ch->q_head]);
+        ch->q_head = (uint8_t)((ch->q_head + 1) % MM_SYNTH_QUEUE_MAX);
+        ch->q_cnt--;
+        ch->pending_req--;
+        ch->delivered++;
+    }
+    if (ch->pending_req == 0) {
+        ch->req_started = 0;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_bundle
+ *
+ * DESCRIPTION: match this frame's buffers of every stream in the channel
+ *              into a superbuf and either dispatch it (continuous) or
+ *              queue it for request_super_buf (burst)
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *   @ch      : channel object
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_bundle(mm_synth_obj_t *obj, mm_synth_channel_t *ch)
+{
+    mm_camera_super_buf_t super_buf;
+    uint8_t i;
+    uint8_t produced = 0;
+
+    memset(&super_buf, 0, sizeof(super_buf));
+    super_buf.camera_handle = obj->my_hdl;
+    super_buf.ch_id = ch->my_hdl;
+
+    for (i = 0; i < ch->num_streams; i++) {
+        mm_synth_stream_t *s = mm_synth_get_stream(obj, ch->streams[i]);
+        if (s == NULL || !s->active || s->cur < 0) {
+            continue;
+        }
+        produced++;
+        super_buf.bufs[super_buf.num_bufs++] = &s->buf[s->cur];
+    }
+    if (produced == 0) {
+        return;
+    }
+    if (produced != ch->num_streams) {
+        /* a stream ran dry or finished its burst, drop like an
+         * incomplete match */
+        ch->unmatched++;
+        return;
+    }
+    for (i = 0; i < super_buf.num_bufs; i++) {
+        mm_synth_stream_t *s =
+                mm_synth_get_stream(obj, super_buf.bufs[i]->stream_id);
+        s->buf_refcnt[super_buf.bufs[i]->buf_idx]++;
+    }
+
+    if (ch->attr.notify_mode == MM_CAMERA_SUPER_BUF_NOTIFY_CONTINUOUS) {
+        mm_synth_add_delivery(obj, ch->super_cb, ch->user_data, &super_buf);
+        ch->delivered++;
+        return;
+    }
+
+    if (ch->skip_left > 0) {
+        ch->skip_left--;
+        mm_synth_release_super_buf(obj, &super_buf);
+        return;
+    }
+    if (ch->q_cnt >= MM_SYNTH_QUEUE_MAX ||
+            (ch->pending_req == 0 && ch->attr.water_mark > 0 &&
+             ch->q_cnt >= ch->attr.water_mark)) {
+        mm_synth_release_super_buf(obj, &ch->queue[ch->q_head]);
+        ch->q_head = (uint8_t)((ch->q_head + 1) % MM_SYNTH_QUEUE_MAX);
+        ch->q_cnt--;
+        ch->overflow++;
+    }
+    ch->queue[(ch->q_head + ch->q_cnt) % MM_SYNTH_QUEUE_MAX] = super_buf;
+    ch->q_cnt++;
+    if (ch->pending_req > 0) {
+        mm_synth_service_channel(obj, ch);
+        ch->skip_left = ch->attr.post_frame_skip;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_tick
+ *
+ * DESCRIPTION: generate one frame on every running stream, then bundle
+ *              and queue the callbacks. Caller holds the camera lock.
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_tick(mm_synth_obj_t *obj)
+{
+    struct timespec ts;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    obj->frame_idx++;
+
+    for (i = 0; i < MM_SYNTH_MAX_STREAMS; i++) {
+        mm_synth_stream_t *s = &obj->streams[i];
+        s->cur = -1;
+        if (!s->active || s->stream_info->stream_type ==
+                CAM_STREAM_TYPE_OFFLINE_PROC) {
+            continue;
+        }
+        if (s->stream_info->streaming_mode == CAM_STREAMING_MODE_BURST) {
+            if (s->burst_left == 0) {
+                continue;
+            }
+            s->burst_left--;
+        }
+        s->cur = mm_synth_produce(obj, s, &ts);
+    }
+
+    for (i = 0; i < MM_CAMERA_CHANNEL_MAX; i++) {
+        if (obj->ch[i].active && obj->ch[i].super_cb != NULL) {
+            mm_synth_bundle(obj, &obj->ch[i]);
+        }
+    }
+
+    for (i = 0; i < MM_SYNTH_MAX_STREAMS; i++) {
+        mm_synth_stream_t *s = &obj->streams[i];
+        mm_camera_super_buf_t super_buf;
+        if (s->cur < 0) {
+            continue;
+        }
+        if (s->stream_cb != NULL) {
+            memset(&super_buf, 0, sizeof(super_buf));
+            super_buf.camera_handle = obj->my_hdl;
+            super_buf.ch_id = s->ch_hdl;
+            super_buf.num_bufs = 1;
+            super_buf.bufs[0] = &s->buf[s->cur];
+            s->buf_refcnt[s->cur]++;
+            mm_synth_add_delivery(obj, s->stream_cb, s->user_data, &super_buf);
+        }
+        if (s->buf_refcnt[s->cur] == 0) {
+            /* nobody consumed it, straight back to the driver */
+            s->buf_refcnt[s->cur] = 1;
+            mm_synth_buf_done(s, (uint32_t)s->cur);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_do_reprocess
+ *
+ * DESCRIPTION: produce the output of one reprocess request. The input is
+ *              copied from the mapped offline buffer or from the online
+ *              source stream buffer, as much as fits.
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *   @job     : reprocess request
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_do_reprocess(mm_synth_obj_t *obj, mm_synth_job_t *job)
+{
+    mm_synth_stream_t *s = mm_synth_get_stream(obj, job->stream_hdl);
+    mm_synth_channel_t *ch;
+    mm_camera_super_buf_t super_buf;
+    mm_camera_buf_def_t *buf;
+    cam_stream_reproc_config_t *cfg;
+    const void *src = NULL;
+    size_t src_len = 0;
+    struct timespec ts;
+    int32_t idx;
+
+    if (s == NULL || !s->active) {
+        return;
+    }
+    cfg = &s->stream_info->reprocess_config;
+    if (cfg->pp_type == CAM_OFFLINE_REPROCESS_TYPE) {
+        if (job->param.buf_index < CAM_MAX_NUM_BUFS_PER_STREAM) {
+            src = s->input_map[job->param.buf_index];
+            src_len = s->input_len[job->param.buf_index];
+        }
+    } else {
+        mm_synth_stream_t *src_s =
+                mm_synth_get_stream_by_server_id(obj, cfg->online.input_stream_id);
+        if (src_s != NULL && src_s->buf != NULL &&
+                job->param.buf_index < src_s->buf_num) {
+            src = src_s->buf[job->param.buf_index].buffer;
+            src_len = src_s->buf[job->param.buf_index].frame_len;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    idx = mm_synth_produce(obj, s, &ts);
+    if (idx < 0) {
+        CDBG_ERROR("%s: no output buffer for reprocess on stream 0x%x",
+                __func__, s->my_hdl);
+        return;
+    }
+    buf = &s->buf[idx];
+    buf->frame_idx = job->param.frame_idx;
+    if (src != NULL && buf->buffer != NULL) {
+        memcpy(buf->buffer, src,
+                (src_len < buf->frame_len) ? src_len : buf->frame_len);
+    }
+
+    memset(&super_buf, 0, sizeof(super_buf));
+    super_buf.camera_handle = obj->my_hdl;
+    super_buf.ch_id = s->ch_hdl;
+    super_buf.num_bufs = 1;
+    super_buf.bufs[0] = buf;
+
+    ch = mm_synth_get_channel(obj, s->ch_hdl);
+    if (ch != NULL && ch->active && ch->super_cb != NULL) {
+        s->buf_refcnt[idx]++;
+        mm_synth_add_delivery(obj, ch->super_cb, ch->user_data, &super_buf);
+        ch->delivered++;
+    }
+    if (s->stream_cb != NULL) {
+        s->buf_refcnt[idx]++;
+        mm_synth_add_delivery(obj, s->stream_cb, s->user_data, &super_buf);
+    }
+    if (s->buf_refcnt[idx] == 0) {
+        s->buf_refcnt[idx] = 1;
+        mm_synth_buf_done(s, (uint32_t)idx);
+    }
+}
+
+static uint8_t mm_synth_has_active_streams(mm_synth_obj_t *obj)
+{
+    int i;
+    for (i = 0; i < MM_SYNTH_MAX_STREAMS; i++) {
+        mm_synth_stream_t *s = &obj->streams[i];
+        if (s->active && s->stream_info->stream_type !=
+                CAM_STREAM_TYPE_OFFLINE_PROC) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_frame_thread
+ *
+ * DESCRIPTION: per camera frame generator. Ticks at the configured frame
+ *              rate while any stream runs, serves reprocess requests and
+ *              superbuf requests in between, and makes every callback to
+ *              the HAL without holding the camera lock.
+ *
+ * PARAMETERS :
+ *   @data    : camera object
+ *
+ * RETURN     : NULL
+ *==========================================================================*/
+static void *mm_synth_frame_thread(void *data)
+{
+    mm_synth_obj_t *obj = (mm_synth_obj_t *)data;
+    int64_t next_ns = 0;
+    int i;
+
+    pthread_mutex_lock(&obj->lock);
+    while (!obj->thread_exit) {
+        int64_t now_ns = mm_synth_now_ns();
+        int64_t period_ns = 1000000000LL / (obj->fps ? obj->fps : 30);
+        uint8_t streaming = mm_synth_has_active_streams(obj);
+
+        while (obj->job_cnt > 0) {
+            mm_synth_job_t job = obj->jobs[obj->job_head];
+            obj->job_head = (uint8_t)((obj->job_head + 1) % MM_SYNTH_JOB_MAX);
+            obj->job_cnt--;
+            mm_synth_do_reprocess(obj, &job);
+        }
+
+        for (i = 0; i < MM_CAMERA_CHANNEL_MAX; i++) {
+            if (obj->ch[i].active && obj->ch[i].super_cb != NULL) {
+                mm_synth_service_channel(obj, &obj->ch[i]);
+            }
+        }
+
+        if (streaming) {
+            if (next_ns == 0) {
+                next_ns = now_ns;
+            }
+            if (now_ns >= next_ns) {
+                mm_synth_tick(obj);
+                next_ns += period_ns;
+                if (next_ns < now_ns) {
+                    /* the HAL kept us busy past a whole frame, do not
+                     * try to catch up with a burst */
+                    obj->late_ticks++;
+                    next_ns = now_ns + period_ns;
+                }
+            }
+        } else {
+            next_ns = 0;
+        }
+
+        if (obj->dl_cnt > 0) {
+            uint32_t cnt = obj->dl_cnt;
+            obj->dispatching = TRUE;
+            pthread_mutex_unlock(&obj->lock);
+            for (i = 0; i < (int)cnt; i++) {
+                obj->dl[i].cb(&obj->dl[i].super_buf, obj->dl[i].user_data);
+            }
+            pthread_mutex_lock(&obj->lock);
+            obj->dl_cnt = 0;
+            obj->dispatching = FALSE;
+            pthread_cond_broadcast(&obj->idle_cond);
+            continue;
+        }
+
+        if (obj->job_cnt > 0 || obj->thread_exit) {
+            continue;
+        }
+        if (streaming) {
+            struct timespec deadline;
+            deadline.tv_sec = (time_t)(next_ns / 1000000000LL);
+            deadline.tv_nsec = (long)(next_ns % 1000000000LL);
+            pthread_cond_timedwait(&obj->cond, &obj->lock, &deadline);
+        } else {
+            pthread_cond_wait(&obj->cond, &obj->lock);
+        }
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return NULL;
+}
+
+/* wait until callbacks in flight have returned, unless we are them */
+static void mm_synth_wait_idle(mm_synth_obj_t *obj)
+{
+    if (pthread_equal(pthread_self(), obj->frame_tid)) {
+        return;
+    }
+    while (obj->dispatching) {
+        pthread_cond_wait(&obj->idle_cond, &obj->lock);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_fill_capability
+ *
+ * DESCRIPTION: describe the synthetic sensor. Size tables are the usual
+ *              ones clipped to the configured sensor size.
+ *
+ * PARAMETERS :
+ *   @obj     : camera object
+ *   @cap     : capability buffer to fill
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_synth_fill_capability(mm_synth_obj_t *obj, cam_capability_t *cap)
+{
+    size_t i, n;
+    int32_t w = obj->sensor_dim.width;
+    int32_t h = obj->sensor_dim.height;
+
+    memset(cap, 0, sizeof(cam_capability_t));
+    cap->version = CAM_HAL_V1;
+    cap->position = (g_synth_info[obj->cam_idx].facing == CAMERA_FACING_FRONT) ?
+            CAM_POSITION_FRONT : CAM_POSITION_BACK;
+    cap->sensor_mount_angle = (uint32_t)g_synth_info[obj->cam_idx].orientation;
+
+    n = 0;
+    cap->picture_sizes_tbl[n++] = obj->sensor_dim;
+    for (i = 0; i < SYNTH_ARRAY_SIZE(g_synth_picture_sizes) && n < MAX_SIZES_CNT; i++) {
+        if (g_synth_picture_sizes[i].width < w && g_synth_picture_sizes[i].height <= h) {
+            cap->picture_sizes_tbl[n++] = g_synth_picture_sizes[i];
+        }
+    }
+    cap->picture_sizes_tbl_cnt = n;
+    memcpy(cap->livesnapshot_sizes_tbl, cap->picture_sizes_tbl,
+            sizeof(cap->livesnapshot_sizes_tbl));
+    cap->livesnapshot_sizes_tbl_cnt = n;
+
+    n = 0;
+    for (i = 0; i < SYNTH_ARRAY_SIZE(g_synth_preview_sizes) && n < MAX_SIZES_CNT; i++) {
+        if (g_synth_preview_sizes[i].width <= w && g_synth_preview_sizes[i].height <= h) {
+            cap->preview_sizes_tbl[n++] = g_synth_preview_sizes[i];
+        }
+    }
+    cap->preview_sizes_tbl_cnt = n;
+    memcpy(cap->video_sizes_tbl, cap->preview_sizes_tbl, sizeof(cap->video_sizes_tbl));
+    cap->video_sizes_tbl_cnt = n;
+
+    cap->fps_ranges_tbl[0].min_fps = 15.0f;
+    cap->fps_ranges_tbl[0].max_fps = (float)obj->max_fps;
+    cap->fps_ranges_tbl[0].video_min_fps = 15.0f;
+    cap->fps_ranges_tbl[0].video_max_fps = (float)obj->max_fps;
+    cap->fps_ranges_tbl[1].min_fps = (float)obj->max_fps;
+    cap->fps_ranges_tbl[1].max_fps = (float)obj->max_fps;
+    cap->fps_ranges_tbl[1].video_min_fps = (float)obj->max_fps;
+    cap->fps_ranges_tbl[1].video_max_fps = (float)obj->max_fps;
+    cap->fps_ranges_tbl_cnt = 2;
+
+    cap->hfr_tbl_cnt = 0;
+
+    cap->supported_preview_fmts[0] = CAM_FORMAT_YUV_420_NV21;
+    cap->supported_preview_fmts[1] = CAM_FORMAT_YUV_420_YV12;
+    cap->supported_preview_fmt_cnt = 2;
+    cap->supported_picture_fmts[0] = CAM_FORMAT_JPEG;
+    cap->supported_picture_fmts[1] = CAM_FORMAT_YUV_420_NV21;
+    cap->supported_picture_fmt_cnt = 2;
+    cap->raw_dim = obj->sensor_dim;
+    cap->supported_raw_fmts[0] = CAM_FORMAT_BAYER_MIPI_RAW_10BPP_BGGR;
+    cap->supported_raw_fmt_cnt = 1;
+
+    cap->supported_iso_modes[0] = CAM_ISO_MODE_AUTO;
+    cap->supported_iso_modes_cnt = 1;
+    cap->supported_flash_modes[0] = CAM_FLASH_MODE_OFF;
+    cap->supported_flash_modes_cnt = 1;
+    cap->supported_effects[0] = CAM_EFFECT_MODE_OFF;
+    cap->supported_effects_cnt = 1;
+    cap->supported_scene_modes[0] = CAM_SCENE_MODE_OFF;
+    cap->supported_scene_modes_cnt = 1;
+    cap->supported_aec_modes[0] = CAM_AEC_MODE_FRAME_AVERAGE;
+    cap->supported_aec_modes_cnt = 1;
+    cap->supported_antibandings[0] = CAM_ANTIBANDING_MODE_OFF;
+    cap->supported_antibandings[1] = CAM_ANTIBANDING_MODE_AUTO;
+    cap->supported_antibandings_cnt = 2;
+    cap->supported_white_balances[0] = CAM_WB_MODE_AUTO;
+    cap->supported_white_balances_cnt = 1;
+    cap->supported_focus_modes[0] = CAM_FOCUS_MODE_AUTO;
+    cap->supported_focus_modes[1] = CAM_FOCUS_MODE_INFINITY;
+    cap->supported_focus_modes[2] = CAM_FOCUS_MODE_CONTINOUS_PICTURE;
+    cap->supported_focus_modes[3] = CAM_FOCUS_MODE_CONTINOUS_VIDEO;
+    cap->supported_focus_modes_cnt = 4;
+    cap->supported_focus_algos[0] = CAM_FOCUS_ALGO_AUTO;
+    cap->supported_focus_algos_cnt = 1;
+
+    /* 1x to 4x in 5% steps */
+    for (i = 0; i < 61 && i < MAX_ZOOMS_CNT; i++) {
+        cap->zoom_ratio_tbl[i] = (uint32_t)(100 + i * 5);
+    }
+    cap->zoom_ratio_tbl_cnt = i;
+    cap->zoom_supported = 1;
+
+    cap->exposure_compensation_min = -12;
+    cap->exposure_compensation_max = 12;
+    cap->exposure_compensation_default = 0;
+    cap->exposure_compensation_step = 1.0f / 6.0f;
+    cap->exp_compensation_step.numerator = 1;
+    cap->exp_compensation_step.denominator = 6;
+
+    cap->brightness_ctrl.min_value = 0;
+    cap->brightness_ctrl.max_value = 6;
+    cap->brightness_ctrl.def_value = 3;
+    cap->brightness_ctrl.step = 1;
+    cap->sharpness_ctrl.min_value = 0;
+    cap->sharpness_ctrl.max_value = 36;
+    cap->sharpness_ctrl.def_value = 12;
+    cap->sharpness_ctrl.step = 6;
+    cap->contrast_ctrl.min_value = 0;
+    cap->contrast_ctrl.max_value = 10;
+    cap->contrast_ctrl.def_value = 5;
+    cap->contrast_ctrl.step = 1;
+    cap->saturation_ctrl.min_value = 0;
+    cap->saturation_ctrl.max_value = 10;
+    cap->saturation_ctrl.def_value = 5;
+    cap->saturation_ctrl.step = 1;
+    cap->sce_ctrl.min_value = -100;
+    cap->sce_ctrl.max_value = 100;
+    cap->sce_ctrl.def_value = 0;
+    cap->sce_ctrl.step = 10;
+
+    cap->auto_wb_lock_supported = 1;
+    cap->auto_exposure_lock_supported = 1;
+    cap->video_snapshot_supported = 1;
+    cap->max_num_roi = 5;
+    cap->max_num_focus_areas = 1;
+    cap->max_num_metering_areas = 1;
+    cap->focal_length = 3.5f;
+    cap->hor_view_angle = 62.0f;
+    cap->ver_view_angle = 48.0f;
+
+    cap->padding_info.width_padding = CAM_PAD_TO_32;
+    cap->padding_info.height_padding = CAM_PAD_TO_32;
+    cap->padding_info.plane_padding = CAM_PAD_TO_4K;
+    cap->min_num_pp_bufs = 1;
+    cap->qcom_supported_feature_mask =
+            (uint32_t)mm_synth_get_config_int("persist.camera.synth.features", 0);
+
+    cap->pixel_array_size = obj->sensor_dim;
+    cap->active_array_size.width = w;
+    cap->active_array_size.height = h;
+    cap->color_arrangement = CAM_FILTER_ARRANGEMENT_BGGR;
+    cap->white_level = 1023;
+    cap->max_frame_duration = 1000000000LL / 15;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_set_parms
+ *
+ * DESCRIPTION: pick up the parameters the generator cares about from a
+ *              batch: the frame rate range. Everything else is accepted.
+ *
+ * PARAMETERS :
+ *   @camera_handle : camera handle
+ *   @parms   : parameter batch, parm_buffer_new_t
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_synth_set_parms(uint32_t camera_handle, void *parms)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    parm_buffer_new_t *table = (parm_buffer_new_t *)parms;
+    parm_entry_type_new_t *entry;
+    size_t i;
+
+    if (obj == NULL) {
+        return -1;
+    }
+    if (table != NULL) {
+        entry = (parm_entry_type_new_t *)(void *)&table->entry[0];
+        for (i = 0; i < table->num_entry; i++) {
+            if (entry->entry_type == CAM_INTF_PARM_FPS_RANGE &&
+                    entry->size >= sizeof(cam_fps_range_t)) {
+                cam_fps_range_t range;
+                float fps;
+                memcpy(&range, entry->data, sizeof(range));
+                fps = (range.video_max_fps > range.max_fps) ?
+                        range.video_max_fps : range.max_fps;
+                obj->fps = (fps >= 1.0f && fps < (float)obj->max_fps) ?
+                        (uint32_t)fps : obj->max_fps;
+            }
+            entry = GET_NEXT_PARAM(entry, parm_entry_type_new_t);
+        }
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_get_parms(uint32_t camera_handle, void *parms)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    parm_buffer_new_t *table = (parm_buffer_new_t *)parms;
+    parm_entry_type_new_t *entry;
+    size_t i;
+
+    if (obj == NULL) {
+        return -1;
+    }
+    if (table != NULL) {
+        entry = (parm_entry_type_new_t *)(void *)&table->entry[0];
+        for (i = 0; i < table->num_entry; i++) {
+            if (entry->entry_type == CAM_INTF_PARM_RAW_DIMENSION &&
+                    entry->size >= sizeof(cam_dimension_t)) {
+                memcpy(entry->data, &obj->sensor_dim, sizeof(cam_dimension_t));
+            }
+            entry = GET_NEXT_PARAM(entry, parm_entry_type_new_t);
+        }
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_query_capability(uint32_t camera_handle)
+{
+    int32_t rc = -1;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    if (obj->cap_buf != NULL && obj->cap_len >= sizeof(cam_capability_t)) {
+        mm_synth_fill_capability(obj, obj->cap_buf);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_register_event_notify(uint32_t camera_handle,
+        mm_camera_event_notify_t evt_cb, void *user_data)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    if (obj == NULL) {
+        return -1;
+    }
+    obj->evt_cb = evt_cb;
+    obj->evt_data = user_data;
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_map_buf(uint32_t camera_handle, uint8_t buf_type,
+        int fd, size_t size)
+{
+    int32_t rc = 0;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    if (buf_type == CAM_MAPPING_BUF_TYPE_CAPABILITY) {
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            CDBG_ERROR("%s: mmap capability failed: %s", __func__, strerror(errno));
+            rc = -1;
+        } else {
+            obj->cap_buf = (cam_capability_t *)addr;
+            obj->cap_len = size;
+        }
+    }
+    /* the parameter batch is passed by pointer to set_parms */
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_unmap_buf(uint32_t camera_handle, uint8_t buf_type)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    if (buf_type == CAM_MAPPING_BUF_TYPE_CAPABILITY && obj->cap_buf != NULL) {
+        munmap(obj->cap_buf, obj->cap_len);
+        obj->cap_buf = NULL;
+        obj->cap_len = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_do_auto_focus(uint32_t camera_handle)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    if (obj == NULL) {
+        return -1;
+    }
+    obj->af_countdown = MM_SYNTH_AF_FRAMES;
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_cancel_auto_focus(uint32_t camera_handle)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    if (obj == NULL) {
+        return -1;
+    }
+    obj->af_countdown = 0;
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_prepare_snapshot(uint32_t camera_handle,
+        int32_t do_af_flag)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    if (obj == NULL) {
+        return -1;
+    }
+    obj->prep_snapshot_pending = 1;
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_zsl_snapshot(uint32_t camera_handle,
+        uint32_t ch_id)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    if (obj == NULL) {
+        return -1;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static uint32_t mm_synth_add_channel(uint32_t camera_handle,
+        mm_camera_channel_attr_t *attr, mm_camera_buf_notify_t channel_cb,
+        void *userdata)
+{
+    uint32_t hdl = 0;
+    uint8_t i;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return 0;
+    }
+    for (i = 0; i < MM_CAMERA_CHANNEL_MAX; i++) {
+        if (obj->ch[i].my_hdl == 0) {
+            break;
+        }
+    }
+    if (i < MM_CAMERA_CHANNEL_MAX) {
+        mm_synth_channel_t *ch = &obj->ch[i];
+        memset(ch, 0, sizeof(*ch));
+        ch->my_hdl = mm_camera_util_generate_handler(i);
+        if (attr != NULL) {
+            ch->attr = *attr;
+        } else {
+            ch->attr.notify_mode = MM_CAMERA_SUPER_BUF_NOTIFY_CONTINUOUS;
+        }
+        ch->super_cb = channel_cb;
+        ch->user_data = userdata;
+        hdl = ch->my_hdl;
+    } else {
+        CDBG_ERROR("%s: no free channel", __func__);
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return hdl;
+}
+
+static void mm_synth_unlink(mm_synth_obj_t *obj, mm_synth_channel_t *ch,
+        uint32_t stream_id)
+{
+    uint8_t i, j;
+    for (i = 0; i < ch->num_streams; i++) {
+        if (ch->streams[i] == stream_id) {
+            for (j = i; j + 1 < ch->num_streams; j++) {
+                ch->streams[j] = ch->streams[j + 1];
+            }
+            ch->num_streams--;
+            return;
+        }
+    }
+}
+
+static int32_t mm_synth_delete_channel(uint32_t camera_handle, uint32_t ch_id)
+{
+    int i;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch == NULL || ch->active) {
+        pthread_mutex_unlock(&obj->lock);
+        return -1;
+    }
+    for (i = 0; i < MM_SYNTH_MAX_STREAMS; i++) {
+        mm_synth_stream_t *s = &obj->streams[i];
+        if (s->my_hdl != 0 && s->ch_hdl == ch_id) {
+            int j;
+            for (j = 0; j < MM_CAMERA_CHANNEL_MAX; j++) {
+                mm_synth_unlink(obj, &obj->ch[j], s->my_hdl);
+            }
+            memset(s, 0, sizeof(*s));
+        }
+    }
+    memset(ch, 0, sizeof(*ch));
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static int32_t mm_synth_get_bundle_info(uint32_t camera_handle, uint32_t ch_id,
+        cam_bundle_config_t *bundle_info)
+{
+    uint8_t i;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch == NULL || bundle_info == NULL) {
+        pthread_mutex_unlock(&obj->lock);
+        return -1;
+    }
+    memset(bundle_info, 0, sizeof(*bundle_info));
+    bundle_info->bundle_id = ch->my_hdl;
+    for (i = 0; i < ch->num_streams; i++) {
+        mm_synth_stream_t *s = mm_synth_get_stream(obj, ch->streams[i]);
+        if (s != NULL) {
+            bundle_info->stream_ids[bundle_info->num_of_streams++] = s->server_id;
+        }
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+static uint32_t mm_synth_add_stream(uint32_t camera_handle, uint32_t ch_id)
+{
+    uint32_t hdl = 0;
+    uint8_t i;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return 0;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch != NULL && ch->num_streams < MAX_STREAM_NUM_IN_BUNDLE) {
+        for (i = 0; i < MM_SYNTH_MAX_STREAMS; i++) {
+            if (obj->streams[i].my_hdl == 0) {
+                break;
+            }
+        }
+        if (i < MM_SYNTH_MAX_STREAMS) {
+            mm_synth_stream_t *s = &obj->streams[i];
+            memset(s, 0, sizeof(*s));
+            s->my_hdl = mm_camera_util_generate_handler(i);
+            s->ch_hdl = ch_id;
+            s->server_id = ++obj->next_server_id;
+            s->cur = -1;
+            ch->streams[ch->num_streams++] = s->my_hdl;
+            hdl = s->my_hdl;
+        }
+    }
+    if (hdl == 0) {
+        CDBG_ERROR("%s: no free stream in channel 0x%x", __func__, ch_id);
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return hdl;
+}
+
+static int32_t mm_synth_link_stream(uint32_t camera_handle, uint32_t ch_id,
+        uint32_t stream_id, uint32_t linked_ch_id)
+{
+    int32_t rc = -1;
+    mm_synth_channel_t *linked;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    linked = mm_synth_get_channel(obj, linked_ch_id);
+    if (mm_synth_get_channel(obj, ch_id) != NULL &&
+            mm_synth_get_stream(obj, stream_id) != NULL &&
+            linked != NULL && linked->num_streams < MAX_STREAM_NUM_IN_BUNDLE) {
+        linked->streams[linked->num_streams++] = stream_id;
+        rc = (int32_t)stream_id;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_delete_stream(uint32_t camera_handle, uint32_t ch_id,
+        uint32_t stream_id)
+{
+    int32_t rc = -1;
+    mm_synth_stream_t *s;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    s = mm_synth_get_stream(obj, stream_id);
+    if (ch != NULL && s != NULL && !s->active) {
+        if (s->ch_hdl == ch_id) {
+            int i;
+            for (i = 0; i < MM_CAMERA_CHANNEL_MAX; i++) {
+                mm_synth_unlink(obj, &obj->ch[i], stream_id);
+            }
+            memset(s, 0, sizeof(*s));
+        } else {
+            mm_synth_unlink(obj, ch, stream_id);
+        }
+        rc = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_config_stream(uint32_t camera_handle, uint32_t ch_id,
+        uint32_t stream_id, mm_camera_stream_config_t *config)
+{
+    int32_t rc = -1;
+    mm_synth_stream_t *s;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    s = mm_synth_get_stream(obj, stream_id);
+    if (s != NULL && s->ch_hdl == ch_id && config != NULL &&
+            config->stream_info != NULL) {
+        mm_stream_t tmp;
+
+        s->stream_info = config->stream_info;
+        s->padding_info = config->padding_info;
+        s->mem_vtbl = config->mem_vtbl;
+        s->stream_cb = config->stream_cb;
+        s->user_data = config->userdata;
+
+        /* same plane layout as the hardware path */
+        memset(&tmp, 0, sizeof(tmp));
+        tmp.stream_info = s->stream_info;
+        tmp.padding_info = s->padding_info;
+        rc = mm_stream_calc_offset(&tmp);
+        s->frame_offset = tmp.frame_offset;
+        s->stream_info->stream_svr_id = s->server_id;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_map_ops(uint32_t frame_idx,
+        int32_t plane_idx, int fd, size_t size,
+        void *userdata)
+{
+    /* buffers are shared by address within the process */
+    return 0;
+}
+
+static int32_t mm_synth_unmap_ops(uint32_t frame_idx,
+        int32_t plane_idx, void *userdata)
+{
+    return 0;
+}
+
+static int32_t mm_synth_map_stream_buf(uint32_t camera_handle, uint32_t ch_id,
+        uint32_t stream_id, uint8_t buf_type, uint32_t buf_idx,
+        int32_t plane_idx, int fd, size_t size)
+{
+    int32_t rc = 0;
+    mm_synth_stream_t *s;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    s = mm_synth_get_stream(obj, stream_id);
+    if (s == NULL || s->ch_hdl != ch_id) {
+        rc = -1;
+    } else if (buf_type == CAM_MAPPING_BUF_TYPE_OFFLINE_INPUT_BUF &&
+            buf_idx < CAM_MAX_NUM_BUFS_PER_STREAM) {
+        void *addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            CDBG_ERROR("%s: mmap input buf failed: %s", __func__, strerror(errno));
+            rc = -1;
+        } else {
+            if (s->input_map[buf_idx] != NULL) {
+                munmap(s->input_map[buf_idx], s->input_len[buf_idx]);
+            }
+            s->input_map[buf_idx] = addr;
+            s->input_len[buf_idx] = size;
+        }
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_unmap_stream_buf(uint32_t camera_handle, uint32_t ch_id,
+        uint32_t stream_id, uint8_t buf_type, uint32_t buf_idx,
+        int32_t plane_idx)
+{
+    int32_t rc = 0;
+    mm_synth_stream_t *s;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    s = mm_synth_get_stream(obj, stream_id);
+    if (s == NULL || s->ch_hdl != ch_id) {
+        rc = -1;
+    } else if (buf_type == CAM_MAPPING_BUF_TYPE_OFFLINE_INPUT_BUF &&
+            buf_idx < CAM_MAX_NUM_BUFS_PER_STREAM &&
+            s->input_map[buf_idx] != NULL) {
+        munmap(s->input_map[buf_idx], s->input_len[buf_idx]);
+        s->input_map[buf_idx] = NULL;
+        s->input_len[buf_idx] = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_set_stream_parms(uint32_t camera_handle, uint32_t ch_id,
+        uint32_t s_id, cam_stream_parm_buffer_t *parms)
+{
+    int32_t rc = 0;
+    mm_synth_stream_t *s;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    s = mm_synth_get_stream(obj, s_id);
+    if (s == NULL || s->ch_hdl != ch_id || parms == NULL) {
+        rc = -1;
+    } else if (parms->type == CAM_STREAM_PARAM_TYPE_DO_REPROCESS) {
+        if (!s->active || obj->job_cnt >= MM_SYNTH_JOB_MAX) {
+            CDBG_ERROR("%s: cannot queue reprocess on stream 0x%x",
+                    __func__, s_id);
+            rc = -1;
+        } else {
+            mm_synth_job_t *job =
+                    &obj->jobs[(obj->job_head + obj->job_cnt) % MM_SYNTH_JOB_MAX];
+            job->stream_hdl = s_id;
+            job->param = parms->reprocess;
+            obj->job_cnt++;
+            parms->reprocess.ret_val = 0;
+            pthread_cond_signal(&obj->cond);
+        }
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_get_stream_parms(uint32_t camera_handle, uint32_t ch_id,
+        uint32_t s_id, cam_stream_parm_buffer_t *parms)
+{
+    int32_t rc = 0;
+    mm_synth_stream_t *s;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    s = mm_synth_get_stream(obj, s_id);
+    if (s == NULL || s->ch_hdl != ch_id || parms == NULL ||
+            s->stream_info == NULL) {
+        rc = -1;
+    } else if (parms->type == CAM_STREAM_PARAM_TYPE_GET_OUTPUT_CROP) {
+        parms->outputCrop.num_of_streams = 1;
+        parms->outputCrop.crop_info[0].stream_id = s->server_id;
+        parms->outputCrop.crop_info[0].crop.left = 0;
+        parms->outputCrop.crop_info[0].crop.top = 0;
+        parms->outputCrop.crop_info[0].crop.width = s->stream_info->dim.width;
+        parms->outputCrop.crop_info[0].crop.height = s->stream_info->dim.height;
+    } else if (parms->type == CAM_STREAM_PARAM_TYPE_GET_IMG_PROP) {
+        memset(&parms->imgProp, 0, sizeof(parms->imgProp));
+        parms->imgProp.crop.width = s->stream_info->dim.width;
+        parms->imgProp.crop.height = s->stream_info->dim.height;
+        parms->imgProp.input = s->stream_info->dim;
+        parms->imgProp.output = s->stream_info->dim;
+        parms->imgProp.format = s->stream_info->fmt;
+        parms->imgProp.size = s->frame_offset.frame_len;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_start_channel
+ *
+ * DESCRIPTION: get buffers for every stream owned by the channel, queue
+ *              the ones flagged for initial registration to the driver
+ *              side and let the frame thread run
+ *
+ * PARAMETERS :
+ *   @camera_handle : camera handle
+ *   @ch_id   : channel handle
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_synth_start_channel(uint32_t camera_handle, uint32_t ch_id)
+{
+    int32_t rc = 0;
+    uint8_t i, j;
+    mm_synth_channel_t *ch;
+    mm_camera_map_unmap_ops_tbl_t ops_tbl;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch == NULL || ch->active) {
+        pthread_mutex_unlock(&obj->lock);
+        return -1;
+    }
+
+    ops_tbl.map_ops = mm_synth_map_ops;
+    ops_tbl.unmap_ops = mm_synth_unmap_ops;
+    ops_tbl.userdata = obj;
+
+    for (i = 0; i < ch->num_streams && rc == 0; i++) {
+        mm_synth_stream_t *s = mm_synth_get_stream(obj, ch->streams[i]);
+        uint8_t *reg_flags = NULL;
+
+        if (s == NULL || s->ch_hdl != ch_id) {
+            /* linked streams are started by their own channel */
+            continue;
+        }
+        if (s->stream_info == NULL || s->mem_vtbl.get_bufs == NULL) {
+            rc = -1;
+            break;
+        }
+        rc = s->mem_vtbl.get_bufs(&s->frame_offset, &s->buf_num, &reg_flags,
+                &s->buf, &ops_tbl, s->mem_vtbl.user_data);
+        if (rc != 0 || s->buf_num > CAM_MAX_NUM_BUFS_PER_STREAM) {
+            CDBG_ERROR("%s: get bufs failed for stream 0x%x", __func__, s->my_hdl);
+            free(reg_flags);
+            rc = -1;
+            break;
+        }
+        s->free_head = 0;
+        s->free_cnt = 0;
+        for (j = 0; j < s->buf_num; j++) {
+            s->buf[j].stream_id = s->my_hdl;
+            s->buf[j].stream_type = s->stream_info->stream_type;
+            if (reg_flags != NULL && reg_flags[j]) {
+                s->buf_refcnt[j] = 0;
+                s->free_q[s->free_cnt++] = j;
+            } else {
+                /* held by the HAL until it is queued with qbuf */
+                s->buf_refcnt[j] = 1;
+            }
+        }
+        free(reg_flags);
+        s->stream_info->num_bufs = s->buf_num;
+        s->burst_left = s->stream_info->num_of_burst;
+        s->frames = 0;
+        s->drops = 0;
+        s->active = TRUE;
+    }
+
+    if (rc != 0) {
+        for (j = 0; j < i; j++) {
+            mm_synth_stream_t *s = mm_synth_get_stream(obj, ch->streams[j]);
+            if (s != NULL && s->ch_hdl == ch_id && s->active) {
+                s->active = FALSE;
+                s->mem_vtbl.put_bufs(&ops_tbl, s->mem_vtbl.user_data);
+                free(s->buf);
+                s->buf = NULL;
+            }
+        }
+    } else {
+        ch->active = TRUE;
+        ch->pending_req = 0;
+        ch->req_started = 0;
+        ch->skip_left = 0;
+        ch->q_head = 0;
+        ch->q_cnt = 0;
+        ch->delivered = 0;
+        ch->unmatched = 0;
+        ch->overflow = 0;
+        pthread_cond_signal(&obj->cond);
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_stop_channel
+ *
+ * DESCRIPTION: stop producing on the channel's streams, drop queued
+ *              superbufs, wait out callbacks in flight and give the
+ *              buffers back to the HAL
+ *
+ * PARAMETERS :
+ *   @camera_handle : camera handle
+ *   @ch_id   : channel handle
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_synth_stop_channel(uint32_t camera_handle, uint32_t ch_id)
+{
+    uint8_t i;
+    uint8_t num = 0;
+    mm_synth_channel_t *ch;
+    mm_synth_stream_t *stopped[MAX_STREAM_NUM_IN_BUNDLE];
+    mm_camera_map_unmap_ops_tbl_t ops_tbl;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch == NULL || !ch->active) {
+        pthread_mutex_unlock(&obj->lock);
+        return (ch == NULL) ? -1 : 0;
+    }
+
+    while (ch->q_cnt > 0) {
+        mm_synth_release_super_buf(obj, &ch->queue[ch->q_head]);
+        ch->q_head = (uint8_t)((ch->q_head + 1) % MM_SYNTH_QUEUE_MAX);
+        ch->q_cnt--;
+    }
+    ch->active = FALSE;
+    ch->pending_req = 0;
+    for (i = 0; i < ch->num_streams; i++) {
+        mm_synth_stream_t *s = mm_synth_get_stream(obj, ch->streams[i]);
+        if (s != NULL && s->ch_hdl == ch_id && s->active) {
+            s->active = FALSE;
+            stopped[num++] = s;
+            CDBG_HIGH("%s: stream 0x%x type %d: %u frames, %u dropped, "
+                    "%u late ticks", __func__, s->my_hdl,
+                    s->stream_info->stream_type, s->frames, s->drops,
+                    obj->late_ticks);
+        }
+    }
+    CDBG_HIGH("%s: channel 0x%x: %u superbufs, %u unmatched, %u overflow",
+            __func__, ch_id, ch->delivered, ch->unmatched, ch->overflow);
+    mm_synth_wait_idle(obj);
+    pthread_mutex_unlock(&obj->lock);
+
+    ops_tbl.map_ops = mm_synth_map_ops;
+    ops_tbl.unmap_ops = mm_synth_unmap_ops;
+    ops_tbl.userdata = obj;
+    for (i = 0; i < num; i++) {
+        stopped[i]->mem_vtbl.put_bufs(&ops_tbl, stopped[i]->mem_vtbl.user_data);
+        free(stopped[i]->buf);
+        stopped[i]->buf = NULL;
+        stopped[i]->buf_num = 0;
+        stopped[i]->free_cnt = 0;
+    }
+    return 0;
+}
+
+static int32_t mm_synth_qbuf(uint32_t camera_handle, uint32_t ch_id,
+        mm_camera_buf_def_t *buf)
+{
+    int32_t rc = -1;
+    mm_synth_stream_t *s;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    s = (buf != NULL) ? mm_synth_get_stream(obj, buf->stream_id) : NULL;
+    if (s != NULL) {
+        rc = mm_synth_buf_done(s, buf->buf_idx);
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_get_queued_buf_count(uint32_t camera_handle,
+        uint32_t ch_id, uint32_t stream_id)
+{
+    int32_t rc = -1;
+    mm_synth_stream_t *s;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    s = mm_synth_get_stream(obj, stream_id);
+    if (s != NULL) {
+        rc = s->free_cnt;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_request_super_buf(uint32_t camera_handle,
+        uint32_t ch_id, uint32_t num_buf_requested)
+{
+    int32_t rc = -1;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch != NULL && ch->active && ch->super_cb != NULL) {
+        ch->pending_req += num_buf_requested;
+        pthread_cond_signal(&obj->cond);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_cancel_super_buf_request(uint32_t camera_handle,
+        uint32_t ch_id)
+{
+    int32_t rc = -1;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch != NULL) {
+        ch->pending_req = 0;
+        ch->req_started = 0;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_flush_super_buf_queue(uint32_t camera_handle,
+        uint32_t ch_id, uint32_t frame_idx)
+{
+    int32_t rc = -1;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch != NULL) {
+        while (ch->q_cnt > 0 &&
+                ch->queue[ch->q_head].bufs[0]->frame_idx <= frame_idx) {
+            mm_synth_release_super_buf(obj, &ch->queue[ch->q_head]);
+            ch->q_head = (uint8_t)((ch->q_head + 1) % MM_SYNTH_QUEUE_MAX);
+            ch->q_cnt--;
+        }
+        rc = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_configure_notify_mode(uint32_t camera_handle,
+        uint32_t ch_id, mm_camera_super_buf_notify_mode_t notify_mode)
+{
+    int32_t rc = -1;
+    mm_synth_channel_t *ch;
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+
+    if (obj == NULL) {
+        return -1;
+    }
+    ch = mm_synth_get_channel(obj, ch_id);
+    if (ch != NULL && notify_mode < MM_CAMERA_SUPER_BUF_NOTIFY_MAX) {
+        ch->attr.notify_mode = notify_mode;
+        if (notify_mode == MM_CAMERA_SUPER_BUF_NOTIFY_CONTINUOUS) {
+            /* whatever was held for a burst goes out now */
+            ch->pending_req += ch->q_cnt;
+            pthread_cond_signal(&obj->cond);
+        }
+        rc = 0;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return rc;
+}
+
+static int32_t mm_synth_process_advanced_capture(uint32_t camera_handle,
+        mm_camera_advanced_capture_t type, uint32_t ch_id,
+        int8_t start_flag)
+{
+    mm_synth_obj_t *obj = mm_synth_get_obj(camera_handle);
+    if (obj == NULL) {
+        return -1;
+    }
+    pthread_mutex_unlock(&obj->lock);
+    return 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_synth_close
+ *
+ * DESCRIPTION: drop a reference on the camera, tearing it down with the
+ *              last one
+ *
+ * PARAMETERS :
+ *   @camera_handle : camera handle
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_synth_close(uint32_t camera_handle)
+{
+    mm_synth_obj_t *obj = NULL;
+    uint8_t idx = mm_camera_util_get_index_by_handler(camera_handle);
+
+    pthread_mutex_lock(&g_synth_lock);
+    if (idx < MM_CAMERA_MAX_NUM_SENSORS && g_synth_obj[idx] != NULL &&
+            g_synth_obj[idx]->my_hdl == camera_handle) {
+        obj = g_synth_obj[idx];
+        if (--obj->ref_count > 0) {
+            obj = NULL;
+        } else {
+            g_synth_obj[idx] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&g_synth_lock);
+    if (obj == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&obj->lock);
+    obj->thread_exit = TRUE;
+    pthread_cond_signal(&obj->cond);
+    pthread_mutex_unlock(&obj->lock);
+    pthread_join(obj->frame_tid, NULL);
+
+    if (obj->cap_buf != NULL) {
+        munmap(obj->cap_buf, obj->cap_len);
+    }
+    pthread_cond_destroy(&obj->idle_cond);
+    pthread_cond_destroy(&obj->cond);
+    pthread_mutex_destroy(&obj->lock);
+    free(obj);
+    return 0;
+}
+
+static mm_camera_ops_t mm_synth_ops = {
+    .query_capability = mm_synth_query_capability,
+    .register_event_notify = mm_synth_register_event_notify,
+    .close_camera = mm_synth_close,
+    .set_parms = mm_synth_set_parms,
+    .get_parms = mm_synth_get_parms,
+    .do_auto_focus = mm_synth_do_auto_focus,
+    .cancel_auto_focus = mm_synth_cancel_auto_focus,
+    .prepare_snapshot = mm_synth_prepare_snapshot,
+    .start_zsl_snapshot = mm_synth_zsl_snapshot,
+    .stop_zsl_snapshot = mm_synth_zsl_snapshot,
+    .map_buf = mm_synth_map_buf,
+    .unmap_buf = mm_synth_unmap_buf,
+    .add_channel = mm_synth_add_channel,
+    .delete_channel = mm_synth_delete_channel,
+    .get_bundle_info = mm_synth_get_bundle_info,
+    .add_stream = mm_synth_add_stream,
+    .link_stream = mm_synth_link_stream,
+    .delete_stream = mm_synth_delete_stream,
+    .config_stream = mm_synth_config_stream,
+    .qbuf = mm_synth_qbuf,
+    .get_queued_buf_count = mm_synth_get_queued_buf_count,
+    .map_stream_buf = mm_synth_map_stream_buf,
+    .unmap_stream_buf = mm_synth_unmap_stream_buf,
+    .set_stream_parms = mm_synth_set_stream_parms,
+    .get_stream_parms = mm_synth_get_stream_parms,
+    .start_channel = mm_synth_start_channel,
+    .stop_channel = mm_synth_stop_channel,
+    .request_super_buf = mm_synth_request_super_buf,
+    .cancel_super_buf_request = mm_synth_cancel_super_buf_request,
+    .flush_super_buf_queue = mm_synth_flush_super_buf_queue,
+    .configure_notify_mode = mm_synth_configure_notify_mode,
+    .process_advanced_capture = mm_synth_process_advanced_capture
+};
+
+/*===========================================================================
+ * FUNCTION   : get_num_of_cameras
+ *
+ * DESCRIPTION: number of synthetic cameras, persist.camera.synth.num.
+ *              The first one faces back, the second one front.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : number of cameras supported
+ *==========================================================================*/
+uint8_t get_num_of_cameras()
+{
+    int num = mm_synth_get_config_int("persist.camera.synth.num", 1);
+    int i;
+
+    if (num < 1) {
+        num = 1;
+    } else if (num > 2) {
+        num = 2;
+    }
+
+    pthread_mutex_lock(&g_synth_lock);
+    g_synth_num_cam = (uint8_t)num;
+    for (i = 0; i < num; i++) {
+        g_synth_info[i].facing = (i == 0) ? CAMERA_FACING_BACK : CAMERA_FACING_FRONT;
+        g_synth_info[i].orientation = (i == 0) ? 90 : 270;
+    }
+    pthread_mutex_unlock(&g_synth_lock);
+    CDBG_HIGH("%s: %d synthetic camera(s)", __func__, num);
+    return (uint8_t)num;
+}
+
+struct camera_info *get_cam_info(uint32_t camera_id)
+{
+    return &g_synth_info[camera_id];
+}
+
+/*===========================================================================
+ * FUNCTION   : get_cam_sensor_name
+ *
+ * DESCRIPTION: name of a synthetic sensor. It carries the settings the
+ *              capabilities are built from, so changing one of them looks
+ *              like a different sensor.
+ *
+ * PARAMETERS :
+ *   @camera_id : camera Id
+ *
+ * RETURN     : sensor name, "" if the camera id is out of range
+ *==========================================================================*/
+const char *get_cam_sensor_name(uint32_t camera_id)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    if (camera_id >= MM_CAMERA_MAX_NUM_SENSORS) {
+        return "";
+    }
+    mm_synth_get_config("persist.camera.synth.sensor", value, "4160x3120");
+    snprintf(g_synth_sensor_name[camera_id], PROPERTY_VALUE_MAX,
+            "synth_%s_%d_%d", value,
+            mm_synth_get_config_int("persist.camera.synth.fps", 30),
+            mm_synth_get_config_int("persist.camera.synth.features", 0));
+    return g_synth_sensor_name[camera_id];
+}
+
+uint8_t check_cam_access(uint8_t camera_idx)
+{
+    return TRUE;
+}
+
+/*===========================================================================
+ * FUNCTION   : camera_open
+ *
+ * DESCRIPTION: open a synthetic camera and start its (idle) frame thread
+ *
+ * PARAMETERS :
+ *   @camera_idx : camera index. should within range of 0 to num_of_cameras
+ *
+ * RETURN     : ptr to a virtual table containing camera handle and operation table.
+ *              NULL if failed.
+ *==========================================================================*/
+mm_camera_vtbl_t * camera_open(uint8_t camera_idx)
+{
+    mm_synth_obj_t *obj;
+    pthread_condattr_t cond_attr;
+    char value[PROPERTY_VALUE_MAX];
+    int w = 0, h = 0;
+
+    cam_trace_refresh();
+    if (camera_idx >= g_synth_num_cam) {
+        CDBG_ERROR("%s: Invalid camera_idx (%d)", __func__, camera_idx);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_synth_lock);
+    if (g_synth_obj[camera_idx] != NULL) {
+        g_synth_obj[camera_idx]->ref_count++;
+        pthread_mutex_unlock(&g_synth_lock);
+        return &g_synth_obj[camera_idx]->vtbl;
+    }
+
+    obj = (mm_synth_obj_t *)calloc(1, sizeof(mm_synth_obj_t));
+    if (obj == NULL) {
+        pthread_mutex_unlock(&g_synth_lock);
+        CDBG_ERROR("%s: no mem", __func__);
+        return NULL;
+    }
+    obj->cam_idx = camera_idx;
+    obj->ref_count = 1;
+    obj->my_hdl = mm_camera_util_generate_handler(camera_idx);
+    obj->vtbl.camera_handle = obj->my_hdl;
+    obj->vtbl.ops = &mm_synth_ops;
+
+    mm_synth_get_config("persist.camera.synth.sensor", value, "4160x3120");
+    if (sscanf(value, "%dx%d", &w, &h) != 2 || w < 176 || h < 144) {
+        w = 4160;
+        h = 3120;
+    }
+    obj->sensor_dim.width = w & ~1;
+    obj->sensor_dim.height = h & ~1;
+    obj->max_fps = (uint32_t)mm_synth_get_config_int("persist.camera.synth.fps", 30);
+    if (obj->max_fps < 1 || obj->max_fps > 240) {
+        obj->max_fps = 30;
+    }
+    obj->fps = obj->max_fps;
+    obj->fill = (uint8_t)(mm_synth_get_config_int("persist.camera.synth.fill", 1) != 0);
+
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&obj->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    pthread_cond_init(&obj->idle_cond, NULL);
+
+    if (pthread_create(&obj->frame_tid, NULL, mm_synth_frame_thread, obj) != 0) {
+        CDBG_ERROR("%s: cannot start frame thread", __func__);
+        pthread_cond_destroy(&obj->idle_cond);
+        pthread_cond_destroy(&obj->cond);
+        pthread_mutex_destroy(&obj->lock);
+        free(obj);
+        pthread_mutex_unlock(&g_synth_lock);
+        return NULL;
+    }
+    pthread_setname_np(obj->frame_tid, "CAM_synth");
+
+    g_synth_obj[camera_idx] = obj;
+    pthread_mutex_unlock(&g_synth_lock);
+    CDBG_HIGH("%s: camera %d %dx%d @ %u fps", __func__, camera_idx,
+            obj->sensor_dim.width, obj->sensor_dim.height, obj->max_fps);
+    return &obj->vtbl;
+}
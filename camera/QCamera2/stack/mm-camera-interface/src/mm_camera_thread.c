@@ -29,12 +29,15 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/prctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <fcntl.h>
-#include <poll.h>
+#include <cutils/properties.h>
 #include <cam_semaphore.h>
 
 #include "mm_camera_dbg.h"
@@ -54,22 +57,53 @@ typedef enum {
     MM_CAMERA_PIPE_CMD_MAX
 } mm_camera_pipe_cmd_type_t;
 
+#define MM_CAMERA_PIPE_CMD_BIT(cmd) (1U << (cmd))
+
 typedef enum {
     MM_CAMERA_POLL_TASK_STATE_STOPPED,
     MM_CAMERA_POLL_TASK_STATE_POLL,     /* polling pid in polling state. */
     MM_CAMERA_POLL_TASK_STATE_MAX
 } mm_camera_poll_task_state_type_t;
 
-typedef struct {
-    uint32_t cmd;
-    mm_camera_event_t event;
-} mm_camera_sig_evt_t;
+/* epoll data of the eventfd, poll entries use their index */
+#define MM_CAMERA_POLL_CMD_IDX MAX_STREAM_NUM_IN_BUNDLE
+#define MM_CAMERA_POLL_MAX_EVENTS (MAX_STREAM_NUM_IN_BUNDLE + 1)
 
+/*===========================================================================
+ * FUNCTION   : mm_camera_poll_kick
+ *
+ * DESCRIPTION: queue a command for the poll thread and wake it up through
+ *              the eventfd. Commands are kept as a bitmask, so several
+ *              updates posted before the thread runs are handled in one
+ *              pass. Must be called with poll_cb->mutex held.
+ *
+ * PARAMETERS :
+ *   @poll_cb      : ptr to poll thread object
+ *   @cmd          : command to be sent
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_camera_poll_kick(mm_camera_poll_thread_t *poll_cb,
+                                   uint32_t cmd)
+{
+    uint64_t kick = 1;
+
+    poll_cb->pending_cmds |= MM_CAMERA_PIPE_CMD_BIT(cmd);
+    ssize_t len = write(poll_cb->evt_fd, &kick, sizeof(kick));
+    if (len != (ssize_t)sizeof(kick)) {
+        CDBG_ERROR("%s: len = %lld, errno = %d", __func__,
+                (long long int)len, errno);
+        return -1;
+    }
+    return 0;
+}
 
 /*===========================================================================
  * FUNCTION   : mm_camera_poll_sig_async
  *
- * DESCRIPTION: Asynchoronous call to send a command through pipe.
+ * DESCRIPTION: Asynchoronous call to send a command to the poll thread.
  *
  * PARAMETERS :
  *   @poll_cb      : ptr to poll thread object
@@ -82,40 +116,22 @@ typedef struct {
 static int32_t mm_camera_poll_sig_async(mm_camera_poll_thread_t *poll_cb,
                                         uint32_t cmd)
 {
-    /* send through pipe */
-    /* get the mutex */
-    mm_camera_sig_evt_t cmd_evt;
-
     CDBG("%s: E cmd = %d", __func__,cmd);
-    memset(&cmd_evt, 0, sizeof(cmd_evt));
-    cmd_evt.cmd = cmd;
     pthread_mutex_lock(&poll_cb->mutex);
     /* reset the statue to false */
     poll_cb->status = FALSE;
 
     /* send cmd to worker */
-    ssize_t len = write(poll_cb->pfds[1], &cmd_evt, sizeof(cmd_evt));
-    if (len < 1) {
-        CDBG_ERROR("%s: len = %lld, errno = %d", __func__,
-                (long long int)len, errno);
-        /* Avoid waiting for the signal */
-        pthread_mutex_unlock(&poll_cb->mutex);
-        return 0;
-    }
-    CDBG("%s: begin IN mutex write done, len = %lld", __func__,
-            (long long int)len);
+    mm_camera_poll_kick(poll_cb, cmd);
     pthread_mutex_unlock(&poll_cb->mutex);
     CDBG("%s: X", __func__);
     return 0;
 }
 
-
-
-
 /*===========================================================================
  * FUNCTION   : mm_camera_poll_sig
  *
- * DESCRIPTION: synchorinzed call to send a command through pipe.
+ * DESCRIPTION: synchorinzed call to send a command to the poll thread.
  *
  * PARAMETERS :
  *   @poll_cb      : ptr to poll thread object
@@ -128,28 +144,16 @@ static int32_t mm_camera_poll_sig_async(mm_camera_poll_thread_t *poll_cb,
 static int32_t mm_camera_poll_sig(mm_camera_poll_thread_t *poll_cb,
                                   uint32_t cmd)
 {
-    /* send through pipe */
-    /* get the mutex */
-    mm_camera_sig_evt_t cmd_evt;
-
     CDBG("%s: E cmd = %d", __func__,cmd);
-    memset(&cmd_evt, 0, sizeof(cmd_evt));
-    cmd_evt.cmd = cmd;
     pthread_mutex_lock(&poll_cb->mutex);
     /* reset the statue to false */
     poll_cb->status = FALSE;
     /* send cmd to worker */
-
-    ssize_t len = write(poll_cb->pfds[1], &cmd_evt, sizeof(cmd_evt));
-    if(len < 1) {
-        CDBG_ERROR("%s: len = %lld, errno = %d", __func__,
-                (long long int)len, errno);
+    if (0 != mm_camera_poll_kick(poll_cb, cmd)) {
         /* Avoid waiting for the signal */
         pthread_mutex_unlock(&poll_cb->mutex);
         return 0;
     }
-    CDBG("%s: begin IN mutex write done, len = %lld", __func__,
-            (long long int)len);
     /* wait till worker task gives positive signal */
     if (FALSE == poll_cb->status) {
         CDBG("%s: wait", __func__);
@@ -175,7 +179,8 @@ static void mm_camera_poll_sig_done(mm_camera_poll_thread_t *poll_cb)
 {
     pthread_mutex_lock(&poll_cb->mutex);
     poll_cb->status = TRUE;
-    pthread_cond_signal(&poll_cb->cond_v);
+    /* coalesced commands may have more than one caller waiting */
+    pthread_cond_broadcast(&poll_cb->cond_v);
     CDBG("%s: done, in mutex", __func__);
     pthread_mutex_unlock(&poll_cb->mutex);
 }
@@ -198,72 +203,99 @@ static void mm_camera_poll_set_state(mm_camera_poll_thread_t *poll_cb,
 }
 
 /*===========================================================================
- * FUNCTION   : mm_camera_poll_proc_pipe
+ * FUNCTION   : mm_camera_poll_sync_entries
  *
- * DESCRIPTION: polling thread routine to process pipe
+ * DESCRIPTION: bring the epoll set in line with poll_entries. Only entries
+ *              whose fd changed since the last sync touch the kernel.
  *
  * PARAMETERS :
  *   @poll_cb : ptr to poll thread object
  *
  * RETURN     : none
  *==========================================================================*/
-static void mm_camera_poll_proc_pipe(mm_camera_poll_thread_t *poll_cb)
+static void mm_camera_poll_sync_entries(mm_camera_poll_thread_t *poll_cb)
 {
-    ssize_t read_len;
-    int i;
-    mm_camera_sig_evt_t cmd_evt;
-    read_len = read(poll_cb->pfds[0], &cmd_evt, sizeof(cmd_evt));
-    CDBG("%s: read_fd = %d, read_len = %d, expect_len = %d cmd = %d",
-         __func__, poll_cb->pfds[0], (int)read_len, (int)sizeof(cmd_evt), cmd_evt.cmd);
-    switch (cmd_evt.cmd) {
-    case MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED:
-    case MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC:
-        /* we always have index 0 for pipe read */
-        poll_cb->num_fds = 0;
-        poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->pfds[0];
-        poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-        poll_cb->num_fds++;
-
-        if (MM_CAMERA_POLL_TYPE_EVT == poll_cb->poll_type) {
-            if (poll_cb->poll_entries[0].fd > 0) {
-                /* fd is valid, we update poll_fds */
-                poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->poll_entries[0].fd;
-                poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-                poll_cb->num_fds++;
-            }
-        } else if (MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) {
-            for(i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
-                if(poll_cb->poll_entries[i].fd > 0) {
-                    /* fd is valid, we update poll_fds to this fd */
-                    poll_cb->poll_fds[poll_cb->num_fds].fd = poll_cb->poll_entries[i].fd;
-                    poll_cb->poll_fds[poll_cb->num_fds].events = POLLIN|POLLRDNORM|POLLPRI;
-                    poll_cb->num_fds++;
-                } else {
-                    /* fd is invalid, we set the entry to -1 to prevent polling.
-                     * According to spec, polling will not poll on entry with fd=-1.
-                     * If this is not the case, we need to skip these invalid fds
-                     * when updating this array.
-                     * We still keep fd=-1 in this array because this makes easier to
-                     * map cb associated with this fd once incoming data avail by directly
-                     * using the index-1(0 is reserved for pipe read, so need to reduce index by 1) */
-                    poll_cb->poll_fds[poll_cb->num_fds].fd = -1;
-                    poll_cb->poll_fds[poll_cb->num_fds].events = 0;
-                    poll_cb->num_fds++;
-                }
+    struct epoll_event ev;
+    uint32_t i, num_entries;
+    int32_t fd;
+
+    /* for MM_CAMERA_POLL_TYPE_EVT only index 0 is valid */
+    num_entries = (MM_CAMERA_POLL_TYPE_EVT == poll_cb->poll_type) ?
+            1 : MAX_STREAM_NUM_IN_BUNDLE;
+
+    /* remove stale fds first, a closed fd number may come back in
+     * another entry within the same update */
+    for (i = 0; i < num_entries; i++) {
+        fd = poll_cb->poll_entries[i].fd;
+        if ((poll_cb->epoll_reg_fds[i] >= 0) &&
+            (poll_cb->epoll_reg_fds[i] != fd)) {
+            memset(&ev, 0, sizeof(ev));
+            /* fails with ENOENT if the fd was closed already, harmless */
+            epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_DEL,
+                    poll_cb->epoll_reg_fds[i], &ev);
+            poll_cb->stats.syscalls++;
+            poll_cb->epoll_reg_fds[i] = -1;
+        }
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        fd = poll_cb->poll_entries[i].fd;
+        if ((fd > 0) && (poll_cb->epoll_reg_fds[i] != fd)) {
+            memset(&ev, 0, sizeof(ev));
+            /* level triggered: anything left unread is reported again */
+            ev.events = EPOLLIN | EPOLLRDNORM | EPOLLPRI;
+            ev.data.u32 = i;
+            poll_cb->stats.syscalls++;
+            if (0 != epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+                CDBG_ERROR("%s: epoll add fd %d (entry %d) failed: %s",
+                        __func__, fd, i, strerror(errno));
+                continue;
             }
+            poll_cb->epoll_reg_fds[i] = fd;
         }
-        if (cmd_evt.cmd != MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC)
-            mm_camera_poll_sig_done(poll_cb);
-        break;
+    }
+}
 
-    case MM_CAMERA_PIPE_CMD_COMMIT:
-        mm_camera_poll_sig_done(poll_cb);
-        break;
-    case MM_CAMERA_PIPE_CMD_EXIT:
-    default:
+/*===========================================================================
+ * FUNCTION   : mm_camera_poll_proc_cmds
+ *
+ * DESCRIPTION: polling thread routine to process pending commands
+ *
+ * PARAMETERS :
+ *   @poll_cb : ptr to poll thread object
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_camera_poll_proc_cmds(mm_camera_poll_thread_t *poll_cb)
+{
+    ssize_t read_len;
+    uint64_t kicks = 0;
+    uint32_t cmds;
+
+    /* clear the eventfd before taking the commands: a kick landing after
+     * this read makes the next wait return and is never lost */
+    read_len = read(poll_cb->evt_fd, &kicks, sizeof(kicks));
+    poll_cb->stats.syscalls++;
+    pthread_mutex_lock(&poll_cb->mutex);
+    cmds = poll_cb->pending_cmds;
+    poll_cb->pending_cmds = 0;
+    pthread_mutex_unlock(&poll_cb->mutex);
+    CDBG("%s: evt_fd = %d, read_len = %d, kicks = %llu, cmds = 0x%x",
+         __func__, poll_cb->evt_fd, (int)read_len,
+         (unsigned long long)kicks, cmds);
+
+    if (cmds & (MM_CAMERA_PIPE_CMD_BIT(MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED) |
+            MM_CAMERA_PIPE_CMD_BIT(MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED_ASYNC))) {
+        mm_camera_poll_sync_entries(poll_cb);
+    }
+
+    if (cmds & MM_CAMERA_PIPE_CMD_BIT(MM_CAMERA_PIPE_CMD_EXIT)) {
         mm_camera_poll_set_state(poll_cb, MM_CAMERA_POLL_TASK_STATE_STOPPED);
         mm_camera_poll_sig_done(poll_cb);
-        break;
+    } else if (cmds &
+            (MM_CAMERA_PIPE_CMD_BIT(MM_CAMERA_PIPE_CMD_POLL_ENTRIES_UPDATED) |
+            MM_CAMERA_PIPE_CMD_BIT(MM_CAMERA_PIPE_CMD_COMMIT))) {
+        mm_camera_poll_sig_done(poll_cb);
     }
 }
 
@@ -279,42 +311,56 @@ static void mm_camera_poll_proc_pipe(mm_camera_poll_thread_t *poll_cb)
  *==========================================================================*/
 static void *mm_camera_poll_fn(mm_camera_poll_thread_t *poll_cb)
 {
+    struct epoll_event events[MM_CAMERA_POLL_MAX_EVENTS];
+    mm_camera_poll_entry_t *entry;
     int rc = 0, i;
+    uint32_t idx;
+
     if (poll_cb == NULL) {
         CDBG_ERROR("%s: error: poll_cb=%p",__func__,poll_cb);
         return NULL;
     }
-    CDBG("%s: poll type = %d, num_fd = %d poll_cb = %p\n",
-         __func__, poll_cb->poll_type, poll_cb->num_fds,poll_cb);
+    CDBG("%s: poll type = %d, epoll fd = %d poll_cb = %p\n",
+         __func__, poll_cb->poll_type, poll_cb->epoll_fd, poll_cb);
     do {
-         for(i = 0; i < poll_cb->num_fds; i++) {
-            poll_cb->poll_fds[i].events = POLLIN|POLLRDNORM|POLLPRI;
-         }
-
-         rc = poll(poll_cb->poll_fds, poll_cb->num_fds, poll_cb->timeoutms);
-         if(rc > 0) {
-            if ((poll_cb->poll_fds[0].revents & POLLIN) &&
-                (poll_cb->poll_fds[0].revents & POLLRDNORM)) {
-                /* if we have data on pipe, we only process pipe in this iteration */
-                CDBG("%s: cmd received on pipe\n", __func__);
-                mm_camera_poll_proc_pipe(poll_cb);
+        rc = epoll_wait(poll_cb->epoll_fd, events, MM_CAMERA_POLL_MAX_EVENTS,
+                poll_cb->timeoutms);
+        poll_cb->stats.syscalls++;
+        if (rc > 0) {
+            poll_cb->stats.wakeups++;
+            for (i = 0; i < rc; i++) {
+                if (MM_CAMERA_POLL_CMD_IDX == events[i].data.u32) {
+                    break;
+                }
+            }
+            if (i < rc) {
+                /* if we have a cmd pending, we only process cmds in this
+                 * iteration, ready fds are reported again by the next wait */
+                CDBG("%s: cmd received on eventfd\n", __func__);
+                poll_cb->stats.cmd_wakeups++;
+                mm_camera_poll_proc_cmds(poll_cb);
             } else {
-                for(i=1; i<poll_cb->num_fds; i++) {
+                for (i = 0; i < rc; i++) {
+                    idx = events[i].data.u32;
+                    if (idx >= MAX_STREAM_NUM_IN_BUNDLE) {
+                        continue;
+                    }
+                    entry = &poll_cb->poll_entries[idx];
                     /* Checking for ctrl events */
                     if ((poll_cb->poll_type == MM_CAMERA_POLL_TYPE_EVT) &&
-                        (poll_cb->poll_fds[i].revents & POLLPRI)) {
+                        (events[i].events & EPOLLPRI)) {
                         CDBG("%s: mm_camera_evt_notify\n", __func__);
-                        if (NULL != poll_cb->poll_entries[i-1].notify_cb) {
-                            poll_cb->poll_entries[i-1].notify_cb(poll_cb->poll_entries[i-1].user_data);
+                        if (NULL != entry->notify_cb) {
+                            entry->notify_cb(entry->user_data);
                         }
                     }
 
                     if ((MM_CAMERA_POLL_TYPE_DATA == poll_cb->poll_type) &&
-                        (poll_cb->poll_fds[i].revents & POLLIN) &&
-                        (poll_cb->poll_fds[i].revents & POLLRDNORM)) {
+                        (events[i].events & EPOLLIN) &&
+                        (events[i].events & EPOLLRDNORM)) {
                         CDBG("%s: mm_stream_data_notify\n", __func__);
-                        if (NULL != poll_cb->poll_entries[i-1].notify_cb) {
-                            poll_cb->poll_entries[i-1].notify_cb(poll_cb->poll_entries[i-1].user_data);
+                        if (NULL != entry->notify_cb) {
+                            entry->notify_cb(entry->user_data);
                         }
                     }
                 }
@@ -343,9 +389,6 @@ static void *mm_camera_poll_thread(void *data)
     prctl(PR_SET_NAME, (unsigned long)"mm_cam_poll_th", 0, 0, 0);
     mm_camera_poll_thread_t *poll_cb = (mm_camera_poll_thread_t *)data;
 
-    /* add pipe read fd into poll first */
-    poll_cb->poll_fds[poll_cb->num_fds++].fd = poll_cb->pfds[0];
-
     mm_camera_poll_sig_done(poll_cb);
     mm_camera_poll_set_state(poll_cb, MM_CAMERA_POLL_TASK_STATE_POLL);
     return mm_camera_poll_fn(poll_cb);
@@ -496,21 +539,52 @@ int32_t mm_camera_poll_thread_launch(mm_camera_poll_thread_t * poll_cb,
                                      mm_camera_poll_thread_type_t poll_type)
 {
     int32_t rc = 0;
+    uint32_t i;
+    struct epoll_event ev;
+    char value[PROPERTY_VALUE_MAX];
+
     poll_cb->poll_type = poll_type;
+    poll_cb->pending_cmds = 0;
+    for (i = 0; i < MAX_STREAM_NUM_IN_BUNDLE; i++) {
+        poll_cb->epoll_reg_fds[i] = -1;
+    }
+    memset(&poll_cb->stats, 0, sizeof(poll_cb->stats));
+
+    /* buffers a stream may dequeue per wakeup, 1 gives one per wakeup */
+    property_get("persist.camera.poll.drain", value, "0");
+    poll_cb->drain_budget = (uint32_t)atoi(value);
+    if (0 == poll_cb->drain_budget) {
+        poll_cb->drain_budget = MM_CAMERA_POLL_DRAIN_BUDGET;
+    }
 
-    poll_cb->pfds[0] = 0;
-    poll_cb->pfds[1] = 0;
-    rc = pipe(poll_cb->pfds);
-    if(rc < 0) {
-        CDBG_ERROR("%s: pipe open rc=%d\n", __func__, rc);
+    poll_cb->epoll_fd = epoll_create(MM_CAMERA_POLL_MAX_EVENTS);
+    if (poll_cb->epoll_fd < 0) {
+        CDBG_ERROR("%s: epoll_create failed: %s\n", __func__, strerror(errno));
+        return -1;
+    }
+    poll_cb->evt_fd = eventfd(0, EFD_NONBLOCK);
+    if (poll_cb->evt_fd < 0) {
+        CDBG_ERROR("%s: eventfd failed: %s\n", __func__, strerror(errno));
+        close(poll_cb->epoll_fd);
+        return -1;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = MM_CAMERA_POLL_CMD_IDX;
+    rc = epoll_ctl(poll_cb->epoll_fd, EPOLL_CTL_ADD, poll_cb->evt_fd, &ev);
+    if (rc < 0) {
+        CDBG_ERROR("%s: epoll add eventfd failed: %s\n", __func__,
+                strerror(errno));
+        close(poll_cb->evt_fd);
+        close(poll_cb->epoll_fd);
         return -1;
     }
 
     poll_cb->timeoutms = -1;  /* Infinite seconds */
 
-    CDBG("%s: poll_type = %d, read fd = %d, write fd = %d timeout = %d",
-        __func__, poll_cb->poll_type,
-        poll_cb->pfds[0], poll_cb->pfds[1],poll_cb->timeoutms);
+    CDBG("%s: poll_type = %d, epoll fd = %d, event fd = %d timeout = %d, drain %d",
+        __func__, poll_cb->poll_type, poll_cb->epoll_fd, poll_cb->evt_fd,
+        poll_cb->timeoutms, poll_cb->drain_budget);
 
     pthread_mutex_init(&poll_cb->mutex, NULL);
     pthread_cond_init(&poll_cb->cond_v, NULL);
@@ -547,12 +621,23 @@ int32_t mm_camera_poll_thread_release(mm_camera_poll_thread_t *poll_cb)
         CDBG_ERROR("%s: pthread dead already\n", __func__);
     }
 
-    /* close pipe */
-    if(poll_cb->pfds[0]) {
-        close(poll_cb->pfds[0]);
+    if (poll_cb->stats.frames > 0) {
+        CDBG_HIGH("%s: poll type %d: wakeups %u (cmd %u), frames %u, dqbuf %u "
+                "(empty %u), budget hits %u, %u.%02u syscalls/frame", __func__,
+                poll_cb->poll_type, poll_cb->stats.wakeups,
+                poll_cb->stats.cmd_wakeups, poll_cb->stats.frames,
+                poll_cb->stats.dq_calls, poll_cb->stats.dq_empty,
+                poll_cb->stats.budget_hits,
+                poll_cb->stats.syscalls / poll_cb->stats.frames,
+                poll_cb->stats.syscalls * 100 / poll_cb->stats.frames % 100);
+    }
+
+    /* close epoll and eventfd */
+    if (poll_cb->evt_fd > 0) {
+        close(poll_cb->evt_fd);
     }
-    if(poll_cb->pfds[1]) {
-        close(poll_cb->pfds[1]);
+    if (poll_cb->epoll_fd > 0) {
+        close(poll_cb->epoll_fd);
     }
 
     pthread_mutex_destroy(&poll_cb->mutex);
@@ -0,0 +1,531 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <cutils/properties.h>
+
+#include "cam_types.h"
+#include "cam_trace.h"
+#include "mm_camera_dbg.h"
+
+#define CAM_TRACE_RING_SIZE     2048    /* records per thread, power of 2 */
+#define CAM_TRACE_HIST_BUCKETS  20      /* log2 buckets, 1us to 0.5s */
+#define CAM_TRACE_MATCH_SIZE    1024    /* start times kept for matching */
+#define CAM_TRACE_JOB_KEY       0xFFFFFFFF
+
+typedef struct {
+    int64_t ts_ns;
+    uint32_t stream_id;
+    uint32_t frame_idx;
+    uint32_t id;
+    uint16_t point;
+    uint16_t stream_type;
+    int32_t tid;
+    uint32_t reserved;
+} cam_trace_rec_t;
+
+/* Written only by its owner thread. head counts all records ever written,
+ * the reader drops records the writer may have overwritten meanwhile. */
+typedef struct cam_trace_ring {
+    struct cam_trace_ring *next;
+    int in_use;
+    int32_t tid;
+    uint32_t head;
+    cam_trace_rec_t rec[CAM_TRACE_RING_SIZE];
+} cam_trace_ring_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t buckets[CAM_TRACE_HIST_BUCKETS];
+    int64_t sum_us;
+    int64_t max_us;
+} cam_trace_hist_t;
+
+typedef struct {
+    uint64_t key;
+    int64_t ts_ns;
+} cam_trace_match_t;
+
+volatile int g_cam_trace_enabled = 0;
+
+static cam_trace_ring_t *g_trace_rings = NULL;
+static pthread_mutex_t g_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t g_trace_key;
+static pthread_once_t g_trace_once = PTHREAD_ONCE_INIT;
+
+static const char *cam_trace_point_names[CAM_TRACE_POINT_MAX] = {
+    "rcvd_buf",
+    "data_notify",
+    "data_proc",
+    "stream_cb",
+    "deliver",
+    "buf_done",
+    "reprocess",
+    "jpeg_start",
+    "jpeg_done",
+    "save",
+};
+
+static const char *cam_trace_stream_names[CAM_STREAM_TYPE_MAX] = {
+    "default",
+    "preview",
+    "postview",
+    "snapshot",
+    "video",
+    "impl_defined",
+    "yuv",
+    "metadata",
+    "raw",
+    "offline_proc",
+};
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_release_ring
+ *
+ * DESCRIPTION: thread exit handler, lets another thread reuse the ring
+ *
+ * PARAMETERS :
+ *   @data    : ring of the exiting thread
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void cam_trace_release_ring(void *data)
+{
+    cam_trace_ring_t *ring = (cam_trace_ring_t *)data;
+
+    __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void cam_trace_make_key(void)
+{
+    pthread_key_create(&g_trace_key, cam_trace_release_ring);
+}
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_get_ring
+ *
+ * DESCRIPTION: get the ring of the calling thread, takes the lock only the
+ *              first time a thread records
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : ring ptr, NULL if out of memory
+ *==========================================================================*/
+static cam_trace_ring_t *cam_trace_get_ring(void)
+{
+    cam_trace_ring_t *ring;
+
+    pthread_once(&g_trace_once, cam_trace_make_key);
+    ring = (cam_trace_ring_t *)pthread_getspecific(g_trace_key);
+    if (NULL != ring) {
+        return ring;
+    }
+
+    pthread_mutex_lock(&g_trace_lock);
+    for (ring = g_trace_rings; NULL != ring; ring = ring->next) {
+        if (!__atomic_load_n(&ring->in_use, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    if (NULL == ring) {
+        ring = (cam_trace_ring_t *)calloc(1, sizeof(cam_trace_ring_t));
+        if (NULL == ring) {
+            pthread_mutex_unlock(&g_trace_lock);
+            CDBG_ERROR("%s: No memory for trace ring", __func__);
+            return NULL;
+        }
+        ring->next = g_trace_rings;
+        g_trace_rings = ring;
+    }
+    ring->in_use = 1;
+    ring->tid = (int32_t)syscall(SYS_gettid);
+    pthread_mutex_unlock(&g_trace_lock);
+
+    pthread_setspecific(g_trace_key, ring);
+    return ring;
+}
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_refresh
+ *
+ * DESCRIPTION: read persist.camera.trace to switch tracing on or off
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void cam_trace_refresh(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get("persist.camera.trace", value, "0");
+    g_cam_trace_enabled = atoi(value) > 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_record
+ *
+ * DESCRIPTION: add a record to the ring of the calling thread
+ *
+ * PARAMETERS :
+ *   @point       : pipeline stage
+ *   @stream_id   : stream handle
+ *   @stream_type : stream type
+ *   @frame_idx   : frame index, 0 if unknown
+ *   @id          : buffer index, or jpeg job id for jpeg stages
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void cam_trace_record(cam_trace_point_t point, uint32_t stream_id,
+        uint32_t stream_type, uint32_t frame_idx, uint32_t id)
+{
+    cam_trace_ring_t *ring = cam_trace_get_ring();
+    struct timespec ts;
+
+    if (NULL == ring) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint32_t head = ring->head;
+    cam_trace_rec_t *rec = &ring->rec[head & (CAM_TRACE_RING_SIZE - 1)];
+    rec->ts_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    rec->stream_id = stream_id;
+    rec->frame_idx = frame_idx;
+    rec->id = id;
+    rec->point = (uint16_t)point;
+    rec->stream_type = (uint16_t)stream_type;
+    rec->tid = ring->tid;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static int cam_trace_cmp(const void *a, const void *b)
+{
+    const cam_trace_rec_t *ra = (const cam_trace_rec_t *)a;
+    const cam_trace_rec_t *rb = (const cam_trace_rec_t *)b;
+
+    if (ra->ts_ns < rb->ts_ns) {
+        return -1;
+    }
+    return ra->ts_ns > rb->ts_ns ? 1 : 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_snapshot
+ *
+ * DESCRIPTION: copy the records of all rings, sorted by time
+ *
+ * PARAMETERS :
+ *   @out     : filled with a malloc'ed array, to be freed by the caller
+ *
+ * RETURN     : number of records
+ *==========================================================================*/
+static uint32_t cam_trace_snapshot(cam_trace_rec_t **out)
+{
+    cam_trace_ring_t *ring;
+    cam_trace_rec_t *recs;
+    uint32_t rings = 0;
+    uint32_t count = 0;
+
+    *out = NULL;
+    pthread_mutex_lock(&g_trace_lock);
+    for (ring = g_trace_rings; NULL != ring; ring = ring->next) {
+        rings++;
+    }
+    recs = (cam_trace_rec_t *)malloc(
+            (size_t)rings * CAM_TRACE_RING_SIZE * sizeof(cam_trace_rec_t));
+    if (NULL == recs) {
+        pthread_mutex_unlock(&g_trace_lock);
+        return 0;
+    }
+
+    for (ring = g_trace_rings; NULL != ring; ring = ring->next) {
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint32_t start = head > CAM_TRACE_RING_SIZE ?
+                head - CAM_TRACE_RING_SIZE : 0;
+        uint32_t first = count;
+        uint32_t i;
+
+        for (i = start; i != head; i++) {
+            recs[count++] = ring->rec[i & (CAM_TRACE_RING_SIZE - 1)];
+        }
+
+        /* drop what the writer may have overwritten while copying,
+         * including the slot it may be writing right now */
+        uint32_t now = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (now - start >= CAM_TRACE_RING_SIZE) {
+            uint32_t torn = now - start - CAM_TRACE_RING_SIZE + 1;
+            if (torn > head - start) {
+                torn = head - start;
+            }
+            memmove(&recs[first], &recs[first + torn],
+                    (count - first - torn) * sizeof(cam_trace_rec_t));
+            count -= torn;
+        }
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+
+    qsort(recs, count, sizeof(cam_trace_rec_t), cam_trace_cmp);
+    *out = recs;
+    return count;
+}
+
+static void cam_trace_fdprintf(int fd, const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len > 0) {
+        if (len >= (int)sizeof(buf)) {
+            len = sizeof(buf) - 1;
+        }
+        if (write(fd, buf, (size_t)len) < 0) {
+            CDBG_ERROR("%s: write failed", __func__);
+        }
+    }
+}
+
+static uint64_t cam_trace_key(const cam_trace_rec_t *rec)
+{
+    switch (rec->point) {
+    case CAM_TRACE_JPEG_START:
+    case CAM_TRACE_JPEG_DONE:
+    case CAM_TRACE_SAVE:
+        return ((uint64_t)CAM_TRACE_JOB_KEY << 32) | rec->id;
+    default:
+        return ((uint64_t)rec->stream_id << 32) | rec->id;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_write_json
+ *
+ * DESCRIPTION: write records as Chrome trace events. Every buffer is an
+ *              async slice from rcvd_buf to buf_done with the stages in
+ *              between as instant events, jpeg jobs likewise.
+ *
+ * PARAMETERS :
+ *   @path    : output file
+ *   @recs    : records sorted by time
+ *   @count   : number of records
+ *
+ * RETURN     : 0 on success, -1 on failure
+ *==========================================================================*/
+static int cam_trace_write_json(const char *path, const cam_trace_rec_t *recs,
+        uint32_t count)
+{
+    FILE *fp = fopen(path, "w");
+    int pid = (int)getpid();
+    uint32_t i;
+
+    if (NULL == fp) {
+        CDBG_ERROR("%s: Cannot open %s", __func__, path);
+        return -1;
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (i = 0; i < count; i++) {
+        const cam_trace_rec_t *rec = &recs[i];
+        const char *cat = rec->stream_type < CAM_STREAM_TYPE_MAX ?
+                cam_trace_stream_names[rec->stream_type] : "unknown";
+        const char *name = "frame";
+        const char *ph = "n";
+
+        switch (rec->point) {
+        case CAM_TRACE_RCVD_BUF:
+            ph = "b";
+            break;
+        case CAM_TRACE_BUF_DONE:
+            ph = "e";
+            break;
+        case CAM_TRACE_JPEG_START:
+            ph = "b";
+            name = "jpeg";
+            cat = "jpeg";
+            break;
+        case CAM_TRACE_JPEG_DONE:
+            ph = "e";
+            name = "jpeg";
+            cat = "jpeg";
+            break;
+        case CAM_TRACE_SAVE:
+            cat = "jpeg";
+            name = cam_trace_point_names[rec->point];
+            break;
+        default:
+            name = cam_trace_point_names[rec->point];
+            break;
+        }
+
+        fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\","
+                "\"id\":\"%llx\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                "\"args\":{\"stage\":\"%s\",\"frame\":%u,\"id\":%u}}\n",
+                i ? "," : "", name, cat, ph,
+                (unsigned long long)cam_trace_key(rec), pid, rec->tid,
+                (double)rec->ts_ns / 1000.0,
+                cam_trace_point_names[rec->point], rec->frame_idx, rec->id);
+    }
+    fprintf(fp, "]}\n");
+    fclose(fp);
+    return 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_print_hist
+ *
+ * DESCRIPTION: print latency of every stage relative to the start of its
+ *              buffer (rcvd_buf) or jpeg job (jpeg_start), per stream type
+ *
+ * PARAMETERS :
+ *   @fd      : output fd
+ *   @recs    : records sorted by time
+ *   @count   : number of records
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void cam_trace_print_hist(int fd, const cam_trace_rec_t *recs,
+        uint32_t count)
+{
+    cam_trace_hist_t *hist;
+    cam_trace_match_t *match;
+    uint32_t i, t, p, b;
+
+    hist = (cam_trace_hist_t *)calloc(CAM_STREAM_TYPE_MAX * CAM_TRACE_POINT_MAX,
+            sizeof(cam_trace_hist_t));
+    match = (cam_trace_match_t *)calloc(CAM_TRACE_MATCH_SIZE,
+            sizeof(cam_trace_match_t));
+    if (NULL == hist || NULL == match) {
+        free(hist);
+        free(match);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        const cam_trace_rec_t *rec = &recs[i];
+        uint64_t key = cam_trace_key(rec);
+        cam_trace_match_t *m =
+                &match[(key ^ (key >> 29)) & (CAM_TRACE_MATCH_SIZE - 1)];
+
+        if (rec->stream_type >= CAM_STREAM_TYPE_MAX) {
+            continue;
+        }
+        if (CAM_TRACE_RCVD_BUF == rec->point ||
+                CAM_TRACE_JPEG_START == rec->point) {
+            m->key = key;
+            m->ts_ns = rec->ts_ns;
+            continue;
+        }
+        if (m->key != key || 0 == m->ts_ns) {
+            continue;
+        }
+
+        int64_t us = (rec->ts_ns - m->ts_ns) / 1000;
+        cam_trace_hist_t *h =
+                &hist[rec->stream_type * CAM_TRACE_POINT_MAX + rec->point];
+        b = 0;
+        while (b < CAM_TRACE_HIST_BUCKETS - 1 && (1LL << b) <= us) {
+            b++;
+        }
+        h->buckets[b]++;
+        h->count++;
+        h->sum_us += us;
+        if (us > h->max_us) {
+            h->max_us = us;
+        }
+    }
+
+    cam_trace_fdprintf(fd, "Camera trace: %u records, latency from rcvd_buf "
+            "(jpeg: from jpeg_start) in us\n", count);
+    for (t = 0; t < CAM_STREAM_TYPE_MAX; t++) {
+        for (p = 0; p < CAM_TRACE_POINT_MAX; p++) {
+            cam_trace_hist_t *h = &hist[t * CAM_TRACE_POINT_MAX + p];
+            if (0 == h->count) {
+                continue;
+            }
+            cam_trace_fdprintf(fd, "  %s %s: n=%u avg=%lld max=%lld\n   ",
+                    cam_trace_stream_names[t], cam_trace_point_names[p],
+                    h->count, (long long)(h->sum_us / h->count),
+                    (long long)h->max_us);
+            for (b = 0; b < CAM_TRACE_HIST_BUCKETS; b++) {
+                if (h->buckets[b]) {
+                    cam_trace_fdprintf(fd, " <%lld:%u", 1LL << b,
+                            h->buckets[b]);
+                }
+            }
+            cam_trace_fdprintf(fd, "\n");
+        }
+    }
+
+    free(hist);
+    free(match);
+}
+
+/*===========================================================================
+ * FUNCTION   : cam_trace_dump
+ *
+ * DESCRIPTION: export the records of all threads
+ *
+ * PARAMETERS :
+ *   @fd        : fd to print latency histograms to, -1 to skip
+ *   @json_path : Chrome trace file to write, NULL to skip
+ *
+ * RETURN     : number of records, negative on failure
+ *==========================================================================*/
+int cam_trace_dump(int fd, const char *json_path)
+{
+    cam_trace_rec_t *recs = NULL;
+    uint32_t count = cam_trace_snapshot(&recs);
+    int rc = (int)count;
+
+    if (NULL == recs) {
+        return -1;
+    }
+
+    if (fd >= 0) {
+        cam_trace_print_hist(fd, recs, count);
+    }
+    if (NULL != json_path && cam_trace_write_json(json_path, recs, count)) {
+        rc = -1;
+    }
+
+    free(recs);
+    return rc;
+}
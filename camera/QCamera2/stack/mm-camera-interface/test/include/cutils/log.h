@@ -0,0 +1,73 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __HOST_CUTILS_LOG_H__
+#define __HOST_CUTILS_LOG_H__
+
+/* Host stand-in for liblog. Messages go to stderr, one line each, in the
+ * logcat brief format. Verbose is compiled out.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef LOG_TAG
+#define LOG_TAG NULL
+#endif
+
+static inline void __attribute__((format(printf, 3, 4)))
+__host_log(char prio, const char *tag, const char *fmt, ...)
+{
+    char buf[1024];
+    va_list ap;
+    size_t len;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    len = strlen(buf);
+    while (len && (buf[len - 1] == '\n'))
+        buf[--len] = '\0';
+    fprintf(stderr, "%c/%s: %s\n", prio, tag ? tag : "", buf);
+}
+
+#define ALOGE(...)              __host_log('E', LOG_TAG, __VA_ARGS__)
+#define ALOGW(...)              __host_log('W', LOG_TAG, __VA_ARGS__)
+#define ALOGI(...)              __host_log('I', LOG_TAG, __VA_ARGS__)
+#define ALOGD(...)              __host_log('D', LOG_TAG, __VA_ARGS__)
+#define ALOGV(...)              ((void)0)
+
+#define ALOGE_IF(cond, ...)     ((cond) ? (void)ALOGE(__VA_ARGS__) : (void)0)
+#define ALOGW_IF(cond, ...)     ((cond) ? (void)ALOGW(__VA_ARGS__) : (void)0)
+#define ALOGI_IF(cond, ...)     ((cond) ? (void)ALOGI(__VA_ARGS__) : (void)0)
+#define ALOGD_IF(cond, ...)     ((cond) ? (void)ALOGD(__VA_ARGS__) : (void)0)
+
+#endif /* __HOST_CUTILS_LOG_H__ */
@@ -0,0 +1,62 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __HOST_CUTILS_PROPERTIES_H__
+#define __HOST_CUTILS_PROPERTIES_H__
+
+/* Host stand-in for the Android properties. A property reads from the
+ * environment variable of the same name, e.g.
+ *    env persist.camera.synth.fps=60 ./mm_camera_synth_test
+ * and falls back to its default value. Setting one is a no-op.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PROPERTY_KEY_MAX    32
+#define PROPERTY_VALUE_MAX    92
+
+static inline int property_get(const char *key, char *value, const char *default_value)
+{
+    const char *env = getenv(key);
+
+    if (env == NULL)
+        env = default_value ? default_value : "";
+    strlcpy(value, env, PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+static inline int property_set(const char *key, const char *value)
+{
+    (void)key;
+    (void)value;
+    return 0;
+}
+
+#endif /* __HOST_CUTILS_PROPERTIES_H__ */
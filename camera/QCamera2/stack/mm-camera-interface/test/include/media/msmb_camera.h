@@ -0,0 +1,85 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __HOST_MEDIA_MSMB_CAMERA_H__
+#define __HOST_MEDIA_MSMB_CAMERA_H__
+
+/* Host stand-in for the msm camera uapi. The values only need to be
+ * self-consistent: on the host the synthetic backend never hands them to a
+ * kernel.
+ */
+
+#include <linux/videodev2.h>
+#include <linux/media.h>
+#include <linux/ioctl.h>
+
+#define MSM_CAMERA_NAME                 "msm_camera"
+#define MSM_CONFIGURATION_NAME          "msm_config"
+
+#define MSM_CAMERA_SUBDEV_SENSOR        1
+#define MSM_CAMERA_SUBDEV_SENSOR_INIT   14
+
+#define MSM_MAX_CAMERA_SENSORS          5
+
+#define QCAMERA_VNODE_GROUP_ID          2
+
+#define MSM_CAMERA_V4L2_EVENT_TYPE      (V4L2_EVENT_PRIVATE_START + 0x00002000)
+#define MSM_CAMERA_PRIV_SHUTDOWN        10
+#define MSM_CAMERA_MSM_NOTIFY           16
+
+#define MSM_CAMERA_STATUS_SUCCESS       0
+#define MSM_CAMERA_STATUS_FAIL          1
+
+#define V4L2_PIX_FMT_NV14               v4l2_fourcc('N', 'V', '1', '4')
+#define V4L2_PIX_FMT_NV41               v4l2_fourcc('N', 'V', '4', '1')
+
+struct msm_v4l2_event_data {
+    unsigned int command;
+    unsigned int status;
+    unsigned int session_id;
+    unsigned int stream_id;
+    unsigned int map_op;
+    unsigned int map_buf_idx;
+    unsigned int notify;
+    unsigned int arg_value;
+    unsigned int ret_value;
+    unsigned int v4l2_event_type;
+    unsigned int v4l2_event_id;
+};
+
+struct msm_v4l2_format_data {
+    enum v4l2_buf_type type;
+    unsigned int width;
+    unsigned int height;
+    unsigned int pixelformat;
+    unsigned char num_planes;
+    unsigned int plane_sizes[VIDEO_MAX_PLANES];
+};
+
+#endif /* __HOST_MEDIA_MSMB_CAMERA_H__ */
@@ -0,0 +1,598 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Host check of the synthetic backend, libmmcamera_interface_synth, driven
+ * through the mm-camera-interface vtbl the way the HAL drives it:
+ *   - frame generation: continuous preview + metadata bundles, frame
+ *     order, the painted test pattern, crop and auto focus metadata
+ *   - buffer return: a HAL that holds every buffer starves the stream,
+ *     qbuf brings it back, put_bufs runs once per stream on stop
+ *   - request_super_buf: a burst channel with a linked metadata stream
+ *     delivers exactly the requested bundles, matched by frame index
+ *   - the ashmem backed ion emulation
+ *
+ *   make -C camera/QCamera2/stack/mm-camera-interface/test check
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/ashmem.h>
+
+#include "mm_camera_interface.h"
+#include "mm_camera_synth.h"
+
+#define ERROR(format, ...) printf( \
+    "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define TEST_NUM_BUFS       6
+#define TEST_WIDTH          640
+#define TEST_HEIGHT         480
+#define TEST_TIMEOUT_MS     2000
+
+typedef struct {
+    cam_stream_info_t info;
+    uint32_t stream_id;
+    uint8_t *mem;
+    size_t buf_len;
+    int get_calls;
+    int put_calls;
+} test_stream_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    mm_camera_vtbl_t *cam;
+
+    /* preview channel */
+    uint32_t prev_frames;
+    uint32_t prev_last_idx;
+    uint32_t meta_crop_streams;
+    uint32_t af_done;
+    uint32_t errors;
+    int hold;                         /* keep buffers instead of qbuf */
+    mm_camera_buf_def_t *held[TEST_NUM_BUFS];
+    int held_cnt;
+
+    /* zsl channel */
+    uint32_t zsl_frames;
+    uint32_t zsl_first_idx;
+    uint32_t zsl_last_idx;
+} test_ctx_t;
+
+static test_ctx_t g_ctx = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL,
+    0, 0, 0, 0, 0, 0, { NULL }, 0, 0, 0, 0
+};
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* Wait until *counter reaches target, 0 on success. Caller holds no lock. */
+static int wait_count(const uint32_t *counter, uint32_t target)
+{
+    int64_t deadline = now_ms() + TEST_TIMEOUT_MS;
+    int rc = 0;
+
+    pthread_mutex_lock(&g_ctx.lock);
+    while (*counter < target && rc == 0) {
+        struct timespec ts;
+        int64_t left = deadline - now_ms();
+        if (left <= 0) {
+            rc = -1;
+            break;
+        }
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += left / 1000;
+        ts.tv_nsec += (left % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&g_ctx.cond, &g_ctx.lock, &ts);
+    }
+    pthread_mutex_unlock(&g_ctx.lock);
+    return rc;
+}
+
+static uint32_t read_count(const uint32_t *counter)
+{
+    uint32_t val;
+
+    pthread_mutex_lock(&g_ctx.lock);
+    val = *counter;
+    pthread_mutex_unlock(&g_ctx.lock);
+    return val;
+}
+
+static int32_t test_get_bufs(cam_frame_len_offset_t *offset,
+        uint8_t *num_bufs, uint8_t **initial_reg_flag,
+        mm_camera_buf_def_t **bufs, mm_camera_map_unmap_ops_tbl_t *ops_tbl,
+        void *user_data)
+{
+    test_stream_t *s = (test_stream_t *)user_data;
+    uint8_t *flags;
+    mm_camera_buf_def_t *defs;
+    int i, p;
+
+    s->buf_len = offset->frame_len;
+    s->mem = (uint8_t *)calloc(TEST_NUM_BUFS, s->buf_len);
+    flags = (uint8_t *)malloc(TEST_NUM_BUFS);
+    defs = (mm_camera_buf_def_t *)calloc(TEST_NUM_BUFS, sizeof(*defs));
+    if (s->mem == NULL || flags == NULL || defs == NULL) {
+        free(s->mem);
+        free(flags);
+        free(defs);
+        s->mem = NULL;
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < TEST_NUM_BUFS; i++) {
+        /* like QCameraStream, the last buffer is registered later */
+        flags[i] = (i < TEST_NUM_BUFS - 1);
+        defs[i].buf_idx = (uint32_t)i;
+        defs[i].fd = -1;
+        defs[i].buffer = s->mem + (size_t)i * s->buf_len;
+        defs[i].frame_len = s->buf_len;
+        defs[i].num_planes = (int8_t)offset->num_planes;
+        for (p = 0; p < defs[i].num_planes; p++) {
+            defs[i].planes[p].length = offset->mp[p].len;
+            defs[i].planes[p].data_offset = offset->mp[p].offset;
+            defs[i].planes[p].reserved[0] = (p == 0) ? 0 :
+                    defs[i].planes[p - 1].reserved[0] +
+                    defs[i].planes[p - 1].length;
+        }
+    }
+    s->get_calls++;
+    *num_bufs = TEST_NUM_BUFS;
+    *initial_reg_flag = flags;
+    *bufs = defs;
+    return 0;
+}
+
+static int32_t test_put_bufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl,
+        void *user_data)
+{
+    test_stream_t *s = (test_stream_t *)user_data;
+
+    free(s->mem);
+    s->mem = NULL;
+    s->put_calls++;
+    return 0;
+}
+
+/* Check the pattern of mm_synth_fill_frame on row 1 away from the bar */
+static int check_pattern(const test_stream_t *s, const mm_camera_buf_def_t *buf)
+{
+    const cam_frame_len_offset_t *off = &s->info.buf_planes.plane_info;
+    const uint8_t *y = (const uint8_t *)buf->buffer +
+            buf->planes[0].data_offset;
+    const uint8_t *c = (const uint8_t *)buf->buffer +
+            buf->planes[1].reserved[0] + buf->planes[1].data_offset;
+    uint32_t width = (uint32_t)off->mp[0].width;
+    uint32_t bar = (buf->frame_idx * 8) % width;
+    uint32_t x = (bar >= 32) ? 0 : bar + 32;
+    uint8_t luma = (uint8_t)(1 + buf->frame_idx * 2);
+
+    if (y[off->mp[0].stride + x] != luma || c[0] != 128 || y[bar] != 235) {
+        ERROR("frame %u: luma %u (want %u), chroma %u, bar %u",
+                buf->frame_idx, y[off->mp[0].stride + x], luma, c[0], y[bar]);
+        return -1;
+    }
+    return 0;
+}
+
+static test_stream_t g_meta, g_prev, g_snap;
+
+static void preview_cb(mm_camera_super_buf_t *super_buf, void *user_data)
+{
+    uint32_t frame_idx = super_buf->bufs[0]->frame_idx;
+    uint32_t i;
+    int hold;
+
+    pthread_mutex_lock(&g_ctx.lock);
+    hold = g_ctx.hold;
+    if (super_buf->num_bufs != 2 || frame_idx <= g_ctx.prev_last_idx) {
+        ERROR("bundle of %u bufs, frame %u after %u",
+                super_buf->num_bufs, frame_idx, g_ctx.prev_last_idx);
+        g_ctx.errors++;
+    }
+    for (i = 0; i < super_buf->num_bufs; i++) {
+        mm_camera_buf_def_t *buf = super_buf->bufs[i];
+        if (buf->frame_idx != frame_idx) {
+            ERROR("unmatched bundle: frame %u and %u", frame_idx,
+                    buf->frame_idx);
+            g_ctx.errors++;
+        }
+        if (buf->stream_type == CAM_STREAM_TYPE_METADATA) {
+            cam_metadata_info_t *meta = (cam_metadata_info_t *)buf->buffer;
+            if (meta->is_crop_valid) {
+                g_ctx.meta_crop_streams = meta->crop_data.num_of_streams;
+            }
+            if (meta->is_focus_valid &&
+                    meta->focus_data.focus_state == CAM_AF_FOCUSED) {
+                g_ctx.af_done++;
+            }
+        } else if (check_pattern(&g_prev, buf)) {
+            g_ctx.errors++;
+        }
+    }
+    g_ctx.prev_last_idx = frame_idx;
+    g_ctx.prev_frames++;
+    pthread_cond_broadcast(&g_ctx.cond);
+    pthread_mutex_unlock(&g_ctx.lock);
+
+    for (i = 0; i < super_buf->num_bufs; i++) {
+        mm_camera_buf_def_t *buf = super_buf->bufs[i];
+        if (hold && buf->stream_type == CAM_STREAM_TYPE_PREVIEW) {
+            pthread_mutex_lock(&g_ctx.lock);
+            g_ctx.held[g_ctx.held_cnt++] = buf;
+            pthread_mutex_unlock(&g_ctx.lock);
+        } else {
+            g_ctx.cam->ops->qbuf(super_buf->camera_handle, super_buf->ch_id,
+                    buf);
+        }
+    }
+}
+
+static void zsl_cb(mm_camera_super_buf_t *super_buf, void *user_data)
+{
+    uint32_t frame_idx = super_buf->bufs[0]->frame_idx;
+    uint32_t i;
+    int types = 0;
+
+    pthread_mutex_lock(&g_ctx.lock);
+    for (i = 0; i < super_buf->num_bufs; i++) {
+        mm_camera_buf_def_t *buf = super_buf->bufs[i];
+        if (buf->frame_idx != frame_idx) {
+            ERROR("unmatched zsl bundle: frame %u and %u", frame_idx,
+                    buf->frame_idx);
+            g_ctx.errors++;
+        }
+        types |= 1 << buf->stream_type;
+    }
+    if (super_buf->num_bufs != 2 || types != ((1 << CAM_STREAM_TYPE_SNAPSHOT) |
+            (1 << CAM_STREAM_TYPE_METADATA))) {
+        ERROR("zsl bundle of %u bufs, types 0x%x", super_buf->num_bufs, types);
+        g_ctx.errors++;
+    }
+    if (g_ctx.zsl_frames == 0) {
+        g_ctx.zsl_first_idx = frame_idx;
+    } else if (frame_idx <= g_ctx.zsl_last_idx) {
+        ERROR("zsl frame %u after %u", frame_idx, g_ctx.zsl_last_idx);
+        g_ctx.errors++;
+    }
+    g_ctx.zsl_last_idx = frame_idx;
+    g_ctx.zsl_frames++;
+    pthread_cond_broadcast(&g_ctx.cond);
+    pthread_mutex_unlock(&g_ctx.lock);
+
+    for (i = 0; i < super_buf->num_bufs; i++) {
+        g_ctx.cam->ops->qbuf(super_buf->camera_handle, super_buf->ch_id,
+                super_buf->bufs[i]);
+    }
+}
+
+static int add_stream(uint32_t ch_id, test_stream_t *s,
+        cam_stream_type_t type, cam_format_t fmt)
+{
+    mm_camera_vtbl_t *cam = g_ctx.cam;
+    mm_camera_stream_config_t config;
+
+    s->stream_id = cam->ops->add_stream(cam->camera_handle, ch_id);
+    if (s->stream_id == 0) {
+        ERROR("add_stream type %d failed", type);
+        return -1;
+    }
+    memset(&s->info, 0, sizeof(s->info));
+    s->info.stream_type = type;
+    s->info.fmt = fmt;
+    if (type == CAM_STREAM_TYPE_METADATA) {
+        /* one plane holding the whole struct, as the HAL configures it */
+        s->info.dim.width = (int32_t)sizeof(cam_metadata_info_t);
+        s->info.dim.height = 1;
+    } else {
+        s->info.dim.width = TEST_WIDTH;
+        s->info.dim.height = TEST_HEIGHT;
+    }
+    s->info.streaming_mode = CAM_STREAMING_MODE_CONTINUOUS;
+
+    memset(&config, 0, sizeof(config));
+    config.stream_info = &s->info;
+    config.padding_info.width_padding = CAM_PAD_TO_16;
+    config.padding_info.height_padding = CAM_PAD_TO_2;
+    config.padding_info.plane_padding = CAM_PAD_TO_4;
+    config.mem_vtbl.get_bufs = test_get_bufs;
+    config.mem_vtbl.put_bufs = test_put_bufs;
+    config.mem_vtbl.user_data = s;
+    if (cam->ops->config_stream(cam->camera_handle, ch_id, s->stream_id,
+            &config)) {
+        ERROR("config_stream type %d failed", type);
+        return -1;
+    }
+    return 0;
+}
+
+/* Preview: continuous bundles of metadata and preview, AF through metadata */
+static int test_frames(uint32_t ch_id)
+{
+    mm_camera_vtbl_t *cam = g_ctx.cam;
+    uint32_t start = read_count(&g_ctx.prev_frames);
+
+    if (cam->ops->do_auto_focus(cam->camera_handle)) {
+        ERROR("do_auto_focus failed");
+        return -1;
+    }
+    if (wait_count(&g_ctx.prev_frames, start + 20) ||
+            wait_count(&g_ctx.af_done, 1)) {
+        ERROR("%u preview frames, af %u", read_count(&g_ctx.prev_frames),
+                read_count(&g_ctx.af_done));
+        return -1;
+    }
+    /* metadata, preview and the zsl snapshot stream */
+    if (read_count(&g_ctx.meta_crop_streams) != 3) {
+        ERROR("crop of %u streams", read_count(&g_ctx.meta_crop_streams));
+        return -1;
+    }
+    printf("frames: %u preview bundles, last frame %u, af done %u\n",
+            read_count(&g_ctx.prev_frames), read_count(&g_ctx.prev_last_idx),
+            read_count(&g_ctx.af_done));
+    return 0;
+}
+
+/* Hold every preview buffer: the stream must starve, then resume on qbuf */
+static int test_buf_return(uint32_t ch_id)
+{
+    mm_camera_vtbl_t *cam = g_ctx.cam;
+    uint32_t frames;
+    int i, held, queued;
+
+    pthread_mutex_lock(&g_ctx.lock);
+    g_ctx.hold = 1;
+    g_ctx.held_cnt = 0;
+    pthread_mutex_unlock(&g_ctx.lock);
+
+    /* five registered buffers, the sixth was never queued */
+    usleep(500 * 1000);
+    frames = read_count(&g_ctx.prev_frames);
+    usleep(200 * 1000);
+    pthread_mutex_lock(&g_ctx.lock);
+    held = g_ctx.held_cnt;
+    g_ctx.hold = 0;
+    pthread_mutex_unlock(&g_ctx.lock);
+    queued = cam->ops->get_queued_buf_count(cam->camera_handle, ch_id,
+            g_prev.stream_id);
+    if (held != TEST_NUM_BUFS - 1 || queued != 0 ||
+            read_count(&g_ctx.prev_frames) != frames) {
+        ERROR("holding %d bufs, %d queued, %u frames while starved",
+                held, queued, read_count(&g_ctx.prev_frames) - frames);
+        return -1;
+    }
+
+    for (i = 0; i < held; i++) {
+        if (cam->ops->qbuf(cam->camera_handle, ch_id, g_ctx.held[i])) {
+            ERROR("qbuf %d failed", i);
+            return -1;
+        }
+    }
+    if (wait_count(&g_ctx.prev_frames, frames + 10)) {
+        ERROR("stream did not resume after qbuf");
+        return -1;
+    }
+    printf("buffer return: starved with %d bufs held, resumed after qbuf\n",
+            held);
+    return 0;
+}
+
+/* ZSL: burst channel with the preview channel's metadata linked in */
+static int test_super_buf(uint32_t zsl_ch, uint32_t prev_ch)
+{
+    mm_camera_vtbl_t *cam = g_ctx.cam;
+    uint32_t last_prev;
+
+    /* let the queue fill past the water mark */
+    usleep(200 * 1000);
+    if (read_count(&g_ctx.zsl_frames) != 0) {
+        ERROR("zsl bundle before any request");
+        return -1;
+    }
+    last_prev = read_count(&g_ctx.prev_last_idx);
+    if (cam->ops->request_super_buf(cam->camera_handle, zsl_ch, 3) ||
+            wait_count(&g_ctx.zsl_frames, 3)) {
+        ERROR("%u of 3 zsl bundles", read_count(&g_ctx.zsl_frames));
+        return -1;
+    }
+    usleep(200 * 1000);
+    if (read_count(&g_ctx.zsl_frames) != 3) {
+        ERROR("%u zsl bundles for a request of 3",
+                read_count(&g_ctx.zsl_frames));
+        return -1;
+    }
+    /* look_back 2: nothing older than two frames before the request */
+    if (read_count(&g_ctx.zsl_first_idx) + 2 < last_prev) {
+        ERROR("first zsl frame %u, preview was at %u",
+                read_count(&g_ctx.zsl_first_idx), last_prev);
+        return -1;
+    }
+    printf("request_super_buf: 3 bundles, frames %u..%u, preview at %u\n",
+            read_count(&g_ctx.zsl_first_idx), read_count(&g_ctx.zsl_last_idx),
+            last_prev);
+    return 0;
+}
+
+static int test_ion(void)
+{
+    struct ion_allocation_data alloc;
+    struct ion_fd_data share;
+    struct ion_handle_data handle;
+    uint8_t *addr;
+    int fd, rc = -1;
+
+    fd = mm_camera_synth_ion_open();
+    if (fd < 0) {
+        ERROR("ion open failed");
+        return -1;
+    }
+    memset(&alloc, 0, sizeof(alloc));
+    alloc.len = 4096;
+    alloc.heap_id_mask = ION_HEAP(ION_IOMMU_HEAP_ID);
+    memset(&share, 0, sizeof(share));
+    if (mm_camera_synth_ion_ioctl(fd, ION_IOC_ALLOC, &alloc) == 0) {
+        share.handle = alloc.handle;
+        if (mm_camera_synth_ion_ioctl(fd, ION_IOC_SHARE, &share) == 0) {
+            addr = (uint8_t *)mmap(NULL, alloc.len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, share.fd, 0);
+            if (addr != MAP_FAILED) {
+                memset(addr, 0x5a, alloc.len);
+                rc = (addr[alloc.len - 1] == 0x5a) ? 0 : -1;
+                munmap(addr, alloc.len);
+            }
+            close(share.fd);
+        }
+        handle.handle = alloc.handle;
+        if (mm_camera_synth_ion_ioctl(fd, ION_IOC_FREE, &handle)) {
+            rc = -1;
+        }
+    }
+    close(fd);
+    if (rc) {
+        ERROR("ion alloc/share/map/free failed");
+    } else {
+        printf("ion: alloc, share, map and free of %zu bytes\n", alloc.len);
+    }
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    mm_camera_vtbl_t *cam;
+    mm_camera_channel_attr_t attr;
+    cam_capability_t *cap;
+    uint32_t prev_ch, zsl_ch;
+    int cap_fd;
+    int rc = 0;
+
+    /* fast frames keep the run short; an explicit setting wins */
+    setenv("CAMERA_SYNTH_FPS", "120", 0);
+    setenv("CAMERA_SYNTH_SENSOR", "1280x960", 0);
+
+    if (get_num_of_cameras() == 0) {
+        ERROR("no cameras");
+        return 1;
+    }
+    cam = camera_open(0);
+    if (cam == NULL) {
+        ERROR("camera_open failed");
+        return 1;
+    }
+    g_ctx.cam = cam;
+
+    cap_fd = ashmem_create_region("capability", sizeof(*cap));
+    if (cap_fd < 0 || cam->ops->map_buf(cam->camera_handle,
+            CAM_MAPPING_BUF_TYPE_CAPABILITY, cap_fd, sizeof(*cap))) {
+        ERROR("map capability failed");
+        return 1;
+    }
+    cap = (cam_capability_t *)mmap(NULL, sizeof(*cap), PROT_READ, MAP_SHARED,
+            cap_fd, 0);
+    if (cap == MAP_FAILED || cam->ops->query_capability(cam->camera_handle) ||
+            cap->preview_sizes_tbl_cnt == 0 ||
+            cap->active_array_size.width != 1280) {
+        ERROR("query_capability failed");
+        return 1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.notify_mode = MM_CAMERA_SUPER_BUF_NOTIFY_CONTINUOUS;
+    prev_ch = cam->ops->add_channel(cam->camera_handle, &attr, preview_cb,
+            NULL);
+    attr.notify_mode = MM_CAMERA_SUPER_BUF_NOTIFY_BURST;
+    attr.water_mark = 2;
+    attr.look_back = 2;
+    zsl_ch = cam->ops->add_channel(cam->camera_handle, &attr, zsl_cb, NULL);
+    if (prev_ch == 0 || zsl_ch == 0 ||
+            add_stream(prev_ch, &g_meta, CAM_STREAM_TYPE_METADATA,
+                    CAM_FORMAT_MAX) ||
+            add_stream(prev_ch, &g_prev, CAM_STREAM_TYPE_PREVIEW,
+                    CAM_FORMAT_YUV_420_NV21) ||
+            add_stream(zsl_ch, &g_snap, CAM_STREAM_TYPE_SNAPSHOT,
+                    CAM_FORMAT_YUV_420_NV21) ||
+            cam->ops->link_stream(cam->camera_handle, prev_ch,
+                    g_meta.stream_id, zsl_ch) < 0) {
+        ERROR("channel setup failed");
+        return 1;
+    }
+
+    if (cam->ops->start_channel(cam->camera_handle, prev_ch) ||
+            cam->ops->start_channel(cam->camera_handle, zsl_ch)) {
+        ERROR("start_channel failed");
+        return 1;
+    }
+
+    rc |= test_frames(prev_ch);
+    rc |= test_buf_return(prev_ch);
+    rc |= test_super_buf(zsl_ch, prev_ch);
+
+    cam->ops->stop_channel(cam->camera_handle, zsl_ch);
+    cam->ops->stop_channel(cam->camera_handle, prev_ch);
+    if (g_meta.put_calls != 1 || g_prev.put_calls != 1 ||
+            g_snap.put_calls != 1 || g_prev.get_calls != 1) {
+        ERROR("put_bufs calls %d/%d/%d", g_meta.put_calls, g_prev.put_calls,
+                g_snap.put_calls);
+        rc = -1;
+    }
+    if (g_ctx.errors) {
+        ERROR("%u errors in the callbacks", g_ctx.errors);
+        rc = -1;
+    }
+    cam->ops->delete_channel(cam->camera_handle, zsl_ch);
+    cam->ops->delete_channel(cam->camera_handle, prev_ch);
+    cam->ops->unmap_buf(cam->camera_handle, CAM_MAPPING_BUF_TYPE_CAPABILITY);
+    cam->ops->close_camera(cam->camera_handle);
+    munmap(cap, sizeof(*cap));
+    close(cap_fd);
+
+    rc |= test_ion();
+
+    printf("%s\n", rc ? "FAIL" : "PASS");
+    return rc ? 1 : 0;
+}
@@ -39,15 +39,42 @@
 #include "OMX_Component.h"
 #include "QOMX_JpegExtensions.h"
 #include "mm_jpeg_ionbuf.h"
+#include "mm_jpeg_sw_enc.h"
 
 #define MM_JPEG_MAX_THREADS 30
 #define MM_JPEG_CIRQ_SIZE 30
 #define MM_JPEG_MAX_SESSION 10
 #define MAX_EXIF_TABLE_ENTRIES 50
+#define MM_JPEG_EXIF_POOL_SIZE 256
 #define MAX_JPEG_SIZE 20000000
 #define MAX_OMX_HANDLES (5)
 
 
+/** mm_jpeg_sw_enc_mode_t:
+ *  @MM_JPEG_SW_ENC_AUTO: software encoder only if OMX cannot be loaded
+ *  @MM_JPEG_SW_ENC_FORCE: always use the software encoder
+ *
+ *  Encoder backend selection, persist.camera.jpeg.swenc
+ **/
+typedef enum {
+  MM_JPEG_SW_ENC_AUTO,
+  MM_JPEG_SW_ENC_FORCE
+} mm_jpeg_sw_enc_mode_t;
+
+/** mm_jpeg_exif_table_t:
+ *  @info: tags handed to the encoder
+ *  @pool, @pool_size, @pool_used: storage for the values that do not fit
+ *    in the tag itself, strings and arrays
+ *
+ *  Tags parsed from the metadata, see addExifEntry
+ **/
+typedef struct {
+  QOMX_EXIF_INFO info;
+  uint8_t *pool;
+  uint32_t pool_size;
+  uint32_t pool_used;
+} mm_jpeg_exif_table_t;
+
 /** mm_jpeg_abort_state_t:
  *  @MM_JPEG_ABORT_NONE: Abort is not issued
  *  @MM_JPEG_ABORT_INIT: Abort is issued from the client
@@ -300,6 +327,7 @@ typedef struct mm_jpeg_job_session {
 
   QEXIF_INFO_DATA exif_info_local[MAX_EXIF_TABLE_ENTRIES];  //all exif tags for JPEG encoder
   int exif_count_local;
+  uint64_t exif_pool[MM_JPEG_EXIF_POOL_SIZE / sizeof(uint64_t)];
 
   mm_jpeg_cirq_t cb_q;
   int32_t ebd_count;
@@ -335,6 +363,13 @@ typedef struct mm_jpeg_job_session {
   mm_jpeg_queue_t *out_buf_q;
 
   uint32_t job_index;
+
+  /* encoded by mm_jpeg_sw_enc instead of OMX, omx_handle is NULL */
+  OMX_BOOL use_sw_enc;
+  /* EXIF layout of the last sw job, patched by the next one */
+  mm_jpeg_sw_exif_tmpl_t sw_exif_tmpl;
+  /* job being coded by the sw job thread */
+  mm_jpeg_sw_job_t sw_job;
 } mm_jpeg_job_session_t;
 
 typedef struct {
@@ -399,6 +434,14 @@ typedef struct mm_jpeg_obj_t {
 
   uint32_t num_sessions;
 
+  /* software encoder backend */
+  OMX_BOOL omx_loaded;
+  mm_jpeg_sw_enc_mode_t sw_enc_mode;
+  uint32_t sw_enc_threads;        /* 0 for one per online core */
+  OMX_BOOL sw_enc_ready;
+  mm_jpeg_sw_enc_t sw_enc;
+  mm_jpeg_job_cmd_thread_t sw_job_mgr; /* runs the sw encodes */
+
 } mm_jpeg_obj;
 
 /** mm_jpeg_pending_func_t:
@@ -462,11 +505,12 @@ extern int32_t mm_jpeg_queue_deinit(mm_jpeg_queue_t* queue);
 extern int32_t mm_jpeg_queue_flush(mm_jpeg_queue_t* queue);
 extern uint32_t mm_jpeg_queue_get_size(mm_jpeg_queue_t* queue);
 extern mm_jpeg_q_data_t mm_jpeg_queue_peek(mm_jpeg_queue_t* queue);
-extern int32_t addExifEntry(QOMX_EXIF_INFO *p_exif_info, exif_tag_id_t tagid,
+extern void mm_jpeg_exif_table_init(mm_jpeg_exif_table_t *p_table,
+  QEXIF_INFO_DATA *p_entries, void *p_pool, uint32_t pool_size);
+extern int32_t addExifEntry(mm_jpeg_exif_table_t *p_table, exif_tag_id_t tagid,
   exif_tag_type_t type, uint32_t count, void *data);
-extern int32_t releaseExifEntry(QEXIF_INFO_DATA *p_exif_data);
 extern int process_meta_data(cam_metadata_info_t *p_meta,
-  QOMX_EXIF_INFO *exif_info, mm_jpeg_exif_params_t *p_cam3a_params);
+  mm_jpeg_exif_table_t *exif_info, mm_jpeg_exif_params_t *p_cam3a_params);
 
 OMX_ERRORTYPE mm_jpeg_session_change_state(mm_jpeg_job_session_t* p_session,
   OMX_STATETYPE new_state,
@@ -0,0 +1,203 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef MM_JPEG_SW_ENC_H_
+#define MM_JPEG_SW_ENC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "qexif.h"
+
+/* Software baseline JPEG encoder used when the OMX encoder is not
+ * available. The main image is cut into strips of whole MCU rows that are
+ * entropy coded independently on a worker pool and joined with restart
+ * markers, so one image uses all the workers. It only depends on libc and
+ * pthreads and builds on the host for testing. */
+
+#define MM_JPEG_SW_MAX_THREADS 8
+#define MM_JPEG_SW_EXIF_SETS 2
+#define MM_JPEG_SW_EXIF_SLOTS 128
+
+typedef enum {
+  MM_JPEG_SW_FMT_H2V2_CRCB,   /* NV21 */
+  MM_JPEG_SW_FMT_H2V2_CBCR,   /* NV12 */
+  MM_JPEG_SW_FMT_H2V1_CRCB,   /* NV61 */
+  MM_JPEG_SW_FMT_H2V1_CBCR,   /* NV16 */
+  MM_JPEG_SW_FMT_MONO,
+  MM_JPEG_SW_FMT_MAX
+} mm_jpeg_sw_fmt_t;
+
+/** mm_jpeg_sw_image_t:
+ *  @y, @c: luma and interleaved chroma planes, @c unused for MONO
+ *  @y_stride, @c_stride: plane strides in bytes
+ *  @width, @height: source dimension
+ *  @crop_*: source rectangle to encode, zero width/height for all of it
+ *  @out_w, @out_h: scaled size before rotation, zero for the crop size
+ *  @rotation: clockwise 0, 90, 180 or 270
+ **/
+typedef struct {
+  const uint8_t *y;
+  const uint8_t *c;
+  uint32_t y_stride;
+  uint32_t c_stride;
+  uint32_t width;
+  uint32_t height;
+  mm_jpeg_sw_fmt_t fmt;
+  uint32_t crop_x;
+  uint32_t crop_y;
+  uint32_t crop_w;
+  uint32_t crop_h;
+  uint32_t out_w;
+  uint32_t out_h;
+  uint32_t rotation;
+} mm_jpeg_sw_image_t;
+
+/** mm_jpeg_sw_exif_tag_t:
+ *  Same layout as QEXIF_INFO_DATA, which lives in the OMX extension
+ *  header and so is not available to host builds
+ **/
+typedef struct {
+  exif_tag_entry_t tag_entry;
+  exif_tag_id_t tag_id;
+} mm_jpeg_sw_exif_tag_t;
+
+typedef struct {
+  const mm_jpeg_sw_exif_tag_t *entries;
+  uint32_t count;
+} mm_jpeg_sw_exif_set_t;
+
+/** mm_jpeg_sw_exif_slot_t:
+ *  @tag_id, @type, @count, @has_data: job tag the slot was built from
+ *  @off: offset of its values in the template, -1 if not written
+ *  @shadow: offset of the same values in host order in the shadow copy
+ **/
+typedef struct {
+  exif_tag_id_t tag_id;
+  uint32_t type;
+  uint32_t count;
+  uint32_t has_data;
+  int32_t off;
+  uint32_t shadow;
+} mm_jpeg_sw_exif_slot_t;
+
+/** mm_jpeg_sw_exif_tmpl_t:
+ *  APP1 segment of the previous job, without the thumbnail. As long as
+ *  the tags come with the same ids, types and counts in the same order
+ *  and the coded size does not change the layout is the same, so the
+ *  next job only rewrites the values that differ, the segment length and
+ *  the thumbnail length. Zero initialize, free the buffers with
+ *  mm_jpeg_sw_exif_tmpl_release.
+ *  @buf, @len, @cap: serialized segment
+ *  @shadow, @shadow_cap: values of @buf in host order, for comparing
+ *  @slots, @num: one slot per job tag, the sets back to back
+ *  @tn_len_off: offset of the IFD1 thumbnail length value, 0 without IFD1
+ *  @builds, @reuses, @patched: full builds, patched reuses and values
+ *    rewritten by them
+ **/
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+  size_t cap;
+  uint8_t *shadow;
+  size_t shadow_cap;
+  mm_jpeg_sw_exif_slot_t slots[MM_JPEG_SW_EXIF_SLOTS];
+  uint32_t num[MM_JPEG_SW_EXIF_SETS];
+  uint32_t jw;
+  uint32_t jh;
+  uint32_t thumb;
+  uint32_t tn_len_off;
+  uint32_t valid;
+  uint32_t builds;
+  uint32_t reuses;
+  uint32_t patched;
+} mm_jpeg_sw_exif_tmpl_t;
+
+/** mm_jpeg_sw_job_t:
+ *  @main: main image
+ *  @quality: 1..100
+ *  @encode_thumbnail: embed @thumb in the EXIF IFD1
+ *  @exif: tag sets, the first set wins when a tag appears twice
+ *  @exif_tmpl: optional template kept across the jobs of a session,
+ *    NULL to serialize the tags from scratch
+ *  @out, @out_size: output buffer; if @out is NULL @alloc_out is called
+ *    once with the exact size after the strips are coded
+ *  @is_aborted: optional, polled before each MCU row and before the
+ *    output is allocated, the encode fails once it returns non zero
+ *  @user_data: argument of @alloc_out and @is_aborted
+ **/
+typedef struct {
+  mm_jpeg_sw_image_t main;
+  uint32_t quality;
+  uint32_t encode_thumbnail;
+  mm_jpeg_sw_image_t thumb;
+  uint32_t thumb_quality;
+  mm_jpeg_sw_exif_set_t exif[MM_JPEG_SW_EXIF_SETS];
+  mm_jpeg_sw_exif_tmpl_t *exif_tmpl;
+  uint8_t *out;
+  size_t out_size;
+  uint8_t *(*alloc_out)(void *user_data, size_t size);
+  int (*is_aborted)(void *user_data);
+  void *user_data;
+} mm_jpeg_sw_job_t;
+
+typedef struct {
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+} mm_jpeg_sw_strip_t;
+
+struct mm_jpeg_sw_frame;
+
+typedef struct {
+  pthread_t threads[MM_JPEG_SW_MAX_THREADS];
+  uint32_t num_threads;          /* workers incl. the calling thread */
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  struct mm_jpeg_sw_frame *frame; /* frame being coded, NULL when idle */
+  uint32_t next_strip;
+  uint32_t strips_done;
+  int exit;
+  mm_jpeg_sw_strip_t *strips;    /* per strip bitstreams, reused */
+  uint32_t num_strips_alloc;
+  uint8_t *thumb_buf;            /* coded thumbnail, reused */
+  size_t thumb_cap;
+} mm_jpeg_sw_enc_t;
+
+int32_t mm_jpeg_sw_enc_init(mm_jpeg_sw_enc_t *p_enc, uint32_t num_threads);
+void mm_jpeg_sw_enc_deinit(mm_jpeg_sw_enc_t *p_enc);
+int32_t mm_jpeg_sw_enc_encode(mm_jpeg_sw_enc_t *p_enc,
+  const mm_jpeg_sw_job_t *p_job, uint8_t **p_out, size_t *p_len);
+size_t mm_jpeg_sw_enc_write_exif(const mm_jpeg_sw_job_t *p_job,
+  uint32_t jw, uint32_t jh, int thumb, const uint8_t *thumb_data,
+  size_t thumb_len, uint8_t *p);
+void mm_jpeg_sw_exif_tmpl_release(mm_jpeg_sw_exif_tmpl_t *p_tmpl);
+
+#endif /* MM_JPEG_SW_ENC_H_ */
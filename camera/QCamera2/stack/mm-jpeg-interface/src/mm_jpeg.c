@@ -37,6 +37,7 @@
 #include <sys/prctl.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <unistd.h>
 #include <cutils/trace.h>
 
 #include "mm_jpeg_dbg.h"
@@ -75,6 +76,12 @@ mm_jpeg_job_q_node_t* mm_jpeg_queue_remove_job_by_dst_ptr(
   mm_jpeg_queue_t* queue, void * dst_ptr);
 static OMX_ERRORTYPE mm_jpeg_session_configure(mm_jpeg_job_session_t *p_session);
 
+/* mm_jpeg_sw_enc takes the OMX exif entries as they are */
+typedef char mm_jpeg_sw_exif_layout_check[
+  (sizeof(QEXIF_INFO_DATA) == sizeof(mm_jpeg_sw_exif_tag_t) &&
+  offsetof(QEXIF_INFO_DATA, tag_id) ==
+  offsetof(mm_jpeg_sw_exif_tag_t, tag_id)) ? 1 : -1];
+
 /** mm_jpeg_session_send_buffers:
  *
  *  Arguments:
@@ -292,18 +299,31 @@ OMX_ERRORTYPE mm_jpeg_session_create(mm_jpeg_job_session_t* p_session)
   p_session->exif_count_local = 0;
   p_session->auto_out_buf = OMX_FALSE;
 
+  p_session->use_sw_enc = OMX_FALSE;
+  p_session->omx_handle = NULL;
+
   p_session->omx_callbacks.EmptyBufferDone = mm_jpeg_ebd;
   p_session->omx_callbacks.FillBufferDone = mm_jpeg_fbd;
   p_session->omx_callbacks.EventHandler = mm_jpeg_event_handler;
 
+  if ((OMX_TRUE == my_obj->omx_loaded) &&
+    (MM_JPEG_SW_ENC_FORCE != my_obj->sw_enc_mode)) {
+    rc = OMX_GetHandle(&p_session->omx_handle,
+        "OMX.qcom.image.jpeg.encoder",
+        (void *)p_session,
+        &p_session->omx_callbacks);
+    if (OMX_ErrorNone != rc) {
+      CDBG_ERROR("%s:%d] OMX_GetHandle failed (%d), using sw encoder",
+        __func__, __LINE__, rc);
+      p_session->omx_handle = NULL;
+      rc = OMX_ErrorNone;
+    }
+  }
 
-  rc = OMX_GetHandle(&p_session->omx_handle,
-      "OMX.qcom.image.jpeg.encoder",
-      (void *)p_session,
-      &p_session->omx_callbacks);
-  if (OMX_ErrorNone != rc) {
-    CDBG_ERROR("%s:%d] OMX_GetHandle failed (%d)", __func__, __LINE__, rc);
-    return rc;
+  if (NULL == p_session->omx_handle) {
+    /* nothing to configure, the job params are applied per encode */
+    p_session->use_sw_enc = OMX_TRUE;
+    p_session->config = OMX_TRUE;
   }
 
   my_obj->num_sessions++;
@@ -332,6 +352,10 @@ void mm_jpeg_session_destroy(mm_jpeg_job_session_t* p_session)
   mm_jpeg_obj *my_obj = (mm_jpeg_obj *) p_session->jpeg_obj;
 
   CDBG("%s:%d] E", __func__, __LINE__);
+  if (OMX_TRUE == p_session->use_sw_enc) {
+    goto release;
+  }
+
   if (NULL == p_session->omx_handle) {
     CDBG_ERROR("%s:%d] invalid handle", __func__, __LINE__);
     return;
@@ -363,9 +387,17 @@ void mm_jpeg_session_destroy(mm_jpeg_job_session_t* p_session)
   }
   p_session->omx_handle = NULL;
 
+release:
   pthread_mutex_destroy(&p_session->lock);
   pthread_cond_destroy(&p_session->cond);
 
+  if (p_session->sw_exif_tmpl.builds) {
+    CDBG_HIGH("%s:%d] sw exif builds %u reuses %u patched values %u",
+      __func__, __LINE__, p_session->sw_exif_tmpl.builds,
+      p_session->sw_exif_tmpl.reuses, p_session->sw_exif_tmpl.patched);
+  }
+  mm_jpeg_sw_exif_tmpl_release(&p_session->sw_exif_tmpl);
+
   if (NULL != p_session->meta_enc_key) {
     free(p_session->meta_enc_key);
     p_session->meta_enc_key = NULL;
@@ -1092,7 +1124,7 @@ OMX_ERRORTYPE mm_jpeg_session_config_common(mm_jpeg_job_session_t *p_session)
   OMX_INDEXTYPE exif_idx;
   OMX_CONFIG_ROTATIONTYPE rotate;
   mm_jpeg_encode_job_t *p_jobparams = &p_session->encode_job;
-  QOMX_EXIF_INFO exif_info;
+  mm_jpeg_exif_table_t exif_table;
 
   /* set rotation */
   memset(&rotate, 0, sizeof(rotate));
@@ -1128,19 +1160,19 @@ OMX_ERRORTYPE mm_jpeg_session_config_common(mm_jpeg_job_session_t *p_session)
   }
   /*parse aditional exif data from the metadata*/
   if (NULL != p_jobparams->p_metadata) {
-    exif_info.numOfEntries = 0;
-    exif_info.exif_data = &p_session->exif_info_local[0];
-    process_meta_data(p_jobparams->p_metadata, &exif_info, &p_jobparams->cam_exif_params);
+    mm_jpeg_exif_table_init(&exif_table, p_session->exif_info_local,
+      p_session->exif_pool, sizeof(p_session->exif_pool));
+    process_meta_data(p_jobparams->p_metadata, &exif_table, &p_jobparams->cam_exif_params);
     /* After Parse metadata */
-    p_session->exif_count_local = (int)exif_info.numOfEntries;
+    p_session->exif_count_local = (int)exif_table.info.numOfEntries;
 
-    if (exif_info.numOfEntries > 0) {
+    if (exif_table.info.numOfEntries > 0) {
       /* set exif tags */
       CDBG("%s:%d] exif tags from metadata count %d", __func__, __LINE__,
-        (int)exif_info.numOfEntries);
+        (int)exif_table.info.numOfEntries);
 
       rc = OMX_SetConfig(p_session->omx_handle, exif_idx,
-        &exif_info);
+        &exif_table.info);
       if (OMX_ErrorNone != rc) {
         CDBG_ERROR("%s:%d] Error %d", __func__, __LINE__, rc);
         return rc;
@@ -1440,6 +1472,440 @@ error:
   return ret;
 }
 
+/** mm_jpeg_sw_map_format:
+ *
+ *  Arguments:
+ *    @color_fmt: mm-jpeg color format
+ *    @p_fmt: software encoder format
+ *
+ *  Return:
+ *       0 for success -1 for formats the software encoder does not take
+ *
+ **/
+static int32_t mm_jpeg_sw_map_format(mm_jpeg_color_format color_fmt,
+  mm_jpeg_sw_fmt_t *p_fmt)
+{
+  switch (color_fmt) {
+  case MM_JPEG_COLOR_FORMAT_YCRCBLP_H2V2:
+    *p_fmt = MM_JPEG_SW_FMT_H2V2_CRCB;
+    break;
+  case MM_JPEG_COLOR_FORMAT_YCBCRLP_H2V2:
+    *p_fmt = MM_JPEG_SW_FMT_H2V2_CBCR;
+    break;
+  case MM_JPEG_COLOR_FORMAT_YCRCBLP_H2V1:
+    *p_fmt = MM_JPEG_SW_FMT_H2V1_CRCB;
+    break;
+  case MM_JPEG_COLOR_FORMAT_YCBCRLP_H2V1:
+    *p_fmt = MM_JPEG_SW_FMT_H2V1_CBCR;
+    break;
+  case MM_JPEG_COLOR_FORMAT_MONOCHROME:
+    *p_fmt = MM_JPEG_SW_FMT_MONO;
+    break;
+  default:
+    return -1;
+  }
+  return 0;
+}
+
+/** mm_jpeg_sw_fill_image:
+ *
+ *  Arguments:
+ *    @p_buf: source buffer
+ *    @p_dim: source, crop and output dimension
+ *    @color_fmt: source color format
+ *    @rotation: clockwise rotation
+ *    @p_img: software encoder image to fill
+ *
+ *  Return:
+ *       0 for success -1 otherwise
+ *
+ *  Description:
+ *       Describe a frame the same way the OMX input port sees it: luma
+ *       at mp[0].offset, chroma mp[1].offset past the luma plane
+ *
+ **/
+static int32_t mm_jpeg_sw_fill_image(mm_jpeg_buf_t *p_buf,
+  mm_jpeg_dim_t *p_dim, mm_jpeg_color_format color_fmt, uint32_t rotation,
+  mm_jpeg_sw_image_t *p_img)
+{
+  memset(p_img, 0, sizeof(*p_img));
+  if ((NULL == p_buf->buf_vaddr) ||
+    mm_jpeg_sw_map_format(color_fmt, &p_img->fmt)) {
+    CDBG_ERROR("%s:%d] unsupported buffer %p format %d", __func__, __LINE__,
+      p_buf->buf_vaddr, color_fmt);
+    return -1;
+  }
+  p_img->y = p_buf->buf_vaddr + p_buf->offset.mp[0].offset;
+  p_img->c = p_buf->buf_vaddr + p_buf->offset.mp[0].len +
+    p_buf->offset.mp[1].offset;
+  p_img->y_stride = (uint32_t)p_buf->offset.mp[0].stride;
+  p_img->c_stride = (uint32_t)p_buf->offset.mp[1].stride;
+  p_img->width = (uint32_t)p_dim->src_dim.width;
+  p_img->height = (uint32_t)p_dim->src_dim.height;
+  p_img->crop_x = (uint32_t)p_dim->crop.left;
+  p_img->crop_y = (uint32_t)p_dim->crop.top;
+  p_img->crop_w = (uint32_t)p_dim->crop.width;
+  p_img->crop_h = (uint32_t)p_dim->crop.height;
+  p_img->out_w = (uint32_t)p_dim->dst_dim.width;
+  p_img->out_h = (uint32_t)p_dim->dst_dim.height;
+  p_img->rotation = rotation;
+  return 0;
+}
+
+/** mm_jpeg_sw_get_memory:
+ *
+ *  Arguments:
+ *    @user_data: job session
+ *    @size: exact size of the jpeg
+ *
+ *  Return:
+ *       output address, NULL on failure
+ *
+ *  Description:
+ *       Output allocation for sessions using get_memory, the destination
+ *       buffer holds the omx_jpeg_ouput_buf_t handed back to the client
+ *
+ **/
+static uint8_t *mm_jpeg_sw_get_memory(void *user_data, size_t size)
+{
+  mm_jpeg_job_session_t *p_session = (mm_jpeg_job_session_t *)user_data;
+  omx_jpeg_ouput_buf_t *p_out = (omx_jpeg_ouput_buf_t *)
+    p_session->params.dest_buf[p_session->encode_job.dst_index].buf_vaddr;
+
+  if (NULL == p_out) {
+    return NULL;
+  }
+  p_out->size = size;
+  if (p_session->params.get_memory(p_out) || (NULL == p_out->vaddr)) {
+    CDBG_ERROR("%s:%d] get_memory failed for %zu bytes", __func__, __LINE__,
+      size);
+    return NULL;
+  }
+  return (uint8_t *)p_out->vaddr;
+}
+
+/** mm_jpeg_sw_is_aborted:
+ *
+ *  Arguments:
+ *    @user_data: job session
+ *
+ *  Return:
+ *       non zero if the job of the session is being aborted
+ *
+ *  Description:
+ *       Abort hook of the sw encoder, polled between MCU rows
+ *
+ **/
+static int mm_jpeg_sw_is_aborted(void *user_data)
+{
+  mm_jpeg_job_session_t *p_session = (mm_jpeg_job_session_t *)user_data;
+  int aborted;
+
+  pthread_mutex_lock(&p_session->lock);
+  aborted = (MM_JPEG_ABORT_NONE != p_session->abort_state);
+  pthread_mutex_unlock(&p_session->lock);
+  return aborted;
+}
+
+/** mm_jpeg_session_run_sw:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @p_session: encode session queued by mm_jpeg_session_encode_sw
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Encode the job of the session and complete it as mm_jpeg_fbd
+ *       does for OMX. An aborted job is dropped without a callback,
+ *       the session is handed back for the next job and the waiting
+ *       mm_jpeg_session_abort is woken up.
+ *
+ **/
+static void mm_jpeg_session_run_sw(mm_jpeg_obj *my_obj,
+  mm_jpeg_job_session_t *p_session)
+{
+  mm_jpeg_encode_params_t *p_params = &p_session->params;
+  mm_jpeg_encode_job_t *p_jobparams = &p_session->encode_job;
+  mm_jpeg_buf_t *p_dst = &p_params->dest_buf[p_jobparams->dst_index];
+  mm_jpeg_output_t output_buf;
+  uint8_t *p_out = NULL;
+  size_t out_len = 0;
+  int32_t rc = -1;
+
+  if (!mm_jpeg_sw_is_aborted(p_session)) {
+    rc = mm_jpeg_sw_enc_encode(&my_obj->sw_enc, &p_session->sw_job, &p_out,
+      &out_len);
+  }
+
+  pthread_mutex_lock(&p_session->lock);
+  if (MM_JPEG_ABORT_NONE != p_session->abort_state) {
+    CDBG_HIGH("%s:%d] sw encode aborted", __func__, __LINE__);
+    if ((0 == rc) && (NULL != p_params->get_memory)) {
+      p_params->put_memory((omx_jpeg_ouput_buf_t *)p_dst->buf_vaddr);
+    }
+    mm_jpegenc_job_done(p_session);
+    p_session->abort_state = MM_JPEG_ABORT_DONE;
+    pthread_cond_signal(&p_session->cond);
+    pthread_mutex_unlock(&p_session->lock);
+    return;
+  }
+
+  if (rc) {
+    CDBG_ERROR("%s:%d] sw encode failed", __func__, __LINE__);
+    p_session->job_status = JPEG_JOB_STATUS_ERROR;
+  } else {
+    CDBG_HIGH("%s:%d] sw encoded %dx%d rot %d into %zu bytes", __func__,
+      __LINE__, p_jobparams->main_dim.src_dim.width,
+      p_jobparams->main_dim.src_dim.height, p_jobparams->rotation, out_len);
+    p_session->fbd_count++;
+    p_session->job_status = JPEG_JOB_STATUS_DONE;
+  }
+  if (NULL != p_params->jpeg_cb) {
+    output_buf.buf_filled_len = out_len;
+    output_buf.buf_vaddr = (NULL != p_params->get_memory) ?
+      p_dst->buf_vaddr : p_out;
+    output_buf.fd = 0;
+    p_params->jpeg_cb(p_session->job_status,
+      p_session->client_hdl,
+      p_session->jobId,
+      rc ? NULL : &output_buf,
+      p_params->userdata);
+  }
+  mm_jpegenc_job_done(p_session);
+  pthread_mutex_unlock(&p_session->lock);
+}
+
+/** mm_jpeg_sw_job_thread:
+ *
+ *  Arguments:
+ *    @data: jpeg object
+ *
+ *  Return:
+ *       NULL
+ *
+ *  Description:
+ *       Runs the queued sw encodes one at a time without holding
+ *       job_lock, so abort and destroy are not held up by an encode. A
+ *       NULL session stops the thread.
+ *
+ **/
+static void *mm_jpeg_sw_job_thread(void *data)
+{
+  mm_jpeg_obj *my_obj = (mm_jpeg_obj *)data;
+  mm_jpeg_job_cmd_thread_t *cmd_thread = &my_obj->sw_job_mgr;
+  mm_jpeg_q_data_t qdata;
+  int rc;
+
+  prctl(PR_SET_NAME, (unsigned long)"mm_jpeg_sw", 0, 0, 0);
+  for (;;) {
+    do {
+      rc = cam_sem_wait(&cmd_thread->job_sem);
+      if (rc != 0 && errno != EINVAL) {
+        CDBG_ERROR("%s: cam_sem_wait error (%s)",
+          __func__, strerror(errno));
+        return NULL;
+      }
+    } while (rc != 0);
+
+    qdata = mm_jpeg_queue_deq(&cmd_thread->job_queue);
+    if (NULL == qdata.p) {
+      break;
+    }
+    mm_jpeg_session_run_sw(my_obj, (mm_jpeg_job_session_t *)qdata.p);
+  }
+  return NULL;
+}
+
+/** mm_jpeg_sw_enc_start:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *
+ *  Return:
+ *       0 for success -1 otherwise
+ *
+ *  Description:
+ *       Start the software encoder pool and its job thread on first use
+ *
+ **/
+static int32_t mm_jpeg_sw_enc_start(mm_jpeg_obj *my_obj)
+{
+  mm_jpeg_job_cmd_thread_t *cmd_thread = &my_obj->sw_job_mgr;
+  uint32_t num_threads = my_obj->sw_enc_threads;
+  long num_cpus;
+
+  if (OMX_TRUE == my_obj->sw_enc_ready) {
+    return 0;
+  }
+  if (0 == num_threads) {
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = (num_cpus > 0) ? (uint32_t)num_cpus : 1;
+  }
+  if (mm_jpeg_sw_enc_init(&my_obj->sw_enc, num_threads)) {
+    CDBG_ERROR("%s:%d] sw encoder init failed", __func__, __LINE__);
+    return -1;
+  }
+
+  cam_sem_init(&cmd_thread->job_sem, 0);
+  mm_jpeg_queue_init(&cmd_thread->job_queue);
+  if (pthread_create(&cmd_thread->pid, NULL, mm_jpeg_sw_job_thread,
+    (void *)my_obj)) {
+    CDBG_ERROR("%s:%d] sw job thread launch failed", __func__, __LINE__);
+    mm_jpeg_queue_deinit(&cmd_thread->job_queue);
+    cam_sem_destroy(&cmd_thread->job_sem);
+    mm_jpeg_sw_enc_deinit(&my_obj->sw_enc);
+    return -1;
+  }
+  pthread_setname_np(cmd_thread->pid, "CAM_jpeg_sw");
+
+  CDBG_HIGH("%s:%d] sw encoder started with %d threads", __func__, __LINE__,
+    my_obj->sw_enc.num_threads);
+  my_obj->sw_enc_ready = OMX_TRUE;
+  return 0;
+}
+
+/** mm_jpeg_sw_enc_stop:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Stop the sw job thread and the encoder pool
+ *
+ **/
+static void mm_jpeg_sw_enc_stop(mm_jpeg_obj *my_obj)
+{
+  mm_jpeg_job_cmd_thread_t *cmd_thread = &my_obj->sw_job_mgr;
+  mm_jpeg_q_data_t qdata;
+
+  if (OMX_TRUE != my_obj->sw_enc_ready) {
+    return;
+  }
+
+  qdata.p = NULL;
+  mm_jpeg_queue_enq(&cmd_thread->job_queue, qdata);
+  cam_sem_post(&cmd_thread->job_sem);
+  if (pthread_join(cmd_thread->pid, NULL) != 0) {
+    CDBG("%s: pthread dead already", __func__);
+  }
+  mm_jpeg_queue_deinit(&cmd_thread->job_queue);
+  cam_sem_destroy(&cmd_thread->job_sem);
+  memset(cmd_thread, 0, sizeof(mm_jpeg_job_cmd_thread_t));
+
+  mm_jpeg_sw_enc_deinit(&my_obj->sw_enc);
+  my_obj->sw_enc_ready = OMX_FALSE;
+}
+
+/** mm_jpeg_session_encode_sw:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @p_session: encode session, job params set
+ *
+ *  Return:
+ *       OMX_ERRORTYPE
+ *
+ *  Description:
+ *       Set up the software encode of the job and queue it to the sw
+ *       job thread, which completes it like mm_jpeg_fbd does for OMX.
+ *       The main image is coded on the encoder pool, so the latency
+ *       scales with the cores. On failure the caller reports the error.
+ *
+ **/
+static OMX_ERRORTYPE mm_jpeg_session_encode_sw(mm_jpeg_obj *my_obj,
+  mm_jpeg_job_session_t *p_session)
+{
+  mm_jpeg_encode_params_t *p_params = &p_session->params;
+  mm_jpeg_encode_job_t *p_jobparams = &p_session->encode_job;
+  mm_jpeg_buf_t *p_dst = &p_params->dest_buf[p_jobparams->dst_index];
+  mm_jpeg_sw_job_t *p_sw_job = &p_session->sw_job;
+  mm_jpeg_exif_table_t exif_table;
+  mm_jpeg_q_data_t qdata;
+
+  pthread_mutex_lock(&p_session->lock);
+  p_session->abort_state = MM_JPEG_ABORT_NONE;
+  p_session->encoding = OMX_FALSE;
+  pthread_mutex_unlock(&p_session->lock);
+
+  if (mm_jpeg_sw_enc_start(my_obj)) {
+    return OMX_ErrorInsufficientResources;
+  }
+
+  memset(p_sw_job, 0, sizeof(*p_sw_job));
+  if (mm_jpeg_sw_fill_image(&p_params->src_main_buf[p_jobparams->src_index],
+    &p_jobparams->main_dim, p_params->color_format, p_jobparams->rotation,
+    &p_sw_job->main)) {
+    return OMX_ErrorBadParameter;
+  }
+  p_sw_job->quality = p_params->quality;
+
+  if (p_params->encode_thumbnail) {
+    mm_jpeg_dim_t thumb_dim = p_jobparams->thumb_dim;
+    /* no upscaling, same as the OMX thumbnail config */
+    if ((thumb_dim.dst_dim.width > thumb_dim.src_dim.width) ||
+      (thumb_dim.dst_dim.height > thumb_dim.src_dim.height)) {
+      thumb_dim.dst_dim = thumb_dim.src_dim;
+    }
+    if (mm_jpeg_sw_fill_image(
+      &p_params->src_thumb_buf[p_jobparams->thumb_index], &thumb_dim,
+      p_params->thumb_color_format, p_params->thumb_rotation,
+      &p_sw_job->thumb)) {
+      return OMX_ErrorBadParameter;
+    }
+    p_sw_job->encode_thumbnail = 1;
+    p_sw_job->thumb_quality = p_params->thumb_quality ?
+      p_params->thumb_quality : p_params->quality;
+  }
+
+  /* exif tags from the HAL, then the ones parsed from the metadata */
+  p_sw_job->exif[0].entries =
+    (const mm_jpeg_sw_exif_tag_t *)p_jobparams->exif_info.exif_data;
+  p_sw_job->exif[0].count = (uint32_t)p_jobparams->exif_info.numOfEntries;
+  memset(&p_session->exif_info_local[0], 0, sizeof(p_session->exif_info_local));
+  if (NULL != p_jobparams->p_metadata) {
+    mm_jpeg_exif_table_init(&exif_table, p_session->exif_info_local,
+      p_session->exif_pool, sizeof(p_session->exif_pool));
+    process_meta_data(p_jobparams->p_metadata, &exif_table,
+      &p_jobparams->cam_exif_params);
+    p_session->exif_count_local = (int)exif_table.info.numOfEntries;
+    p_sw_job->exif[1].entries =
+      (const mm_jpeg_sw_exif_tag_t *)p_session->exif_info_local;
+    p_sw_job->exif[1].count = (uint32_t)exif_table.info.numOfEntries;
+  }
+  /* same tags every shot, only the changed values are rewritten */
+  p_sw_job->exif_tmpl = &p_session->sw_exif_tmpl;
+
+  if (NULL != p_params->get_memory) {
+    p_sw_job->alloc_out = mm_jpeg_sw_get_memory;
+  } else {
+    p_sw_job->out = p_dst->buf_vaddr;
+    p_sw_job->out_size = p_dst->buf_size;
+  }
+  p_sw_job->is_aborted = mm_jpeg_sw_is_aborted;
+  p_sw_job->user_data = p_session;
+
+  /* abort waits for the sw job thread from here on */
+  pthread_mutex_lock(&p_session->lock);
+  p_session->encoding = OMX_TRUE;
+  pthread_mutex_unlock(&p_session->lock);
+
+  qdata.p = p_session;
+  if (mm_jpeg_queue_enq(&my_obj->sw_job_mgr.job_queue, qdata)) {
+    pthread_mutex_lock(&p_session->lock);
+    p_session->encoding = OMX_FALSE;
+    pthread_mutex_unlock(&p_session->lock);
+    return OMX_ErrorInsufficientResources;
+  }
+  cam_sem_post(&my_obj->sw_job_mgr.job_sem);
+
+  return OMX_ErrorNone;
+}
+
 /** mm_jpeg_process_encoding_job:
  *
  *  Arguments:
@@ -1518,7 +1984,11 @@ int32_t mm_jpeg_process_encoding_job(mm_jpeg_obj *my_obj, mm_jpeg_job_q_node_t*
 
   p_session->encode_job = job_node->enc_info.encode_job;
   p_session->jobId = job_node->enc_info.job_id;
-  ret = mm_jpeg_session_encode(p_session);
+  if (OMX_TRUE == p_session->use_sw_enc) {
+    ret = mm_jpeg_session_encode_sw(my_obj, p_session);
+  } else {
+    ret = mm_jpeg_session_encode(p_session);
+  }
   if (ret) {
     CDBG_ERROR("%s:%d] encode session failed", __func__, __LINE__);
     goto error;
@@ -1737,13 +2207,14 @@ int32_t mm_jpeg_init(mm_jpeg_obj *my_obj)
     return -1;
   }
 
-  /* load OMX */
-  if (OMX_ErrorNone != OMX_Init()) {
-    /* roll back in error case */
-    CDBG_ERROR("%s:%d] OMX_Init failed (%d)", __func__, __LINE__, rc);
-    mm_jpeg_jobmgr_thread_release(my_obj);
-    mm_jpeg_queue_deinit(&my_obj->ongoing_job_q);
-    pthread_mutex_destroy(&my_obj->job_lock);
+  /* load OMX, sessions fall back to the sw encoder without it */
+  my_obj->omx_loaded = OMX_FALSE;
+  if (MM_JPEG_SW_ENC_FORCE == my_obj->sw_enc_mode) {
+    CDBG_HIGH("%s:%d] sw encoder forced", __func__, __LINE__);
+  } else if (OMX_ErrorNone != OMX_Init()) {
+    CDBG_ERROR("%s:%d] OMX_Init failed, using sw encoder", __func__, __LINE__);
+  } else {
+    my_obj->omx_loaded = OMX_TRUE;
   }
 
 #ifdef LOAD_ADSP_RPC_LIB
@@ -1782,7 +2253,12 @@ int32_t mm_jpeg_deinit(mm_jpeg_obj *my_obj)
   }
 
   /* unload OMX engine */
-  OMX_Deinit();
+  if (OMX_TRUE == my_obj->omx_loaded) {
+    OMX_Deinit();
+    my_obj->omx_loaded = OMX_FALSE;
+  }
+
+  mm_jpeg_sw_enc_stop(my_obj);
 
   /* deinit ongoing job and cb queue */
   rc = mm_jpeg_queue_deinit(&my_obj->ongoing_job_q);
@@ -1913,73 +2389,76 @@ int32_t mm_jpeg_start_job(mm_jpeg_obj *my_obj,
   p_session->work_buffer.ion_info_fd.fd = p_jobparams->work_buf.fd;
   p_session->work_buffer.p_pmem_fd      = p_jobparams->work_buf.fd;
 
-  prev_width = my_obj->prev_w;
-  prev_height = my_obj->prev_h;
+  /* the work buffer is scratch memory of the OMX encoder only */
+  if (OMX_TRUE != p_session->use_sw_enc) {
+    prev_width = my_obj->prev_w;
+    prev_height = my_obj->prev_h;
 
-  curr_width = p_jobparams->main_dim.src_dim.width;
-  curr_height = p_jobparams->main_dim.src_dim.height;
+    curr_width = p_jobparams->main_dim.src_dim.width;
+    curr_height = p_jobparams->main_dim.src_dim.height;
 
-  work_bufs_need = my_obj->num_sessions + NUM_OMX_SESSIONS;
+    work_bufs_need = my_obj->num_sessions + NUM_OMX_SESSIONS;
 
-  if (work_bufs_need > MM_JPEG_CONCURRENT_SESSIONS_COUNT) {
-    work_bufs_need = MM_JPEG_CONCURRENT_SESSIONS_COUNT;
-  }
-
-  if (p_session->work_buffer.addr) {
-    work_bufs_need--;
-    /* release if there are any work buffers already allocated */
-    while (my_obj->work_buf_cnt) {
-      buffer_deallocate(&my_obj->ionBuffer[my_obj->work_buf_cnt]);
-      my_obj->work_buf_cnt--;
-    }
-    CDBG_HIGH("%s:%d] HAL passed the work buffer of size = %d; don't alloc internally",
-      __func__, __LINE__, p_session->work_buffer.size);
-  } else {
-    p_session->work_buffer = my_obj->ionBuffer[0];
-
-    CDBG_HIGH("%s:%d] work_bufs_need %d work_buf_cnt %d", __func__, __LINE__,
-      work_bufs_need, my_obj->work_buf_cnt);
-
-    if (my_obj->work_buf_cnt > work_bufs_need) {
-      CDBG_ERROR("%s: %d] Unexpected work buffer count", __func__, __LINE__);
-      return rc;
+    if (work_bufs_need > MM_JPEG_CONCURRENT_SESSIONS_COUNT) {
+      work_bufs_need = MM_JPEG_CONCURRENT_SESSIONS_COUNT;
     }
 
-    if ((my_obj->work_buf_cnt == work_bufs_need) &&
-        ((curr_width * curr_height) != (prev_width * prev_height))) {
-      CDBG_HIGH("%s: %d] curr_width %d curr_height %d prev_width %d prev_height %d",
-        __func__, __LINE__, curr_width, curr_height, prev_width, prev_height);
-      /* resolution changed, release the previously allocated work buffer */
+    if (p_session->work_buffer.addr) {
+      work_bufs_need--;
+      /* release if there are any work buffers already allocated */
       while (my_obj->work_buf_cnt) {
         buffer_deallocate(&my_obj->ionBuffer[my_obj->work_buf_cnt]);
         my_obj->work_buf_cnt--;
       }
-    }
-    my_obj->prev_w = curr_width;
-    my_obj->prev_h = curr_height;
-    work_buf_size = CEILING64(curr_width) *
-      CEILING64(curr_height) * 3 / 2;
-  }
+      CDBG_HIGH("%s:%d] HAL passed the work buffer of size = %zu; don't alloc internally",
+        __func__, __LINE__, p_session->work_buffer.size);
+    } else {
+      p_session->work_buffer = my_obj->ionBuffer[0];
 
-  CDBG_HIGH("%s:%d] >>>> Work bufs need %d, %d", __func__, __LINE__,
-    work_bufs_need, my_obj->work_buf_cnt);
+      CDBG_HIGH("%s:%d] work_bufs_need %d work_buf_cnt %d", __func__, __LINE__,
+        work_bufs_need, my_obj->work_buf_cnt);
 
-  for (i = my_obj->work_buf_cnt; i < work_bufs_need; i++) {
-     my_obj->ionBuffer[i].size = CEILING32(work_buf_size);
-     CDBG_HIGH("%s: Picture size %d x %d, WorkBufSize = %zu",__func__,
-         curr_width, curr_height, my_obj->ionBuffer[i].size);
+      if (my_obj->work_buf_cnt > work_bufs_need) {
+        CDBG_ERROR("%s: %d] Unexpected work buffer count", __func__, __LINE__);
+        return rc;
+      }
+
+      if ((my_obj->work_buf_cnt == work_bufs_need) &&
+          ((curr_width * curr_height) != (prev_width * prev_height))) {
+        CDBG_HIGH("%s: %d] curr_width %d curr_height %d prev_width %d prev_height %d",
+          __func__, __LINE__, curr_width, curr_height, prev_width, prev_height);
+        /* resolution changed, release the previously allocated work buffer */
+        while (my_obj->work_buf_cnt) {
+          buffer_deallocate(&my_obj->ionBuffer[my_obj->work_buf_cnt]);
+          my_obj->work_buf_cnt--;
+        }
+      }
+      my_obj->prev_w = curr_width;
+      my_obj->prev_h = curr_height;
+      work_buf_size = CEILING64(curr_width) *
+        CEILING64(curr_height) * 3 / 2;
+    }
 
-     my_obj->ionBuffer[i].addr = (uint8_t *)buffer_allocate(&my_obj->ionBuffer[i], 1);
-     my_obj->work_buf_cnt++;
-     if (NULL == my_obj->ionBuffer[i].addr) {
-       CDBG_ERROR("%s:%d] Ion allocation failed",__func__, __LINE__);
-       while (i--) {
-         buffer_deallocate(&my_obj->ionBuffer[i]);
-         my_obj->work_buf_cnt--;
-       }
-       return -1;
-     } else
-         p_session->work_buffer = my_obj->ionBuffer[i];
+    CDBG_HIGH("%s:%d] >>>> Work bufs need %d, %d", __func__, __LINE__,
+      work_bufs_need, my_obj->work_buf_cnt);
+
+    for (i = my_obj->work_buf_cnt; i < work_bufs_need; i++) {
+       my_obj->ionBuffer[i].size = CEILING32(work_buf_size);
+       CDBG_HIGH("%s: Picture size %d x %d, WorkBufSize = %zu",__func__,
+           curr_width, curr_height, my_obj->ionBuffer[i].size);
+
+       my_obj->ionBuffer[i].addr = (uint8_t *)buffer_allocate(&my_obj->ionBuffer[i], 1);
+       my_obj->work_buf_cnt++;
+       if (NULL == my_obj->ionBuffer[i].addr) {
+         CDBG_ERROR("%s:%d] Ion allocation failed",__func__, __LINE__);
+         while (i--) {
+           buffer_deallocate(&my_obj->ionBuffer[i]);
+           my_obj->work_buf_cnt--;
+         }
+         return -1;
+       } else
+           p_session->work_buffer = my_obj->ionBuffer[i];
+    }
   }
 
   if (OMX_FALSE == p_session->active) {
@@ -2298,20 +2777,14 @@ error2:
 static int32_t mm_jpegenc_destroy_job(mm_jpeg_job_session_t *p_session)
 {
   mm_jpeg_encode_job_t *p_jobparams = &p_session->encode_job;
-  int i = 0, rc = 0;
 
   CDBG_ERROR("%s:%d] Exif entry count %d %d", __func__, __LINE__,
     (int)p_jobparams->exif_info.numOfEntries,
     (int)p_session->exif_count_local);
-  for (i = 0; i < p_session->exif_count_local; i++) {
-    rc = releaseExifEntry(&p_session->exif_info_local[i]);
-    if (rc) {
-      CDBG_ERROR("%s:%d] Exif release failed (%d)", __func__, __LINE__, rc);
-    }
-  }
+  /* the tag values live in the session pool, nothing to free */
   p_session->exif_count_local = 0;
 
-  return rc;
+  return 0;
 }
 
 /** mm_jpeg_session_encode:
@@ -45,11 +45,35 @@
 #define AWB_EXIF_SIZE       4
 #define AF_EXIF_SIZE        2
 
+/** mm_jpeg_exif_table_init:
+ *
+ *  Arguments:
+ *   @p_table : table to set up
+ *   @p_entries: MAX_EXIF_TABLE_ENTRIES tags
+ *   @p_pool  : storage for the values, 8 byte aligned
+ *   @pool_size: size of @p_pool in bytes
+ *
+ *  Return     : none
+ *
+ *  Description:
+ *       Start an empty table on top of caller owned storage, which is
+ *       reused by the next job without freeing anything
+ *
+ **/
+void mm_jpeg_exif_table_init(mm_jpeg_exif_table_t *p_table,
+  QEXIF_INFO_DATA *p_entries, void *p_pool, uint32_t pool_size)
+{
+  p_table->info.numOfEntries = 0;
+  p_table->info.exif_data = p_entries;
+  p_table->pool = (uint8_t *)p_pool;
+  p_table->pool_size = pool_size;
+  p_table->pool_used = 0;
+}
+
 /** addExifEntry:
  *
  *  Arguments:
- *   @exif_info : Exif info struct
- *   @p_session: job session
+ *   @p_table : Exif table
  *   @tagid   : exif tag ID
  *   @type    : data type
  *   @count   : number of data in uint of its type
@@ -60,227 +84,75 @@
  *              none-zero failure code
  *
  *  Description:
- *       Function to add an entry to exif data
+ *       Function to add an entry to exif data. Single numbers are
+ *       stored in the entry, strings and arrays in the table pool.
  *
  **/
-int32_t addExifEntry(QOMX_EXIF_INFO *p_exif_info, exif_tag_id_t tagid,
+int32_t addExifEntry(mm_jpeg_exif_table_t *p_table, exif_tag_id_t tagid,
   exif_tag_type_t type, uint32_t count, void *data)
 {
-    int32_t rc = 0;
-    uint32_t numOfEntries = (uint32_t)p_exif_info->numOfEntries;
-    QEXIF_INFO_DATA *p_info_data = p_exif_info->exif_data;
+    uint32_t numOfEntries = (uint32_t)p_table->info.numOfEntries;
+    QEXIF_INFO_DATA *p_info_data;
+    uint32_t size, offset;
+    uint8_t *values;
+
     if(numOfEntries >= MAX_EXIF_TABLE_ENTRIES) {
         ALOGE("%s: Number of entries exceeded limit", __func__);
         return -1;
     }
+    p_info_data = &p_table->info.exif_data[numOfEntries];
 
-    p_info_data[numOfEntries].tag_id = tagid;
-    p_info_data[numOfEntries].tag_entry.type = type;
-    p_info_data[numOfEntries].tag_entry.count = count;
-    p_info_data[numOfEntries].tag_entry.copy = 1;
     switch (type) {
-    case EXIF_BYTE: {
-      if (count > 1) {
-        uint8_t *values = (uint8_t *)malloc(count);
-        if (values == NULL) {
-          ALOGE("%s: No memory for byte array", __func__);
-          rc = -1;
-        } else {
-          memcpy(values, data, count);
-          p_info_data[numOfEntries].tag_entry.data._bytes = values;
-        }
-      } else {
-        p_info_data[numOfEntries].tag_entry.data._byte = *(uint8_t *)data;
-      }
+    case EXIF_BYTE:
+    case EXIF_UNDEFINED:
+      size = count;
+      break;
+    case EXIF_ASCII:
+      size = count + 1;
+      break;
+    case EXIF_SHORT:
+      size = count * sizeof(uint16_t);
+      break;
+    case EXIF_LONG:
+    case EXIF_SLONG:
+      size = count * sizeof(uint32_t);
+      break;
+    case EXIF_RATIONAL:
+    case EXIF_SRATIONAL:
+      size = count * sizeof(rat_t);
+      break;
+    default:
+      ALOGE("%s: Unknown type %d", __func__, type);
+      return -1;
     }
-    break;
-    case EXIF_ASCII: {
-      char *str = NULL;
-      str = (char *)malloc(count + 1);
-      if (str == NULL) {
-        ALOGE("%s: No memory for ascii string", __func__);
-        rc = -1;
-      } else {
-        memset(str, 0, count + 1);
-        memcpy(str, data, count);
-        p_info_data[numOfEntries].tag_entry.data._ascii = str;
-      }
-    }
-    break;
-    case EXIF_SHORT: {
-      if (count > 1) {
-        uint16_t *values = (uint16_t *)malloc(count * sizeof(uint16_t));
-        if (values == NULL) {
-          ALOGE("%s: No memory for short array", __func__);
-          rc = -1;
-        } else {
-          memcpy(values, data, count * sizeof(uint16_t));
-          p_info_data[numOfEntries].tag_entry.data._shorts = values;
-        }
-      } else {
-        p_info_data[numOfEntries].tag_entry.data._short = *(uint16_t *)data;
-      }
-    }
-    break;
-    case EXIF_LONG: {
-      if (count > 1) {
-        uint32_t *values = (uint32_t *)malloc(count * sizeof(uint32_t));
-        if (values == NULL) {
-          ALOGE("%s: No memory for long array", __func__);
-          rc = -1;
-        } else {
-          memcpy(values, data, count * sizeof(uint32_t));
-          p_info_data[numOfEntries].tag_entry.data._longs = values;
-        }
-      } else {
-        p_info_data[numOfEntries].tag_entry.data._long = *(uint32_t *)data;
-      }
-    }
-    break;
-    case EXIF_RATIONAL: {
-      if (count > 1) {
-        rat_t *values = (rat_t *)malloc(count * sizeof(rat_t));
-        if (values == NULL) {
-          ALOGE("%s: No memory for rational array", __func__);
-          rc = -1;
-        } else {
-          memcpy(values, data, count * sizeof(rat_t));
-          p_info_data[numOfEntries].tag_entry.data._rats = values;
-        }
-      } else {
-        p_info_data[numOfEntries].tag_entry.data._rat = *(rat_t *)data;
+
+    p_info_data->tag_id = tagid;
+    p_info_data->tag_entry.type = type;
+    p_info_data->tag_entry.count = count;
+    p_info_data->tag_entry.copy = 1;
+    if (count <= 1 && EXIF_ASCII != type && EXIF_UNDEFINED != type) {
+      memcpy(&p_info_data->tag_entry.data, data, size);
+    } else {
+      offset = (p_table->pool_used + 7) & ~7U;
+      if (offset + size > p_table->pool_size) {
+        ALOGE("%s: No room for tag 0x%x", __func__, tagid);
+        return -1;
       }
-    }
-    break;
-    case EXIF_UNDEFINED: {
-      uint8_t *values = (uint8_t *)malloc(count);
-      if (values == NULL) {
-        ALOGE("%s: No memory for undefined array", __func__);
-        rc = -1;
-      } else {
+      values = p_table->pool + offset;
+      if (EXIF_ASCII == type) {
         memcpy(values, data, count);
-        p_info_data[numOfEntries].tag_entry.data._undefined = values;
-      }
-    }
-    break;
-    case EXIF_SLONG: {
-      if (count > 1) {
-        int32_t *values = (int32_t *)malloc(count * sizeof(int32_t));
-        if (values == NULL) {
-          ALOGE("%s: No memory for signed long array", __func__);
-          rc = -1;
-        } else {
-          memcpy(values, data, count * sizeof(int32_t));
-          p_info_data[numOfEntries].tag_entry.data._slongs = values;
-        }
-      } else {
-        p_info_data[numOfEntries].tag_entry.data._slong = *(int32_t *)data;
-      }
-    }
-    break;
-    case EXIF_SRATIONAL: {
-      if (count > 1) {
-        srat_t *values = (srat_t *)malloc(count * sizeof(srat_t));
-        if (values == NULL) {
-          ALOGE("%s: No memory for signed rational array", __func__);
-          rc = -1;
-        } else {
-          memcpy(values, data, count * sizeof(srat_t));
-          p_info_data[numOfEntries].tag_entry.data._srats = values;
-        }
+        values[count] = '\0';
       } else {
-        p_info_data[numOfEntries].tag_entry.data._srat = *(srat_t *)data;
+        memcpy(values, data, size);
       }
-    }
-    break;
+      /* all the pointer members share the same storage */
+      p_info_data->tag_entry.data._bytes = values;
+      p_table->pool_used = offset + size;
     }
 
     // Increase number of entries
-    p_exif_info->numOfEntries++;
-    return rc;
-}
-
-/** releaseExifEntry
- *
- *  Arguments:
- *   @p_exif_data : Exif info struct
- *
- *  Retrun     : int32_t type of status
- *               0  -- success
- *              none-zero failure code
- *
- *  Description:
- *       Function to release an entry from exif data
- *
- **/
-int32_t releaseExifEntry(QEXIF_INFO_DATA *p_exif_data)
-{
- switch (p_exif_data->tag_entry.type) {
-  case EXIF_BYTE: {
-    if (p_exif_data->tag_entry.count > 1 &&
-      p_exif_data->tag_entry.data._bytes != NULL) {
-      free(p_exif_data->tag_entry.data._bytes);
-      p_exif_data->tag_entry.data._bytes = NULL;
-    }
-  }
-  break;
-  case EXIF_ASCII: {
-    if (p_exif_data->tag_entry.data._ascii != NULL) {
-      free(p_exif_data->tag_entry.data._ascii);
-      p_exif_data->tag_entry.data._ascii = NULL;
-    }
-  }
-  break;
-  case EXIF_SHORT: {
-    if (p_exif_data->tag_entry.count > 1 &&
-      p_exif_data->tag_entry.data._shorts != NULL) {
-      free(p_exif_data->tag_entry.data._shorts);
-      p_exif_data->tag_entry.data._shorts = NULL;
-    }
-  }
-  break;
-  case EXIF_LONG: {
-    if (p_exif_data->tag_entry.count > 1 &&
-      p_exif_data->tag_entry.data._longs != NULL) {
-      free(p_exif_data->tag_entry.data._longs);
-      p_exif_data->tag_entry.data._longs = NULL;
-    }
-  }
-  break;
-  case EXIF_RATIONAL: {
-    if (p_exif_data->tag_entry.count > 1 &&
-      p_exif_data->tag_entry.data._rats != NULL) {
-      free(p_exif_data->tag_entry.data._rats);
-      p_exif_data->tag_entry.data._rats = NULL;
-    }
-  }
-  break;
-  case EXIF_UNDEFINED: {
-    if (p_exif_data->tag_entry.data._undefined != NULL) {
-      free(p_exif_data->tag_entry.data._undefined);
-      p_exif_data->tag_entry.data._undefined = NULL;
-    }
-  }
-  break;
-  case EXIF_SLONG: {
-    if (p_exif_data->tag_entry.count > 1 &&
-      p_exif_data->tag_entry.data._slongs != NULL) {
-      free(p_exif_data->tag_entry.data._slongs);
-      p_exif_data->tag_entry.data._slongs = NULL;
-    }
-  }
-  break;
-  case EXIF_SRATIONAL: {
-    if (p_exif_data->tag_entry.count > 1 &&
-      p_exif_data->tag_entry.data._srats != NULL) {
-      free(p_exif_data->tag_entry.data._srats);
-      p_exif_data->tag_entry.data._srats = NULL;
-    }
-  }
-  break;
-  } /*end of switch*/
-
-  return 0;
+    p_table->info.numOfEntries++;
+    return 0;
 }
 
 /** process_sensor_data:
@@ -298,7 +170,7 @@ int32_t releaseExifEntry(QEXIF_INFO_DATA *p_exif_data)
  *  Notes: this needs to be filled for the metadata
  **/
 int process_sensor_data(cam_sensor_params_t *p_sensor_params,
-  QOMX_EXIF_INFO *exif_info, mm_jpeg_exif_params_t *p_cam_exif_params)
+  mm_jpeg_exif_table_t *exif_info, mm_jpeg_exif_params_t *p_cam_exif_params)
 {
   int rc = 0;
   rat_t val_rat;
@@ -414,7 +286,7 @@ int process_sensor_data(cam_sensor_params_t *p_sensor_params,
  *  Notes: this needs to be filled for the metadata
  **/
 int process_3a_data(cam_ae_params_t *p_ae_params, cam_awb_params_t *p_awb_params,
-        cam_auto_focus_data_t *p_focus_data, QOMX_EXIF_INFO *exif_info)
+        cam_auto_focus_data_t *p_focus_data, mm_jpeg_exif_table_t *exif_info)
 {
   int rc = 0;
   srat_t val_srat;
@@ -588,7 +460,7 @@ int process_3a_data(cam_ae_params_t *p_ae_params, cam_awb_params_t *p_awb_params
  *
  *  Notes: this needs to be filled for the metadata
  **/
-int process_meta_data(cam_metadata_info_t *p_meta, QOMX_EXIF_INFO *exif_info,
+int process_meta_data(cam_metadata_info_t *p_meta, mm_jpeg_exif_table_t *exif_info,
   mm_jpeg_exif_params_t *p_cam_exif_params)
 {
   int rc = 0;
@@ -333,6 +333,13 @@ uint32_t jpeg_open(mm_jpeg_ops_t *ops, mm_dimension picture_size)
     jpeg_obj->max_pic_w = picture_size.w;
     jpeg_obj->max_pic_h = picture_size.h;
 
+    /* 1 forces the sw encoder, otherwise it is only used without OMX */
+    property_get("persist.camera.jpeg.swenc", prop, "0");
+    jpeg_obj->sw_enc_mode = (atoi(prop) == 1) ?
+      MM_JPEG_SW_ENC_FORCE : MM_JPEG_SW_ENC_AUTO;
+    property_get("persist.camera.jpeg.swenc.threads", prop, "0");
+    jpeg_obj->sw_enc_threads = (uint32_t)atoi(prop);
+
     rc = mm_jpeg_init(jpeg_obj);
     if(0 != rc) {
       CDBG_ERROR("%s:%d] mm_jpeg_init err = %d", __func__, __LINE__, rc);
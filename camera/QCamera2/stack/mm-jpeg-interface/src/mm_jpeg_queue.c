@@ -142,6 +142,8 @@ int32_t mm_jpeg_queue_flush(mm_jpeg_queue_t* queue)
 
     while(pos != head) {
         node = member_of(pos, mm_jpeg_q_node_t, list);
+        /* step on before the node is unlinked and freed */
+        pos = pos->next;
         cam_list_del_node(&node->list);
         queue->size--;
 
@@ -151,7 +153,6 @@ int32_t mm_jpeg_queue_flush(mm_jpeg_queue_t* queue)
             free(node->data.p);
         }
         free(node);
-        pos = pos->next;
     }
     queue->size = 0;
     pthread_mutex_unlock(&queue->lock);
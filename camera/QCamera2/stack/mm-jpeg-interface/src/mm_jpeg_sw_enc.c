@@ -0,0 +1,2056 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mm_jpeg_sw_enc.h"
+
+/* APP1 payload limit, the thumbnail is requantized until it fits */
+#define MM_JPEG_SW_APP1_MAX 65533
+/* bytes kept free in a strip buffer before coding an MCU, covers the
+ * worst case of six blocks with 0xFF stuffing */
+#define MM_JPEG_SW_MCU_MAX_BYTES 4096
+/* strips handed out per worker, evens out uneven strip cost */
+#define MM_JPEG_SW_STRIPS_PER_THREAD 4
+#define MM_JPEG_SW_MAX_TAPS 4
+#define MM_JPEG_SW_MAX_EXIF_TAGS 128
+
+#define EXIF_TAG_NUM(id) ((uint16_t)((id) & 0xffff))
+#define EXIF_TAG_OFFSET(id) ((id) >> 16)
+
+typedef struct {
+  uint16_t code[256];
+  uint8_t size[256];
+} mm_jpeg_sw_huff_t;
+
+typedef struct {
+  uint8_t *p;
+  size_t len;
+  size_t cap;
+  uint32_t acc;
+  uint32_t nbits;
+  mm_jpeg_sw_strip_t *strip;
+  int error;
+} mm_jpeg_sw_bits_t;
+
+/* one image coded by the pool: main image or thumbnail */
+typedef struct mm_jpeg_sw_frame {
+  const mm_jpeg_sw_image_t *img;
+  uint32_t jw;               /* coded width, after rotation */
+  uint32_t jh;
+  uint32_t mcu_cols;
+  uint32_t mcu_rows;
+  uint32_t rows_per_strip;
+  uint32_t num_strips;
+  uint32_t fast;             /* no scaling, no rotation */
+  uint32_t swap;             /* 90/270: columns walk source rows */
+  /* source taps per coded column and row, see mm_jpeg_sw_setup_maps */
+  uint32_t *col_map;
+  uint32_t *row_map;
+  uint32_t col_taps;
+  uint32_t row_taps;
+  uint8_t qt[2][64];         /* natural order */
+  float fdtbl[2][64];
+  mm_jpeg_sw_strip_t *strips;
+  int error;
+  const mm_jpeg_sw_job_t *job; /* abort hook, NULL if none */
+} mm_jpeg_sw_frame_t;
+
+typedef struct {
+  uint16_t tag;
+  uint16_t type;
+  uint32_t count;
+  const void *data;          /* host order values */
+  uint32_t ifd;
+  uint32_t value;            /* generated LONG/SHORT tags */
+  int32_t src;               /* index of the job tag, -1 if generated */
+} mm_jpeg_sw_tag_t;
+
+enum {
+  MM_JPEG_SW_IFD0,
+  MM_JPEG_SW_IFD_EXIF,
+  MM_JPEG_SW_IFD_GPS,
+  MM_JPEG_SW_IFD1,
+  MM_JPEG_SW_IFD_MAX
+};
+
+static const uint8_t zigzag[64] = {
+  0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const uint8_t std_luma_qt[64] = {
+  16, 11, 10, 16, 24, 40, 51, 61,
+  12, 12, 14, 19, 26, 58, 60, 55,
+  14, 13, 16, 24, 40, 57, 69, 56,
+  14, 17, 22, 29, 51, 87, 80, 62,
+  18, 22, 37, 56, 68, 109, 103, 77,
+  24, 35, 55, 64, 81, 104, 113, 92,
+  49, 64, 78, 87, 103, 121, 120, 101,
+  72, 92, 95, 98, 112, 100, 103, 99
+};
+
+static const uint8_t std_chroma_qt[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99,
+  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,
+  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/* Annex K.3 tables */
+static const uint8_t dc_luma_bits[16] = {
+  0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
+};
+static const uint8_t dc_chroma_bits[16] = {
+  0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
+};
+static const uint8_t dc_vals[12] = {
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+static const uint8_t ac_luma_bits[16] = {
+  0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d
+};
+static const uint8_t ac_luma_vals[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+  0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+  0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+  0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+  0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+  0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+  0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+  0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+  0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+  0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+  0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa
+};
+static const uint8_t ac_chroma_bits[16] = {
+  0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77
+};
+static const uint8_t ac_chroma_vals[162] = {
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+  0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+  0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+  0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+  0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+  0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+  0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+  0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+  0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+  0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4,
+  0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa
+};
+
+static const float aan_scale[8] = {
+  1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+  1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+/* 0: luma dc, 1: chroma dc, 2: luma ac, 3: chroma ac */
+static mm_jpeg_sw_huff_t g_huff[4];
+static pthread_once_t g_huff_once = PTHREAD_ONCE_INIT;
+
+/** mm_jpeg_sw_build_huff:
+ *
+ *  Arguments:
+ *    @bits: code counts per length
+ *    @vals: symbols
+ *    @p_huff: code table to fill, indexed by symbol
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Canonical code assignment of Annex C
+ *
+ **/
+static void mm_jpeg_sw_build_huff(const uint8_t *bits, const uint8_t *vals,
+  mm_jpeg_sw_huff_t *p_huff)
+{
+  uint32_t len, i, k = 0;
+  uint16_t code = 0;
+
+  memset(p_huff, 0, sizeof(*p_huff));
+  for (len = 1; len <= 16; len++) {
+    for (i = 0; i < bits[len - 1]; i++) {
+      p_huff->code[vals[k]] = code++;
+      p_huff->size[vals[k]] = (uint8_t)len;
+      k++;
+    }
+    code = (uint16_t)(code << 1);
+  }
+}
+
+static void mm_jpeg_sw_init_tables(void)
+{
+  mm_jpeg_sw_build_huff(dc_luma_bits, dc_vals, &g_huff[0]);
+  mm_jpeg_sw_build_huff(dc_chroma_bits, dc_vals, &g_huff[1]);
+  mm_jpeg_sw_build_huff(ac_luma_bits, ac_luma_vals, &g_huff[2]);
+  mm_jpeg_sw_build_huff(ac_chroma_bits, ac_chroma_vals, &g_huff[3]);
+}
+
+/** mm_jpeg_sw_setup_quant:
+ *
+ *  Arguments:
+ *    @p_frame: frame
+ *    @quality: 1..100
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Scale the Annex K tables the way libjpeg does and fold the AAN
+ *       output scaling into the reciprocal divisors
+ *
+ **/
+static void mm_jpeg_sw_setup_quant(mm_jpeg_sw_frame_t *p_frame,
+  uint32_t quality)
+{
+  uint32_t i, t;
+  int32_t scale, q;
+  const uint8_t *base;
+
+  if (quality < 1) {
+    quality = 1;
+  } else if (quality > 100) {
+    quality = 100;
+  }
+  scale = (quality < 50) ? (int32_t)(5000 / quality) :
+    (int32_t)(200 - quality * 2);
+
+  for (t = 0; t < 2; t++) {
+    base = t ? std_chroma_qt : std_luma_qt;
+    for (i = 0; i < 64; i++) {
+      q = (base[i] * scale + 50) / 100;
+      if (q < 1) {
+        q = 1;
+      } else if (q > 255) {
+        q = 255;
+      }
+      p_frame->qt[t][i] = (uint8_t)q;
+      p_frame->fdtbl[t][i] = 1.0f /
+        ((float)q * aan_scale[i >> 3] * aan_scale[i & 7] * 8.0f);
+    }
+  }
+}
+
+/** mm_jpeg_sw_taps:
+ *
+ *  Arguments:
+ *    @start: first source sample of the crop
+ *    @len: crop length
+ *    @out: scaled length
+ *    @o: output sample
+ *    @taps: samples per output
+ *    @p_map: filled with @taps source positions
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Spread the taps evenly over the source span of one output sample
+ *
+ **/
+static void mm_jpeg_sw_taps(uint32_t start, uint32_t len, uint32_t out,
+  uint32_t o, uint32_t taps, uint32_t *p_map)
+{
+  uint64_t s0 = (uint64_t)o * len / out;
+  uint64_t s1 = (uint64_t)(o + 1) * len / out;
+  uint32_t k;
+
+  if (s1 <= s0) {
+    s1 = s0 + 1;
+  }
+  for (k = 0; k < taps; k++) {
+    uint64_t s = s0 + ((2 * k + 1) * (s1 - s0)) / (2 * taps);
+    if (s >= len) {
+      s = len - 1;
+    }
+    p_map[k] = start + (uint32_t)s;
+  }
+}
+
+/** mm_jpeg_sw_setup_maps:
+ *
+ *  Arguments:
+ *    @p_frame: frame, img and coded size set
+ *
+ *  Return:
+ *       0 for success, -1 on allocation failure
+ *
+ *  Description:
+ *       Precompute the source taps for every coded column and row. For
+ *       0/180 degrees columns give source x and rows source y, for 90/270
+ *       it is the other way round (@swap).
+ *
+ **/
+static int32_t mm_jpeg_sw_setup_maps(mm_jpeg_sw_frame_t *p_frame)
+{
+  const mm_jpeg_sw_image_t *img = p_frame->img;
+  uint32_t ow = img->out_w, oh = img->out_h;
+  uint32_t x_taps, y_taps, j;
+
+  x_taps = img->crop_w / ow;
+  y_taps = img->crop_h / oh;
+  x_taps = (x_taps < 1) ? 1 : (x_taps > MM_JPEG_SW_MAX_TAPS) ?
+    MM_JPEG_SW_MAX_TAPS : x_taps;
+  y_taps = (y_taps < 1) ? 1 : (y_taps > MM_JPEG_SW_MAX_TAPS) ?
+    MM_JPEG_SW_MAX_TAPS : y_taps;
+
+  p_frame->swap = (img->rotation == 90 || img->rotation == 270);
+  p_frame->col_taps = p_frame->swap ? y_taps : x_taps;
+  p_frame->row_taps = p_frame->swap ? x_taps : y_taps;
+  p_frame->col_map = malloc(p_frame->jw * p_frame->col_taps * sizeof(uint32_t));
+  p_frame->row_map = malloc(p_frame->jh * p_frame->row_taps * sizeof(uint32_t));
+  if (NULL == p_frame->col_map || NULL == p_frame->row_map) {
+    return -1;
+  }
+
+  for (j = 0; j < p_frame->jw; j++) {
+    uint32_t *p_map = &p_frame->col_map[j * p_frame->col_taps];
+    switch (img->rotation) {
+    case 90:
+      mm_jpeg_sw_taps(img->crop_y, img->crop_h, oh, oh - 1 - j, y_taps, p_map);
+      break;
+    case 180:
+      mm_jpeg_sw_taps(img->crop_x, img->crop_w, ow, ow - 1 - j, x_taps, p_map);
+      break;
+    case 270:
+      mm_jpeg_sw_taps(img->crop_y, img->crop_h, oh, j, y_taps, p_map);
+      break;
+    default:
+      mm_jpeg_sw_taps(img->crop_x, img->crop_w, ow, j, x_taps, p_map);
+      break;
+    }
+  }
+  for (j = 0; j < p_frame->jh; j++) {
+    uint32_t *p_map = &p_frame->row_map[j * p_frame->row_taps];
+    switch (img->rotation) {
+    case 90:
+      mm_jpeg_sw_taps(img->crop_x, img->crop_w, ow, j, x_taps, p_map);
+      break;
+    case 180:
+      mm_jpeg_sw_taps(img->crop_y, img->crop_h, oh, oh - 1 - j, y_taps, p_map);
+      break;
+    case 270:
+      mm_jpeg_sw_taps(img->crop_x, img->crop_w, ow, ow - 1 - j, x_taps, p_map);
+      break;
+    default:
+      mm_jpeg_sw_taps(img->crop_y, img->crop_h, oh, j, y_taps, p_map);
+      break;
+    }
+  }
+  return 0;
+}
+
+/** mm_jpeg_sw_fetch_mcu_fast:
+ *
+ *  Arguments:
+ *    @p_frame: frame
+ *    @mx, @my: MCU position
+ *    @y: 4 luma blocks, level shifted
+ *    @cb, @cr: chroma blocks, level shifted
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Unscaled, unrotated fetch straight from the planes. Samples
+ *       past the right and bottom edge repeat the last column and row.
+ *
+ **/
+static void mm_jpeg_sw_fetch_mcu_fast(const mm_jpeg_sw_frame_t *p_frame,
+  uint32_t mx, uint32_t my, float y[4][64], float *cb, float *cr)
+{
+  const mm_jpeg_sw_image_t *img = p_frame->img;
+  uint32_t x0 = mx * 16, y0 = my * 16;
+  uint32_t r, c, sx, sy;
+  uint32_t cb_off, cr_off;
+  uint32_t h2v1 = (img->fmt == MM_JPEG_SW_FMT_H2V1_CRCB ||
+    img->fmt == MM_JPEG_SW_FMT_H2V1_CBCR);
+  uint32_t xlim[16];
+
+  for (c = 0; c < 16; c++) {
+    sx = x0 + c;
+    xlim[c] = img->crop_x + ((sx < p_frame->jw) ? sx : p_frame->jw - 1);
+  }
+
+  for (r = 0; r < 16; r++) {
+    const uint8_t *p_row;
+    float *p_dst = &y[(r >> 3) * 2][(r & 7) * 8];
+    sy = y0 + r;
+    sy = img->crop_y + ((sy < p_frame->jh) ? sy : p_frame->jh - 1);
+    p_row = img->y + (size_t)sy * img->y_stride;
+    for (c = 0; c < 8; c++) {
+      p_dst[c] = (float)p_row[xlim[c]] - 128.0f;
+      p_dst[64 + c] = (float)p_row[xlim[c + 8]] - 128.0f;
+    }
+  }
+
+  if (img->fmt == MM_JPEG_SW_FMT_MONO) {
+    for (c = 0; c < 64; c++) {
+      cb[c] = 0.0f;
+      cr[c] = 0.0f;
+    }
+    return;
+  }
+
+  cr_off = (img->fmt == MM_JPEG_SW_FMT_H2V2_CRCB ||
+    img->fmt == MM_JPEG_SW_FMT_H2V1_CRCB) ? 0 : 1;
+  cb_off = 1 - cr_off;
+  for (r = 0; r < 8; r++) {
+    /* luma row of this chroma row */
+    sy = y0 + r * 2;
+    sy = img->crop_y + ((sy < p_frame->jh) ? sy : p_frame->jh - 1);
+    for (c = 0; c < 8; c++) {
+      const uint8_t *p_c;
+      sx = xlim[c * 2] & ~1U;
+      if (h2v1) {
+        /* 4:2:2 source, average the two chroma rows of the 4:2:0 sample */
+        uint32_t sy1 = (sy + 1 < img->crop_y + p_frame->jh) ? sy + 1 : sy;
+        const uint8_t *p_c1 = img->c + (size_t)sy1 * img->c_stride + sx;
+        p_c = img->c + (size_t)sy * img->c_stride + sx;
+        cb[r * 8 + c] = (float)((p_c[cb_off] + p_c1[cb_off] + 1) >> 1) - 128.0f;
+        cr[r * 8 + c] = (float)((p_c[cr_off] + p_c1[cr_off] + 1) >> 1) - 128.0f;
+      } else {
+        p_c = img->c + (size_t)(sy >> 1) * img->c_stride + sx;
+        cb[r * 8 + c] = (float)p_c[cb_off] - 128.0f;
+        cr[r * 8 + c] = (float)p_c[cr_off] - 128.0f;
+      }
+    }
+  }
+}
+
+/** mm_jpeg_sw_fetch_mcu_mapped:
+ *
+ *  Arguments:
+ *    @p_frame: frame
+ *    @mx, @my: MCU position
+ *    @y: 4 luma blocks, level shifted
+ *    @cb, @cr: chroma blocks, level shifted
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Scaled and/or rotated fetch through the tap maps. Each sample is
+ *       the mean of its taps, chroma uses the taps of the top left luma
+ *       sample of its 2x2 group.
+ *
+ **/
+static void mm_jpeg_sw_fetch_mcu_mapped(const mm_jpeg_sw_frame_t *p_frame,
+  uint32_t mx, uint32_t my, float y[4][64], float *cb, float *cr)
+{
+  const mm_jpeg_sw_image_t *img = p_frame->img;
+  uint32_t ct = p_frame->col_taps, rt = p_frame->row_taps;
+  float norm = 1.0f / (float)(ct * rt);
+  uint32_t r, c, i, k, jx, jy;
+  uint32_t h2v2 = (img->fmt == MM_JPEG_SW_FMT_H2V2_CRCB ||
+    img->fmt == MM_JPEG_SW_FMT_H2V2_CBCR);
+  uint32_t cr_off = (img->fmt == MM_JPEG_SW_FMT_H2V2_CRCB ||
+    img->fmt == MM_JPEG_SW_FMT_H2V1_CRCB) ? 0 : 1;
+
+  for (r = 0; r < 16; r++) {
+    jy = my * 16 + r;
+    if (jy >= p_frame->jh) {
+      jy = p_frame->jh - 1;
+    }
+    const uint32_t *p_rm = &p_frame->row_map[jy * rt];
+    for (c = 0; c < 16; c++) {
+      uint32_t sum = 0;
+      jx = mx * 16 + c;
+      if (jx >= p_frame->jw) {
+        jx = p_frame->jw - 1;
+      }
+      const uint32_t *p_cm = &p_frame->col_map[jx * ct];
+      for (i = 0; i < rt; i++) {
+        for (k = 0; k < ct; k++) {
+          uint32_t sx = p_frame->swap ? p_rm[i] : p_cm[k];
+          uint32_t sy = p_frame->swap ? p_cm[k] : p_rm[i];
+          sum += img->y[(size_t)sy * img->y_stride + sx];
+        }
+      }
+      y[(r >> 3) * 2 + (c >> 3)][(r & 7) * 8 + (c & 7)] =
+        (float)sum * norm - 128.0f;
+    }
+  }
+
+  if (img->fmt == MM_JPEG_SW_FMT_MONO) {
+    for (c = 0; c < 64; c++) {
+      cb[c] = 0.0f;
+      cr[c] = 0.0f;
+    }
+    return;
+  }
+
+  for (r = 0; r < 8; r++) {
+    jy = my * 16 + r * 2;
+    if (jy >= p_frame->jh) {
+      jy = p_frame->jh - 1;
+    }
+    const uint32_t *p_rm = &p_frame->row_map[jy * rt];
+    for (c = 0; c < 8; c++) {
+      uint32_t sum_cb = 0, sum_cr = 0;
+      jx = mx * 16 + c * 2;
+      if (jx >= p_frame->jw) {
+        jx = p_frame->jw - 1;
+      }
+      const uint32_t *p_cm = &p_frame->col_map[jx * ct];
+      for (i = 0; i < rt; i++) {
+        for (k = 0; k < ct; k++) {
+          uint32_t sx = p_frame->swap ? p_rm[i] : p_cm[k];
+          uint32_t sy = p_frame->swap ? p_cm[k] : p_rm[i];
+          const uint8_t *p_c = img->c +
+            (size_t)(h2v2 ? sy >> 1 : sy) * img->c_stride + (sx & ~1U);
+          sum_cr += p_c[cr_off];
+          sum_cb += p_c[1 - cr_off];
+        }
+      }
+      cb[r * 8 + c] = (float)sum_cb * norm - 128.0f;
+      cr[r * 8 + c] = (float)sum_cr * norm - 128.0f;
+    }
+  }
+}
+
+/** mm_jpeg_sw_fdct:
+ *
+ *  Arguments:
+ *    @d: 8 samples, @s apart
+ *    @s: stride
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       AAN forward DCT of one row or column, output unscaled
+ *
+ **/
+static inline void mm_jpeg_sw_fdct(float *d, uint32_t s)
+{
+  float tmp0 = d[0] + d[7 * s], tmp7 = d[0] - d[7 * s];
+  float tmp1 = d[s] + d[6 * s], tmp6 = d[s] - d[6 * s];
+  float tmp2 = d[2 * s] + d[5 * s], tmp5 = d[2 * s] - d[5 * s];
+  float tmp3 = d[3 * s] + d[4 * s], tmp4 = d[3 * s] - d[4 * s];
+  float tmp10, tmp11, tmp12, tmp13, z1, z2, z3, z4, z5, z11, z13;
+
+  /* even part */
+  tmp10 = tmp0 + tmp3;
+  tmp13 = tmp0 - tmp3;
+  tmp11 = tmp1 + tmp2;
+  tmp12 = tmp1 - tmp2;
+  d[0] = tmp10 + tmp11;
+  d[4 * s] = tmp10 - tmp11;
+  z1 = (tmp12 + tmp13) * 0.707106781f;
+  d[2 * s] = tmp13 + z1;
+  d[6 * s] = tmp13 - z1;
+
+  /* odd part */
+  tmp10 = tmp4 + tmp5;
+  tmp11 = tmp5 + tmp6;
+  tmp12 = tmp6 + tmp7;
+  z5 = (tmp10 - tmp12) * 0.382683433f;
+  z2 = 0.541196100f * tmp10 + z5;
+  z4 = 1.306562965f * tmp12 + z5;
+  z3 = tmp11 * 0.707106781f;
+  z11 = tmp7 + z3;
+  z13 = tmp7 - z3;
+  d[5 * s] = z13 + z2;
+  d[3 * s] = z13 - z2;
+  d[s] = z11 + z4;
+  d[7 * s] = z11 - z4;
+}
+
+/** mm_jpeg_sw_put_bits:
+ *
+ *  Arguments:
+ *    @p_bits: bit writer
+ *    @code: bits, right aligned
+ *    @size: number of bits, at most 16
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Append bits, stuffing a zero after every 0xFF byte
+ *
+ **/
+static inline void mm_jpeg_sw_put_bits(mm_jpeg_sw_bits_t *p_bits,
+  uint32_t code, uint32_t size)
+{
+  p_bits->acc = (p_bits->acc << size) | (code & ((1U << size) - 1));
+  p_bits->nbits += size;
+  while (p_bits->nbits >= 8) {
+    uint8_t b = (uint8_t)(p_bits->acc >> (p_bits->nbits - 8));
+    p_bits->p[p_bits->len++] = b;
+    if (0xff == b) {
+      p_bits->p[p_bits->len++] = 0;
+    }
+    p_bits->nbits -= 8;
+  }
+}
+
+/** mm_jpeg_sw_reserve:
+ *
+ *  Arguments:
+ *    @p_bits: bit writer
+ *
+ *  Return:
+ *       0 for success, -1 on allocation failure
+ *
+ *  Description:
+ *       Make room for one more MCU in the strip buffer
+ *
+ **/
+static int32_t mm_jpeg_sw_reserve(mm_jpeg_sw_bits_t *p_bits)
+{
+  size_t cap;
+  uint8_t *p;
+
+  if (p_bits->cap - p_bits->len >= MM_JPEG_SW_MCU_MAX_BYTES) {
+    return 0;
+  }
+  cap = p_bits->cap * 2 + MM_JPEG_SW_MCU_MAX_BYTES;
+  p = realloc(p_bits->p, cap);
+  if (NULL == p) {
+    return -1;
+  }
+  p_bits->p = p;
+  p_bits->cap = cap;
+  p_bits->strip->data = p;
+  p_bits->strip->cap = cap;
+  return 0;
+}
+
+/** mm_jpeg_sw_code_block:
+ *
+ *  Arguments:
+ *    @p_bits: bit writer
+ *    @blk: level shifted samples, transformed in place
+ *    @fdtbl: quantizer reciprocals
+ *    @dc_pred: previous DC of the component
+ *    @p_dc, @p_ac: code tables
+ *
+ *  Return:
+ *       quantized DC of the block
+ *
+ *  Description:
+ *       DCT, quantize and entropy code one block
+ *
+ **/
+static int32_t mm_jpeg_sw_code_block(mm_jpeg_sw_bits_t *p_bits, float *blk,
+  const float *fdtbl, int32_t dc_pred,
+  const mm_jpeg_sw_huff_t *p_dc, const mm_jpeg_sw_huff_t *p_ac)
+{
+  int32_t q[64];
+  uint32_t i, run, nbits, last;
+  int32_t v, bits;
+
+  for (i = 0; i < 64; i += 8) {
+    mm_jpeg_sw_fdct(&blk[i], 1);
+  }
+  for (i = 0; i < 8; i++) {
+    mm_jpeg_sw_fdct(&blk[i], 8);
+  }
+
+  last = 0;
+  for (i = 0; i < 64; i++) {
+    float f = blk[zigzag[i]] * fdtbl[zigzag[i]];
+    q[i] = (int32_t)((f < 0.0f) ? f - 0.5f : f + 0.5f);
+    if (q[i]) {
+      last = i;
+    }
+  }
+
+  /* DC difference */
+  v = q[0] - dc_pred;
+  bits = v;
+  if (v < 0) {
+    v = -v;
+    bits--;
+  }
+  for (nbits = 0; v; nbits++) {
+    v >>= 1;
+  }
+  mm_jpeg_sw_put_bits(p_bits, p_dc->code[nbits], p_dc->size[nbits]);
+  if (nbits) {
+    mm_jpeg_sw_put_bits(p_bits, (uint32_t)bits, nbits);
+  }
+
+  /* AC run lengths */
+  run = 0;
+  for (i = 1; i <= last; i++) {
+    if (0 == q[i]) {
+      run++;
+      continue;
+    }
+    while (run > 15) {
+      mm_jpeg_sw_put_bits(p_bits, p_ac->code[0xf0], p_ac->size[0xf0]);
+      run -= 16;
+    }
+    v = q[i];
+    bits = v;
+    if (v < 0) {
+      v = -v;
+      bits--;
+    }
+    for (nbits = 0; v; nbits++) {
+      v >>= 1;
+    }
+    mm_jpeg_sw_put_bits(p_bits, p_ac->code[(run << 4) | nbits],
+      p_ac->size[(run << 4) | nbits]);
+    mm_jpeg_sw_put_bits(p_bits, (uint32_t)bits, nbits);
+    run = 0;
+  }
+  if (last < 63) {
+    mm_jpeg_sw_put_bits(p_bits, p_ac->code[0x00], p_ac->size[0x00]);
+  }
+  return q[0];
+}
+
+/** mm_jpeg_sw_aborted:
+ *
+ *  Arguments:
+ *    @p_job: job, NULL for none
+ *
+ *  Return:
+ *       non zero if the owner of the job asked to stop
+ *
+ *  Description:
+ *       Poll the abort hook of the job
+ *
+ **/
+static int mm_jpeg_sw_aborted(const mm_jpeg_sw_job_t *p_job)
+{
+  return (NULL != p_job && NULL != p_job->is_aborted) ?
+    p_job->is_aborted(p_job->user_data) : 0;
+}
+
+/** mm_jpeg_sw_code_strip:
+ *
+ *  Arguments:
+ *    @p_frame: frame
+ *    @idx: strip index
+ *
+ *  Return:
+ *       0 for success, -1 on allocation failure
+ *
+ *  Description:
+ *       Entropy code the MCU rows of one restart interval. DC
+ *       predictors start at zero and the last byte is padded with ones,
+ *       so strips can be joined with RSTn markers in any order they
+ *       finish.
+ *
+ **/
+static int32_t mm_jpeg_sw_code_strip(mm_jpeg_sw_frame_t *p_frame, uint32_t idx)
+{
+  mm_jpeg_sw_strip_t *p_strip = &p_frame->strips[idx];
+  mm_jpeg_sw_bits_t bits;
+  float y[4][64], cb[64], cr[64];
+  int32_t dc_y = 0, dc_cb = 0, dc_cr = 0;
+  uint32_t mx, my, b;
+  uint32_t my_end = (idx + 1) * p_frame->rows_per_strip;
+
+  if (my_end > p_frame->mcu_rows) {
+    my_end = p_frame->mcu_rows;
+  }
+
+  memset(&bits, 0, sizeof(bits));
+  bits.p = p_strip->data;
+  bits.cap = p_strip->cap;
+  bits.strip = p_strip;
+
+  for (my = idx * p_frame->rows_per_strip; my < my_end; my++) {
+    if (mm_jpeg_sw_aborted(p_frame->job)) {
+      p_strip->len = 0;
+      return -1;
+    }
+    for (mx = 0; mx < p_frame->mcu_cols; mx++) {
+      if (mm_jpeg_sw_reserve(&bits)) {
+        p_strip->len = 0;
+        return -1;
+      }
+      if (p_frame->fast) {
+        mm_jpeg_sw_fetch_mcu_fast(p_frame, mx, my, y, cb, cr);
+      } else {
+        mm_jpeg_sw_fetch_mcu_mapped(p_frame, mx, my, y, cb, cr);
+      }
+      for (b = 0; b < 4; b++) {
+        dc_y = mm_jpeg_sw_code_block(&bits, y[b], p_frame->fdtbl[0], dc_y,
+          &g_huff[0], &g_huff[2]);
+      }
+      dc_cb = mm_jpeg_sw_code_block(&bits, cb, p_frame->fdtbl[1], dc_cb,
+        &g_huff[1], &g_huff[3]);
+      dc_cr = mm_jpeg_sw_code_block(&bits, cr, p_frame->fdtbl[1], dc_cr,
+        &g_huff[1], &g_huff[3]);
+    }
+  }
+  if (bits.nbits) {
+    mm_jpeg_sw_put_bits(&bits, 0x7f, 8 - bits.nbits);
+  }
+  p_strip->len = bits.len;
+  return 0;
+}
+
+/** mm_jpeg_sw_worker_loop:
+ *
+ *  Arguments:
+ *    @p_enc: encoder
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Code strips of the current frame until none is left. Called with
+ *       the lock held, returns with it held.
+ *
+ **/
+static void mm_jpeg_sw_worker_loop(mm_jpeg_sw_enc_t *p_enc)
+{
+  mm_jpeg_sw_frame_t *p_frame = p_enc->frame;
+  uint32_t idx;
+  int32_t rc;
+
+  while (NULL != p_frame && p_enc->next_strip < p_frame->num_strips) {
+    idx = p_enc->next_strip++;
+    pthread_mutex_unlock(&p_enc->lock);
+    rc = mm_jpeg_sw_code_strip(p_frame, idx);
+    pthread_mutex_lock(&p_enc->lock);
+    if (rc) {
+      p_frame->error = 1;
+    }
+    if (++p_enc->strips_done == p_frame->num_strips) {
+      pthread_cond_broadcast(&p_enc->done_cond);
+    }
+  }
+}
+
+static void *mm_jpeg_sw_worker(void *data)
+{
+  mm_jpeg_sw_enc_t *p_enc = (mm_jpeg_sw_enc_t *)data;
+
+  pthread_mutex_lock(&p_enc->lock);
+  while (!p_enc->exit) {
+    if (NULL != p_enc->frame &&
+      p_enc->next_strip < p_enc->frame->num_strips) {
+      mm_jpeg_sw_worker_loop(p_enc);
+    } else {
+      pthread_cond_wait(&p_enc->work_cond, &p_enc->lock);
+    }
+  }
+  pthread_mutex_unlock(&p_enc->lock);
+  return NULL;
+}
+
+/** mm_jpeg_sw_enc_init:
+ *
+ *  Arguments:
+ *    @p_enc: encoder
+ *    @num_threads: coding threads incl. the caller of encode, 0 or 1
+ *      codes on the calling thread only
+ *
+ *  Return:
+ *       0 for success else failure
+ *
+ *  Description:
+ *       Start the worker pool
+ *
+ **/
+int32_t mm_jpeg_sw_enc_init(mm_jpeg_sw_enc_t *p_enc, uint32_t num_threads)
+{
+  uint32_t i;
+
+  pthread_once(&g_huff_once, mm_jpeg_sw_init_tables);
+  memset(p_enc, 0, sizeof(*p_enc));
+  if (num_threads < 1) {
+    num_threads = 1;
+  } else if (num_threads > MM_JPEG_SW_MAX_THREADS) {
+    num_threads = MM_JPEG_SW_MAX_THREADS;
+  }
+  pthread_mutex_init(&p_enc->lock, NULL);
+  pthread_cond_init(&p_enc->work_cond, NULL);
+  pthread_cond_init(&p_enc->done_cond, NULL);
+
+  p_enc->num_threads = 1;
+  for (i = 1; i < num_threads; i++) {
+    if (pthread_create(&p_enc->threads[i], NULL, mm_jpeg_sw_worker, p_enc)) {
+      break;
+    }
+    p_enc->num_threads++;
+  }
+  return 0;
+}
+
+/** mm_jpeg_sw_enc_deinit:
+ *
+ *  Arguments:
+ *    @p_enc: encoder
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Stop the workers and free the strip buffers
+ *
+ **/
+void mm_jpeg_sw_enc_deinit(mm_jpeg_sw_enc_t *p_enc)
+{
+  uint32_t i;
+
+  pthread_mutex_lock(&p_enc->lock);
+  p_enc->exit = 1;
+  pthread_cond_broadcast(&p_enc->work_cond);
+  pthread_mutex_unlock(&p_enc->lock);
+  for (i = 1; i < p_enc->num_threads; i++) {
+    pthread_join(p_enc->threads[i], NULL);
+  }
+
+  for (i = 0; i < p_enc->num_strips_alloc; i++) {
+    free(p_enc->strips[i].data);
+  }
+  free(p_enc->strips);
+  free(p_enc->thumb_buf);
+  pthread_cond_destroy(&p_enc->done_cond);
+  pthread_cond_destroy(&p_enc->work_cond);
+  pthread_mutex_destroy(&p_enc->lock);
+  memset(p_enc, 0, sizeof(*p_enc));
+}
+
+/** mm_jpeg_sw_check_image:
+ *
+ *  Arguments:
+ *    @src: image from the job
+ *    @p_img: normalized copy
+ *
+ *  Return:
+ *       0 for success, -1 for invalid parameters
+ *
+ *  Description:
+ *       Validate the image and fill in the defaults. Crop offsets are
+ *       rounded down to even so chroma stays sited.
+ *
+ **/
+static int32_t mm_jpeg_sw_check_image(const mm_jpeg_sw_image_t *src,
+  mm_jpeg_sw_image_t *p_img)
+{
+  *p_img = *src;
+  if (NULL == p_img->y || (NULL == p_img->c &&
+    p_img->fmt != MM_JPEG_SW_FMT_MONO) || p_img->fmt >= MM_JPEG_SW_FMT_MAX ||
+    0 == p_img->width || 0 == p_img->height ||
+    (p_img->rotation != 0 && p_img->rotation != 90 &&
+    p_img->rotation != 180 && p_img->rotation != 270)) {
+    return -1;
+  }
+  if (0 == p_img->crop_w || 0 == p_img->crop_h) {
+    p_img->crop_x = 0;
+    p_img->crop_y = 0;
+    p_img->crop_w = p_img->width;
+    p_img->crop_h = p_img->height;
+  }
+  p_img->crop_x &= ~1U;
+  p_img->crop_y &= ~1U;
+  if (p_img->crop_x + p_img->crop_w > p_img->width ||
+    p_img->crop_y + p_img->crop_h > p_img->height) {
+    return -1;
+  }
+  if (0 == p_img->out_w || 0 == p_img->out_h) {
+    p_img->out_w = p_img->crop_w;
+    p_img->out_h = p_img->crop_h;
+  }
+  return 0;
+}
+
+/** mm_jpeg_sw_frame_setup:
+ *
+ *  Arguments:
+ *    @p_frame: frame to set up
+ *    @p_img: normalized image
+ *    @quality: 1..100
+ *    @max_strips: upper bound of strips, 1 for a single interval
+ *
+ *  Return:
+ *       0 for success, -1 on allocation failure
+ *
+ *  Description:
+ *       Work out the MCU grid, the restart interval and the sampling
+ *
+ **/
+static int32_t mm_jpeg_sw_frame_setup(mm_jpeg_sw_frame_t *p_frame,
+  const mm_jpeg_sw_image_t *p_img, uint32_t quality, uint32_t max_strips)
+{
+  memset(p_frame, 0, sizeof(*p_frame));
+  p_frame->img = p_img;
+  p_frame->swap = (p_img->rotation == 90 || p_img->rotation == 270);
+  p_frame->jw = p_frame->swap ? p_img->out_h : p_img->out_w;
+  p_frame->jh = p_frame->swap ? p_img->out_w : p_img->out_h;
+  p_frame->mcu_cols = (p_frame->jw + 15) / 16;
+  p_frame->mcu_rows = (p_frame->jh + 15) / 16;
+
+  if (max_strips > p_frame->mcu_rows) {
+    max_strips = p_frame->mcu_rows;
+  }
+  p_frame->rows_per_strip = (p_frame->mcu_rows + max_strips - 1) / max_strips;
+  /* the restart interval is a 16 bit MCU count */
+  if (p_frame->rows_per_strip * p_frame->mcu_cols > 0xffff) {
+    p_frame->rows_per_strip = 0xffff / p_frame->mcu_cols;
+  }
+  p_frame->num_strips = (p_frame->mcu_rows + p_frame->rows_per_strip - 1) /
+    p_frame->rows_per_strip;
+
+  mm_jpeg_sw_setup_quant(p_frame, quality);
+
+  p_frame->fast = (0 == p_img->rotation && p_img->out_w == p_img->crop_w &&
+    p_img->out_h == p_img->crop_h);
+  if (!p_frame->fast) {
+    return mm_jpeg_sw_setup_maps(p_frame);
+  }
+  return 0;
+}
+
+static void mm_jpeg_sw_frame_release(mm_jpeg_sw_frame_t *p_frame)
+{
+  free(p_frame->col_map);
+  free(p_frame->row_map);
+  p_frame->col_map = NULL;
+  p_frame->row_map = NULL;
+}
+
+/** mm_jpeg_sw_alloc_strips:
+ *
+ *  Arguments:
+ *    @p_enc: encoder
+ *    @num: strips needed
+ *    @hint: expected bytes per strip
+ *
+ *  Return:
+ *       0 for success, -1 on allocation failure
+ *
+ *  Description:
+ *       Grow the reusable strip buffers
+ *
+ **/
+static int32_t mm_jpeg_sw_alloc_strips(mm_jpeg_sw_enc_t *p_enc, uint32_t num,
+  size_t hint)
+{
+  uint32_t i;
+
+  if (num > p_enc->num_strips_alloc) {
+    mm_jpeg_sw_strip_t *p = realloc(p_enc->strips, num * sizeof(*p));
+    if (NULL == p) {
+      return -1;
+    }
+    memset(&p[p_enc->num_strips_alloc], 0,
+      (num - p_enc->num_strips_alloc) * sizeof(*p));
+    p_enc->strips = p;
+    p_enc->num_strips_alloc = num;
+  }
+  for (i = 0; i < num; i++) {
+    mm_jpeg_sw_strip_t *p_strip = &p_enc->strips[i];
+    p_strip->len = 0;
+    if (p_strip->cap < hint) {
+      uint8_t *p = realloc(p_strip->data, hint);
+      if (NULL == p) {
+        return -1;
+      }
+      p_strip->data = p;
+      p_strip->cap = hint;
+    }
+  }
+  return 0;
+}
+
+static inline uint8_t *mm_jpeg_sw_put16(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+  return p + 2;
+}
+
+/** mm_jpeg_sw_write_tables:
+ *
+ *  Arguments:
+ *    @p: output, NULL to measure
+ *    @p_frame: frame
+ *
+ *  Return:
+ *       bytes written
+ *
+ *  Description:
+ *       DQT, SOF0, DHT, DRI and SOS of a frame
+ *
+ **/
+static size_t mm_jpeg_sw_write_tables(uint8_t *p, const mm_jpeg_sw_frame_t *p_frame)
+{
+  static const uint8_t *const bits[4] = {
+    dc_luma_bits, ac_luma_bits, dc_chroma_bits, ac_chroma_bits
+  };
+  static const uint8_t *const vals[4] = {
+    dc_vals, ac_luma_vals, dc_vals, ac_chroma_vals
+  };
+  static const uint8_t classes[4] = { 0x00, 0x10, 0x01, 0x11 };
+  uint32_t dri = (p_frame->num_strips > 1) ?
+    p_frame->rows_per_strip * p_frame->mcu_cols : 0;
+  uint8_t *start = p;
+  uint32_t i, t, n;
+  size_t len;
+
+  len = 4 + 2 * 65;                 /* DQT */
+  len += 4 + 6 + 3 * 3;             /* SOF0 */
+  len += 4 + 2 * (17 + 12) + 2 * (17 + 162); /* DHT */
+  len += dri ? 6 : 0;               /* DRI */
+  len += 4 + 1 + 3 * 2 + 3;         /* SOS */
+  if (NULL == p) {
+    return len;
+  }
+
+  p = mm_jpeg_sw_put16(p, 0xffdb);
+  p = mm_jpeg_sw_put16(p, 2 + 2 * 65);
+  for (t = 0; t < 2; t++) {
+    *p++ = (uint8_t)t;
+    for (i = 0; i < 64; i++) {
+      *p++ = p_frame->qt[t][zigzag[i]];
+    }
+  }
+
+  p = mm_jpeg_sw_put16(p, 0xffc0);
+  p = mm_jpeg_sw_put16(p, 8 + 3 * 3);
+  *p++ = 8;
+  p = mm_jpeg_sw_put16(p, p_frame->jh);
+  p = mm_jpeg_sw_put16(p, p_frame->jw);
+  *p++ = 3;
+  for (i = 1; i <= 3; i++) {
+    *p++ = (uint8_t)i;
+    *p++ = (1 == i) ? 0x22 : 0x11;
+    *p++ = (1 == i) ? 0 : 1;
+  }
+
+  p = mm_jpeg_sw_put16(p, 0xffc4);
+  p = mm_jpeg_sw_put16(p, 2 + 2 * (17 + 12) + 2 * (17 + 162));
+  for (t = 0; t < 4; t++) {
+    *p++ = classes[t];
+    for (i = 0, n = 0; i < 16; i++) {
+      *p++ = bits[t][i];
+      n += bits[t][i];
+    }
+    memcpy(p, vals[t], n);
+    p += n;
+  }
+
+  if (dri) {
+    p = mm_jpeg_sw_put16(p, 0xffdd);
+    p = mm_jpeg_sw_put16(p, 4);
+    p = mm_jpeg_sw_put16(p, dri);
+  }
+
+  p = mm_jpeg_sw_put16(p, 0xffda);
+  p = mm_jpeg_sw_put16(p, 6 + 3 * 2);
+  *p++ = 3;
+  for (i = 1; i <= 3; i++) {
+    *p++ = (uint8_t)i;
+    *p++ = (1 == i) ? 0x00 : 0x11;
+  }
+  *p++ = 0;
+  *p++ = 63;
+  *p++ = 0;
+  return (size_t)(p - start);
+}
+
+/** mm_jpeg_sw_frame_size:
+ *
+ *  Arguments:
+ *    @p_frame: coded frame
+ *
+ *  Return:
+ *       bytes of tables, strips, restart markers and EOI
+ *
+ **/
+static size_t mm_jpeg_sw_frame_size(const mm_jpeg_sw_frame_t *p_frame)
+{
+  size_t len = mm_jpeg_sw_write_tables(NULL, p_frame);
+  uint32_t i;
+
+  for (i = 0; i < p_frame->num_strips; i++) {
+    len += p_frame->strips[i].len;
+  }
+  return len + 2 * (p_frame->num_strips - 1) + 2;
+}
+
+/** mm_jpeg_sw_write_frame:
+ *
+ *  Arguments:
+ *    @p: output
+ *    @p_frame: coded frame
+ *
+ *  Return:
+ *       bytes written
+ *
+ *  Description:
+ *       Tables followed by the strips joined with RST0..7 and EOI
+ *
+ **/
+static size_t mm_jpeg_sw_write_frame(uint8_t *p, const mm_jpeg_sw_frame_t *p_frame)
+{
+  uint8_t *start = p;
+  uint32_t i;
+
+  p += mm_jpeg_sw_write_tables(p, p_frame);
+  for (i = 0; i < p_frame->num_strips; i++) {
+    if (i) {
+      p = mm_jpeg_sw_put16(p, 0xffd0 + ((i - 1) & 7));
+    }
+    memcpy(p, p_frame->strips[i].data, p_frame->strips[i].len);
+    p += p_frame->strips[i].len;
+  }
+  p = mm_jpeg_sw_put16(p, 0xffd9);
+  return (size_t)(p - start);
+}
+
+/** mm_jpeg_sw_type_size:
+ *
+ *  Arguments:
+ *    @type: EXIF type
+ *
+ *  Return:
+ *       bytes per element, 0 for unknown types
+ *
+ **/
+static uint32_t mm_jpeg_sw_type_size(uint32_t type)
+{
+  switch (type) {
+  case EXIF_BYTE:
+  case EXIF_ASCII:
+  case EXIF_UNDEFINED:
+    return 1;
+  case EXIF_SHORT:
+    return 2;
+  case EXIF_LONG:
+  case EXIF_SLONG:
+    return 4;
+  case EXIF_RATIONAL:
+  case EXIF_SRATIONAL:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+/** mm_jpeg_sw_tag_data:
+ *
+ *  Arguments:
+ *    @p_entry: tag from the job
+ *
+ *  Return:
+ *       pointer to the values in host order
+ *
+ *  Description:
+ *       Single numeric values live in the union, everything else behind
+ *       a pointer, see exif_tag_entry_t
+ *
+ **/
+static const void *mm_jpeg_sw_tag_data(const exif_tag_entry_t *p_entry)
+{
+  if (p_entry->count > 1 || EXIF_ASCII == p_entry->type ||
+    EXIF_UNDEFINED == p_entry->type) {
+    /* all the pointer members share the same storage */
+    return p_entry->data._bytes;
+  }
+  return &p_entry->data;
+}
+
+static int mm_jpeg_sw_skip_tag(exif_tag_id_t id)
+{
+  /* offsets and dimensions we write ourselves */
+  return id == EXIFTAGID_EXIF_IFD_PTR || id == EXIFTAGID_GPS_IFD_PTR ||
+    EXIF_TAG_OFFSET(id) == INTEROP ||
+    EXIF_TAG_OFFSET(id) == JPEG_INTERCHANGE_FORMAT ||
+    EXIF_TAG_OFFSET(id) == JPEG_INTERCHANGE_FORMAT_LENGTH ||
+    EXIF_TAG_OFFSET(id) == TN_JPEGINTERCHANGE_FORMAT ||
+    EXIF_TAG_OFFSET(id) == TN_JPEGINTERCHANGE_FORMAT_L ||
+    id == EXIFTAGID_EXIF_PIXEL_X_DIMENSION ||
+    id == EXIFTAGID_EXIF_PIXEL_Y_DIMENSION;
+}
+
+/** mm_jpeg_sw_collect_tags:
+ *
+ *  Arguments:
+ *    @p_job: job
+ *    @jw, @jh: coded main image size
+ *    @thumb: IFD1 is written
+ *    @tags: output array of MM_JPEG_SW_MAX_EXIF_TAGS
+ *
+ *  Return:
+ *       number of tags, sorted by IFD and tag number
+ *
+ **/
+static uint32_t mm_jpeg_sw_collect_tags(const mm_jpeg_sw_job_t *p_job,
+  uint32_t jw, uint32_t jh, int thumb, mm_jpeg_sw_tag_t *tags)
+{
+  static const uint8_t exif_version[4] = { '0', '2', '2', '0' };
+  uint32_t n = 0, s, i, j, off, base = 0;
+  int has_gps = 0, has_version = 0;
+
+  for (s = 0; s < MM_JPEG_SW_EXIF_SETS; base += p_job->exif[s].count, s++) {
+    for (i = 0; i < p_job->exif[s].count; i++) {
+      const mm_jpeg_sw_exif_tag_t *p_data = &p_job->exif[s].entries[i];
+      mm_jpeg_sw_tag_t *p_tag = &tags[n];
+
+      if (n >= MM_JPEG_SW_MAX_EXIF_TAGS - 8) {
+        break;
+      }
+      if (mm_jpeg_sw_skip_tag(p_data->tag_id) ||
+        0 == mm_jpeg_sw_type_size(p_data->tag_entry.type) ||
+        0 == p_data->tag_entry.count) {
+        continue;
+      }
+      off = EXIF_TAG_OFFSET(p_data->tag_id);
+      if (off <= GPS_DIFFERENTIAL) {
+        p_tag->ifd = MM_JPEG_SW_IFD_GPS;
+        has_gps = 1;
+      } else if (off <= GPS_IFD) {
+        p_tag->ifd = MM_JPEG_SW_IFD0;
+      } else if (off <= TN_COPYRIGHT) {
+        if (!thumb) {
+          continue;
+        }
+        p_tag->ifd = MM_JPEG_SW_IFD1;
+      } else {
+        p_tag->ifd = MM_JPEG_SW_IFD_EXIF;
+      }
+      p_tag->tag = EXIF_TAG_NUM(p_data->tag_id);
+      p_tag->type = (uint16_t)p_data->tag_entry.type;
+      p_tag->count = p_data->tag_entry.count;
+      p_tag->data = mm_jpeg_sw_tag_data(&p_data->tag_entry);
+      p_tag->src = (int32_t)(base + i);
+      if (NULL == p_tag->data) {
+        continue;
+      }
+      /* first set wins */
+      for (j = 0; j < n; j++) {
+        if (tags[j].ifd == p_tag->ifd && tags[j].tag == p_tag->tag) {
+          break;
+        }
+      }
+      if (j < n) {
+        continue;
+      }
+      if (p_tag->ifd == MM_JPEG_SW_IFD_EXIF &&
+        p_tag->tag == EXIF_TAG_NUM(EXIFTAGID_EXIF_VERSION)) {
+        has_version = 1;
+      }
+      n++;
+    }
+  }
+
+  /* pointers, filled in by the writer */
+  tags[n].ifd = MM_JPEG_SW_IFD0;
+  tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_EXIF_IFD_PTR);
+  tags[n].type = EXIF_LONG;
+  tags[n].count = 1;
+  tags[n].data = NULL;
+  tags[n].src = -1;
+  n++;
+  if (has_gps) {
+    tags[n] = tags[n - 1];
+    tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_GPS_IFD_PTR);
+    n++;
+  }
+  if (!has_version) {
+    tags[n].ifd = MM_JPEG_SW_IFD_EXIF;
+    tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_EXIF_VERSION);
+    tags[n].type = EXIF_UNDEFINED;
+    tags[n].count = 4;
+    tags[n].data = exif_version;
+    tags[n].src = -1;
+    n++;
+  }
+  tags[n].ifd = MM_JPEG_SW_IFD_EXIF;
+  tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_EXIF_PIXEL_X_DIMENSION);
+  tags[n].type = EXIF_LONG;
+  tags[n].count = 1;
+  tags[n].data = NULL;
+  tags[n].value = jw;
+  tags[n].src = -1;
+  n++;
+  tags[n] = tags[n - 1];
+  tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_EXIF_PIXEL_Y_DIMENSION);
+  tags[n].value = jh;
+  n++;
+  if (thumb) {
+    tags[n].ifd = MM_JPEG_SW_IFD1;
+    tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_TN_COMPRESSION);
+    tags[n].type = EXIF_SHORT;
+    tags[n].count = 1;
+    tags[n].data = NULL;
+    tags[n].value = 6;
+    tags[n].src = -1;
+    n++;
+    tags[n] = tags[n - 1];
+    tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_TN_JPEGINTERCHANGE_FORMAT);
+    tags[n].type = EXIF_LONG;
+    n++;
+    tags[n] = tags[n - 1];
+    tags[n].tag = EXIF_TAG_NUM(EXIFTAGID_TN_JPEGINTERCHANGE_FORMAT_L);
+    n++;
+  }
+
+  /* insertion sort, IFD first then tag number */
+  for (i = 1; i < n; i++) {
+    mm_jpeg_sw_tag_t t = tags[i];
+    for (j = i; j > 0 && (tags[j - 1].ifd > t.ifd ||
+      (tags[j - 1].ifd == t.ifd && tags[j - 1].tag > t.tag)); j--) {
+      tags[j] = tags[j - 1];
+    }
+    tags[j] = t;
+  }
+  return n;
+}
+
+static inline void mm_jpeg_sw_le16(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void mm_jpeg_sw_le32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+/** mm_jpeg_sw_put_values:
+ *
+ *  Arguments:
+ *    @p: output
+ *    @p_tag: tag
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Write the values of a tag little endian
+ *
+ **/
+static void mm_jpeg_sw_put_values(uint8_t *p, const mm_jpeg_sw_tag_t *p_tag)
+{
+  uint32_t i;
+
+  if (NULL == p_tag->data) {
+    if (EXIF_SHORT == p_tag->type) {
+      mm_jpeg_sw_le16(p, p_tag->value);
+    } else {
+      mm_jpeg_sw_le32(p, p_tag->value);
+    }
+    return;
+  }
+  switch (p_tag->type) {
+  case EXIF_SHORT:
+    for (i = 0; i < p_tag->count; i++) {
+      mm_jpeg_sw_le16(p + i * 2, ((const uint16_t *)p_tag->data)[i]);
+    }
+    break;
+  case EXIF_LONG:
+  case EXIF_SLONG:
+  case EXIF_RATIONAL:
+  case EXIF_SRATIONAL:
+    /* rationals are pairs of 32 bit words */
+    for (i = 0; i < p_tag->count * mm_jpeg_sw_type_size(p_tag->type) / 4; i++) {
+      mm_jpeg_sw_le32(p + i * 4, ((const uint32_t *)p_tag->data)[i]);
+    }
+    break;
+  default:
+    memcpy(p, p_tag->data, p_tag->count);
+    break;
+  }
+}
+
+/** mm_jpeg_sw_write_exif:
+ *
+ *  Arguments:
+ *    @p: output, NULL to measure
+ *    @tags, @n: sorted tags
+ *    @thumb, @thumb_len: coded thumbnail, NULL if none
+ *    @val_off: optional, set to the offset of the values of every tag
+ *      from @p
+ *
+ *  Return:
+ *       size of the APP1 segment incl. marker, 0 if it does not fit
+ *
+ *  Description:
+ *       Little endian TIFF with IFD0, the EXIF and GPS sub IFDs and an
+ *       IFD1 carrying the thumbnail, which always goes last
+ *
+ **/
+static size_t mm_jpeg_sw_write_exif(uint8_t *p, const mm_jpeg_sw_tag_t *tags,
+  uint32_t n, const uint8_t *thumb, size_t thumb_len, uint32_t *val_off)
+{
+  uint32_t ifd_off[MM_JPEG_SW_IFD_MAX], ifd_cnt[MM_JPEG_SW_IFD_MAX];
+  uint32_t ifd, i, off, data_off, next;
+  uint8_t *tiff = p ? p + 10 : NULL;
+  size_t len;
+
+  memset(ifd_cnt, 0, sizeof(ifd_cnt));
+  for (i = 0; i < n; i++) {
+    ifd_cnt[tags[i].ifd]++;
+  }
+
+  /* lay out every IFD followed by its out of line values */
+  off = 8;
+  for (ifd = 0; ifd < MM_JPEG_SW_IFD_MAX; ifd++) {
+    ifd_off[ifd] = off;
+    if (0 == ifd_cnt[ifd]) {
+      continue;
+    }
+    off += 2 + 12 * ifd_cnt[ifd] + 4;
+    for (i = 0; i < n; i++) {
+      uint32_t sz = tags[i].count * mm_jpeg_sw_type_size(tags[i].type);
+      if (tags[i].ifd == ifd && sz > 4) {
+        off += (sz + 1) & ~1U;
+      }
+    }
+  }
+  len = 10 + off + (thumb ? thumb_len : 0);
+  if (len - 2 > 0xffff) {
+    return 0;
+  }
+  if (NULL == p) {
+    return len;
+  }
+
+  mm_jpeg_sw_put16(p, 0xffe1);
+  mm_jpeg_sw_put16(p + 2, (uint32_t)(len - 2));
+  memcpy(p + 4, "Exif\0\0", 6);
+  memcpy(tiff, "II", 2);
+  mm_jpeg_sw_le16(tiff + 2, 42);
+  mm_jpeg_sw_le32(tiff + 4, 8);
+
+  for (ifd = 0; ifd < MM_JPEG_SW_IFD_MAX; ifd++) {
+    uint8_t *p_ent;
+    if (0 == ifd_cnt[ifd]) {
+      continue;
+    }
+    p_ent = tiff + ifd_off[ifd];
+    mm_jpeg_sw_le16(p_ent, ifd_cnt[ifd]);
+    p_ent += 2;
+    data_off = ifd_off[ifd] + 2 + 12 * ifd_cnt[ifd] + 4;
+    for (i = 0; i < n; i++) {
+      mm_jpeg_sw_tag_t t = tags[i];
+      uint32_t sz;
+      if (t.ifd != ifd) {
+        continue;
+      }
+      if (t.tag == EXIF_TAG_NUM(EXIFTAGID_EXIF_IFD_PTR)) {
+        t.value = ifd_off[MM_JPEG_SW_IFD_EXIF];
+      } else if (t.tag == EXIF_TAG_NUM(EXIFTAGID_GPS_IFD_PTR)) {
+        t.value = ifd_off[MM_JPEG_SW_IFD_GPS];
+      } else if (ifd == MM_JPEG_SW_IFD1 &&
+        t.tag == EXIF_TAG_NUM(EXIFTAGID_TN_JPEGINTERCHANGE_FORMAT)) {
+        t.value = off;
+      } else if (ifd == MM_JPEG_SW_IFD1 &&
+        t.tag == EXIF_TAG_NUM(EXIFTAGID_TN_JPEGINTERCHANGE_FORMAT_L)) {
+        t.value = (uint32_t)thumb_len;
+      }
+      mm_jpeg_sw_le16(p_ent, t.tag);
+      mm_jpeg_sw_le16(p_ent + 2, t.type);
+      mm_jpeg_sw_le32(p_ent + 4, t.count);
+      mm_jpeg_sw_le32(p_ent + 8, 0);
+      sz = t.count * mm_jpeg_sw_type_size(t.type);
+      if (sz <= 4) {
+        mm_jpeg_sw_put_values(p_ent + 8, &t);
+        if (NULL != val_off) {
+          val_off[i] = (uint32_t)(p_ent + 8 - p);
+        }
+      } else {
+        mm_jpeg_sw_le32(p_ent + 8, data_off);
+        mm_jpeg_sw_put_values(tiff + data_off, &t);
+        if (NULL != val_off) {
+          val_off[i] = 10 + data_off;
+        }
+        if (sz & 1) {
+          tiff[data_off + sz] = 0;
+        }
+        data_off += (sz + 1) & ~1U;
+      }
+      p_ent += 12;
+    }
+    /* only IFD0 links to IFD1, the sub IFDs end the chain */
+    next = (MM_JPEG_SW_IFD0 == ifd && ifd_cnt[MM_JPEG_SW_IFD1]) ?
+      ifd_off[MM_JPEG_SW_IFD1] : 0;
+    mm_jpeg_sw_le32(p_ent, next);
+  }
+  if (thumb) {
+    memcpy(tiff + off, thumb, thumb_len);
+  }
+  return len;
+}
+
+/** mm_jpeg_sw_exif_build:
+ *
+ *  Arguments:
+ *    @p_tmpl: template
+ *    @p_job: job
+ *    @jw, @jh: coded main image size
+ *    @thumb: IFD1 is written
+ *
+ *  Return:
+ *       0 for success, -1 if the tags do not fit APP1, there are more
+ *       job tags than slots or on allocation failure
+ *
+ *  Description:
+ *       Serialize the tags of the job into the template and remember
+ *       where the values of every job tag went
+ *
+ **/
+static int32_t mm_jpeg_sw_exif_build(mm_jpeg_sw_exif_tmpl_t *p_tmpl,
+  const mm_jpeg_sw_job_t *p_job, uint32_t jw, uint32_t jh, int thumb)
+{
+  mm_jpeg_sw_tag_t tags[MM_JPEG_SW_MAX_EXIF_TAGS];
+  uint32_t val_off[MM_JPEG_SW_MAX_EXIF_TAGS];
+  uint32_t n, s, i, k = 0, sz, shadow_len = 0;
+  size_t len;
+
+  p_tmpl->valid = 0;
+  if (p_job->exif[0].count + p_job->exif[1].count > MM_JPEG_SW_EXIF_SLOTS) {
+    return -1;
+  }
+  n = mm_jpeg_sw_collect_tags(p_job, jw, jh, thumb, tags);
+  len = mm_jpeg_sw_write_exif(NULL, tags, n, NULL, 0, NULL);
+  if (0 == len) {
+    return -1;
+  }
+  if (p_tmpl->cap < len) {
+    uint8_t *p = realloc(p_tmpl->buf, len);
+    if (NULL == p) {
+      return -1;
+    }
+    p_tmpl->buf = p;
+    p_tmpl->cap = len;
+  }
+  mm_jpeg_sw_write_exif(p_tmpl->buf, tags, n, NULL, 0, val_off);
+
+  for (s = 0; s < MM_JPEG_SW_EXIF_SETS; s++) {
+    p_tmpl->num[s] = p_job->exif[s].count;
+    for (i = 0; i < p_job->exif[s].count; i++, k++) {
+      const mm_jpeg_sw_exif_tag_t *p_data = &p_job->exif[s].entries[i];
+      mm_jpeg_sw_exif_slot_t *p_slot = &p_tmpl->slots[k];
+      p_slot->tag_id = p_data->tag_id;
+      p_slot->type = p_data->tag_entry.type;
+      p_slot->count = p_data->tag_entry.count;
+      p_slot->has_data = NULL != mm_jpeg_sw_tag_data(&p_data->tag_entry);
+      p_slot->off = -1;
+      p_slot->shadow = 0;
+    }
+  }
+  p_tmpl->tn_len_off = 0;
+  for (i = 0; i < n; i++) {
+    if (tags[i].src >= 0) {
+      p_tmpl->slots[tags[i].src].off = (int32_t)val_off[i];
+      p_tmpl->slots[tags[i].src].shadow = shadow_len;
+      sz = tags[i].count * mm_jpeg_sw_type_size(tags[i].type);
+      shadow_len += (sz + 3) & ~3U;
+    } else if (MM_JPEG_SW_IFD1 == tags[i].ifd &&
+      tags[i].tag == EXIF_TAG_NUM(EXIFTAGID_TN_JPEGINTERCHANGE_FORMAT_L)) {
+      p_tmpl->tn_len_off = val_off[i];
+    }
+  }
+  if (p_tmpl->shadow_cap < shadow_len) {
+    uint8_t *p = realloc(p_tmpl->shadow, shadow_len);
+    if (NULL == p) {
+      return -1;
+    }
+    p_tmpl->shadow = p;
+    p_tmpl->shadow_cap = shadow_len;
+  }
+  for (i = 0; i < n; i++) {
+    if (tags[i].src >= 0) {
+      memcpy(p_tmpl->shadow + p_tmpl->slots[tags[i].src].shadow,
+        tags[i].data, tags[i].count * mm_jpeg_sw_type_size(tags[i].type));
+    }
+  }
+
+  p_tmpl->len = len;
+  p_tmpl->jw = jw;
+  p_tmpl->jh = jh;
+  p_tmpl->thumb = thumb ? 1 : 0;
+  p_tmpl->valid = 1;
+  p_tmpl->builds++;
+  return 0;
+}
+
+/** mm_jpeg_sw_exif_patch:
+ *
+ *  Arguments:
+ *    @p_tmpl: template
+ *    @p_job: job
+ *    @jw, @jh: coded main image size
+ *    @thumb: IFD1 is written
+ *
+ *  Return:
+ *       0 for success, -1 if the job does not match the template layout
+ *
+ *  Description:
+ *       Rewrite in place the values of the job tags that changed since
+ *       the template was last used
+ *
+ **/
+static int32_t mm_jpeg_sw_exif_patch(mm_jpeg_sw_exif_tmpl_t *p_tmpl,
+  const mm_jpeg_sw_job_t *p_job, uint32_t jw, uint32_t jh, int thumb)
+{
+  uint32_t s, i, k = 0, sz;
+
+  if (!p_tmpl->valid || p_tmpl->jw != jw || p_tmpl->jh != jh ||
+    p_tmpl->thumb != (thumb ? 1U : 0U)) {
+    return -1;
+  }
+  for (s = 0; s < MM_JPEG_SW_EXIF_SETS; s++) {
+    if (p_tmpl->num[s] != p_job->exif[s].count) {
+      return -1;
+    }
+  }
+  for (s = 0; s < MM_JPEG_SW_EXIF_SETS; s++) {
+    for (i = 0; i < p_job->exif[s].count; i++, k++) {
+      const mm_jpeg_sw_exif_tag_t *p_data = &p_job->exif[s].entries[i];
+      mm_jpeg_sw_exif_slot_t *p_slot = &p_tmpl->slots[k];
+      mm_jpeg_sw_tag_t t;
+
+      t.data = mm_jpeg_sw_tag_data(&p_data->tag_entry);
+      if (p_slot->tag_id != p_data->tag_id ||
+        p_slot->type != p_data->tag_entry.type ||
+        p_slot->count != p_data->tag_entry.count ||
+        p_slot->has_data != (NULL != t.data)) {
+        return -1;
+      }
+      if (p_slot->off < 0) {
+        continue;
+      }
+      sz = p_slot->count * mm_jpeg_sw_type_size(p_slot->type);
+      if (0 == memcmp(p_tmpl->shadow + p_slot->shadow, t.data, sz)) {
+        continue;
+      }
+      memcpy(p_tmpl->shadow + p_slot->shadow, t.data, sz);
+      t.type = (uint16_t)p_slot->type;
+      t.count = p_slot->count;
+      mm_jpeg_sw_put_values(p_tmpl->buf + p_slot->off, &t);
+      p_tmpl->patched++;
+    }
+  }
+  p_tmpl->reuses++;
+  return 0;
+}
+
+/** mm_jpeg_sw_enc_write_exif:
+ *
+ *  Arguments:
+ *    @p_job: job, its template is used and updated if set
+ *    @jw, @jh: coded main image size
+ *    @thumb: IFD1 is written
+ *    @thumb_data, @thumb_len: coded thumbnail, NULL if not coded yet
+ *    @p: output, NULL to measure
+ *
+ *  Return:
+ *       size of the APP1 segment incl. marker, 0 if it does not fit
+ *
+ *  Description:
+ *       With a template the segment is patched in place and copied out
+ *       followed by the thumbnail, so there is no per tag work unless
+ *       the tags or the image size change. Without one, or if the
+ *       template cannot be built, the tags are serialized from scratch.
+ *
+ **/
+size_t mm_jpeg_sw_enc_write_exif(const mm_jpeg_sw_job_t *p_job,
+  uint32_t jw, uint32_t jh, int thumb, const uint8_t *thumb_data,
+  size_t thumb_len, uint8_t *p)
+{
+  mm_jpeg_sw_exif_tmpl_t *p_tmpl = p_job->exif_tmpl;
+  mm_jpeg_sw_tag_t tags[MM_JPEG_SW_MAX_EXIF_TAGS];
+  uint32_t n;
+  size_t len;
+
+  if (!thumb || NULL == thumb_data) {
+    thumb_data = NULL;
+    thumb_len = 0;
+  }
+  if (NULL != p_tmpl &&
+    (0 == mm_jpeg_sw_exif_patch(p_tmpl, p_job, jw, jh, thumb) ||
+    0 == mm_jpeg_sw_exif_build(p_tmpl, p_job, jw, jh, thumb))) {
+    len = p_tmpl->len + thumb_len;
+    if (len - 2 > 0xffff) {
+      return 0;
+    }
+    if (NULL != p) {
+      memcpy(p, p_tmpl->buf, p_tmpl->len);
+      mm_jpeg_sw_put16(p + 2, (uint32_t)(len - 2));
+      if (p_tmpl->tn_len_off) {
+        mm_jpeg_sw_le32(p + p_tmpl->tn_len_off, (uint32_t)thumb_len);
+      }
+      if (NULL != thumb_data) {
+        memcpy(p + p_tmpl->len, thumb_data, thumb_len);
+      }
+    }
+    return len;
+  }
+
+  n = mm_jpeg_sw_collect_tags(p_job, jw, jh, thumb, tags);
+  return mm_jpeg_sw_write_exif(p, tags, n, thumb_data, thumb_len, NULL);
+}
+
+/** mm_jpeg_sw_exif_tmpl_release:
+ *
+ *  Arguments:
+ *    @p_tmpl: template
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Free the template buffers, it can be used again afterwards
+ *
+ **/
+void mm_jpeg_sw_exif_tmpl_release(mm_jpeg_sw_exif_tmpl_t *p_tmpl)
+{
+  free(p_tmpl->buf);
+  free(p_tmpl->shadow);
+  memset(p_tmpl, 0, sizeof(*p_tmpl));
+}
+
+/** mm_jpeg_sw_code_frame:
+ *
+ *  Arguments:
+ *    @p_enc: encoder
+ *    @p_frame: frame with strips assigned
+ *    @p_side: optional work for the calling thread while the workers
+ *      code the frame, NULL if none
+ *    @side_data: argument of @p_side
+ *
+ *  Return:
+ *       0 for success, -1 on failure
+ *
+ *  Description:
+ *       Publish the frame to the pool and join in until every strip is
+ *       done
+ *
+ **/
+static int32_t mm_jpeg_sw_code_frame(mm_jpeg_sw_enc_t *p_enc,
+  mm_jpeg_sw_frame_t *p_frame, void (*p_side)(void *), void *side_data)
+{
+  pthread_mutex_lock(&p_enc->lock);
+  p_enc->frame = p_frame;
+  p_enc->next_strip = 0;
+  p_enc->strips_done = 0;
+  pthread_cond_broadcast(&p_enc->work_cond);
+  if (NULL != p_side) {
+    pthread_mutex_unlock(&p_enc->lock);
+    p_side(side_data);
+    pthread_mutex_lock(&p_enc->lock);
+  }
+  mm_jpeg_sw_worker_loop(p_enc);
+  while (p_enc->strips_done < p_frame->num_strips) {
+    pthread_cond_wait(&p_enc->done_cond, &p_enc->lock);
+  }
+  p_enc->frame = NULL;
+  pthread_mutex_unlock(&p_enc->lock);
+  return p_frame->error ? -1 : 0;
+}
+
+typedef struct {
+  mm_jpeg_sw_enc_t *p_enc;
+  const mm_jpeg_sw_job_t *p_job;
+  mm_jpeg_sw_image_t img;
+  mm_jpeg_sw_strip_t strip;
+  size_t max_len;            /* room left in APP1 */
+  size_t len;                /* coded thumbnail, 0 if dropped */
+} mm_jpeg_sw_thumb_t;
+
+/** mm_jpeg_sw_code_thumb:
+ *
+ *  Arguments:
+ *    @data: mm_jpeg_sw_thumb_t
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Code the thumbnail as a single interval on the calling thread,
+ *       lowering the quality until it fits in APP1. Dropped if it never
+ *       does.
+ *
+ **/
+static void mm_jpeg_sw_code_thumb(void *data)
+{
+  mm_jpeg_sw_thumb_t *p_th = (mm_jpeg_sw_thumb_t *)data;
+  mm_jpeg_sw_enc_t *p_enc = p_th->p_enc;
+  mm_jpeg_sw_frame_t frame;
+  uint32_t quality = p_th->p_job->thumb_quality;
+  size_t len;
+
+  p_th->len = 0;
+  for (;;) {
+    if (mm_jpeg_sw_frame_setup(&frame, &p_th->img, quality, 1)) {
+      mm_jpeg_sw_frame_release(&frame);
+      return;
+    }
+    frame.strips = &p_th->strip;
+    frame.job = p_th->p_job;
+    p_th->strip.len = 0;
+    if (mm_jpeg_sw_code_strip(&frame, 0)) {
+      mm_jpeg_sw_frame_release(&frame);
+      return;
+    }
+    len = 2 + mm_jpeg_sw_frame_size(&frame);
+    if (len <= p_th->max_len) {
+      if (p_enc->thumb_cap < len) {
+        uint8_t *p = realloc(p_enc->thumb_buf, len);
+        if (NULL == p) {
+          mm_jpeg_sw_frame_release(&frame);
+          return;
+        }
+        p_enc->thumb_buf = p;
+        p_enc->thumb_cap = len;
+      }
+      mm_jpeg_sw_put16(p_enc->thumb_buf, 0xffd8);
+      mm_jpeg_sw_write_frame(p_enc->thumb_buf + 2, &frame);
+      p_th->len = len;
+      mm_jpeg_sw_frame_release(&frame);
+      return;
+    }
+    mm_jpeg_sw_frame_release(&frame);
+    if (quality <= 10) {
+      return;
+    }
+    quality = (quality > 25) ? quality - 15 : 10;
+  }
+}
+
+/** mm_jpeg_sw_enc_encode:
+ *
+ *  Arguments:
+ *    @p_enc: encoder
+ *    @p_job: job
+ *    @p_out: set to the buffer holding the JPEG
+ *    @p_len: set to the JPEG size
+ *
+ *  Return:
+ *       0 for success, -1 on invalid parameters, allocation failure,
+ *       abort or if the output buffer is too small
+ *
+ *  Description:
+ *       Code the main image on the pool while the calling thread codes
+ *       the thumbnail, then write SOI, APP1, the tables and the strips
+ *       into the output. Not reentrant, callers serialize per encoder.
+ *
+ **/
+int32_t mm_jpeg_sw_enc_encode(mm_jpeg_sw_enc_t *p_enc,
+  const mm_jpeg_sw_job_t *p_job, uint8_t **p_out, size_t *p_len)
+{
+  mm_jpeg_sw_image_t main_img;
+  mm_jpeg_sw_frame_t frame;
+  mm_jpeg_sw_thumb_t thumb;
+  size_t exif_len, total, hint;
+  uint8_t *out, *p;
+  int32_t rc;
+
+  if (mm_jpeg_sw_check_image(&p_job->main, &main_img)) {
+    return -1;
+  }
+  memset(&thumb, 0, sizeof(thumb));
+  thumb.p_enc = p_enc;
+  thumb.p_job = p_job;
+  if (p_job->encode_thumbnail &&
+    mm_jpeg_sw_check_image(&p_job->thumb, &thumb.img)) {
+    return -1;
+  }
+
+  rc = mm_jpeg_sw_frame_setup(&frame, &main_img, p_job->quality,
+    p_enc->num_threads * MM_JPEG_SW_STRIPS_PER_THREAD);
+  if (rc) {
+    mm_jpeg_sw_frame_release(&frame);
+    return -1;
+  }
+  /* about 2 bits per pixel covers most scenes at high quality */
+  hint = (size_t)frame.rows_per_strip * frame.mcu_cols * 16 * 16 / 4;
+  if (mm_jpeg_sw_alloc_strips(p_enc, frame.num_strips, hint)) {
+    mm_jpeg_sw_frame_release(&frame);
+    return -1;
+  }
+  frame.strips = p_enc->strips;
+  frame.job = p_job;
+
+  if (p_job->encode_thumbnail) {
+    exif_len = mm_jpeg_sw_enc_write_exif(p_job, frame.jw, frame.jh, 1,
+      NULL, 0, NULL);
+    thumb.max_len = (exif_len && exif_len - 2 < MM_JPEG_SW_APP1_MAX) ?
+      MM_JPEG_SW_APP1_MAX - (exif_len - 2) : 0;
+  }
+
+  rc = mm_jpeg_sw_code_frame(p_enc, &frame,
+    p_job->encode_thumbnail ? mm_jpeg_sw_code_thumb : NULL, &thumb);
+  free(thumb.strip.data);
+  if (rc || mm_jpeg_sw_aborted(p_job)) {
+    mm_jpeg_sw_frame_release(&frame);
+    return -1;
+  }
+
+  /* a thumbnail that did not fit drops IFD1 */
+  exif_len = mm_jpeg_sw_enc_write_exif(p_job, frame.jw, frame.jh,
+    thumb.len != 0, p_enc->thumb_buf, thumb.len, NULL);
+  total = 2 + exif_len + mm_jpeg_sw_frame_size(&frame);
+
+  out = p_job->out;
+  if (NULL == out) {
+    out = (NULL != p_job->alloc_out) ?
+      p_job->alloc_out(p_job->user_data, total) : NULL;
+  } else if (p_job->out_size < total) {
+    out = NULL;
+  }
+  if (NULL == out) {
+    mm_jpeg_sw_frame_release(&frame);
+    return -1;
+  }
+
+  p = mm_jpeg_sw_put16(out, 0xffd8);
+  p += mm_jpeg_sw_enc_write_exif(p_job, frame.jw, frame.jh,
+    thumb.len != 0, p_enc->thumb_buf, thumb.len, p);
+  p += mm_jpeg_sw_write_frame(p, &frame);
+  mm_jpeg_sw_frame_release(&frame);
+
+  *p_out = out;
+  *p_len = (size_t)(p - out);
+  return 0;
+}
@@ -85,4 +85,52 @@ LOCAL_SHARED_LIBRARIES := libcutils libdl libmmjpeg_interface
 
 include $(BUILD_EXECUTABLE)
 
+#sw encoder benchmark, device and host
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)/../inc
+LOCAL_C_INCLUDES += $(call project-path-for,qcom-camera)/mm-image-codec/qexif
+LOCAL_SRC_FILES := mm_jpeg_sw_bench.c ../src/mm_jpeg_sw_enc.c
+LOCAL_MODULE           := mm-jpeg-sw-bench
+LOCAL_32_BIT_ONLY := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)/../inc
+LOCAL_C_INCLUDES += $(call project-path-for,qcom-camera)/mm-image-codec/qexif
+LOCAL_SRC_FILES := mm_jpeg_sw_bench.c ../src/mm_jpeg_sw_enc.c
+LOCAL_MODULE           := mm-jpeg-sw-bench
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+#per shot exif build benchmark, device and host
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)/../inc
+LOCAL_C_INCLUDES += $(call project-path-for,qcom-camera)/mm-image-codec/qexif
+LOCAL_SRC_FILES := mm_jpeg_exif_bench.c ../src/mm_jpeg_sw_enc.c
+LOCAL_MODULE           := mm-jpeg-exif-bench
+LOCAL_32_BIT_ONLY := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)/../inc
+LOCAL_C_INCLUDES += $(call project-path-for,qcom-camera)/mm-image-codec/qexif
+LOCAL_SRC_FILES := mm_jpeg_exif_bench.c ../src/mm_jpeg_sw_enc.c
+LOCAL_MODULE           := mm-jpeg-exif-bench
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
 LOCAL_PATH := $(OLD_LOCAL_PATH)
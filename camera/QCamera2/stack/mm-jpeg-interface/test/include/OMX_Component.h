@@ -0,0 +1,91 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __HOST_OMX_COMPONENT_H__
+#define __HOST_OMX_COMPONENT_H__
+
+#include <OMX_Image.h>
+
+typedef enum OMX_PORTDOMAINTYPE {
+    OMX_PortDomainAudio,
+    OMX_PortDomainVideo,
+    OMX_PortDomainImage,
+    OMX_PortDomainOther,
+    OMX_PortDomainMax = 0x7FFFFFFF
+} OMX_PORTDOMAINTYPE;
+
+typedef struct OMX_PARAM_PORTDEFINITIONTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_DIRTYPE eDir;
+    OMX_U32 nBufferCountActual;
+    OMX_U32 nBufferCountMin;
+    OMX_U32 nBufferSize;
+    OMX_BOOL bEnabled;
+    OMX_BOOL bPopulated;
+    OMX_PORTDOMAINTYPE eDomain;
+    union {
+        OMX_IMAGE_PORTDEFINITIONTYPE image;
+    } format;
+    OMX_BOOL bBuffersContiguous;
+    OMX_U32 nBufferAlignment;
+} OMX_PARAM_PORTDEFINITIONTYPE;
+
+typedef struct OMX_COMPONENTTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_PTR pComponentPrivate;
+    OMX_PTR pApplicationPrivate;
+    OMX_ERRORTYPE (*SendCommand)(OMX_HANDLETYPE hComponent,
+            OMX_COMMANDTYPE Cmd, OMX_U32 nParam1, OMX_PTR pCmdData);
+    OMX_ERRORTYPE (*GetParameter)(OMX_HANDLETYPE hComponent,
+            OMX_INDEXTYPE nParamIndex, OMX_PTR pComponentParameterStructure);
+    OMX_ERRORTYPE (*SetParameter)(OMX_HANDLETYPE hComponent,
+            OMX_INDEXTYPE nIndex, OMX_PTR pComponentParameterStructure);
+    OMX_ERRORTYPE (*GetConfig)(OMX_HANDLETYPE hComponent,
+            OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure);
+    OMX_ERRORTYPE (*SetConfig)(OMX_HANDLETYPE hComponent,
+            OMX_INDEXTYPE nIndex, OMX_PTR pComponentConfigStructure);
+    OMX_ERRORTYPE (*GetExtensionIndex)(OMX_HANDLETYPE hComponent,
+            OMX_STRING cParameterName, OMX_INDEXTYPE *pIndexType);
+    OMX_ERRORTYPE (*GetState)(OMX_HANDLETYPE hComponent,
+            OMX_STATETYPE *pState);
+    OMX_ERRORTYPE (*UseBuffer)(OMX_HANDLETYPE hComponent,
+            OMX_BUFFERHEADERTYPE **ppBufferHdr, OMX_U32 nPortIndex,
+            OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8 *pBuffer);
+    OMX_ERRORTYPE (*FreeBuffer)(OMX_HANDLETYPE hComponent,
+            OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE *pBuffer);
+    OMX_ERRORTYPE (*EmptyThisBuffer)(OMX_HANDLETYPE hComponent,
+            OMX_BUFFERHEADERTYPE *pBuffer);
+    OMX_ERRORTYPE (*FillThisBuffer)(OMX_HANDLETYPE hComponent,
+            OMX_BUFFERHEADERTYPE *pBuffer);
+} OMX_COMPONENTTYPE;
+
+#endif /* __HOST_OMX_COMPONENT_H__ */
@@ -0,0 +1,163 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __HOST_OMX_CORE_H__
+#define __HOST_OMX_CORE_H__
+
+#include <OMX_Index.h>
+
+typedef enum OMX_COMMANDTYPE {
+    OMX_CommandStateSet,
+    OMX_CommandFlush,
+    OMX_CommandPortDisable,
+    OMX_CommandPortEnable,
+    OMX_CommandMarkBuffer,
+    OMX_CommandMax = 0x7FFFFFFF
+} OMX_COMMANDTYPE;
+
+typedef enum OMX_STATETYPE {
+    OMX_StateInvalid,
+    OMX_StateLoaded,
+    OMX_StateIdle,
+    OMX_StateExecuting,
+    OMX_StatePause,
+    OMX_StateWaitForResources,
+    OMX_StateMax = 0x7FFFFFFF
+} OMX_STATETYPE;
+
+typedef enum OMX_ERRORTYPE {
+    OMX_ErrorNone = 0,
+    OMX_ErrorInsufficientResources = (OMX_S32)0x80001000,
+    OMX_ErrorUndefined = (OMX_S32)0x80001001,
+    OMX_ErrorInvalidComponentName = (OMX_S32)0x80001002,
+    OMX_ErrorComponentNotFound = (OMX_S32)0x80001003,
+    OMX_ErrorInvalidComponent = (OMX_S32)0x80001004,
+    OMX_ErrorBadParameter = (OMX_S32)0x80001005,
+    OMX_ErrorNotImplemented = (OMX_S32)0x80001006,
+    OMX_ErrorUnderflow = (OMX_S32)0x80001007,
+    OMX_ErrorOverflow = (OMX_S32)0x80001008,
+    OMX_ErrorHardware = (OMX_S32)0x80001009,
+    OMX_ErrorInvalidState = (OMX_S32)0x8000100A,
+    OMX_ErrorTimeout = (OMX_S32)0x80001011,
+    OMX_ErrorSameState = (OMX_S32)0x80001012,
+    OMX_ErrorIncorrectStateTransition = (OMX_S32)0x80001017,
+    OMX_ErrorMax = 0x7FFFFFFF
+} OMX_ERRORTYPE;
+
+typedef enum OMX_EVENTTYPE {
+    OMX_EventCmdComplete,
+    OMX_EventError,
+    OMX_EventMark,
+    OMX_EventPortSettingsChanged,
+    OMX_EventBufferFlag,
+    OMX_EventResourcesAcquired,
+    OMX_EventComponentResumed,
+    OMX_EventDynamicResourcesAvailable,
+    OMX_EventPortFormatDetected,
+    OMX_EventKhronosExtensions = 0x6F000000,
+    OMX_EventVendorStartUnused = 0x7F000000,
+    OMX_EventMax = 0x7FFFFFFF
+} OMX_EVENTTYPE;
+
+typedef struct OMX_MARKTYPE {
+    OMX_HANDLETYPE hMarkTargetComponent;
+    OMX_PTR pMarkData;
+} OMX_MARKTYPE;
+
+typedef struct OMX_BUFFERHEADERTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U8 *pBuffer;
+    OMX_U32 nAllocLen;
+    OMX_U32 nFilledLen;
+    OMX_U32 nOffset;
+    OMX_PTR pAppPrivate;
+    OMX_PTR pPlatformPrivate;
+    OMX_PTR pInputPortPrivate;
+    OMX_PTR pOutputPortPrivate;
+    OMX_HANDLETYPE hMarkTargetComponent;
+    OMX_PTR pMarkData;
+    OMX_U32 nTickCount;
+    OMX_TICKS nTimeStamp;
+    OMX_U32 nFlags;
+    OMX_U32 nOutputPortIndex;
+    OMX_U32 nInputPortIndex;
+} OMX_BUFFERHEADERTYPE;
+
+typedef struct OMX_CALLBACKTYPE {
+    OMX_ERRORTYPE (*EventHandler)(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+            OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2,
+            OMX_PTR pEventData);
+    OMX_ERRORTYPE (*EmptyBufferDone)(OMX_HANDLETYPE hComponent,
+            OMX_PTR pAppData, OMX_BUFFERHEADERTYPE *pBuffer);
+    OMX_ERRORTYPE (*FillBufferDone)(OMX_HANDLETYPE hComponent,
+            OMX_PTR pAppData, OMX_BUFFERHEADERTYPE *pBuffer);
+} OMX_CALLBACKTYPE;
+
+/* The component table is in OMX_Component.h, as in the Khronos headers */
+#define OMX_SendCommand(hComponent, Cmd, nParam, pCmdData) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->SendCommand(hComponent, Cmd, \
+            nParam, pCmdData)
+#define OMX_GetParameter(hComponent, nParamIndex, pComponentParameterStructure) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->GetParameter(hComponent, \
+            nParamIndex, pComponentParameterStructure)
+#define OMX_SetParameter(hComponent, nParamIndex, pComponentParameterStructure) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->SetParameter(hComponent, \
+            nParamIndex, pComponentParameterStructure)
+#define OMX_GetConfig(hComponent, nConfigIndex, pComponentConfigStructure) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->GetConfig(hComponent, \
+            nConfigIndex, pComponentConfigStructure)
+#define OMX_SetConfig(hComponent, nConfigIndex, pComponentConfigStructure) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->SetConfig(hComponent, \
+            nConfigIndex, pComponentConfigStructure)
+#define OMX_GetExtensionIndex(hComponent, cParameterName, pIndexType) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->GetExtensionIndex(hComponent, \
+            cParameterName, pIndexType)
+#define OMX_GetState(hComponent, pState) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->GetState(hComponent, pState)
+#define OMX_UseBuffer(hComponent, ppBufferHdr, nPortIndex, pAppPrivate, \
+        nSizeBytes, pBuffer) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->UseBuffer(hComponent, ppBufferHdr, \
+            nPortIndex, pAppPrivate, nSizeBytes, pBuffer)
+#define OMX_FreeBuffer(hComponent, nPortIndex, pBuffer) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->FreeBuffer(hComponent, \
+            nPortIndex, pBuffer)
+#define OMX_EmptyThisBuffer(hComponent, pBuffer) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->EmptyThisBuffer(hComponent, pBuffer)
+#define OMX_FillThisBuffer(hComponent, pBuffer) \
+    ((OMX_COMPONENTTYPE *)(hComponent))->FillThisBuffer(hComponent, pBuffer)
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Init(void);
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Deinit(void);
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetHandle(OMX_HANDLETYPE *pHandle,
+        OMX_STRING cComponentName, OMX_PTR pAppData,
+        OMX_CALLBACKTYPE *pCallBacks);
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_FreeHandle(OMX_HANDLETYPE hComponent);
+
+#endif /* __HOST_OMX_CORE_H__ */
@@ -0,0 +1,97 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __HOST_OMX_TYPES_H__
+#define __HOST_OMX_TYPES_H__
+
+/* Host stand-in for the Khronos OpenMAX IL 1.1.2 headers, only what
+ * mm-jpeg-interface uses. Names and layouts follow the spec so the code
+ * compiles unchanged; there is no OMX core on the host, see omx_core_stub.c.
+ */
+
+#include <stdint.h>
+
+#define OMX_API
+#define OMX_APIENTRY
+#define OMX_IN
+#define OMX_OUT
+#define OMX_INOUT
+#define OMX_ALL 0xFFFFFFFF
+
+typedef uint8_t OMX_U8;
+typedef int8_t OMX_S8;
+typedef uint16_t OMX_U16;
+typedef int16_t OMX_S16;
+typedef uint32_t OMX_U32;
+typedef int32_t OMX_S32;
+typedef uint64_t OMX_U64;
+typedef int64_t OMX_S64;
+typedef OMX_S64 OMX_TICKS;
+
+typedef enum OMX_BOOL {
+    OMX_FALSE = 0,
+    OMX_TRUE = !OMX_FALSE,
+    OMX_BOOL_MAX = 0x7FFFFFFF
+} OMX_BOOL;
+
+typedef void *OMX_PTR;
+typedef char *OMX_STRING;
+typedef unsigned char OMX_UUIDTYPE[128];
+typedef void *OMX_HANDLETYPE;
+typedef void *OMX_NATIVE_WINDOWTYPE;
+
+typedef enum OMX_DIRTYPE {
+    OMX_DirInput,
+    OMX_DirOutput,
+    OMX_DirMax = 0x7FFFFFFF
+} OMX_DIRTYPE;
+
+typedef enum OMX_ENDIANTYPE {
+    OMX_EndianBig,
+    OMX_EndianLittle,
+    OMX_EndianMax = 0x7FFFFFFF
+} OMX_ENDIANTYPE;
+
+typedef enum OMX_NUMERICALDATATYPE {
+    OMX_NumericalDataSigned,
+    OMX_NumericalDataUnsigned,
+    OMX_NumercialDataMax = 0x7FFFFFFF
+} OMX_NUMERICALDATATYPE;
+
+typedef union OMX_VERSIONTYPE {
+    struct {
+        OMX_U8 nVersionMajor;
+        OMX_U8 nVersionMinor;
+        OMX_U8 nRevision;
+        OMX_U8 nStep;
+    } s;
+    OMX_U32 nVersion;
+} OMX_VERSIONTYPE;
+
+#endif /* __HOST_OMX_TYPES_H__ */
@@ -0,0 +1,324 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Per shot EXIF build time of the software encoder: the APP1 segment
+ * serialized from the tags every shot against the session template that
+ * only rewrites what changed. The tags mirror what the HAL and the
+ * metadata parser hand over for a burst; every shot moves the time
+ * stamps, exposure, GPS fix and orientation and brings a thumbnail of a
+ * different size. Both paths must produce the same bytes. Builds for the
+ * device and for the host.
+ *
+ *   mm-jpeg-exif-bench [shots]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mm_jpeg_sw_enc.h"
+
+#define BENCH_W 4208
+#define BENCH_H 3120
+#define BENCH_THUMB_MAX 16384
+
+typedef struct {
+  mm_jpeg_sw_exif_tag_t hal[24];
+  uint32_t num_hal;
+  mm_jpeg_sw_exif_tag_t meta[16];
+  uint32_t num_meta;
+  char datetime[20];
+  char subsec[7];
+  char gps_method[40];
+  char lat_ref[2];
+  char lon_ref[2];
+  char datestamp[11];
+  char make[16];
+  char model[16];
+  rat_t lat[3];
+  rat_t lon[3];
+  rat_t gps_time[3];
+  uint8_t maker_note[20];
+  uint8_t scene_type;
+} bench_tags_t;
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ns(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* single values are kept in the entry, like addExifEntry does */
+static void set_val(mm_jpeg_sw_exif_tag_t *p_tag, exif_tag_id_t id,
+  exif_tag_type_t type, const void *val, size_t size)
+{
+  p_tag->tag_id = id;
+  p_tag->tag_entry.type = type;
+  p_tag->tag_entry.count = 1;
+  p_tag->tag_entry.copy = 1;
+  memcpy(&p_tag->tag_entry.data, val, size);
+}
+
+static void set_ptr(mm_jpeg_sw_exif_tag_t *p_tag, exif_tag_id_t id,
+  exif_tag_type_t type, uint32_t count, void *ptr)
+{
+  p_tag->tag_id = id;
+  p_tag->tag_entry.type = type;
+  p_tag->tag_entry.count = count;
+  p_tag->tag_entry.copy = 1;
+  p_tag->tag_entry.data._bytes = ptr;
+}
+
+static void set_rat(mm_jpeg_sw_exif_tag_t *p_tag, exif_tag_id_t id,
+  uint32_t num, uint32_t denom)
+{
+  rat_t r;
+
+  r.num = num;
+  r.denom = denom;
+  set_val(p_tag, id, EXIF_RATIONAL, &r, sizeof(r));
+}
+
+static void set_short(mm_jpeg_sw_exif_tag_t *p_tag, exif_tag_id_t id,
+  uint16_t v)
+{
+  set_val(p_tag, id, EXIF_SHORT, &v, sizeof(v));
+}
+
+/* fill in the tags of shot @shot, same layout for every shot */
+static void make_tags(bench_tags_t *t, uint32_t shot)
+{
+  static const uint16_t orientation[4] = { 1, 6, 3, 8 };
+  uint32_t sec = 1420070400 + shot / 8;
+  srat_t sr;
+  uint32_t n = 0, i;
+
+  snprintf(t->datetime, sizeof(t->datetime), "2015:01:01 %02u:%02u:%02u",
+    (sec / 3600) % 24, (sec / 60) % 60, sec % 60);
+  snprintf(t->subsec, sizeof(t->subsec), "%06u", (shot % 8) * 125000);
+  snprintf(t->datestamp, sizeof(t->datestamp), "2015:01:01");
+  memcpy(t->gps_method, "ASCII\0\0\0GPS", 12);
+  snprintf(t->lat_ref, sizeof(t->lat_ref), "N");
+  snprintf(t->lon_ref, sizeof(t->lon_ref), "W");
+  snprintf(t->make, sizeof(t->make), "QCOM-AA");
+  snprintf(t->model, sizeof(t->model), "QCAM-AA");
+  t->lat[0].num = 37; t->lat[0].denom = 1;
+  t->lat[1].num = 24; t->lat[1].denom = 1;
+  t->lat[2].num = 1000 + shot % 97; t->lat[2].denom = 100;
+  t->lon[0].num = 122; t->lon[0].denom = 1;
+  t->lon[1].num = 5; t->lon[1].denom = 1;
+  t->lon[2].num = 3000 + shot % 89; t->lon[2].denom = 100;
+  t->gps_time[0].num = (sec / 3600) % 24; t->gps_time[0].denom = 1;
+  t->gps_time[1].num = (sec / 60) % 60; t->gps_time[1].denom = 1;
+  t->gps_time[2].num = sec % 60; t->gps_time[2].denom = 1;
+
+  /* HAL tags, see QCamera2HardwareInterface::getExifData */
+  set_ptr(&t->hal[n++], EXIFTAGID_DATE_TIME, EXIF_ASCII, 20, t->datetime);
+  set_ptr(&t->hal[n++], EXIFTAGID_EXIF_DATE_TIME_ORIGINAL, EXIF_ASCII, 20,
+    t->datetime);
+  set_ptr(&t->hal[n++], EXIFTAGID_EXIF_DATE_TIME_DIGITIZED, EXIF_ASCII, 20,
+    t->datetime);
+  set_ptr(&t->hal[n++], EXIFTAGID_SUBSEC_TIME, EXIF_ASCII, 7, t->subsec);
+  set_ptr(&t->hal[n++], EXIFTAGID_SUBSEC_TIME_ORIGINAL, EXIF_ASCII, 7,
+    t->subsec);
+  set_ptr(&t->hal[n++], EXIFTAGID_SUBSEC_TIME_DIGITIZED, EXIF_ASCII, 7,
+    t->subsec);
+  set_rat(&t->hal[n++], EXIFTAGID_FOCAL_LENGTH, 469, 100);
+  set_short(&t->hal[n++], EXIFTAGID_ISO_SPEED_RATING,
+    (uint16_t)(100 + (shot % 4) * 100));
+  set_ptr(&t->hal[n++], EXIFTAGID_GPS_PROCESSINGMETHOD, EXIF_ASCII, 12,
+    t->gps_method);
+  set_ptr(&t->hal[n++], EXIFTAGID_GPS_LATITUDE, EXIF_RATIONAL, 3, t->lat);
+  set_ptr(&t->hal[n++], EXIFTAGID_GPS_LATITUDE_REF, EXIF_ASCII, 2,
+    t->lat_ref);
+  set_ptr(&t->hal[n++], EXIFTAGID_GPS_LONGITUDE, EXIF_RATIONAL, 3, t->lon);
+  set_ptr(&t->hal[n++], EXIFTAGID_GPS_LONGITUDE_REF, EXIF_ASCII, 2,
+    t->lon_ref);
+  set_rat(&t->hal[n++], EXIFTAGID_GPS_ALTITUDE, 3200 + shot % 50, 100);
+  set_val(&t->hal[n], EXIFTAGID_GPS_ALTITUDE_REF, EXIF_BYTE, "", 1);
+  n++;
+  set_ptr(&t->hal[n++], EXIFTAGID_GPS_DATESTAMP, EXIF_ASCII, 11,
+    t->datestamp);
+  set_ptr(&t->hal[n++], EXIFTAGID_GPS_TIMESTAMP, EXIF_RATIONAL, 3,
+    t->gps_time);
+  set_ptr(&t->hal[n++], EXIFTAGID_MAKE, EXIF_ASCII, 8, t->make);
+  set_ptr(&t->hal[n++], EXIFTAGID_MODEL, EXIF_ASCII, 8, t->model);
+  set_short(&t->hal[n++], EXIFTAGID_ORIENTATION, orientation[shot % 4]);
+  set_short(&t->hal[n++], EXIFTAGID_TN_ORIENTATION, orientation[shot % 4]);
+  t->num_hal = n;
+
+  /* metadata tags, see process_meta_data */
+  n = 0;
+  set_rat(&t->meta[n++], EXIFTAGID_EXPOSURE_TIME, 1, 30 + shot % 90);
+  sr.num = (int32_t)(490 + shot % 90);
+  sr.denom = 100;
+  set_val(&t->meta[n++], EXIFTAGID_SHUTTER_SPEED, EXIF_SRATIONAL, &sr,
+    sizeof(sr));
+  set_short(&t->meta[n++], EXIFTAGID_ISO_SPEED_RATING,
+    (uint16_t)(100 + (shot % 4) * 100));
+  set_short(&t->meta[n++], EXIFTAGID_EXPOSURE_MODE, 0);
+  t->scene_type = 1;
+  set_ptr(&t->meta[n++], EXIFTAGID_SCENE_TYPE, EXIF_UNDEFINED, 1,
+    &t->scene_type);
+  sr.num = (int32_t)(shot % 7) * 100 - 300;
+  set_val(&t->meta[n++], EXIFTAGID_BRIGHTNESS, EXIF_SRATIONAL, &sr,
+    sizeof(sr));
+  set_short(&t->meta[n++], EXIFTAGID_FLASH, 0);
+  set_short(&t->meta[n++], EXIFTAGID_FOCAL_LENGTH_35MM, 28);
+  set_rat(&t->meta[n++], EXIFTAGID_F_NUMBER, 220, 100);
+  set_rat(&t->meta[n++], EXIFTAGID_APERTURE, 228, 100);
+  for (i = 0; i < sizeof(t->maker_note); i++) {
+    t->maker_note[i] = (uint8_t)(shot * 7 + i);
+  }
+  set_ptr(&t->meta[n++], EXIFTAGID_EXIF_MAKER_NOTE, EXIF_UNDEFINED,
+    sizeof(t->maker_note), t->maker_note);
+  set_short(&t->meta[n++], EXIFTAGID_SCENE_CAPTURE_TYPE, 0);
+  t->num_meta = n;
+}
+
+/* measure and write, as the encoder does once the thumbnail is coded */
+static size_t write_app1(mm_jpeg_sw_job_t *p_job, const uint8_t *thumb,
+  size_t thumb_len, uint8_t *out)
+{
+  size_t len;
+
+  len = mm_jpeg_sw_enc_write_exif(p_job, BENCH_W, BENCH_H, 1, thumb,
+    thumb_len, NULL);
+  if (0 == len) {
+    return 0;
+  }
+  return mm_jpeg_sw_enc_write_exif(p_job, BENCH_W, BENCH_H, 1, thumb,
+    thumb_len, out);
+}
+
+static int run_case(const char *name, bench_tags_t *t, mm_jpeg_sw_job_t *p_job,
+  const uint8_t *thumb, uint8_t *out, int64_t *lat, int shots)
+{
+  int64_t sum = 0;
+  int i;
+
+  for (i = 0; i < shots; i++) {
+    size_t thumb_len = 6000 + ((size_t)i * 379) % 8000;
+    int64_t start;
+
+    make_tags(t, (uint32_t)i);
+    start = now_ns();
+    if (0 == write_app1(p_job, thumb, thumb_len, out)) {
+      printf("%s: APP1 write failed at shot %d\n", name, i);
+      return -1;
+    }
+    lat[i] = now_ns() - start;
+    sum += lat[i];
+  }
+  qsort(lat, (size_t)shots, sizeof(lat[0]), cmp_ns);
+  printf("%-9s mean %7.2f us  p50 %7.2f us  p95 %7.2f us  max %7.2f us\n",
+    name, (double)sum / shots / 1e3, (double)lat[shots / 2] / 1e3,
+    (double)lat[shots * 95 / 100] / 1e3, (double)lat[shots - 1] / 1e3);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int shots = (argc > 1) ? atoi(argv[1]) : 2000;
+  static bench_tags_t tags;
+  mm_jpeg_sw_exif_tmpl_t tmpl;
+  mm_jpeg_sw_job_t job;
+  uint8_t *thumb = malloc(BENCH_THUMB_MAX);
+  uint8_t *out = malloc(2 * 65536);
+  uint8_t *ref = out + 65536;
+  int64_t *lat;
+  int i, rc = 0;
+
+  if (shots < 2) {
+    shots = 2000;
+  }
+  lat = malloc(sizeof(int64_t) * (size_t)shots);
+  if (NULL == thumb || NULL == out || NULL == lat) {
+    printf("no memory\n");
+    return 1;
+  }
+  for (i = 0; i < BENCH_THUMB_MAX; i++) {
+    thumb[i] = (uint8_t)(i * 13);
+  }
+  memset(&tmpl, 0, sizeof(tmpl));
+  memset(&job, 0, sizeof(job));
+  job.encode_thumbnail = 1;
+  job.exif[0].entries = tags.hal;
+  job.exif[1].entries = tags.meta;
+  make_tags(&tags, 0);
+  job.exif[0].count = tags.num_hal;
+  job.exif[1].count = tags.num_meta;
+
+  /* both paths have to agree byte for byte on every shot */
+  for (i = 0; i < shots && 0 == rc; i++) {
+    size_t thumb_len = 6000 + ((size_t)i * 379) % 8000;
+    size_t len, ref_len;
+
+    make_tags(&tags, (uint32_t)i);
+    job.exif_tmpl = NULL;
+    ref_len = write_app1(&job, thumb, thumb_len, ref);
+    job.exif_tmpl = &tmpl;
+    len = write_app1(&job, thumb, thumb_len, out);
+    if (0 == len || len != ref_len || memcmp(out, ref, len)) {
+      printf("template output differs at shot %d (%zu vs %zu bytes)\n", i,
+        len, ref_len);
+      rc = -1;
+    }
+  }
+  printf("%d shots, %u + %u tags, %zu byte APP1 without thumbnail\n",
+    shots, tags.num_hal, tags.num_meta, tmpl.len);
+  printf("template: %u builds, %u reuses, %.1f values rewritten per shot\n",
+    tmpl.builds, tmpl.reuses, (double)tmpl.patched / shots);
+  mm_jpeg_sw_exif_tmpl_release(&tmpl);
+
+  if (0 == rc) {
+    job.exif_tmpl = NULL;
+    rc = run_case("serialize", &tags, &job, thumb, out, lat, shots);
+  }
+  if (0 == rc) {
+    job.exif_tmpl = &tmpl;
+    rc = run_case("template", &tags, &job, thumb, out, lat, shots);
+    mm_jpeg_sw_exif_tmpl_release(&tmpl);
+  }
+
+  free(lat);
+  free(out);
+  free(thumb);
+  return (0 == rc) ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Encode time of the software JPEG encoder over a sweep of picture sizes
+ * and worker counts. The input is a synthetic NV21 frame with gradients
+ * and noise so the entropy coder sees camera like statistics. Builds for
+ * the device and for the host.
+ *
+ *   mm-jpeg-sw-bench [iterations] [max threads] [quality]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mm_jpeg_sw_enc.h"
+
+typedef struct {
+  const char *name;
+  uint32_t w;
+  uint32_t h;
+} bench_size_t;
+
+static const bench_size_t sizes[] = {
+  { "VGA", 640, 480 },
+  { "1080p", 1920, 1080 },
+  { "8MP", 3264, 2448 },
+  { "13MP", 4208, 3120 },
+};
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ns(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void fill_frame(uint8_t *y, uint8_t *c, uint32_t w, uint32_t h)
+{
+  uint32_t i, j, seed = 1;
+
+  for (j = 0; j < h; j++) {
+    for (i = 0; i < w; i++) {
+      seed = seed * 1103515245 + 12345;
+      y[j * w + i] = (uint8_t)(((i + j) * 255 / (w + h)) +
+        ((seed >> 16) & 15));
+    }
+  }
+  for (j = 0; j < h / 2; j++) {
+    for (i = 0; i < w; i += 2) {
+      c[j * w + i] = (uint8_t)(96 + (j * 64) / (h / 2));
+      c[j * w + i + 1] = (uint8_t)(96 + (i * 64) / w);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : 10;
+  uint32_t max_threads = (argc > 2) ? (uint32_t)atoi(argv[2]) : 0;
+  uint32_t quality = (argc > 3) ? (uint32_t)atoi(argv[3]) : 85;
+  size_t s;
+  int rc = 0;
+
+  if (iterations < 1) {
+    iterations = 10;
+  }
+  if (0 == max_threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = (cpus > 0) ? (uint32_t)cpus : 1;
+  }
+  if (max_threads > MM_JPEG_SW_MAX_THREADS) {
+    max_threads = MM_JPEG_SW_MAX_THREADS;
+  }
+
+  printf("%d iterations, quality %u, %ld cores online\n", iterations,
+    quality, sysconf(_SC_NPROCESSORS_ONLN));
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && 0 == rc; s++) {
+    uint32_t w = sizes[s].w, h = sizes[s].h;
+    size_t out_size = (size_t)w * h * 3 / 2 + 65536;
+    uint8_t *y = malloc((size_t)w * h);
+    uint8_t *c = malloc((size_t)w * h / 2);
+    uint8_t *out = malloc(out_size);
+    int64_t *lat = malloc(sizeof(int64_t) * (size_t)iterations);
+    double base_ms = 0.0;
+    uint32_t threads;
+
+    if (NULL == y || NULL == c || NULL == out || NULL == lat) {
+      printf("%s: no memory\n", sizes[s].name);
+      rc = -1;
+    } else {
+      fill_frame(y, c, w, h);
+    }
+
+    for (threads = 1; threads <= max_threads && 0 == rc; threads *= 2) {
+      mm_jpeg_sw_enc_t enc;
+      mm_jpeg_sw_job_t job;
+      uint8_t *p_out = NULL;
+      size_t len = 0;
+      int64_t sum = 0;
+      double mean_ms;
+      int i;
+
+      memset(&job, 0, sizeof(job));
+      job.main.y = y;
+      job.main.c = c;
+      job.main.y_stride = w;
+      job.main.c_stride = w;
+      job.main.width = w;
+      job.main.height = h;
+      job.main.fmt = MM_JPEG_SW_FMT_H2V2_CRCB;
+      job.quality = quality;
+      job.encode_thumbnail = 1;
+      job.thumb = job.main;
+      job.thumb.out_w = 320;
+      job.thumb.out_h = 240;
+      job.thumb_quality = quality;
+      job.out = out;
+      job.out_size = out_size;
+
+      mm_jpeg_sw_enc_init(&enc, threads);
+      /* warm up the strip buffers */
+      rc = mm_jpeg_sw_enc_encode(&enc, &job, &p_out, &len);
+      for (i = 0; i < iterations && 0 == rc; i++) {
+        int64_t start = now_ns();
+        rc = mm_jpeg_sw_enc_encode(&enc, &job, &p_out, &len);
+        lat[i] = now_ns() - start;
+        sum += lat[i];
+      }
+      mm_jpeg_sw_enc_deinit(&enc);
+      if (rc) {
+        printf("%s: encode failed with %u threads\n", sizes[s].name, threads);
+        break;
+      }
+      if (len < 4 || p_out[0] != 0xff || p_out[1] != 0xd8 ||
+        p_out[len - 2] != 0xff || p_out[len - 1] != 0xd9) {
+        printf("%s: bad bitstream with %u threads\n", sizes[s].name, threads);
+        rc = -1;
+        break;
+      }
+
+      qsort(lat, (size_t)iterations, sizeof(lat[0]), cmp_ns);
+      mean_ms = (double)sum / iterations / 1e6;
+      if (1 == threads) {
+        base_ms = mean_ms;
+      }
+      printf("%-6s %ux%u threads %u  mean %8.2f ms  p50 %8.2f ms  "
+        "%6.1f MP/s  x%.2f  %zu bytes\n",
+        sizes[s].name, w, h, threads, mean_ms,
+        (double)lat[iterations / 2] / 1e6,
+        (double)w * h / 1e6 / (mean_ms / 1e3),
+        base_ms / mean_ms, len);
+    }
+
+    free(lat);
+    free(out);
+    free(c);
+    free(y);
+  }
+  return (0 == rc) ? 0 : 1;
+}
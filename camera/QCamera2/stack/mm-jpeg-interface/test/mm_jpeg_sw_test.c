@@ -0,0 +1,414 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Host check of the software encoder path of libmmjpeg_interface, driven
+ * through jpeg_open and its ops the way the HAL drives them. The stub OMX
+ * core has no components, so every session runs on the sw job thread:
+ *   - encode into the session destination buffer, with a thumbnail
+ *   - encode into memory from the session get_memory callback
+ *   - abort_job of an encode in flight, then reuse of the session
+ *
+ *   make -C camera/QCamera2/stack/mm-jpeg-interface/test check
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm_jpeg_interface.h"
+
+#define ERROR(format, ...) printf( \
+  "%s[%d] : ERROR: " format "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define TEST_WIDTH      640
+#define TEST_HEIGHT     480
+#define TEST_BIG_WIDTH  4208
+#define TEST_BIG_HEIGHT 3120
+#define TEST_TIMEOUT_S  10
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t done;
+  uint32_t errors;
+  uint32_t job_id;             /* of the last callback */
+  uint8_t *out;
+  size_t out_len;
+  uint32_t get_calls;
+  uint32_t put_calls;
+  omx_jpeg_ouput_buf_t mem;
+} test_ctx_t;
+
+static test_ctx_t g_ctx = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+  0, 0, 0, NULL, 0, 0, 0, { NULL, NULL, 0, 0, NULL, 0 }
+};
+
+static void test_encode_cb(jpeg_job_status_t status, uint32_t client_hdl,
+  uint32_t jobId, mm_jpeg_output_t *p_output, void *userData)
+{
+  test_ctx_t *ctx = (test_ctx_t *)userData;
+
+  pthread_mutex_lock(&ctx->lock);
+  ctx->job_id = jobId;
+  if ((JPEG_JOB_STATUS_DONE != status) || (NULL == p_output)) {
+    ctx->errors++;
+  } else {
+    ctx->out = p_output->buf_vaddr;
+    ctx->out_len = p_output->buf_filled_len;
+  }
+  ctx->done++;
+  pthread_cond_signal(&ctx->cond);
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+static int test_get_memory(omx_jpeg_ouput_buf_t *p_out_buf)
+{
+  p_out_buf->vaddr = malloc(p_out_buf->size);
+  p_out_buf->isheap = 1;
+  g_ctx.get_calls++;
+  return (NULL == p_out_buf->vaddr) ? -1 : 0;
+}
+
+static int test_put_memory(omx_jpeg_ouput_buf_t *p_out_buf)
+{
+  free(p_out_buf->vaddr);
+  p_out_buf->vaddr = NULL;
+  g_ctx.put_calls++;
+  return 0;
+}
+
+/* Wait until done reaches target, 0 on success */
+static int wait_done(uint32_t target)
+{
+  struct timespec ts;
+  int rc = 0;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += TEST_TIMEOUT_S;
+  pthread_mutex_lock(&g_ctx.lock);
+  while ((g_ctx.done < target) && (0 == rc)) {
+    rc = pthread_cond_timedwait(&g_ctx.cond, &g_ctx.lock, &ts);
+  }
+  pthread_mutex_unlock(&g_ctx.lock);
+  return rc ? -1 : 0;
+}
+
+/* NV21 frame with gradients so the entropy coder has some work */
+static uint8_t *test_frame(uint32_t w, uint32_t h)
+{
+  uint8_t *p = (uint8_t *)malloc((size_t)w * h * 3 / 2);
+  uint32_t x, y;
+
+  if (NULL == p) {
+    return NULL;
+  }
+  for (y = 0; y < h; y++) {
+    for (x = 0; x < w; x++) {
+      p[y * w + x] = (uint8_t)((x + y * 3) ^ (x >> 3));
+    }
+  }
+  for (y = 0; y < h / 2; y++) {
+    for (x = 0; x < w; x += 2) {
+      p[w * h + y * w + x] = (uint8_t)(128 + (x >> 2));
+      p[w * h + y * w + x + 1] = (uint8_t)(128 - (y >> 1));
+    }
+  }
+  return p;
+}
+
+static void test_fill_buf(mm_jpeg_buf_t *p_buf, uint8_t *addr, uint32_t w,
+  uint32_t h)
+{
+  memset(p_buf, 0, sizeof(*p_buf));
+  p_buf->buf_vaddr = addr;
+  p_buf->fd = -1;
+  p_buf->buf_size = (size_t)w * h * 3 / 2;
+  p_buf->format = MM_JPEG_FMT_YUV;
+  p_buf->offset.num_planes = 2;
+  p_buf->offset.mp[0].len = w * h;
+  p_buf->offset.mp[0].stride = (int32_t)w;
+  p_buf->offset.mp[0].scanline = (int32_t)h;
+  p_buf->offset.mp[1].len = w * h / 2;
+  p_buf->offset.mp[1].stride = (int32_t)w;
+  p_buf->offset.mp[1].scanline = (int32_t)(h / 2);
+  p_buf->offset.frame_len = (uint32_t)p_buf->buf_size;
+}
+
+static void test_fill_dim(mm_jpeg_dim_t *p_dim, uint32_t w, uint32_t h,
+  uint32_t out_w, uint32_t out_h)
+{
+  memset(p_dim, 0, sizeof(*p_dim));
+  p_dim->src_dim.width = (int32_t)w;
+  p_dim->src_dim.height = (int32_t)h;
+  p_dim->dst_dim.width = (int32_t)out_w;
+  p_dim->dst_dim.height = (int32_t)out_h;
+  p_dim->crop.width = (int32_t)w;
+  p_dim->crop.height = (int32_t)h;
+}
+
+static void test_session_params(mm_jpeg_encode_params_t *p_params,
+  uint8_t *frame, uint32_t w, uint32_t h, uint8_t *dst, size_t dst_size)
+{
+  memset(p_params, 0, sizeof(*p_params));
+  p_params->jpeg_cb = test_encode_cb;
+  p_params->userdata = &g_ctx;
+  p_params->color_format = MM_JPEG_COLOR_FORMAT_YCRCBLP_H2V2;
+  p_params->thumb_color_format = MM_JPEG_COLOR_FORMAT_YCRCBLP_H2V2;
+  p_params->num_src_bufs = 1;
+  p_params->num_tmb_bufs = 1;
+  p_params->num_dst_bufs = 1;
+  test_fill_buf(&p_params->src_main_buf[0], frame, w, h);
+  test_fill_buf(&p_params->src_thumb_buf[0], frame, w, h);
+  p_params->dest_buf[0].buf_vaddr = dst;
+  p_params->dest_buf[0].buf_size = dst_size;
+  p_params->dest_buf[0].fd = -1;
+  p_params->quality = 85;
+  p_params->thumb_quality = 75;
+  test_fill_dim(&p_params->main_dim, w, h, w, h);
+}
+
+static void test_job(mm_jpeg_job_t *p_job, mm_jpeg_encode_params_t *p_params,
+  uint32_t session_id)
+{
+  memset(p_job, 0, sizeof(*p_job));
+  p_job->job_type = JPEG_JOB_TYPE_ENCODE;
+  p_job->encode_job.session_id = session_id;
+  p_job->encode_job.main_dim = p_params->main_dim;
+  p_job->encode_job.thumb_dim = p_params->thumb_dim;
+}
+
+/* Baseline jpeg: SOI first, EOI last, and the Exif APP1 if asked for */
+static int test_check_jpeg(const uint8_t *p, size_t len, int exif)
+{
+  if ((NULL == p) || (len < 4) || (p[0] != 0xFF) || (p[1] != 0xD8) ||
+    (p[len - 2] != 0xFF) || (p[len - 1] != 0xD9)) {
+    ERROR("not a jpeg, %zu bytes", len);
+    return -1;
+  }
+  if (exif && ((len < 10) || (p[2] != 0xFF) || (p[3] != 0xE1) ||
+    memcmp(p + 6, "Exif", 4))) {
+    ERROR("no Exif APP1");
+    return -1;
+  }
+  return 0;
+}
+
+static void test_reset(void)
+{
+  pthread_mutex_lock(&g_ctx.lock);
+  g_ctx.done = 0;
+  g_ctx.errors = 0;
+  g_ctx.out = NULL;
+  g_ctx.out_len = 0;
+  pthread_mutex_unlock(&g_ctx.lock);
+}
+
+static int test_encode(mm_jpeg_ops_t *ops, uint32_t handle, uint8_t *frame)
+{
+  mm_jpeg_encode_params_t params;
+  mm_jpeg_job_t job;
+  size_t dst_size = TEST_WIDTH * TEST_HEIGHT * 3 / 2;
+  uint8_t *dst = (uint8_t *)malloc(dst_size);
+  uint32_t session_id = 0;
+  uint32_t job_id = 0;
+  int rc = -1;
+
+  test_reset();
+  test_session_params(&params, frame, TEST_WIDTH, TEST_HEIGHT, dst, dst_size);
+  params.encode_thumbnail = 1;
+  test_fill_dim(&params.thumb_dim, TEST_WIDTH, TEST_HEIGHT, 160, 120);
+  if ((NULL == dst) || ops->create_session(handle, &params, &session_id) ||
+    (0 == session_id)) {
+    ERROR("create_session failed");
+    goto end;
+  }
+  test_job(&job, &params, session_id);
+  if (ops->start_job(&job, &job_id)) {
+    ERROR("start_job failed");
+    goto destroy;
+  }
+  if (wait_done(1) || g_ctx.errors || (g_ctx.job_id != job_id)) {
+    ERROR("encode did not complete, errors %u", g_ctx.errors);
+    goto destroy;
+  }
+  if ((g_ctx.out != dst) || (g_ctx.out_len > dst_size) ||
+    test_check_jpeg(g_ctx.out, g_ctx.out_len, 1)) {
+    ERROR("bad output %p len %zu", g_ctx.out, g_ctx.out_len);
+    goto destroy;
+  }
+  printf("encode: %ux%u with thumbnail into %zu bytes\n", TEST_WIDTH,
+    TEST_HEIGHT, g_ctx.out_len);
+  rc = 0;
+
+destroy:
+  ops->destroy_session(session_id);
+end:
+  free(dst);
+  return rc;
+}
+
+static int test_get_mem(mm_jpeg_ops_t *ops, uint32_t handle, uint8_t *frame)
+{
+  mm_jpeg_encode_params_t params;
+  mm_jpeg_job_t job;
+  uint32_t session_id = 0;
+  uint32_t job_id = 0;
+  int rc = -1;
+
+  test_reset();
+  memset(&g_ctx.mem, 0, sizeof(g_ctx.mem));
+  test_session_params(&params, frame, TEST_WIDTH, TEST_HEIGHT,
+    (uint8_t *)&g_ctx.mem, sizeof(g_ctx.mem));
+  params.get_memory = test_get_memory;
+  params.put_memory = test_put_memory;
+  if (ops->create_session(handle, &params, &session_id) || (0 == session_id)) {
+    ERROR("create_session failed");
+    return -1;
+  }
+  test_job(&job, &params, session_id);
+  if (ops->start_job(&job, &job_id)) {
+    ERROR("start_job failed");
+    goto destroy;
+  }
+  if (wait_done(1) || g_ctx.errors || (g_ctx.job_id != job_id)) {
+    ERROR("encode did not complete, errors %u", g_ctx.errors);
+    goto destroy;
+  }
+  /* the jpeg is allocated at its exact size; like the OMX path the
+   * callback hands back the omx_jpeg_ouput_buf_t it was written to */
+  if ((1 != g_ctx.get_calls) || (g_ctx.out != (uint8_t *)&g_ctx.mem) ||
+    (g_ctx.out_len != g_ctx.mem.size) ||
+    test_check_jpeg(g_ctx.mem.vaddr, g_ctx.out_len, 0)) {
+    ERROR("get_memory calls %u out %p mem %p len %zu size %zu",
+      g_ctx.get_calls, g_ctx.out, g_ctx.mem.vaddr, g_ctx.out_len,
+      g_ctx.mem.size);
+    goto destroy;
+  }
+  printf("get_memory: %zu bytes\n", g_ctx.out_len);
+  rc = 0;
+
+destroy:
+  ops->destroy_session(session_id);
+  free(g_ctx.mem.vaddr);
+  return rc;
+}
+
+static int test_abort(mm_jpeg_ops_t *ops, uint32_t handle)
+{
+  mm_jpeg_encode_params_t params;
+  mm_jpeg_job_t job;
+  size_t dst_size = (size_t)TEST_BIG_WIDTH * TEST_BIG_HEIGHT * 3 / 2;
+  uint8_t *frame = test_frame(TEST_BIG_WIDTH, TEST_BIG_HEIGHT);
+  uint8_t *dst = (uint8_t *)malloc(dst_size);
+  uint32_t session_id = 0;
+  uint32_t job_id = 0;
+  uint32_t done;
+  int rc = -1;
+
+  test_reset();
+  test_session_params(&params, frame, TEST_BIG_WIDTH, TEST_BIG_HEIGHT, dst,
+    dst_size);
+  if ((NULL == frame) || (NULL == dst) ||
+    ops->create_session(handle, &params, &session_id) || (0 == session_id)) {
+    ERROR("create_session failed");
+    goto end;
+  }
+  test_job(&job, &params, session_id);
+  if (ops->start_job(&job, &job_id)) {
+    ERROR("start_job failed");
+    goto destroy;
+  }
+  usleep(5000);
+  /* the status is not meaningful, the HAL does not look at it either */
+  ops->abort_job(job_id);
+
+  /* nothing may be delivered once abort_job has returned */
+  pthread_mutex_lock(&g_ctx.lock);
+  done = g_ctx.done;
+  pthread_mutex_unlock(&g_ctx.lock);
+  usleep(200000);
+  if ((g_ctx.done != done) || g_ctx.errors) {
+    ERROR("callback after abort, done %u -> %u errors %u", done, g_ctx.done,
+      g_ctx.errors);
+    goto destroy;
+  }
+
+  /* the session takes the next job */
+  if (ops->start_job(&job, &job_id)) {
+    ERROR("start_job after abort failed");
+    goto destroy;
+  }
+  if (wait_done(done + 1) || g_ctx.errors || (g_ctx.job_id != job_id) ||
+    test_check_jpeg(g_ctx.out, g_ctx.out_len, 0)) {
+    ERROR("encode after abort failed, errors %u", g_ctx.errors);
+    goto destroy;
+  }
+  printf("abort: %s, next job %zu bytes\n",
+    done ? "completed before abort" : "dropped", g_ctx.out_len);
+  rc = 0;
+
+destroy:
+  ops->destroy_session(session_id);
+end:
+  free(frame);
+  free(dst);
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+  mm_jpeg_ops_t ops;
+  mm_dimension pic_size;
+  uint8_t *frame = test_frame(TEST_WIDTH, TEST_HEIGHT);
+  uint32_t handle;
+  int rc = 0;
+
+  memset(&ops, 0, sizeof(ops));
+  pic_size.w = TEST_BIG_WIDTH;
+  pic_size.h = TEST_BIG_HEIGHT;
+  handle = jpeg_open(&ops, pic_size);
+  if ((NULL == frame) || (0 == handle)) {
+    ERROR("jpeg_open failed");
+    return 1;
+  }
+
+  rc |= test_encode(&ops, handle, frame);
+  rc |= test_get_mem(&ops, handle, frame);
+  rc |= test_abort(&ops, handle);
+
+  ops.close(handle);
+  free(frame);
+  printf("%s\n", rc ? "FAIL" : "PASS");
+  return rc ? 1 : 0;
+}
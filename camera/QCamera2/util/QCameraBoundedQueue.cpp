@@ -0,0 +1,601 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <sched.h>
+#include <stdlib.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include "QCameraBoundedQueue.h"
+
+/* Marks a ring slot whose item is being matched by flushNodes */
+#define Q_SLOT_BUSY ((void *)1)
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraBoundedQueue
+ *
+ * DESCRIPTION: default constructor of QCameraBoundedQueue
+ *
+ * PARAMETERS :
+ *   @capacity : max number of items in each lane
+ *   @spsc     : single producer single consumer mode
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraBoundedQueue::QCameraBoundedQueue(uint32_t capacity, bool spsc)
+{
+    init(capacity, spsc, NULL, NULL);
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraBoundedQueue
+ *
+ * DESCRIPTION: constructor of QCameraBoundedQueue
+ *
+ * PARAMETERS :
+ *   @capacity    : max number of items in each lane
+ *   @spsc        : single producer single consumer mode
+ *   @data_rel_fn : function ptr to release node data internal resource
+ *   @user_data   : user data ptr
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraBoundedQueue::QCameraBoundedQueue(uint32_t capacity, bool spsc,
+        release_data_fn data_rel_fn, void *user_data)
+{
+    init(capacity, spsc, data_rel_fn, user_data);
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraBoundedQueue
+ *
+ * DESCRIPTION: deconstructor of QCameraBoundedQueue
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraBoundedQueue::~QCameraBoundedQueue()
+{
+    flush();
+    free(m_ring);
+    free(m_prio);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : init
+ *
+ * DESCRIPTION: allocate both lanes, capacity is rounded up to a power of 2
+ *
+ * PARAMETERS :
+ *   @capacity    : max number of items in each lane
+ *   @spsc        : single producer single consumer mode
+ *   @data_rel_fn : function ptr to release node data internal resource
+ *   @user_data   : user data ptr
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBoundedQueue::init(uint32_t capacity, bool spsc,
+        release_data_fn data_rel_fn, void *user_data)
+{
+    uint32_t size = 1;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    pthread_mutex_init(&m_lock, NULL);
+    m_ring = (void **)calloc(size, sizeof(void *));
+    m_prio = (void **)calloc(size, sizeof(void *));
+    if (NULL == m_ring || NULL == m_prio) {
+        ALOGE("%s: No memory for %d queue nodes", __func__, size);
+        free(m_ring);
+        free(m_prio);
+        m_ring = NULL;
+        m_prio = NULL;
+        size = 0;
+    }
+    m_mask = size - 1;
+    m_head = 0;
+    m_tail = 0;
+    m_prioCount = 0;
+    m_size = 0;
+    m_spsc = spsc;
+    m_dataFn = data_rel_fn;
+    m_userData = user_data;
+}
+
+/*===========================================================================
+ * FUNCTION   : isEmpty
+ *
+ * DESCRIPTION: return if the queue is empty or not
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true -- queue is empty; false -- not empty
+ *==========================================================================*/
+bool QCameraBoundedQueue::isEmpty()
+{
+    return getCurrentSize() == 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : getCurrentSize
+ *
+ * DESCRIPTION: return number of items in both lanes
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of items
+ *==========================================================================*/
+int QCameraBoundedQueue::getCurrentSize()
+{
+    return __atomic_load_n(&m_size, __ATOMIC_ACQUIRE);
+}
+
+/*===========================================================================
+ * FUNCTION   : enqueue
+ *
+ * DESCRIPTION: enqueue data into the normal lane
+ *
+ * PARAMETERS :
+ *   @data    : data to be enqueued
+ *
+ * RETURN     : true -- success; false -- failed, queue is full or data
+ *              is NULL
+ *==========================================================================*/
+bool QCameraBoundedQueue::enqueue(void *data)
+{
+    bool ret;
+
+    if (m_spsc) {
+        ret = push(data);
+    } else {
+        pthread_mutex_lock(&m_lock);
+        ret = push(data);
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    if (!ret) {
+        ALOGE("%s: queue is full (%d)", __func__, m_mask + 1);
+    }
+    return ret;
+}
+
+/*===========================================================================
+ * FUNCTION   : enqueueWithPriority
+ *
+ * DESCRIPTION: enqueue data into the priority lane. It will be dequeued
+ *              before all items of the normal lane and before items
+ *              enqueued with priority earlier.
+ *
+ * PARAMETERS :
+ *   @data    : data to be enqueued
+ *
+ * RETURN     : true -- success; false -- failed, queue is full or data
+ *              is NULL
+ *==========================================================================*/
+bool QCameraBoundedQueue::enqueueWithPriority(void *data)
+{
+    bool ret = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (NULL != m_prio && NULL != data && m_prioCount <= m_mask) {
+        m_prio[m_prioCount] = data;
+        __atomic_add_fetch(&m_size, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&m_prioCount, m_prioCount + 1, __ATOMIC_RELEASE);
+        ret = true;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (!ret) {
+        ALOGE("%s: priority queue is full (%d)", __func__, m_mask + 1);
+    }
+    return ret;
+}
+
+/*===========================================================================
+ * FUNCTION   : dequeue
+ *
+ * DESCRIPTION: dequeue data from the queue
+ *
+ * PARAMETERS :
+ *   @bFromHead : if true, dequeue from the head
+ *                if false, dequeue from the tail
+ *
+ * RETURN     : data ptr. NULL if not any data in the queue.
+ *==========================================================================*/
+void* QCameraBoundedQueue::dequeue(bool bFromHead)
+{
+    void *data = NULL;
+
+    if (!bFromHead || !m_spsc) {
+        pthread_mutex_lock(&m_lock);
+        if (bFromHead) {
+            data = popPrio();
+            if (NULL == data) {
+                data = popHead();
+            }
+        } else {
+            data = popTail();
+        }
+        pthread_mutex_unlock(&m_lock);
+        return data;
+    }
+
+    if (__atomic_load_n(&m_prioCount, __ATOMIC_ACQUIRE) > 0) {
+        pthread_mutex_lock(&m_lock);
+        data = popPrio();
+        pthread_mutex_unlock(&m_lock);
+        if (NULL != data) {
+            return data;
+        }
+    }
+
+    return popHead();
+}
+
+/*===========================================================================
+ * FUNCTION   : flush
+ *
+ * DESCRIPTION: flush all nodes from the queue, queue will be empty after this
+ *              operation.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBoundedQueue::flush()
+{
+    void *data;
+
+    pthread_mutex_lock(&m_lock);
+    while (NULL != (data = popPrio())) {
+        releaseData(data);
+    }
+
+    if (NULL != m_ring) {
+        uint32_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+
+        for (uint32_t pos = head; pos != tail; pos++) {
+            data = claim(pos);
+            if (NULL != data) {
+                __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+                releaseData(data);
+            }
+        }
+
+        // Move the head past the emptied slots, otherwise they still count
+        // against the capacity and enqueue fails on an empty queue. The
+        // consumer may have moved it on meanwhile, never move it back.
+        while ((int32_t)(tail - head) > 0 &&
+                !__atomic_compare_exchange_n(&m_head, &head, tail, false,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : flushNodes
+ *
+ * DESCRIPTION: flush only specific nodes, depending on
+ *              the given matching function.
+ *
+ * PARAMETERS :
+ *   @match   : matching function
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBoundedQueue::flushNodes(match_fn match)
+{
+    if ( NULL == match ) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < m_prioCount; i++) {
+        if (match(m_prio[i], m_userData)) {
+            __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+            releaseData(m_prio[i]);
+        } else {
+            m_prio[count++] = m_prio[i];
+        }
+    }
+    __atomic_store_n(&m_prioCount, count, __ATOMIC_RELEASE);
+
+    if (NULL != m_ring) {
+        uint32_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+
+        for (uint32_t pos = head; pos != tail; pos++) {
+            void **slot = &m_ring[pos & m_mask];
+            void *data = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+            // Hold the item while matching so the consumer can not take it
+            if (NULL == data || !__atomic_compare_exchange_n(slot, &data,
+                    Q_SLOT_BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+
+            if (match(data, m_userData)) {
+                __atomic_store_n(slot, NULL, __ATOMIC_RELEASE);
+                __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+                releaseData(data);
+            } else {
+                __atomic_store_n(slot, data, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : flushNodes
+ *
+ * DESCRIPTION: flush only specific nodes, depending on
+ *              the given matching function.
+ *
+ * PARAMETERS :
+ *   @match      : matching function
+ *   @match_data : data passed to the matching function
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBoundedQueue::flushNodes(match_fn_data match, void *match_data)
+{
+    if ( NULL == match ) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < m_prioCount; i++) {
+        if (match(m_prio[i], m_userData, match_data)) {
+            __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+            releaseData(m_prio[i]);
+        } else {
+            m_prio[count++] = m_prio[i];
+        }
+    }
+    __atomic_store_n(&m_prioCount, count, __ATOMIC_RELEASE);
+
+    if (NULL != m_ring) {
+        uint32_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+
+        for (uint32_t pos = head; pos != tail; pos++) {
+            void **slot = &m_ring[pos & m_mask];
+            void *data = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+            // Hold the item while matching so the consumer can not take it
+            if (NULL == data || !__atomic_compare_exchange_n(slot, &data,
+                    Q_SLOT_BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+
+            if (match(data, m_userData, match_data)) {
+                __atomic_store_n(slot, NULL, __ATOMIC_RELEASE);
+                __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+                releaseData(data);
+            } else {
+                __atomic_store_n(slot, data, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : push
+ *
+ * DESCRIPTION: append data to the normal lane. Only called by the producer
+ *              or with m_lock held.
+ *
+ * PARAMETERS :
+ *   @data    : data to be enqueued
+ *
+ * RETURN     : true -- success; false -- lane is full
+ *==========================================================================*/
+bool QCameraBoundedQueue::push(void *data)
+{
+    // NULL marks an empty slot
+    if (NULL == m_ring || NULL == data) {
+        return false;
+    }
+
+    uint32_t tail = __atomic_load_n(&m_tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+    if (tail - head > m_mask) {
+        return false;
+    }
+
+    // Count first so the size never goes negative when a consumer or
+    // flush takes the item right after it is published
+    __atomic_add_fetch(&m_size, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&m_ring[tail & m_mask], data, __ATOMIC_RELEASE);
+    __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : popHead
+ *
+ * DESCRIPTION: take the oldest item of the normal lane. Only called by the
+ *              consumer or with m_lock held. Slots already emptied by
+ *              flushNodes or dequeue(false) are skipped.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : data ptr. NULL if the lane is empty.
+ *==========================================================================*/
+void *QCameraBoundedQueue::popHead()
+{
+    if (NULL == m_ring) {
+        return NULL;
+    }
+
+    uint32_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+    while (head != __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE)) {
+        void *data = claim(head);
+
+        // A concurrent flush() may have moved the head on already, then
+        // head is reloaded with its value instead
+        if (__atomic_compare_exchange_n(&m_head, &head, head + 1, false,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            head++;
+        }
+        if (NULL != data) {
+            __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+            return data;
+        }
+    }
+
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : popTail
+ *
+ * DESCRIPTION: take the newest item of the normal lane, or the oldest item
+ *              of the priority lane if the normal lane is empty. Called
+ *              with m_lock held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : data ptr. NULL if the queue is empty.
+ *==========================================================================*/
+void *QCameraBoundedQueue::popTail()
+{
+    if (NULL != m_ring) {
+        // head must be read before tail so head never passes it
+        uint32_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+            void *data = claim(--tail);
+            if (NULL != data) {
+                __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+                return data;
+            }
+        }
+    }
+
+    if (m_prioCount > 0) {
+        void *data = m_prio[0];
+
+        for (uint32_t i = 1; i < m_prioCount; i++) {
+            m_prio[i - 1] = m_prio[i];
+        }
+        __atomic_store_n(&m_prioCount, m_prioCount - 1, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+        return data;
+    }
+
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : popPrio
+ *
+ * DESCRIPTION: take the newest item of the priority lane. Called with
+ *              m_lock held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : data ptr. NULL if the priority lane is empty.
+ *==========================================================================*/
+void *QCameraBoundedQueue::popPrio()
+{
+    if (0 == m_prioCount) {
+        return NULL;
+    }
+
+    __atomic_store_n(&m_prioCount, m_prioCount - 1, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&m_size, 1, __ATOMIC_RELAXED);
+    return m_prio[m_prioCount];
+}
+
+/*===========================================================================
+ * FUNCTION   : claim
+ *
+ * DESCRIPTION: atomically take the item stored for a ring position. Waits
+ *              while flushNodes holds the slot.
+ *
+ * PARAMETERS :
+ *   @pos     : ring position
+ *
+ * RETURN     : data ptr. NULL if the slot was already emptied.
+ *==========================================================================*/
+void *QCameraBoundedQueue::claim(uint32_t pos)
+{
+    void **slot = &m_ring[pos & m_mask];
+    void *data = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+        if (Q_SLOT_BUSY == data) {
+            sched_yield();
+            data = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        if (NULL == data) {
+            return NULL;
+        }
+        if (__atomic_compare_exchange_n(slot, &data, NULL, false,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return data;
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseData
+ *
+ * DESCRIPTION: release a flushed item the same way QCameraQueue does
+ *
+ * PARAMETERS :
+ *   @data    : data ptr
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBoundedQueue::releaseData(void *data)
+{
+    if (NULL != data) {
+        if (m_dataFn) {
+            m_dataFn(data, m_userData);
+        }
+        free(data);
+    }
+}
+
+}; // namespace qcamera
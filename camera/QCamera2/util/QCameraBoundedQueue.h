@@ -0,0 +1,89 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_BOUNDED_QUEUE_H__
+#define __QCAMERA_BOUNDED_QUEUE_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include "QCameraQueue.h"
+
+namespace qcamera {
+
+/*
+ * Fixed capacity variant of QCameraQueue with the same interface. All
+ * nodes are preallocated so enqueue never calls malloc. Items enqueued
+ * with priority go to a separate lane which is always dequeued first.
+ *
+ * In spsc mode enqueue() must only be called from one thread and
+ * dequeue() from one other thread; these two calls are then lock free.
+ * flush(), flushNodes(), dequeue(false) and the priority lane take the
+ * lock and may be used from any thread. Without spsc all calls take the
+ * lock, as in QCameraQueue.
+ */
+class QCameraBoundedQueue {
+public:
+    QCameraBoundedQueue(uint32_t capacity, bool spsc = false);
+    QCameraBoundedQueue(uint32_t capacity, bool spsc,
+            release_data_fn data_rel_fn, void *user_data);
+    virtual ~QCameraBoundedQueue();
+    bool enqueue(void *data);
+    bool enqueueWithPriority(void *data);
+    void flush();
+    void flushNodes(match_fn match);
+    void flushNodes(match_fn_data match, void *spec_data);
+    void* dequeue(bool bFromHead = true);
+    bool isEmpty();
+    int getCurrentSize();
+private:
+    void init(uint32_t capacity, bool spsc,
+            release_data_fn data_rel_fn, void *user_data);
+    bool push(void *data);
+    void *popHead();
+    void *popTail();
+    void *popPrio();
+    void *claim(uint32_t pos);
+    void releaseData(void *data);
+
+    void **m_ring;          // normal lane, m_mask + 1 slots
+    uint32_t m_mask;
+    uint32_t m_head;        // next position to dequeue, owned by consumer
+    uint32_t m_tail;        // next position to enqueue, owned by producer
+    void **m_prio;          // priority lane, newest item on top
+    uint32_t m_prioCount;
+    int m_size;
+    bool m_spsc;
+    pthread_mutex_t m_lock;
+    release_data_fn m_dataFn;
+    void * m_userData;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_BOUNDED_QUEUE_H__ */
@@ -0,0 +1,240 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_TAG "QCameraBufIndexMap"
+
+#include <string.h>
+#include <utils/Log.h>
+#include "QCameraBufIndexMap.h"
+
+#define BUF_MAP_MASK (QCAMERA_BUF_MAP_SIZE - 1)
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraBufIndexMap
+ *
+ * DESCRIPTION: constructor of QCameraBufIndexMap
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraBufIndexMap::QCameraBufIndexMap()
+    : m_count(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    memset(m_table, 0, sizeof(m_table));
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraBufIndexMap
+ *
+ * DESCRIPTION: deconstructor of QCameraBufIndexMap
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraBufIndexMap::~QCameraBufIndexMap()
+{
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : add
+ *
+ * DESCRIPTION: map a pointer to a buffer index. A pointer that is already
+ *              mapped takes the new index.
+ *
+ * PARAMETERS :
+ *   @ptr     : pointer handed out for the buffer
+ *   @index   : buffer index
+ *
+ * RETURN     : 0 on success, -1 if ptr is NULL or the table is full
+ *==========================================================================*/
+int QCameraBufIndexMap::add(const void *ptr, int index)
+{
+    if (ptr == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    uint32_t i = hash(ptr);
+    while (m_table[i].ptr != NULL && m_table[i].ptr != ptr) {
+        i = (i + 1) & BUF_MAP_MASK;
+    }
+    if (m_table[i].ptr == NULL) {
+        // keep one slot free so every probe ends
+        if (m_count >= QCAMERA_BUF_MAP_SIZE - 1) {
+            pthread_mutex_unlock(&m_lock);
+            ALOGE("%s: table full, %p not mapped", __func__, ptr);
+            return -1;
+        }
+        m_table[i].ptr = ptr;
+        m_count++;
+    }
+    m_table[i].index = index;
+    pthread_mutex_unlock(&m_lock);
+    return 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : remove
+ *
+ * DESCRIPTION: drop the mapping of a pointer. Entries further down the
+ *              probe run are moved back so lookups stay exact.
+ *
+ * PARAMETERS :
+ *   @ptr     : pointer to forget
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBufIndexMap::remove(const void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    uint32_t i = hash(ptr);
+    while (m_table[i].ptr != NULL && m_table[i].ptr != ptr) {
+        i = (i + 1) & BUF_MAP_MASK;
+    }
+    if (m_table[i].ptr == NULL) {
+        pthread_mutex_unlock(&m_lock);
+        return;
+    }
+
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & BUF_MAP_MASK;
+        if (m_table[j].ptr == NULL) {
+            break;
+        }
+        // an entry whose home slot lies cyclically in (i, j] is still
+        // reachable, anything else has to move into the hole
+        uint32_t k = hash(m_table[j].ptr);
+        bool reachable = (i <= j) ? ((i < k) && (k <= j)) :
+                ((i < k) || (k <= j));
+        if (!reachable) {
+            m_table[i] = m_table[j];
+            i = j;
+        }
+    }
+    m_table[i].ptr = NULL;
+    m_table[i].index = 0;
+    m_count--;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : find
+ *
+ * DESCRIPTION: look up the buffer index of a pointer
+ *
+ * PARAMETERS :
+ *   @ptr     : pointer handed out for the buffer
+ *
+ * RETURN     : buffer index, -1 if the pointer is not mapped
+ *==========================================================================*/
+int QCameraBufIndexMap::find(const void *ptr) const
+{
+    int index = -1;
+
+    if (ptr == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    uint32_t i = hash(ptr);
+    while (m_table[i].ptr != NULL) {
+        if (m_table[i].ptr == ptr) {
+            index = m_table[i].index;
+            break;
+        }
+        i = (i + 1) & BUF_MAP_MASK;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return index;
+}
+
+/*===========================================================================
+ * FUNCTION   : clear
+ *
+ * DESCRIPTION: drop every mapping
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBufIndexMap::clear()
+{
+    pthread_mutex_lock(&m_lock);
+    memset(m_table, 0, sizeof(m_table));
+    m_count = 0;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : count
+ *
+ * DESCRIPTION: number of mapped pointers
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : count
+ *==========================================================================*/
+int QCameraBufIndexMap::count() const
+{
+    pthread_mutex_lock(&m_lock);
+    int n = m_count;
+    pthread_mutex_unlock(&m_lock);
+    return n;
+}
+
+/*===========================================================================
+ * FUNCTION   : hash
+ *
+ * DESCRIPTION: home slot of a pointer. Buffer pointers are page or heap
+ *              aligned, so the low bits carry nothing; a multiplicative
+ *              hash spreads the rest over the table.
+ *
+ * PARAMETERS :
+ *   @ptr     : pointer
+ *
+ * RETURN     : slot in the table
+ *==========================================================================*/
+uint32_t QCameraBufIndexMap::hash(const void *ptr)
+{
+    uint64_t v = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(v >> 32) & BUF_MAP_MASK;
+}
+
+}; // namespace qcamera
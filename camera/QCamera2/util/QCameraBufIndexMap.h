@@ -0,0 +1,78 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_BUF_INDEX_MAP_H__
+#define __QCAMERA_BUF_INDEX_MAP_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+// slots in the table, a power of two and at least twice the most buffers
+// a memory object holds, so probe runs stay short
+#define QCAMERA_BUF_MAP_SIZE 64
+
+/*
+ * Maps the pointers a memory object hands out (buffer data, video
+ * metadata) back to buffer indexes, so a buffer returned by the app or
+ * the encoder is found without scanning every buffer.
+ *
+ * Open addressing with linear probing over a fixed table; removal shifts
+ * the rest of the run back, so there are no tombstones and lookups never
+ * degrade. All calls are thread safe: buffers are added by the allocation
+ * thread while others are already being returned.
+ */
+class QCameraBufIndexMap {
+public:
+    QCameraBufIndexMap();
+    virtual ~QCameraBufIndexMap();
+
+    int add(const void *ptr, int index);
+    void remove(const void *ptr);
+    int find(const void *ptr) const;
+    void clear();
+    int count() const;
+
+private:
+    typedef struct {
+        const void *ptr;          // NULL for a free slot
+        int index;
+    } entry_t;
+
+    static uint32_t hash(const void *ptr);
+
+    mutable pthread_mutex_t m_lock;
+    entry_t m_table[QCAMERA_BUF_MAP_SIZE];
+    int m_count;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_BUF_INDEX_MAP_H__ */
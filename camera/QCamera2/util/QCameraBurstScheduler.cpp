@@ -0,0 +1,660 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#define LOG_TAG "QCameraBurstScheduler"
+
+#include <string.h>
+#include <time.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include "QCameraBurstScheduler.h"
+
+// shots in flight before anything has been measured
+#define BURST_INITIAL_WINDOW 2
+
+using namespace android;
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraBurstScheduler
+ *
+ * DESCRIPTION: constructor of QCameraBurstScheduler
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraBurstScheduler::QCameraBurstScheduler()
+    : m_active(false),
+      m_requestFn(NULL),
+      m_userData(NULL),
+      m_window(BURST_INITIAL_WINDOW),
+      m_deferred(0),
+      m_lastDone(0),
+      m_firstDone(0),
+      m_intervalAvg(0),
+      m_intervalSum(0),
+      m_shotSum(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_mutex_init(&m_issueLock, NULL);
+    memset(&m_config, 0, sizeof(m_config));
+    memset(&m_issued, 0, sizeof(m_issued));
+    memset(m_stageTs, 0, sizeof(m_stageTs));
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraBurstScheduler
+ *
+ * DESCRIPTION: deconstructor of QCameraBurstScheduler
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraBurstScheduler::~QCameraBurstScheduler()
+{
+    stop();
+    pthread_mutex_destroy(&m_issueLock);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : start
+ *
+ * DESCRIPTION: begin a burst. Measurements and statistics of the previous
+ *              burst are cleared.
+ *
+ * PARAMETERS :
+ *   @config    : memory limit and window limit of this burst
+ *   @requestFn : callback that asks the backend for more frames
+ *   @userData  : user data ptr passed to requestFn
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBurstScheduler::start(const qcamera_burst_config_t &config,
+        qcamera_burst_request_t requestFn, void *userData)
+{
+    pthread_mutex_lock(&m_issueLock);
+    pthread_mutex_lock(&m_lock);
+    m_config = config;
+    m_requestFn = requestFn;
+    m_userData = userData;
+    m_deferred = 0;
+    m_lastDone = 0;
+    m_firstDone = 0;
+    m_intervalAvg = 0;
+    m_intervalSum = 0;
+    m_shotSum = 0;
+    memset(&m_issued, 0, sizeof(m_issued));
+    memset(m_stageTs, 0, sizeof(m_stageTs));
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_window = calcWindow();
+    m_active = (requestFn != NULL);
+    pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_issueLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : stop
+ *
+ * DESCRIPTION: end the burst. Deferred shots are dropped; statistics stay
+ *              readable until the next start.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *
+ * NOTE       : waits for a request callback that is in progress, so the
+ *              backend is not touched once this returns
+ *==========================================================================*/
+void QCameraBurstScheduler::stop()
+{
+    pthread_mutex_lock(&m_issueLock);
+    pthread_mutex_lock(&m_lock);
+    m_active = false;
+    m_deferred = 0;
+    pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_issueLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : isActive
+ *
+ * DESCRIPTION: query whether a burst is running
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true between start and stop
+ *==========================================================================*/
+bool QCameraBurstScheduler::isActive()
+{
+    pthread_mutex_lock(&m_lock);
+    bool active = m_active;
+    pthread_mutex_unlock(&m_lock);
+    return active;
+}
+
+/*===========================================================================
+ * FUNCTION   : requestShot
+ *
+ * DESCRIPTION: ask for more shots. They are requested from the backend now
+ *              if the window has room, otherwise when earlier shots finish.
+ *
+ * PARAMETERS :
+ *   @count   : number of shots
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success, shots issued or deferred
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraBurstScheduler::requestShot(uint8_t count)
+{
+    int32_t rc = NO_ERROR;
+
+    pthread_mutex_lock(&m_issueLock);
+    pthread_mutex_lock(&m_lock);
+    if (!m_active) {
+        pthread_mutex_unlock(&m_lock);
+        pthread_mutex_unlock(&m_issueLock);
+        return NO_INIT;
+    }
+    m_stats.requested += count;
+    m_deferred += count;
+    expireShots(nowNs());
+    uint8_t n = takeDeferred();
+    m_stats.deferred += (m_deferred < count) ? m_deferred : count;
+    pthread_mutex_unlock(&m_lock);
+
+    if (n > 0) {
+        rc = issue(n, false);
+    }
+    pthread_mutex_unlock(&m_issueLock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : shotDone
+ *
+ * DESCRIPTION: retire the oldest shot in flight and issue deferred shots
+ *              the window now has room for. A shot that completes after
+ *              it timed out retires the oldest one still in flight.
+ *
+ * PARAMETERS :
+ *   @success : false if the shot was lost, it is then left out of the
+ *              latency and rate figures
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBurstScheduler::shotDone(bool success)
+{
+    int64_t now = nowNs();
+    int64_t issued = 0;
+
+    pthread_mutex_lock(&m_issueLock);
+    pthread_mutex_lock(&m_lock);
+    if (!m_active) {
+        pthread_mutex_unlock(&m_lock);
+        pthread_mutex_unlock(&m_issueLock);
+        return;
+    }
+
+    if (m_stats.in_flight > 0) {
+        m_stats.in_flight--;
+    }
+    bool matched = pop(m_issued, issued);
+    if (success) {
+        m_stats.completed++;
+        if (matched) {
+            int64_t lat = now - issued;
+            m_shotSum += lat;
+            if (m_stats.min_shot_ns == 0 || lat < m_stats.min_shot_ns) {
+                m_stats.min_shot_ns = lat;
+            }
+            if (lat > m_stats.max_shot_ns) {
+                m_stats.max_shot_ns = lat;
+            }
+        }
+        if (m_lastDone != 0) {
+            int64_t interval = now - m_lastDone;
+            m_intervalSum += interval;
+            m_intervalAvg = average(m_intervalAvg, interval);
+            if (interval > m_stats.max_interval_ns) {
+                m_stats.max_interval_ns = interval;
+            }
+        } else {
+            m_firstDone = now;
+        }
+        m_lastDone = now;
+    } else {
+        m_stats.failed++;
+    }
+    expireShots(now);
+
+    m_window = calcWindow();
+    uint8_t n = takeDeferred();
+    pthread_mutex_unlock(&m_lock);
+
+    if (n > 0) {
+        issue(n, true);
+    }
+    pthread_mutex_unlock(&m_issueLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : checkTimeouts
+ *
+ * DESCRIPTION: retire the shots in flight for longer than the timeout and
+ *              issue deferred shots in their place
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBurstScheduler::checkTimeouts()
+{
+    uint8_t n = 0;
+
+    pthread_mutex_lock(&m_issueLock);
+    pthread_mutex_lock(&m_lock);
+    if (m_active && expireShots(nowNs()) > 0) {
+        n = takeDeferred();
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (n > 0) {
+        issue(n, true);
+    }
+    pthread_mutex_unlock(&m_issueLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : enter
+ *
+ * DESCRIPTION: a frame was queued to a stage
+ *
+ * PARAMETERS :
+ *   @stage   : stage the frame entered
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBurstScheduler::enter(qcamera_burst_stage_t stage)
+{
+    if (stage >= QCAMERA_BURST_STAGE_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (m_active) {
+        qcamera_burst_stage_stats_t &st = m_stats.stage[stage];
+        push(m_stageTs[stage], nowNs());
+        st.depth++;
+        if (st.depth > st.peak_depth) {
+            st.peak_depth = st.depth;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : leave
+ *
+ * DESCRIPTION: the oldest frame in a stage left it
+ *
+ * PARAMETERS :
+ *   @stage   : stage the frame left
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBurstScheduler::leave(qcamera_burst_stage_t stage)
+{
+    int64_t entered = 0;
+
+    if (stage >= QCAMERA_BURST_STAGE_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (m_active) {
+        qcamera_burst_stage_stats_t &st = m_stats.stage[stage];
+        if (st.depth > 0) {
+            st.depth--;
+        }
+        st.count++;
+        if (pop(m_stageTs[stage], entered)) {
+            int64_t lat = nowNs() - entered;
+            st.avg_latency_ns = average(st.avg_latency_ns, lat);
+            if (lat > st.max_latency_ns) {
+                st.max_latency_ns = lat;
+            }
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : admitReprocess
+ *
+ * DESCRIPTION: decide whether the next frame should be sent to reprocess
+ *              now. The encoder backlog is kept at the number of encodes
+ *              that finish while one reprocess runs, plus one, so the
+ *              encoder does not starve and frames that are only waiting
+ *              for it stay unprocessed instead of holding reprocess output
+ *              buffers.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true to reprocess the next frame now
+ *==========================================================================*/
+bool QCameraBurstScheduler::admitReprocess()
+{
+    bool admit = true;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_active) {
+        const qcamera_burst_stage_stats_t *st = m_stats.stage;
+        int64_t reproc = st[QCAMERA_BURST_STAGE_REPROCESS].avg_latency_ns;
+        int64_t encode = st[QCAMERA_BURST_STAGE_ENCODE].avg_latency_ns;
+        if (reproc > 0 && encode > 0) {
+            int64_t target = (reproc + encode - 1) / encode + 1;
+            int64_t backlog = st[QCAMERA_BURST_STAGE_JPEG_INPUT].depth +
+                    st[QCAMERA_BURST_STAGE_ENCODE].depth;
+            admit = backlog < target;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+    return admit;
+}
+
+/*===========================================================================
+ * FUNCTION   : window
+ *
+ * DESCRIPTION: current limit on shots in flight
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of shots
+ *==========================================================================*/
+uint32_t QCameraBurstScheduler::window()
+{
+    pthread_mutex_lock(&m_lock);
+    uint32_t w = m_window;
+    pthread_mutex_unlock(&m_lock);
+    return w;
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: statistics of the running or the last burst
+ *
+ * PARAMETERS :
+ *   @stats   : filled with a snapshot of the counters
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBurstScheduler::getStats(qcamera_burst_stats_t &stats)
+{
+    pthread_mutex_lock(&m_lock);
+    stats = m_stats;
+    stats.window = m_window;
+    if (stats.completed > 0) {
+        stats.avg_shot_ns = m_shotSum / stats.completed;
+    }
+    if (stats.completed > 1) {
+        stats.avg_interval_ns = m_intervalSum / (stats.completed - 1);
+        if (m_lastDone > m_firstDone) {
+            stats.shots_per_sec = (double)(stats.completed - 1) * 1e9 /
+                    (double)(m_lastDone - m_firstDone);
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : calcWindow
+ *
+ * DESCRIPTION: size the window from the shortest shot latency and the
+ *              current shot interval, within the memory and window limits.
+ *              Called with m_lock held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of shots allowed in flight
+ *==========================================================================*/
+uint32_t QCameraBurstScheduler::calcWindow()
+{
+    int64_t w = BURST_INITIAL_WINDOW;
+    int64_t max = QCAMERA_BURST_MAX_IN_FLIGHT;
+
+    if (m_stats.min_shot_ns > 0 && m_intervalAvg > 0) {
+        w = (m_stats.min_shot_ns + m_intervalAvg - 1) / m_intervalAvg + 1;
+    }
+    if (m_config.max_window > 0 && (int64_t)m_config.max_window < max) {
+        max = m_config.max_window;
+    }
+    if (m_config.mem_limit > 0 && m_config.shot_bytes > 0) {
+        int64_t fit = (int64_t)(m_config.mem_limit / m_config.shot_bytes);
+        if (fit < max) {
+            max = fit;
+        }
+    }
+    if (w > max) {
+        w = max;
+    }
+    return (w < 1) ? 1 : (uint32_t)w;
+}
+
+/*===========================================================================
+ * FUNCTION   : takeDeferred
+ *
+ * DESCRIPTION: move as many deferred shots in flight as the window allows.
+ *              Called with m_lock held; the caller issues them.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of shots to issue
+ *==========================================================================*/
+uint8_t QCameraBurstScheduler::takeDeferred()
+{
+    uint32_t n = 0;
+
+    if (m_stats.in_flight < m_window) {
+        n = m_window - m_stats.in_flight;
+    }
+    if (n > m_deferred) {
+        n = m_deferred;
+    }
+    if (n > UINT8_MAX) {
+        n = UINT8_MAX;
+    }
+    if (n > 0) {
+        int64_t now = nowNs();
+        m_deferred -= n;
+        m_stats.in_flight += n;
+        m_stats.issued += n;
+        if (m_stats.in_flight > m_stats.peak_in_flight) {
+            m_stats.peak_in_flight = m_stats.in_flight;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            push(m_issued, now);
+        }
+    }
+    return (uint8_t)n;
+}
+
+/*===========================================================================
+ * FUNCTION   : expireShots
+ *
+ * DESCRIPTION: retire the shots that are in flight for longer than the
+ *              timeout as failed. Called with m_lock held.
+ *
+ * PARAMETERS :
+ *   @now     : current time in ns
+ *
+ * RETURN     : number of shots retired
+ *==========================================================================*/
+uint32_t QCameraBurstScheduler::expireShots(int64_t now)
+{
+    int64_t issued = 0;
+    uint32_t expired = 0;
+
+    if (m_config.shot_timeout_ns <= 0) {
+        return 0;
+    }
+    while (m_issued.count > 0 &&
+            now - m_issued.ts[m_issued.head] > m_config.shot_timeout_ns) {
+        pop(m_issued, issued);
+        if (m_stats.in_flight > 0) {
+            m_stats.in_flight--;
+        }
+        m_stats.failed++;
+        m_stats.expired++;
+        expired++;
+        ALOGE("%s: shot in flight for %lld ms, retired", __func__,
+                (long long)((now - issued) / 1000000));
+    }
+    return expired;
+}
+
+/*===========================================================================
+ * FUNCTION   : issue
+ *
+ * DESCRIPTION: request shots from the backend. Called with m_issueLock
+ *              held and m_lock released. Shots the backend refuses are
+ *              taken out of flight again.
+ *
+ * PARAMETERS :
+ *   @count   : number of shots
+ *   @keep    : put refused shots back with the deferred ones instead of
+ *              dropping them
+ *
+ * RETURN     : int32_t type of status from the request callback
+ *==========================================================================*/
+int32_t QCameraBurstScheduler::issue(uint8_t count, bool keep)
+{
+    int32_t rc = m_requestFn(count, m_userData);
+
+    if (rc != NO_ERROR) {
+        ALOGE("%s: request for %d shots failed %d", __func__, count, rc);
+        pthread_mutex_lock(&m_lock);
+        m_stats.in_flight -= (count < m_stats.in_flight) ?
+                count : m_stats.in_flight;
+        m_stats.issued -= count;
+        m_issued.count -= (count < m_issued.count) ? count : m_issued.count;
+        if (keep) {
+            m_deferred += count;
+        }
+        pthread_mutex_unlock(&m_lock);
+    }
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : push
+ *
+ * DESCRIPTION: append a timestamp. A full fifo drops it, the matching
+ *              leave then goes without a latency sample.
+ *
+ * PARAMETERS :
+ *   @fifo    : timestamp fifo
+ *   @ts      : timestamp in ns
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraBurstScheduler::push(ts_fifo_t &fifo, int64_t ts)
+{
+    if (fifo.count < QCAMERA_BURST_MAX_IN_FLIGHT) {
+        fifo.ts[(fifo.head + fifo.count) % QCAMERA_BURST_MAX_IN_FLIGHT] = ts;
+        fifo.count++;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : pop
+ *
+ * DESCRIPTION: take the oldest timestamp
+ *
+ * PARAMETERS :
+ *   @fifo    : timestamp fifo
+ *   @ts      : oldest timestamp in ns
+ *
+ * RETURN     : false if the fifo was empty
+ *==========================================================================*/
+bool QCameraBurstScheduler::pop(ts_fifo_t &fifo, int64_t &ts)
+{
+    if (fifo.count == 0) {
+        return false;
+    }
+    ts = fifo.ts[fifo.head];
+    fifo.head = (fifo.head + 1) % QCAMERA_BURST_MAX_IN_FLIGHT;
+    fifo.count--;
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : average
+ *
+ * DESCRIPTION: exponential moving average with a weight of 1/8
+ *
+ * PARAMETERS :
+ *   @avg     : current average, 0 if there is none yet
+ *   @sample  : new sample
+ *
+ * RETURN     : updated average
+ *==========================================================================*/
+int64_t QCameraBurstScheduler::average(int64_t avg, int64_t sample)
+{
+    if (avg == 0) {
+        return sample;
+    }
+    return avg + (sample - avg) / 8;
+}
+
+/*===========================================================================
+ * FUNCTION   : nowNs
+ *
+ * DESCRIPTION: monotonic time
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : time in ns
+ *==========================================================================*/
+int64_t QCameraBurstScheduler::nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,173 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __QCAMERA_BURST_SCHEDULER_H__
+#define __QCAMERA_BURST_SCHEDULER_H__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+#define QCAMERA_BURST_MAX_IN_FLIGHT 32
+
+// postprocessing stages a longshot frame passes through, in order
+typedef enum {
+    QCAMERA_BURST_STAGE_PP_INPUT,     // waiting for the reprocess channel
+    QCAMERA_BURST_STAGE_REPROCESS,    // in the reprocess channel
+    QCAMERA_BURST_STAGE_JPEG_INPUT,   // waiting for the encoder
+    QCAMERA_BURST_STAGE_ENCODE,       // being encoded
+    QCAMERA_BURST_STAGE_SAVE,         // waiting for the save thread
+    QCAMERA_BURST_STAGE_MAX
+} qcamera_burst_stage_t;
+
+// asks the backend for count more frames, returns 0 on success
+typedef int32_t (*qcamera_burst_request_t)(uint8_t count, void *user_data);
+
+typedef struct {
+    size_t shot_bytes;          // buffer memory one shot holds while in flight
+    size_t mem_limit;           // bytes in flight, 0 for no limit
+    uint32_t max_window;        // shots in flight, 0 for the built in maximum
+    int64_t shot_timeout_ns;    // shots in flight longer are retired, 0 for none
+} qcamera_burst_config_t;
+
+typedef struct {
+    uint32_t depth;             // entries in the stage now
+    uint32_t peak_depth;
+    uint32_t count;             // entries that left the stage
+    int64_t avg_latency_ns;     // time spent in the stage, moving average
+    int64_t max_latency_ns;
+} qcamera_burst_stage_stats_t;
+
+typedef struct {
+    uint32_t requested;         // shots the app asked for
+    uint32_t issued;            // shots requested from the backend
+    uint32_t completed;         // shots that came out of the encoder
+    uint32_t failed;            // shots lost on the way
+    uint32_t expired;           // failed shots retired by the timeout
+    uint32_t deferred;          // shots that had to wait for room
+    uint32_t in_flight;
+    uint32_t peak_in_flight;
+    uint32_t window;            // current limit on shots in flight
+    int64_t avg_shot_ns;        // issue to encoded, mean
+    int64_t min_shot_ns;
+    int64_t max_shot_ns;
+    int64_t avg_interval_ns;    // shot to shot, mean
+    int64_t max_interval_ns;
+    double shots_per_sec;       // first to last completed shot
+    qcamera_burst_stage_stats_t stage[QCAMERA_BURST_STAGE_MAX];
+} qcamera_burst_stats_t;
+
+/*
+ * Flow control for longshot. Every shot the app asks for goes through
+ * requestShot(); it is passed on to the backend right away while fewer
+ * than window() shots are in flight and deferred otherwise. shotDone()
+ * retires a shot and issues deferred ones as room frees up, so requests
+ * are delayed, never dropped, until stop(). Shots the backend refuses
+ * while shotDone() issues them stay deferred. A shot that is in flight
+ * longer than the configured timeout is taken as lost and retired as a
+ * failure by the next requestShot(), shotDone() or checkTimeouts(), so a
+ * frame dropped without a shotDone() does not hold its slot for the rest
+ * of the burst. checkTimeouts() is meant to be called periodically, e.g.
+ * per preview frame, for when every shot in flight was lost.
+ *
+ * The window is sized from measurements: the shortest issue to encoded
+ * time seen so far divided by the current shot to shot interval, plus
+ * one. While the window is what limits the burst every completion grows
+ * it by one; once a stage saturates the interval stops shrinking and the
+ * window settles at what that stage needs to stay busy. It never exceeds
+ * the memory limit divided by the per shot size.
+ *
+ * enter() and leave() bracket the time a frame spends in each stage. All
+ * stages are first in first out, so each leave() is matched with the
+ * oldest enter(). admitReprocess() uses the reprocess and encode latencies
+ * to keep the encoder fed without letting reprocessed frames pile up in
+ * front of it.
+ *
+ * All calls are thread safe. The request callback runs on the thread that
+ * called requestShot(), shotDone() or checkTimeouts() and never after stop() returns.
+ */
+class QCameraBurstScheduler {
+public:
+    QCameraBurstScheduler();
+    virtual ~QCameraBurstScheduler();
+
+    void start(const qcamera_burst_config_t &config,
+            qcamera_burst_request_t requestFn, void *userData);
+    void stop();
+    bool isActive();
+    int32_t requestShot(uint8_t count);
+    void shotDone(bool success);
+    void checkTimeouts();
+    void enter(qcamera_burst_stage_t stage);
+    void leave(qcamera_burst_stage_t stage);
+    bool admitReprocess();
+    uint32_t window();
+    void getStats(qcamera_burst_stats_t &stats);
+
+private:
+    typedef struct {
+        int64_t ts[QCAMERA_BURST_MAX_IN_FLIGHT]; // enter times, oldest first
+        uint32_t head;
+        uint32_t count;
+    } ts_fifo_t;
+
+    static void push(ts_fifo_t &fifo, int64_t ts);
+    static bool pop(ts_fifo_t &fifo, int64_t &ts);
+    static int64_t average(int64_t avg, int64_t sample);
+    static int64_t nowNs();
+    uint32_t calcWindow();
+    uint8_t takeDeferred();
+    uint32_t expireShots(int64_t now);
+    int32_t issue(uint8_t count, bool keep);
+
+    pthread_mutex_t m_lock;
+    pthread_mutex_t m_issueLock;  // held across the request callback
+    bool m_active;
+    qcamera_burst_config_t m_config;
+    qcamera_burst_request_t m_requestFn;
+    void *m_userData;
+
+    uint32_t m_window;
+    uint32_t m_deferred;          // shots waiting for room
+    int64_t m_lastDone;
+    int64_t m_firstDone;
+    int64_t m_intervalAvg;        // moving average used for the window
+    int64_t m_intervalSum;
+    int64_t m_shotSum;            // issue to encoded, completed shots
+    ts_fifo_t m_issued;
+    ts_fifo_t m_stageTs[QCAMERA_BURST_STAGE_MAX];
+    qcamera_burst_stats_t m_stats;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_BURST_SCHEDULER_H__ */
@@ -0,0 +1,90 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __QCAMERA_DUMP_FORMAT_H__
+#define __QCAMERA_DUMP_FORMAT_H__
+
+#include <stdint.h>
+
+/*
+ * On disk layout of the frame dump container written by QCameraDumpWriter.
+ *
+ *   qcamera_dump_file_hdr_t
+ *   { qcamera_dump_rec_hdr_t, payload, zero pad to QCAMERA_DUMP_ALIGN } * n
+ *   qcamera_dump_index_entry_t * n
+ *   qcamera_dump_trailer_t
+ *
+ * The index and trailer are only written when the writer is stopped. A file
+ * without them, e.g. after a crash, can still be read record by record up
+ * to the first incomplete one. All fields are in host byte order.
+ */
+
+#define QCAMERA_DUMP_FILE_MAGIC   0x50444351 /* "QCDP" */
+#define QCAMERA_DUMP_REC_MAGIC    0x52444351 /* "QCDR" */
+#define QCAMERA_DUMP_INDEX_MAGIC  0x49444351 /* "QCDI" */
+#define QCAMERA_DUMP_VERSION      1
+#define QCAMERA_DUMP_NAME_MAX     64
+#define QCAMERA_DUMP_ALIGN        8
+
+#define QCAMERA_DUMP_ALIGN_SIZE(x) \
+    (((x) + (QCAMERA_DUMP_ALIGN - 1)) & ~((uint64_t)QCAMERA_DUMP_ALIGN - 1))
+
+typedef struct {
+    uint32_t magic;         /* QCAMERA_DUMP_FILE_MAGIC */
+    uint32_t version;       /* QCAMERA_DUMP_VERSION */
+    uint32_t camera_id;
+    uint32_t reserved;
+    int64_t start_time;     /* seconds since the epoch */
+} qcamera_dump_file_hdr_t;
+
+typedef struct {
+    uint32_t magic;         /* QCAMERA_DUMP_REC_MAGIC */
+    uint32_t type;          /* QCAMERA_DUMP_FRM_* of the record */
+    uint32_t frame_idx;
+    uint32_t seq;           /* order the records were accepted in */
+    uint64_t size;          /* payload bytes, without header and pad */
+    int64_t timestamp;      /* CLOCK_MONOTONIC ns when accepted */
+    char name[QCAMERA_DUMP_NAME_MAX]; /* file name of the record */
+} qcamera_dump_rec_hdr_t;
+
+typedef struct {
+    uint64_t offset;        /* file offset of the record header */
+    uint64_t size;          /* payload bytes */
+    uint32_t type;
+    uint32_t frame_idx;
+} qcamera_dump_index_entry_t;
+
+typedef struct {
+    uint32_t magic;         /* QCAMERA_DUMP_INDEX_MAGIC */
+    uint32_t count;         /* number of index entries */
+    uint64_t index_offset;  /* file offset of the first index entry */
+} qcamera_dump_trailer_t;
+
+#endif /* __QCAMERA_DUMP_FORMAT_H__ */
@@ -0,0 +1,643 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#define LOG_TAG "QCameraDumpWriter"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include "QCameraDumpWriter.h"
+#include "QCameraPlaneOps.h"
+
+#define DUMP_INDEX_INIT_ENTRIES 256
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraDumpWriter
+ *
+ * DESCRIPTION: constructor of QCameraDumpWriter
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraDumpWriter::QCameraDumpWriter()
+    : m_thread(0),
+      m_running(false),
+      m_exit(false),
+      m_fd(-1),
+      m_ring(NULL),
+      m_head(0),
+      m_tail(0),
+      m_end(0),
+      m_wrapped(false),
+      m_used(0),
+      m_seq(0),
+      m_accepted(0),
+      m_tokens(0),
+      m_lastRefill(0),
+      m_fileOffset(0),
+      m_index(NULL),
+      m_indexCnt(0),
+      m_indexMax(0),
+      m_indexLost(false)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_cond, NULL);
+    memset(&m_config, 0, sizeof(m_config));
+    memset(m_lastType, 0, sizeof(m_lastType));
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraDumpWriter
+ *
+ * DESCRIPTION: deconstructor of QCameraDumpWriter, flushes and closes the
+ *              file if still running
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraDumpWriter::~QCameraDumpWriter()
+{
+    stop();
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : start
+ *
+ * DESCRIPTION: create the container file, allocate the ring and launch the
+ *              writer thread. Does nothing if already running.
+ *
+ * PARAMETERS :
+ *   @path     : container file to create
+ *   @cameraId : camera id recorded in the file header
+ *   @config   : ring size and limits
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraDumpWriter::start(const char *path, uint32_t cameraId,
+        const qcamera_dump_config_t &config)
+{
+    int32_t rc = NO_ERROR;
+
+    if (path == NULL ||
+            config.ring_size < sizeof(qcamera_dump_rec_hdr_t) * 2) {
+        return BAD_VALUE;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (m_running) {
+        pthread_mutex_unlock(&m_lock);
+        return NO_ERROR;
+    }
+
+    m_config = config;
+    m_config.ring_size &= ~((size_t)QCAMERA_DUMP_ALIGN - 1);
+    m_ring = (uint8_t *)malloc(m_config.ring_size);
+    if (m_ring == NULL) {
+        ALOGE("%s: No memory for %zu byte dump ring", __func__, m_config.ring_size);
+        pthread_mutex_unlock(&m_lock);
+        return NO_MEMORY;
+    }
+
+    m_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (m_fd < 0) {
+        ALOGE("%s: cannot create %s: %s", __func__, path, strerror(errno));
+        rc = UNKNOWN_ERROR;
+    } else {
+        qcamera_dump_file_hdr_t hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = QCAMERA_DUMP_FILE_MAGIC;
+        hdr.version = QCAMERA_DUMP_VERSION;
+        hdr.camera_id = cameraId;
+        hdr.start_time = (int64_t)time(NULL);
+        m_fileOffset = 0;
+        rc = writeSpan((const uint8_t *)&hdr, sizeof(hdr));
+    }
+
+    if (rc == NO_ERROR) {
+        m_head = m_tail = m_end = m_used = 0;
+        m_wrapped = false;
+        m_exit = false;
+        m_seq = 0;
+        m_accepted = 0;
+        m_tokens = (int64_t)m_config.rate_kbps * 1024;
+        m_lastRefill = nowNs();
+        memset(m_lastType, 0, sizeof(m_lastType));
+        memset(&m_stats, 0, sizeof(m_stats));
+        m_indexCnt = 0;
+        m_indexLost = false;
+        if (pthread_create(&m_thread, NULL, writerRoutine, this) != 0) {
+            ALOGE("%s: cannot launch writer thread", __func__);
+            rc = UNKNOWN_ERROR;
+        }
+    }
+
+    if (rc != NO_ERROR) {
+        if (m_fd >= 0) {
+            close(m_fd);
+            unlink(path);
+            m_fd = -1;
+        }
+        free(m_ring);
+        m_ring = NULL;
+    } else {
+        m_running = true;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : stop
+ *
+ * DESCRIPTION: stop accepting records, write out everything still in the
+ *              ring followed by the index, and close the file
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraDumpWriter::stop()
+{
+    pthread_mutex_lock(&m_lock);
+    if (!m_running || m_exit) {
+        pthread_mutex_unlock(&m_lock);
+        return;
+    }
+    m_exit = true;
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+
+    pthread_join(m_thread, NULL);
+
+    pthread_mutex_lock(&m_lock);
+    free(m_ring);
+    m_ring = NULL;
+    free(m_index);
+    m_index = NULL;
+    m_indexCnt = m_indexMax = 0;
+    m_running = false;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : isRunning
+ *
+ * DESCRIPTION: query whether records are being accepted
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true if started and not stopped
+ *==========================================================================*/
+bool QCameraDumpWriter::isRunning()
+{
+    pthread_mutex_lock(&m_lock);
+    bool running = m_running && !m_exit;
+    pthread_mutex_unlock(&m_lock);
+    return running;
+}
+
+/*===========================================================================
+ * FUNCTION   : dump
+ *
+ * DESCRIPTION: copy one record into the ring for the writer thread. The
+ *              segments are packed back to back, without their padding.
+ *
+ * PARAMETERS :
+ *   @type     : record type
+ *   @frameIdx : frame index of the record
+ *   @name     : file name the extractor gives the record
+ *   @segs     : pieces of the payload
+ *   @count    : number of segments
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR     -- record queued
+ *              WOULD_BLOCK  -- record dropped by a limit or a full ring
+ *              NO_INIT      -- writer not running
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraDumpWriter::dump(uint32_t type, uint32_t frameIdx,
+        const char *name, const qcamera_dump_seg_t *segs, uint32_t count)
+{
+    qcamera_dump_rec_hdr_t *hdr = NULL;
+    size_t payload = 0;
+    uint8_t *dst;
+
+    if (segs == NULL && count > 0) {
+        return BAD_VALUE;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        payload += segs[i].width * segs[i].height;
+    }
+    size_t len = sizeof(qcamera_dump_rec_hdr_t) + (size_t)QCAMERA_DUMP_ALIGN_SIZE(payload);
+    int64_t now = nowNs();
+
+    pthread_mutex_lock(&m_lock);
+    if (!m_running || m_exit) {
+        pthread_mutex_unlock(&m_lock);
+        return NO_INIT;
+    }
+    if (!admit(type, len, now)) {
+        pthread_mutex_unlock(&m_lock);
+        return WOULD_BLOCK;
+    }
+    hdr = (qcamera_dump_rec_hdr_t *)reserve(len);
+    if (hdr == NULL) {
+        m_stats.dropped_full++;
+        pthread_mutex_unlock(&m_lock);
+        return WOULD_BLOCK;
+    }
+    // take the limits only for records that are actually queued
+    uint32_t slot = type ? (uint32_t)__builtin_ctz(type) % QCAMERA_DUMP_MAX_TYPES : 0;
+    m_lastType[slot] = now;
+    m_tokens -= (int64_t)len;
+    m_accepted += len;
+    memset(hdr, 0, sizeof(*hdr));   // magic stays 0 until the copy is done
+    hdr->type = type;
+    hdr->frame_idx = frameIdx;
+    hdr->seq = m_seq++;
+    m_stats.queued++;
+    if (m_used > m_stats.peak_ring_used) {
+        m_stats.peak_ring_used = m_used;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    hdr->size = payload;
+    hdr->timestamp = now;
+    if (name != NULL) {
+        strncpy(hdr->name, name, sizeof(hdr->name) - 1);
+    }
+    dst = (uint8_t *)(hdr + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        if (segs[i].height <= 1 || segs[i].stride == segs[i].width) {
+            memcpy(dst, segs[i].data, segs[i].width * segs[i].height);
+        } else {
+            QCameraPlaneOps::copyPlane(dst, (int32_t)segs[i].width,
+                    (const uint8_t *)segs[i].data, (int32_t)segs[i].stride,
+                    (int32_t)segs[i].width, (int32_t)segs[i].height);
+        }
+        dst += segs[i].width * segs[i].height;
+    }
+    memset(dst, 0, len - sizeof(*hdr) - payload);
+
+    pthread_mutex_lock(&m_lock);
+    hdr->magic = QCAMERA_DUMP_REC_MAGIC;
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: get the record and write counters
+ *
+ * PARAMETERS :
+ *   @stats    : filled with the counters since start
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraDumpWriter::getStats(qcamera_dump_stats_t &stats)
+{
+    pthread_mutex_lock(&m_lock);
+    stats = m_stats;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : admit
+ *
+ * DESCRIPTION: apply sampling, size and rate limits to a record. Caller
+ *              holds m_lock.
+ *
+ * PARAMETERS :
+ *   @type     : record type
+ *   @len      : bytes the record takes in the file
+ *   @now      : current CLOCK_MONOTONIC time in ns
+ *
+ * RETURN     : true if the record may be queued
+ *==========================================================================*/
+bool QCameraDumpWriter::admit(uint32_t type, size_t len, int64_t now)
+{
+    uint32_t slot = type ? (uint32_t)__builtin_ctz(type) % QCAMERA_DUMP_MAX_TYPES : 0;
+
+    if (m_config.min_interval_ms > 0 && m_lastType[slot] != 0 &&
+            now - m_lastType[slot] < (int64_t)m_config.min_interval_ms * 1000000) {
+        m_stats.dropped_sample++;
+        return false;
+    }
+
+    if (m_config.max_file_size > 0 && sizeof(qcamera_dump_file_hdr_t) +
+            m_accepted + len > m_config.max_file_size) {
+        m_stats.dropped_limit++;
+        return false;
+    }
+
+    if (m_config.rate_kbps > 0) {
+        // token bucket holding at most one second worth of bytes. A record
+        // bigger than that needs a full bucket and leaves it in debt.
+        int64_t rate = (int64_t)m_config.rate_kbps * 1024;
+        m_tokens += rate * (now - m_lastRefill) / 1000000000LL;
+        if (m_tokens > rate) {
+            m_tokens = rate;
+        }
+        m_lastRefill = now;
+        if (m_tokens < (((int64_t)len < rate) ? (int64_t)len : rate)) {
+            m_stats.dropped_rate++;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : reserve
+ *
+ * DESCRIPTION: take len contiguous bytes at the tail of the ring. Caller
+ *              holds m_lock.
+ *
+ * PARAMETERS :
+ *   @len      : bytes to reserve, multiple of QCAMERA_DUMP_ALIGN
+ *
+ * RETURN     : ptr to the reserved bytes, NULL if the ring is too full
+ *==========================================================================*/
+uint8_t *QCameraDumpWriter::reserve(size_t len)
+{
+    size_t pos;
+
+    if (!m_wrapped) {
+        if (m_config.ring_size - m_tail >= len) {
+            pos = m_tail;
+        } else if (m_head >= len) {
+            // no room before the end, continue at the start of the ring
+            m_end = m_tail;
+            m_wrapped = true;
+            pos = 0;
+        } else {
+            return NULL;
+        }
+    } else if (m_head - m_tail >= len) {
+        pos = m_tail;
+    } else {
+        return NULL;
+    }
+    m_tail = pos + len;
+    m_used += len;
+    return m_ring + pos;
+}
+
+/*===========================================================================
+ * FUNCTION   : writerRoutine
+ *
+ * DESCRIPTION: entry of the writer thread
+ *
+ * PARAMETERS :
+ *   @data     : ptr to QCameraDumpWriter
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraDumpWriter::writerRoutine(void *data)
+{
+    QCameraDumpWriter *pme = (QCameraDumpWriter *)data;
+
+    prctl(PR_SET_NAME, (unsigned long)"CAM_dumpWriter", 0, 0, 0);
+    pme->writerLoop();
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : writerLoop
+ *
+ * DESCRIPTION: write the ready records at the head of the ring until
+ *              stopped and drained, then write the index
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraDumpWriter::writerLoop()
+{
+    pthread_mutex_lock(&m_lock);
+    while (true) {
+        size_t start = m_head;
+        size_t limit = m_wrapped ? m_end : m_tail;
+        size_t pos = start;
+        uint32_t records = 0;
+
+        // records are committed out of order by concurrent producers, so
+        // stop at the first one still being copied
+        while (pos < limit) {
+            qcamera_dump_rec_hdr_t *hdr = (qcamera_dump_rec_hdr_t *)(m_ring + pos);
+            if (hdr->magic != QCAMERA_DUMP_REC_MAGIC) {
+                break;
+            }
+            pos += sizeof(*hdr) + (size_t)QCAMERA_DUMP_ALIGN_SIZE(hdr->size);
+            records++;
+        }
+
+        if (records == 0) {
+            if (m_wrapped && start == m_end) {
+                m_head = 0;
+                m_wrapped = false;
+                continue;
+            }
+            if (m_exit && m_used == 0) {
+                break;
+            }
+            pthread_cond_wait(&m_cond, &m_lock);
+            continue;
+        }
+        pthread_mutex_unlock(&m_lock);
+
+        // records between start and pos are not touched by producers
+        // until m_head moves past them
+        uint64_t offset = m_fileOffset;
+        for (size_t p = start; p < pos; ) {
+            qcamera_dump_rec_hdr_t *hdr = (qcamera_dump_rec_hdr_t *)(m_ring + p);
+            if (!m_indexLost && !addIndex(offset + (p - start), hdr)) {
+                m_indexLost = true;
+            }
+            p += sizeof(*hdr) + (size_t)QCAMERA_DUMP_ALIGN_SIZE(hdr->size);
+        }
+        int32_t rc = writeSpan(m_ring + start, pos - start);
+
+        pthread_mutex_lock(&m_lock);
+        if (rc == NO_ERROR) {
+            m_stats.written += records;
+            m_stats.bytes_written += pos - start;
+            m_stats.write_calls++;
+        }
+        m_head = pos;
+        m_used -= pos - start;
+        if (!m_wrapped && m_head == m_tail) {
+            // empty, start over so records rarely have to wrap
+            m_head = m_tail = 0;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    writeIndex();
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : writeSpan
+ *
+ * DESCRIPTION: append bytes to the container file. After a failed write
+ *              the file is closed and later spans are discarded.
+ *
+ * PARAMETERS :
+ *   @data     : bytes to write
+ *   @len      : number of bytes
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraDumpWriter::writeSpan(const uint8_t *data, size_t len)
+{
+    if (m_fd < 0) {
+        return NO_INIT;
+    }
+    while (len > 0) {
+        ssize_t written = write(m_fd, data, len);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            ALOGE("%s: write failed: %s, dumping stopped", __func__, strerror(errno));
+            close(m_fd);
+            m_fd = -1;
+            return UNKNOWN_ERROR;
+        }
+        data += written;
+        len -= (size_t)written;
+        m_fileOffset += (uint64_t)written;
+    }
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : addIndex
+ *
+ * DESCRIPTION: remember a record for the index. Writer thread only.
+ *
+ * PARAMETERS :
+ *   @offset   : file offset of the record header
+ *   @hdr      : record header
+ *
+ * RETURN     : true if added, false if out of memory
+ *==========================================================================*/
+bool QCameraDumpWriter::addIndex(uint64_t offset, const qcamera_dump_rec_hdr_t *hdr)
+{
+    if (m_indexCnt == m_indexMax) {
+        uint32_t max = m_indexMax ? m_indexMax * 2 : DUMP_INDEX_INIT_ENTRIES;
+        qcamera_dump_index_entry_t *index = (qcamera_dump_index_entry_t *)
+                realloc(m_index, sizeof(qcamera_dump_index_entry_t) * max);
+        if (index == NULL) {
+            ALOGE("%s: No memory for %u index entries", __func__, max);
+            return false;
+        }
+        m_index = index;
+        m_indexMax = max;
+    }
+    qcamera_dump_index_entry_t *entry = &m_index[m_indexCnt++];
+    entry->offset = offset;
+    entry->size = hdr->size;
+    entry->type = hdr->type;
+    entry->frame_idx = hdr->frame_idx;
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : writeIndex
+ *
+ * DESCRIPTION: append the index and the trailer pointing to it. Writer
+ *              thread only. Without a complete index nothing is appended
+ *              and readers fall back to walking the records.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraDumpWriter::writeIndex()
+{
+    qcamera_dump_trailer_t trailer;
+
+    if (m_indexLost) {
+        return;
+    }
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.magic = QCAMERA_DUMP_INDEX_MAGIC;
+    trailer.count = m_indexCnt;
+    trailer.index_offset = m_fileOffset;
+    if (m_indexCnt > 0 && writeSpan((const uint8_t *)m_index,
+            sizeof(qcamera_dump_index_entry_t) * m_indexCnt) != NO_ERROR) {
+        return;
+    }
+    writeSpan((const uint8_t *)&trailer, sizeof(trailer));
+}
+
+/*===========================================================================
+ * FUNCTION   : nowNs
+ *
+ * DESCRIPTION: current CLOCK_MONOTONIC time
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : time in ns
+ *==========================================================================*/
+int64_t QCameraDumpWriter::nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,140 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __QCAMERA_DUMP_WRITER_H__
+#define __QCAMERA_DUMP_WRITER_H__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "QCameraDumpFormat.h"
+
+namespace qcamera {
+
+#define QCAMERA_DUMP_MAX_TYPES 32
+
+// one piece of a record: height rows of width bytes, stride bytes apart
+typedef struct {
+    const void *data;
+    size_t width;
+    size_t height;
+    size_t stride;
+} qcamera_dump_seg_t;
+
+typedef struct {
+    size_t ring_size;          // bytes of the copy ring
+    uint32_t rate_kbps;        // accepted KB per second, 0 for no limit
+    uint32_t min_interval_ms;  // per type gap between records, 0 for none
+    uint64_t max_file_size;    // bytes, 0 for no limit
+} qcamera_dump_config_t;
+
+typedef struct {
+    uint32_t queued;           // records accepted into the ring
+    uint32_t written;          // records written to the file
+    uint32_t dropped_full;     // ring had no room
+    uint32_t dropped_rate;     // over rate_kbps
+    uint32_t dropped_sample;   // within min_interval_ms of the last one
+    uint32_t dropped_limit;    // file would exceed max_file_size
+    uint32_t write_calls;
+    uint64_t bytes_written;
+    size_t peak_ring_used;
+} qcamera_dump_stats_t;
+
+/*
+ * Asynchronous writer for debug frame dumps. dump() copies a record into a
+ * preallocated ring and returns; a writer thread appends the ring contents
+ * to a single container file (see QCameraDumpFormat.h), writing as many
+ * consecutive records as are ready with one write() call.
+ *
+ * Records that do not fit in the ring, exceed the rate limit, come too
+ * soon after the last record of their type or would grow the file past
+ * its limit are dropped and counted, so dump() never blocks on storage.
+ * dump() may be called from any number of threads.
+ */
+class QCameraDumpWriter {
+public:
+    QCameraDumpWriter();
+    virtual ~QCameraDumpWriter();
+
+    int32_t start(const char *path, uint32_t cameraId,
+            const qcamera_dump_config_t &config);
+    void stop();
+    bool isRunning();
+    int32_t dump(uint32_t type, uint32_t frameIdx, const char *name,
+            const qcamera_dump_seg_t *segs, uint32_t count);
+    void getStats(qcamera_dump_stats_t &stats);
+
+private:
+    static void *writerRoutine(void *data);
+    void writerLoop();
+    int32_t writeSpan(const uint8_t *data, size_t len);
+    bool addIndex(uint64_t offset, const qcamera_dump_rec_hdr_t *hdr);
+    void writeIndex();
+    uint8_t *reserve(size_t len);
+    bool admit(uint32_t type, size_t len, int64_t now);
+    static int64_t nowNs();
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;        // records ready, or exit
+    pthread_t m_thread;
+    bool m_running;
+    bool m_exit;
+    int m_fd;
+    qcamera_dump_config_t m_config;
+
+    // copy ring, records are laid out exactly as in the file. While
+    // m_wrapped the unwritten data is [m_head, m_end) + [0, m_tail),
+    // otherwise [m_head, m_tail).
+    uint8_t *m_ring;
+    size_t m_head;
+    size_t m_tail;
+    size_t m_end;
+    bool m_wrapped;
+    size_t m_used;
+
+    uint32_t m_seq;
+    uint64_t m_accepted;          // bytes accepted for the file so far
+    int64_t m_tokens;             // rate limiter bucket, bytes
+    int64_t m_lastRefill;
+    int64_t m_lastType[QCAMERA_DUMP_MAX_TYPES];
+
+    // owned by the writer thread
+    uint64_t m_fileOffset;
+    qcamera_dump_index_entry_t *m_index;
+    uint32_t m_indexCnt;
+    uint32_t m_indexMax;
+    bool m_indexLost;             // out of memory, leave the file unindexed
+
+    qcamera_dump_stats_t m_stats;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_DUMP_WRITER_H__ */
@@ -0,0 +1,614 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_TAG "QCameraLoadGovernor"
+
+#include <string.h>
+#include <time.h>
+#include <utils/Log.h>
+#include "QCameraLoadGovernor.h"
+
+// a ladder step or a stage has to be worth this share of the frame period
+#define LOAD_MIN_SAVING_PCT 1
+// windows in a row under budget before a step is undone, doubled up to
+// the maximum each time an undone step has to be taken again right away
+// and halved each time one sticks
+#define LOAD_RELAX_WINDOWS 4
+#define LOAD_MAX_RELAX_WINDOWS 64
+
+namespace qcamera {
+
+// admit every Nth call of a stage, 0 never, one row per ladder level
+static const uint32_t gLoadLadder[][QCAMERA_LOAD_STAGE_MAX] = {
+    // dump, fd cb, preview cb, makeup, reprocess
+    { 1, 1, 1, 1, 1 },
+    { 0, 1, 1, 1, 1 },
+    { 0, 2, 1, 1, 1 },
+    { 0, 2, 2, 1, 1 },
+    { 0, 2, 2, 0, 1 },
+    { 0, 4, 4, 0, 1 },
+};
+
+#define LOAD_MAX_LEVEL \
+    ((uint32_t)(sizeof(gLoadLadder) / sizeof(gLoadLadder[0])) - 1)
+
+static const char *gLoadReasons[] = { "load", "relax", "thermal" };
+
+/*===========================================================================
+ * FUNCTION   : QCameraLoadGovernor
+ *
+ * DESCRIPTION: constructor of QCameraLoadGovernor
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraLoadGovernor::QCameraLoadGovernor()
+    : m_active(false),
+      m_fpsFn(NULL),
+      m_userData(NULL),
+      m_level(0),
+      m_loadStep(0),
+      m_thermalStep(0),
+      m_fpsStep(0),
+      m_calmWindows(0),
+      m_relaxWindows(LOAD_RELAX_WINDOWS),
+      m_lastRelax(0),
+      m_windowStart(0),
+      m_windowFrames(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_mutex_init(&m_notifyLock, NULL);
+    memset(&m_config, 0, sizeof(m_config));
+    memset(m_window, 0, sizeof(m_window));
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraLoadGovernor
+ *
+ * DESCRIPTION: deconstructor of QCameraLoadGovernor
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraLoadGovernor::~QCameraLoadGovernor()
+{
+    stop();
+    pthread_mutex_destroy(&m_notifyLock);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : start
+ *
+ * DESCRIPTION: begin governing a preview session. Measurements and
+ *              statistics of the previous session are cleared, the last
+ *              thermal step is kept.
+ *
+ * PARAMETERS :
+ *   @config  : frame period, budget and evaluation window
+ *   @fpsFn   : callback that applies a new frame rate step
+ *   @userData: user data ptr passed to fpsFn
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLoadGovernor::start(const qcamera_load_config_t &config,
+        qcamera_load_fps_t fpsFn, void *userData)
+{
+    pthread_mutex_lock(&m_notifyLock);
+    pthread_mutex_lock(&m_lock);
+    m_config = config;
+    if (m_config.max_fps_step > QCAMERA_LOAD_MAX_FPS_STEP) {
+        m_config.max_fps_step = QCAMERA_LOAD_MAX_FPS_STEP;
+    }
+    if (m_config.window_ms == 0) {
+        m_config.window_ms = 500;
+    }
+    m_fpsFn = fpsFn;
+    m_userData = userData;
+    m_level = (m_config.thermal_shed && (m_thermalStep > 0)) ?
+            LOAD_MAX_LEVEL : 0;
+    m_loadStep = 0;
+    m_calmWindows = 0;
+    m_relaxWindows = LOAD_RELAX_WINDOWS;
+    m_lastRelax = 0;
+    m_windowStart = 0;
+    m_windowFrames = 0;
+    memset(m_window, 0, sizeof(m_window));
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_active = (fpsFn != NULL) && (config.frame_ns > 0);
+    m_fpsStep = combinedStep();
+    pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_notifyLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : stop
+ *
+ * DESCRIPTION: end the session. Every stage is admitted again and the
+ *              rate step asked for by load is dropped; statistics stay
+ *              readable until the next start.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *
+ * NOTE       : waits for a rate callback that is in progress
+ *==========================================================================*/
+void QCameraLoadGovernor::stop()
+{
+    pthread_mutex_lock(&m_notifyLock);
+    pthread_mutex_lock(&m_lock);
+    m_active = false;
+    m_loadStep = 0;
+    m_fpsStep = combinedStep();
+    pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_notifyLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : isActive
+ *
+ * DESCRIPTION: query whether a session is being governed
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true between start and stop
+ *==========================================================================*/
+bool QCameraLoadGovernor::isActive()
+{
+    pthread_mutex_lock(&m_lock);
+    bool active = m_active;
+    pthread_mutex_unlock(&m_lock);
+    return active;
+}
+
+/*===========================================================================
+ * FUNCTION   : admit
+ *
+ * DESCRIPTION: decide whether an optional stage runs for this frame. Call
+ *              it only when the stage has work to do, so idle stages are
+ *              not taken for shed ones.
+ *
+ * PARAMETERS :
+ *   @stage   : stage about to run
+ *
+ * RETURN     : true if the stage should run
+ *==========================================================================*/
+bool QCameraLoadGovernor::admit(qcamera_load_stage_t stage)
+{
+    if (stage >= QCAMERA_LOAD_STAGE_MAX) {
+        return true;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (!m_active) {
+        pthread_mutex_unlock(&m_lock);
+        return true;
+    }
+    uint32_t divisor = gLoadLadder[m_level][stage];
+    window_t &win = m_window[stage];
+    bool admitted = (divisor != 0) && ((win.tick % divisor) == 0);
+    win.tick++;
+    win.calls++;
+    if (admitted) {
+        m_stats.stage[stage].runs++;
+    } else {
+        m_stats.stage[stage].shed++;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return admitted;
+}
+
+/*===========================================================================
+ * FUNCTION   : begin
+ *
+ * DESCRIPTION: start timing an admitted stage
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : start time to pass to end()
+ *==========================================================================*/
+int64_t QCameraLoadGovernor::begin()
+{
+    return nowNs();
+}
+
+/*===========================================================================
+ * FUNCTION   : end
+ *
+ * DESCRIPTION: account the time an admitted stage took
+ *
+ * PARAMETERS :
+ *   @stage   : stage that ran
+ *   @start   : value begin() returned
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLoadGovernor::end(qcamera_load_stage_t stage, int64_t start)
+{
+    int64_t cost = nowNs() - start;
+
+    if (stage >= QCAMERA_LOAD_STAGE_MAX || cost < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (m_active) {
+        qcamera_load_stage_stats_t &st = m_stats.stage[stage];
+        m_window[stage].busy_ns += cost;
+        st.avg_ns = average(st.avg_ns, cost);
+        if (cost > st.max_ns) {
+            st.max_ns = cost;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : frameDone
+ *
+ * DESCRIPTION: count a preview frame. At the end of each window the load
+ *              is evaluated and a changed rate step is passed to the
+ *              callback.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLoadGovernor::frameDone()
+{
+    int64_t now = nowNs();
+    bool notify = false;
+    uint32_t step = 0;
+
+    pthread_mutex_lock(&m_notifyLock);
+    pthread_mutex_lock(&m_lock);
+    if (!m_active) {
+        pthread_mutex_unlock(&m_lock);
+        pthread_mutex_unlock(&m_notifyLock);
+        return;
+    }
+    m_stats.frames++;
+    m_windowFrames++;
+    if (m_windowStart == 0) {
+        m_windowStart = now;
+    } else if (now - m_windowStart >= (int64_t)m_config.window_ms * 1000000LL) {
+        notify = evaluate(now);
+        step = m_fpsStep;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (notify) {
+        m_fpsFn(step, m_userData);
+    }
+    pthread_mutex_unlock(&m_notifyLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : setThermalStep
+ *
+ * DESCRIPTION: take a new step from the thermal engine and return the
+ *              rate step to apply now
+ *
+ * PARAMETERS :
+ *   @step    : thermal step, 0 for none
+ *
+ * RETURN     : rate step, load and thermal combined
+ *==========================================================================*/
+uint32_t QCameraLoadGovernor::setThermalStep(uint32_t step)
+{
+    pthread_mutex_lock(&m_lock);
+    bool changed = (step != m_thermalStep);
+    m_thermalStep = step;
+    if (m_active && m_config.thermal_shed && (step > 0) &&
+            (m_level < LOAD_MAX_LEVEL)) {
+        m_level = LOAD_MAX_LEVEL;
+        changed = true;
+    }
+    m_fpsStep = combinedStep();
+    if (m_active && changed) {
+        record(QCAMERA_LOAD_REASON_THERMAL, nowNs());
+    }
+    step = m_fpsStep;
+    pthread_mutex_unlock(&m_lock);
+    return step;
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: get governor statistics
+ *
+ * PARAMETERS :
+ *   @stats   : filled with a snapshot of the counters
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLoadGovernor::getStats(qcamera_load_stats_t &stats)
+{
+    pthread_mutex_lock(&m_lock);
+    stats = m_stats;
+    stats.level = m_level;
+    stats.max_level = LOAD_MAX_LEVEL;
+    stats.fps_step = m_fpsStep;
+    stats.load_step = m_loadStep;
+    stats.thermal_step = m_thermalStep;
+    for (int i = 0; i < QCAMERA_LOAD_STAGE_MAX; i++) {
+        stats.stage[i].divisor = m_active ? gLoadLadder[m_level][i] : 1;
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : framePeriod
+ *
+ * DESCRIPTION: frame period at the rate step in effect. Called with
+ *              m_lock held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : period in ns
+ *==========================================================================*/
+int64_t QCameraLoadGovernor::framePeriod()
+{
+    uint32_t step = (m_fpsStep < QCAMERA_LOAD_MAX_FPS_STEP) ?
+            m_fpsStep : QCAMERA_LOAD_MAX_FPS_STEP;
+    return m_config.frame_ns << step;
+}
+
+/*===========================================================================
+ * FUNCTION   : saving
+ *
+ * DESCRIPTION: per frame time saved by moving from one ladder level to a
+ *              higher one, from the last measured stage costs. Called with
+ *              m_lock held.
+ *
+ * PARAMETERS :
+ *   @from    : current level
+ *   @to      : higher level
+ *
+ * RETURN     : time in ns, negative if to sheds less than from
+ *==========================================================================*/
+int64_t QCameraLoadGovernor::saving(uint32_t from, uint32_t to)
+{
+    int64_t saved = 0;
+
+    for (int i = 0; i < QCAMERA_LOAD_STAGE_MAX; i++) {
+        int64_t cost = m_stats.stage[i].frame_cost_ns;
+        uint32_t a = gLoadLadder[from][i];
+        uint32_t b = gLoadLadder[to][i];
+        saved += ((a != 0) ? cost / a : 0) - ((b != 0) ? cost / b : 0);
+    }
+    return saved;
+}
+
+/*===========================================================================
+ * FUNCTION   : combinedStep
+ *
+ * DESCRIPTION: rate step to apply for the current thermal and load steps.
+ *              The thermal step is never lowered. Called with m_lock held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : rate step
+ *==========================================================================*/
+uint32_t QCameraLoadGovernor::combinedStep()
+{
+    uint32_t step = m_thermalStep;
+
+    if (!m_active) {
+        return step;
+    }
+    return (m_loadStep > step) ? m_loadStep : step;
+}
+
+/*===========================================================================
+ * FUNCTION   : evaluate
+ *
+ * DESCRIPTION: close a window: update stage costs, climb or descend the
+ *              ladder and the load rate step. Called with m_lock held.
+ *
+ * PARAMETERS :
+ *   @now     : end of the window
+ *
+ * RETURN     : true if the rate step changed
+ *==========================================================================*/
+bool QCameraLoadGovernor::evaluate(int64_t now)
+{
+    int64_t period = framePeriod();
+    int64_t busy = 0;
+    uint32_t frames = m_windowFrames;
+    uint32_t oldStep = m_fpsStep;
+
+    for (int i = 0; i < QCAMERA_LOAD_STAGE_MAX; i++) {
+        busy += m_window[i].busy_ns;
+    }
+    uint32_t load = (uint32_t)(busy * 100 / (period * frames));
+    int64_t minSaving = period * LOAD_MIN_SAVING_PCT / 100;
+
+    for (int i = 0; i < QCAMERA_LOAD_STAGE_MAX; i++) {
+        qcamera_load_stage_stats_t &st = m_stats.stage[i];
+        // a stage that is off is not measured any more; let its estimate
+        // fade while there is room so it gets another try eventually
+        if ((gLoadLadder[m_level][i] == 0) && (m_window[i].calls > 0) &&
+                (load <= m_config.budget_pct)) {
+            st.avg_ns -= st.avg_ns / 8;
+        }
+        // full rate cost: the average run times every call, shed or not
+        st.frame_cost_ns = st.avg_ns * m_window[i].calls / frames;
+        m_window[i].calls = 0;
+        m_window[i].busy_ns = 0;
+    }
+    m_windowStart = now;
+    m_windowFrames = 0;
+
+    m_stats.windows++;
+    m_stats.load_pct = load;
+    if (load > m_stats.peak_load_pct) {
+        m_stats.peak_load_pct = load;
+    }
+
+    if (load > m_config.budget_pct) {
+        m_calmWindows = 0;
+        if ((m_lastRelax != 0) && (m_stats.windows - m_lastRelax <= 2) &&
+                (m_relaxWindows < LOAD_MAX_RELAX_WINDOWS)) {
+            m_relaxWindows *= 2;
+        }
+        m_lastRelax = 0;
+        uint32_t next = m_level + 1;
+        while ((next <= LOAD_MAX_LEVEL) && (saving(m_level, next) < minSaving)) {
+            next++;
+        }
+        if (next <= LOAD_MAX_LEVEL) {
+            m_level = next;
+            m_stats.escalations++;
+            record(QCAMERA_LOAD_REASON_LOAD, now);
+        } else if (m_loadStep < m_config.max_fps_step) {
+            m_loadStep++;
+            m_stats.escalations++;
+            m_fpsStep = combinedStep();
+            record(QCAMERA_LOAD_REASON_LOAD, now);
+        }
+    } else if (++m_calmWindows >= m_relaxWindows) {
+        uint32_t limit = m_config.budget_pct * 3 / 4;
+        if (m_loadStep > 0) {
+            // same work per frame, half the period
+            if (load * 2 < limit) {
+                m_loadStep--;
+                relaxed();
+                m_fpsStep = combinedStep();
+                record(QCAMERA_LOAD_REASON_RELAX, now);
+            }
+        } else if ((m_level > 0) &&
+                !(m_config.thermal_shed && (m_thermalStep > 0))) {
+            // undo up to and including the first level that adds work back
+            uint32_t prev = m_level - 1;
+            while ((prev > 0) && (saving(prev, m_level) < minSaving)) {
+                prev--;
+            }
+            int64_t added = saving(prev, m_level);
+            if (load + (uint32_t)(added * 100 / period) < limit) {
+                m_level = prev;
+                relaxed();
+                record(QCAMERA_LOAD_REASON_RELAX, now);
+            }
+        }
+    }
+
+    return m_fpsStep != oldStep;
+}
+
+/*===========================================================================
+ * FUNCTION   : relaxed
+ *
+ * DESCRIPTION: bookkeeping after a step was undone. Called with m_lock
+ *              held.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLoadGovernor::relaxed()
+{
+    // the previous step undone was not taken again
+    if ((m_lastRelax != 0) && (m_relaxWindows > LOAD_RELAX_WINDOWS)) {
+        m_relaxWindows /= 2;
+    }
+    m_calmWindows = 0;
+    m_lastRelax = m_stats.windows;
+    m_stats.relaxations++;
+}
+
+/*===========================================================================
+ * FUNCTION   : record
+ *
+ * DESCRIPTION: log a decision. Called with m_lock held.
+ *
+ * PARAMETERS :
+ *   @reason  : what triggered it
+ *   @now     : time of the decision
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLoadGovernor::record(qcamera_load_reason_t reason, int64_t now)
+{
+    qcamera_load_decision_t &d =
+            m_stats.log[m_stats.decisions % QCAMERA_LOAD_LOG_SIZE];
+
+    d.ts_ns = now;
+    d.reason = reason;
+    d.level = m_level;
+    d.fps_step = m_fpsStep;
+    d.load_pct = m_stats.load_pct;
+    m_stats.decisions++;
+    ALOGD("%s: %s: level %u/%u, rate step %u (load %u thermal %u), load %u%%",
+            __func__, gLoadReasons[reason], m_level, LOAD_MAX_LEVEL,
+            m_fpsStep, m_loadStep, m_thermalStep, m_stats.load_pct);
+}
+
+/*===========================================================================
+ * FUNCTION   : average
+ *
+ * DESCRIPTION: exponential moving average with a weight of 1/8
+ *
+ * PARAMETERS :
+ *   @avg     : current average, 0 if there is none yet
+ *   @sample  : new sample
+ *
+ * RETURN     : updated average
+ *==========================================================================*/
+int64_t QCameraLoadGovernor::average(int64_t avg, int64_t sample)
+{
+    if (avg == 0) {
+        return sample;
+    }
+    return avg + (sample - avg) / 8;
+}
+
+/*===========================================================================
+ * FUNCTION   : nowNs
+ *
+ * DESCRIPTION: monotonic time
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : time in ns
+ *==========================================================================*/
+int64_t QCameraLoadGovernor::nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}; // namespace qcamera
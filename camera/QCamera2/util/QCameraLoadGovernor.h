@@ -0,0 +1,188 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_LOAD_GOVERNOR_H__
+#define __QCAMERA_LOAD_GOVERNOR_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+// frame rate steps the governor takes on its own, each one halves the rate
+#define QCAMERA_LOAD_MAX_FPS_STEP 2
+// decisions kept for dumps
+#define QCAMERA_LOAD_LOG_SIZE 16
+
+// optional per frame work, in the order it is shed
+typedef enum {
+    QCAMERA_LOAD_STAGE_DUMP,          // preview frame dumps
+    QCAMERA_LOAD_STAGE_FD_CB,         // face detection callbacks
+    QCAMERA_LOAD_STAGE_PREVIEW_CB,    // preview data callbacks
+    QCAMERA_LOAD_STAGE_MAKEUP,        // TS makeup on preview frames
+    QCAMERA_LOAD_STAGE_REPROCESS,     // reprocess requests, measured only
+    QCAMERA_LOAD_STAGE_MAX
+} qcamera_load_stage_t;
+
+typedef enum {
+    QCAMERA_LOAD_REASON_LOAD,         // optional stages over budget
+    QCAMERA_LOAD_REASON_RELAX,        // back under budget for long enough
+    QCAMERA_LOAD_REASON_THERMAL,      // thermal step changed
+} qcamera_load_reason_t;
+
+// asks for a new frame rate step, 0 is the configured rate
+typedef void (*qcamera_load_fps_t)(uint32_t step, void *user_data);
+
+typedef struct {
+    int64_t frame_ns;           // frame period at the configured rate
+    uint32_t budget_pct;        // share of a frame period optional stages may use
+    uint32_t window_ms;         // how often the load is evaluated
+    uint32_t max_fps_step;      // rate steps allowed for load, 0 never touches the rate
+    bool thermal_shed;          // also shed the whole ladder during a thermal step
+} qcamera_load_config_t;
+
+typedef struct {
+    uint32_t runs;              // invocations that were admitted
+    uint32_t shed;              // invocations that were skipped
+    uint32_t divisor;           // 1 every frame, N every Nth, 0 off
+    int64_t avg_ns;             // one run, moving average
+    int64_t max_ns;
+    int64_t frame_cost_ns;      // per frame if it was admitted every time
+} qcamera_load_stage_stats_t;
+
+typedef struct {
+    int64_t ts_ns;
+    qcamera_load_reason_t reason;
+    uint32_t level;
+    uint32_t fps_step;
+    uint32_t load_pct;
+} qcamera_load_decision_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t windows;
+    uint32_t level;             // position on the shed ladder
+    uint32_t max_level;
+    uint32_t fps_step;          // rate step in effect, load and thermal combined
+    uint32_t load_step;         // part of it asked for by load alone
+    uint32_t thermal_step;      // last step reported by the thermal engine
+    uint32_t load_pct;          // last window, share of the frame period
+    uint32_t peak_load_pct;
+    uint32_t escalations;
+    uint32_t relaxations;
+    uint32_t decisions;         // total, the log keeps the newest ones
+    qcamera_load_decision_t log[QCAMERA_LOAD_LOG_SIZE];
+    qcamera_load_stage_stats_t stage[QCAMERA_LOAD_STAGE_MAX];
+} qcamera_load_stats_t;
+
+/*
+ * Closed loop control of the optional work done per preview frame.
+ *
+ * Every optional stage asks admit() before it runs and brackets the run
+ * with begin() and end(); frameDone() is called once per preview frame.
+ * Each window the time spent in the stages is compared with budget_pct of
+ * the frame period. Over budget the governor climbs a fixed ladder that
+ * first drops dumps, then thins out face detection and preview callbacks,
+ * then turns makeup off and finally thins the callbacks further. Levels
+ * that would save less than a percent of the frame period, because the
+ * stage is idle or cheap, are skipped. Only when the ladder is exhausted
+ * does it ask for a lower frame rate through the callback. Reprocess cost
+ * counts against the budget but is never shed, the app asked for those
+ * frames.
+ *
+ * Going back down is one step at a time, after several windows under
+ * budget and only if the projected load with the step undone stays below
+ * three quarters of the budget. Stages that are off cannot be measured,
+ * so their last cost fades while there is room; a step that has to be
+ * taken again right after being undone doubles the wait for the next try.
+ *
+ * setThermalStep() feeds in the thermal engine's rate step. It always
+ * applies unchanged; the step handed out is the larger of the thermal
+ * and the load step. With thermal_shed set, a thermal step also sheds the
+ * whole ladder until it is cleared, on top of the lower rate.
+ *
+ * All calls are thread safe. The rate callback runs on the thread calling
+ * frameDone() and never after stop() returns. Without start() every stage
+ * is admitted and thermal steps pass through.
+ */
+class QCameraLoadGovernor {
+public:
+    QCameraLoadGovernor();
+    virtual ~QCameraLoadGovernor();
+
+    void start(const qcamera_load_config_t &config,
+            qcamera_load_fps_t fpsFn, void *userData);
+    void stop();
+    bool isActive();
+    bool admit(qcamera_load_stage_t stage);
+    int64_t begin();
+    void end(qcamera_load_stage_t stage, int64_t start);
+    void frameDone();
+    uint32_t setThermalStep(uint32_t step);
+    void getStats(qcamera_load_stats_t &stats);
+
+private:
+    typedef struct {
+        uint32_t calls;           // admit() calls this window
+        uint32_t tick;            // admit() calls, for thinning out
+        int64_t busy_ns;          // run time this window
+    } window_t;
+
+    static int64_t average(int64_t avg, int64_t sample);
+    static int64_t nowNs();
+    int64_t framePeriod();
+    int64_t saving(uint32_t from, uint32_t to);
+    uint32_t combinedStep();
+    bool evaluate(int64_t now);
+    void relaxed();
+    void record(qcamera_load_reason_t reason, int64_t now);
+
+    pthread_mutex_t m_lock;
+    pthread_mutex_t m_notifyLock; // held across the rate callback
+    bool m_active;
+    qcamera_load_config_t m_config;
+    qcamera_load_fps_t m_fpsFn;
+    void *m_userData;
+
+    uint32_t m_level;
+    uint32_t m_loadStep;
+    uint32_t m_thermalStep;
+    uint32_t m_fpsStep;           // last step handed out
+    uint32_t m_calmWindows;       // windows in a row under budget
+    uint32_t m_relaxWindows;      // calm windows needed to undo a step
+    uint32_t m_lastRelax;         // window a step was last undone in
+    int64_t m_windowStart;
+    uint32_t m_windowFrames;
+    window_t m_window[QCAMERA_LOAD_STAGE_MAX];
+    qcamera_load_stats_t m_stats;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_LOAD_GOVERNOR_H__ */
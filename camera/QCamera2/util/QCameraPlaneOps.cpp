@@ -0,0 +1,316 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <string.h>
+#include "QCameraPlaneOps.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PLANE_OPS_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PLANE_OPS_SSE2
+#endif
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : copyPlane
+ *
+ * DESCRIPTION: copy width bytes of each of height rows between buffers
+ *              of different strides
+ *
+ * PARAMETERS :
+ *   @dst       : destination plane
+ *   @dstStride : destination row pitch in bytes
+ *   @src       : source plane
+ *   @srcStride : source row pitch in bytes
+ *   @width     : bytes per row to copy
+ *   @height    : number of rows
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPlaneOps::copyPlane(uint8_t *dst, int32_t dstStride,
+        const uint8_t *src, int32_t srcStride, int32_t width, int32_t height)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (dstStride == width && srcStride == width) {
+        memcpy(dst, src, (size_t)width * (size_t)height);
+        return;
+    }
+    // libc memcpy is already vectorized, rows are long enough for it
+    for (int32_t j = 0; j < height; j++) {
+        memcpy(dst, src, (size_t)width);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : swapUV
+ *
+ * DESCRIPTION: exchange the bytes of each interleaved chroma pair,
+ *              converting NV21 chroma to NV12 or back. dst may equal src.
+ *
+ * PARAMETERS :
+ *   @dst       : destination chroma plane
+ *   @dstStride : destination row pitch in bytes
+ *   @src       : source chroma plane
+ *   @srcStride : source row pitch in bytes
+ *   @pairs     : chroma pairs per row
+ *   @height    : number of rows
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPlaneOps::swapUV(uint8_t *dst, int32_t dstStride,
+        const uint8_t *src, int32_t srcStride, int32_t pairs, int32_t height)
+{
+    for (int32_t j = 0; j < height; j++) {
+        const uint8_t *s = src + (size_t)j * srcStride;
+        uint8_t *d = dst + (size_t)j * dstStride;
+        int32_t i = 0;
+#if defined(PLANE_OPS_NEON)
+        for (; i + 16 <= pairs; i += 16) {
+            uint8x16x2_t uv = vld2q_u8(s + 2 * i);
+            uint8x16x2_t vu;
+            vu.val[0] = uv.val[1];
+            vu.val[1] = uv.val[0];
+            vst2q_u8(d + 2 * i, vu);
+        }
+#elif defined(PLANE_OPS_SSE2)
+        for (; i + 8 <= pairs; i += 8) {
+            __m128i uv = _mm_loadu_si128((const __m128i *)(s + 2 * i));
+            __m128i vu = _mm_or_si128(_mm_slli_epi16(uv, 8), _mm_srli_epi16(uv, 8));
+            _mm_storeu_si128((__m128i *)(d + 2 * i), vu);
+        }
+#endif
+        for (; i < pairs; i++) {
+            uint8_t c0 = s[2 * i];
+            d[2 * i] = s[2 * i + 1];
+            d[2 * i + 1] = c0;
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : splitUV
+ *
+ * DESCRIPTION: deinterleave semi planar chroma into two planes, e.g.
+ *              NV21 chroma into the V and U planes of YV12
+ *
+ * PARAMETERS :
+ *   @dst0       : plane receiving the first byte of each pair
+ *   @dst0Stride : its row pitch in bytes
+ *   @dst1       : plane receiving the second byte of each pair
+ *   @dst1Stride : its row pitch in bytes
+ *   @src        : interleaved chroma plane
+ *   @srcStride  : source row pitch in bytes
+ *   @pairs      : chroma pairs per row
+ *   @height     : number of rows
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPlaneOps::splitUV(uint8_t *dst0, int32_t dst0Stride,
+        uint8_t *dst1, int32_t dst1Stride,
+        const uint8_t *src, int32_t srcStride, int32_t pairs, int32_t height)
+{
+    for (int32_t j = 0; j < height; j++) {
+        const uint8_t *s = src + (size_t)j * srcStride;
+        uint8_t *d0 = dst0 + (size_t)j * dst0Stride;
+        uint8_t *d1 = dst1 + (size_t)j * dst1Stride;
+        int32_t i = 0;
+#if defined(PLANE_OPS_NEON)
+        for (; i + 16 <= pairs; i += 16) {
+            uint8x16x2_t uv = vld2q_u8(s + 2 * i);
+            vst1q_u8(d0 + i, uv.val[0]);
+            vst1q_u8(d1 + i, uv.val[1]);
+        }
+#elif defined(PLANE_OPS_SSE2)
+        const __m128i lo = _mm_set1_epi16(0x00ff);
+        for (; i + 16 <= pairs; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(s + 2 * i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(s + 2 * i + 16));
+            _mm_storeu_si128((__m128i *)(d0 + i), _mm_packus_epi16(
+                    _mm_and_si128(a, lo), _mm_and_si128(b, lo)));
+            _mm_storeu_si128((__m128i *)(d1 + i), _mm_packus_epi16(
+                    _mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+        }
+#endif
+        for (; i < pairs; i++) {
+            d0[i] = s[2 * i];
+            d1[i] = s[2 * i + 1];
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mergeUV
+ *
+ * DESCRIPTION: interleave two chroma planes into semi planar chroma, e.g.
+ *              the V and U planes of YV12 into NV21 chroma
+ *
+ * PARAMETERS :
+ *   @dst        : interleaved chroma plane
+ *   @dstStride  : destination row pitch in bytes
+ *   @src0       : plane supplying the first byte of each pair
+ *   @src0Stride : its row pitch in bytes
+ *   @src1       : plane supplying the second byte of each pair
+ *   @src1Stride : its row pitch in bytes
+ *   @pairs      : chroma pairs per row
+ *   @height     : number of rows
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPlaneOps::mergeUV(uint8_t *dst, int32_t dstStride,
+        const uint8_t *src0, int32_t src0Stride,
+        const uint8_t *src1, int32_t src1Stride, int32_t pairs, int32_t height)
+{
+    for (int32_t j = 0; j < height; j++) {
+        const uint8_t *s0 = src0 + (size_t)j * src0Stride;
+        const uint8_t *s1 = src1 + (size_t)j * src1Stride;
+        uint8_t *d = dst + (size_t)j * dstStride;
+        int32_t i = 0;
+#if defined(PLANE_OPS_NEON)
+        for (; i + 16 <= pairs; i += 16) {
+            uint8x16x2_t uv;
+            uv.val[0] = vld1q_u8(s0 + i);
+            uv.val[1] = vld1q_u8(s1 + i);
+            vst2q_u8(d + 2 * i, uv);
+        }
+#elif defined(PLANE_OPS_SSE2)
+        for (; i + 16 <= pairs; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(s0 + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(s1 + i));
+            _mm_storeu_si128((__m128i *)(d + 2 * i), _mm_unpacklo_epi8(a, b));
+            _mm_storeu_si128((__m128i *)(d + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+        }
+#endif
+        for (; i < pairs; i++) {
+            d[2 * i] = s0[i];
+            d[2 * i + 1] = s1[i];
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : yuyvToSemiPlanar
+ *
+ * DESCRIPTION: convert packed YUYV 4:2:2 to NV12 or NV21. Luma keeps every
+ *              row, chroma is sampled from the even rows.
+ *
+ * PARAMETERS :
+ *   @dstY        : destination luma plane
+ *   @dstYStride  : luma row pitch in bytes
+ *   @dstUV       : destination chroma plane
+ *   @dstUVStride : chroma row pitch in bytes
+ *   @src         : YUYV source
+ *   @srcStride   : source row pitch in bytes
+ *   @width       : width in pixels, even
+ *   @height      : height in rows
+ *   @vuOrder     : true for NV21 (V first), false for NV12
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPlaneOps::yuyvToSemiPlanar(uint8_t *dstY, int32_t dstYStride,
+        uint8_t *dstUV, int32_t dstUVStride,
+        const uint8_t *src, int32_t srcStride,
+        int32_t width, int32_t height, bool vuOrder)
+{
+    const int32_t pairs = width / 2;
+
+    for (int32_t j = 0; j < height; j++) {
+        const uint8_t *s = src + (size_t)j * srcStride;
+        uint8_t *y = dstY + (size_t)j * dstYStride;
+        uint8_t *c = (j & 1) ? NULL : dstUV + (size_t)(j / 2) * dstUVStride;
+        int32_t i = 0;
+#if defined(PLANE_OPS_NEON)
+        for (; i + 16 <= pairs; i += 16) {
+            uint8x16x4_t p = vld4q_u8(s + 4 * i);   // Y0 U Y1 V
+            uint8x16x2_t luma;
+            luma.val[0] = p.val[0];
+            luma.val[1] = p.val[2];
+            vst2q_u8(y + 2 * i, luma);
+            if (c != NULL) {
+                uint8x16x2_t chroma;
+                chroma.val[0] = vuOrder ? p.val[3] : p.val[1];
+                chroma.val[1] = vuOrder ? p.val[1] : p.val[3];
+                vst2q_u8(c + 2 * i, chroma);
+            }
+        }
+#elif defined(PLANE_OPS_SSE2)
+        const __m128i lo = _mm_set1_epi16(0x00ff);
+        for (; i + 8 <= pairs; i += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(s + 4 * i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(s + 4 * i + 16));
+            _mm_storeu_si128((__m128i *)(y + 2 * i), _mm_packus_epi16(
+                    _mm_and_si128(a, lo), _mm_and_si128(b, lo)));
+            if (c != NULL) {
+                __m128i uv = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+                        _mm_srli_epi16(b, 8));
+                if (vuOrder) {
+                    uv = _mm_or_si128(_mm_slli_epi16(uv, 8), _mm_srli_epi16(uv, 8));
+                }
+                _mm_storeu_si128((__m128i *)(c + 2 * i), uv);
+            }
+        }
+#endif
+        for (; i < pairs; i++) {
+            y[2 * i] = s[4 * i];
+            y[2 * i + 1] = s[4 * i + 2];
+            if (c != NULL) {
+                c[2 * i] = s[4 * i + (vuOrder ? 3 : 1)];
+                c[2 * i + 1] = s[4 * i + (vuOrder ? 1 : 3)];
+            }
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : impl
+ *
+ * DESCRIPTION: name of the kernel set compiled in
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : "neon", "sse2" or "scalar"
+ *==========================================================================*/
+const char *QCameraPlaneOps::impl()
+{
+#if defined(PLANE_OPS_NEON)
+    return "neon";
+#elif defined(PLANE_OPS_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+}; // namespace qcamera
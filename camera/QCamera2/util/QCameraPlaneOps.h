@@ -0,0 +1,88 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_PLANE_OPS_H__
+#define __QCAMERA_PLANE_OPS_H__
+
+#include <stdint.h>
+
+namespace qcamera {
+
+/*
+ * Row based copy and format conversion kernels for 8 bit YUV planes.
+ *
+ * Every call takes base pointers and strides in bytes for each plane, so
+ * the same kernel strips padding (dst stride == width), adds it back, or
+ * works in place on padded buffers. Widths are in pixels of the plane
+ * being written: for the interleaved chroma of NV12/NV21 that is the
+ * number of chroma pairs. Buffers must not overlap, except that swapUV()
+ * may be called with dst == src.
+ *
+ * NEON and SSE2 bodies are picked at compile time; any build without
+ * either uses the scalar loops. Heights of 0 or widths of 0 are no-ops.
+ */
+class QCameraPlaneOps {
+public:
+    // plain plane copy, collapses to one memcpy when both are unpadded
+    static void copyPlane(uint8_t *dst, int32_t dstStride,
+            const uint8_t *src, int32_t srcStride,
+            int32_t width, int32_t height);
+
+    // NV21 <-> NV12 chroma: swap the two bytes of every pair
+    static void swapUV(uint8_t *dst, int32_t dstStride,
+            const uint8_t *src, int32_t srcStride,
+            int32_t pairs, int32_t height);
+
+    // semi planar chroma -> two planes. The first byte of each pair goes
+    // to dst0: pass U then V for NV12, V then U for NV21.
+    static void splitUV(uint8_t *dst0, int32_t dst0Stride,
+            uint8_t *dst1, int32_t dst1Stride,
+            const uint8_t *src, int32_t srcStride,
+            int32_t pairs, int32_t height);
+
+    // two chroma planes -> semi planar, src0 supplies the first byte
+    static void mergeUV(uint8_t *dst, int32_t dstStride,
+            const uint8_t *src0, int32_t src0Stride,
+            const uint8_t *src1, int32_t src1Stride,
+            int32_t pairs, int32_t height);
+
+    // packed YUYV -> NV12 (vuOrder false) or NV21 (vuOrder true). Chroma
+    // is taken from the even source rows. width must be even.
+    static void yuyvToSemiPlanar(uint8_t *dstY, int32_t dstYStride,
+            uint8_t *dstUV, int32_t dstUVStride,
+            const uint8_t *src, int32_t srcStride,
+            int32_t width, int32_t height, bool vuOrder);
+
+    // name of the compiled in kernel set, for logs and benchmarks
+    static const char *impl();
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_PLANE_OPS_H__ */
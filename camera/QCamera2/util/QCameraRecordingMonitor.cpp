@@ -0,0 +1,387 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+#include "QCameraRecordingMonitor.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraRecordingMonitor
+ *
+ * DESCRIPTION: constructor of QCameraRecordingMonitor
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraRecordingMonitor::QCameraRecordingMonitor()
+    : m_active(false),
+      m_growPending(false),
+      m_starving(false),
+      m_starveRun(0),
+      m_starveStart(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_mutex_init(&m_growLock, NULL);
+    memset(&m_config, 0, sizeof(m_config));
+    memset(m_sentNs, 0, sizeof(m_sentNs));
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraRecordingMonitor
+ *
+ * DESCRIPTION: deconstructor of QCameraRecordingMonitor
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraRecordingMonitor::~QCameraRecordingMonitor()
+{
+    stop();
+    pthread_mutex_destroy(&m_growLock);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : start
+ *
+ * DESCRIPTION: begin monitoring a recording session, statistics of the
+ *              previous session are cleared
+ *
+ * PARAMETERS :
+ *   @config  : buffer counts and starvation thresholds
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraRecordingMonitor::start(const qcamera_rec_config_t &config)
+{
+    pthread_mutex_lock(&m_lock);
+    m_config = config;
+    if (m_config.active_bufs > QCAMERA_REC_MAX_BUFS) {
+        m_config.active_bufs = QCAMERA_REC_MAX_BUFS;
+    }
+    if (m_config.max_bufs > QCAMERA_REC_MAX_BUFS) {
+        m_config.max_bufs = QCAMERA_REC_MAX_BUFS;
+    }
+    if (m_config.max_bufs < m_config.active_bufs) {
+        m_config.max_bufs = m_config.active_bufs;
+    }
+    if (m_config.starve_frames == 0) {
+        m_config.starve_frames = 1;
+    }
+    if (m_config.grow_step == 0) {
+        m_config.grow_step = 1;
+    }
+    m_growPending = false;
+    m_starving = false;
+    m_starveRun = 0;
+    m_starveStart = 0;
+    memset(m_sentNs, 0, sizeof(m_sentNs));
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_active = true;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : stop
+ *
+ * DESCRIPTION: end the session. Frames still at the encoder are no longer
+ *              tracked.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *
+ * NOTE       : waits for a growth that is in progress
+ *==========================================================================*/
+void QCameraRecordingMonitor::stop()
+{
+    pthread_mutex_lock(&m_growLock);
+    pthread_mutex_lock(&m_lock);
+    if (m_active && m_starving) {
+        m_stats.starved_ns += nowNs() - m_starveStart;
+    }
+    m_starving = false;
+    m_growPending = false;
+    m_active = false;
+    pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_growLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : isActive
+ *
+ * DESCRIPTION: query whether a session is being monitored
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true between start and stop
+ *==========================================================================*/
+bool QCameraRecordingMonitor::isActive()
+{
+    pthread_mutex_lock(&m_lock);
+    bool active = m_active;
+    pthread_mutex_unlock(&m_lock);
+    return active;
+}
+
+/*===========================================================================
+ * FUNCTION   : sent
+ *
+ * DESCRIPTION: account a frame handed to the encoder. Call it before the
+ *              frame is handed over, so its return can not overtake it.
+ *
+ * PARAMETERS :
+ *   @index   : buffer index
+ *
+ * RETURN     : number of buffers to add to the stream, 0 for none. A
+ *              non zero count has to be answered with beginGrow and
+ *              endGrow before another one is asked for.
+ *==========================================================================*/
+uint32_t QCameraRecordingMonitor::sent(uint32_t index)
+{
+    int64_t now = nowNs();
+    uint32_t grow = 0;
+
+    pthread_mutex_lock(&m_lock);
+    if (!m_active || index >= QCAMERA_REC_MAX_BUFS) {
+        pthread_mutex_unlock(&m_lock);
+        return 0;
+    }
+    // a buffer that is still out had its return missed, restart it
+    if (m_sentNs[index] == 0) {
+        m_stats.in_flight++;
+        if (m_stats.in_flight > m_stats.peak_in_flight) {
+            m_stats.peak_in_flight = m_stats.in_flight;
+        }
+    }
+    m_sentNs[index] = now;
+    m_stats.sent++;
+
+    updateStarving(now);
+    if (m_starving) {
+        m_stats.starved_frames++;
+        m_starveRun++;
+    } else {
+        m_starveRun = 0;
+    }
+    if (m_starving && (m_starveRun >= m_config.starve_frames) &&
+            !m_growPending && (m_config.active_bufs < m_config.max_bufs)) {
+        grow = m_config.max_bufs - m_config.active_bufs;
+        if (grow > m_config.grow_step) {
+            grow = m_config.grow_step;
+        }
+        m_growPending = true;
+        m_starveRun = 0;
+        m_stats.grow_requests++;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return grow;
+}
+
+/*===========================================================================
+ * FUNCTION   : cancel
+ *
+ * DESCRIPTION: take back a sent frame that never reached the encoder
+ *
+ * PARAMETERS :
+ *   @index   : buffer index
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraRecordingMonitor::cancel(uint32_t index)
+{
+    pthread_mutex_lock(&m_lock);
+    if (m_active && (index < QCAMERA_REC_MAX_BUFS) && (m_sentNs[index] != 0)) {
+        m_sentNs[index] = 0;
+        m_stats.in_flight--;
+        m_stats.cancelled++;
+        updateStarving(nowNs());
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : returned
+ *
+ * DESCRIPTION: account a frame the encoder gave back. Call it before the
+ *              buffer is queued to the driver again.
+ *
+ * PARAMETERS :
+ *   @index   : buffer index, out of range for buffers that were not found
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraRecordingMonitor::returned(uint32_t index)
+{
+    int64_t now = nowNs();
+
+    pthread_mutex_lock(&m_lock);
+    if (!m_active) {
+        pthread_mutex_unlock(&m_lock);
+        return;
+    }
+    if (index >= QCAMERA_REC_MAX_BUFS || m_sentNs[index] == 0) {
+        m_stats.unknown++;
+        pthread_mutex_unlock(&m_lock);
+        return;
+    }
+    int64_t hold = now - m_sentNs[index];
+    m_sentNs[index] = 0;
+    m_stats.in_flight--;
+    m_stats.returned++;
+    m_stats.hold_total_ns += hold;
+    if (hold > m_stats.hold_max_ns) {
+        m_stats.hold_max_ns = hold;
+    }
+    updateStarving(now);
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : beginGrow
+ *
+ * DESCRIPTION: start adding the buffers sent() asked for. On success the
+ *              growth has to be finished with endGrow.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true if buffers may be added, false once stopped
+ *==========================================================================*/
+bool QCameraRecordingMonitor::beginGrow()
+{
+    pthread_mutex_lock(&m_growLock);
+    pthread_mutex_lock(&m_lock);
+    bool active = m_active;
+    if (!active) {
+        m_growPending = false;
+    }
+    pthread_mutex_unlock(&m_lock);
+    if (!active) {
+        pthread_mutex_unlock(&m_growLock);
+    }
+    return active;
+}
+
+/*===========================================================================
+ * FUNCTION   : endGrow
+ *
+ * DESCRIPTION: finish a growth begun with beginGrow
+ *
+ * PARAMETERS :
+ *   @added   : buffers the stream took on, 0 if the growth failed
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraRecordingMonitor::endGrow(uint32_t added)
+{
+    pthread_mutex_lock(&m_lock);
+    m_growPending = false;
+    if (added == 0) {
+        m_stats.grow_failures++;
+    } else {
+        if (added > m_config.max_bufs - m_config.active_bufs) {
+            added = m_config.max_bufs - m_config.active_bufs;
+        }
+        m_config.active_bufs += added;
+        m_stats.grown += added;
+        updateStarving(nowNs());
+    }
+    pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_growLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: get recording statistics
+ *
+ * PARAMETERS :
+ *   @stats   : filled with a snapshot of the counters
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraRecordingMonitor::getStats(qcamera_rec_stats_t &stats)
+{
+    pthread_mutex_lock(&m_lock);
+    stats = m_stats;
+    stats.active_bufs = m_config.active_bufs;
+    stats.max_bufs = m_config.max_bufs;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : updateStarving
+ *
+ * DESCRIPTION: re-evaluate starvation after the in flight count or the
+ *              buffer count changed. Called with m_lock held.
+ *
+ * PARAMETERS :
+ *   @now     : current time
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraRecordingMonitor::updateStarving(int64_t now)
+{
+    uint32_t left = (m_config.active_bufs > m_stats.in_flight) ?
+            m_config.active_bufs - m_stats.in_flight : 0;
+    bool starving = (left <= m_config.low_water);
+
+    if (starving && !m_starving) {
+        m_stats.starvations++;
+        m_starveStart = now;
+    } else if (!starving && m_starving) {
+        m_stats.starved_ns += now - m_starveStart;
+        m_starveRun = 0;
+    }
+    m_starving = starving;
+}
+
+/*===========================================================================
+ * FUNCTION   : nowNs
+ *
+ * DESCRIPTION: monotonic clock
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : time in ns
+ *==========================================================================*/
+int64_t QCameraRecordingMonitor::nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,120 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_RECORDING_MONITOR_H__
+#define __QCAMERA_RECORDING_MONITOR_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+// buffer indexes the monitor can track
+#define QCAMERA_REC_MAX_BUFS 32
+
+typedef struct {
+    uint32_t active_bufs;       // buffers the stream cycles through at start
+    uint32_t max_bufs;          // growth limit, <= active_bufs never grows
+    uint32_t low_water;         // starving with this many or fewer left
+    uint32_t starve_frames;     // frames in a row starving before growing
+    uint32_t grow_step;         // buffers asked for per growth
+} qcamera_rec_config_t;
+
+typedef struct {
+    uint32_t sent;              // frames handed to the encoder
+    uint32_t returned;
+    uint32_t cancelled;         // frames that never reached the encoder
+    uint32_t unknown;           // returns of buffers that were not out
+    uint32_t in_flight;         // held by the encoder now
+    uint32_t peak_in_flight;
+    int64_t hold_total_ns;      // over all returned frames
+    int64_t hold_max_ns;
+    uint32_t starvations;       // times the driver ran down to low_water
+    uint32_t starved_frames;    // frames sent while starving
+    int64_t starved_ns;         // time spent starving, finished episodes
+    uint32_t grow_requests;
+    uint32_t grow_failures;
+    uint32_t grown;             // buffers added during the session
+    uint32_t active_bufs;
+    uint32_t max_bufs;
+} qcamera_rec_stats_t;
+
+/*
+ * Watches the buffers of a recording session on their way through the
+ * encoder.
+ *
+ * sent() is called as a video frame is handed to the encoder and
+ * returned() as the encoder gives it back, both by buffer index. The time
+ * in between is the hold time. Whatever the encoder holds is not
+ * available to the driver; once that leaves low_water buffers or fewer
+ * the session is starving and the next few frames risk being dropped by
+ * the ISP. Starving for starve_frames frames in a row makes sent() ask
+ * for grow_step more buffers, up to max_bufs. The caller adds them off
+ * the frame path and brackets that with beginGrow() and endGrow(); only
+ * one growth is outstanding at a time.
+ *
+ * All calls are thread safe. stop() waits for a growth in progress and
+ * beginGrow() refuses once stop() returned, so buffers are never added to
+ * a stream that is being torn down. Statistics stay readable until the
+ * next start().
+ */
+class QCameraRecordingMonitor {
+public:
+    QCameraRecordingMonitor();
+    virtual ~QCameraRecordingMonitor();
+
+    void start(const qcamera_rec_config_t &config);
+    void stop();
+    bool isActive();
+    uint32_t sent(uint32_t index);
+    void cancel(uint32_t index);
+    void returned(uint32_t index);
+    bool beginGrow();
+    void endGrow(uint32_t added);
+    void getStats(qcamera_rec_stats_t &stats);
+
+private:
+    static int64_t nowNs();
+    void updateStarving(int64_t now);
+
+    pthread_mutex_t m_lock;
+    pthread_mutex_t m_growLock;   // held from beginGrow to endGrow
+    bool m_active;
+    bool m_growPending;
+    bool m_starving;
+    uint32_t m_starveRun;         // frames in a row sent while starving
+    int64_t m_starveStart;
+    qcamera_rec_config_t m_config;
+    int64_t m_sentNs[QCAMERA_REC_MAX_BUFS]; // 0 when not at the encoder
+    qcamera_rec_stats_t m_stats;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_RECORDING_MONITOR_H__ */
@@ -19,15 +19,20 @@
 // #define LOG_NDEBUG 0
 
 #include <cutils/log.h>
+#include <cutils/properties.h>
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 
 #include <hardware/lights.h>
@@ -40,63 +45,238 @@ static struct light_state_t g_notification;
 static struct light_state_t g_battery;
 static int g_attention = 0;
 
-char const*const RED_LED_FILE
-        = "/sys/class/leds/red/brightness";
+/* backlight ramp engine, disabled unless persist.lights.ramp_rate is set */
+#define RAMP_PERIOD_MS 16
+static int g_ramp_fd = -1;
+static int g_ramp_rate; /* brightness levels per second */
+static int g_ramp_active;
+static int64_t g_ramp_last_ns;
+static int g_backlight_current;
+static int g_backlight_target;
+
+/* statistics, logged every STATS_INTERVAL calls if debug.lights.stats=1 */
+#define STATS_INTERVAL 256
+static int g_stats_enabled;
+static struct {
+    int64_t calls;
+    int64_t writes;
+    int64_t syscalls;
+    int64_t syscalls_avoided;
+    int64_t latency_sum_ns;
+    int64_t latency_max_ns;
+} g_stats;
+
+enum {
+    RED_LED,
+    GREEN_LED,
+    BLUE_LED,
+    BLUETOOTH_LED,
+    LCD,
+    BUTTON,
+    RED_BLINK,
+    GREEN_BLINK,
+    BLUE_BLINK,
+    NODE_COUNT,
+};
 
-char const*const GREEN_LED_FILE
-        = "/sys/class/leds/green/brightness";
+/*
+ * The sysfs nodes are opened on first use and kept open. The last value
+ * written is cached so writing the same value again costs no syscall.
+ * Brightness and blink of one LED affect each other in the driver, so a
+ * write to either invalidates the cached value of its pair.
+ */
+struct led_node {
+    char const* path;
+    int pair;
+    int fd;
+    int value;
+};
 
-char const*const BLUE_LED_FILE
-        = "/sys/class/leds/blue/brightness";
+static struct led_node g_nodes[NODE_COUNT] = {
+    [RED_LED]       = { "/sys/class/leds/red/brightness", RED_BLINK, -1, -1 },
+    [GREEN_LED]     = { "/sys/class/leds/green/brightness", GREEN_BLINK, -1, -1 },
+    [BLUE_LED]      = { "/sys/class/leds/blue/brightness", BLUE_BLINK, -1, -1 },
+    [BLUETOOTH_LED] = { "/sys/class/leds/bt/brightness", -1, -1, -1 },
+    [LCD]           = { "/sys/class/leds/lcd-backlight/brightness", -1, -1, -1 },
+    [BUTTON]        = { "/sys/class/leds/button-backlight/brightness", -1, -1, -1 },
+    [RED_BLINK]     = { "/sys/class/leds/red/blink", RED_LED, -1, -1 },
+    [GREEN_BLINK]   = { "/sys/class/leds/green/blink", GREEN_LED, -1, -1 },
+    [BLUE_BLINK]    = { "/sys/class/leds/blue/blink", BLUE_LED, -1, -1 },
+};
 
-char const*const BLUETOOTH_LED_FILE
-        = "/sys/class/leds/bt/brightness";
+/**
+ * device methods
+ */
 
-char const*const LCD_FILE
-        = "/sys/class/leds/lcd-backlight/brightness";
+static int64_t
+now_ns(void)
+{
+    struct timespec ts;
 
-char const*const BUTTON_FILE
-        = "/sys/class/leds/button-backlight/brightness";
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-char const*const RED_BLINK_FILE
-        = "/sys/class/leds/red/blink";
+static void
+account_call_locked(int64_t start_ns)
+{
+    int64_t latency = now_ns() - start_ns;
+
+    g_stats.calls++;
+    g_stats.latency_sum_ns += latency;
+    if (latency > g_stats.latency_max_ns)
+        g_stats.latency_max_ns = latency;
+
+    if (g_stats_enabled && (g_stats.calls % STATS_INTERVAL) == 0) {
+        ALOGI("calls:%lld writes:%lld syscalls:%lld avoided:%lld "
+                "latency avg:%lldns max:%lldns\n",
+                (long long)g_stats.calls, (long long)g_stats.writes,
+                (long long)g_stats.syscalls,
+                (long long)g_stats.syscalls_avoided,
+                (long long)(g_stats.latency_sum_ns / g_stats.calls),
+                (long long)g_stats.latency_max_ns);
+    }
+}
 
-char const*const GREEN_BLINK_FILE
-        = "/sys/class/leds/green/blink";
+static int
+write_int(int node, int value)
+{
+    struct led_node *led = &g_nodes[node];
+    static int already_warned = 0;
+    char buffer[20];
+    int bytes;
+    ssize_t amt;
+
+    g_stats.writes++;
+    if (led->value == value) {
+        /* open, write and close of the old implementation */
+        g_stats.syscalls_avoided += 3;
+        return 0;
+    }
 
-char const*const BLUE_BLINK_FILE
-        = "/sys/class/leds/blue/blink";
+    if (led->fd < 0) {
+        led->fd = open(led->path, O_RDWR);
+        g_stats.syscalls++;
+        if (led->fd < 0) {
+            if (already_warned == 0) {
+                ALOGE("write_int failed to open %s\n", led->path);
+                already_warned = 1;
+            }
+            return -errno;
+        }
+    } else {
+        g_stats.syscalls_avoided += 2;
+    }
 
-/**
- * device methods
- */
+    if (led->pair >= 0)
+        g_nodes[led->pair].value = -1;
 
-void init_globals(void)
+    bytes = snprintf(buffer, sizeof(buffer), "%d\n", value);
+    amt = pwrite(led->fd, buffer, (size_t)bytes, 0);
+    g_stats.syscalls++;
+    if (amt == -1) {
+        led->value = -1;
+        return -errno;
+    }
+
+    led->value = value;
+    return 0;
+}
+
+static void
+ramp_arm_locked(int enable)
 {
-    // init the mutex
-    pthread_mutex_init(&g_lock, NULL);
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    if (enable) {
+        spec.it_value.tv_nsec = RAMP_PERIOD_MS * 1000000L;
+        spec.it_interval.tv_nsec = RAMP_PERIOD_MS * 1000000L;
+        g_ramp_last_ns = now_ns();
+    }
+
+    if (timerfd_settime(g_ramp_fd, 0, &spec, NULL))
+        ALOGE("failed to arm backlight ramp timer: %s\n", strerror(errno));
+    g_ramp_active = enable;
 }
 
-static int
-write_int(char const* path, int value)
+static void
+ramp_step_locked(void)
 {
-    int fd;
-    static int already_warned = 0;
+    int64_t now = now_ns();
+    int step = (int)(g_ramp_rate * (now - g_ramp_last_ns) / 1000000000LL);
 
-    fd = open(path, O_RDWR);
-    if (fd >= 0) {
-        char buffer[20];
-        int bytes = snprintf(buffer, sizeof(buffer), "%d\n", value);
-        ssize_t amt = write(fd, buffer, (size_t)bytes);
-        close(fd);
-        return amt == -1 ? -errno : 0;
+    if (step < 1)
+        step = 1;
+    g_ramp_last_ns = now;
+
+    if (g_backlight_current < g_backlight_target) {
+        g_backlight_current += step;
+        if (g_backlight_current > g_backlight_target)
+            g_backlight_current = g_backlight_target;
     } else {
-        if (already_warned == 0) {
-            ALOGE("write_int failed to open %s\n", path);
-            already_warned = 1;
+        g_backlight_current -= step;
+        if (g_backlight_current < g_backlight_target)
+            g_backlight_current = g_backlight_target;
+    }
+
+    write_int(LCD, g_backlight_current);
+    if (g_backlight_current == g_backlight_target)
+        ramp_arm_locked(0);
+}
+
+static void *
+ramp_thread(void *arg)
+{
+    uint64_t expirations;
+
+    (void)arg;
+    for (;;) {
+        if (read(g_ramp_fd, &expirations, sizeof(expirations)) < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("backlight ramp timer read failed: %s\n", strerror(errno));
+            break;
         }
-        return -errno;
+
+        pthread_mutex_lock(&g_lock);
+        if (g_ramp_active)
+            ramp_step_locked();
+        pthread_mutex_unlock(&g_lock);
     }
+
+    return NULL;
+}
+
+void init_globals(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+    pthread_t thread;
+
+    // init the mutex
+    pthread_mutex_init(&g_lock, NULL);
+
+    property_get("debug.lights.stats", value, "0");
+    g_stats_enabled = atoi(value) == 1;
+
+    property_get("persist.lights.ramp_rate", value, "0");
+    g_ramp_rate = atoi(value);
+    if (g_ramp_rate <= 0)
+        return;
+
+    g_ramp_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (g_ramp_fd < 0) {
+        ALOGE("failed to create backlight ramp timer: %s\n", strerror(errno));
+        return;
+    }
+
+    if (pthread_create(&thread, NULL, ramp_thread, NULL)) {
+        ALOGE("failed to start backlight ramp thread\n");
+        close(g_ramp_fd);
+        g_ramp_fd = -1;
+        return;
+    }
+    pthread_detach(thread);
 }
 
 static int
@@ -119,11 +299,23 @@ set_light_backlight(struct light_device_t* dev,
 {
     int err = 0;
     int brightness = rgb_to_brightness(state);
+    int64_t start = now_ns();
     if(!dev) {
         return -1;
     }
     pthread_mutex_lock(&g_lock);
-    err = write_int(LCD_FILE, brightness);
+    /* Screen on and off are applied at once, other changes are ramped */
+    if (g_ramp_fd >= 0 && brightness && g_backlight_current) {
+        g_backlight_target = brightness;
+        if (!g_ramp_active && g_backlight_target != g_backlight_current)
+            ramp_arm_locked(1);
+    } else {
+        if (g_ramp_active)
+            ramp_arm_locked(0);
+        err = write_int(LCD, brightness);
+        g_backlight_current = g_backlight_target = brightness;
+    }
+    account_call_locked(start);
     pthread_mutex_unlock(&g_lock);
     return err;
 }
@@ -172,21 +364,21 @@ set_speaker_light_locked(struct light_device_t* dev,
 
     if (blink) {
         if (red) {
-            if (write_int(RED_BLINK_FILE, blink))
-                write_int(RED_LED_FILE, 0);
+            if (write_int(RED_BLINK, blink))
+                write_int(RED_LED, 0);
 	}
         if (green) {
-            if (write_int(GREEN_BLINK_FILE, blink))
-                write_int(GREEN_LED_FILE, 0);
+            if (write_int(GREEN_BLINK, blink))
+                write_int(GREEN_LED, 0);
 	}
         if (blue) {
-            if (write_int(BLUE_BLINK_FILE, blink))
-                write_int(BLUE_LED_FILE, 0);
+            if (write_int(BLUE_BLINK, blink))
+                write_int(BLUE_LED, 0);
 	}
     } else {
-        write_int(RED_LED_FILE, red);
-        write_int(GREEN_LED_FILE, green);
-        write_int(BLUE_LED_FILE, blue);
+        write_int(RED_LED, red);
+        write_int(GREEN_LED, green);
+        write_int(BLUE_LED, blue);
     }
 
     return 0;
@@ -206,9 +398,12 @@ static int
 set_light_battery(struct light_device_t* dev,
         struct light_state_t const* state)
 {
+    int64_t start = now_ns();
+
     pthread_mutex_lock(&g_lock);
     g_battery = *state;
     handle_speaker_battery_locked(dev);
+    account_call_locked(start);
     pthread_mutex_unlock(&g_lock);
     return 0;
 }
@@ -217,9 +412,12 @@ static int
 set_light_notifications(struct light_device_t* dev,
         struct light_state_t const* state)
 {
+    int64_t start = now_ns();
+
     pthread_mutex_lock(&g_lock);
     g_notification = *state;
     handle_speaker_battery_locked(dev);
+    account_call_locked(start);
     pthread_mutex_unlock(&g_lock);
     return 0;
 }
@@ -228,6 +426,8 @@ static int
 set_light_attention(struct light_device_t* dev,
         struct light_state_t const* state)
 {
+    int64_t start = now_ns();
+
     pthread_mutex_lock(&g_lock);
     if (state->flashMode == LIGHT_FLASH_HARDWARE) {
         g_attention = state->flashOnMS;
@@ -235,6 +435,7 @@ set_light_attention(struct light_device_t* dev,
         g_attention = 0;
     }
     handle_speaker_battery_locked(dev);
+    account_call_locked(start);
     pthread_mutex_unlock(&g_lock);
     return 0;
 }
@@ -244,11 +445,13 @@ set_light_buttons(struct light_device_t* dev,
         struct light_state_t const* state)
 {
     int err = 0;
+    int64_t start = now_ns();
     if(!dev) {
         return -1;
     }
     pthread_mutex_lock(&g_lock);
-    err = write_int(BUTTON_FILE, state->color & 0xFF);
+    err = write_int(BUTTON, state->color & 0xFF);
+    account_call_locked(start);
     pthread_mutex_unlock(&g_lock);
     return err;
 }
@@ -258,11 +461,13 @@ set_light_bluetooth(struct light_device_t* dev,
         struct light_state_t const* state)
 {
     int err = 0;
+    int64_t start = now_ns();
     if(!dev) {
         return -1;
     }
     pthread_mutex_lock(&g_lock);
-    err = write_int(BLUETOOTH_LED_FILE, state->color & 0xFF);
+    err = write_int(BLUETOOTH_LED, state->color & 0xFF);
+    account_call_locked(start);
     pthread_mutex_unlock(&g_lock);
     return err;
 }
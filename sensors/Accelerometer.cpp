@@ -136,27 +136,20 @@ int AccelSensor::enable(int32_t, int en) {
 	}
 
 	if (flags != mEnabled) {
-		int fd;
-		strlcpy(&input_sysfs_path[input_sysfs_path_len],
-				SYSFS_ENABLE, SYSFS_MAXLEN);
-		fd = open(input_sysfs_path, O_RDWR);
-		if (fd >= 0) {
-			char buf[2];
-			int err;
-			buf[1] = 0;
-			if (flags) {
-				buf[0] = '1';
-				mEnabledTime = getTimestamp() + IGNORE_EVENT_TIME;
-			} else {
-				buf[0] = '0';
-			}
-			err = write(fd, buf, sizeof(buf));
-			close(fd);
-			mEnabled = flags;
-			return 0;
+		char buf[2];
+		buf[1] = 0;
+		if (flags) {
+			buf[0] = '1';
+			mEnabledTime = getTimestamp() + IGNORE_EVENT_TIME;
+		} else {
+			buf[0] = '0';
 		}
-		ALOGE("AccelSensor: failed to open %s", input_sysfs_path);
-		return -1;
+		if (writeControl(CONTROL_ENABLE, buf, sizeof(buf))) {
+			ALOGE("AccelSensor: failed to write %s", input_sysfs_path);
+			return -1;
+		}
+		mEnabled = flags;
+		return 0;
 	}
 	return 0;
 }
@@ -167,7 +160,7 @@ bool AccelSensor::hasPendingEvents() const {
 
 int AccelSensor::setDelay(int32_t, int64_t delay_ns)
 {
-	int fd;
+	char buf[80];
 	char propBuf[PROPERTY_VALUE_MAX];
 	property_get("sensors.accel.loopback", propBuf, "0");
 	if (strcmp(propBuf, "1") == 0) {
@@ -175,17 +168,8 @@ int AccelSensor::setDelay(int32_t, int64_t delay_ns)
 		return 0;
 	}
 	int delay_ms = delay_ns / 1000000;
-	strlcpy(&input_sysfs_path[input_sysfs_path_len],
-			SYSFS_POLL_DELAY, SYSFS_MAXLEN);
-	fd = open(input_sysfs_path, O_RDWR);
-	if (fd >= 0) {
-		char buf[80];
-		snprintf(buf, sizeof(buf), "%d", delay_ms);
-		write(fd, buf, strlen(buf)+1);
-		close(fd);
-		return 0;
-	}
-	return -1;
+	snprintf(buf, sizeof(buf), "%d", delay_ms);
+	return writeControl(CONTROL_POLL_DELAY, buf, strlen(buf)+1);
 }
 
 int AccelSensor::readEvents(sensors_event_t* data, int count)
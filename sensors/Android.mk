@@ -33,7 +33,8 @@ endif
 LOCAL_C_INCLUDES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include
 LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
 
-LOCAL_SRC_FILES :=	\
+# Also built into sensors_replay
+sensors_hal_src :=	\
 		sensors.cpp 			\
 		SensorBase.cpp			\
 		LightSensor.cpp			\
@@ -45,14 +46,20 @@ LOCAL_SRC_FILES :=	\
 		InputEventReader.cpp \
 		CalibrationManager.cpp \
 		NativeSensorManager.cpp \
+		CalibrationStore.cpp \
 		VirtualSensor.cpp	\
+		FrameAligner.cpp	\
 		sensors_XML.cpp
 
+LOCAL_SRC_FILES := $(sensors_hal_src)
+
 LOCAL_C_INCLUDES += external/libxml2/include	\
 		    external/icu/icu4c/source/common
 
 LOCAL_SHARED_LIBRARIES := liblog libcutils libdl libxml2 libutils
 
+sensors_hal_cflags := $(filter -DTARGET_%,$(LOCAL_CFLAGS))
+
 include $(BUILD_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
@@ -98,5 +105,91 @@ LOCAL_SRC_FILES := calmodule.cfg
 
 include $(BUILD_PREBUILT)
 
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_record
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := tools/sensors_record.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)
+LOCAL_SHARED_LIBRARIES := libcutils
+
+include $(BUILD_EXECUTABLE)
+
+# The replay tool carries its own copy of the HAL built with SENSORS_REPLAY,
+# so the HAL module installed on the device never reads SENSORS_REPLAY_DIR.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_replay
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(sensors_hal_cflags) -DLOG_TAG=\"Sensors\" -DSENSORS_REPLAY
+LOCAL_SRC_FILES := tools/sensors_replay.cpp $(sensors_hal_src)
+LOCAL_C_INCLUDES := $(LOCAL_PATH) \
+		    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+		    external/libxml2/include \
+		    external/icu/icu4c/source/common
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SHARED_LIBRARIES := liblog libcutils libdl libxml2 libutils
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_light_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(sensors_hal_cflags) -DLOG_TAG=\"Sensors\"
+LOCAL_SRC_FILES := tools/sensors_light_bench.cpp $(sensors_hal_src)
+LOCAL_C_INCLUDES := $(LOCAL_PATH) \
+		    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+		    external/libxml2/include \
+		    external/icu/icu4c/source/common
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SHARED_LIBRARIES := liblog libcutils libdl libxml2 libutils
+
+include $(BUILD_EXECUTABLE)
+
+# Host builds replay logs pulled from a device without one. host/ holds the
+# stubs for what the host toolchain lacks next to the Android headers, plus a
+# Makefile and stand-in headers for building the tools outside the tree.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_record
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -include $(LOCAL_PATH)/tools/host/sensors_host.h
+LOCAL_SRC_FILES := tools/sensors_record.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)
+LOCAL_STATIC_LIBRARIES := libcutils
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_replay
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(sensors_hal_cflags) -DLOG_TAG=\"Sensors\" -DSENSORS_REPLAY \
+		-include $(LOCAL_PATH)/tools/host/sensors_host.h
+LOCAL_SRC_FILES := tools/sensors_replay.cpp $(sensors_hal_src)
+LOCAL_C_INCLUDES := $(LOCAL_PATH) \
+		    external/libxml2/include \
+		    external/icu/icu4c/source/common
+LOCAL_STATIC_LIBRARIES := libxml2 libutils libcutils liblog
+LOCAL_LDLIBS := -ldl -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_light_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(sensors_hal_cflags) -DLOG_TAG=\"Sensors\" \
+		-include $(LOCAL_PATH)/tools/host/sensors_host.h
+LOCAL_SRC_FILES := tools/sensors_light_bench.cpp $(sensors_hal_src)
+LOCAL_C_INCLUDES := $(LOCAL_PATH) \
+		    external/libxml2/include \
+		    external/icu/icu4c/source/common
+LOCAL_STATIC_LIBRARIES := libxml2 libutils libcutils liblog
+LOCAL_LDLIBS := -ldl -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
 endif #BUILD_TINY_ANDROID
 endif #TARGET_BOARD_PLATFORM
@@ -121,27 +121,19 @@ int PressureSensor::setInitialState() {
 int PressureSensor::enable(int32_t, int en) {
 	int flags = en ? 1 : 0;
 	if (flags != mEnabled) {
-		int fd;
-		strlcpy(&input_sysfs_path[input_sysfs_path_len],
-				SYSFS_ENABLE, SYSFS_MAXLEN);
-		fd = open(input_sysfs_path, O_RDWR);
-		if (fd >= 0) {
-			char buf[2];
-			int err;
-			buf[1] = 0;
-			if (flags) {
-				buf[0] = '1';
-				mEnabledTime = getTimestamp() + IGNORE_EVENT_TIME;
-			} else {
-				buf[0] = '0';
-			}
-			err = write(fd, buf, sizeof(buf));
-			close(fd);
-			mEnabled = flags;
-			setInitialState();
-			return 0;
+		char buf[2];
+		buf[1] = 0;
+		if (flags) {
+			buf[0] = '1';
+			mEnabledTime = getTimestamp() + IGNORE_EVENT_TIME;
+		} else {
+			buf[0] = '0';
 		}
-		return -1;
+		if (writeControl(CONTROL_ENABLE, buf, sizeof(buf)))
+			return -1;
+		mEnabled = flags;
+		setInitialState();
+		return 0;
 	}
 	return 0;
 }
@@ -152,19 +144,10 @@ bool PressureSensor::hasPendingEvents() const {
 
 int PressureSensor::setDelay(int32_t, int64_t delay_ns)
 {
-	int fd;
+	char buf[80];
 	int delay_ms = delay_ns / 1000000;
-	strlcpy(&input_sysfs_path[input_sysfs_path_len],
-			SYSFS_POLL_DELAY, SYSFS_MAXLEN);
-	fd = open(input_sysfs_path, O_RDWR);
-	if (fd >= 0) {
-		char buf[80];
-		snprintf(buf, sizeof(buf), "%d", delay_ms);
-		write(fd, buf, strlen(buf)+1);
-		close(fd);
-		return 0;
-	}
-	return -1;
+	snprintf(buf, sizeof(buf), "%d", delay_ms);
+	return writeControl(CONTROL_POLL_DELAY, buf, strlen(buf)+1);
 }
 
 int PressureSensor::readEvents(sensors_event_t* data, int count)
@@ -64,9 +64,24 @@ void CalibrationManager::loadCalLibs()
 	char buf[MAX_CAL_CFG_LEN];
 	char* cal_libs[MAX_CAL_LIBS];
 	struct sensor_cal_module_t* modules[MAX_CAL_LIBS];
+	const char *cfg_path = CAL_LIB_CFG_PATH;
+	const char *lib_path = CAL_LIB_PATH;
 	int i = 0;
 	int count;
 	int tmp;
+#ifdef SENSORS_REPLAY
+	char replay_cfg[PATH_MAX];
+	char replay_lib[PATH_MAX];
+	const char *replay_dir = getenv(SENSORS_REPLAY_ENV);
+
+	/* Host builds pick the config and the libraries from replay_dir */
+	if (replay_dir != NULL) {
+		snprintf(replay_cfg, sizeof(replay_cfg), "%s/calmodule.cfg", replay_dir);
+		snprintf(replay_lib, sizeof(replay_lib), "%s/", replay_dir);
+		cfg_path = replay_cfg;
+		lib_path = replay_lib;
+	}
+#endif
 
 	algo_count = 0;
 	algo_list = NULL;
@@ -75,16 +90,18 @@ void CalibrationManager::loadCalLibs()
 	cal_libs[1] = NULL;
 	count = 1;
 
-	fd = open(CAL_LIB_CFG_PATH, O_RDONLY);
+	fd = open(cfg_path, O_RDONLY);
 	if (fd < 0) {
 		ALOGE("Open %s failed.(%s)\nDrop to default calibration library.",
-				CAL_LIB_CFG_PATH, strerror(errno));
+				cfg_path, strerror(errno));
 	} else {
 		len = read(fd, buf, MAX_CAL_CFG_LEN);
 		if (len > 0) {
 			char *save_ptr, *str, *token;
 
 			buf[len] = '\0';
+			/* The config replaces the default library */
+			free(cal_libs[0]);
 			for(str = buf; ;str = NULL) {
 				token = strtok_r(str, "\n", &save_ptr);
 				if (token == NULL)
@@ -102,7 +119,7 @@ void CalibrationManager::loadCalLibs()
 		char path[PATH_MAX];
 
 		ALOGI("Found calibration library:%s\n", cal_libs[i]);
-		strlcpy(path, CAL_LIB_PATH, sizeof(path));
+		strlcpy(path, lib_path, sizeof(path));
 		strlcat(path, cal_libs[i], sizeof(path));
 		if (access(path, F_OK) != 0) {
 			ALOGE("module %s doesn't exist(%s)", cal_libs[i], strerror(errno));
@@ -0,0 +1,297 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <utils/Log.h>
+#include "CalibrationStore.h"
+#include "sensors_XML.h"
+
+ANDROID_SINGLETON_STATIC_INSTANCE(CalibrationStore);
+
+CalibrationStore::CalibrationStore()
+	: mMap(NULL)
+{
+}
+
+CalibrationStore::~CalibrationStore()
+{
+	unmap();
+}
+
+uint32_t CalibrationStore::hashName(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+uint32_t CalibrationStore::checksum(const struct cal_store_header *hdr)
+{
+	const uint32_t *p = (const uint32_t *)hdr->entry;
+	const uint32_t *end = (const uint32_t *)&hdr->entry[hdr->count];
+	uint32_t sum = hdr->count;
+
+	while (p < end)
+		sum = (sum << 1 | sum >> 31) + *p++;
+
+	return sum;
+}
+
+/* Map the store file read only. Return 0 on success */
+int CalibrationStore::map()
+{
+	struct stat st;
+	const struct cal_store_header *hdr;
+	int fd;
+
+	if (mMap != NULL)
+		return 0;
+
+	fd = open(CAL_STORE_PATH, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) || (st.st_size != sizeof(struct cal_store_header))) {
+		ALOGE("%s has invalid size\n", CAL_STORE_PATH);
+		close(fd);
+		return -EINVAL;
+	}
+
+	hdr = (const struct cal_store_header *)mmap(NULL, sizeof(*hdr),
+			PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED) {
+		ALOGE("mmap %s failed.(%s)\n", CAL_STORE_PATH, strerror(errno));
+		return -errno;
+	}
+
+	if ((hdr->magic != CAL_STORE_MAGIC) || (hdr->version != CAL_STORE_VERSION) ||
+			(hdr->count > MAX_SENSORS) || (hdr->checksum != checksum(hdr))) {
+		ALOGE("%s is corrupted\n", CAL_STORE_PATH);
+		munmap((void *)hdr, sizeof(*hdr));
+		return -EINVAL;
+	}
+
+	mMap = hdr;
+	return 0;
+}
+
+void CalibrationStore::unmap()
+{
+	if (mMap != NULL) {
+		munmap((void *)mMap, sizeof(*mMap));
+		mMap = NULL;
+	}
+}
+
+const struct cal_store_entry* CalibrationStore::find(const struct cal_store_header *hdr,
+		const struct sensor_t *sensor)
+{
+	uint32_t hash = hashName(sensor->name);
+	uint32_t i;
+
+	for (i = 0; i < hdr->count; i++) {
+		if ((hdr->entry[i].hash == hash) && (hdr->entry[i].type == sensor->type))
+			return &hdr->entry[i];
+	}
+
+	return NULL;
+}
+
+/* Replace the store file with hdr atomically */
+int CalibrationStore::commit(const struct cal_store_header *hdr)
+{
+	int fd;
+	ssize_t len;
+
+	fd = open(CAL_STORE_TMP_PATH, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+	if (fd < 0) {
+		ALOGE("open %s failed.(%s)\n", CAL_STORE_TMP_PATH, strerror(errno));
+		return -1;
+	}
+
+	len = ::write(fd, hdr, sizeof(*hdr));
+	if ((len != sizeof(*hdr)) || fsync(fd)) {
+		ALOGE("write %s failed.(%s)\n", CAL_STORE_TMP_PATH, strerror(errno));
+		close(fd);
+		unlink(CAL_STORE_TMP_PATH);
+		return -1;
+	}
+	close(fd);
+
+	unmap();
+	if (rename(CAL_STORE_TMP_PATH, CAL_STORE_PATH)) {
+		ALOGE("rename %s failed.(%s)\n", CAL_STORE_TMP_PATH, strerror(errno));
+		unlink(CAL_STORE_TMP_PATH);
+		return -1;
+	}
+
+	/* Make the rename itself durable */
+	fd = open(CAL_STORE_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		ALOGE("open %s failed.(%s)\n", CAL_STORE_DIR, strerror(errno));
+		return -1;
+	}
+	if (fsync(fd)) {
+		ALOGE("fsync %s failed.(%s)\n", CAL_STORE_DIR, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	close(fd);
+
+	return 0;
+}
+
+int CalibrationStore::read(const struct sensor_t *sensor, struct cal_result_t *cal_result)
+{
+	const struct cal_store_entry *entry;
+	int err;
+
+	if ((sensor == NULL) || (cal_result == NULL)) {
+		ALOGE("Null pointer parameter\n");
+		return -EINVAL;
+	}
+
+	err = map();
+	if (err)
+		return err;
+
+	entry = find(mMap, sensor);
+	if (entry == NULL)
+		return -ENOENT;
+
+	memcpy(cal_result->offset, entry->offset, sizeof(cal_result->offset));
+	cal_result->factor = entry->factor;
+	cal_result->range = entry->range;
+
+	return 0;
+}
+
+int CalibrationStore::write(const struct sensor_t *sensor, const struct cal_result_t *cal_result)
+{
+	struct cal_store_header hdr;
+	struct cal_store_entry *entry;
+
+	if ((sensor == NULL) || (cal_result == NULL)) {
+		ALOGE("Null pointer parameter\n");
+		return -EINVAL;
+	}
+
+	if (map() == 0) {
+		hdr = *mMap;
+	} else {
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.magic = CAL_STORE_MAGIC;
+		hdr.version = CAL_STORE_VERSION;
+	}
+
+	entry = (struct cal_store_entry *)find(&hdr, sensor);
+	if (entry == NULL) {
+		if (hdr.count >= MAX_SENSORS) {
+			ALOGE("calibration store is full\n");
+			return -ENOSPC;
+		}
+		entry = &hdr.entry[hdr.count++];
+		memset(entry, 0, sizeof(*entry));
+		entry->hash = hashName(sensor->name);
+		entry->type = sensor->type;
+	}
+
+	memcpy(entry->offset, cal_result->offset, sizeof(entry->offset));
+	entry->factor = cal_result->factor;
+	entry->range = cal_result->range;
+	hdr.checksum = checksum(&hdr);
+
+	return commit(&hdr);
+}
+
+int CalibrationStore::importXML(const struct sensor_t *list, int count)
+{
+	sensors_XML& sensor_XML(sensors_XML :: getInstance());
+	struct cal_store_header hdr;
+	struct cal_result_t cal_result;
+	struct cal_store_entry *entry;
+	struct stat xml_st, store_st;
+	int i;
+
+	if (stat(CAL_STORE_PATH, &store_st) == 0) {
+		/* The factory tools may still update the XML file directly. Pick
+		 * it up again when it is newer than the store. */
+		if (stat(CAL_XML_PATH, &xml_st) || (xml_st.st_mtime <= store_st.st_mtime))
+			return 0;
+		ALOGI("%s is newer than %s, importing\n", CAL_XML_PATH, CAL_STORE_PATH);
+		/* Drop the cached copy so the updated file is parsed */
+		sensor_XML.sensors_rm_file();
+	}
+
+	if (map() == 0) {
+		hdr = *mMap;
+	} else {
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.magic = CAL_STORE_MAGIC;
+		hdr.version = CAL_STORE_VERSION;
+	}
+
+	for (i = 0; i < count; i++) {
+		memset(&cal_result, 0, sizeof(cal_result));
+		if (sensor_XML.read_sensors_params((struct sensor_t *)&list[i], &cal_result))
+			continue;
+
+		entry = (struct cal_store_entry *)find(&hdr, &list[i]);
+		if (entry == NULL) {
+			if (hdr.count >= MAX_SENSORS)
+				break;
+			entry = &hdr.entry[hdr.count++];
+			memset(entry, 0, sizeof(*entry));
+			entry->hash = hashName(list[i].name);
+			entry->type = list[i].type;
+		}
+		memcpy(entry->offset, cal_result.offset, sizeof(entry->offset));
+		entry->factor = cal_result.factor;
+		entry->range = cal_result.range;
+		ALOGI("Imported calibration parameters of %s\n", list[i].name);
+	}
+	hdr.checksum = checksum(&hdr);
+
+	/* Create the store even if nothing was imported so the XML file is only
+	 * parsed again once it changes. */
+	return commit(&hdr);
+}
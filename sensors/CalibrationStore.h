@@ -0,0 +1,92 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef SENSOR_CALIBRATION_STORE_H
+#define SENSOR_CALIBRATION_STORE_H
+
+#include <stdint.h>
+#include <utils/Singleton.h>
+#include <hardware/sensors.h>
+#include <sensors_extension.h>
+#include "sensors.h"
+
+using namespace android;
+
+#define CAL_STORE_DIR		"/persist"
+#define CAL_STORE_PATH		"/persist/sensors_calibration_params.bin"
+#define CAL_STORE_TMP_PATH	"/persist/sensors_calibration_params.bin.tmp"
+/* The legacy file written by sensors_XML */
+#define CAL_XML_PATH		"/persist/sensors_calibration_params.xml"
+#define CAL_STORE_MAGIC		0x4c414353 /* "SCAL" */
+#define CAL_STORE_VERSION	1
+
+/* One calibration record. The layout is fixed and must only be changed
+ * together with CAL_STORE_VERSION. */
+struct cal_store_entry {
+	uint32_t hash; // FNV-1a hash of the sensor name
+	int32_t type; // the sensor type, names may be shared between types
+	int32_t offset[3]; // cal_result_t offset/threshold/bias
+	int32_t factor; // cal_result_t factor
+	int32_t range; // cal_result_t range
+	uint32_t reserved;
+};
+
+struct cal_store_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count; // number of valid entries
+	uint32_t checksum; // sum of the entry words
+	struct cal_store_entry entry[MAX_SENSORS];
+};
+
+class CalibrationStore : public Singleton<CalibrationStore> {
+	friend class Singleton<CalibrationStore>;
+	CalibrationStore();
+	~CalibrationStore();
+
+	/* Point to the mapped store file, NULL if not mapped */
+	const struct cal_store_header *mMap;
+
+	static uint32_t hashName(const char *name);
+	static uint32_t checksum(const struct cal_store_header *hdr);
+	int map();
+	void unmap();
+	const struct cal_store_entry* find(const struct cal_store_header *hdr,
+			const struct sensor_t *sensor);
+	int commit(const struct cal_store_header *hdr);
+public:
+	/* Return 0 on success, -ENOENT if no record exists for the sensor */
+	int read(const struct sensor_t *sensor, struct cal_result_t *cal_result);
+	int write(const struct sensor_t *sensor, const struct cal_result_t *cal_result);
+	/* Convert the legacy XML calibration file. Only done if the store does not
+	 * exist or the XML file was modified after it. */
+	int importXML(const struct sensor_t *list, int count);
+};
+
+#endif
@@ -91,7 +91,7 @@ int CompassSensor::enable(int32_t, int en) {
 	arg.common.enable = flags;
 
 	if (flags != mEnabled) {
-		int fd;
+		char buf[2];
 
 		if ((algo != NULL) && (algo->methods->config != NULL)) {
 			if (algo->methods->config(CMD_ENABLE, (sensor_algo_args*)&arg)) {
@@ -99,26 +99,19 @@ int CompassSensor::enable(int32_t, int en) {
 			}
 		}
 
-		strlcpy(&input_sysfs_path[input_sysfs_path_len],
-				SYSFS_ENABLE, SYSFS_MAXLEN);
-		fd = open(input_sysfs_path, O_RDWR);
-		if (fd >= 0) {
-			char buf[2];
-			int err;
-			buf[1] = 0;
-			if (flags) {
-				buf[0] = '1';
-				mEnabledTime = getTimestamp() + IGNORE_EVENT_TIME;
-			} else {
-				buf[0] = '0';
-			}
-			err = write(fd, buf, sizeof(buf));
-			close(fd);
-			mEnabled = flags;
-			return 0;
+		buf[1] = 0;
+		if (flags) {
+			buf[0] = '1';
+			mEnabledTime = getTimestamp() + IGNORE_EVENT_TIME;
+		} else {
+			buf[0] = '0';
+		}
+		if (writeControl(CONTROL_ENABLE, buf, sizeof(buf))) {
+			ALOGE("CompassSensor: failed to write %s", input_sysfs_path);
+			return -1;
 		}
-		ALOGE("CompassSensor: failed to open %s", input_sysfs_path);
-		return -1;
+		mEnabled = flags;
+		return 0;
 	}
 	return 0;
 }
@@ -129,7 +122,7 @@ bool CompassSensor::hasPendingEvents() const {
 
 int CompassSensor::setDelay(int32_t, int64_t delay_ns)
 {
-	int fd;
+	char buf[80];
 	int delay_ms = delay_ns / 1000000;
 	compass_algo_args arg;
 	arg.common.delay_ms = delay_ms;
@@ -140,17 +133,8 @@ int CompassSensor::setDelay(int32_t, int64_t delay_ns)
 		}
 	}
 
-	strlcpy(&input_sysfs_path[input_sysfs_path_len],
-			SYSFS_POLL_DELAY, SYSFS_MAXLEN);
-	fd = open(input_sysfs_path, O_RDWR);
-	if (fd >= 0) {
-		char buf[80];
-		sprintf(buf, "%d", delay_ms);
-		write(fd, buf, strlen(buf)+1);
-		close(fd);
-		return 0;
-	}
-	return -1;
+	snprintf(buf, sizeof(buf), "%d", delay_ms);
+	return writeControl(CONTROL_POLL_DELAY, buf, strlen(buf)+1);
 }
 
 int CompassSensor::readEvents(sensors_event_t* data, int count)
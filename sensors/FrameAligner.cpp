@@ -0,0 +1,199 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <cutils/log.h>
+
+#include "FrameAligner.h"
+
+/*****************************************************************************/
+
+FrameAligner::FrameAligner()
+	: mStreamCount(0),
+	  mPeriod(0),
+	  mNextFrame(0)
+{
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+bool FrameAligner::canInterpolate(int32_t type)
+{
+	switch (type) {
+		case SENSOR_TYPE_ACCELEROMETER:
+		case SENSOR_TYPE_MAGNETIC_FIELD:
+		case SENSOR_TYPE_GYROSCOPE:
+			return true;
+		default:
+			return false;
+	}
+}
+
+int FrameAligner::addStream(int32_t type)
+{
+	if (mStreamCount >= ALIGN_MAX_STREAMS)
+		return -1;
+
+	memset(&mStreams[mStreamCount], 0, sizeof(Stream));
+	mStreams[mStreamCount].type = type;
+
+	return mStreamCount++;
+}
+
+void FrameAligner::reset()
+{
+	for (int i = 0; i < mStreamCount; i++) {
+		mStreams[i].head = 0;
+		mStreams[i].count = 0;
+		mStreams[i].interval_ns = 0;
+	}
+	mNextFrame = 0;
+}
+
+/* Return the i-th oldest sample of the stream */
+const sensors_event_t* FrameAligner::sample(const Stream *s, int i) const
+{
+	return &s->ring[(s->head - s->count + i + ALIGN_RING_SIZE) % ALIGN_RING_SIZE];
+}
+
+void FrameAligner::push(const sensors_event_t *event)
+{
+	Stream *s = NULL;
+
+	for (int i = 0; i < mStreamCount; i++) {
+		if (mStreams[i].type == event->type) {
+			s = &mStreams[i];
+			break;
+		}
+	}
+
+	if (s == NULL)
+		return;
+
+	if (s->count) {
+		const sensors_event_t *last = sample(s, s->count - 1);
+		int64_t dt = event->timestamp - last->timestamp;
+
+		/* Out of order samples can't be interpolated */
+		if (dt <= 0)
+			return;
+
+		if (s->interval_ns) {
+			int64_t jitter = dt > s->interval_ns ? dt - s->interval_ns : s->interval_ns - dt;
+			mStats.jitter_sum_ns += jitter;
+			if (jitter > mStats.jitter_max_ns)
+				mStats.jitter_max_ns = jitter;
+			mStats.samples++;
+			s->interval_ns += (dt - s->interval_ns) / 8;
+		} else {
+			s->interval_ns = dt;
+		}
+	}
+
+	s->ring[s->head] = *event;
+	s->head = (s->head + 1) % ALIGN_RING_SIZE;
+	if (s->count < ALIGN_RING_SIZE)
+		s->count++;
+}
+
+/* Compute the sample of the stream at time t. The stream must hold samples
+ * before and after t. */
+void FrameAligner::resample(const Stream *s, int64_t t, sensors_event_t *out)
+{
+	const sensors_event_t *a = sample(s, 0);
+	const sensors_event_t *b = a;
+	int64_t skew;
+	int i;
+
+	for (i = 1; i < s->count; i++) {
+		b = sample(s, i);
+		if (b->timestamp >= t)
+			break;
+		a = b;
+	}
+
+	skew = t - a->timestamp < b->timestamp - t ? t - a->timestamp : b->timestamp - t;
+	if (skew < 0)
+		skew = 0;
+	mStats.skew_sum_ns += skew;
+	if (skew > mStats.skew_max_ns)
+		mStats.skew_max_ns = skew;
+
+	if (canInterpolate(s->type) && (b->timestamp > a->timestamp)) {
+		float w = float(t - a->timestamp) / float(b->timestamp - a->timestamp);
+
+		*out = (w < 0.5f) ? *a : *b;
+		for (i = 0; i < 3; i++)
+			out->data[i] = a->data[i] + (b->data[i] - a->data[i]) * w;
+	} else {
+		/* Hold the last value */
+		*out = (b->timestamp <= t) ? *b : *a;
+	}
+	out->timestamp = t;
+}
+
+int FrameAligner::nextFrame(sensors_event_t *frame)
+{
+	int64_t oldest = 0;
+	int i;
+
+	if ((mStreamCount == 0) || (mPeriod <= 0))
+		return 0;
+
+	for (i = 0; i < mStreamCount; i++) {
+		const Stream *s = &mStreams[i];
+
+		if (s->count == 0)
+			return 0;
+		/* Wait for a sample at or after the frame time */
+		if (sample(s, s->count - 1)->timestamp < mNextFrame)
+			return 0;
+		if (sample(s, 0)->timestamp > oldest)
+			oldest = sample(s, 0)->timestamp;
+	}
+
+	/* A stream dropped the samples needed for this frame. Restart the frame
+	 * clock from the oldest time all streams can cover. */
+	if (mNextFrame < oldest) {
+		if (mNextFrame)
+			mStats.skipped += (oldest - mNextFrame + mPeriod - 1) / mPeriod;
+		mNextFrame = oldest;
+		for (i = 0; i < mStreamCount; i++) {
+			if (sample(&mStreams[i], mStreams[i].count - 1)->timestamp < mNextFrame)
+				return 0;
+		}
+	}
+
+	for (i = 0; i < mStreamCount; i++)
+		resample(&mStreams[i], mNextFrame, &frame[i]);
+
+	mStats.frames++;
+	mNextFrame += mPeriod;
+
+	return mStreamCount;
+}
@@ -0,0 +1,93 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef ANDROID_FRAME_ALIGNER_H
+#define ANDROID_FRAME_ALIGNER_H
+
+#include <stdint.h>
+#include <hardware/sensors.h>
+
+/*****************************************************************************/
+
+#define ALIGN_RING_SIZE		8
+#define ALIGN_MAX_STREAMS	4
+
+/* Statistics of the aligned frames. Skew is the distance between the frame
+ * time and the closest real sample of a stream. Jitter is the deviation of a
+ * stream's sample interval from its smoothed average. */
+struct AlignStats {
+	int64_t frames;
+	int64_t skipped; // frames dropped because a stream fell behind
+	int64_t skew_sum_ns;
+	int64_t skew_max_ns;
+	int64_t samples;
+	int64_t jitter_sum_ns;
+	int64_t jitter_max_ns;
+};
+
+/* Collect samples of several hardware sensors and produce frames holding one
+ * sample of each sensor at the same time. Frames are generated at a fixed
+ * period, samples are linearly interpolated to the frame time.
+ */
+class FrameAligner {
+	struct Stream {
+		int32_t type;
+		sensors_event_t ring[ALIGN_RING_SIZE];
+		int head; // index of the next sample to write
+		int count;
+		int64_t interval_ns; // smoothed sample interval
+	};
+
+	Stream mStreams[ALIGN_MAX_STREAMS];
+	int mStreamCount;
+	int64_t mPeriod;
+	int64_t mNextFrame;
+	AlignStats mStats;
+
+	const sensors_event_t* sample(const Stream *s, int i) const;
+	void resample(const Stream *s, int64_t t, sensors_event_t *out);
+public:
+	FrameAligner();
+	/* Return true if samples of this sensor type can be interpolated */
+	static bool canInterpolate(int32_t type);
+	/* Return the index of the stream, -1 on error */
+	int addStream(int32_t type);
+	int getStreamCount() const { return mStreamCount; }
+	void setPeriod(int64_t ns) { mPeriod = ns; }
+	void reset();
+	void push(const sensors_event_t *event);
+	/* Fill frame with one event per stream in the order the streams were
+	 * added. Return the number of events, 0 if no frame is ready. */
+	int nextFrame(sensors_event_t *frame);
+	const AlignStats& getStats() const { return mStats; }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_FRAME_ALIGNER_H
@@ -19,7 +19,9 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <math.h>
+#include <time.h>
 #include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/select.h>
@@ -30,6 +32,7 @@
 #include "LightSensor.h"
 
 #define EVENT_TYPE_LIGHT		ABS_MISC
+#define ADC_MAX				4095
 /*****************************************************************************/
 
 enum input_device_name {
@@ -60,13 +63,6 @@ static const char *input_sysfs_path_list[SUPPORTED_LSENSOR_COUNT] = {
 	[STK3x1x_LS] = "/sys/class/input/%s/device/",
 };
 
-static const char *input_sysfs_enable_list[SUPPORTED_LSENSOR_COUNT] = {
-	[GENERIC_LS] = "enable",
-	[LIGHTSENSOR_LEVEL] = "enable",
-	[CM36283_LS] = "enable",
-	[STK3x1x_LS] = "enable",
-};
-
 static const int input_report_type[SUPPORTED_LSENSOR_COUNT] = {
 	[GENERIC_LS] = TYPE_LUX,
 	[LIGHTSENSOR_LEVEL] = TYPE_ADC,
@@ -74,6 +70,21 @@ static const int input_report_type[SUPPORTED_LSENSOR_COUNT] = {
 	[STK3x1x_LS] = TYPE_LUX,
 };
 
+/* ADC to lux lookup table, built once by the first LightSensor */
+static float adc_lux_table[ADC_MAX + 1];
+static pthread_once_t adc_lux_table_once = PTHREAD_ONCE_INIT;
+
+static void buildLuxTable()
+{
+	// Convert adc value to lux assuming:
+	// I = 10 * log(Ev) uA
+	// R = 47kOhm
+	// Max adc value 4095 = 3.3V
+	// 1/4 of light reaches sensor
+	for (int i = 0; i <= ADC_MAX; i++)
+		adc_lux_table[i] = powf(10, i * (330.0f / 4095.0f / 47.0f)) * 4;
+}
+
 LightSensor::LightSensor()
 : SensorBase(NULL, NULL),
 	  mInputReader(4),
@@ -86,6 +97,7 @@ LightSensor::LightSensor()
 	mPendingEvent.sensor = SENSORS_LIGHT_HANDLE;
 	mPendingEvent.type = SENSOR_TYPE_LIGHT;
 	memset(mPendingEvent.data, 0, sizeof(mPendingEvent.data));
+	initFilter();
 
 	for(i = 0; i < SUPPORTED_LSENSOR_COUNT; i++) {
 		data_name = data_device_name[i];
@@ -118,6 +130,7 @@ LightSensor::LightSensor(char *name)
 	mPendingEvent.sensor = SENSORS_LIGHT_HANDLE;
 	mPendingEvent.type = SENSOR_TYPE_LIGHT;
 	memset(mPendingEvent.data, 0, sizeof(mPendingEvent.data));
+	initFilter();
 
 	if (data_fd > 0) {
 		strlcpy(input_sysfs_path, SYSFS_CLASS, sizeof(input_sysfs_path));
@@ -139,6 +152,7 @@ LightSensor::LightSensor(struct SensorContext *context)
 	mPendingEvent.sensor = context->sensor->handle;
 	mPendingEvent.type = SENSOR_TYPE_LIGHT;
 	memset(mPendingEvent.data, 0, sizeof(mPendingEvent.data));
+	initFilter();
 
 	data_fd = context->data_fd;
 	strlcpy(input_sysfs_path, context->enable_path, sizeof(input_sysfs_path));
@@ -146,6 +160,58 @@ LightSensor::LightSensor(struct SensorContext *context)
 	mUseAbsTimeStamp = false;
 }
 
+/* In on-change mode events whose lux value changed by no more than
+ * sensors.light.hysteresis percent of the last reported value are dropped.
+ * The mode is off if the property is 0 or not set.
+ * Setting sensors.light.profile to 1 accounts the thread CPU time spent
+ * in readEvents so the cost per sample can be read from the dump. */
+void LightSensor::initFilter()
+{
+	char propBuf[PROPERTY_VALUE_MAX];
+
+	pthread_once(&adc_lux_table_once, buildLuxTable);
+
+	property_get("sensors.light.hysteresis", propBuf, "0");
+	setHysteresis(atoi(propBuf));
+	mLastLux = 0;
+	mReported = 0;
+	mSuppressed = 0;
+
+	property_get("sensors.light.profile", propBuf, "0");
+	mProfile = atoi(propBuf) == 1;
+	mCpuTimeNs = 0;
+}
+
+static int64_t getThreadCpuNs()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void LightSensor::setHysteresis(int percent)
+{
+	mHysteresis = (percent > 0) ? percent : 0;
+	mHasReported = false;
+}
+
+float LightSensor::adcToLux(int value)
+{
+	if ((value >= 0) && (value <= ADC_MAX))
+		return adc_lux_table[value];
+
+	return powf(10, value * (330.0f / 4095.0f / 47.0f)) * 4;
+}
+
+bool LightSensor::isRedundant(float lux) const
+{
+	if (!mHysteresis || !mHasReported)
+		return false;
+
+	return fabsf(lux - mLastLux) <= mLastLux * mHysteresis / 100.0f;
+}
+
 LightSensor::~LightSensor() {
 	if (mEnabled) {
 		enable(0, 0);
@@ -154,7 +220,7 @@ LightSensor::~LightSensor() {
 
 int LightSensor::setDelay(int32_t, int64_t ns)
 {
-	int fd;
+	char buf[80];
 	char propBuf[PROPERTY_VALUE_MAX];
 	property_get("sensors.light.loopback", propBuf, "0");
 	if (strcmp(propBuf, "1") == 0) {
@@ -162,17 +228,8 @@ int LightSensor::setDelay(int32_t, int64_t ns)
 		return 0;
 	}
 	int delay_ms = ns / 1000000;
-	strlcpy(&input_sysfs_path[input_sysfs_path_len],
-			SYSFS_POLL_DELAY, SYSFS_MAXLEN);
-	fd = open(input_sysfs_path, O_RDWR);
-	if (fd >= 0) {
-		char buf[80];
-		snprintf(buf, sizeof(buf), "%d", delay_ms);
-		write(fd, buf, strlen(buf)+1);
-		close(fd);
-		return 0;
-	}
-	return -1;
+	snprintf(buf, sizeof(buf), "%d", delay_ms);
+	return writeControl(CONTROL_POLL_DELAY, buf, strlen(buf)+1);
 }
 
 int LightSensor::enable(int32_t, int en)
@@ -186,33 +243,23 @@ int LightSensor::enable(int32_t, int en)
 		return 0;
 	}
 	if (flags != mEnabled) {
-		int fd;
-		if (sensor_index >= 0) {
-			strlcpy(&input_sysfs_path[input_sysfs_path_len],
-				input_sysfs_enable_list[sensor_index], sizeof(input_sysfs_path) - input_sysfs_path_len);
-		}
-		else {
+		char buf[2];
+		if (sensor_index < 0) {
 			ALOGE("invalid sensor index:%d\n", sensor_index);
 			return -1;
 		}
-		fd = open(input_sysfs_path, O_RDWR);
-		if (fd >= 0) {
-			char buf[2];
-			int err;
-			buf[1] = 0;
-			if (flags) {
-				buf[0] = '1';
-			} else {
-				buf[0] = '0';
-			}
-			err = write(fd, buf, sizeof(buf));
-			close(fd);
-			mEnabled = flags;
-			return 0;
+		buf[1] = 0;
+		if (flags) {
+			buf[0] = '1';
 		} else {
-			ALOGE("open %s failed.(%s)\n", input_sysfs_path, strerror(errno));
-			return -1;
+			buf[0] = '0';
 		}
+		if (writeControl(CONTROL_ENABLE, buf, sizeof(buf)))
+			return -1;
+		mEnabled = flags;
+		/* Always report the first sample after enable */
+		mHasReported = false;
+		return 0;
 	} else if (flags) { /* already enabled */
 		mHasPendingEvent = true;
 	}
@@ -232,6 +279,11 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
 		mHasPendingEvent = false;
 		mPendingEvent.timestamp = getTimestamp();
 		*data = mPendingEvent;
+		if (mEnabled) {
+			mLastLux = mPendingEvent.light;
+			mHasReported = true;
+			mReported++;
+		}
 		return mEnabled ? 1 : 0;
 	}
 
@@ -242,6 +294,8 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
 		return mEnabled ? 1 : 0;
 	}
 
+	int64_t start = mProfile ? getThreadCpuNs() : 0;
+
 	ssize_t n = mInputReader.fill(data_fd);
 	if (n < 0)
 		return n;
@@ -270,9 +324,16 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
 						mPendingEvent.timestamp = timevalToNano(event->time);
 					}
 					if (mEnabled) {
+						if (isRedundant(mPendingEvent.light)) {
+							mSuppressed++;
+							break;
+						}
 						*data++ = mPendingEvent;
 						count--;
 						numEventReceived++;
+						mLastLux = mPendingEvent.light;
+						mHasReported = true;
+						mReported++;
 					}
 					break;
 			}
@@ -283,6 +344,9 @@ int LightSensor::readEvents(sensors_event_t* data, int count)
 		mInputReader.next();
 	}
 
+	if (mProfile)
+		mCpuTimeNs += getThreadCpuNs() - start;
+
 	return numEventReceived;
 }
 
@@ -292,12 +356,7 @@ float LightSensor::convertEvent(int value)
 
 	if (sensor_index >= 0) {
 		if (input_report_type[sensor_index] == TYPE_ADC) {
-			// Convert adc value to lux assuming:
-			// I = 10 * log(Ev) uA
-			// R = 47kOhm
-			// Max adc value 4095 = 3.3V
-			// 1/4 of light reaches sensor
-			lux =  powf(10, value * (330.0f / 4095.0f / 47.0f)) * 4;
+			lux = adcToLux(value);
 		} else if (input_report_type[sensor_index] == TYPE_LUX) {
 			lux = value;
 		} else {
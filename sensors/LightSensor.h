@@ -35,8 +35,17 @@ class LightSensor : public SensorBase {
 	sensors_event_t mPendingEvent;
 	bool mHasPendingEvent;
 	int sensor_index;
+	int mHysteresis; // relative change in percent needed to report
+	bool mHasReported;
+	float mLastLux;
+	int64_t mReported;
+	int64_t mSuppressed;
+	bool mProfile;
+	int64_t mCpuTimeNs;
 
 	int setInitialState();
+	void initFilter();
+	bool isRedundant(float lux) const;
 
 public:
 	LightSensor();
@@ -48,6 +57,13 @@ public:
 	virtual int setDelay(int32_t handle, int64_t ns);
 	virtual int enable(int32_t handle, int enabled);
 	virtual float convertEvent(int value);
+	/* Relative change in percent needed to report, 0 reports every sample */
+	void setHysteresis(int percent);
+	/* ADC sample to lux. The table is built by the LightSensor constructors. */
+	static float adcToLux(int value);
+	int64_t getReportedEvents() const { return mReported; }
+	int64_t getSuppressedEvents() const { return mSuppressed; }
+	int64_t getCpuTimeNs() const { return mCpuTimeNs; }
 };
 
 /*****************************************************************************/
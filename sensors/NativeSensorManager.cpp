@@ -26,10 +26,19 @@ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
 OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
 IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 --------------------------------------------------------------------------*/
+#include <time.h>
 #include "NativeSensorManager.h"
 
 ANDROID_SINGLETON_STATIC_INSTANCE(NativeSensorManager);
 
+static int64_t getMonotonicNs()
+{
+	struct timespec t;
+	t.tv_sec = t.tv_nsec = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
 enum {
 	ORIENTATION = 0,
 	PSEUDO_GYROSCOPE,
@@ -250,9 +259,10 @@ const struct SysfsMap NativeSensorManager::node_map[] = {
 };
 
 NativeSensorManager::NativeSensorManager():
-	mSensorCount(0), type_map(NULL), handle_map(NULL), fd_map(NULL)
+	mSensorCount(0), mCalibrateTime(0), type_map(NULL), handle_map(NULL), fd_map(NULL)
 {
 	int i;
+	int64_t start = getMonotonicNs();
 
 	memset(sensor_list, 0, sizeof(sensor_list));
 	memset(context, 0, sizeof(context));
@@ -273,6 +283,10 @@ NativeSensorManager::NativeSensorManager():
 		ALOGE("Get data info failed\n");
 	}
 
+	ALOGI("Sensor HAL init took %lld us, loading calibration took %lld us\n",
+			(long long)((getMonotonicNs() - start) / 1000),
+			(long long)(mCalibrateTime / 1000));
+
 	dump();
 }
 
@@ -328,6 +342,8 @@ void NativeSensorManager::dump()
 				context[i].delay_ns,
 				context[i].enable);
 
+		dumpStats(&context[i]);
+
 		ALOGI("Listener:");
 		list_for_each(node, &context[i].listener) {
 			ref = node_to_item(node, struct SensorRefMap, list);
@@ -344,6 +360,49 @@ void NativeSensorManager::dump()
 	ALOGI("\n");
 }
 
+/* Counters of a sensor since the HAL was loaded. Logged by activate()
+ * each time the sensor is turned off, since dump() only runs at load. */
+void NativeSensorManager::dumpStats(const struct SensorContext *ctx)
+{
+	if (ctx->driver == NULL)
+		return;
+
+	if (ctx->is_virtual) {
+		VirtualSensor *virt = (VirtualSensor *)ctx->driver;
+		const AlignStats *stats = virt->getAlignStats();
+
+		ALOGI("%s: events dropped:%lld\n", ctx->sensor->name,
+				(long long)virt->getDroppedEvents());
+		if ((stats != NULL) && stats->frames) {
+			ALOGI("%s: aligned frames:%lld skipped:%lld skew avg:%lldns max:%lldns\n",
+					ctx->sensor->name,
+					(long long)stats->frames, (long long)stats->skipped,
+					(long long)(stats->skew_sum_ns / stats->frames),
+					(long long)stats->skew_max_ns);
+		}
+		if ((stats != NULL) && stats->samples) {
+			ALOGI("%s: jitter avg:%lldns max:%lldns\n", ctx->sensor->name,
+					(long long)(stats->jitter_sum_ns / stats->samples),
+					(long long)stats->jitter_max_ns);
+		}
+	} else {
+		ALOGI("%s: sysfs syscalls avoided:%lld\n", ctx->sensor->name,
+				(long long)ctx->driver->getSyscallsAvoided());
+	}
+
+	if (!ctx->is_virtual && (ctx->sensor->type == SENSOR_TYPE_LIGHT)) {
+		LightSensor *light = (LightSensor *)ctx->driver;
+		int64_t samples = light->getReportedEvents() + light->getSuppressedEvents();
+
+		ALOGI("%s: events reported:%lld suppressed:%lld\n", ctx->sensor->name,
+				(long long)light->getReportedEvents(),
+				(long long)light->getSuppressedEvents());
+		if (light->getCpuTimeNs() && samples)
+			ALOGI("%s: cpu per sample:%lldns\n", ctx->sensor->name,
+					(long long)(light->getCpuTimeNs() / samples));
+	}
+}
+
 int NativeSensorManager::getDataInfo() {
 	struct dirent **namelist;
 	char *file;
@@ -363,13 +422,24 @@ int NativeSensorManager::getDataInfo() {
 	struct sensor_t sensor_acc;
 	struct sensor_t sensor_light;
 	struct sensor_t sensor_proximity;
+#ifdef SENSORS_REPLAY
+	const char *replay_dir = getenv(SENSORS_REPLAY_ENV);
+#endif
 
 	strlcpy(path, EVENT_PATH, sizeof(path));
 	file = path + strlen(EVENT_PATH);
 	nNodes = scandir(path, &namelist, 0, alphasort);
 	if (nNodes < 0) {
 		ALOGE("scan %s failed.(%s)\n", EVENT_PATH, strerror(errno));
+#ifdef SENSORS_REPLAY
+		/* No input devices on a host, the data nodes come from replay_dir */
+		if (replay_dir == NULL)
+			return -1;
+		nNodes = 0;
+		namelist = NULL;
+#else
 		return -1;
+#endif
 	}
 
 	for (event_count = 0, j = 0; (j < nNodes) && (j < MAX_SENSORS); j++) {
@@ -402,6 +472,12 @@ int NativeSensorManager::getDataInfo() {
 	free(namelist);
 
 	mSensorCount = getSensorListInner();
+
+	/* Convert the legacy XML calibration file on first boot or once it changes */
+	int64_t start = getMonotonicNs();
+	CalibrationStore::getInstance().importXML(sensor_list, mSensorCount);
+	mCalibrateTime += getMonotonicNs() - start;
+
 	for (i = 0; i < mSensorCount; i++) {
 		struct SensorRefMap *item;
 		list = &context[i];
@@ -424,6 +500,15 @@ int NativeSensorManager::getDataInfo() {
 			}
 		}
 
+#ifdef SENSORS_REPLAY
+		/* Read the events recorded by sensors_record instead */
+		if (replay_dir != NULL) {
+			free(list->data_path);
+			snprintf(path, sizeof(path), "%s/%s", replay_dir, list->sensor->name);
+			list->data_path = strdup(path);
+		}
+#endif
+
 		if (list->data_path != NULL)
 			list->data_fd = open(list->data_path,O_RDONLY | O_CLOEXEC | O_NONBLOCK);
 		else
@@ -664,6 +749,10 @@ int NativeSensorManager::getSensorListInner()
 	int err = -1;
 	const char *dirname = SYSFS_CLASS;
 	char devname[PATH_MAX];
+#ifdef SENSORS_REPLAY
+	char replay_class[PATH_MAX];
+	const char *replay_dir = getenv(SENSORS_REPLAY_ENV);
+#endif
 	char *filename;
 	char *nodename;
 	DIR *dir;
@@ -671,6 +760,14 @@ int NativeSensorManager::getSensorListInner()
 	struct SensorContext *list;
 	unsigned int i;
 
+#ifdef SENSORS_REPLAY
+	/* Sysfs snapshot written by sensors_replay */
+	if (replay_dir != NULL) {
+		snprintf(replay_class, sizeof(replay_class), "%s/sysfs/", replay_dir);
+		dirname = replay_class;
+	}
+#endif
+
 	dir = opendir(dirname);
 	if(dir == NULL) {
 		return 0;
@@ -686,12 +783,12 @@ int NativeSensorManager::getSensorListInner()
 
 		list = &context[number];
 
-		strlcpy(filename, de->d_name, PATH_MAX - strlen(SYSFS_CLASS));
+		strlcpy(filename, de->d_name, PATH_MAX - strlen(dirname));
 		nodename = filename + strlen(de->d_name);
 		*nodename++ = '/';
 
 		for (i = 0; i < ARRAY_SIZE(node_map); i++) {
-			strlcpy(nodename, node_map[i].node, PATH_MAX - strlen(SYSFS_CLASS) - strlen(de->d_name));
+			strlcpy(nodename, node_map[i].node, PATH_MAX - strlen(dirname) - strlen(de->d_name));
 			err = getNode((char*)(list->sensor), devname, &node_map[i]);
 			if (err) {
 				ALOGE("Get node for %s failed.\n", devname);
@@ -727,12 +824,14 @@ int NativeSensorManager::activate(int handle, int enable)
 	struct listnode *node;
 	struct SensorContext *ctx;
 	struct SensorRefMap *item;
+	int was_enabled;
 
 	list = getInfoByHandle(handle);
 	if (list == NULL) {
 		ALOGE("Invalid handle(%d)", handle);
 		return -EINVAL;
 	}
+	was_enabled = list->enable;
 
 	/* Search for the background sensor for the sensor specified by handle. */
 	list_for_each(node, &list->dep_list) {
@@ -760,6 +859,8 @@ int NativeSensorManager::activate(int handle, int enable)
 			/* Disable the background sensor if it doesn't have any listeners. */
 			if (list_empty(&item->ctx->listener)) {
 				item->ctx->driver->enable(item->ctx->sensor->handle, 0);
+				if (item->ctx != list)
+					dumpStats(item->ctx);
 			}
 		}
 	}
@@ -769,6 +870,9 @@ int NativeSensorManager::activate(int handle, int enable)
 
 	list->enable = enable;
 
+	if (!enable && was_enabled)
+		dumpStats(list);
+
 	return err;
 }
 
@@ -1043,6 +1147,7 @@ int NativeSensorManager::calibrate(int handle, struct cal_cmd_t *para)
 {
 	const SensorContext *list;
 	struct cal_result_t cal_result;
+	CalibrationStore& store(CalibrationStore::getInstance());
 	sensors_XML& sensor_XML(sensors_XML :: getInstance());
 	int err;
 
@@ -1061,7 +1166,14 @@ int NativeSensorManager::calibrate(int handle, struct cal_cmd_t *para)
 	if (!para->save) {
 		return err;
 	}
+	/* The XML is still read by the factory tools. Write it before the store
+	 * so the store stays the newer file and is not re-imported on boot. */
 	err = sensor_XML.write_sensors_params(list->sensor, &cal_result);
+	if (err < 0) {
+		ALOGE("write calibrate %s sensor XML error\n", list->sensor->name);
+		return err;
+	}
+	err = store.write(list->sensor, &cal_result);
 	if (err < 0) {
 		ALOGE("write calibrate %s sensor error\n", list->sensor->name);
 		return err;
@@ -1072,7 +1184,8 @@ int NativeSensorManager::calibrate(int handle, struct cal_cmd_t *para)
 int NativeSensorManager::initCalibrate(const SensorContext *list)
 {
 	struct cal_result_t cal_result;
-	sensors_XML& sensor_XML(sensors_XML :: getInstance());
+	CalibrationStore& store(CalibrationStore::getInstance());
+	int64_t start = getMonotonicNs();
 	int err = 0;
 
 	if(list == NULL) {
@@ -1080,7 +1193,8 @@ int NativeSensorManager::initCalibrate(const SensorContext *list)
 		return -EINVAL;
 	}
 	memset(&cal_result, 0, sizeof(cal_result));
-	err = sensor_XML.read_sensors_params(list->sensor, &cal_result);
+	err = store.read(list->sensor, &cal_result);
+	mCalibrateTime += getMonotonicNs() - start;
 	if (err < 0) {
 		ALOGE("read %s calibrate params error\n", list->sensor->name);
 		return err;
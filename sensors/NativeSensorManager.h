@@ -51,6 +51,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "VirtualSensor.h"
 
 #include "sensors_extension.h"
+#include "CalibrationStore.h"
 #include "sensors_XML.h"
 using namespace android;
 
@@ -120,6 +121,7 @@ class NativeSensorManager : public Singleton<NativeSensorManager> {
 	static const struct sensor_t virtualSensorList[];
 
 	int mSensorCount;
+	int64_t mCalibrateTime;
 
 	DefaultKeyedVector<int32_t, struct SensorContext*> type_map;
 	DefaultKeyedVector<int32_t, struct SensorContext*> handle_map;
@@ -141,6 +143,7 @@ public:
 	inline SensorContext* getInfoByType(int type) { return type_map.valueFor(type); };
 	int getSensorCount() {return mSensorCount;}
 	void dump();
+	void dumpStats(const struct SensorContext *ctx);
 	int hasPendingEvents(int handle);
 	int activate(int handle, int enable);
 	int setDelay(int handle, int64_t ns);
@@ -57,12 +57,6 @@ static const char *input_sysfs_path_list[SUPPORTED_PSENSOR_COUNT] = {
         [CM36283_PS] = "/sys/class/input/%s/device/",
 };
 
-static const char *input_sysfs_enable_list[SUPPORTED_PSENSOR_COUNT] = {
-   [GENERIC_PSENSOR] = "enable",
-    [LEGACY_PSENSOR] = "enable",
-        [CM36283_PS] = "enable",
-};
-
 
 ProximitySensor::ProximitySensor()
     : SensorBase(NULL, NULL),
@@ -163,31 +157,21 @@ int ProximitySensor::enable(int32_t, int en) {
     }
 
     if (flags != mEnabled) {
-        int fd;
-        if (sensor_index >= 0) {
-            strlcpy(&input_sysfs_path[input_sysfs_path_len], input_sysfs_enable_list[sensor_index],
-                            sizeof(input_sysfs_path) - input_sysfs_path_len);
-        } else {
+        char buf[2];
+        if (sensor_index < 0) {
             ALOGE("invalid sensor index:%d\n", sensor_index);
             return -1;
         }
-        fd = open(input_sysfs_path, O_RDWR);
-        if (fd >= 0) {
-            char buf[2];
-            buf[1] = 0;
-            if (flags) {
-                buf[0] = '1';
-            } else {
-                buf[0] = '0';
-            }
-            write(fd, buf, sizeof(buf));
-            close(fd);
-            mEnabled = flags;
-            return 0;
+        buf[1] = 0;
+        if (flags) {
+            buf[0] = '1';
         } else {
-            ALOGE("open %s failed.(%s)\n", input_sysfs_path, strerror(errno));
-            return -1;
+            buf[0] = '0';
         }
+        if (writeControl(CONTROL_ENABLE, buf, sizeof(buf)))
+            return -1;
+        mEnabled = flags;
+        return 0;
     } else if (flags) {
             mHasPendingEvent = true;
     }
@@ -33,13 +33,26 @@
 
 /*****************************************************************************/
 
+static const char *control_node[CONTROL_COUNT] = {
+        [CONTROL_ENABLE] = SYSFS_ENABLE,
+        [CONTROL_POLL_DELAY] = SYSFS_POLL_DELAY,
+        [CONTROL_MAX_LATENCY] = SYSFS_MAXLATENCY,
+        [CONTROL_FLUSH] = SYSFS_FLUSH,
+};
+
 SensorBase::SensorBase(
         const char* dev_name,
         const char* data_name,
         const struct SensorContext* context /* = NULL */)
         : dev_name(dev_name), data_name(data_name), algo(NULL),
-        dev_fd(-1), data_fd(-1), mEnabled(0), mHasPendingMetadata(0)
+        dev_fd(-1), data_fd(-1), mEnabled(0), mHasPendingMetadata(0),
+        mSyscallsAvoided(0)
 {
+        for (int i = 0; i < CONTROL_COUNT; i++) {
+                control[i].fd = -1;
+                control[i].len = -1;
+        }
+
         if (context != NULL) {
                 CalibrationManager& cm(CalibrationManager::getInstance());
                 algo = cm.getCalAlgo(context->sensor);
@@ -60,6 +73,7 @@ SensorBase::SensorBase(
 }
 
 SensorBase::~SensorBase() {
+    closeControls();
     if (data_fd >= 0) {
         close(data_fd);
     }
@@ -84,6 +98,77 @@ int SensorBase::close_device() {
     return 0;
 }
 
+/* Write buf to the control node. The node is opened on first use and the
+ * descriptor kept until the sensor is destroyed. Writes of the value already
+ * present in the node are skipped when dedup is set.
+ */
+int SensorBase::writeControl(int node, const char *buf, int len, bool dedup)
+{
+        struct SysfsControl *ctl;
+        ssize_t ret;
+
+        if ((node < 0) || (node >= CONTROL_COUNT) || (len <= 0))
+                return -EINVAL;
+
+        ctl = &control[node];
+        if (dedup && (ctl->len == len) && !memcmp(ctl->value, buf, len)) {
+                /* open, write and close */
+                mSyscallsAvoided += 3;
+                return 0;
+        }
+
+        if (ctl->fd < 0) {
+                strlcpy(&input_sysfs_path[input_sysfs_path_len],
+                                control_node[node], SYSFS_MAXLEN);
+                ctl->fd = open(input_sysfs_path, O_RDWR | O_CLOEXEC);
+                if (ctl->fd < 0) {
+                        ALOGE("open %s failed.(%s)", input_sysfs_path, strerror(errno));
+                        return -1;
+                }
+        } else {
+                /* open and close */
+                mSyscallsAvoided += 2;
+        }
+
+        ret = pwrite(ctl->fd, buf, len, 0);
+        if (ret < 0) {
+                ALOGE("write %s failed.(%s)", control_node[node], strerror(errno));
+                ctl->len = -1;
+                return -1;
+        } else if (ret < len) {
+                ALOGE("write %s short: %zd of %d bytes", control_node[node], ret, len);
+                ctl->len = -1;
+                return -1;
+        }
+
+        if (len <= (int)sizeof(ctl->value)) {
+                memcpy(ctl->value, buf, len);
+                ctl->len = len;
+        } else {
+                ctl->len = -1;
+        }
+
+        /* Some drivers reset the rate settings on enable. Make sure they are
+         * written again after the enable state changed. */
+        if (node == CONTROL_ENABLE) {
+                control[CONTROL_POLL_DELAY].len = -1;
+                control[CONTROL_MAX_LATENCY].len = -1;
+        }
+
+        return 0;
+}
+
+void SensorBase::closeControls()
+{
+        for (int i = 0; i < CONTROL_COUNT; i++) {
+                if (control[i].fd >= 0) {
+                        close(control[i].fd);
+                        control[i].fd = -1;
+                }
+                control[i].len = -1;
+        }
+}
+
 int SensorBase::getFd() const {
     if (!data_name) {
         return dev_fd;
@@ -164,40 +249,21 @@ int SensorBase::initCalibrate(int32_t, struct cal_result_t*)
 
 int SensorBase::setLatency(int32_t, int64_t latency_ns)
 {
-        int fd;
         int latency_ms;
-        ssize_t len;
         char buf[80];
 
         if ((latency_ns / 1000000ULL) >= ((1ULL << 31) - 1))
                 return -EINVAL;
 
         latency_ms = latency_ns / 1000000;
-        strlcpy(&input_sysfs_path[input_sysfs_path_len],
-                        SYSFS_MAXLATENCY, SYSFS_MAXLEN);
-        fd = open(input_sysfs_path, O_RDWR);
-        if (fd < 0) {
-                ALOGE("open %s failed.(%s)", input_sysfs_path, strerror(errno));
-                return -1;
-        }
-
         snprintf(buf, sizeof(buf), "%d", latency_ms);
-        len = write(fd, buf, strlen(buf) + 1);
-        if (len < (ssize_t)strlen(buf) + 1) {
-                ALOGE("write %s failed.(%s)", input_sysfs_path, strerror(errno));
-                close(fd);
-                return -1;
-        }
 
-        close(fd);
-        return 0;
+        return writeControl(CONTROL_MAX_LATENCY, buf, strlen(buf) + 1);
 }
 
 int SensorBase::flush(int32_t handle)
 {
-        int fd;
         const char *buf = "1";
-        int len;
 
         NativeSensorManager& sm(NativeSensorManager::getInstance());
         struct SensorContext* ctx = sm.getInfoByHandle(handle);
@@ -216,21 +282,9 @@ int SensorBase::flush(int32_t handle)
 
         /* sensors have FIFO: call into driver */
         if (ctx->sensor->fifoMaxEventCount) {
-                strlcpy(&input_sysfs_path[input_sysfs_path_len],
-                                SYSFS_FLUSH, SYSFS_MAXLEN);
-                fd = open(input_sysfs_path, O_RDWR);
-                if (fd < 0) {
-                        ALOGE("open %s failed.(%s)", input_sysfs_path, strerror(errno));
+                /* Every write triggers a flush, never skip it */
+                if (writeControl(CONTROL_FLUSH, buf, strlen(buf) + 1, false))
                         return -1;
-                }
-
-                len = write(fd, buf, strlen(buf)+1);
-                if (len < (ssize_t)strlen(buf) + 1) {
-                        ALOGE("write %s failed.(%s)", input_sysfs_path, strerror(errno));
-                        close(fd);
-                        return -1;
-                }
-                close(fd);
         }
 
         mHasPendingMetadata++;
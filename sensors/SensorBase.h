@@ -27,12 +27,28 @@
 #include <hardware/sensors.h>
 #include <CalibrationManager.h>
 #include <sensors_extension.h>
+#include "sensors.h"
 
 /*****************************************************************************/
 
 struct sensors_event_t;
 struct SensorContext;
 
+/* The control nodes kept open for the lifetime of the sensor */
+enum {
+	CONTROL_ENABLE = 0,
+	CONTROL_POLL_DELAY,
+	CONTROL_MAX_LATENCY,
+	CONTROL_FLUSH,
+	CONTROL_COUNT,
+};
+
+struct SysfsControl {
+	int fd; // the cached file descriptor of the control node
+	int len; // length of the last value written, -1 if unknown
+	char value[SYSFS_MAXLEN]; // the last value written to the node
+};
+
 class SensorBase {
 protected:
 	const char*	dev_name;
@@ -48,6 +64,8 @@ protected:
 	int input_sysfs_path_len;
 	int mEnabled;
 	int mHasPendingMetadata;
+	struct SysfsControl control[CONTROL_COUNT];
+	int64_t mSyscallsAvoided;
 
 	int openInput(const char* inputName);
 	static int64_t getTimestamp();
@@ -60,6 +78,9 @@ protected:
 	int open_device();
 	int close_device();
 
+	int writeControl(int node, const char *buf, int len, bool dedup = true);
+	void closeControls();
+
 public:
 			SensorBase(const char* dev_name, const char* data_name,
 					const struct SensorContext* context = NULL);
@@ -77,6 +98,7 @@ public:
 	virtual int initCalibrate(int32_t handle, struct cal_result_t *cal_result);
 	virtual int setLatency(int32_t handle, int64_t ns);
 	virtual int flush(int32_t handle);
+	int64_t getSyscallsAvoided() const { return mSyscallsAvoided; }
 };
 
 /*****************************************************************************/
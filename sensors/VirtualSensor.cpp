@@ -36,6 +36,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <float.h>
 #include <sys/select.h>
 #include <cutils/log.h>
+#include <cutils/properties.h>
 
 #include "VirtualSensor.h"
 #include "sensors.h"
@@ -49,15 +50,60 @@ VirtualSensor::VirtualSensor(const struct SensorContext *ctx)
 	  mRead(mBuffer),
 	  mWrite(mBuffer),
 	  mBufferEnd(mBuffer + MAX_EVENTS),
-	  mFreeSpace(MAX_EVENTS)
+	  mFreeSpace(MAX_EVENTS),
+	  mDropped(0),
+	  mAligner(NULL),
+	  mAlign(false)
 
 {
+	char value[PROPERTY_VALUE_MAX];
+
+	/* Feed the algo with time aligned frames of all the background sensors
+	 * instead of the events in the order they are read. */
+	property_get("sensors.fusion.align", value, "0");
+	mAlign = !strcmp(value, "1");
+}
+
+/* The background sensors are only added to the context after the driver
+ * is created, so the aligner is set up when the sensor is first enabled. */
+void VirtualSensor::setupAligner()
+{
+	const SensorContext *ctx = context;
+	struct listnode *node;
+	struct SensorRefMap *item;
+	int count = 0;
+	bool align = true;
+
+	mAlign = false;
+	list_for_each(node, &ctx->dep_list) {
+		item = node_to_item(node, struct SensorRefMap, list);
+		if (!FrameAligner::canInterpolate(item->ctx->sensor->type))
+			align = false;
+		count++;
+	}
+
+	/* Only worth it for continuous sensors fused from several sensors */
+	if (!align || (count < 2) || (count > ALIGN_MAX_STREAMS))
+		return;
+
+	mAligner = new FrameAligner();
+	list_for_each(node, &ctx->dep_list) {
+		item = node_to_item(node, struct SensorRefMap, list);
+		mAligner->addStream(item->ctx->sensor->type);
+	}
+	ALOGI("%s uses aligned frames of %d sensors", ctx->sensor->name, count);
 }
 
 VirtualSensor::~VirtualSensor() {
 	if (mEnabled) {
 		enable(0, 0);
 	}
+	delete mAligner;
+}
+
+const AlignStats* VirtualSensor::getAlignStats() const
+{
+	return (mAligner != NULL) ? &mAligner->getStats() : NULL;
 }
 
 int VirtualSensor::enable(int32_t, int en) {
@@ -66,6 +112,10 @@ int VirtualSensor::enable(int32_t, int en) {
 
 	if (mEnabled != flag) {
 		mEnabled = flag;
+		if (mEnabled && mAlign)
+			setupAligner();
+		if (mAligner != NULL)
+			mAligner->reset();
 		arg.enable = mEnabled;
 		if ((algo != NULL) && (algo->methods->config != NULL)) {
 			if (algo->methods->config(CMD_ENABLE, (sensor_algo_args*)&arg)) {
@@ -114,45 +164,86 @@ int VirtualSensor::readEvents(sensors_event_t* data, int count)
 	}
 
 	if (number > 0)
-		mLastEvent = data[number - 1];
+		mLastEvent = *(data - 1);
 
 	return number;
 }
 
+/* Return 0 if the algo produced an event in out */
+int VirtualSensor::convertEvent(sensors_event_t *event, sensors_event_t *out)
+{
+	if (algo->methods->convert(event, out, NULL))
+		return -1;
+
+	out->version = sizeof(sensors_event_t);
+	out->sensor = context->sensor->handle;
+	out->type = context->sensor->type;
+#if defined(SENSORS_DEVICE_API_VERSION_1_3)
+	out->flags = context->sensor->flags;
+#endif
+	out->timestamp = event->timestamp;
+
+	return 0;
+}
+
+void VirtualSensor::writeEvent(const sensors_event_t *out)
+{
+	if (mFreeSpace) {
+		*mWrite++ = *out;
+		mFreeSpace--;
+		if (mWrite >= mBufferEnd) {
+			mWrite = mBuffer;
+		}
+	} else {
+		mDropped++;
+		ALOGW("Circular buffer is full(%lld dropped)\n", (long long)mDropped);
+	}
+}
+
 int VirtualSensor::injectEvents(sensors_event_t* data, int count)
 {
-	int i;
+	int i, j, n;
 	sensors_event_t event;
+	sensors_event_t out;
 
 	if (algo == NULL)
 		return 0;
 
-	for (i = 0; i < count; i++) {
-		event = data[i];
-		sensors_event_t out;
-		if (mFreeSpace) {
-			if (algo->methods->convert(&event, &out, NULL))
-				continue;
-
-			out.version = sizeof(sensors_event_t);
-			out.sensor = context->sensor->handle;
-			out.type = context->sensor->type;
-#if defined(SENSORS_DEVICE_API_VERSION_1_3)
-			out.flags = context->sensor->flags;
-#endif
-			out.timestamp = event.timestamp;
-
-			*mWrite++ = out;
-			mFreeSpace--;
-			if (mWrite >= mBufferEnd) {
-				mWrite = mBuffer;
+	if (mAligner != NULL) {
+		sensors_event_t frame[ALIGN_MAX_STREAMS];
+
+		mAligner->setPeriod(context->delay_ns);
+		for (i = 0; i < count; i++)
+			mAligner->push(&data[i]);
+
+		while ((n = mAligner->nextFrame(frame)) > 0) {
+			sensors_event_t result;
+			bool converted = false;
+
+			/* The algo keeps the last sample of the other sensors, so
+			 * feeding the whole frame produces the fused result at the
+			 * frame time. A failed conversion may leave out partly
+			 * written, so only the last successful one is reported. */
+			for (j = 0; j < n; j++) {
+				if (!convertEvent(&frame[j], &out)) {
+					result = out;
+					converted = true;
+				}
 			}
-
-		} else {
-			ALOGW("Circular buffer is full\n");
+			if (converted)
+				writeEvent(&result);
 		}
+
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		event = data[i];
+		/* No need to convert the event if it will be dropped */
+		if (mFreeSpace && convertEvent(&event, &out))
+			continue;
+		writeEvent(&out);
 	}
 
 	return 0;
 }
-
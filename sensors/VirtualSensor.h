@@ -37,6 +37,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "SensorBase.h"
 #include "InputEventReader.h"
 #include "NativeSensorManager.h"
+#include "FrameAligner.h"
 
 /*****************************************************************************/
 
@@ -53,6 +54,12 @@ class VirtualSensor : public SensorBase {
 	sensors_event_t* mWrite;
 	sensors_event_t* mBufferEnd;
 	ssize_t mFreeSpace;
+	int64_t mDropped;
+	FrameAligner *mAligner;
+	bool mAlign;
+	void setupAligner();
+	int convertEvent(sensors_event_t *event, sensors_event_t *out);
+	void writeEvent(const sensors_event_t *out);
 public:
 	VirtualSensor(const struct SensorContext *i);
 	virtual ~VirtualSensor();
@@ -60,6 +67,9 @@ public:
 	virtual bool hasPendingEvents() const;
 	virtual int enable(int32_t handle, int enabled);
 	virtual int injectEvents(sensors_event_t* data, int count);
+	int64_t getDroppedEvents() const { return mDropped; }
+	/* Return NULL if the events are not aligned */
+	const AlignStats* getAlignStats() const;
 };
 
 /*****************************************************************************/
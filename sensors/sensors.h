@@ -66,6 +66,10 @@ __BEGIN_DECLS
 #define SYSFS_FLUSH		"flush"
 #define SYSFS_FLAGS		"flags"
 
+/* Directory of the sysfs snapshot and FIFOs of the sensors_replay tool.
+ * Only read by builds with SENSORS_REPLAY defined. */
+#define SENSORS_REPLAY_ENV	"SENSORS_REPLAY_DIR"
+
 #define COMPASS_VENDOR_AKM		"AKM"
 #define COMPASS_VENDOR_ALPS		"Alps"
 #define COMPASS_VENDOR_YAMAHA		"Yamaha"
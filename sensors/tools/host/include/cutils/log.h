@@ -0,0 +1,75 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef HOST_CUTILS_LOG_H
+#define HOST_CUTILS_LOG_H
+
+/* Host stand-in for liblog, for building the sensors tools outside of the
+ * Android tree. Messages go to stderr; debug and verbose are compiled out.
+ * Pulls in the libc headers the real one drags along, the HAL relies on it.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static inline void __attribute__((format(printf, 2, 3)))
+__host_log(char prio, const char *fmt, ...)
+{
+	char buf[1024];
+	va_list ap;
+	size_t len;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	/* Like logcat, one line per message */
+	len = strlen(buf);
+	while (len && (buf[len - 1] == '\n'))
+		buf[--len] = '\0';
+	fprintf(stderr, "%c/%s: %s\n", prio, LOG_TAG, buf);
+}
+
+#define ALOGE(...)		__host_log('E', __VA_ARGS__)
+#define ALOGW(...)		__host_log('W', __VA_ARGS__)
+#define ALOGI(...)		__host_log('I', __VA_ARGS__)
+#define ALOGD(...)		((void)0)
+#define ALOGV(...)		((void)0)
+
+#define ALOGE_IF(cond, ...)	((cond) ? (void)ALOGE(__VA_ARGS__) : (void)0)
+#define ALOGW_IF(cond, ...)	((cond) ? (void)ALOGW(__VA_ARGS__) : (void)0)
+#define ALOGI_IF(cond, ...)	((cond) ? (void)ALOGI(__VA_ARGS__) : (void)0)
+#define ALOGD_IF(cond, ...)	((void)(cond))
+
+#endif
@@ -0,0 +1,79 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef HOST_HARDWARE_HARDWARE_H
+#define HOST_HARDWARE_HARDWARE_H
+
+/* Host copy of the parts of the libhardware module ABI the HAL uses */
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+#define HARDWARE_MODULE_TAG			1
+#define HARDWARE_DEVICE_TAG			2
+
+#define HARDWARE_MODULE_API_VERSION(maj, min)	((((maj) & 0xff) << 8) | ((min) & 0xff))
+#define HARDWARE_DEVICE_API_VERSION(maj, min)	((((maj) & 0xff) << 8) | ((min) & 0xff))
+#define HARDWARE_HAL_API_VERSION		HARDWARE_MODULE_API_VERSION(1, 0)
+
+struct hw_module_t;
+struct hw_device_t;
+
+struct hw_module_methods_t {
+	int (*open)(const struct hw_module_t *module, const char *id,
+			struct hw_device_t **device);
+};
+
+struct hw_module_t {
+	uint32_t tag;
+	union {
+		uint16_t module_api_version;
+		uint16_t version_major;
+	};
+	union {
+		uint16_t hal_api_version;
+		uint16_t version_minor;
+	};
+	const char *id;
+	const char *name;
+	const char *author;
+	struct hw_module_methods_t *methods;
+	void *dso;
+	uint32_t reserved[32 - 7];
+};
+
+struct hw_device_t {
+	uint32_t tag;
+	uint32_t version;
+	struct hw_module_t *module;
+	uint32_t reserved[12];
+	int (*close)(struct hw_device_t *device);
+};
+
+#endif
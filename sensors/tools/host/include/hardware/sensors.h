@@ -0,0 +1,226 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef HOST_HARDWARE_SENSORS_H
+#define HOST_HARDWARE_SENSORS_H
+
+/* Host copy of the parts of the sensors HAL ABI (API 1.3) the HAL uses */
+
+#include <stdint.h>
+#include <hardware/hardware.h>
+
+#define SENSORS_HARDWARE_MODULE_ID		"sensors"
+#define SENSORS_HARDWARE_POLL			"poll"
+
+#define SENSORS_MODULE_API_VERSION_0_1		HARDWARE_MODULE_API_VERSION(0, 1)
+#define SENSORS_DEVICE_API_VERSION_0_1		HARDWARE_DEVICE_API_VERSION(0, 1)
+#define SENSORS_DEVICE_API_VERSION_1_1		HARDWARE_DEVICE_API_VERSION(1, 1)
+#define SENSORS_DEVICE_API_VERSION_1_3		HARDWARE_DEVICE_API_VERSION(1, 3)
+
+#define SENSORS_HANDLE_BASE			0
+
+#define META_DATA_VERSION			2
+#define META_DATA_FLUSH_COMPLETE		1
+
+#define SENSOR_FLAG_WAKE_UP			1
+#define SENSOR_FLAG_CONTINUOUS_MODE		0
+#define SENSOR_FLAG_ON_CHANGE_MODE		2
+
+#define SENSOR_STATUS_UNRELIABLE		0
+#define SENSOR_STATUS_ACCURACY_HIGH		3
+
+#define GRAVITY_EARTH				(9.80665f)
+
+enum {
+	SENSOR_TYPE_META_DATA			= 0,
+	SENSOR_TYPE_ACCELEROMETER		= 1,
+	SENSOR_TYPE_GEOMAGNETIC_FIELD		= 2,
+	SENSOR_TYPE_MAGNETIC_FIELD		= SENSOR_TYPE_GEOMAGNETIC_FIELD,
+	SENSOR_TYPE_ORIENTATION			= 3,
+	SENSOR_TYPE_GYROSCOPE			= 4,
+	SENSOR_TYPE_LIGHT			= 5,
+	SENSOR_TYPE_PRESSURE			= 6,
+	SENSOR_TYPE_TEMPERATURE			= 7,
+	SENSOR_TYPE_PROXIMITY			= 8,
+	SENSOR_TYPE_GRAVITY			= 9,
+	SENSOR_TYPE_LINEAR_ACCELERATION		= 10,
+	SENSOR_TYPE_ROTATION_VECTOR		= 11,
+	SENSOR_TYPE_RELATIVE_HUMIDITY		= 12,
+	SENSOR_TYPE_AMBIENT_TEMPERATURE		= 13,
+	SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED	= 14,
+	SENSOR_TYPE_GAME_ROTATION_VECTOR	= 15,
+	SENSOR_TYPE_GYROSCOPE_UNCALIBRATED	= 16,
+	SENSOR_TYPE_SIGNIFICANT_MOTION		= 17,
+	SENSOR_TYPE_STEP_DETECTOR		= 18,
+	SENSOR_TYPE_STEP_COUNTER		= 19,
+	SENSOR_TYPE_GEOMAGNETIC_ROTATION_VECTOR	= 20,
+	SENSOR_TYPE_DEVICE_PRIVATE_BASE		= 0x10000,
+};
+
+typedef struct {
+	union {
+		float v[3];
+		struct {
+			float x;
+			float y;
+			float z;
+		};
+		struct {
+			float azimuth;
+			float pitch;
+			float roll;
+		};
+	};
+	int8_t status;
+	uint8_t reserved[3];
+} sensors_vec_t;
+
+typedef struct {
+	union {
+		float uncalib[3];
+		struct {
+			float x_uncalib;
+			float y_uncalib;
+			float z_uncalib;
+		};
+	};
+	union {
+		float bias[3];
+		struct {
+			float x_bias;
+			float y_bias;
+			float z_bias;
+		};
+	};
+} uncalibrated_event_t;
+
+typedef struct meta_data_event {
+	int32_t what;
+	int32_t sensor;
+} meta_data_event_t;
+
+typedef struct sensors_event_t {
+	int32_t version;
+	int32_t sensor;
+	int32_t type;
+	int32_t reserved0;
+	int64_t timestamp;
+	union {
+		union {
+			float data[16];
+			sensors_vec_t acceleration;
+			sensors_vec_t magnetic;
+			sensors_vec_t orientation;
+			sensors_vec_t gyro;
+			float temperature;
+			float distance;
+			float light;
+			float pressure;
+			float relative_humidity;
+			uncalibrated_event_t uncalibrated_gyro;
+			uncalibrated_event_t uncalibrated_magnetic;
+			meta_data_event_t meta_data;
+		};
+		union {
+			uint64_t data[8];
+			uint64_t step_counter;
+		} u64;
+	};
+	uint32_t flags;
+	uint32_t reserved1[3];
+} sensors_event_t;
+
+typedef sensors_event_t sensors_meta_data_event_t;
+
+struct sensor_t {
+	const char *name;
+	const char *vendor;
+	int version;
+	int handle;
+	int type;
+	float maxRange;
+	float resolution;
+	float power;
+	int32_t minDelay;
+	uint32_t fifoReservedEventCount;
+	uint32_t fifoMaxEventCount;
+	const char *stringType;
+	const char *requiredPermission;
+#if defined(__LP64__)
+	int64_t maxDelay;
+	uint64_t flags;
+#else
+	int32_t maxDelay;
+	uint32_t flags;
+#endif
+	void *reserved[2];
+};
+
+struct sensors_module_t {
+	struct hw_module_t common;
+	int (*get_sensors_list)(struct sensors_module_t *module,
+			struct sensor_t const **list);
+};
+
+struct sensors_poll_device_t {
+	struct hw_device_t common;
+	int (*activate)(struct sensors_poll_device_t *dev, int handle, int enabled);
+	int (*setDelay)(struct sensors_poll_device_t *dev, int handle, int64_t period_ns);
+	int (*poll)(struct sensors_poll_device_t *dev, sensors_event_t *data, int count);
+};
+
+typedef struct sensors_poll_device_1 {
+	union {
+		struct sensors_poll_device_t v0;
+		struct {
+			struct hw_device_t common;
+			int (*activate)(struct sensors_poll_device_t *dev, int handle, int enabled);
+			int (*setDelay)(struct sensors_poll_device_t *dev, int handle, int64_t period_ns);
+			int (*poll)(struct sensors_poll_device_t *dev, sensors_event_t *data, int count);
+		};
+	};
+	int (*batch)(struct sensors_poll_device_1 *dev, int handle, int flags,
+			int64_t period_ns, int64_t timeout);
+	int (*flush)(struct sensors_poll_device_1 *dev, int handle);
+	void (*reserved_procs[8])(void);
+} sensors_poll_device_1_t;
+
+static inline int sensors_open(const struct hw_module_t *module,
+		struct sensors_poll_device_t **device)
+{
+	return module->methods->open(module, SENSORS_HARDWARE_POLL,
+			(struct hw_device_t **)device);
+}
+
+static inline int sensors_close(struct sensors_poll_device_t *device)
+{
+	return device->common.close(&device->common);
+}
+
+#endif
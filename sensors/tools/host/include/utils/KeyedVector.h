@@ -0,0 +1,69 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef HOST_UTILS_KEYEDVECTOR_H
+#define HOST_UTILS_KEYEDVECTOR_H
+
+/* Host stand-in for the libutils DefaultKeyedVector, on top of std::map */
+
+#include <map>
+#include <sys/types.h>
+
+namespace android {
+
+template <typename KEY, typename VALUE>
+class DefaultKeyedVector {
+public:
+	DefaultKeyedVector(const VALUE& defValue = VALUE()) : mDefault(defValue) {}
+
+	void setCapacity(size_t size) { (void)size; }
+	size_t size() const { return mMap.size(); }
+
+	ssize_t add(const KEY& key, const VALUE& value) {
+		mMap[key] = value;
+		return 0;
+	}
+
+	ssize_t removeItem(const KEY& key) {
+		return mMap.erase(key) ? 0 : -1;
+	}
+
+	const VALUE& valueFor(const KEY& key) const {
+		typename std::map<KEY, VALUE>::const_iterator it = mMap.find(key);
+		return (it == mMap.end()) ? mDefault : it->second;
+	}
+
+private:
+	std::map<KEY, VALUE> mMap;
+	VALUE mDefault;
+};
+
+}; // namespace android
+
+#endif
@@ -0,0 +1,75 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef HOST_UTILS_SINGLETON_H
+#define HOST_UTILS_SINGLETON_H
+
+/* Host stand-in for the libutils Mutex and Singleton */
+
+#include <pthread.h>
+
+namespace android {
+
+class Mutex {
+public:
+	Mutex() { pthread_mutex_init(&mMutex, NULL); }
+	~Mutex() { pthread_mutex_destroy(&mMutex); }
+	void lock() { pthread_mutex_lock(&mMutex); }
+	void unlock() { pthread_mutex_unlock(&mMutex); }
+
+	class Autolock {
+	public:
+		Autolock(Mutex& mutex) : mLock(mutex) { mLock.lock(); }
+		~Autolock() { mLock.unlock(); }
+	private:
+		Mutex& mLock;
+	};
+
+private:
+	pthread_mutex_t mMutex;
+};
+
+template <typename TYPE>
+class Singleton {
+public:
+	static TYPE& getInstance() {
+		static TYPE *instance = new TYPE();
+		return *instance;
+	}
+
+protected:
+	Singleton() {}
+	~Singleton() {}
+};
+
+}; // namespace android
+
+#define ANDROID_SINGLETON_STATIC_INSTANCE(TYPE)
+
+#endif
@@ -0,0 +1,162 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+/* Calibration module for host replays. It gives the HAL an orientation
+ * algo, so that replaying an accelerometer and compass log also runs the
+ * virtual sensor path: the circular buffer and the frame aligner. The
+ * orientation is the plain tilt compensated compass, nothing is filtered.
+ *
+ * To use it, copy the library into the replay directory next to a
+ * calmodule.cfg naming it:
+ *	cp libcalmodule_replay.so /tmp/sensors_replay/
+ *	echo libcalmodule_replay.so > /tmp/sensors_replay/calmodule.cfg
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <CalibrationModule.h>
+
+#define SENSOR_CAL_ALGO_VERSION		1
+#define ARRAY_SIZE(a)			(sizeof(a)/sizeof(a[0]))
+
+struct sensor_cal_module_t SENSOR_CAL_MODULE_INFO;
+
+static sensors_vec_t last_acc;
+static sensors_vec_t last_mag;
+static int have_acc;
+static int have_mag;
+
+static int convert_orientation(sensors_event_t *raw, sensors_event_t *result,
+		struct sensor_algo_args *args)
+{
+	float roll, pitch, heading;
+	float sin_r, cos_r, sin_p, cos_p;
+	float hx, hy;
+
+	(void)args;
+
+	if (raw->type == SENSOR_TYPE_ACCELEROMETER) {
+		last_acc = raw->acceleration;
+		have_acc = 1;
+	} else if (raw->type == SENSOR_TYPE_MAGNETIC_FIELD) {
+		last_mag = raw->magnetic;
+		have_mag = 1;
+	} else {
+		return -1;
+	}
+
+	if (!have_acc || !have_mag)
+		return -1;
+
+	roll = atan2f(last_acc.y, last_acc.z);
+	pitch = atan2f(-last_acc.x, sqrtf(last_acc.y * last_acc.y + last_acc.z * last_acc.z));
+	sin_r = sinf(roll);
+	cos_r = cosf(roll);
+	sin_p = sinf(pitch);
+	cos_p = cosf(pitch);
+
+	hx = last_mag.x * cos_p + last_mag.y * sin_r * sin_p + last_mag.z * cos_r * sin_p;
+	hy = last_mag.y * cos_r - last_mag.z * sin_r;
+	heading = atan2f(-hy, hx) * 180.0f / (float)M_PI;
+	if (heading < 0)
+		heading += 360.0f;
+
+	memset(result->data, 0, sizeof(result->data));
+	result->orientation.azimuth = heading;
+	result->orientation.pitch = pitch * 180.0f / (float)M_PI;
+	result->orientation.roll = roll * 180.0f / (float)M_PI;
+	result->orientation.status = SENSOR_STATUS_ACCURACY_HIGH;
+
+	return 0;
+}
+
+static int config_orientation(int cmd, struct sensor_algo_args *args)
+{
+	if ((cmd == CMD_ENABLE) && !args->enable) {
+		have_acc = 0;
+		have_mag = 0;
+	}
+
+	return 0;
+}
+
+static int cal_init(const struct sensor_cal_module_t *module)
+{
+	(void)module;
+	return 0;
+}
+
+static void cal_deinit()
+{
+}
+
+static struct sensor_algo_methods_t orientation_methods = {
+	.convert = convert_orientation,
+	.config = config_orientation,
+};
+
+static const char* orientation_match_table[] = {
+	ORIENTATION_NAME,
+	NULL
+};
+
+static struct sensor_cal_algo_t algo_list[] = {
+	{
+		.tag = SENSOR_CAL_ALGO_TAG,
+		.version = SENSOR_CAL_ALGO_VERSION,
+		.type = SENSOR_TYPE_ORIENTATION,
+		.compatible = orientation_match_table,
+		.module = &SENSOR_CAL_MODULE_INFO,
+		.methods = &orientation_methods,
+	},
+};
+
+static int cal_get_algo_list(const struct sensor_cal_algo_t **algo)
+{
+	*algo = algo_list;
+	return 0;
+}
+
+static struct sensor_cal_methods_t cal_methods = {
+	.init = cal_init,
+	.deinit = cal_deinit,
+	.get_algo_list = cal_get_algo_list,
+};
+
+struct sensor_cal_module_t SENSOR_CAL_MODULE_INFO = {
+	.tag = SENSOR_CAL_MODULE_TAG,
+	.id = "cal_module_replay",
+	.version = SENSOR_CAL_MODULE_VERSION,
+	.vendor = "replay",
+	.dso = NULL,
+	.number = ARRAY_SIZE(algo_list),
+	.methods = &cal_methods,
+	.reserved = {0},
+};
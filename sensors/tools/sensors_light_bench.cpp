@@ -0,0 +1,195 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+/* Measure the CPU cost per light sensor sample.
+ *
+ * First compares the ADC to lux conversion through the lookup table with
+ * the powf() formula it replaced. Then feeds samples through a pipe into
+ * LightSensor::readEvents(), with the on-change filter off and at the
+ * given hysteresis, and prints the thread CPU time per sample together
+ * with the reported and suppressed counts. The samples step between four
+ * light levels with +-1% noise, like an indoor sensor reading.
+ *
+ *   sensors_light_bench [samples] [hysteresis percent]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+
+#include "LightSensor.h"
+#include "NativeSensorManager.h"
+
+#ifdef __ANDROID__
+#define BENCH_DIR	"/data/local/tmp/sensors_light_bench"
+#else
+#define BENCH_DIR	"/tmp/sensors_light_bench"
+#endif
+
+static int64_t thread_cpu_ns()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+static void bench_convert(int samples)
+{
+	volatile float sink = 0;
+	int64_t start, formula, table;
+	int i;
+
+	start = thread_cpu_ns();
+	for (i = 0; i < samples; i++)
+		sink += powf(10, (i & 4095) * (330.0f / 4095.0f / 47.0f)) * 4;
+	formula = thread_cpu_ns() - start;
+
+	start = thread_cpu_ns();
+	for (i = 0; i < samples; i++)
+		sink += LightSensor::adcToLux(i & 4095);
+	table = thread_cpu_ns() - start;
+
+	printf("adc to lux: powf %.1f ns/sample, table %.1f ns/sample\n",
+			(double)formula / samples, (double)table / samples);
+}
+
+/* Control nodes written by LightSensor::enable() and setDelay() */
+static int make_nodes(const char *dir)
+{
+	static const char * const nodes[] = { SYSFS_ENABLE, SYSFS_POLL_DELAY };
+	char path[PATH_MAX];
+	size_t i;
+	int fd;
+
+	mkdir(dir, 0770);
+	for (i = 0; i < ARRAY_SIZE(nodes); i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, nodes[i]);
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+		if (fd < 0) {
+			fprintf(stderr, "open %s failed(%s)\n", path, strerror(errno));
+			return -1;
+		}
+		close(fd);
+	}
+
+	return 0;
+}
+
+static int bench_read(int samples, int hysteresis)
+{
+	static const int levels[] = { 100, 400, 50, 1000 };
+	struct SensorContext ctx;
+	struct sensor_t sensor;
+	struct input_event ev[2];
+	sensors_event_t out[16];
+	char path[PATH_MAX];
+	int64_t cpu = 0;
+	int fds[2];
+	int i, n;
+
+	if (pipe(fds)) {
+		fprintf(stderr, "pipe failed(%s)\n", strerror(errno));
+		return -1;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+	memset(&sensor, 0, sizeof(sensor));
+	sensor.name = "bench light";
+	sensor.handle = SENSORS_LIGHT_HANDLE;
+	sensor.type = SENSOR_TYPE_LIGHT;
+	memset(&ctx, 0, sizeof(ctx));
+	snprintf(path, sizeof(path), "%s/", BENCH_DIR);
+	ctx.enable_path = path;
+	ctx.sensor = &sensor;
+	ctx.data_fd = fds[0];
+
+	/* The sensor owns the read end from here on */
+	LightSensor light(&ctx);
+	light.setHysteresis(hysteresis);
+	if (light.enable(0, 1)) {
+		close(fds[1]);
+		return -1;
+	}
+
+	memset(ev, 0, sizeof(ev));
+	ev[0].type = EV_ABS;
+	ev[0].code = ABS_MISC;
+	ev[1].type = EV_SYN;
+	ev[1].code = SYN_REPORT;
+	for (i = 0; i < samples; i++) {
+		int level = levels[(i / 50) % ARRAY_SIZE(levels)];
+
+		ev[0].value = level + (i % 3 - 1) * level / 100;
+		if (write(fds[1], ev, sizeof(ev)) != sizeof(ev)) {
+			fprintf(stderr, "write failed(%s)\n", strerror(errno));
+			close(fds[1]);
+			return -1;
+		}
+
+		int64_t start = thread_cpu_ns();
+		do {
+			n = light.readEvents(out, ARRAY_SIZE(out));
+		} while (n > 0);
+		cpu += thread_cpu_ns() - start;
+	}
+	close(fds[1]);
+
+	printf("hysteresis %3d%%: %.1f ns/sample, reported %lld suppressed %lld\n",
+			hysteresis, (double)cpu / samples,
+			(long long)light.getReportedEvents(),
+			(long long)light.getSuppressedEvents());
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int samples = (argc > 1) ? atoi(argv[1]) : 100000;
+	int hysteresis = (argc > 2) ? atoi(argv[2]) : 5;
+
+	if (samples <= 0)
+		samples = 100000;
+
+	if (make_nodes(BENCH_DIR))
+		return 1;
+
+	bench_convert(samples);
+	if (bench_read(samples, 0) || ((hysteresis > 0) && bench_read(samples, hysteresis)))
+		return 1;
+
+	return 0;
+}
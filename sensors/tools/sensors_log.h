@@ -0,0 +1,83 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+#ifndef SENSORS_LOG_H
+#define SENSORS_LOG_H
+
+#include <stdint.h>
+#include "sensors.h"
+
+/* The file format shared by sensors_record and sensors_replay.
+ * A sensors_log_header is followed by sensors_log_record entries in
+ * capture order. The layout does not depend on the ABI of the recorder.
+ *
+ * The header keeps the sysfs attributes of every recorded sensor so the
+ * replay can enumerate the same sensors without a device.
+ */
+#define SENSORS_LOG_MAGIC	0x474f4c53 /* "SLOG" */
+#define SENSORS_LOG_VERSION	2
+#define SENSORS_LOG_NAME_LEN	80
+#define SENSORS_LOG_ATTR_LEN	32
+#define SENSORS_LOG_ATTR_COUNT	11
+
+/* Order of sensors_log_header.attr. The name is kept in sensors_log_header.name. */
+static const char * const sensors_log_attrs[SENSORS_LOG_ATTR_COUNT] = {
+	SYSFS_VENDOR,
+	SYSFS_VERSION,
+	SYSFS_TYPE,
+	SYSFS_MAXRANGE,
+	SYSFS_RESOLUTION,
+	SYSFS_POWER,
+	SYSFS_MINDELAY,
+	SYSFS_FIFORESVCNT,
+	SYSFS_FIFOMAXCNT,
+	SYSFS_MAXDELAY,
+	SYSFS_FLAGS,
+};
+
+struct sensors_log_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t stream_count; // number of recorded input devices
+	uint32_t reserved;
+	char name[MAX_SENSORS][SENSORS_LOG_NAME_LEN]; // sensor name of each stream
+	char attr[MAX_SENSORS][SENSORS_LOG_ATTR_COUNT][SENSORS_LOG_ATTR_LEN]; // "" if absent
+};
+
+struct sensors_log_record {
+	uint32_t stream; // index into sensors_log_header.name
+	uint16_t type; // input_event type
+	uint16_t code; // input_event code
+	int32_t value; // input_event value
+	uint32_t reserved;
+	int64_t event_ns; // input_event time
+	int64_t capture_ns; // CLOCK_BOOTTIME when the recorder read the event
+};
+
+#endif
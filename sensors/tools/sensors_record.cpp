@@ -0,0 +1,245 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+/* Record the raw input events of every sensor to a file for sensors_replay.
+ * The sensors to record have to be activated by someone else, for example
+ * an application using them.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#include "sensors_log.h"
+
+static volatile sig_atomic_t stop;
+
+static void handle_signal(int)
+{
+	stop = 1;
+}
+
+static int64_t now_ns()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_BOOTTIME, &t);
+	return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+static int read_node(const char *dir, const char *node, char *buf, size_t size)
+{
+	char path[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s%s/%s", SYSFS_CLASS, dir, node);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+
+	buf[len] = '\0';
+	if (buf[len - 1] == '\n')
+		buf[len - 1] = '\0';
+
+	return 0;
+}
+
+/* Open the input device of every sensor registered in SYSFS_CLASS the same
+ * way as NativeSensorManager does. Return the number of streams found. */
+static int open_streams(struct sensors_log_header *hdr, struct pollfd *fds)
+{
+	struct dirent **namelist;
+	char path[PATH_MAX];
+	char name[SENSORS_LOG_NAME_LEN];
+	char type[16];
+	char input[MAX_SENSORS][SENSORS_LOG_NAME_LEN];
+	char input_path[MAX_SENSORS][PATH_MAX];
+	int input_count = 0;
+	int count = 0;
+	int n, i, j;
+	DIR *dir;
+	struct dirent *de;
+
+	n = scandir("/dev/input", &namelist, 0, alphasort);
+	if (n < 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		int fd;
+
+		if ((namelist[i]->d_type == DT_CHR) && (input_count < MAX_SENSORS)) {
+			snprintf(path, sizeof(path), "/dev/input/%s", namelist[i]->d_name);
+			fd = open(path, O_RDONLY);
+			if (fd >= 0) {
+				if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), &name) < 1)
+					name[0] = '\0';
+				strlcpy(input[input_count], name, sizeof(input[0]));
+				strlcpy(input_path[input_count], path, sizeof(input_path[0]));
+				input_count++;
+				close(fd);
+			}
+		}
+		free(namelist[i]);
+	}
+	free(namelist);
+
+	dir = opendir(SYSFS_CLASS);
+	if (dir == NULL)
+		return -1;
+
+	while (((de = readdir(dir)) != NULL) && (count < MAX_SENSORS)) {
+		int match = -1;
+
+		if (de->d_name[0] == '.')
+			continue;
+		if (read_node(de->d_name, SYSFS_NAME, name, sizeof(name)) ||
+				read_node(de->d_name, SYSFS_TYPE, type, sizeof(type)))
+			continue;
+
+		for (j = 0; j < input_count; j++) {
+			if (!strcmp(name, input[j])) {
+				match = j;
+				break;
+			}
+			if (!strcmp(input[j], type_to_name(atoi(type))))
+				match = j;
+		}
+		if (match < 0)
+			continue;
+
+		fds[count].fd = open(input_path[match], O_RDONLY | O_NONBLOCK);
+		if (fds[count].fd < 0) {
+			fprintf(stderr, "open %s failed(%s)\n", input_path[match], strerror(errno));
+			continue;
+		}
+		fds[count].events = POLLIN;
+		strlcpy(hdr->name[count], name, sizeof(hdr->name[0]));
+		for (j = 0; j < SENSORS_LOG_ATTR_COUNT; j++) {
+			if (read_node(de->d_name, sensors_log_attrs[j], hdr->attr[count][j],
+						sizeof(hdr->attr[0][0])))
+				hdr->attr[count][j][0] = '\0';
+		}
+		printf("stream %d: %s(%s)\n", count, name, input_path[match]);
+		count++;
+	}
+	closedir(dir);
+
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	struct sensors_log_header hdr;
+	struct pollfd fds[MAX_SENSORS];
+	struct input_event events[64];
+	struct sensors_log_record record;
+	int64_t end = 0;
+	int64_t total = 0;
+	int count, i, j;
+	FILE *out;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <output> [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SENSORS_LOG_MAGIC;
+	hdr.version = SENSORS_LOG_VERSION;
+	count = open_streams(&hdr, fds);
+	if (count <= 0) {
+		fprintf(stderr, "no sensor input device found\n");
+		return 1;
+	}
+	hdr.stream_count = count;
+
+	out = fopen(argv[1], "w");
+	if (out == NULL) {
+		fprintf(stderr, "open %s failed(%s)\n", argv[1], strerror(errno));
+		return 1;
+	}
+	fwrite(&hdr, sizeof(hdr), 1, out);
+
+	if (argc > 2)
+		end = now_ns() + atoll(argv[2]) * 1000000000LL;
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	while (!stop && (!end || (now_ns() < end))) {
+		if (poll(fds, count, 100) <= 0)
+			continue;
+
+		for (i = 0; i < count; i++) {
+			ssize_t len;
+
+			if (!(fds[i].revents & POLLIN))
+				continue;
+
+			len = read(fds[i].fd, events, sizeof(events));
+			if (len <= 0)
+				continue;
+
+			memset(&record, 0, sizeof(record));
+			record.stream = i;
+			record.capture_ns = now_ns();
+			for (j = 0; j < (int)(len / sizeof(events[0])); j++) {
+				record.type = events[j].type;
+				record.code = events[j].code;
+				record.value = events[j].value;
+				record.event_ns = events[j].time.tv_sec * 1000000000LL +
+					events[j].time.tv_usec * 1000LL;
+				fwrite(&record, sizeof(record), 1, out);
+				total++;
+			}
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		close(fds[i].fd);
+	fclose(out);
+
+	printf("%lld events recorded\n", (long long)total);
+	return 0;
+}
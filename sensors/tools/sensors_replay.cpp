@@ -0,0 +1,501 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+
+/* Replay a file written by sensors_record through the sensors HAL and
+ * report the latency from event injection to pollEvents() output.
+ *
+ * The HAL sources are built into this tool with SENSORS_REPLAY defined,
+ * which makes NativeSensorManager look in SENSORS_REPLAY_ENV for its
+ * sysfs nodes and data nodes. The tool writes the sysfs attributes saved
+ * in the log there and feeds each recorded stream through a FIFO named
+ * after the sensor, so it also runs on a Linux host. Event times are
+ * rewritten to the injection time, which also keys a table of the times
+ * each report was actually sent: latency runs from the write of the
+ * SYN_REPORT that completed a report to its event leaving poll.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+
+#include <hardware/hardware.h>
+#include <hardware/sensors.h>
+
+#include "NativeSensorManager.h"
+#include "VirtualSensor.h"
+#include "sensors_log.h"
+
+#ifdef __ANDROID__
+#define REPLAY_DIR		"/data/local/tmp/sensors_replay"
+#else
+#define REPLAY_DIR		"/tmp/sensors_replay"
+#endif
+#define MAX_LATENCY_SAMPLES	(1 << 20)
+/* Events still in the HAL when the last record was written */
+#define DRAIN_IDLE_NS		100000000LL
+#define DRAIN_MAX_NS		2000000000LL
+
+/* Built in from sensors.cpp */
+extern struct sensors_module_t HAL_MODULE_INFO_SYM;
+
+/* Written by the injection thread only, published through sent_count */
+struct sent_report {
+	int64_t ts;
+	int64_t sent_ns;
+};
+
+struct replay_context {
+	struct sensors_log_record *records;
+	size_t record_count;
+	int fifo[MAX_SENSORS];
+	double speed;
+	struct sensors_poll_device_t *dev;
+	int wake_handle;
+	int done;
+	int64_t last_event_ns;
+	struct sent_report *sent;
+	size_t sent_count;
+	int64_t injected;
+	int64_t start_ns;
+	int64_t end_ns;
+};
+
+static int64_t now_ns()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_BOOTTIME, &t);
+	return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+static int64_t cpu_ns()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* Send time of the report an event came from. Hardware events carry the
+ * time of their report exactly; a virtual event built from several reports
+ * maps to the first report at or after its time, the one that completed it.
+ */
+static int64_t sent_time(const struct replay_context *ctx, int64_t ts)
+{
+	size_t count = __atomic_load_n(&ctx->sent_count, __ATOMIC_ACQUIRE);
+	size_t lo = 0, hi = count;
+
+	if (count == 0)
+		return -1;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (ctx->sent[mid].ts < ts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return ctx->sent[(lo < count) ? lo : count - 1].sent_ns;
+}
+
+static void *inject_thread(void *data)
+{
+	struct replay_context *ctx = (struct replay_context *)data;
+	sensors_poll_device_1_t *dev = (sensors_poll_device_1_t *)ctx->dev;
+	int64_t first = ctx->records[0].capture_ns;
+	int64_t base = now_ns();
+	int64_t last_ts = 0;
+	int64_t ts = 0;
+	int64_t now;
+	size_t i;
+
+	ctx->start_ns = base;
+	for (i = 0; i < ctx->record_count; i++) {
+		struct sensors_log_record *r = &ctx->records[i];
+		struct input_event ev;
+		int64_t due = base + (int64_t)((r->capture_ns - first) / ctx->speed);
+		int64_t now = now_ns();
+
+		if (due > now) {
+			struct timespec t;
+			t.tv_sec = (due - now) / 1000000000LL;
+			t.tv_nsec = (due - now) % 1000000000LL;
+			nanosleep(&t, NULL);
+		}
+
+		/* A new report starts after SYN_REPORT. Event times only keep
+		 * microseconds and have to stay unique to key the sent table.
+		 */
+		if (!ts) {
+			ts = now_ns() / 1000 * 1000;
+			if (ts <= last_ts)
+				ts = last_ts + 1000;
+			last_ts = ts;
+		}
+
+		memset(&ev, 0, sizeof(ev));
+		ev.time.tv_sec = ts / 1000000000LL;
+		ev.time.tv_usec = (ts % 1000000000LL) / 1000;
+		ev.type = r->type;
+		ev.code = r->code;
+		ev.value = r->value;
+		if (ev.type == EV_SYN) {
+			if (ev.code == SYN_TIME_SEC)
+				ev.value = ts / 1000000000LL;
+			else if (ev.code == SYN_TIME_NSEC)
+				ev.value = ts % 1000000000LL;
+		}
+
+		if (write(ctx->fifo[r->stream], &ev, sizeof(ev)) == sizeof(ev))
+			ctx->injected++;
+
+		if ((ev.type == EV_SYN) && (ev.code == SYN_REPORT)) {
+			size_t n = ctx->sent_count;
+
+			ctx->sent[n].ts = ts;
+			ctx->sent[n].sent_ns = now_ns();
+			__atomic_store_n(&ctx->sent_count, n + 1, __ATOMIC_RELEASE);
+			ts = 0;
+		}
+	}
+	ctx->end_ns = now_ns();
+
+	/* Wait for the events still in flight to leave poll */
+	do {
+		struct timespec t = { 0, 10000000 };
+
+		nanosleep(&t, NULL);
+		now = now_ns();
+	} while ((now - __atomic_load_n(&ctx->last_event_ns, __ATOMIC_ACQUIRE) < DRAIN_IDLE_NS) &&
+			(now - ctx->end_ns < DRAIN_MAX_NS));
+
+	/* Let the poll loop see the end of the replay. The flush leaves a
+	 * meta event pending and activating the sensor again wakes up poll
+	 * to return it.
+	 */
+	__atomic_store_n(&ctx->done, 1, __ATOMIC_RELEASE);
+	dev->flush(dev, ctx->wake_handle);
+	ctx->dev->activate(ctx->dev, ctx->wake_handle, 1);
+
+	return NULL;
+}
+
+static int load_log(const char *file, struct sensors_log_header *hdr,
+		struct sensors_log_record **records, size_t *count)
+{
+	struct stat st;
+	size_t i;
+	FILE *in;
+
+	in = fopen(file, "r");
+	if (in == NULL)
+		return -1;
+
+	if ((fstat(fileno(in), &st) < 0) || (fread(hdr, sizeof(*hdr), 1, in) != 1) ||
+			(hdr->magic != SENSORS_LOG_MAGIC) || (hdr->version != SENSORS_LOG_VERSION) ||
+			(hdr->stream_count > MAX_SENSORS)) {
+		fclose(in);
+		return -1;
+	}
+
+	*count = (st.st_size - sizeof(*hdr)) / sizeof(**records);
+	*records = (struct sensors_log_record *)malloc(*count * sizeof(**records) + 1);
+	if ((*records == NULL) || (fread(*records, sizeof(**records), *count, in) != *count)) {
+		fclose(in);
+		return -1;
+	}
+	fclose(in);
+
+	for (i = 0; i < *count; i++) {
+		if ((*records)[i].stream >= hdr->stream_count) {
+			free(*records);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int write_node(const char *dir, const char *node, const char *value)
+{
+	char path[PATH_MAX];
+	FILE *out;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, node);
+	out = fopen(path, "w");
+	if (out == NULL) {
+		fprintf(stderr, "open %s failed(%s)\n", path, strerror(errno));
+		return -1;
+	}
+	/* The HAL strips the trailing newline of sysfs values */
+	fprintf(out, "%s\n", value);
+	fclose(out);
+
+	return 0;
+}
+
+/* Recreate the sysfs class nodes of the recorded sensors under dir/sysfs */
+static int write_sysfs(const char *dir, const struct sensors_log_header *hdr)
+{
+	static const char * const controls[] = {
+		SYSFS_ENABLE, SYSFS_POLL_DELAY, SYSFS_MAXLATENCY, SYSFS_FLUSH,
+	};
+	char path[PATH_MAX];
+	uint32_t i, j;
+
+	snprintf(path, sizeof(path), "%s/sysfs", dir);
+	mkdir(path, 0770);
+	for (i = 0; i < hdr->stream_count; i++) {
+		snprintf(path, sizeof(path), "%s/sysfs/sensor%u", dir, i);
+		mkdir(path, 0770);
+		if (write_node(path, SYSFS_NAME, hdr->name[i]))
+			return -1;
+		for (j = 0; j < SENSORS_LOG_ATTR_COUNT; j++) {
+			if (hdr->attr[i][j][0] && write_node(path, sensors_log_attrs[j], hdr->attr[i][j]))
+				return -1;
+		}
+		for (j = 0; j < ARRAY_SIZE(controls); j++) {
+			if (write_node(path, controls[j], ""))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void remove_sysfs(const char *dir, const struct sensors_log_header *hdr)
+{
+	char path[PATH_MAX];
+	uint32_t i;
+
+	for (i = 0; i < hdr->stream_count; i++) {
+		snprintf(path, sizeof(path), "%s/sysfs/sensor%u", dir, i);
+		DIR *d = opendir(path);
+		struct dirent *de;
+
+		if (d == NULL)
+			continue;
+		while ((de = readdir(d)) != NULL) {
+			char node[PATH_MAX + sizeof(de->d_name)];
+			int len;
+
+			if (de->d_name[0] == '.')
+				continue;
+			len = snprintf(node, sizeof(node), "%s/%s", path, de->d_name);
+			if ((len < 0) || (len >= (int)sizeof(node)))
+				continue;
+			unlink(node);
+		}
+		closedir(d);
+		rmdir(path);
+	}
+	snprintf(path, sizeof(path), "%s/sysfs", dir);
+	rmdir(path);
+}
+
+int main(int argc, char **argv)
+{
+	struct replay_context ctx;
+	struct sensors_log_header hdr;
+	struct sensors_module_t *module = &HAL_MODULE_INFO_SYM;
+	struct sensor_t const *list;
+	sensors_event_t events[64];
+	int64_t per_sensor[MAX_SENSORS];
+	int64_t *latency;
+	int64_t received = 0;
+	int64_t dropped = 0;
+	int64_t cpu_start, wall;
+	size_t samples = 0;
+	const char *dir;
+	char path[PATH_MAX];
+	pthread_t thread;
+	int count, i, n;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <log> [speed] [dir]\n", argv[0]);
+		return 1;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.speed = (argc > 2) ? atof(argv[2]) : 1.0;
+	if (ctx.speed <= 0)
+		ctx.speed = 1.0;
+	dir = (argc > 3) ? argv[3] : REPLAY_DIR;
+
+	if (load_log(argv[1], &hdr, &ctx.records, &ctx.record_count) ||
+			(ctx.record_count == 0)) {
+		fprintf(stderr, "invalid log %s\n", argv[1]);
+		return 1;
+	}
+
+	/* The HAL reads the sysfs nodes and opens the FIFOs when it is loaded */
+	mkdir(dir, 0770);
+	if (write_sysfs(dir, &hdr))
+		return 1;
+	for (i = 0; i < (int)hdr.stream_count; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, hdr.name[i]);
+		unlink(path);
+		if (mkfifo(path, 0660)) {
+			fprintf(stderr, "mkfifo %s failed(%s)\n", path, strerror(errno));
+			return 1;
+		}
+	}
+	setenv(SENSORS_REPLAY_ENV, dir, 1);
+
+	if (sensors_open(&module->common, &ctx.dev)) {
+		fprintf(stderr, "failed to open the sensors HAL\n");
+		return 1;
+	}
+
+	/* Open for writing only after the HAL opened the read side */
+	for (i = 0; i < (int)hdr.stream_count; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, hdr.name[i]);
+		ctx.fifo[i] = open(path, O_WRONLY);
+		if (ctx.fifo[i] < 0) {
+			fprintf(stderr, "open %s failed(%s)\n", path, strerror(errno));
+			return 1;
+		}
+	}
+
+	count = module->get_sensors_list(module, &list);
+	if (count <= 0) {
+		fprintf(stderr, "no sensor found in the log\n");
+		return 1;
+	}
+	if (count > MAX_SENSORS)
+		count = MAX_SENSORS;
+	for (i = 0; i < count; i++) {
+		ctx.dev->setDelay(ctx.dev, list[i].handle, list[i].minDelay * 1000LL);
+		ctx.dev->activate(ctx.dev, list[i].handle, 1);
+		per_sensor[i] = 0;
+	}
+	ctx.wake_handle = list[0].handle;
+
+	latency = (int64_t *)malloc(MAX_LATENCY_SAMPLES * sizeof(*latency));
+	ctx.sent = (struct sent_report *)malloc(ctx.record_count * sizeof(*ctx.sent));
+	if ((latency == NULL) || (ctx.sent == NULL))
+		return 1;
+
+	cpu_start = cpu_ns();
+	ctx.last_event_ns = now_ns();
+	pthread_create(&thread, NULL, inject_thread, &ctx);
+
+	while (!__atomic_load_n(&ctx.done, __ATOMIC_ACQUIRE)) {
+		n = ctx.dev->poll(ctx.dev, events, ARRAY_SIZE(events));
+		int64_t now = now_ns();
+
+		/* Woken up by the injection thread, everything was drained */
+		if (__atomic_load_n(&ctx.done, __ATOMIC_ACQUIRE))
+			break;
+
+		for (i = 0; i < n; i++) {
+			int64_t sent;
+
+			if (events[i].type == SENSOR_TYPE_META_DATA)
+				continue;
+
+			/* Skip the events reported on activation */
+			if (events[i].timestamp < ctx.start_ns)
+				continue;
+
+			__atomic_store_n(&ctx.last_event_ns, now, __ATOMIC_RELEASE);
+			sent = sent_time(&ctx, events[i].timestamp);
+			if ((sent >= 0) && (samples < MAX_LATENCY_SAMPLES))
+				latency[samples++] = now - sent;
+			for (int j = 0; j < count; j++) {
+				if (list[j].handle == events[i].sensor)
+					per_sensor[j]++;
+			}
+			received++;
+		}
+	}
+
+	pthread_join(thread, NULL);
+	wall = ctx.end_ns - ctx.start_ns;
+
+	printf("injected %lld input events, received %lld sensor events in %.3f s\n",
+			(long long)ctx.injected, (long long)received, wall / 1e9);
+	if (samples) {
+		qsort(latency, samples, sizeof(*latency), cmp_int64);
+		printf("latency us: p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+				latency[samples / 2] / 1e3,
+				latency[samples * 9 / 10] / 1e3,
+				latency[samples * 99 / 100] / 1e3,
+				latency[samples - 1] / 1e3);
+		printf("throughput %.1f events/s, cpu %.2f us/event\n",
+				received * 1e9 / wall,
+				(cpu_ns() - cpu_start) / 1e3 / received);
+	}
+	/* Created with the HAL device, after SENSORS_REPLAY_ENV is set */
+	NativeSensorManager& sm(NativeSensorManager::getInstance());
+	for (i = 0; i < count; i++) {
+		const SensorContext *sc = sm.getInfoByHandle(list[i].handle);
+		int64_t drops = 0;
+
+		/* Events lost in the circular buffer of a virtual sensor */
+		if ((sc != NULL) && sc->is_virtual && (sc->driver != NULL))
+			drops = ((VirtualSensor *)sc->driver)->getDroppedEvents();
+		dropped += drops;
+		printf("%-32s %lld events %lld dropped\n", list[i].name,
+				(long long)per_sensor[i], (long long)drops);
+	}
+	printf("virtual sensor drops %lld\n", (long long)dropped);
+
+	for (i = 0; i < count; i++)
+		ctx.dev->activate(ctx.dev, list[i].handle, 0);
+	sensors_close(ctx.dev);
+	for (i = 0; i < (int)hdr.stream_count; i++) {
+		close(ctx.fifo[i]);
+		snprintf(path, sizeof(path), "%s/%s", dir, hdr.name[i]);
+		unlink(path);
+	}
+	remove_sysfs(dir, &hdr);
+	free(latency);
+	free(ctx.sent);
+	free(ctx.records);
+
+	return 0;
+}